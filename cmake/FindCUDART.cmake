@@ -0,0 +1,31 @@
+# - Try to find libcudart
+# Once done this will define
+#  CUDART_FOUND - System has the CUDA runtime
+#  CUDART_INCLUDE_DIRS - The libcudart include directories
+#  CUDART_LIBRARIES - The libraries needed to use libcudart
+
+FIND_PATH(WITH_CUDART_PREFIX
+    NAMES include/cuda_runtime.h
+)
+
+FIND_LIBRARY(CUDART_LIBRARIES
+    NAMES cudart
+    HINTS ${WITH_CUDART_PREFIX}/lib64 ${WITH_CUDART_PREFIX}/lib
+)
+
+FIND_PATH(CUDART_INCLUDE_DIRS
+    NAMES cuda_runtime.h
+    HINTS ${WITH_CUDART_PREFIX}/include
+)
+
+INCLUDE(FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(CUDART DEFAULT_MSG
+    CUDART_LIBRARIES
+    CUDART_INCLUDE_DIRS
+)
+
+# Hide these vars from ccmake GUI
+MARK_AS_ADVANCED(
+	CUDART_LIBRARIES
+	CUDART_INCLUDE_DIRS
+)
@@ -0,0 +1,31 @@
+# - Try to find libcufile
+# Once done this will define
+#  CUFILE_FOUND - System has the cuFile (GPUDirect Storage) library
+#  CUFILE_INCLUDE_DIRS - The libcufile include directories
+#  CUFILE_LIBRARIES - The libraries needed to use libcufile
+
+FIND_PATH(WITH_CUFILE_PREFIX
+    NAMES include/cufile.h
+)
+
+FIND_LIBRARY(CUFILE_LIBRARIES
+    NAMES cufile
+    HINTS ${WITH_CUFILE_PREFIX}/lib64 ${WITH_CUFILE_PREFIX}/lib
+)
+
+FIND_PATH(CUFILE_INCLUDE_DIRS
+    NAMES cufile.h
+    HINTS ${WITH_CUFILE_PREFIX}/include
+)
+
+INCLUDE(FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(CUFILE DEFAULT_MSG
+    CUFILE_LIBRARIES
+    CUFILE_INCLUDE_DIRS
+)
+
+# Hide these vars from ccmake GUI
+MARK_AS_ADVANCED(
+	CUFILE_LIBRARIES
+	CUFILE_INCLUDE_DIRS
+)
@@ -0,0 +1,31 @@
+# - Try to find liblustreapi
+# Once done this will define
+#  LUSTREAPI_FOUND - System has liblustreapi
+#  LUSTREAPI_INCLUDE_DIRS - The liblustreapi include directories
+#  LUSTREAPI_LIBRARIES - The libraries needed to use liblustreapi
+
+FIND_PATH(WITH_LUSTREAPI_PREFIX
+    NAMES include/lustre/lustreapi.h
+)
+
+FIND_LIBRARY(LUSTREAPI_LIBRARIES
+    NAMES lustreapi
+    HINTS ${WITH_LUSTREAPI_PREFIX}/lib
+)
+
+FIND_PATH(LUSTREAPI_INCLUDE_DIRS
+    NAMES lustre/lustreapi.h
+    HINTS ${WITH_LUSTREAPI_PREFIX}/include
+)
+
+INCLUDE(FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(LUSTREAPI DEFAULT_MSG
+    LUSTREAPI_LIBRARIES
+    LUSTREAPI_INCLUDE_DIRS
+)
+
+# Hide these vars from ccmake GUI
+MARK_AS_ADVANCED(
+	LUSTREAPI_LIBRARIES
+	LUSTREAPI_INCLUDE_DIRS
+)
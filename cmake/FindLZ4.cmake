@@ -0,0 +1,31 @@
+# - Try to find liblz4
+# Once done this will define
+#  LZ4_FOUND - System has liblz4
+#  LZ4_INCLUDE_DIRS - The liblz4 include directories
+#  LZ4_LIBRARIES - The libraries needed to use liblz4
+
+FIND_PATH(WITH_LZ4_PREFIX
+    NAMES include/lz4.h
+)
+
+FIND_LIBRARY(LZ4_LIBRARIES
+    NAMES lz4
+    HINTS ${WITH_LZ4_PREFIX}/lib
+)
+
+FIND_PATH(LZ4_INCLUDE_DIRS
+    NAMES lz4.h
+    HINTS ${WITH_LZ4_PREFIX}/include
+)
+
+INCLUDE(FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(LZ4 DEFAULT_MSG
+    LZ4_LIBRARIES
+    LZ4_INCLUDE_DIRS
+)
+
+# Hide these vars from ccmake GUI
+MARK_AS_ADVANCED(
+	LZ4_LIBRARIES
+	LZ4_INCLUDE_DIRS
+)
@@ -0,0 +1,31 @@
+# - Try to find libzstd
+# Once done this will define
+#  ZSTD_FOUND - System has libzstd
+#  ZSTD_INCLUDE_DIRS - The libzstd include directories
+#  ZSTD_LIBRARIES - The libraries needed to use libzstd
+
+FIND_PATH(WITH_ZSTD_PREFIX
+    NAMES include/zstd.h
+)
+
+FIND_LIBRARY(ZSTD_LIBRARIES
+    NAMES zstd
+    HINTS ${WITH_ZSTD_PREFIX}/lib
+)
+
+FIND_PATH(ZSTD_INCLUDE_DIRS
+    NAMES zstd.h
+    HINTS ${WITH_ZSTD_PREFIX}/include
+)
+
+INCLUDE(FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(ZSTD DEFAULT_MSG
+    ZSTD_LIBRARIES
+    ZSTD_INCLUDE_DIRS
+)
+
+# Hide these vars from ccmake GUI
+MARK_AS_ADVANCED(
+	ZSTD_LIBRARIES
+	ZSTD_INCLUDE_DIRS
+)
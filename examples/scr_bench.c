@@ -0,0 +1,475 @@
+/*
+ * Benchmark the bandwidth of SCR phases for one configuration.
+ *
+ * In write mode, each iteration writes a dataset of FILES files of SIZE
+ * bytes per rank.  Even iterations are checkpoints only, odd iterations
+ * are also marked as output so that SCR flushes them.  This reports the
+ * time to write files to cache, the time in SCR_Complete_output for
+ * checkpoints (encode), and the time in SCR_Complete_output for flushed
+ * datasets (flush, including its encode).  With async flush, the flush
+ * phase measures how long the application is blocked.
+ *
+ * In restart mode, this times SCR_Init through SCR_Complete_restart.
+ * Whether that is a fetch or a rebuild depends on what the caller removed
+ * from cache before the run, so the phase name is given on the command
+ * line.  See scr_bench.sh for a driver that sweeps configurations.
+ *
+ * Results are bandwidths in MB/s per rank per iteration, summarized as
+ * min/median/max, along with the median aggregate bandwidth, and are
+ * appended to a CSV or JSON-lines file by rank 0.  Write mode also
+ * reports the time in SCR_Init as an "init" phase in seconds, whose
+ * aggregate is the time of the slowest rank.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <getopt.h>
+
+#include "mpi.h"
+#include "scr.h"
+#include "test_common.h"
+
+static int rank  = -1;
+static int ranks = 0;
+
+static size_t filesize = 1024 * 1024;
+static int files = 1;
+static int iters = 4;
+static char* type   = "XOR";
+static int bypass   = 0;
+static int async    = 0;
+static char* mode   = "write";
+static char* phase  = "restart";
+static char* label  = "";
+static char* outfile = NULL;
+static int json = 0;
+
+/* compare doubles for qsort */
+static int cmp_double(const void* a, const void* b)
+{
+  double x = *(const double*) a;
+  double y = *(const double*) b;
+  return (x > y) - (x < y);
+}
+
+/* returns median of sorted array */
+static double median(const double* vals, int count)
+{
+  if (count == 0) {
+    return 0.0;
+  }
+  if (count % 2 == 1) {
+    return vals[count / 2];
+  }
+  return (vals[count / 2 - 1] + vals[count / 2]) / 2.0;
+}
+
+/* given times in seconds from this rank for count iterations, gather
+ * them to rank 0 and append a record for the phase to the output file,
+ * reports bandwidth unless time_flag is set, in which case it reports
+ * the times themselves */
+static void report(const char* name, const double* secs, int count, int time_flag)
+{
+  const char* units = time_flag ? "s" : "MB/s";
+
+  /* bytes written or read by each rank in each iteration */
+  double mb = ((double) filesize * (double) files) / (1024.0 * 1024.0);
+
+  double* all = NULL;
+  if (rank == 0) {
+    all = (double*) malloc(count * ranks * sizeof(double));
+  }
+  MPI_Gather((void*) secs, count, MPI_DOUBLE, all, count, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+  if (rank != 0) {
+    return;
+  }
+
+  /* aggregate bandwidth of each iteration is limited by the slowest rank */
+  double* agg = (double*) malloc(count * sizeof(double));
+  int i, r;
+  for (i = 0; i < count; i++) {
+    double max = 0.0;
+    for (r = 0; r < ranks; r++) {
+      if (all[r * count + i] > max) {
+        max = all[r * count + i];
+      }
+    }
+    if (time_flag) {
+      agg[i] = max;
+    } else {
+      agg[i] = (max > 0.0) ? (mb * ranks) / max : 0.0;
+    }
+  }
+
+  /* convert times to per-rank bandwidths */
+  int total = count * ranks;
+  if (! time_flag) {
+    for (i = 0; i < total; i++) {
+      all[i] = (all[i] > 0.0) ? mb / all[i] : 0.0;
+    }
+  }
+
+  qsort(all, total, sizeof(double), cmp_double);
+  qsort(agg, count, sizeof(double), cmp_double);
+  double bwmin = (total > 0) ? all[0] : 0.0;
+  double bwmax = (total > 0) ? all[total - 1] : 0.0;
+  double bwmed = median(all, total);
+  double aggmed = median(agg, count);
+
+  printf("%-8s Min %9.3f %s\tMedian %9.3f %s\tMax %9.3f %s\tAgg %9.3f %s\n",
+         name, bwmin, units, bwmed, units, bwmax, units, aggmed, units
+  );
+  fflush(stdout);
+
+  if (outfile != NULL) {
+    /* write a header if we're starting a new CSV file */
+    struct stat st;
+    int new_file = (stat(outfile, &st) != 0 || st.st_size == 0);
+
+    FILE* fp = fopen(outfile, "a");
+    if (fp != NULL) {
+      if (json) {
+        fprintf(fp, "{\"label\":\"%s\",\"phase\":\"%s\",\"ranks\":%d,\"size\":%lu,"
+                    "\"files\":%d,\"type\":\"%s\",\"bypass\":%d,\"async\":%d,\"iters\":%d,"
+                    "\"min\":%.3f,\"median\":%.3f,\"max\":%.3f,\"agg_median\":%.3f,\"units\":\"%s\"}\n",
+                label, name, ranks, (unsigned long) filesize,
+                files, type, bypass, async, count,
+                bwmin, bwmed, bwmax, aggmed, units
+        );
+      } else {
+        if (new_file) {
+          fprintf(fp, "label,phase,ranks,size,files,type,bypass,async,iters,min,median,max,agg_median,units\n");
+        }
+        fprintf(fp, "%s,%s,%d,%lu,%d,%s,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%s\n",
+                label, name, ranks, (unsigned long) filesize,
+                files, type, bypass, async, count,
+                bwmin, bwmed, bwmax, aggmed, units
+        );
+      }
+      fclose(fp);
+    } else {
+      printf("%d: Could not open output file %s\n", rank, outfile);
+    }
+  }
+
+  free(agg);
+  free(all);
+}
+
+/* write our files for the dataset named by dset */
+static int write_files(const char* dset, char* buf)
+{
+  int valid = 1;
+  int i;
+  for (i = 0; i < files; i++) {
+    char name[SCR_MAX_FILENAME];
+    safe_snprintf(name, sizeof(name), "%s/rank_%d.%d.dat", dset, rank, i);
+
+    char file[SCR_MAX_FILENAME];
+    if (SCR_Route_file(name, file) != SCR_SUCCESS) {
+      printf("%d: failed calling SCR_Route_file(): @%s:%d\n",
+             rank, __FILE__, __LINE__
+      );
+      valid = 0;
+      continue;
+    }
+
+    int fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+      printf("%d: Could not open file %s\n", rank, file);
+      valid = 0;
+      continue;
+    }
+    if (reliable_write(fd, buf, filesize) < 0) {
+      printf("%d: Error writing to %s\n", rank, file);
+      valid = 0;
+    }
+    if (fsync(fd) < 0) {
+      printf("%d: Error fsync %s\n", rank, file);
+      valid = 0;
+    }
+    if (close(fd) < 0) {
+      printf("%d: Error closing %s\n", rank, file);
+      valid = 0;
+    }
+  }
+  return valid;
+}
+
+/* read our files from the dataset named by dset */
+static int read_files(const char* dset, char* buf)
+{
+  int valid = 1;
+  int i;
+  for (i = 0; i < files; i++) {
+    char name[SCR_MAX_FILENAME];
+    safe_snprintf(name, sizeof(name), "%s/rank_%d.%d.dat", dset, rank, i);
+
+    char file[SCR_MAX_FILENAME];
+    if (SCR_Route_file(name, file) != SCR_SUCCESS) {
+      valid = 0;
+      continue;
+    }
+
+    int fd = open(file, O_RDONLY);
+    if (fd < 0) {
+      printf("%d: Could not open file %s\n", rank, file);
+      valid = 0;
+      continue;
+    }
+    if (reliable_read(fd, buf, filesize) < 0) {
+      printf("%d: Error reading from %s\n", rank, file);
+      valid = 0;
+    }
+    close(fd);
+  }
+  return valid;
+}
+
+/* configure SCR for the settings we're measuring */
+static void configure(void)
+{
+  char buf[256];
+
+  safe_snprintf(buf, sizeof(buf), "SCR_COPY_TYPE=%s", type);
+  SCR_Config(buf);
+
+  safe_snprintf(buf, sizeof(buf), "SCR_CACHE_BYPASS=%d", bypass);
+  SCR_Config(buf);
+
+  safe_snprintf(buf, sizeof(buf), "SCR_FLUSH_ASYNC=%d", async);
+  SCR_Config(buf);
+
+  /* we flush datasets explicitly by marking them as output */
+  SCR_Config("SCR_FLUSH=0");
+}
+
+static int bench_write(char* buf)
+{
+  double* write_secs  = (double*) malloc(iters * sizeof(double));
+  double* encode_secs = (double*) malloc(iters * sizeof(double));
+  double* flush_secs  = (double*) malloc(iters * sizeof(double));
+  int encode_count = 0;
+  int flush_count  = 0;
+
+  int i;
+  for (i = 0; i < iters * 2; i++) {
+    /* mark every other dataset as output to force a flush */
+    int flush = (i % 2 == 1);
+    int flags = SCR_FLAG_CHECKPOINT;
+    if (flush) {
+      flags |= SCR_FLAG_OUTPUT;
+    }
+
+    char dset[SCR_MAX_FILENAME];
+    safe_snprintf(dset, sizeof(dset), "bench.%d", i);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    SCR_Start_output(dset, flags);
+
+    double start = MPI_Wtime();
+    int valid = write_files(dset, buf);
+    double written = MPI_Wtime();
+
+    SCR_Complete_output(valid);
+    double complete = MPI_Wtime();
+
+    /* measure writes on checkpoint-only iterations, so that we sample
+     * each phase the same number of times */
+    if (flush) {
+      flush_secs[flush_count++] = complete - written;
+    } else {
+      write_secs[encode_count]    = written - start;
+      encode_secs[encode_count++] = complete - written;
+    }
+  }
+
+  report("write",  write_secs,  encode_count, 0);
+  report("encode", encode_secs, encode_count, 0);
+  report("flush",  flush_secs,  flush_count,  0);
+
+  free(flush_secs);
+  free(encode_secs);
+  free(write_secs);
+  return 0;
+}
+
+static int bench_restart(char* buf)
+{
+  double start = MPI_Wtime();
+
+  if (SCR_Init() != SCR_SUCCESS) {
+    printf("Failed initializing SCR\n");
+    return 1;
+  }
+
+  int restarted = 0;
+  int have_restart = 0;
+  char dset[SCR_MAX_FILENAME];
+  SCR_Have_restart(&have_restart, dset);
+  if (have_restart) {
+    SCR_Start_restart(dset);
+    int valid = read_files(dset, buf);
+    if (SCR_Complete_restart(valid) == SCR_SUCCESS) {
+      restarted = 1;
+    }
+  }
+
+  double secs = MPI_Wtime() - start;
+
+  if (! restarted) {
+    if (rank == 0) {
+      printf("Failed to restart from a checkpoint\n");
+    }
+    SCR_Finalize();
+    return 1;
+  }
+
+  report(phase, &secs, 1, 0);
+
+  SCR_Finalize();
+  return 0;
+}
+
+static void print_usage(void)
+{
+  printf("\n");
+  printf("  Usage: scr_bench [options]\n");
+  printf("\n");
+  printf("  Options:\n");
+  printf("    -s, --size=<SIZE>     File size in bytes (default %lu)\n", (unsigned long) filesize);
+  printf("    -n, --files=<COUNT>   Files per rank in each dataset (default %d)\n", files);
+  printf("    -i, --iters=<COUNT>   Samples of each phase (default %d)\n", iters);
+  printf("    -r, --type=<TYPE>     Redundancy type: SINGLE, PARTNER, XOR, RS (default %s)\n", type);
+  printf("    -b, --bypass          Write files directly to the file system\n");
+  printf("    -a, --async           Flush asynchronously\n");
+  printf("    -m, --mode=<MODE>     write or restart (default %s)\n", mode);
+  printf("    -p, --phase=<NAME>    Phase name to report in restart mode (default %s)\n", phase);
+  printf("    -l, --label=<STR>     Label to include in each record\n");
+  printf("    -o, --out=<FILE>      Append results to FILE\n");
+  printf("    -j, --json            Write results as JSON lines rather than CSV\n");
+  printf("    -h, --help            Print usage\n");
+  printf("\n");
+}
+
+int main (int argc, char* argv[])
+{
+  MPI_Init(&argc, &argv);
+
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+  static const char *opt_string = "s:n:i:r:bam:p:l:o:jh";
+  static struct option long_options[] = {
+    {"size",   required_argument, NULL, 's'},
+    {"files",  required_argument, NULL, 'n'},
+    {"iters",  required_argument, NULL, 'i'},
+    {"type",   required_argument, NULL, 'r'},
+    {"bypass", no_argument,       NULL, 'b'},
+    {"async",  no_argument,       NULL, 'a'},
+    {"mode",   required_argument, NULL, 'm'},
+    {"phase",  required_argument, NULL, 'p'},
+    {"label",  required_argument, NULL, 'l'},
+    {"out",    required_argument, NULL, 'o'},
+    {"json",   no_argument,       NULL, 'j'},
+    {"help",   no_argument,       NULL, 'h'},
+    {NULL,     no_argument,       NULL,   0}
+  };
+
+  int usage = 0;
+  int long_index = 0;
+  int opt = getopt_long(argc, argv, opt_string, long_options, &long_index);
+  while (opt != -1) {
+    switch(opt) {
+      case 's':
+        filesize = (size_t) strtoull(optarg, NULL, 10);
+        break;
+      case 'n':
+        files = atoi(optarg);
+        break;
+      case 'i':
+        iters = atoi(optarg);
+        break;
+      case 'r':
+        type = optarg;
+        break;
+      case 'b':
+        bypass = 1;
+        break;
+      case 'a':
+        async = 1;
+        break;
+      case 'm':
+        mode = optarg;
+        break;
+      case 'p':
+        phase = optarg;
+        break;
+      case 'l':
+        label = optarg;
+        break;
+      case 'o':
+        outfile = optarg;
+        break;
+      case 'j':
+        json = 1;
+        break;
+      case 'h':
+      default:
+        usage = 1;
+        break;
+    }
+
+    /* get the next option */
+    opt = getopt_long(argc, argv, opt_string, long_options, &long_index);
+  }
+
+  if (filesize == 0 || files < 1 || iters < 1 ||
+      (strcmp(mode, "write") != 0 && strcmp(mode, "restart") != 0))
+  {
+    usage = 1;
+  }
+
+  /* check that we got an appropriate number of arguments */
+  if (usage) {
+    if (rank == 0) {
+      print_usage();
+    }
+    MPI_Finalize();
+    return 1;
+  }
+
+  char* buf = (char*) malloc(filesize);
+  init_buffer(buf, filesize, rank, 0);
+
+  configure();
+
+  int rc;
+  if (strcmp(mode, "restart") == 0) {
+    rc = bench_restart(buf);
+  } else {
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    if (SCR_Init() != SCR_SUCCESS) {
+      printf("Failed initializing SCR\n");
+      return 1;
+    }
+    double secs = MPI_Wtime() - start;
+    report("init", &secs, 1, 1);
+
+    rc = bench_write(buf);
+    SCR_Finalize();
+  }
+
+  free(buf);
+
+  MPI_Finalize();
+
+  return rc;
+}
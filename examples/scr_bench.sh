@@ -0,0 +1,75 @@
+#!/bin/bash
+
+# Sweep scr_bench over a set of configurations and append the results
+# to a single CSV file, so that runs on the same hardware can be compared
+# against a baseline.
+#
+# Usage:
+#   ./scr_bench.sh [output.csv]
+#
+# Each setting may be overridden from the environment, e.g.,
+#   SIZES="1048576 16777216" TYPES="XOR" ./scr_bench.sh baseline.csv
+#
+# LAUNCH is the command used to run scr_bench in parallel.
+# CACHE is the cache directory SCR is configured to use, which this
+# script clears between runs, and from which it removes files to
+# force a fetch or a rebuild on restart.
+
+OUT=${1:-scr_bench.csv}
+LAUNCH=${LAUNCH:-"mpirun -np 2"}
+BENCH=${BENCH:-./scr_bench}
+ITERS=${ITERS:-4}
+CACHE=${CACHE:-/dev/shm/$USER}
+SIZES=${SIZES:-"1048576 16777216"}
+FILES=${FILES:-"1 8"}
+TYPES=${TYPES:-"SINGLE PARTNER XOR RS"}
+BYPASS=${BYPASS:-"0 1"}
+ASYNC=${ASYNC:-"0 1"}
+
+# restart runs must look like the same job to find the cached datasets
+export SCR_JOB_ID=${SCR_JOB_ID:-scr_bench.$$}
+
+cleanup() {
+    rm -rf $CACHE/scr.*/
+    rm -rf .scr/ bench.*/
+}
+
+for size in $SIZES; do
+for files in $FILES; do
+for type in $TYPES; do
+for bypass in $BYPASS; do
+for async in $ASYNC; do
+    label="s${size}_n${files}_${type}_b${bypass}_a${async}"
+    flags="-s $size -n $files -i $ITERS -r $type -l $label -o $OUT"
+    if [ "$bypass" = "1" ]; then
+        flags="$flags -b"
+    fi
+    if [ "$async" = "1" ]; then
+        flags="$flags -a"
+    fi
+
+    echo "Running $label"
+
+    # write, encode, and flush
+    cleanup
+    $LAUNCH $BENCH -m write $flags
+
+    # rebuild: drop the files of rank 0 from cache, only meaningful
+    # when cached datasets carry redundancy data
+    if [ "$bypass" = "0" ] && [ "$type" != "SINGLE" ]; then
+        find $CACHE -name 'rank_0.*.dat' -delete 2>/dev/null
+        $LAUNCH $BENCH -m restart -p rebuild $flags
+    fi
+
+    # fetch: drop cache entirely so the restart reads from the prefix
+    rm -rf $CACHE/scr.*/
+    $LAUNCH $BENCH -m restart -p fetch $flags
+done
+done
+done
+done
+done
+
+cleanup
+
+exit 0
@@ -29,52 +29,26 @@ parser.add_argument('--model', help='model to compute optimum checkpoint interva
 parser.add_argument('--percent', help='express optimum checkpoint interval as percent overhead', action='store_true')
 parser.add_argument('--prefix', help='prefix directory to look for log file', type=str)
 parser.add_argument('--logfile', help='path to log file', type=str)
+parser.add_argument('--jobs', help='print per-job checkpoint cost, flush bandwidth, and interval between job starts', action='store_true')
 args = parser.parse_args(sys.argv[1:])
 
-# count up number of times job has started
-num_starts = 0.0
+# format a statistic, which is None if it had no samples
+def fmt(value, spec='%.1f'):
+  if value is None:
+    return '-'
+  return spec % value
 
-# total time spent during fetch and number of times fetch was executed
-# this will count towards restart cost
-fetch_secs  = 0.0
-fetch_count = 0.0
-
-# total time spent during rebuild and number of times rebuild was executed
-# this will count towards restart cost
-rebuild_secs  = 0.0
-rebuild_count = 0.0
-
-# total time spent during compute phases number of compute phases
-# counts toward compute time
-compute_secs  = 0.0
-compute_count = 0.0
-
-# total time spent during checkpoint phases number of checkpoint phases
-# we'll include this in the checkpoint cost
-checkpoint_secs  = 0.0
-checkpoint_count = 0.0
-
-# total time spent flushing checkpoints and number of flushed checkpoints
-# we'll include this in the checkpoint cost
-flush_ckpt_secs  = 0.0
-flush_ckpt_count = 0.0
-
-# total time spent flushing output and number of flushed outputs (non-checkpoints)
-# this will be part of the "compute" time
-flush_output_secs  = 0.0
-flush_output_count = 0.0
-
-# tracks whether we are in a compute or checkpoint phase
-state = None
-
-# parse log file and get list of entries
+# parse log and get its records as columns,
+# prefer the JSON event log since it is much faster to load
 filename = os.path.join('.scr', 'log')
 if args.prefix:
   filename = os.path.join(args.prefix, filename)
+if os.path.exists(filename + '.json'):
+  filename = filename + '.json'
 if args.logfile:
   filename = args.logfile
 try:
-  entries = scrlog.parse_file(filename)
+  cols = scrlog.load_columns(filename)
 except:
   if args.stats:
     print "ERROR: failed to parse log file:", filename
@@ -86,73 +60,26 @@ except:
     print "10.0"
   quit()
 
-# run over entries and add up time and number of times we executed different phases
-for e in entries:
-  dt = e['timestamp']
-
-  # count number of times we see event=START signaling start of new run
-  if e['label'] == 'START':
-    num_starts += 1.0
-    continue
-
-  # fetch time and count
-  if e['label'] == 'FETCH':
-    secs = e['secs']
-    fetch_secs += secs
-    fetch_count += 1.0
-    continue
-
-  # rebuild time and count
-  if e['label'] == 'RESTART_SUCCESS':
-    secs = e['secs']
-    rebuild_secs += secs
-    rebuild_count += 1.0
-    continue
-
-  # rebuild time and count
-  if e['label'] == 'RESTART_FAILURE':
-    secs = e['secs']
-    rebuild_secs += secs
-    rebuild_count += 1.0
-    continue
-
-  # start of compute phase
-  if e['label'] == 'COMPUTE_START':
-    state = 'compute'
-    continue
-
-  # end of compute phase
-  if e['label'] == 'COMPUTE_END':
-    secs = e['secs']
-    compute_secs += secs
-    compute_count += 1.0
-    continue
-
-  # start of checkpoint phase
-  if e['label'] == 'CHECKPOINT_START':
-    state = 'checkpoint'
-    continue
-
-  # end of checkpoint phase
-  if e['label'] == 'CHECKPOINT_END':
-    secs = e['secs']
-    checkpoint_secs += secs
-    checkpoint_count += 1.0
-    continue
-
-  # flush time and count
-  # if in checkpoint, add to checkpoint time, if in output add to compute time
-  if e['label'] == 'FLUSH_SYNC':
-    secs = e['secs']
-    if state == 'checkpoint':
-      flush_ckpt_secs += secs
-      flush_ckpt_count += 1.0
-    else:
-      flush_output_secs += secs
-      flush_output_count += 1.0
-    continue
-
-#  print e
+# add up time and number of times we executed different phases
+totals = scrlog.summarize(cols)
+num_starts         = totals['starts']
+fetch_secs         = totals['fetch_secs']
+fetch_count        = totals['fetch_count']
+rebuild_secs       = totals['rebuild_secs']
+rebuild_count      = totals['rebuild_count']
+compute_secs       = totals['compute_secs']
+compute_count      = totals['compute_count']
+checkpoint_secs    = totals['checkpoint_secs']
+checkpoint_count   = totals['checkpoint_count']
+flush_ckpt_secs    = totals['flush_ckpt_secs']
+flush_ckpt_count   = totals['flush_ckpt_count']
+flush_output_secs  = totals['flush_output_secs']
+flush_output_count = totals['flush_output_count']
+
+if args.jobs:
+  print "jobid start_interval(s) checkpoint_cost(s) flush_bytes flush_bw(B/s)"
+  for j in scrlog.job_stats(cols):
+    print j['jobid'], fmt(j['interval']), fmt(j['checkpoint_cost'], '%.3f'), fmt(j['flush_bytes'], '%.0f'), fmt(j['flush_bw'], '%.0f')
 
 fetch_cost = fetch_secs
 if fetch_count > 0.0:
@@ -200,6 +127,13 @@ if args.stats:
   print "Total time (s): " + str(total_secs)
   print "Mean time to interrupt (s): " + str(avg_secs_before_failure)
 
+  # runs that ended without a halt record ended in a failure
+  fails = scrlog.failure_stats(cols)
+  print "Runs / failures: ", int(fails['runs']), int(fails['failures'])
+  print "Mean time between failures (s): " + fmt(fails['mtbf'])
+  print "Time to failure min/median/mean/max/stddev (s): ", \
+    fmt(fails['min']), fmt(fails['median']), fmt(fails['mean']), fmt(fails['max']), fmt(fails['stddev'])
+
 if args.model == 'young':
   # "A First Order Approximation to the Optimum Checkpoint Interval",
   # John Young, 1976.
@@ -21,12 +21,44 @@ depending on its 'type' and 'label' values:
   e['timestamp'] (datetime)
   e['note']      (str)
   e['name']      (str)
+
+When SCR_LOG_JSON_ENABLE is set, SCR also writes one JSON record per
+line to .scr/log.json.  That file carries the same fields with 'time'
+in seconds since the epoch, and it can be parsed much faster:
+
+entries = scrlog.parse_json_file(jsonfile)
+
+For large logs, load_columns() returns the records as a dictionary of
+columns (numpy arrays when numpy is available).  log.json is parsed in
+one pass by pandas when it is installed, or otherwise by a single call
+to json.loads.  summarize(), job_stats(), and failure_stats() reduce the
+columns without a per-record python loop:
+
+cols  = scrlog.load_columns(prefix)
+total = scrlog.summarize(cols)
+jobs  = scrlog.job_stats(cols)
+fails = scrlog.failure_stats(cols)
+
+Statistics with no samples are None rather than nan.
 """
 
 import re
+import os
+import json
+import time
 from datetime import datetime, timedelta
 from dateutil import parser
 
+try:
+  import numpy as np
+except ImportError:
+  np = None
+
+try:
+  import pandas as pd
+except ImportError:
+  pd = None
+
 # define regular expressions to pluck out field values
 re_time  = re.compile(r'^(\d\d\d\d\-\d\d\-\d\dT\d\d:\d\d:\d\d)')
 re_jobid = re.compile(r'^jobid=(.*)$')
@@ -133,3 +165,323 @@ def parse_file(filename):
       e = parse_line(l)
       entries.append(e)
   return entries
+
+# given a line from log.json, return an entry like parse_line
+def parse_json_line(l):
+  e = json.loads(l)
+  if 'time' in e:
+    e['timestamp'] = datetime.fromtimestamp(e['time'])
+  if 'files' in e:
+    e['files'] = float(e['files'])
+  return e
+
+def parse_json_file(filename):
+  entries = []
+  with open(filename) as f:
+    for l in f:
+      if l.strip():
+        entries.append(parse_json_line(l))
+  return entries
+
+# names of columns returned by load_columns
+column_names = ['time', 'jobid', 'type', 'label', 'dset', 'secs', 'bytes', 'files']
+
+# convert list of entries to a dictionary of columns,
+# missing numeric values are 0 and missing strings are empty
+def columns_from_entries(entries):
+  cols = dict((c, []) for c in column_names)
+  for e in entries:
+    t = e.get('time')
+    if t is None and 'timestamp' in e:
+      t = time.mktime(e['timestamp'].timetuple())
+    cols['time'].append(float(t or 0.0))
+    cols['jobid'].append(e.get('jobid', ''))
+    cols['type'].append(e.get('type', ''))
+    cols['label'].append(e.get('label', ''))
+    cols['dset'].append(int(e.get('dset', 0)))
+    cols['secs'].append(float(e.get('secs', 0.0)))
+    cols['bytes'].append(float(e.get('bytes', 0.0)))
+    cols['files'].append(float(e.get('files', 0.0)))
+  if np is not None:
+    for c in ['time', 'secs', 'bytes', 'files']:
+      cols[c] = np.array(cols[c], dtype=np.float64)
+    cols['dset'] = np.array(cols['dset'], dtype=np.int64)
+    for c in ['jobid', 'type', 'label']:
+      cols[c] = np.array(cols[c], dtype=object)
+  return cols
+
+# convert a list of JSON records to columns one column at a time
+def _columns_from_records(recs):
+  cols = dict()
+  cols['time']  = [float(r.get('time', 0.0)) for r in recs]
+  cols['jobid'] = [r.get('jobid', '') for r in recs]
+  cols['type']  = [r.get('type', '') for r in recs]
+  cols['label'] = [r.get('label', '') for r in recs]
+  cols['dset']  = [int(r.get('dset', 0)) for r in recs]
+  cols['secs']  = [float(r.get('secs', 0.0)) for r in recs]
+  cols['bytes'] = [float(r.get('bytes', 0.0)) for r in recs]
+  cols['files'] = [float(r.get('files', 0.0)) for r in recs]
+  if np is not None:
+    for c in ['time', 'secs', 'bytes', 'files']:
+      cols[c] = np.array(cols[c], dtype=np.float64)
+    cols['dset'] = np.array(cols['dset'], dtype=np.int64)
+    for c in ['jobid', 'type', 'label']:
+      cols[c] = np.array(cols[c], dtype=object)
+  return cols
+
+# convert a pandas data frame read from log.json to columns
+def _columns_from_frame(df):
+  n = len(df)
+  cols = dict()
+  for c in ['time', 'secs', 'bytes', 'files']:
+    if c in df:
+      cols[c] = df[c].fillna(0.0).to_numpy(dtype=np.float64)
+    else:
+      cols[c] = np.zeros(n, dtype=np.float64)
+  if 'dset' in df:
+    cols['dset'] = df['dset'].fillna(0).to_numpy(dtype=np.int64)
+  else:
+    cols['dset'] = np.zeros(n, dtype=np.int64)
+  for c in ['jobid', 'type', 'label']:
+    if c in df:
+      cols[c] = df[c].fillna('').astype(str).to_numpy(dtype=object)
+    else:
+      cols[c] = np.full(n, '', dtype=object)
+  return cols
+
+# load log.json as columns, parsing the whole file at once,
+# a job killed while writing can leave a partial last line,
+# in which case we fall back to parsing line by line and skip it
+def load_json_columns(filename):
+  if pd is not None and np is not None:
+    try:
+      df = pd.read_json(filename, lines=True, dtype=False, convert_dates=False)
+      return _columns_from_frame(df)
+    except ValueError:
+      pass
+
+  with open(filename) as f:
+    lines = [l for l in f.read().split('\n') if l.strip()]
+  try:
+    recs = json.loads('[' + ','.join(lines) + ']')
+  except ValueError:
+    recs = []
+    for l in lines:
+      try:
+        recs.append(json.loads(l))
+      except ValueError:
+        pass
+  return _columns_from_records(recs)
+
+# load log as columns, given either a log file or a prefix directory,
+# prefers .scr/log.json over the text log when both exist
+def load_columns(path):
+  if os.path.isdir(path):
+    jsonfile = os.path.join(path, '.scr', 'log.json')
+    if os.path.exists(jsonfile):
+      path = jsonfile
+    else:
+      path = os.path.join(path, '.scr', 'log')
+  if path.endswith('.json'):
+    return load_json_columns(path)
+  return columns_from_entries(parse_file(path))
+
+# returns list of rows whose label is any of the given labels
+def _rows(cols, labels):
+  if np is not None:
+    return np.isin(cols['label'], labels)
+  return [l in labels for l in cols['label']]
+
+def _sum(values, mask):
+  if np is not None:
+    return float(values[mask].sum())
+  return float(sum(v for v, m in zip(values, mask) if m))
+
+def _count(mask):
+  if np is not None:
+    return float(np.count_nonzero(mask))
+  return float(sum(1 for m in mask if m))
+
+# mark FLUSH_SYNC records that fall in a checkpoint phase,
+# i.e., whose most recent phase start is CHECKPOINT_START
+def _in_checkpoint(cols):
+  labels = cols['label']
+  if np is not None:
+    n = len(labels)
+    idx = np.arange(n)
+    starts = _rows(cols, ['COMPUTE_START', 'CHECKPOINT_START'])
+    last = np.maximum.accumulate(np.where(starts, idx, -1))
+    ckpt = np.zeros(n, dtype=bool)
+    valid = last >= 0
+    ckpt[valid] = labels[last[valid]] == 'CHECKPOINT_START'
+    return ckpt
+  ckpt = []
+  state = None
+  for l in labels:
+    if l == 'COMPUTE_START':
+      state = 'compute'
+    elif l == 'CHECKPOINT_START':
+      state = 'checkpoint'
+    ckpt.append(state == 'checkpoint')
+  return ckpt
+
+# add up time and number of times we executed different phases,
+# returns a dictionary of totals and counts
+def summarize(cols):
+  s = dict()
+  s['starts'] = _count(_rows(cols, ['START']))
+
+  # fetch and rebuild count towards restart cost
+  m = _rows(cols, ['FETCH'])
+  s['fetch_secs'], s['fetch_count'] = _sum(cols['secs'], m), _count(m)
+  m = _rows(cols, ['RESTART_SUCCESS', 'RESTART_FAILURE'])
+  s['rebuild_secs'], s['rebuild_count'] = _sum(cols['secs'], m), _count(m)
+
+  m = _rows(cols, ['COMPUTE_END'])
+  s['compute_secs'], s['compute_count'] = _sum(cols['secs'], m), _count(m)
+  m = _rows(cols, ['CHECKPOINT_END'])
+  s['checkpoint_secs'], s['checkpoint_count'] = _sum(cols['secs'], m), _count(m)
+
+  # flushes in a checkpoint phase count towards checkpoint cost,
+  # others towards compute time
+  flush = _rows(cols, ['FLUSH_SYNC'])
+  ckpt = _in_checkpoint(cols)
+  if np is not None:
+    m_ckpt, m_out = flush & ckpt, flush & ~ckpt
+  else:
+    m_ckpt = [f and c for f, c in zip(flush, ckpt)]
+    m_out  = [f and not c for f, c in zip(flush, ckpt)]
+  s['flush_ckpt_secs'], s['flush_ckpt_count'] = _sum(cols['secs'], m_ckpt), _count(m_ckpt)
+  s['flush_output_secs'], s['flush_output_count'] = _sum(cols['secs'], m_out), _count(m_out)
+  return s
+
+# split columns into one set of columns per jobid, in order of first appearance
+def _split_jobs(cols):
+  if np is not None:
+    if len(cols['jobid']) == 0:
+      return
+    jobids = cols['jobid'].astype(str)
+    uniq, first, inverse = np.unique(jobids, return_index=True, return_inverse=True)
+    rows_by_job = np.argsort(inverse, kind='stable')
+    bounds = np.concatenate(([0], np.cumsum(np.bincount(inverse, minlength=len(uniq)))))
+    for u in np.argsort(first):
+      rows = rows_by_job[bounds[u]:bounds[u + 1]]
+      yield str(uniq[u]), dict((c, cols[c][rows]) for c in column_names)
+    return
+
+  jobs = []
+  order = dict()
+  for i, j in enumerate(cols['jobid']):
+    if j not in order:
+      order[j] = len(jobs)
+      jobs.append((j, []))
+    jobs[order[j]][1].append(i)
+  for j, rows in jobs:
+    if np is not None:
+      rows = np.array(rows, dtype=np.int64)
+      yield j, dict((c, cols[c][rows]) for c in column_names)
+    else:
+      yield j, dict((c, [cols[c][i] for i in rows]) for c in column_names)
+
+# compute per-job checkpoint cost, flush bandwidth, and the
+# interval since the start of the previous job, returns list of dicts,
+# the cost, bandwidth, and interval are None for a job without samples
+def job_stats(cols):
+  stats = []
+  prev_start = None
+  for jobid, jc in _split_jobs(cols):
+    s = summarize(jc)
+    s['jobid'] = jobid
+
+    times = jc['time']
+    s['first'] = float(min(times))
+    s['last']  = float(max(times))
+
+    # average checkpoint cost for this job
+    s['checkpoint_cost'] = None
+    if s['checkpoint_count'] > 0.0:
+      s['checkpoint_cost'] = (s['checkpoint_secs'] + s['flush_ckpt_secs']) / s['checkpoint_count']
+
+    # aggregate bandwidth of flush transfers to the file system
+    m = _rows(jc, ['FLUSH_SYNC', 'FLUSH_ASYNC'])
+    if np is not None:
+      m = m & (jc['type'] == 'xfer')
+    else:
+      m = [x and t == 'xfer' for x, t in zip(m, jc['type'])]
+    s['flush_bytes'] = _sum(jc['bytes'], m)
+    flush_secs = _sum(jc['secs'], m)
+    s['flush_bw'] = s['flush_bytes'] / flush_secs if flush_secs > 0.0 else None
+
+    # time between the start of this job and the one before it
+    s['interval'] = s['first'] - prev_start if prev_start is not None else None
+    prev_start = s['first']
+    stats.append(s)
+  return stats
+
+# split the log into runs at each START record, a run that logged no
+# HALT before the next START ended in a failure or was killed,
+# returns the length of each run in seconds and whether it failed,
+# records before the first START belong to no run
+def runs(cols):
+  starts = _rows(cols, ['START'])
+  halts  = _rows(cols, ['HALT'])
+  times  = cols['time']
+  if np is not None:
+    idx = np.flatnonzero(starts)
+    if len(idx) == 0:
+      return np.zeros(0, dtype=np.float64), np.zeros(0, dtype=bool)
+    offsets = idx - idx[0]
+    end = np.maximum.reduceat(times[idx[0]:], offsets)
+    halted = np.add.reduceat(halts[idx[0]:].astype(np.int64), offsets) > 0
+    return end - times[idx], ~halted
+
+  secs = []
+  failed = []
+  for t, s, h in zip(times, starts, halts):
+    if s:
+      secs.append(0.0)
+      failed.append(True)
+      start = t
+    elif secs:
+      secs[-1] = max(secs[-1], t - start)
+      if h:
+        failed[-1] = False
+  return secs, failed
+
+# compute mean time between failures over all runs, and the count,
+# min, median, mean, max, and standard deviation of the length of runs
+# that ended in a failure, values are None when there are no failures
+def failure_stats(cols):
+  secs, failed = runs(cols)
+  if np is not None:
+    lengths = secs[failed]
+    total = float(secs.sum())
+  else:
+    lengths = sorted(x for x, f in zip(secs, failed) if f)
+    total = float(sum(secs))
+
+  s = dict()
+  s['runs']      = float(len(secs))
+  s['failures']  = float(len(lengths))
+  s['run_secs']  = total
+  for k in ['mtbf', 'min', 'median', 'mean', 'max', 'stddev']:
+    s[k] = None
+  n = len(lengths)
+  if n == 0:
+    return s
+
+  s['mtbf'] = total / n
+  if np is not None:
+    s['min']    = float(lengths.min())
+    s['median'] = float(np.median(lengths))
+    s['mean']   = float(lengths.mean())
+    s['max']    = float(lengths.max())
+    s['stddev'] = float(lengths.std())
+  else:
+    mean = sum(lengths) / n
+    s['min']    = lengths[0]
+    s['median'] = (lengths[(n - 1) // 2] + lengths[n // 2]) / 2.0
+    s['mean']   = mean
+    s['max']    = lengths[-1]
+    s['stddev'] = (sum((x - mean) ** 2 for x in lengths) / n) ** 0.5
+  return s
@@ -57,6 +57,14 @@ static scr_filemap* scr_map = NULL;
 /* tracks redundancy descriptor for current dataset */
 static scr_reddesc* scr_rd = NULL;
 
+/* tracks a complete output started with SCR_Icomplete_output */
+static int scr_output_pending = 0;          /* flag set while a complete output is outstanding */
+static int scr_output_rc = SCR_SUCCESS;     /* return code of the outstanding or last complete output */
+static SCR_Request scr_output_req_id = -1;  /* request handle of the outstanding or last complete output */
+static MPI_Request scr_output_mpi_req;      /* allreduce of file counts for the outstanding output */
+static unsigned long scr_output_my_counts[3];    /* number of files, bytes, and valid flag of this process */
+static unsigned long scr_output_total_counts[3]; /* sums of the above across processes */
+
 static double scr_time_compute_start;     /* records the start time of the current compute phase */
 static double scr_time_compute_end;       /* records the end time of the current compute phase */
 
@@ -66,6 +74,27 @@ static double scr_time_checkpoint_end;    /* records the end time of the current
 static time_t scr_timestamp_output_start; /* record timestamp of start of output phase */
 static double scr_time_output_start;      /* records the start time of the current output phase */
 static double scr_time_output_end;        /* records the end time of the current output phase */
+static int    scr_outputs_completed = 0;  /* number of outputs completed since init */
+
+static double scr_time_flush_start;       /* records the start time of the last flush from check_flush */
+
+static double scr_time_init_start;        /* records the start time of SCR_Init */
+
+static char* scr_route_dir    = NULL; /* cache directory of the dataset being written */
+static int   scr_route_dir_id = -1;   /* id of the dataset scr_route_dir belongs to */
+static char  scr_route_cwd[SCR_MAX_FILENAME]; /* working directory at start of output */
+static int   scr_route_cwd_valid = 0; /* whether scr_route_cwd has been filled in */
+
+static int     scr_stripe_count   = 0;    /* number of dirs files of the dataset are spread over */
+static char**  scr_stripe_dirs    = NULL; /* dataset dir on each store, first is scr_route_dir */
+static double* scr_stripe_weight  = NULL; /* share of files each dir should get */
+static double* scr_stripe_credit  = NULL; /* running credit of each dir for weighted round robin */
+static kvtree* scr_stripe_names   = NULL; /* maps file name to index of the dir it was routed to */
+
+static int          scr_clone_id  = 0;    /* checkpoint whose files routed files start from, 0 if none */
+static scr_filemap* scr_clone_map = NULL; /* filemap of scr_clone_id, read on first route */
+
+static int scr_through = 0; /* whether completed files of this output are copied to the prefix directory */
 
 /* look up redundancy descriptor we should use for this dataset */
 static scr_reddesc* scr_get_reddesc(const scr_dataset* dataset, int ndescs, scr_reddesc* descs)
@@ -162,130 +191,230 @@ static int scr_halt(const char* reason)
   return rc;
 }
 
-/* check whether we should halt the job */
-static int scr_bool_check_halt_and_decrement(int halt_cond, int decrement)
+/* state of a decision made by rank 0 ahead of time and broadcast
+ * with MPI_Ibcast while the application runs its next step */
+typedef struct {
+  int posted;      /* whether we have posted a broadcast for the next call */
+  int flag;        /* decision, only valid once the broadcast completes */
+  MPI_Request req; /* request of the broadcast */
+} scr_decide_state;
+
+static scr_decide_state scr_decide_checkpoint = {0, 0, MPI_REQUEST_NULL};
+static scr_decide_state scr_decide_exit       = {0, 0, MPI_REQUEST_NULL};
+
+/* if we posted a decision for this call, wait for it to arrive and
+ * set flag, returns 1 if we got a decision and 0 otherwise */
+static int scr_decide_get(scr_decide_state* d, int* flag)
+{
+  if (! d->posted) {
+    return 0;
+  }
+
+  /* rank 0 sent this a call ago, so it has usually arrived by now */
+  MPI_Wait(&d->req, MPI_STATUS_IGNORE);
+  d->posted = 0;
+  *flag = d->flag;
+  return 1;
+}
+
+/* post the decision for the next call, where flag is only used on rank 0 */
+static void scr_decide_post(scr_decide_state* d, int flag)
+{
+  d->flag = flag;
+  MPI_Ibcast(&d->flag, 1, MPI_INT, 0, scr_comm_world, &d->req);
+  d->posted = 1;
+}
+
+/* complete and drop any decisions we posted, so that the next call
+ * decides with the current state, e.g., after a new checkpoint or
+ * before freeing scr_comm_world */
+static void scr_decide_reset(void)
+{
+  int flag;
+  scr_decide_get(&scr_decide_checkpoint, &flag);
+  scr_decide_get(&scr_decide_exit, &flag);
+}
+
+static int scr_output_finish(void);
+
+/* check whether a halt condition is active, only called on rank 0,
+ * which reads the halt file, records halt reason if halt_exit is set */
+static int scr_halt_test(int halt_exit, int decrement)
 {
   /* assume we don't have to halt */
   int need_to_halt = 0;
 
-  /* determine whether we should halt the job by calling exit
-   * if we detect an active halt condition */
-  int halt_exit = ((halt_cond == SCR_TEST_AND_HALT) && scr_halt_exit);
+  /* TODO: all epochs are stored in ints, should be in unsigned ints? */
+  /* get current epoch seconds */
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  int now = tv.tv_sec;
+
+  /* picks up new values if the halt file has changed since we last
+   * read it and decrements the checkpoint counter, the counter is
+   * written back when the file changes, the count runs out, or when
+   * we set a halt reason */
+  scr_halt_check_and_decrement(scr_halt_file, scr_halt_hash, decrement);
+
+  /* set halt seconds to value found in our halt hash */
+  int halt_seconds;
+  if (kvtree_util_get_int(scr_halt_hash, SCR_HALT_KEY_SECONDS, &halt_seconds) != KVTREE_SUCCESS) {
+    /* didn't find anything, so set value to 0 */
+    halt_seconds = 0;
+  }
+
+  /* if halt secs enabled, check the remaining time */
+  if (halt_seconds > 0) {
+    long int remaining = scr_env_seconds_remaining();
+    if (remaining >= 0 && remaining <= halt_seconds) {
+      if (halt_exit) {
+        scr_dbg(0, "Job exiting: Reached time limit: (seconds remaining = %ld) <= (SCR_HALT_SECONDS = %d).",
+                remaining, halt_seconds
+        );
+        scr_halt("TIME_LIMIT");
+      }
+      need_to_halt = 1;
+    }
+  }
 
-  /* only rank 0 reads the halt file */
-  if (scr_my_rank_world == 0) {
-    /* TODO: all epochs are stored in ints, should be in unsigned ints? */
-    /* get current epoch seconds */
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    int now = tv.tv_sec;
-
-    /* locks halt file, reads it to pick up new values, decrements the
-     * checkpoint counter, writes it out, and unlocks it */
-    scr_halt_sync_and_decrement(scr_halt_file, scr_halt_hash, decrement);
-
-    /* set halt seconds to value found in our halt hash */
-    int halt_seconds;
-    if (kvtree_util_get_int(scr_halt_hash, SCR_HALT_KEY_SECONDS, &halt_seconds) != KVTREE_SUCCESS) {
-      /* didn't find anything, so set value to 0 */
-      halt_seconds = 0;
-    }
-
-    /* if halt secs enabled, check the remaining time */
-    if (halt_seconds > 0) {
-      long int remaining = scr_env_seconds_remaining();
-      if (remaining >= 0 && remaining <= halt_seconds) {
-        if (halt_exit) {
-          scr_dbg(0, "Job exiting: Reached time limit: (seconds remaining = %ld) <= (SCR_HALT_SECONDS = %d).",
-                  remaining, halt_seconds
-          );
-          scr_halt("TIME_LIMIT");
+  /* check whether a reason has been specified */
+  char* reason;
+  if (kvtree_util_get_str(scr_halt_hash, SCR_HALT_KEY_EXIT_REASON, &reason) == KVTREE_SUCCESS) {
+    if (strcmp(reason, "") != 0) {
+      /* got a reason, but let's ignore SCR_FINALIZE_CALLED if it's set
+       * and assume user restarted intentionally */
+      if (strcmp(reason, SCR_FINALIZE_CALLED) != 0) {
+        /* since reason points at the EXIT_REASON string in the halt hash, and since
+         * scr_halt() resets this value, we need to copy the current reason */
+        char* tmp_reason = strdup(reason);
+        if (halt_exit && tmp_reason != NULL) {
+          scr_dbg(0, "Job exiting: Reason: %s.", tmp_reason);
+          scr_halt(tmp_reason);
         }
+        scr_free(&tmp_reason);
         need_to_halt = 1;
       }
     }
+  }
 
-    /* check whether a reason has been specified */
-    char* reason;
-    if (kvtree_util_get_str(scr_halt_hash, SCR_HALT_KEY_EXIT_REASON, &reason) == KVTREE_SUCCESS) {
-      if (strcmp(reason, "") != 0) {
-        /* got a reason, but let's ignore SCR_FINALIZE_CALLED if it's set
-         * and assume user restarted intentionally */
-        if (strcmp(reason, SCR_FINALIZE_CALLED) != 0) {
-          /* since reason points at the EXIT_REASON string in the halt hash, and since
-           * scr_halt() resets this value, we need to copy the current reason */
-          char* tmp_reason = strdup(reason);
-          if (halt_exit && tmp_reason != NULL) {
-            scr_dbg(0, "Job exiting: Reason: %s.", tmp_reason);
-            scr_halt(tmp_reason);
-          }
-          scr_free(&tmp_reason);
-          need_to_halt = 1;
-        }
+  /* check whether we are out of checkpoints */
+  int checkpoints_left;
+  if (kvtree_util_get_int(scr_halt_hash, SCR_HALT_KEY_CHECKPOINTS, &checkpoints_left) == KVTREE_SUCCESS) {
+    if (checkpoints_left == 0) {
+      if (halt_exit) {
+        scr_dbg(0, "Job exiting: No more checkpoints remaining.");
+        scr_halt("NO_CHECKPOINTS_LEFT");
       }
+      need_to_halt = 1;
     }
+  }
 
-    /* check whether we are out of checkpoints */
-    int checkpoints_left;
-    if (kvtree_util_get_int(scr_halt_hash, SCR_HALT_KEY_CHECKPOINTS, &checkpoints_left) == KVTREE_SUCCESS) {
-      if (checkpoints_left == 0) {
-        if (halt_exit) {
-          scr_dbg(0, "Job exiting: No more checkpoints remaining.");
-          scr_halt("NO_CHECKPOINTS_LEFT");
-        }
-        need_to_halt = 1;
+  /* check whether we need to exit before a specified time */
+  int exit_before;
+  if (kvtree_util_get_int(scr_halt_hash, SCR_HALT_KEY_EXIT_BEFORE, &exit_before) == KVTREE_SUCCESS) {
+    if (now >= (exit_before - halt_seconds)) {
+      if (halt_exit) {
+        time_t time_now  = (time_t) now;
+        time_t time_exit = (time_t) exit_before - halt_seconds;
+        char str_now[256];
+        char str_exit[256];
+        strftime(str_now,  sizeof(str_now),  "%c", localtime(&time_now));
+        strftime(str_exit, sizeof(str_exit), "%c", localtime(&time_exit));
+        scr_dbg(0, "Job exiting: Current time (%s) is past ExitBefore-HaltSeconds time (%s).",
+                str_now, str_exit
+        );
+        scr_halt("EXIT_BEFORE_TIME");
       }
+      need_to_halt = 1;
     }
+  }
 
-    /* check whether we need to exit before a specified time */
-    int exit_before;
-    if (kvtree_util_get_int(scr_halt_hash, SCR_HALT_KEY_EXIT_BEFORE, &exit_before) == KVTREE_SUCCESS) {
-      if (now >= (exit_before - halt_seconds)) {
-        if (halt_exit) {
-          time_t time_now  = (time_t) now;
-          time_t time_exit = (time_t) exit_before - halt_seconds;
-          char str_now[256];
-          char str_exit[256];
-          strftime(str_now,  sizeof(str_now),  "%c", localtime(&time_now));
-          strftime(str_exit, sizeof(str_exit), "%c", localtime(&time_exit));
-          scr_dbg(0, "Job exiting: Current time (%s) is past ExitBefore-HaltSeconds time (%s).",
-                  str_now, str_exit
-          );
-          scr_halt("EXIT_BEFORE_TIME");
-        }
-        need_to_halt = 1;
+  /* check whether we need to exit after a specified time */
+  int exit_after;
+  if (kvtree_util_get_int(scr_halt_hash, SCR_HALT_KEY_EXIT_AFTER, &exit_after) == KVTREE_SUCCESS) {
+    if (now >= exit_after) {
+      if (halt_exit) {
+        time_t time_now  = (time_t) now;
+        time_t time_exit = (time_t) exit_after;
+        char str_now[256];
+        char str_exit[256];
+        strftime(str_now,  sizeof(str_now),  "%c", localtime(&time_now));
+        strftime(str_exit, sizeof(str_exit), "%c", localtime(&time_exit));
+        scr_dbg(0, "Job exiting: Current time (%s) is past ExitAfter time (%s).", str_now, str_exit);
+        scr_halt("EXIT_AFTER_TIME");
       }
+      need_to_halt = 1;
     }
+  }
 
-    /* check whether we need to exit after a specified time */
-    int exit_after;
-    if (kvtree_util_get_int(scr_halt_hash, SCR_HALT_KEY_EXIT_AFTER, &exit_after) == KVTREE_SUCCESS) {
-      if (now >= exit_after) {
-        if (halt_exit) {
-          time_t time_now  = (time_t) now;
-          time_t time_exit = (time_t) exit_after;
-          char str_now[256];
-          char str_exit[256];
-          strftime(str_now,  sizeof(str_now),  "%c", localtime(&time_now));
-          strftime(str_exit, sizeof(str_exit), "%c", localtime(&time_exit));
-          scr_dbg(0, "Job exiting: Current time (%s) is past ExitAfter time (%s).", str_now, str_exit);
-          scr_halt("EXIT_AFTER_TIME");
-        }
-        need_to_halt = 1;
-      }
+  return need_to_halt;
+}
+
+/* returns 1 if the async flush of the latest dataset is expected to
+ * complete within the time left in the allocation, before the window
+ * reserved by SCR_HALT_SECONDS, in which case it is faster to let it
+ * finish than to stop it and flush again synchronously,
+ * must be called by all procs */
+static int scr_flush_async_can_finish(void)
+{
+  /* a flush that has not moved any bytes yet gives no rate to go by,
+   * so give it a moment, the estimate is the same on all procs */
+  double percent, bw, eta;
+  int rc = scr_flush_async_status(&percent, &bw, &eta);
+  int waited = 0;
+  while (rc == SCR_SUCCESS && eta < 0.0 && waited < SCR_HALT_ETA_WAIT) {
+    sleep(1);
+    waited++;
+    rc = scr_flush_async_status(&percent, &bw, &eta);
+  }
+
+  int finish = 0;
+  if (rc == SCR_SUCCESS && scr_my_rank_world == 0) {
+    long int remaining = scr_env_seconds_remaining();
+    if (eta >= 0.0 && (remaining < 0 || eta < (double) (remaining - scr_halt_seconds))) {
+      scr_dbg(1, "Async flush is %.0f%% done at %.2f MB/s, letting it finish in an estimated %.0f of %ld seconds remaining",
+        percent, bw / (1024.0 * 1024.0), eta, remaining
+      );
+      finish = 1;
     }
   }
+  MPI_Bcast(&finish, 1, MPI_INT, 0, scr_comm_world);
+
+  return finish;
+}
+
+/* check whether we should halt the job */
+static int scr_bool_check_halt_and_decrement(int halt_cond, int decrement)
+{
+  /* assume we don't have to halt */
+  int need_to_halt = 0;
+
+  /* determine whether we should halt the job by calling exit
+   * if we detect an active halt condition */
+  int halt_exit = ((halt_cond == SCR_TEST_AND_HALT) && scr_halt_exit);
+
+  /* only rank 0 reads the halt file */
+  if (scr_my_rank_world == 0) {
+    need_to_halt = scr_halt_test(halt_exit, decrement);
+  }
 
   /* broadcast halt decision from rank 0 */
   MPI_Bcast(&need_to_halt, 1, MPI_INT, 0, scr_comm_world);
 
   /* halt job if we need to, and flush latest checkpoint if needed */
   if (need_to_halt && halt_exit) {
+    /* complete any decisions rank 0 sent ahead of time */
+    scr_decide_reset();
+
+    /* the latest checkpoint is not in the flush file until its output
+     * and encode finish */
+    scr_output_finish();
+
     /* handle any async flush */
     if (scr_flush_async_in_progress) {
-      /* there's an async flush ongoing, see which dataset is being flushed */
-      int flush_rc;
-      if (scr_flush_async_dataset_id == scr_dataset_id) {
+      /* there's an async flush ongoing, see which datasets are being flushed */
+      int flush_rc = SCR_SUCCESS;
+      if (scr_flush_async_pending(scr_dataset_id)) {
 #ifdef HAVE_LIBCPPR
         /* if we have CPPR, async flush is faster than sync flush, so let it finish */
         flush_rc = scr_flush_async_wait(scr_cindex);
@@ -296,16 +425,21 @@ static int scr_bool_check_halt_and_decrement(int halt_cond, int decrement)
         /* neither strdup nor free */
         const scr_storedesc* storedesc = scr_cache_get_storedesc(scr_cindex, scr_dataset_id);
         const char* type = storedesc->xfer;
-        if (strcmp(type, "DATAWARP") == 0) {
-          /* wait for datawarp flushes to finish */
+
+        /* let the async flush finish if it is expected to in time */
+        int finish = scr_flush_async_can_finish();
+        if (finish || strcmp(type, "DATAWARP") == 0) {
+          /* wait for datawarp flushes, or flushes due to finish in time */
           flush_rc = scr_flush_async_wait(scr_cindex);
         } else {
-          /* kill the async flush, we'll get this with a sync flush instead */
+          /* finish flushes of older datasets, then kill the async flush
+           * of this one, we'll get this with a sync flush instead */
+          flush_rc = scr_flush_async_wait_count(scr_cindex, 1);
           scr_flush_async_stop();
         }
 #endif
       } else {
-        /* the async flush is flushing a different dataset, so wait for it */
+        /* the async flushes are flushing different datasets, so wait for them */
         flush_rc = scr_flush_async_wait(scr_cindex);
       }
       if (flush_rc != SCR_SUCCESS) {
@@ -332,11 +466,15 @@ static int scr_bool_check_halt_and_decrement(int halt_cond, int decrement)
     if (scr_flush_async) {
       scr_flush_async_finalize();
     }
+    scr_flush_sync_finalize();
 
     /* sync up tasks before exiting (don't want tasks to exit so early that
      * runtime kills others after timeout) */
     MPI_Barrier(scr_comm_world);
 
+    /* wait on any emergency flush before we exit */
+    scr_pmix_event_finalize();
+
 #ifdef HAVE_LIBPMIX
     /* sync procs in pmix before shutdown */
     int retval = PMIx_Fence(NULL, 0, NULL, 0);
@@ -384,16 +522,45 @@ Utility functions
 =========================================
 */
 
-/* check whether a flush is needed, and execute flush if so */
-static int scr_check_flush(scr_cache_index* map)
+/* given the checkpoint model, determine whether enough time has passed
+ * since the last flush to flush the current checkpoint */
+static int scr_bool_flush_interval(void)
+{
+  /* have rank 0 make the decision and broadcast the result */
+  int flag = 0;
+  if (scr_my_rank_world == 0) {
+    /* compute the optimal flush interval from the measured cost of
+     * a flush and the rate of failures that need the prefix directory */
+    int count;
+    double secs;
+    scr_stats_local_total(SCR_STATS_FLUSH, &count, &secs);
+    double interval = 0.0;
+    if (count > 0) {
+      interval = scr_interval_secs(scr_checkpoint_model, secs / (double) count, scr_checkpoint_mtbf_pfs);
+    }
+
+    if (interval > 0.0) {
+      double now = MPI_Wtime();
+      if (now - scr_time_flush_start >= interval) {
+        flag = 1;
+      }
+    } else {
+      /* until we have measured a flush, flush every scr_flush checkpoints */
+      if (scr_checkpoint_id % scr_flush == 0) {
+        flag = 1;
+      }
+    }
+  }
+  MPI_Bcast(&flag, 1, MPI_INT, 0, scr_comm_world);
+  return flag;
+}
+
+/* determine whether dataset must be flushed once it is complete */
+static int scr_bool_need_flush(const scr_dataset* dataset)
 {
   /* assume we don't have to flush */
   int need_flush = 0;
 
-  /* get info for current dataset */
-  scr_dataset* dataset = scr_dataset_new();
-  scr_cache_index_get_dataset(map, scr_dataset_id, dataset);
-
   /* if this is output we have to flush */
   int is_output = scr_dataset_is_output(dataset);
   if (is_output) {
@@ -402,34 +569,49 @@ static int scr_check_flush(scr_cache_index* map)
 
   /* check whether user has flush enabled */
   if (scr_flush > 0) {
-    /* if this is a checkpoint, then every scr_flush checkpoints, flush the checkpoint set */
+    /* if this is a checkpoint, then every scr_flush checkpoints, flush the checkpoint set,
+     * or when using a checkpoint model, flush once the optimal flush interval has passed */
     int is_ckpt = scr_dataset_is_ckpt(dataset);
-    if (is_ckpt && scr_checkpoint_id > 0 && scr_checkpoint_id % scr_flush == 0) {
-      need_flush = 1;
+    if (is_ckpt && scr_checkpoint_id > 0) {
+      if (scr_checkpoint_model != SCR_INTERVAL_NONE) {
+        if (scr_bool_flush_interval()) {
+          need_flush = 1;
+        }
+      } else if (scr_checkpoint_id % scr_flush == 0) {
+        need_flush = 1;
+      }
     }
   }
 
+  return need_flush;
+}
+
+/* check whether a flush is needed, and execute flush if so */
+static int scr_check_flush(scr_cache_index* map)
+{
+  /* get info for current dataset */
+  scr_dataset* dataset = scr_dataset_new();
+  scr_cache_index_get_dataset(map, scr_dataset_id, dataset);
+
+  /* determine whether this dataset needs to be flushed */
+  int need_flush = scr_bool_need_flush(dataset);
+
+  /* remember when we last flushed for the flush interval */
+  if (need_flush && scr_my_rank_world == 0) {
+    scr_time_flush_start = MPI_Wtime();
+  }
+
   /* flush the dataset if needed */
   if (need_flush) {
-    /* need to flush, determine whether to use async or sync flush */
-    if (scr_flush_async) {
+    /* need to flush, determine whether to use async or sync flush,
+     * segments of shared files are only written back by a sync flush */
+    if (scr_flush_async && ! scr_flush_has_segments(scr_cindex, scr_dataset_id)) {
       if (scr_my_rank_world == 0) {
         scr_dbg(2, "async flush attempt @ %s:%d", __FILE__, __LINE__);;
       }
 
-      /* check that we don't start an async flush if one is already in progress */
-      if (scr_flush_async_in_progress) {
-        /* we need to flush the current dataset, however, another flush is ongoing,
-         * so wait for this other flush to complete before starting the next one */
-        int flush_rc = scr_flush_async_wait(scr_cindex);
-        if (flush_rc != SCR_SUCCESS) {
-          scr_abort(-1, "Flush of dataset %d failed @ %s:%d",
-            scr_flush_async_dataset_id, __FILE__, __LINE__
-          );
-        }
-      }
-
-      /* start an async flush on the current dataset id */
+      /* start an async flush on the current dataset id, this first
+       * waits for older flushes if the queue has no room for it */
       scr_flush_async_start(scr_cindex, scr_dataset_id);
     } else {
       /* synchronously flush the current dataset */
@@ -451,6 +633,289 @@ static int scr_check_flush(scr_cache_index* map)
   return SCR_SUCCESS;
 }
 
+/* with SCR_REDDESC_MODEL, replace the descriptor d picked by the regular
+ * schedule for checkpoint dataset with the one expected to lose the
+ * least time, rank 0 decides for everyone */
+static scr_reddesc* scr_model_reddesc(const scr_dataset* dataset, scr_reddesc* d)
+{
+  if (! scr_reddesc_model || ! scr_dataset_is_ckpt(dataset)) {
+    return d;
+  }
+
+  /* a dataset flushed synchronously right away is safe in the prefix
+   * directory before anything could go wrong with its cached copy */
+  int flush_follows = (scr_bool_need_flush(dataset) && ! scr_flush_async);
+
+  int index = (d != NULL) ? d->index : -1;
+  if (scr_my_rank_world == 0 && scr_time_checkpoint_start > 0.0) {
+    /* expect the time to the next checkpoint to match the last one,
+     * and a failure during it to cost the work since the last flush */
+    double now = MPI_Wtime();
+    double interval = now - scr_time_checkpoint_start;
+    double lost = 0.0;
+    if (! flush_follows) {
+      lost = now - scr_time_flush_start + interval / 2.0;
+    }
+
+    scr_reddesc* model = scr_reddesc_for_model(scr_nreddescs, scr_reddescs, d, interval, lost);
+    if (model != NULL && model->index != index) {
+      scr_dbg(2, "Cost model picked redundancy descriptor %d over %d @ %s:%d",
+        model->index, index, __FILE__, __LINE__
+      );
+      index = model->index;
+    }
+  }
+  MPI_Bcast(&index, 1, MPI_INT, 0, scr_comm_world);
+
+  if (index >= 0 && index < scr_nreddescs) {
+    return &scr_reddescs[index];
+  }
+  return d;
+}
+
+/* once the redundancy scheme has been applied to dataset id with return code rc,
+ * record the dataset in the flush file and check whether we need to flush or halt,
+ * otherwise delete the dataset to conserve space */
+static int scr_complete_encode(int id, int rc, int decrement)
+{
+  /* get info for the dataset */
+  scr_dataset* dataset = scr_dataset_new();
+  scr_cache_index_get_dataset(scr_cindex, id, dataset);
+  int is_ckpt   = scr_dataset_is_ckpt(dataset);
+  int is_output = scr_dataset_is_output(dataset);
+
+  if (rc == SCR_SUCCESS) {
+    /* record entry in flush file for this dataset */
+    char* dset_name;
+    scr_dataset_get_name(dataset, &dset_name);
+    scr_flush_file_new_entry(id, dset_name, dataset, SCR_FLUSH_KEY_LOCATION_CACHE, is_ckpt, is_output);
+
+    /* go ahead and flush any bypass dataset since
+     * it's just a bit more work to finish at this point */
+    int bypass = 0;
+    scr_cache_index_get_bypass(scr_cindex, id, &bypass);
+    if (bypass) {
+      int flush_rc = scr_flush_sync(scr_cindex, id);
+      if (flush_rc != SCR_SUCCESS) {
+        scr_abort(-1, "Flush of dataset %d failed @ %s:%d",
+          id, __FILE__, __LINE__
+        );
+      }
+    }
+
+    /* check_flush may start an async flush, whereas check_halt will call sync flush,
+     * so place check_flush after check_halt */
+    if (is_ckpt) {
+      /* only halt on checkpoints */
+      scr_bool_check_halt_and_decrement(SCR_TEST_AND_HALT, decrement);
+    }
+    scr_check_flush(scr_cindex);
+
+    /* keep identical blocks in cache only once if the store asks for it */
+    scr_cache_dedup_dataset(scr_cindex, id);
+
+    /* keep files compressed in cache if the store asks for it */
+    scr_cache_compress_dataset(scr_cindex, id);
+  } else {
+    /* something went wrong, so delete this checkpoint from the cache */
+    scr_cache_delete(scr_cindex, id);
+
+    /* TODODSET: probably should return error or abort if this is output */
+  }
+
+  scr_dataset_delete(&dataset);
+
+  return rc;
+}
+
+/* wait for an outstanding async encode to finish and complete its dataset */
+static int scr_encode_async_finish(void)
+{
+  if (! scr_encode_async_in_progress) {
+    return SCR_SUCCESS;
+  }
+
+  int id = scr_encode_async_dataset_id;
+  if (scr_my_rank_world == 0) {
+    scr_dbg(2, "Waiting on encode of dataset %d @ %s:%d", id, __FILE__, __LINE__);
+  }
+
+  /* the checkpoint was already counted in the halt file when it was dispatched */
+  int rc = scr_reddesc_apply_wait();
+  return scr_complete_encode(id, rc, 0);
+}
+
+/* complete the dataset of an outstanding async encode if it has finished */
+static int scr_encode_async_progress(void)
+{
+  if (scr_encode_async_in_progress) {
+    if (scr_reddesc_apply_test() == SCR_SUCCESS) {
+      return scr_encode_async_finish();
+    }
+
+    /* not done yet, just print a progress message to the screen */
+    if (scr_my_rank_world == 0) {
+      scr_dbg(1, "Encode of dataset %d is ongoing", scr_encode_async_dataset_id);
+    }
+  }
+  return SCR_SUCCESS;
+}
+
+/* returns the current working directory, which is looked up once per output phase,
+ * aborts if it cannot be determined */
+static const char* scr_route_get_cwd(const char* file)
+{
+  if (! scr_route_cwd_valid) {
+    if (scr_getcwd(scr_route_cwd, sizeof(scr_route_cwd)) != SCR_SUCCESS) {
+      /* problem acquiring current working directory */
+      scr_abort(-1, "Failed to build absolute path to %s @ %s:%d",
+        file, __FILE__, __LINE__
+      );
+    }
+    scr_route_cwd_valid = 1;
+  }
+  return scr_route_cwd;
+}
+
+/* remember the cache directory of the given dataset so that
+ * routing its files only needs a string concatenation */
+static void scr_route_set_dir(int id, const char* dir)
+{
+  scr_free(&scr_route_dir);
+  scr_route_dir_id = -1;
+
+  /* forget the stores the previous dataset was striped across */
+  int i;
+  for (i = 0; i < scr_stripe_count; i++) {
+    scr_free(&scr_stripe_dirs[i]);
+  }
+  scr_free(&scr_stripe_dirs);
+  scr_free(&scr_stripe_weight);
+  scr_free(&scr_stripe_credit);
+  kvtree_delete(&scr_stripe_names);
+  scr_stripe_count = 0;
+
+  /* forget the working directory in case the application has changed it */
+  scr_route_cwd_valid = 0;
+
+  if (dir != NULL) {
+    spath* path = spath_from_str(dir);
+    spath_reduce(path);
+    scr_route_dir = spath_strdup(path);
+    scr_route_dir_id = id;
+    spath_delete(&path);
+  }
+}
+
+/* spread the files of dataset id over the primary store of red and the
+ * stores it stripes across, giving each store a share of the files by the
+ * smaller of its share of write bandwidth and its share of free space,
+ * must be called after scr_route_set_dir */
+static void scr_route_set_stripes(const scr_reddesc* red, int id)
+{
+  if (scr_route_dir == NULL || red->stripe_count == 0) {
+    return;
+  }
+
+  int count = red->stripe_count + 1;
+  scr_stripe_dirs   = (char**)  SCR_MALLOC(count * sizeof(char*));
+  scr_stripe_weight = (double*) SCR_MALLOC(count * sizeof(double));
+  scr_stripe_credit = (double*) SCR_MALLOC(count * sizeof(double));
+  scr_stripe_names  = kvtree_new();
+  scr_stripe_count  = count;
+
+  /* measure each store, bandwidth counts the same for all
+   * unless we have tuned every one of them */
+  double* bw    = (double*) SCR_MALLOC(count * sizeof(double));
+  double* space = (double*) SCR_MALLOC(count * sizeof(double));
+  double bw_total    = 0.0;
+  double space_total = 0.0;
+  int bw_known    = 1;
+  int space_known = 1;
+  int i;
+  for (i = 0; i < count; i++) {
+    scr_storedesc* store;
+    if (i == 0) {
+      store = scr_reddesc_get_store(red);
+      scr_stripe_dirs[i] = strdup(scr_route_dir);
+    } else {
+      store = scr_reddesc_get_stripe_store(red, i - 1);
+      scr_stripe_dirs[i] = scr_cache_stripe_dir_get(red, i - 1, id);
+    }
+    scr_stripe_credit[i] = 0.0;
+
+    bw[i] = store->write_bw;
+    if (bw[i] <= 0.0) {
+      bw_known = 0;
+    }
+    if (scr_storedesc_free_bytes(store, &space[i]) != SCR_SUCCESS) {
+      space_known = 0;
+    }
+    bw_total    += bw[i];
+    space_total += space[i];
+  }
+
+  double weight_total = 0.0;
+  for (i = 0; i < count; i++) {
+    double weight = bw_known ? bw[i] / bw_total : 1.0 / (double) count;
+    if (space_known) {
+      double share = (space_total > 0.0) ? space[i] / space_total : 0.0;
+      if (share < weight) {
+        weight = share;
+      }
+    }
+    scr_stripe_weight[i] = weight;
+    weight_total += weight;
+  }
+
+  /* keep everything on the primary store if no store has room */
+  if (weight_total <= 0.0) {
+    scr_stripe_weight[0] = 1.0;
+  }
+
+  if (scr_my_rank_world == 0) {
+    for (i = 0; i < count; i++) {
+      scr_dbg(2, "Striping dataset %d files to %s with weight %f",
+        id, scr_stripe_dirs[i], scr_stripe_weight[i]
+      );
+    }
+  }
+
+  scr_free(&space);
+  scr_free(&bw);
+}
+
+/* return the directory the named file of the current dataset goes to,
+ * the same name always goes to the same directory */
+static const char* scr_route_stripe_dir(const char* base)
+{
+  if (scr_stripe_count == 0) {
+    return scr_route_dir;
+  }
+
+  int index;
+  if (kvtree_util_get_int(scr_stripe_names, base, &index) == KVTREE_SUCCESS) {
+    return scr_stripe_dirs[index];
+  }
+
+  /* smooth weighted round robin, each dir gains its weight and
+   * the one with the most credit pays the total for the file */
+  double total = 0.0;
+  index = 0;
+  int i;
+  for (i = 0; i < scr_stripe_count; i++) {
+    scr_stripe_credit[i] += scr_stripe_weight[i];
+    total += scr_stripe_weight[i];
+    if (scr_stripe_credit[i] > scr_stripe_credit[index]) {
+      index = i;
+    }
+  }
+  scr_stripe_credit[index] -= total;
+
+  kvtree_util_set_int(scr_stripe_names, base, index);
+  return scr_stripe_dirs[index];
+}
+
 /* given a dataset id and a filename,
  * return the full path to the file which the caller should use to access the file */
 static int scr_route_file(int id, const char* file, char* newfile, int n)
@@ -460,6 +925,8 @@ static int scr_route_file(int id, const char* file, char* newfile, int n)
     return SCR_FAILURE;
   }
 
+  scr_trace_mark_begin("route");
+
   /* check that user's filename is not too long */
   if (strlen(file) >= SCR_MAX_FILENAME) {
     scr_abort(-1, "file name (%s) is longer than SCR_MAX_FILENAME (%d) @ %s:%d",
@@ -467,6 +934,26 @@ static int scr_route_file(int id, const char* file, char* newfile, int n)
     );
   }
 
+  /* if we have the cache directory of this dataset,
+   * just append the file name to it */
+  if (scr_route_dir != NULL && id == scr_route_dir_id) {
+    const char* base = strrchr(file, '/');
+    base = (base != NULL) ? base + 1 : file;
+
+    /* leave names that need simplifying to the general case below */
+    if (strcmp(base, "") != 0 && strcmp(base, ".") != 0 && strcmp(base, "..") != 0) {
+      const char* dir = scr_route_stripe_dir(base);
+      int len = snprintf(newfile, (size_t) n, "%s/%s", dir, base);
+      if (len < 0 || len >= n) {
+        scr_abort(-1, "file name (%s/%s) is longer than %d @ %s:%d",
+          dir, base, n, __FILE__, __LINE__
+        );
+      }
+      scr_trace_mark_end("route");
+      return SCR_SUCCESS;
+    }
+  }
+
   /* convert path string to path object */
   spath* path_file = spath_from_str(file);
 
@@ -480,15 +967,7 @@ static int scr_route_file(int id, const char* file, char* newfile, int n)
     /* build absolute path to file */
     if (! spath_is_absolute(path_file)) {
       /* the path is not absolute, so prepend the current working directory */
-      char cwd[SCR_MAX_FILENAME];
-      if (scr_getcwd(cwd, sizeof(cwd)) == SCR_SUCCESS) {
-        spath_prepend_str(path_file, cwd);
-      } else {
-        /* problem acquiring current working directory */
-        scr_abort(-1, "Failed to build absolute path to %s @ %s:%d",
-          file, __FILE__, __LINE__
-        );
-      }
+      spath_prepend_str(path_file, scr_route_get_cwd(file));
     }
 
     /* TODO: should we check path is a child in prefix here? */
@@ -512,6 +991,7 @@ static int scr_route_file(int id, const char* file, char* newfile, int n)
   /* free the file path */
   spath_delete(&path_file);
 
+  scr_trace_mark_end("route");
   return SCR_SUCCESS;
 }
 
@@ -618,29 +1098,85 @@ static int scr_get_params()
     }
   }
 
-  /* set logging */
-  if ((value = scr_param_get("SCR_LOG_ENABLE")) != NULL) {
-    scr_log_enable = atoi(value);
+  /* whether to record the time of each phase of init and finalize */
+  if ((value = scr_param_get("SCR_TRACE")) != NULL) {
+    scr_trace = atoi(value);
   }
 
-  /* check whether SCR logging DB is enabled */
-  if ((value = scr_param_get("SCR_LOG_TXT_ENABLE")) != NULL) {
-    scr_log_txt_enable = atoi(value);
+  /* whether to record a timeline of library phases */
+  if ((value = scr_param_get("SCR_TRACE_TIMELINE")) != NULL) {
+    scr_trace_timeline = atoi(value);
   }
 
-  /* check whether SCR logging DB is enabled */
-  if ((value = scr_param_get("SCR_LOG_SYSLOG_ENABLE")) != NULL) {
-    scr_log_syslog_enable = atoi(value);
+  /* whether to keep histograms of file operation latency, how many
+   * slow ranks to report, and how often to report them */
+  if ((value = scr_param_get("SCR_IOHIST")) != NULL) {
+    scr_iohist = atoi(value);
+  }
+  scr_io_copy_hook = scr_iohist ? scr_iohist_record_copy : NULL;
+  if ((value = scr_param_get("SCR_IOHIST_TOP")) != NULL) {
+    scr_iohist_top = atoi(value);
+  }
+  if ((value = scr_param_get("SCR_IOHIST_INTERVAL")) != NULL) {
+    scr_iohist_interval = atoi(value);
   }
 
-  /* check whether SCR logging DB is enabled */
-  if ((value = scr_param_get("SCR_LOG_DB_ENABLE")) != NULL) {
-    scr_log_db_enable = atoi(value);
+  /* whether to print a summary of SCR overhead at finalize */
+  if ((value = scr_param_get("SCR_REPORT")) != NULL) {
+    scr_report = atoi(value);
   }
 
-  /* read in the debug level for database log messages */
-  if ((value = scr_param_get("SCR_LOG_DB_DEBUG")) != NULL) {
-    scr_log_db_debug = atoi(value);
+  /* whether to reduce within nodes and then across node leaders */
+  if ((value = scr_param_get("SCR_COLL_HIER")) != NULL) {
+    scr_coll_hier = atoi(value);
+  }
+
+  /* whether to inject failures into cache before the rebuild,
+   * and which ranks to inject them into */
+  if ((value = scr_param_get("SCR_INJECT")) != NULL) {
+    int type = scr_inject_type_from_str(value);
+    if (type >= 0) {
+      scr_inject = type;
+    } else {
+      scr_err("Unknown value for SCR_INJECT: %s @ %s:%d",
+        value, __FILE__, __LINE__
+      );
+    }
+  }
+  if ((value = scr_param_get("SCR_INJECT_RANKS")) != NULL) {
+    scr_inject_ranks = strdup(value);
+  } else {
+    scr_inject_ranks = strdup(SCR_INJECT_RANKS);
+  }
+
+  /* set logging */
+  if ((value = scr_param_get("SCR_LOG_ENABLE")) != NULL) {
+    scr_log_enable = atoi(value);
+  }
+
+  /* check whether SCR logging DB is enabled */
+  if ((value = scr_param_get("SCR_LOG_TXT_ENABLE")) != NULL) {
+    scr_log_txt_enable = atoi(value);
+  }
+
+  /* check whether SCR logging DB is enabled */
+  if ((value = scr_param_get("SCR_LOG_SYSLOG_ENABLE")) != NULL) {
+    scr_log_syslog_enable = atoi(value);
+  }
+
+  /* check whether to log events as JSON records */
+  if ((value = scr_param_get("SCR_LOG_JSON_ENABLE")) != NULL) {
+    scr_log_json_enable = atoi(value);
+  }
+
+  /* check whether SCR logging DB is enabled */
+  if ((value = scr_param_get("SCR_LOG_DB_ENABLE")) != NULL) {
+    scr_log_db_enable = atoi(value);
+  }
+
+  /* read in the debug level for database log messages */
+  if ((value = scr_param_get("SCR_LOG_DB_DEBUG")) != NULL) {
+    scr_log_db_debug = atoi(value);
   }
 
   /* SCR log DB connection parameters */
@@ -657,6 +1193,14 @@ static int scr_get_params()
     scr_log_db_name = strdup(value);
   }
 
+  /* whether to write log records from a background thread, and how many to queue */
+  if ((value = scr_param_get("SCR_LOG_ASYNC")) != NULL) {
+    scr_log_async = atoi(value);
+  }
+  if ((value = scr_param_get("SCR_LOG_QUEUE_SIZE")) != NULL) {
+    scr_log_queue_size = atoi(value);
+  }
+
   /* read username from SCR_USER_NAME, if not set, try to read from environment */
   if ((value = scr_param_get("SCR_USER_NAME")) != NULL) {
     scr_username = strdup(value);
@@ -726,6 +1270,91 @@ static int scr_get_params()
     scr_cache_size = atoi(value);
   }
 
+  /* set number of changes to journal before rewriting the cache index */
+  if ((value = scr_param_get("SCR_CACHE_INDEX_JOURNAL")) != NULL) {
+    scr_cache_index_journal = atoi(value);
+  }
+
+  /* set maximum number of bytes of datasets to keep in each cache device */
+  if ((value = scr_param_get("SCR_CACHE_BYTES")) != NULL) {
+    if (scr_abtoull(value, &ull) == SCR_SUCCESS) {
+      scr_cache_bytes = (unsigned long) ull;
+    } else {
+      scr_err("Failed to read SCR_CACHE_BYTES successfully @ %s:%d",
+        __FILE__, __LINE__
+      );
+    }
+  }
+
+  /* set number of bytes to reserve on each cache device */
+  if ((value = scr_param_get("SCR_CACHE_ARENA")) != NULL) {
+    if (scr_abtoull(value, &ull) == SCR_SUCCESS) {
+      scr_cache_arena = (unsigned long) ull;
+    } else {
+      scr_err("Failed to read SCR_CACHE_ARENA successfully @ %s:%d",
+        __FILE__, __LINE__
+      );
+    }
+  }
+
+  /* set whether to evict datasets until the next output fits in free space */
+  if ((value = scr_param_get("SCR_CACHE_FIT")) != NULL) {
+    scr_cache_fit = atoi(value);
+  }
+
+  /* set number of bytes each process expects to write per output */
+  if ((value = scr_param_get("SCR_CACHE_EXPECT_BYTES")) != NULL) {
+    if (scr_abtoull(value, &ull) == SCR_SUCCESS) {
+      scr_cache_expect_bytes = (unsigned long) ull;
+    } else {
+      scr_err("Failed to read SCR_CACHE_EXPECT_BYTES successfully @ %s:%d",
+        __FILE__, __LINE__
+      );
+    }
+  }
+
+  /* set order in which to evict datasets from cache */
+  if ((value = scr_param_get("SCR_CACHE_EVICT")) != NULL) {
+    scr_cache_evict = strdup(value);
+  } else {
+    scr_cache_evict = strdup(SCR_CACHE_EVICT);
+  }
+  if (strcmp(scr_cache_evict, "OLDEST") != 0 &&
+      strcmp(scr_cache_evict, "FLUSHED") != 0 &&
+      strcmp(scr_cache_evict, "LARGEST") != 0)
+  {
+    if (scr_my_rank_world == 0) {
+      scr_err("Unknown SCR_CACHE_EVICT value `%s', evicting oldest datasets first @ %s:%d",
+        scr_cache_evict, __FILE__, __LINE__
+      );
+    }
+    scr_free(&scr_cache_evict);
+    scr_cache_evict = strdup("OLDEST");
+  }
+
+  /* set whether to keep identical blocks in cache only once */
+  if ((value = scr_param_get("SCR_CACHE_DEDUP")) != NULL) {
+    scr_cache_dedup = atoi(value);
+  }
+
+  /* set codec to keep files compressed with in cache */
+  if ((value = scr_param_get("SCR_CACHE_COMPRESS")) != NULL) {
+    scr_cache_compress = strdup(value);
+  } else {
+    scr_cache_compress = strdup(SCR_CACHE_COMPRESS);
+  }
+
+  /* set size of blocks to compare when deduplicating cache */
+  if ((value = scr_param_get("SCR_CACHE_DEDUP_BLOCK_SIZE")) != NULL) {
+    if (scr_abtoull(value, &ull) == SCR_SUCCESS && ull > 0) {
+      scr_cache_dedup_block_size = (unsigned long) ull;
+    } else {
+      scr_err("Failed to read SCR_CACHE_DEDUP_BLOCK_SIZE successfully @ %s:%d",
+        __FILE__, __LINE__
+      );
+    }
+  }
+
   /* fill in a hash of group descriptors */
   scr_groupdesc_hash = kvtree_new();
   tmp = (kvtree*) scr_param_get_hash(SCR_CONFIG_KEY_GROUPDESC);
@@ -784,6 +1413,16 @@ static int scr_get_params()
     scr_group = strdup(SCR_GROUP);
   }
 
+  /* specify the group name that each redundancy set stays within */
+  if ((value = scr_param_get("SCR_SET_GROUP")) != NULL) {
+    scr_set_group = strdup(value);
+  }
+
+  /* specify a file that lists the switch of each node */
+  if ((value = scr_param_get("SCR_TOPOLOGY_FILE")) != NULL) {
+    scr_topology_file = strdup(value);
+  }
+
   /* fill in a hash of redundancy descriptors */
   scr_reddesc_hash = kvtree_new();
   if (scr_copy_type == SCR_COPY_SINGLE) {
@@ -841,6 +1480,16 @@ static int scr_get_params()
     scr_halt_exit = atoi(value);
   }
 
+  /* determine whether rank 0 should decide Need_checkpoint and Should_exit ahead of time */
+  if ((value = scr_param_get("SCR_DECIDE_ASYNC")) != NULL) {
+    scr_decide_async = atoi(value);
+  }
+
+  /* determine whether to listen for failure events from PMIx */
+  if ((value = scr_param_get("SCR_PMIX_EVENTS")) != NULL) {
+    scr_pmix_events = atoi(value);
+  }
+
   /* set MPI buffer size (file chunk size) */
   if ((value = scr_param_get("SCR_MPI_BUF_SIZE")) != NULL) {
     if (scr_abtoull(value, &ull) == SCR_SUCCESS) {
@@ -864,6 +1513,16 @@ static int scr_get_params()
     scr_distribute = atoi(value);
   }
 
+  /* whether to move cached files between nodes for ranks that moved */
+  if ((value = scr_param_get("SCR_DISTRIBUTE_PEER")) != NULL) {
+    scr_distribute_peer = atoi(value);
+  }
+
+  /* whether to rebuild in place when spare nodes replace failed ones */
+  if ((value = scr_param_get("SCR_DISTRIBUTE_SPARE")) != NULL) {
+    scr_distribute_spare = atoi(value);
+  }
+
   /* whether to fetch files from the parallel file system */
   if ((value = scr_param_get("SCR_FETCH")) != NULL) {
     scr_fetch = atoi(value);
@@ -874,6 +1533,31 @@ static int scr_get_params()
     scr_fetch_width = atoi(value);
   }
 
+  /* fetch files when the application first routes them on restart */
+  if ((value = scr_param_get("SCR_FETCH_LAZY")) != NULL) {
+    scr_fetch_lazy = atoi(value);
+  }
+
+  /* whether files of a checkpoint start as copies of the previous checkpoint */
+  if ((value = scr_param_get("SCR_ROUTE_CLONE")) != NULL) {
+    scr_route_clone = atoi(value);
+  }
+
+  /* fetch files only for ranks that lost them when a rebuild fails */
+  if ((value = scr_param_get("SCR_FETCH_PARTIAL")) != NULL) {
+    scr_fetch_partial = atoi(value);
+  }
+
+  /* check the fallback checkpoint in the background during fetch */
+  if ((value = scr_param_get("SCR_FETCH_PREFETCH")) != NULL) {
+    scr_fetch_prefetch = atoi(value);
+  }
+
+  /* check several recent checkpoints up front before fetching */
+  if ((value = scr_param_get("SCR_FETCH_SCREEN")) != NULL) {
+    scr_fetch_screen = atoi(value);
+  }
+
   /* allow user to specify checkpoint to start with on fetch */
   if ((value = scr_param_get("SCR_CURRENT")) != NULL) {
     scr_fetch_current = strdup(value);
@@ -889,6 +1573,11 @@ static int scr_get_params()
     scr_flush_width = atoi(value);
   }
 
+  /* whether to adapt flush and fetch widths to observed bandwidth */
+  if ((value = scr_param_get("SCR_FLOW_ADAPT")) != NULL) {
+    scr_flow_adapt = atoi(value);
+  }
+
   /* specify flush transfer type */
   if ((value = scr_param_get("SCR_FLUSH_TYPE")) != NULL) {
     scr_flush_type = strdup(value);
@@ -896,6 +1585,81 @@ static int scr_get_params()
     scr_flush_type = strdup(SCR_FLUSH_TYPE);
   }
 
+  /* specify codec to compress files with during flush */
+  if ((value = scr_param_get("SCR_FLUSH_COMPRESS")) != NULL) {
+    scr_flush_compress = strdup(value);
+  } else {
+    scr_flush_compress = strdup(SCR_FLUSH_COMPRESS);
+  }
+
+  /* specify max number of delta flushes between full flushes */
+  if ((value = scr_param_get("SCR_FLUSH_DELTA")) != NULL) {
+    scr_flush_delta = atoi(value);
+  }
+
+  /* specify size of blocks to compare in delta flushes */
+  if ((value = scr_param_get("SCR_FLUSH_DELTA_BLOCK_SIZE")) != NULL) {
+    if (scr_abtoull(value, &ull) == SCR_SUCCESS && ull > 0) {
+      scr_flush_delta_block_size = (unsigned long) ull;
+    } else {
+      scr_err("Failed to read SCR_FLUSH_DELTA_BLOCK_SIZE successfully @ %s:%d",
+        __FILE__, __LINE__
+      );
+    }
+  }
+
+  /* link files that have not changed since the last flush rather than copy them */
+  if ((value = scr_param_get("SCR_FLUSH_INCREMENTAL")) != NULL) {
+    scr_flush_incremental = atoi(value);
+  }
+
+  /* copy completed files of output datasets to the prefix directory right away */
+  if ((value = scr_param_get("SCR_FLUSH_THROUGH")) != NULL) {
+    scr_flush_through = atoi(value);
+  }
+
+  /* pick stripe count of each flushed file from its size */
+  if ((value = scr_param_get("SCR_FLUSH_STRIPE_BYTES")) != NULL) {
+    if (scr_abtoull(value, &ull) == SCR_SUCCESS) {
+      scr_flush_stripe_bytes = (unsigned long) ull;
+    } else {
+      scr_err("Failed to read SCR_FLUSH_STRIPE_BYTES successfully @ %s:%d",
+        __FILE__, __LINE__
+      );
+    }
+  }
+
+  /* max number of stripes of a flushed file */
+  if ((value = scr_param_get("SCR_FLUSH_STRIPE_MAX")) != NULL) {
+    scr_flush_stripe_max = atoi(value);
+  }
+
+  /* stripe size of flushed files */
+  if ((value = scr_param_get("SCR_FLUSH_STRIPE_SIZE")) != NULL) {
+    if (scr_abtoull(value, &ull) == SCR_SUCCESS) {
+      scr_flush_stripe_size = (unsigned long) ull;
+    } else {
+      scr_err("Failed to read SCR_FLUSH_STRIPE_SIZE successfully @ %s:%d",
+        __FILE__, __LINE__
+      );
+    }
+  }
+
+  /* number of metadata targets to spread flushed directories over */
+  if ((value = scr_param_get("SCR_FLUSH_MDT_COUNT")) != NULL) {
+    scr_flush_mdt_count = atoi(value);
+  }
+
+  /* number of ranks in each shard of the binary rank2file map */
+  if ((value = scr_param_get("SCR_RANK2FILE_SHARD")) != NULL) {
+    scr_rank2file_shard_ranks = atoi(value);
+  }
+
+  /* pack files of each group into a single container file on flush */
+  if ((value = scr_param_get("SCR_FLUSH_CONTAINER")) != NULL) {
+    scr_flush_container = strdup(value);
+  }
+
   /* specify whether to always flush latest checkpoint from cache on restart */
   if ((value = scr_param_get("SCR_FLUSH_ON_RESTART")) != NULL) {
     scr_flush_on_restart = atoi(value);
@@ -928,6 +1692,16 @@ static int scr_get_params()
     scr_prefix_purge = atoi(value);
   }
 
+  /* whether to delete datasets from the prefix directory in the background */
+  if ((value = scr_param_get("SCR_PREFIX_DELETE_ASYNC")) != NULL) {
+    scr_prefix_delete_async = atoi(value);
+  }
+
+  /* number of threads on each node to delete files from the prefix directory */
+  if ((value = scr_param_get("SCR_PREFIX_DELETE_THREADS")) != NULL) {
+    scr_prefix_delete_threads = atoi(value);
+  }
+
   /* specify whether to use asynchronous flush */
   if ((value = scr_param_get("SCR_FLUSH_ASYNC")) != NULL) {
     scr_flush_async = atoi(value);
@@ -960,6 +1734,68 @@ static int scr_get_params()
     }
   }
 
+  /* max number of datasets to have in flight with async flush */
+  if ((value = scr_param_get("SCR_FLUSH_ASYNC_DEPTH")) != NULL) {
+    scr_flush_async_depth = atoi(value);
+  }
+
+  /* whether a new checkpoint flush cancels flushes of older checkpoints */
+  if ((value = scr_param_get("SCR_FLUSH_ASYNC_LATEST")) != NULL) {
+    scr_flush_async_latest = atoi(value);
+  }
+
+  /* whether one leader per store group runs AXL transfers for flush and fetch */
+  if ((value = scr_param_get("SCR_AXL_AGGREGATE")) != NULL) {
+    scr_axl_aggregate = atoi(value);
+  }
+
+  /* store to stage asynchronous flushes through on their way to the prefix directory */
+  if ((value = scr_param_get("SCR_DRAIN_STORE")) != NULL) {
+    scr_drain_store = strdup(value);
+  }
+
+  /* bandwidth limit on copying from cache to the drain store (in bytes/sec) */
+  if ((value = scr_param_get("SCR_DRAIN_BW")) != NULL) {
+    if (scr_abtoull(value, &ull) == SCR_SUCCESS) {
+      scr_drain_bw = (double) ull;
+    } else {
+      scr_err("Failed to read SCR_DRAIN_BW successfully @ %s:%d",
+        __FILE__, __LINE__
+      );
+    }
+  }
+
+  /* bandwidth limit on copying from the drain store to the prefix directory (in bytes/sec) */
+  if ((value = scr_param_get("SCR_DRAIN_FLUSH_BW")) != NULL) {
+    if (scr_abtoull(value, &ull) == SCR_SUCCESS) {
+      scr_drain_flush_bw = (double) ull;
+    } else {
+      scr_err("Failed to read SCR_DRAIN_FLUSH_BW successfully @ %s:%d",
+        __FILE__, __LINE__
+      );
+    }
+  }
+
+  /* whether to return from complete output while encoding continues */
+  if ((value = scr_param_get("SCR_ENCODE_ASYNC")) != NULL) {
+    scr_encode_async = atoi(value);
+  }
+
+  /* the asynchronous encode runs ER collectives on a helper thread
+   * while the application continues to call MPI */
+  if (scr_encode_async) {
+    int provided;
+    MPI_Query_thread(&provided);
+    if (provided < MPI_THREAD_MULTIPLE) {
+      if (scr_my_rank_world == 0) {
+        scr_warn("SCR_ENCODE_ASYNC requires MPI_THREAD_MULTIPLE, encoding synchronously @ %s:%d",
+          __FILE__, __LINE__
+        );
+      }
+      scr_encode_async = 0;
+    }
+  }
+
   /* set file copy buffer size (file chunk size) */
   if ((value = scr_param_get("SCR_FILE_BUF_SIZE")) != NULL) {
     if (scr_abtoull(value, &ull) == SCR_SUCCESS) {
@@ -976,6 +1812,21 @@ static int scr_get_params()
     }
   }
 
+  /* whether to measure buffer sizes for each store */
+  if ((value = scr_param_get("SCR_BUF_TUNE")) != NULL) {
+    scr_buf_tune = atoi(value);
+  }
+  if ((value = scr_param_get("SCR_BUF_TUNE_BYTES")) != NULL) {
+    if (scr_abtoull(value, &ull) == SCR_SUCCESS) {
+      scr_buf_tune_bytes = (unsigned long) ull;
+    }
+  }
+
+  /* number of reads and writes to keep in flight with io_uring */
+  if ((value = scr_param_get("SCR_IO_URING_DEPTH")) != NULL) {
+    scr_io_set_uring_depth(atoi(value));
+  }
+
   /* whether file metadata should also be copied */
   if ((value = scr_param_get("SCR_COPY_METADATA")) != NULL) {
     scr_copy_metadata = atoi(value);
@@ -1001,6 +1852,66 @@ static int scr_get_params()
     scr_crc_on_delete = atoi(value);
   }
 
+  /* whether to delete files from cache with a background thread */
+  if ((value = scr_param_get("SCR_CACHE_DELETE_ASYNC")) != NULL) {
+    scr_cache_delete_async = atoi(value);
+  }
+
+  /* whether to create directories of the next checkpoint in the background */
+  if ((value = scr_param_get("SCR_CACHE_PREPARE")) != NULL) {
+    scr_cache_prepare = atoi(value);
+  }
+
+  /* whether to write the filemap only when an output completes */
+  if ((value = scr_param_get("SCR_MAP_DEFER")) != NULL) {
+    scr_map_defer = atoi(value);
+  }
+
+  /* whether to check mtime of files before trusting their meta data */
+  if ((value = scr_param_get("SCR_FILE_REVALIDATE")) != NULL) {
+    scr_file_revalidate = atoi(value);
+  }
+
+  /* number of threads to look up files in cache */
+  if ((value = scr_param_get("SCR_STAT_THREADS")) != NULL) {
+    scr_stat_threads = atoi(value);
+  }
+
+  /* number of threads to compute crc32 of large files */
+  if ((value = scr_param_get("SCR_CRC_THREADS")) != NULL) {
+    scr_crc_threads = atoi(value);
+  }
+
+  /* NUMA placement of copy and checksum buffers */
+  if ((value = scr_param_get("SCR_NUMA")) != NULL) {
+    scr_numa = strdup(value);
+  } else {
+    scr_numa = strdup(SCR_NUMA);
+  }
+
+  /* minimum file size before computing crc32 with threads */
+  if ((value = scr_param_get("SCR_CRC_THREAD_MIN_SIZE")) != NULL) {
+    if (scr_abtoull(value, &ull) == SCR_SUCCESS) {
+      scr_crc_thread_min_size = (unsigned long) ull;
+    } else {
+      scr_err("Failed to read SCR_CRC_THREAD_MIN_SIZE successfully @ %s:%d",
+        __FILE__, __LINE__
+      );
+    }
+  }
+
+  /* select checksum algorithm to use for files that don't have one yet */
+  if ((value = scr_param_get("SCR_CHECKSUM")) != NULL) {
+    int type = scr_checksum_type_from_str(value);
+    if (type >= 0) {
+      scr_checksum_type = type;
+    } else {
+      scr_err("Unknown value for SCR_CHECKSUM: %s, using %s @ %s:%d",
+        value, scr_checksum_type_to_str(scr_checksum_type), __FILE__, __LINE__
+      );
+    }
+  }
+
   /* override default checkpoint interval
    * (number of times to call Need_checkpoint between checkpoints) */
   if ((value = scr_param_get("SCR_CHECKPOINT_INTERVAL")) != NULL) {
@@ -1023,6 +1934,42 @@ static int scr_get_params()
     }
   }
 
+  /* model to compute the optimal checkpoint interval */
+  if ((value = scr_param_get("SCR_CHECKPOINT_MODEL")) != NULL) {
+    if (scr_interval_model_from_str(value, &scr_checkpoint_model) != SCR_SUCCESS) {
+      scr_err("Unknown value %s for SCR_CHECKPOINT_MODEL @ %s:%d",
+        value, __FILE__, __LINE__
+      );
+    }
+  }
+
+  /* mean time between failures for the checkpoint model */
+  if ((value = scr_param_get("SCR_CHECKPOINT_MTBF")) != NULL) {
+    if (scr_atod(value, &d) == SCR_SUCCESS) {
+      scr_checkpoint_mtbf = d;
+    } else {
+      scr_err("Failed to read SCR_CHECKPOINT_MTBF successfully @ %s:%d",
+        __FILE__, __LINE__
+      );
+    }
+  }
+
+  /* mean time between failures that need the prefix directory */
+  if ((value = scr_param_get("SCR_CHECKPOINT_MTBF_PFS")) != NULL) {
+    if (scr_atod(value, &d) == SCR_SUCCESS) {
+      scr_checkpoint_mtbf_pfs = d;
+    } else {
+      scr_err("Failed to read SCR_CHECKPOINT_MTBF_PFS successfully @ %s:%d",
+        __FILE__, __LINE__
+      );
+    }
+  }
+
+  /* whether to pick redundancy descriptors with a cost model */
+  if ((value = scr_param_get("SCR_REDDESC_MODEL")) != NULL) {
+    scr_reddesc_model = atoi(value);
+  }
+
   /* TODO: allow someone to silence this if they are not using scripts? */
   /* check that user didn't set something different in $SCR_PREFIX or current working dir */
   value = getenv("SCR_PREFIX");
@@ -1050,28 +1997,144 @@ Common code for Start/Complete output/checkpoint
 =========================================
 */
 
-/* start phase for a new output dataset */
-static int scr_start_output(const char* name, int flags)
+/* returns key of dataset in the order of SCR_CACHE_EVICT,
+ * datasets with lower keys are evicted first */
+static double scr_evict_key(int id)
 {
-  /* bail out if user called Start_output twice without Complete_output in between */
-  if (scr_in_output) {
-    scr_abort(-1, "scr_complete_output must be called before scr_start_output is called again @ %s:%d",
-      __FILE__, __LINE__
-    );
-    return SCR_FAILURE;
+  if (strcmp(scr_cache_evict, "FLUSHED") == 0) {
+    /* datasets that already have a copy on the file system go first */
+    return (double) scr_flush_file_need_flush(id);
+  } else if (strcmp(scr_cache_evict, "LARGEST") == 0) {
+    /* use the total size from the index so that all procs agree */
+    unsigned long size = 0;
+    scr_dataset* dataset = scr_dataset_new();
+    scr_cache_index_get_dataset(scr_cindex, id, dataset);
+    scr_dataset_get_size(dataset, &size);
+    scr_dataset_delete(&dataset);
+    return - (double) size;
   }
+  return 0.0;
+}
 
-  /* set the output flag to indicate we have started a new output dataset */
-  scr_in_output = 1;
+/* order list of datasets by SCR_CACHE_EVICT, oldest first among equals */
+static void scr_evict_order(int ndsets, int* dsets)
+{
+  if (ndsets < 2 || strcmp(scr_cache_evict, "OLDEST") == 0) {
+    return;
+  }
 
-  /* make sure everyone is ready to start before we delete any existing checkpoints */
-  MPI_Barrier(scr_comm_world);
+  double* keys = (double*) SCR_MALLOC(ndsets * sizeof(double));
+  int i;
+  for (i = 0; i < ndsets; i++) {
+    keys[i] = scr_evict_key(dsets[i]);
+  }
+
+  /* insertion sort keeps the list stable, and it is short */
+  for (i = 1; i < ndsets; i++) {
+    double key = keys[i];
+    int id = dsets[i];
+    int j = i - 1;
+    while (j >= 0 && keys[j] > key) {
+      keys[j + 1] = keys[j];
+      dsets[j + 1] = dsets[j];
+      j--;
+    }
+    keys[j + 1] = key;
+    dsets[j + 1] = id;
+  }
 
-  /* determine whether this is a checkpoint */
-  int is_ckpt = (flags & SCR_FLAG_CHECKPOINT);
+  scr_free(&keys);
+}
 
-  /* if we have a checkpoint, stop clock recording compute time,
-   * we count normal output cost as part of compute time for
+/* returns number of bytes this process expects to write to cache
+ * in the next output in store, given list of datasets oldest first */
+static unsigned long scr_expect_bytes(int ndsets, const int* dsets, const char* base)
+{
+  if (scr_cache_expect_bytes > 0) {
+    return scr_cache_expect_bytes;
+  }
+
+  /* otherwise assume we write as much as we did for the most recent dataset */
+  int i;
+  for (i = ndsets - 1; i >= 0; i--) {
+    char* dataset_dir;
+    scr_cache_index_get_dir(scr_cindex, dsets[i], &dataset_dir);
+    int store_index = scr_storedescs_index_from_child_path(dataset_dir);
+    if (store_index >= 0 && strcmp(scr_storedescs[store_index].name, base) == 0) {
+      return scr_cache_get_bytes(scr_cindex, dsets[i]);
+    }
+  }
+  return 0;
+}
+
+/* returns 1 on all procs if each cache device of store has room
+ * for need more bytes from each proc, where each proc holds used bytes
+ * of datasets in the store and has deleted freed bytes that the free space
+ * of the device does not count yet, the arena in cache directory dir
+ * counts as free space */
+static int scr_cache_have_room(
+  const scr_storedesc* store,
+  const char* dir,
+  unsigned long used,
+  unsigned long freed,
+  unsigned long need)
+{
+  /* sum over procs that share the device */
+  unsigned long bytes[3] = {used, freed, need};
+  unsigned long sums[3];
+  MPI_Allreduce(bytes, sums, 3, MPI_UNSIGNED_LONG, MPI_SUM, store->comm);
+
+  int room = 1;
+  if (store->rank == 0) {
+    /* stay within the limit set for the store */
+    if (store->max_bytes > 0 && sums[0] + sums[2] > store->max_bytes) {
+      room = 0;
+    }
+
+    /* and within the space left on the device */
+    double avail;
+    if (scr_cache_fit && scr_storedesc_free_bytes(store, &avail) == SCR_SUCCESS) {
+      /* pages held by the arena are handed back before we write */
+      avail += (double) scr_arena_bytes(store, dir);
+      if (avail + (double) sums[1] < (double) sums[2]) {
+        room = 0;
+      }
+    }
+  }
+
+  return scr_alltrue(room, scr_comm_world);
+}
+
+/* start phase for a new output dataset */
+static int scr_start_output(const char* name, int flags)
+{
+  /* finish completing and encoding the previous dataset
+   * before we add a new one to cache */
+  scr_output_finish();
+
+  /* bail out if user called Start_output twice without Complete_output in between */
+  if (scr_in_output) {
+    scr_abort(-1, "scr_complete_output must be called before scr_start_output is called again @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* set the output flag to indicate we have started a new output dataset */
+  scr_in_output = 1;
+
+  /* make sure everyone is ready to start before we delete any existing checkpoints */
+  MPI_Barrier(scr_comm_world);
+
+  /* decisions that rank 0 sent ahead of time do not account for this
+   * output, so make the next calls decide again */
+  scr_decide_reset();
+
+  /* determine whether this is a checkpoint */
+  int is_ckpt = (flags & SCR_FLAG_CHECKPOINT);
+
+  /* if we have a checkpoint, stop clock recording compute time,
+   * we count normal output cost as part of compute time for
    * computing optimal checkpoint frequency */
   if (is_ckpt && scr_my_rank_world == 0) {
     /* stop the clock for measuring the compute time */
@@ -1119,6 +2182,10 @@ static int scr_start_output(const char* name, int flags)
   /* increment our dataset counter */
   scr_dataset_id++;
 
+  /* files of a checkpoint may start as clones of the previous checkpoint */
+  scr_filemap_delete(&scr_clone_map);
+  scr_clone_id = (is_ckpt && scr_route_clone) ? scr_ckpt_dset_id : 0;
+
   /* increment our checkpoint counters if needed */
   if (is_ckpt) {
     scr_checkpoint_id++;
@@ -1189,10 +2256,31 @@ static int scr_start_output(const char* name, int flags)
 
   /* get the redundancy descriptor for this dataset */
   scr_rd = scr_get_reddesc(dataset, scr_nreddescs, scr_reddescs);
+  scr_rd = scr_model_reddesc(dataset, scr_rd);
+
+  /* output datasets are always flushed, so their files can be written
+   * through to the prefix directory as the application completes them,
+   * unless they are written there directly, must be compressed, or the
+   * flush packs them into a container or lays them out itself, in which
+   * case they would land somewhere other than where the flush puts them */
+  scr_through = 0;
+  if (scr_flush_through && (flags & SCR_FLAG_OUTPUT) && ! scr_rd->bypass &&
+      scr_flush_container == NULL)
+  {
+    int index = scr_storedescs_index_from_name(scr_rd->base);
+    if (index >= 0 &&
+        scr_storedescs[index].compress       == SCR_COMPRESS_NONE &&
+        scr_storedescs[index].cache_compress == SCR_COMPRESS_NONE &&
+        scr_storedescs[index].stripe_bytes   == 0)
+    {
+      scr_through = 1;
+    }
+  }
 
-  /* start the clock to record how long it takes to write output */
+  /* start the clock to record how long it takes to write output,
+   * every rank records its own time for SCR_Get_stats */
+  scr_time_output_start = MPI_Wtime();
   if (scr_my_rank_world == 0) {
-    scr_time_output_start = MPI_Wtime();
     if (is_ckpt) {
       scr_time_checkpoint_start = scr_time_output_start;
     }
@@ -1242,9 +2330,42 @@ static int scr_start_output(const char* name, int flags)
     }
   }
 
+  /* when the store limits bytes or we must fit in free space, track how many
+   * bytes we hold in the base and how many we expect to write */
+  int room = 1;
+  unsigned long used = 0;
+  unsigned long freed = 0;
+  unsigned long need = 0;
+  int by_bytes = (store_index >= 0 &&
+    (scr_storedescs[store_index].max_bytes > 0 || scr_cache_fit ||
+     scr_storedescs[store_index].arena_bytes > 0)
+  );
+  if (by_bytes) {
+    /* the free space should count files of datasets we deleted earlier */
+    if (scr_cache_fit) {
+      scr_reclaim_wait();
+    }
+
+    for (i=0; i < ndsets; i++) {
+      char* dataset_dir;
+      scr_cache_index_get_dir(scr_cindex, dsets[i], &dataset_dir);
+      int index = scr_storedescs_index_from_child_path(dataset_dir);
+      if (index == store_index) {
+        used += scr_cache_get_bytes(scr_cindex, dsets[i]);
+      }
+    }
+    if (! scr_rd->bypass) {
+      need = scr_expect_bytes(ndsets, dsets, scr_rd->base);
+    }
+    room = scr_cache_have_room(&scr_storedescs[store_index], scr_rd->directory, used, freed, need);
+  }
+
+  /* pick the order in which to evict datasets */
+  scr_evict_order(ndsets, dsets);
+
   /* run through and delete datasets from base until we make room for the current one */
   int flushing = -1;
-  for (i=0; i < ndsets && nckpts_base >= size; i++) {
+  for (i=0; i < ndsets && (nckpts_base >= size || ! room); i++) {
     char* dataset_dir;
     scr_cache_index_get_dir(scr_cindex, dsets[i], &dataset_dir);
     int store_index = scr_storedescs_index_from_child_path(dataset_dir);
@@ -1255,8 +2376,15 @@ static int scr_start_output(const char* name, int flags)
         if (strcmp(base, scr_rd->base) == 0) {
           if (! scr_flush_file_is_flushing(dsets[i])) {
             /* this dataset is in our base, and it's not being flushed, so delete it */
+            unsigned long bytes = by_bytes ? scr_cache_get_bytes(scr_cindex, dsets[i]) : 0;
             scr_cache_delete(scr_cindex, dsets[i]);
+            scr_stats_add(SCR_STATS_EV_EVICT, 1.0);
             nckpts_base--;
+            if (by_bytes) {
+              used  -= bytes;
+              freed += bytes;
+              room = scr_cache_have_room(sd, scr_rd->directory, used, freed, need);
+            }
           } else if (flushing == -1) {
             /* this dataset is in our base, but we're flushing it, don't delete it */
             flushing = dsets[i];
@@ -1268,20 +2396,40 @@ static int scr_start_output(const char* name, int flags)
 
   /* if we still don't have room and we're flushing, the dataset we need to delete
    * must be flushing, so wait for it to finish */
-  if (nckpts_base >= size && flushing != -1) {
+  if ((nckpts_base >= size || ! room) && flushing != -1) {
     /* TODO: we could increase the transfer bandwidth to reduce our wait time */
 
     /* wait for this dataset to complete its flush */
-    int flush_rc = scr_flush_async_wait(scr_cindex);
+    int flush_rc = scr_flush_async_wait_id(scr_cindex, flushing);
     if (flush_rc != SCR_SUCCESS) {
       scr_abort(-1, "Flush of dataset %d failed @ %s:%d",
-        scr_flush_async_dataset_id, __FILE__, __LINE__
+        flushing, __FILE__, __LINE__
       );
     }
 
     /* now dataset is no longer flushing, we can delete it and continue on */
+    unsigned long bytes = by_bytes ? scr_cache_get_bytes(scr_cindex, flushing) : 0;
     scr_cache_delete(scr_cindex, flushing);
+    scr_stats_add(SCR_STATS_EV_EVICT, 1.0);
     nckpts_base--;
+    if (by_bytes) {
+      used  -= bytes;
+      freed += bytes;
+      room = scr_cache_have_room(&scr_storedescs[store_index], scr_rd->directory, used, freed, need);
+    }
+  }
+
+  /* give the new dataset its share of the reserve, and take back
+   * what datasets we deleted held */
+  if (by_bytes && ! scr_rd->bypass) {
+    scr_arena_fit(&scr_storedescs[store_index], scr_rd->directory, used, need);
+  }
+
+  /* we have deleted all we can, the output may still fail to fit */
+  if (! room && scr_my_rank_world == 0) {
+    scr_warn("Cache %s may not have room for dataset %d @ %s:%d",
+      scr_rd->base, scr_dataset_id, __FILE__, __LINE__
+    );
   }
 
   /* free the list of datasets */
@@ -1293,17 +2441,30 @@ static int scr_start_output(const char* name, int flags)
   /* store the name of the directory we're about to create */
   const char* dir = scr_cache_dir_get(scr_rd, scr_dataset_id);
   scr_cache_index_set_dir(scr_cindex, scr_dataset_id, dir);
+
+  /* cache the directory for routing files, bypass routes to prefix instead */
+  scr_route_set_dir(scr_dataset_id, scr_rd->bypass ? NULL : dir);
   scr_free(&dir);
 
   /* mark whether dataset should bypass cache */
   scr_cache_index_set_bypass(scr_cindex, scr_dataset_id, scr_rd->bypass);
 
+  /* if we only write the filemap when the output completes, record that
+   * before any file is created, so that deleting the dataset after a
+   * failure also removes files the filemap on disk does not list */
+  scr_cache_index_set_map_deferred(scr_cindex, scr_dataset_id, scr_map_defer);
+
   /* save cache index to disk before creating directory, so we have a record of it */
   scr_cache_index_write(scr_cindex_file, scr_cindex);
 
   /* make directory in cache to store files for this dataset */
   scr_cache_dir_create(scr_rd, scr_dataset_id);
 
+  /* spread files over the other stores of the descriptor, if any */
+  if (! scr_rd->bypass) {
+    scr_route_set_stripes(scr_rd, scr_dataset_id);
+  }
+
   /* since bypass will start writing files to prefix directory immediately,
    * go ahead and create the initial entry in the index file */
   if (scr_rd->bypass) {
@@ -1412,7 +2573,7 @@ static int scr_assign_ownership(scr_filemap* map, int bypass)
 
   /* fatal error if any file is on more than one rank and not in bypass */
   int any_multiple_owner = 0;
-  MPI_Allreduce(&multiple_owner, &any_multiple_owner, 1, MPI_INT, MPI_LOR, scr_comm_world);
+  scr_allreduce(&multiple_owner, &any_multiple_owner, 1, MPI_INT, MPI_LOR, scr_comm_world);
   if (any_multiple_owner && !bypass) {
     scr_abort(-1, "Shared file access detected while not in bypass mode @ %s:%d",
       __FILE__, __LINE__
@@ -1436,8 +2597,31 @@ static int scr_assign_ownership(scr_filemap* map, int bypass)
   return rc;
 }
 
+/* return newly allocated path the flush copies a file with the given
+ * meta data to, or NULL if it is not known */
+static char* scr_route_file_dest(const scr_meta* meta)
+{
+  char* origpath;
+  char* origname;
+  if (scr_meta_get_origpath(meta, &origpath) != SCR_SUCCESS ||
+      scr_meta_get_origname(meta, &origname) != SCR_SUCCESS)
+  {
+    return NULL;
+  }
+
+  /* build the path the same way the flush does */
+  spath* dest_path = spath_from_str(origpath);
+  spath_append_str(dest_path, origname);
+  char* dest = spath_strdup(dest_path);
+  spath_delete(&dest_path);
+  return dest;
+}
+
 /* end phase for current output dataset */
-static int scr_complete_output(int valid)
+/* start completing the current output, this assigns file ownership, records
+ * file metadata, and starts a nonblocking allreduce of the file counts,
+ * the output is finished in scr_complete_output_finish */
+static int scr_complete_output_start(int valid)
 {
   /* bail out if there is no active call to Start_output */
   if (! scr_in_output) {
@@ -1462,7 +2646,29 @@ static int scr_complete_output(int valid)
    * as written by this process */
   int files_valid = valid;
   unsigned long my_counts[3] = {0, 0, 0};
+
+  /* files passed to SCR_Complete_file were checked as they were closed */
+  scr_stream_wait();
+
+  /* look up all other files at once, rather than one after another */
   kvtree_elem* elem;
+  int nstat = 0;
+  const char** stat_files = (const char**) SCR_MALLOC((scr_filemap_num_files(scr_map) + 1) * sizeof(char*));
+  for (elem = scr_filemap_first_file(scr_map);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    const char* file = kvtree_elem_key(elem);
+    struct stat stat_buf;
+    int type;
+    uint64_t value;
+    if (scr_stream_get(file, &stat_buf, &type, &value) != SCR_SUCCESS) {
+      stat_files[nstat++] = file;
+    }
+  }
+  scr_statx_stat_files(nstat, stat_files);
+  scr_free(&stat_files);
+
   for (elem = scr_filemap_first_file(scr_map);
        elem != NULL;
        elem = kvtree_elem_next(elem))
@@ -1474,19 +2680,33 @@ static int scr_complete_output(int valid)
     /* start with valid flag from caller for this file */
     int file_valid = valid;
 
-    /* check that we can read the file */
-    if (scr_file_is_readable(file) != SCR_SUCCESS) {
-      scr_dbg(2, "Do not have read access to file: %s @ %s:%d",
-        file, __FILE__, __LINE__
-      );
-      file_valid  = 0;
-      files_valid = 0;
+    /* use what we found when the file was closed, if anything */
+    struct stat stat_buf;
+    int stat_rc = 0;
+    int type;
+    uint64_t value;
+    if (scr_stream_get(file, &stat_buf, &type, &value) != SCR_SUCCESS) {
+      /* check that we can read the file, using the lookup above if we have it */
+      type = -1;
+      int have_stat;
+      int readable = scr_statx_get_stat(file, &stat_buf, &have_stat);
+      if (readable < 0) {
+        readable  = (scr_file_is_readable(file) == SCR_SUCCESS);
+        have_stat = (stat(file, &stat_buf) == 0);
+      }
+      if (! readable) {
+        scr_dbg(2, "Do not have read access to file: %s @ %s:%d",
+          file, __FILE__, __LINE__
+        );
+        file_valid  = 0;
+        files_valid = 0;
+      }
+
+      /* the size and other metadata of the file */
+      stat_rc = have_stat ? 0 : -1;
     }
 
-    /* stat the file to get its size and other metadata */
     unsigned long filesize = 0;
-    struct stat stat_buf;
-    int stat_rc = stat(file, &stat_buf);
     if (stat_rc == 0) {
       filesize = (unsigned long) stat_buf.st_size;
     }
@@ -1505,9 +2725,29 @@ static int scr_complete_output(int valid)
     if (stat_rc == 0) {
       scr_meta_set_stat(meta, &stat_buf);
     }
+    if (type >= 0) {
+      scr_meta_set_checksum(meta, type, value);
+    }
+
+    /* note files the flush does not need to copy again */
+    if (scr_through) {
+      char* dest = scr_route_file_dest(meta);
+      if (dest != NULL && scr_stream_through(file, dest)) {
+        kvtree_util_set_str(meta, SCR_META_KEY_THROUGH, dest);
+      }
+      scr_free(&dest);
+    }
     scr_filemap_set_meta(scr_map, file, meta);
     scr_meta_delete(&meta);
+
+    /* encode and flush can trust what we just found */
+    if (stat_rc == 0 && file_valid) {
+      scr_cache_known_set(file, filesize);
+    } else {
+      scr_cache_known_unset(file);
+    }
   }
+  scr_statx_clear();
 
   /* we execute a sum as a logical allreduce to determine whether everyone is valid
    * we interpret the result to be true only if the sum adds up to the number of processes */
@@ -1515,20 +2755,54 @@ static int scr_complete_output(int valid)
     my_counts[2] = 1;
   }
 
-  /* execute allreduce to total up number of files, bytes, and number of valid ranks */
-  unsigned long total_counts[3];
-  MPI_Allreduce(my_counts, total_counts, 3, MPI_UNSIGNED_LONG, MPI_SUM, scr_comm_world);
-  unsigned long total_files = total_counts[0];
-  unsigned long total_bytes = total_counts[1];
-  unsigned long total_valid = total_counts[2];
+  /* the application has finished writing, record what this process wrote */
+  double write_secs = MPI_Wtime() - scr_time_output_start;
+  scr_stats_record(SCR_STATS_WRITE, (double) my_counts[1], write_secs);
+  if (scr_rd->bypass) {
+    scr_stats_add(SCR_STATS_EV_BYPASS, (double) my_counts[1]);
+  }
+  scr_iohist_record(SCR_IOHIST_WRITE, (double) my_counts[1], write_secs);
+
+  /* start allreduce to total up number of files, bytes, and number of valid ranks */
+  memcpy(scr_output_my_counts, my_counts, sizeof(my_counts));
+  MPI_Iallreduce(scr_output_my_counts, scr_output_total_counts, 3,
+    MPI_UNSIGNED_LONG, MPI_SUM, scr_comm_world, &scr_output_mpi_req
+  );
+
+  /* mark that we have a complete output outstanding */
+  scr_output_pending = 1;
+  scr_output_rc      = rc;
+  scr_output_req_id  = scr_dataset_id;
+
+  /* unset the output flag to indicate the application has
+   * exited the current output phase */
+  scr_in_output = 0;
+
+  return SCR_SUCCESS;
+}
+
+/* finish the current output once the allreduce started in
+ * scr_complete_output_start has completed, this records the dataset
+ * in the cache index, applies the redundancy scheme, and checks
+ * whether we need to flush or halt */
+static int scr_complete_output_finish(void)
+{
+  int rc = scr_output_rc;
+
+  /* the output is no longer outstanding */
+  scr_output_pending = 0;
+
+  /* get the totals from the allreduce */
+  unsigned long total_files = scr_output_total_counts[0];
+  unsigned long total_bytes = scr_output_total_counts[1];
+  unsigned long total_valid = scr_output_total_counts[2];
 
   /* get dataset from filemap */
   scr_dataset* dataset = scr_dataset_new();
   scr_cache_index_get_dataset(scr_cindex, scr_dataset_id, dataset);
 
   /* get flags for this dataset */
-  int is_ckpt   = scr_dataset_is_ckpt(dataset);
-  int is_output = scr_dataset_is_output(dataset);
+  int is_ckpt = scr_dataset_is_ckpt(dataset);
 
   /* store total number of files, total number of bytes, and complete flag in dataset */
   scr_dataset_set_files(dataset, (int) total_files);
@@ -1544,8 +2818,11 @@ static int scr_complete_output(int valid)
   }
   scr_cache_index_set_dataset(scr_cindex, scr_dataset_id, dataset);
 
-  /* write out info to filemap */
+  /* write out info to filemap, this also covers files routed with
+   * SCR_MAP_DEFER, the write is synced before the cache index can
+   * record that the filemap lists every file */
   scr_cache_set_map(scr_cindex, scr_dataset_id, scr_map);
+  scr_cache_index_set_map_deferred(scr_cindex, scr_dataset_id, 0);
 
   /* record the cost of the output before copy */
   int files    = (int) total_files;
@@ -1569,17 +2846,34 @@ static int scr_complete_output(int valid)
       scr_dataset_get_name(dataset, &dset_name);
       char* dir = scr_cache_dir_get(scr_rd, scr_dataset_id);
       scr_log_transfer("WRITE", scr_rd->base, dir, &scr_dataset_id, dset_name,
-        &scr_timestamp_output_start, &time_diff, &bytes, &files
+        &scr_timestamp_output_start, &time_diff, &bytes, NULL, &files
       );
       scr_free(&dir);
     }
   }
 
-  /* apply redundancy scheme if we're still valid */
+  /* apply redundancy scheme if we're still valid,
+   * when encoding asynchronously we return once it has been dispatched */
+  int encoding = 0;
   if (rc == SCR_SUCCESS) {
-    rc = scr_reddesc_apply(scr_map, scr_rd, scr_dataset_id);
+    if (scr_encode_async) {
+      scr_trace_mark_begin("encode_start");
+      rc = scr_reddesc_apply_start(scr_map, scr_rd, scr_dataset_id);
+      scr_trace_mark_end("encode_start");
+      encoding = scr_encode_async_in_progress;
+    } else {
+      rc = scr_reddesc_apply(scr_map, scr_rd, scr_dataset_id);
+    }
   }
 
+  /* the checks of closed files have served their purpose */
+  scr_stream_clear();
+
+  /* remove directories of datasets deleted while this output was written */
+  scr_reclaim_dirs();
+
+  scr_stats_add(SCR_STATS_EV_OUTPUT, MPI_Wtime() - scr_time_output_start);
+
   /* record the cost of the output and log its completion */
   if (scr_my_rank_world == 0) {
     /* stop the clock for this output */
@@ -1612,12 +2906,12 @@ static int scr_complete_output(int valid)
       if (is_ckpt) {
         scr_log_event("CHECKPOINT_END", scr_rd->base, &scr_dataset_id, dset_name, NULL, &time_diff);
         scr_log_transfer("CHECKPOINT", scr_rd->base, dir, &scr_dataset_id, dset_name,
-          &scr_timestamp_output_start, &time_diff, &bytes, &files
+          &scr_timestamp_output_start, &time_diff, &bytes, NULL, &files
         );
       } else {
         scr_log_event("OUTPUT_END", scr_rd->base, &scr_dataset_id, dset_name, NULL, &time_diff);
         scr_log_transfer("OUTPUT", scr_rd->base, dir, &scr_dataset_id, dset_name,
-          &scr_timestamp_output_start, &time_diff, &bytes, &files
+          &scr_timestamp_output_start, &time_diff, &bytes, NULL, &files
         );
       }
       scr_free(&dir);
@@ -1629,56 +2923,56 @@ static int scr_complete_output(int valid)
     );
   }
 
-  /* if copy is good, check whether we need to flush or halt,
-   * otherwise delete the checkpoint to conserve space */
-  if (rc == SCR_SUCCESS) {
-    /* record entry in flush file for this dataset */
-    char* dset_name;
-    scr_dataset_get_name(dataset, &dset_name);
-    scr_flush_file_new_entry(scr_dataset_id, dset_name, dataset, SCR_FLUSH_KEY_LOCATION_CACHE, is_ckpt, is_output);
-
-    /* go ahead and flush any bypass dataset since
-     * it's just a bit more work to finish at this point */
-    if (scr_rd->bypass) {
-      int flush_rc = scr_flush_sync(scr_cindex, scr_dataset_id);
-      if (flush_rc != SCR_SUCCESS) {
-        scr_abort(-1, "Flush of dataset %d failed @ %s:%d",
-          scr_dataset_id, __FILE__, __LINE__
-        );
-      }
-    }
-
-    /* check_flush may start an async flush, whereas check_halt will call sync flush,
-     * so place check_flush after check_halt */
+  /* if the encode is still running, we finish the dataset when it completes */
+  if (encoding) {
+    /* count this checkpoint in the halt file now so SCR_Should_exit
+     * sees it, we'll check whether to halt once the encode finishes */
     if (is_ckpt) {
-      /* only halt on checkpoints */
-      scr_bool_check_halt_and_decrement(SCR_TEST_AND_HALT, 1);
+      scr_bool_check_halt_and_decrement(SCR_TEST_BUT_DONT_HALT, 1);
     }
-    scr_check_flush(scr_cindex);
   } else {
-    /* something went wrong, so delete this checkpoint from the cache */
-    scr_cache_delete(scr_cindex, scr_dataset_id);
-
-    /* TODODSET: probably should return error or abort if this is output */
+    scr_complete_encode(scr_dataset_id, rc, 1);
   }
 
-  /* if we have an async flush ongoing, take this chance to check whether it's completed */
-  if (scr_flush_async_in_progress) {
+  /* if we have async flushes ongoing, take this chance to complete
+   * any that have finished, they complete oldest first */
+  while (scr_flush_async_in_progress) {
     /* got an outstanding async flush, let's check it */
-    if (scr_flush_async_test(scr_cindex, scr_flush_async_dataset_id) == SCR_SUCCESS) {
+    int flush_id = scr_flush_async_dataset_id;
+    if (scr_flush_async_test(scr_cindex, flush_id) == SCR_SUCCESS) {
       /* async flush has finished, go ahead and complete it */
-      int flush_rc = scr_flush_async_complete(scr_cindex, scr_flush_async_dataset_id);
+      int flush_rc = scr_flush_async_complete(scr_cindex, flush_id);
       if (flush_rc != SCR_SUCCESS) {
         scr_abort(-1, "Flush of dataset %d failed @ %s:%d",
-          scr_flush_async_dataset_id, __FILE__, __LINE__
+          flush_id, __FILE__, __LINE__
         );
       }
     } else {
       /* not done yet, just print a progress message to the screen */
       if (scr_my_rank_world == 0) {
-        scr_dbg(1, "Flush of dataset %d is ongoing", scr_flush_async_dataset_id);
+        scr_dbg(1, "Flush of dataset %d is ongoing", flush_id);
       }
+      break;
+    }
+  }
+
+  /* flush this checkpoint if a failure is reported before the next */
+  if (is_ckpt && rc == SCR_SUCCESS) {
+    scr_pmix_event_checkpoint(scr_cindex);
+  }
+
+  /* get the directories of the next checkpoint ready while the
+   * application computes, assuming its id picks its descriptor */
+  if (is_ckpt && scr_cache_prepare) {
+    scr_dataset* next = scr_dataset_new();
+    scr_dataset_set_id(next, scr_dataset_id + 1);
+    scr_dataset_set_flags(next, SCR_FLAG_CHECKPOINT);
+    scr_dataset_set_ckpt(next, scr_checkpoint_id + 1);
+    scr_reddesc* next_rd = scr_get_reddesc(next, scr_nreddescs, scr_reddescs);
+    if (next_rd != NULL && ! next_rd->bypass) {
+      scr_cache_dir_prepare(next_rd, scr_dataset_id + 1);
     }
+    scr_dataset_delete(&next);
   }
 
   /* done with dataset */
@@ -1693,9 +2987,6 @@ static int scr_complete_output(int valid)
   /* make sure everyone is ready before we exit */
   MPI_Barrier(scr_comm_world);
 
-  /* unset the output flag to indicate we have exited the current output phase */
-  scr_in_output = 0;
-
   /* start the clock for measuring the compute time,
    * we count output time as compute time for non-checkpoint datasets */
   if (is_ckpt && scr_my_rank_world == 0) {
@@ -1710,6 +3001,78 @@ static int scr_complete_output(int valid)
   return rc;
 }
 
+/* wait for the outstanding complete output and finish it */
+static int scr_complete_output_wait(void)
+{
+  /* return the result of the last output if it has been finished */
+  if (! scr_output_pending) {
+    return scr_output_rc;
+  }
+
+  MPI_Wait(&scr_output_mpi_req, MPI_STATUS_IGNORE);
+  scr_output_rc = scr_complete_output_finish();
+  return scr_output_rc;
+}
+
+/* finish the outstanding complete output if its allreduce has completed
+ * on all processes, sets flag to 1 if there is no output outstanding */
+static int scr_complete_output_test(int* flag)
+{
+  *flag = 1;
+  if (! scr_output_pending) {
+    return SCR_SUCCESS;
+  }
+
+  /* proceed only if everyone has their counts, so that all procs
+   * execute the collectives in finish together */
+  int done = 0;
+  MPI_Test(&scr_output_mpi_req, &done, MPI_STATUS_IGNORE);
+  if (! scr_alltrue(done, scr_comm_world)) {
+    *flag = 0;
+    return SCR_SUCCESS;
+  }
+
+  scr_output_rc = scr_complete_output_finish();
+  return SCR_SUCCESS;
+}
+
+/* complete the current output */
+static int scr_complete_output(int valid)
+{
+  scr_trace_mark_begin("complete");
+  int rc = scr_complete_output_start(valid);
+  if (rc == SCR_SUCCESS) {
+    rc = scr_complete_output_wait();
+  }
+  scr_trace_mark_end("complete");
+
+  /* report file operation latency every so many outputs */
+  scr_outputs_completed++;
+  if (scr_iohist_interval > 0 && scr_outputs_completed % scr_iohist_interval == 0) {
+    scr_iohist_report(scr_comm_world);
+  }
+
+  return rc;
+}
+
+/* wait for any outstanding complete output and async encode to finish */
+static int scr_output_finish(void)
+{
+  scr_complete_output_wait();
+  return scr_encode_async_finish();
+}
+
+/* make progress on any outstanding complete output and async encode */
+static int scr_output_progress(void)
+{
+  int flag;
+  scr_complete_output_test(&flag);
+  if (flag) {
+    scr_encode_async_progress();
+  }
+  return SCR_SUCCESS;
+}
+
 /*
 =========================================
 User interface functions
@@ -1727,6 +3090,10 @@ int SCR_Init()
     );
   }
   scr_state = SCR_STATE_IDLE;
+  scr_time_init_start = MPI_Wtime();
+
+  /* time each phase of init to report where startup time goes */
+  scr_trace_begin("init");
 
   /* check whether user has disabled library via environment variable */
   char* value = NULL;
@@ -1794,7 +3161,9 @@ int SCR_Init()
   }
 
   /* read our configuration: environment variables, config file, etc. */
+  scr_trace_begin("params");
   scr_get_params();
+  scr_trace_end();
 
   /* if not enabled, bail with an error */
   if (! scr_enabled) {
@@ -1831,6 +3200,9 @@ int SCR_Init()
     return SCR_FAILURE;
   }
 
+  /* start the timeline of library phases if requested */
+  scr_trace_timeline_init(scr_comm_world);
+
   /* coonfigure used libraries */
   {
     kvtree* axl_config = kvtree_new();
@@ -1916,6 +3288,7 @@ int SCR_Init()
   }
 
   /* setup group descriptors */
+  scr_trace_begin("descriptors");
   if (scr_groupdescs_create(scr_comm_world) != SCR_SUCCESS) {
     if (scr_my_rank_world == 0) {
       scr_err("Failed to prepare one or more group descriptors @ %s:%d",
@@ -1933,6 +3306,9 @@ int SCR_Init()
     }
   }
 
+  /* look up the store to stage asynchronous flushes through */
+  scr_drain_init();
+
   /* setup redundancy descriptors (refers to store descriptors) */
   if (scr_reddescs_create() != SCR_SUCCESS) {
     if (scr_my_rank_world == 0) {
@@ -1941,6 +3317,8 @@ int SCR_Init()
       );
     }
   }
+  scr_trace_end();
+  scr_trace_begin("directories");
 
   /* check that we have an enabled redundancy descriptor with
    * interval of one, this is necessary so a reddesc is defined
@@ -1975,6 +3353,13 @@ int SCR_Init()
   /* get our local rank within our node */
   MPI_Comm_rank(scr_comm_node, &scr_my_rank_host);
 
+  /* build a communicator of one process per node, we only need it
+   * to reduce in two steps, and every process has the same setting */
+  if (scr_coll_hier) {
+    int color = (scr_my_rank_host == 0) ? 0 : MPI_UNDEFINED;
+    MPI_Comm_split(scr_comm_world, color, scr_my_rank_world, &scr_comm_node_leaders);
+  }
+
   /* num_nodes will be used later, this line is moved above cache_dir creation
    * to make sure scr_my_hostid is set before we try to create directories.
    * The logic that uses num_nodes can't be moved here because it relies on the
@@ -1998,9 +3383,37 @@ int SCR_Init()
     if (scr_log_syslog_enable) {
       scr_log_init_syslog();
     }
+    if (scr_log_json_enable) {
+      scr_log_init_json(scr_prefix);
+    }
     if (scr_log_db_enable) {
       scr_log_init_db(scr_log_db_debug, scr_log_db_host, scr_log_db_user, scr_log_db_pass, scr_log_db_name);
     }
+    if (scr_log_async) {
+      scr_log_init_async(scr_log_queue_size);
+    }
+  }
+
+  /* estimate failure rates from the log of earlier runs
+   * if the checkpoint model or the descriptor model needs them */
+  if (scr_my_rank_world == 0 &&
+      (scr_checkpoint_model != SCR_INTERVAL_NONE || scr_reddesc_model) &&
+      (scr_checkpoint_mtbf <= 0.0 || scr_checkpoint_mtbf_pfs <= 0.0))
+  {
+    char logname[SCR_MAX_FILENAME];
+    snprintf(logname, sizeof(logname), "%s/.scr/log", scr_prefix);
+    double mtbf, mtbf_pfs;
+    if (scr_interval_read_log(logname, &mtbf, &mtbf_pfs) == SCR_SUCCESS) {
+      if (scr_checkpoint_mtbf <= 0.0) {
+        scr_checkpoint_mtbf = mtbf;
+      }
+      if (scr_checkpoint_mtbf_pfs <= 0.0) {
+        scr_checkpoint_mtbf_pfs = mtbf_pfs;
+      }
+    }
+    scr_dbg(1, "Checkpoint model using MTBF %f secs, PFS MTBF %f secs",
+      scr_checkpoint_mtbf, scr_checkpoint_mtbf_pfs
+    );
   }
 
   /* register this job in the logging database */
@@ -2062,6 +3475,10 @@ int SCR_Init()
           );
         }
 
+        /* pick buffer sizes for the store the first time we use it,
+         * the arena claims the device only after rebuild and fetch */
+        scr_tune_store(store, reddesc->directory);
+
         /* set up artificially node-local directories if the store view is global */
         if (! strcmp(store->view, "GLOBAL")) {
           /* make sure we can create directories */
@@ -2084,6 +3501,19 @@ int SCR_Init()
             scr_free(&path_str);
           }
         }
+
+        /* create the job directory on each store we stripe files across,
+         * and measure its bandwidth to weight how many files it gets */
+        int j;
+        for (j = 0; j < reddesc->stripe_count; j++) {
+          scr_storedesc* stripe = scr_reddesc_get_stripe_store(reddesc, j);
+          if (scr_storedesc_dir_create(stripe, reddesc->stripe_dirs[j]) != SCR_SUCCESS) {
+            scr_abort(-1, "Failed to create cache directory: %s @ %s:%d",
+              reddesc->stripe_dirs[j], __FILE__, __LINE__
+            );
+          }
+          scr_tune_store(stripe, reddesc->stripe_dirs[j]);
+        }
       } else {
         scr_abort(-1, "Invalid store for redundancy descriptor @ %s:%d",
           __FILE__, __LINE__
@@ -2095,11 +3525,50 @@ int SCR_Init()
   /* TODO: should we check for access and required space in cache
    * directories at this point? */
 
+  /* AXL and ER take a single buffer size, so give them the sizes
+   * tuned for the store that checkpoints go to by default */
+  scr_storedesc* tune_store = NULL;
+  for (i = 0; i < scr_nreddescs && scr_buf_tune; i++) {
+    if (scr_reddescs[i].enabled) {
+      tune_store = scr_reddesc_get_store(&scr_reddescs[i]);
+      break;
+    }
+  }
+  if (tune_store != NULL) {
+    scr_storedesc* store = tune_store;
+    if (store->buf_size > 0) {
+      scr_file_buf_size = (size_t) store->buf_size;
+      scr_mpi_buf_size  = store->mpi_buf_size;
+
+      kvtree* axl_config = kvtree_new();
+      kvtree_util_set_bytecount(axl_config, AXL_KEY_CONFIG_FILE_BUF_SIZE, scr_file_buf_size);
+      if (AXL_Config(axl_config) == NULL) {
+        scr_err("Failed to set tuned buffer size in AXL @ %s:%d",
+          __FILE__, __LINE__
+        );
+      }
+      kvtree_delete(&axl_config);
+
+      kvtree* er_config = kvtree_new();
+      kvtree_util_set_int(er_config, ER_KEY_CONFIG_MPI_BUF_SIZE, scr_mpi_buf_size);
+      if (ER_Config(er_config) == NULL) {
+        scr_err("Failed to set tuned buffer size in ER @ %s:%d",
+          __FILE__, __LINE__
+        );
+      }
+      kvtree_delete(&er_config);
+    }
+  }
+
   /* ensure that the control and cache directories are ready */
   MPI_Barrier(scr_comm_world);
+  scr_trace_end();
 
   scr_env_init();
 
+  /* learn about failed processes and nodes as soon as PMIx does */
+  scr_pmix_event_init();
+
   /* place the halt, flush, and nodes files in the prefix directory */
   scr_halt_file = spath_from_str(scr_prefix_scr);
   spath_append_str(scr_halt_file, "halt.scr");
@@ -2157,6 +3626,7 @@ int SCR_Init()
   }
 
   /* allocate a new global filemap object */
+  scr_trace_begin("rebuild");
   scr_cindex = scr_cache_index_new();
 
   /* leader on each node reads all filemaps and distributes them to other ranks
@@ -2164,6 +3634,13 @@ int SCR_Init()
    * has changed since the last run */
   scr_cache_index_read(scr_cindex_file, scr_cindex);
 
+  /* remove what is left of datasets whose deletion was cut short */
+  scr_reclaim_recover(scr_cindex);
+
+  /* simulate a failure if asked to, so we can time the recovery */
+  scr_inject_failures(scr_cindex);
+  double rebuild_start = MPI_Wtime();
+
   /* delete all files in cache on restart if asked to purge,
    * this is useful during development so the user does not
    * have to manually delete files from all nodes */
@@ -2195,7 +3672,9 @@ int SCR_Init()
       /* check whether we need to flush data */
       if (scr_flush_on_restart) {
         /* always flush on restart if scr_flush_on_restart is set */
+        scr_trace_begin("flush");
         int flush_rc = scr_flush_sync(scr_cindex, scr_ckpt_dset_id);
+        scr_trace_end();
         if (flush_rc != SCR_SUCCESS) {
           scr_abort(-1, "Flush of dataset %d failed @ %s:%d",
             scr_ckpt_dset_id, __FILE__, __LINE__
@@ -2225,7 +3704,12 @@ int SCR_Init()
     scr_flush_file_rebuild(scr_cindex);
   }
 
+  scr_trace_end();
+  double rebuild_secs = MPI_Wtime() - rebuild_start;
+
   /* attempt to fetch files from parallel file system */
+  scr_trace_begin("fetch");
+  double fetch_start = MPI_Wtime();
   int fetch_attempted = 0;
   if ((rc != SCR_SUCCESS || scr_global_restart) && scr_fetch) {
     /* sets scr_dataset_id and scr_checkpoint_id upon success */
@@ -2234,6 +3718,10 @@ int SCR_Init()
       scr_dbg(2, "scr_fetch_latest attempted on restart");
     }
   }
+  scr_trace_end();
+
+  /* report recovery times of an injected failure */
+  scr_inject_report(rebuild_secs, MPI_Wtime() - fetch_start);
 
   /* TODO: there is some risk here of cleaning the cache when we shouldn't
    * if given a badly placed nodeset for a restart job step within an
@@ -2264,9 +3752,26 @@ int SCR_Init()
    * we'll take this to mean that we have a checkpoint in cache */
   scr_have_restart = (scr_checkpoint_id > 0);
 
+  /* flush this checkpoint if a failure is reported before the next */
+  scr_pmix_event_checkpoint(scr_cindex);
+
+  /* claim memory for datasets before the application does,
+   * leaving room for what rebuild and fetch put in cache */
+  if (scr_arena_create(scr_cindex) != SCR_SUCCESS) {
+    if (scr_my_rank_world == 0) {
+      scr_warn("Failed to reserve arena in cache directories @ %s:%d",
+        __FILE__, __LINE__
+      );
+    }
+  }
+
   /* sync everyone before returning to ensure that subsequent
    * calls to SCR functions are valid */
   MPI_Barrier(scr_comm_world);
+  scr_trace_end();
+
+  /* report time spent in each phase of init */
+  scr_trace_report("init", scr_comm_world);
 
   /* start the clocks for measuring the compute time and time of last checkpoint */
   if (scr_my_rank_world == 0) {
@@ -2282,6 +3787,8 @@ int SCR_Init()
     }
   }
 
+  scr_stats_add(SCR_STATS_EV_INIT, MPI_Wtime() - scr_time_init_start);
+
   /* all done, ready to go */
   return rc;
 }
@@ -2310,11 +3817,17 @@ int SCR_Finalize()
    * are calling this as a collective */
   MPI_Barrier(scr_comm_world);
 
+  /* time each phase of finalize to report where shutdown time goes */
+  scr_trace_begin("finalize");
+
 #if 0
   /* free user hash if one was allocated */
   kvtree_delete(&scr_app_hash);
 #endif
 
+  /* finish completing and encoding the latest dataset so that it can be flushed */
+  scr_output_finish();
+
   if (scr_my_rank_world == 0) {
     /* stop the clock for measuring the compute time */
     scr_time_compute_end = MPI_Wtime();
@@ -2324,10 +3837,11 @@ int SCR_Finalize()
   }
 
   /* handle any async flush */
+  scr_trace_begin("flush");
   if (scr_flush_async_in_progress) {
-    /* there's an async flush ongoing, see which dataset is being flushed */
-    int flush_rc;
-    if (scr_flush_async_dataset_id == scr_dataset_id) {
+    /* there's an async flush ongoing, see which datasets are being flushed */
+    int flush_rc = SCR_SUCCESS;
+    if (scr_flush_async_pending(scr_dataset_id)) {
 #ifdef HAVE_LIBCPPR
       /* if we have CPPR, async flush is faster than sync flush, so let it finish */
       flush_rc = scr_flush_async_wait(scr_cindex);
@@ -2338,16 +3852,21 @@ int SCR_Finalize()
       /* neither strdup nor free */
       const scr_storedesc* storedesc = scr_cache_get_storedesc(scr_cindex, scr_dataset_id);
       const char* type = storedesc->xfer;
-      if (strcmp(type, "DATAWARP") == 0) {
-        /* wait for datawarp flushes to finish */
+
+      /* let the async flush finish if it is expected to in time */
+      int finish = scr_flush_async_can_finish();
+      if (finish || strcmp(type, "DATAWARP") == 0) {
+        /* wait for datawarp flushes, or flushes due to finish in time */
         flush_rc = scr_flush_async_wait(scr_cindex);
       } else {
-        /* kill the async flush, we'll get this with a sync flush instead */
+        /* finish flushes of older datasets, then kill the async flush
+         * of this one, we'll get this with a sync flush instead */
+        flush_rc = scr_flush_async_wait_count(scr_cindex, 1);
         scr_flush_async_stop();
       }
 #endif
     } else {
-      /* the async flush is flushing a different checkpoint, so wait for it */
+      /* the async flushes are flushing different checkpoints, so wait for them */
       flush_rc = scr_flush_async_wait(scr_cindex);
     }
     if (flush_rc != SCR_SUCCESS) {
@@ -2369,10 +3888,42 @@ int SCR_Finalize()
       );
     }
   }
+  scr_trace_end();
 
+  scr_trace_begin("cleanup");
   if(scr_flush_async){
     scr_flush_async_finalize();
   }
+  scr_flush_sync_finalize();
+
+  /* remove directories made for a checkpoint that never came */
+  scr_cache_dir_prepare_finalize();
+
+  /* finish deleting files and directories of datasets dropped from cache */
+  scr_reclaim_finalize();
+
+  /* finish deleting datasets dropped from the prefix directory */
+  scr_prefix_finalize();
+  scr_trace_end();
+
+  /* complete any decisions rank 0 sent ahead of time */
+  scr_decide_reset();
+
+  /* hand the pages of the arena back to the node */
+  scr_arena_delete();
+
+  /* report time spent in each phase of finalize */
+  scr_trace_end();
+  scr_trace_report("finalize", scr_comm_world);
+
+  /* report latency of file operations and the slowest ranks */
+  scr_iohist_report(scr_comm_world);
+
+  /* summarize time and bytes spent in SCR over the run */
+  scr_stats_report(MPI_Wtime() - scr_time_init_start);
+
+  /* write timeline of all ranks, now that helper threads have exited */
+  scr_trace_timeline_write(scr_comm_world);
 
   /* free off the memory allocated for our descriptors */
   scr_reddescs_free();
@@ -2389,6 +3940,7 @@ int SCR_Finalize()
 
   /* free off our global filemap object */
   scr_filemap_delete(&scr_map);
+  scr_filemap_delete(&scr_clone_map);
 
   /* free off our global filemap object */
   scr_cache_index_delete(&scr_cindex);
@@ -2398,6 +3950,9 @@ int SCR_Finalize()
     scr_log_finalize();
   }
 
+  /* wait on any emergency flush before we shut down */
+  scr_pmix_event_finalize();
+
 #ifdef HAVE_LIBPMIX
   /* sync procs in pmix before shutdown */
   int retval = PMIx_Fence(NULL, 0, NULL, 0);
@@ -2440,8 +3995,31 @@ int SCR_Finalize()
     );
   }
 
+  /* forget any registered memory buffers */
+  scr_buffer_finalize();
+
+  /* stop checking closed files */
+  scr_stream_finalize();
+
+  /* forget what we know about files in cache */
+  scr_cache_known_free();
+
+  /* release state held for staging flushes through the drain store */
+  scr_drain_finalize();
+
+  /* free the cached cache directory for routing files */
+  scr_route_set_dir(-1, NULL);
+
   /* free memory allocated for variables */
   scr_free(&scr_flush_type);
+  scr_free(&scr_drain_store);
+  scr_free(&scr_inject_ranks);
+  scr_free(&scr_flush_compress);
+  scr_free(&scr_cache_compress);
+  scr_free(&scr_numa);
+  scr_numa_clear();
+  scr_free(&scr_cache_evict);
+  scr_free(&scr_flush_container);
   scr_free(&scr_fetch_current);
   scr_free(&scr_log_db_host);
   scr_free(&scr_log_db_user);
@@ -2452,6 +4030,8 @@ int SCR_Finalize()
   scr_free(&scr_jobname);
   scr_free(&scr_clustername);
   scr_free(&scr_group);
+  scr_free(&scr_set_group);
+  scr_free(&scr_topology_file);
   scr_free(&scr_prefix_scr);
   scr_free(&scr_prefix);
   scr_free(&scr_cntl_prefix);
@@ -2461,11 +4041,15 @@ int SCR_Finalize()
 
   spath_delete(&scr_cindex_file);
   spath_delete(&scr_nodes_file);
+  scr_flush_file_finalize();
   spath_delete(&scr_flush_file);
   spath_delete(&scr_halt_file);
   spath_delete(&scr_prefix_path);
 
   /* free off the library's communicators */
+  if (scr_comm_node_leaders != MPI_COMM_NULL) {
+    MPI_Comm_free(&scr_comm_node_leaders);
+  }
   if (scr_comm_node != MPI_COMM_NULL) {
     MPI_Comm_free(&scr_comm_node);
   }
@@ -2842,6 +4426,96 @@ const char* SCR_Configf(const char* format, ...)
   return ret;
 }
 
+/* decide whether the application should checkpoint on the given call
+ * to SCR_Need_checkpoint, ignoring halt conditions, only called on rank 0 */
+static int scr_need_checkpoint_decide(int count)
+{
+  /* assume we don't need to checkpoint */
+  int flag = 0;
+
+  /* TODO: account for MTBF, time to flush, etc. */
+  /* if we don't need to halt, check whether we can afford to checkpoint */
+
+  /* if checkpoint interval is set, check the current checkpoint id */
+  if (!flag && scr_checkpoint_interval > 0 && count % scr_checkpoint_interval == 0) {
+    flag = 1;
+  }
+
+  /* if checkpoint seconds is set, check the time since the last checkpoint */
+  if (!flag && scr_checkpoint_seconds > 0) {
+    double now_seconds = MPI_Wtime();
+    if ((int)(now_seconds - scr_time_checkpoint_end) >= scr_checkpoint_seconds) {
+      flag = 1;
+    }
+  }
+
+  /* check whether we can afford to checkpoint based on the max allowed
+   * checkpoint overhead, if set */
+  if (!flag && scr_checkpoint_overhead > 0) {
+    /* TODO: could init the cost estimate via environment variable or
+     * stats from previous run */
+    if (scr_time_checkpoint_count == 0) {
+      /* if we haven't taken a checkpoint, we need to take one in order
+       * to get a cost estimate */
+      flag = 1;
+    } else if (scr_time_checkpoint_count > 0) {
+      /* based on average time of checkpoint, current time, and time
+       * that last checkpoint ended, determine overhead of checkpoint
+       * if we took one right now */
+      double now = MPI_Wtime();
+      double avg_cost = scr_time_checkpoint_total / (double) scr_time_checkpoint_count;
+      double percent_cost = avg_cost / (now - scr_time_checkpoint_end + avg_cost) * 100.0;
+
+      /* if our current percent cost is less than allowable overhead,
+       * indicate that it's time for a checkpoint */
+      if (percent_cost < scr_checkpoint_overhead) {
+        flag = 1;
+      }
+    }
+  }
+
+  /* checkpoint once the time since the last checkpoint exceeds the optimal interval
+   * computed from the average cost of a checkpoint and the failure rate, the cost
+   * covers writing and encoding the checkpoint in cache, flush is handled separately */
+  int use_model = (scr_checkpoint_model != SCR_INTERVAL_NONE && scr_checkpoint_mtbf > 0.0);
+  if (!flag && use_model) {
+    if (scr_time_checkpoint_count == 0) {
+      /* take a checkpoint to get a cost estimate */
+      flag = 1;
+    } else {
+      double avg_cost = scr_time_checkpoint_total / (double) scr_time_checkpoint_count;
+      double interval = scr_interval_secs(scr_checkpoint_model, avg_cost, scr_checkpoint_mtbf);
+      double now = MPI_Wtime();
+      if (now - scr_time_checkpoint_end >= interval) {
+        flag = 1;
+      }
+    }
+  }
+
+  /* no way to determine whether we need to checkpoint, so always say yes */
+  if (!flag &&
+      scr_checkpoint_interval <= 0 &&
+      scr_checkpoint_seconds  <= 0 &&
+      scr_checkpoint_overhead <= 0 &&
+      ! use_model)
+  {
+    flag = 1;
+  }
+
+  return flag;
+}
+
+/* have rank 0 decide whether to checkpoint on the next call to
+ * SCR_Need_checkpoint and post its decision */
+static void scr_need_checkpoint_post_next(void)
+{
+  int next = 0;
+  if (scr_my_rank_world == 0) {
+    next = scr_halt_test(0, 0) || scr_need_checkpoint_decide(scr_need_checkpoint_count + 1);
+  }
+  scr_decide_post(&scr_decide_checkpoint, next);
+}
+
 /* sets flag to 1 if a checkpoint should be taken, flag is set to 0 otherwise */
 int SCR_Need_checkpoint(int* flag)
 {
@@ -2865,13 +4539,43 @@ int SCR_Need_checkpoint(int* flag)
     return SCR_FAILURE;
   }
 
+  /* after a failure, a checkpoint can not complete, and the
+   * collectives below may not either */
+  if (scr_pmix_event_failed()) {
+    scr_pmix_event_respond(scr_cindex);
+    *flag = 0;
+    return SCR_SUCCESS;
+  }
+
   /* this is not required, but it helps ensure apps
-   * are calling this as a collective */
-  MPI_Barrier(scr_comm_world);
+   * are calling this as a collective, skip it when
+   * deciding asynchronously to avoid synchronizing */
+  if (! scr_decide_async) {
+    MPI_Barrier(scr_comm_world);
+  }
 
   /* track the number of times a user has called SCR_Need_checkpoint */
   scr_need_checkpoint_count++;
 
+  /* make progress on any outstanding output and async encode */
+  scr_output_progress();
+
+  /* pace any ongoing async flush based on the time since our last call */
+  if (scr_flush_async) {
+    scr_flush_async_progress();
+  }
+
+  /* with async decisions, use the decision rank 0 made on our last
+   * call, and have it make the decision for our next call */
+  if (scr_decide_async && scr_decide_get(&scr_decide_checkpoint, flag)) {
+    /* if we checkpoint now, the next decision depends on when this
+     * checkpoint ends, so the next call decides without looking ahead */
+    if (! *flag) {
+      scr_need_checkpoint_post_next();
+    }
+    return SCR_SUCCESS;
+  }
+
   /* assume we don't need to checkpoint */
   *flag = 0;
 
@@ -2882,61 +4586,18 @@ int SCR_Need_checkpoint(int* flag)
   }
 
   /* have rank 0 make the decision and broadcast the result */
-  if (scr_my_rank_world == 0) {
-    /* TODO: account for MTBF, time to flush, etc. */
-    /* if we don't need to halt, check whether we can afford to checkpoint */
-
-    /* if checkpoint interval is set, check the current checkpoint id */
-    if (!*flag && scr_checkpoint_interval > 0 && scr_need_checkpoint_count % scr_checkpoint_interval == 0) {
-      *flag = 1;
-    }
-
-    /* if checkpoint seconds is set, check the time since the last checkpoint */
-    if (!*flag && scr_checkpoint_seconds > 0) {
-      double now_seconds = MPI_Wtime();
-      if ((int)(now_seconds - scr_time_checkpoint_end) >= scr_checkpoint_seconds) {
-        *flag = 1;
-      }
-    }
-
-    /* check whether we can afford to checkpoint based on the max allowed
-     * checkpoint overhead, if set */
-    if (!*flag && scr_checkpoint_overhead > 0) {
-      /* TODO: could init the cost estimate via environment variable or
-       * stats from previous run */
-      if (scr_time_checkpoint_count == 0) {
-        /* if we haven't taken a checkpoint, we need to take one in order
-         * to get a cost estimate */
-        *flag = 1;
-      } else if (scr_time_checkpoint_count > 0) {
-        /* based on average time of checkpoint, current time, and time
-         * that last checkpoint ended, determine overhead of checkpoint
-         * if we took one right now */
-        double now = MPI_Wtime();
-        double avg_cost = scr_time_checkpoint_total / (double) scr_time_checkpoint_count;
-        double percent_cost = avg_cost / (now - scr_time_checkpoint_end + avg_cost) * 100.0;
-
-        /* if our current percent cost is less than allowable overhead,
-         * indicate that it's time for a checkpoint */
-        if (percent_cost < scr_checkpoint_overhead) {
-          *flag = 1;
-        }
-      }
-    }
-
-    /* no way to determine whether we need to checkpoint, so always say yes */
-    if (!*flag &&
-        scr_checkpoint_interval <= 0 &&
-        scr_checkpoint_seconds  <= 0 &&
-        scr_checkpoint_overhead <= 0)
-    {
-      *flag = 1;
-    }
+  if (scr_my_rank_world == 0 && !*flag) {
+    *flag = scr_need_checkpoint_decide(scr_need_checkpoint_count);
   }
 
   /* rank 0 broadcasts the decision */
   MPI_Bcast(flag, 1, MPI_INT, 0, scr_comm_world);
 
+  /* have rank 0 decide for our next call while the application runs */
+  if (scr_decide_async && ! *flag) {
+    scr_need_checkpoint_post_next();
+  }
+
   return SCR_SUCCESS;
 }
 
@@ -2992,6 +4653,262 @@ int SCR_Start_checkpoint()
   return scr_start_output(NULL, SCR_FLAG_CHECKPOINT);
 }
 
+/* if the previous checkpoint has a file of the same name as file,
+ * start newfile as a copy of it, which the copy makes with a reflink
+ * where the cache supports it, so the application only rewrites the
+ * parts that changed */
+static void scr_route_file_clone(const char* file, const char* newfile)
+{
+  if (scr_clone_id <= 0 || scr_rd->bypass) {
+    return;
+  }
+
+  /* read the filemap of the previous checkpoint on first use,
+   * it may have been deleted from cache to make room for this one */
+  if (scr_clone_map == NULL) {
+    scr_clone_map = scr_filemap_new();
+    if (scr_cache_get_map(scr_cindex, scr_clone_id, scr_clone_map) != SCR_SUCCESS) {
+      scr_filemap_delete(&scr_clone_map);
+      scr_clone_id = 0;
+      return;
+    }
+  }
+
+  /* leave alone a file the application has already written */
+  if (access(newfile, F_OK) == 0) {
+    return;
+  }
+
+  /* split the absolute path of the original file into directory and name */
+  spath* path_abs = spath_from_str(file);
+  if (! spath_is_absolute(path_abs)) {
+    spath_prepend_str(path_abs, scr_route_get_cwd(file));
+  }
+  spath_reduce(path_abs);
+  spath* path_name = spath_cut(path_abs, -1);
+  char* path = spath_strdup(path_abs);
+  char* name = spath_strdup(path_name);
+  spath_delete(&path_name);
+  spath_delete(&path_abs);
+
+  /* look for a complete file of the same name held as is in cache */
+  kvtree_elem* elem;
+  for (elem = scr_filemap_first_file(scr_clone_map);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    const char* src = kvtree_elem_key(elem);
+
+    scr_meta* meta = scr_meta_new();
+    scr_filemap_get_meta(scr_clone_map, src, meta);
+    char* origpath;
+    char* origname;
+    int type = SCR_COMPRESS_NONE;
+    int match = (scr_meta_get_origpath(meta, &origpath) == SCR_SUCCESS &&
+                 scr_meta_get_origname(meta, &origname) == SCR_SUCCESS &&
+                 strcmp(origpath, path) == 0 && strcmp(origname, name) == 0);
+    int usable = (match && scr_meta_is_complete(meta) &&
+                  scr_meta_get_dedup(meta) == NULL &&
+                  scr_meta_get_cache_compress(meta, &type, NULL) == SCR_SUCCESS &&
+                  type == SCR_COMPRESS_NONE);
+    scr_meta_delete(&meta);
+
+    if (usable) {
+      if (scr_file_copy(src, newfile, scr_storedescs_buf_size(newfile), NULL) == SCR_SUCCESS) {
+        scr_dbg(2, "Started %s from %s of dataset %d", newfile, src, scr_clone_id);
+      } else {
+        scr_file_unlink(newfile);
+      }
+    }
+    if (match) {
+      break;
+    }
+  }
+
+  scr_free(&name);
+  scr_free(&path);
+}
+
+/* record a file routed during output in the filemap,
+ * the caller must write out the filemap afterwards */
+static void scr_route_file_add(const char* file, const char* newfile)
+{
+  /* TODO: to avoid duplicates, check that the file is not already in the filemap,
+   * at the moment duplicates just overwrite each other, so there's no harm */
+
+  /* add the file to the filemap */
+  scr_filemap_add_file(scr_map, newfile);
+
+  /* read meta data for this file */
+  scr_meta* meta = scr_meta_new();
+  scr_filemap_get_meta(scr_map, newfile, meta);
+
+  /* set parameters for the file */
+  scr_meta_set_complete(meta, 0);
+  /* TODO: move the ranks field elsewhere, for now it's needed by scr_index.c */
+  scr_meta_set_ranks(meta, scr_ranks_world);
+  scr_meta_set_orig(meta, file);
+
+  /* build absolute path to file */
+  spath* path_abs = spath_from_str(file);
+  if (! spath_is_absolute(path_abs)) {
+    /* the path is not absolute, so prepend the current working directory */
+    spath_prepend_str(path_abs, scr_route_get_cwd(file));
+  }
+
+  /* simplify the absolute path (removes "." and ".." entries) */
+  spath_reduce(path_abs);
+
+  /* check that file is somewhere under prefix */
+  if (! spath_is_child(scr_prefix_path, path_abs)) {
+    /* found a file that's outside of prefix, throw an error */
+    char* path_abs_str = spath_strdup(path_abs);
+    scr_abort(-1, "File `%s' must be under SCR_PREFIX `%s' @ %s:%d",
+      path_abs_str, scr_prefix, __FILE__, __LINE__
+    );
+  }
+
+  /* cut absolute path into direcotry and file name */
+  spath* path_name = spath_cut(path_abs, -1);
+
+  /* store the full path and name of the original file */
+  char* path = spath_strdup(path_abs);
+  char* name = spath_strdup(path_name);
+  scr_meta_set_origpath(meta, path);
+  scr_meta_set_origname(meta, name);
+
+  /* TODO: would be nice to limit mkdir ops here */
+  /* if we're in bypass mode, we need to be sure directory exists
+   * for this file before user starts to write to it */
+  if (scr_rd->bypass) {
+    mode_t mode_dir = scr_getmode(1, 1, 1);
+    if (scr_mkdir(path, mode_dir) != SCR_SUCCESS) {
+      scr_abort(-1, "Failed to create directory %s @ %s:%d",
+        path, __FILE__, __LINE__
+      );
+    }
+  }
+
+  /* free full path and name of original file */
+  scr_free(&name);
+  scr_free(&path);
+
+  /* free directory and file name paths */
+  spath_delete(&path_name);
+  spath_delete(&path_abs);
+
+  /* record the meta data for this file */
+  scr_filemap_set_meta(scr_map, newfile, meta);
+
+  /* delete the meta data object */
+  scr_meta_delete(&meta);
+}
+
+/* given a file routed during restart, check that it exists,
+ * and otherwise look for a file with the same basename in the filemap */
+static int scr_route_file_restart(char* newfile)
+{
+  /* if user specified path to file within prefix, return */
+  if (scr_file_is_readable(newfile) == SCR_SUCCESS) {
+    return SCR_SUCCESS;
+  }
+
+  /* the file may just not be fetched yet */
+  if (scr_fetch_lazy) {
+    scr_fetch_lazy_file(scr_cindex, scr_dataset_id, newfile);
+    if (scr_file_is_readable(newfile) == SCR_SUCCESS) {
+      return SCR_SUCCESS;
+    }
+  }
+
+  /* TODO: To support backwards compatibility, the user is allowed
+   * to pass just the file name with no path component during restart.
+   * This means that they cannot have two files in the same checkpoint
+   * with the same basename even if those files would be in two
+   * different directories, e.g., one can't do something like:
+   *   ckpt.1.root
+   *   ckpt.1/ckpt.1.root
+   *
+   * With bypass, we need to figure out which directory the file is
+   * in, so we have to scan through the filemap to find a match on
+   * the basename.
+   *
+   * The proper fix would be to force users to include path components
+   * even in restart.  This would make route_file symmetric in output
+   * and restart, which is better.  It would take a step in enabling
+   * two files with the same basename but in different directories.
+   * However, it also requires that users names their checkpoints,
+   * so SCR_Start_checkpoint must be deprecated ro changed to take a
+   * name argument. */
+
+  /* compute basename of new file */
+  spath* path = spath_from_str(newfile);
+  spath_basename(path);
+  char* newfilebase = spath_strdup(path);
+  spath_delete(&path);
+
+  /* get the filemap for this checkpoint */
+  scr_filemap* map = scr_filemap_new();
+  scr_cache_get_map(scr_cindex, scr_dataset_id, map);
+
+  /* loop over each file in the map */
+  int found_file = 0;
+  kvtree_elem* file_elem;
+  for (file_elem = scr_filemap_first_file(map);
+       file_elem != NULL;
+       file_elem = kvtree_elem_next(file_elem))
+  {
+    /* get the filename */
+    char* mapfile = kvtree_elem_key(file_elem);
+
+    /* get meta data for this file */
+    scr_meta* meta = scr_meta_new();
+    if (scr_filemap_get_meta(map, mapfile, meta) == SCR_SUCCESS) {
+      /* lookup basename for this file from meta data */
+      char* origname = NULL;
+      if (scr_meta_get_origname(meta, &origname) == SCR_SUCCESS) {
+        /* check whether basename in meta matches basename of input file */
+        if (strcmp(origname, newfilebase) == 0) {
+          /* found a matching base name in our file map,
+           * overwrite output file path in newfile with
+           * full path to checkpoint file */
+          strncpy(newfile, mapfile, SCR_MAX_FILENAME);
+          found_file = 1;
+        }
+      }
+    }
+    scr_meta_delete(&meta);
+
+    /* stop looping early if we found the file */
+    if (found_file) {
+      break;
+    }
+  }
+
+  /* free the filemap */
+  scr_filemap_delete(&map);
+
+  /* free the base name of new file */
+  scr_free(&newfilebase);
+
+  /* return an error if we failed to find the basename in the file map */
+  if (! found_file) {
+    return SCR_FAILURE;
+  }
+
+  /* fetch the file we matched if it is not in cache yet */
+  if (scr_fetch_lazy) {
+    scr_fetch_lazy_file(scr_cindex, scr_dataset_id, newfile);
+  }
+
+  /* if we can't read the file, return an error */
+  if (scr_file_is_readable(newfile) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+
+  return SCR_SUCCESS;
+}
+
 /* given a filename, return the full path to the file which the user should write to */
 int SCR_Route_file(const char* file, char* newfile)
 {
@@ -3044,186 +4961,237 @@ int SCR_Route_file(const char* file, char* newfile)
   /* if we are in a new dataset, record this file in our filemap,
    * otherwise, we are likely in a restart, so check whether the file exists */
   if (scr_in_output) {
-    /* TODO: to avoid duplicates, check that the file is not already in the filemap,
-     * at the moment duplicates just overwrite each other, so there's no harm */
+    scr_route_file_clone(file, newfile);
+    scr_route_file_add(file, newfile);
 
-    /* add the file to the filemap */
-    scr_filemap_add_file(scr_map, newfile);
+    /* write out the filemap, or leave it for SCR_Complete_output */
+    if (! scr_map_defer) {
+      scr_cache_set_map(scr_cindex, scr_dataset_id, scr_map);
+    }
+  } else {
+    return scr_route_file_restart(newfile);
+  }
 
-    /* read meta data for this file */
-    scr_meta* meta = scr_meta_new();
-    scr_filemap_get_meta(scr_map, newfile, meta);
+  return SCR_SUCCESS;
+}
 
-    /* set parameters for the file */
-    scr_meta_set_complete(meta, 0);
-    /* TODO: move the ranks field elsewhere, for now it's needed by scr_index.c */
-    scr_meta_set_ranks(meta, scr_ranks_world);
-    scr_meta_set_orig(meta, file);
+/* tell SCR that the application has closed a file it routed */
+int SCR_Complete_file(const char* file)
+{
+  /* manage state transition */
+  if (scr_state != SCR_STATE_CHECKPOINT &&
+      scr_state != SCR_STATE_OUTPUT)
+  {
+    scr_state_transition_error(scr_state, "SCR_Complete_file()", __FILE__, __LINE__);
+  }
 
-    /* build absolute path to file */
-    spath* path_abs = spath_from_str(file);
-    if (! spath_is_absolute(path_abs)) {
-      /* the path is not absolute, so prepend the current working directory */
-      char cwd[SCR_MAX_FILENAME];
-      if (scr_getcwd(cwd, sizeof(cwd)) == SCR_SUCCESS) {
-        spath_prepend_str(path_abs, cwd);
-      } else {
-        /* problem acquiring current working directory */
-        scr_abort(-1, "Failed to build absolute path to %s @ %s:%d",
-          file, __FILE__, __LINE__
-        );
-      }
-    }
+  /* if not enabled, bail with an error */
+  if (! scr_enabled) {
+    return SCR_FAILURE;
+  }
 
-    /* simplify the absolute path (removes "." and ".." entries) */
-    spath_reduce(path_abs);
+  /* bail out if not initialized -- will get bad results */
+  if (! scr_initialized) {
+    scr_abort(-1, "SCR has not been initialized @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
 
-    /* check that file is somewhere under prefix */
-    if (! spath_is_child(scr_prefix_path, path_abs)) {
-      /* found a file that's outside of prefix, throw an error */
-      char* path_abs_str = spath_strdup(path_abs);
-      scr_abort(-1, "File `%s' must be under SCR_PREFIX `%s' @ %s:%d",
-        path_abs_str, scr_prefix, __FILE__, __LINE__
-      );
+  /* find where the flush would copy the file if we write it through */
+  char* dest = NULL;
+  if (scr_through && scr_in_output) {
+    scr_meta* meta = scr_meta_new();
+    if (scr_filemap_get_meta(scr_map, file, meta) == SCR_SUCCESS) {
+      dest = scr_route_file_dest(meta);
     }
+    scr_meta_delete(&meta);
+  }
 
-    /* cut absolute path into direcotry and file name */
-    spath* path_name = spath_cut(path_abs, -1);
+  /* check the file in the background, the result is used by
+   * SCR_Complete_output if the file is in the filemap */
+  int rc = scr_stream_add(file, dest);
+  scr_free(&dest);
+  return rc;
+}
 
-    /* store the full path and name of the original file */
-    char* path = spath_strdup(path_abs);
-    char* name = spath_strdup(path_name);
-    scr_meta_set_origpath(meta, path);
-    scr_meta_set_origname(meta, name);
+/* given a list of n filenames, return the full path to each file in newfiles,
+ * the filemap is written once for the whole list */
+int SCR_Route_files(int n, const char* files[], char* newfiles[])
+{
+  int i;
 
-    /* TODO: would be nice to limit mkdir ops here */
-    /* if we're in bypass mode, we need to be sure directory exists
-     * for this file before user starts to write to it */
-    if (scr_rd->bypass) {
-      mode_t mode_dir = scr_getmode(1, 1, 1);
-      if (scr_mkdir(path, mode_dir) != SCR_SUCCESS) {
-        scr_abort(-1, "Failed to create directory %s @ %s:%d",
-          path, __FILE__, __LINE__
-        );
+  /* check that we got lists to read from and write to */
+  if (n < 0 || (n > 0 && (files == NULL || newfiles == NULL))) {
+    return SCR_FAILURE;
+  }
+
+  /* outside a start/complete pair, copy each name just as SCR_Route_file does */
+  if (scr_state != SCR_STATE_RESTART    &&
+      scr_state != SCR_STATE_CHECKPOINT &&
+      scr_state != SCR_STATE_OUTPUT)
+  {
+    int rc = SCR_SUCCESS;
+    for (i = 0; i < n; i++) {
+      if (SCR_Route_file(files[i], newfiles[i]) != SCR_SUCCESS) {
+        rc = SCR_FAILURE;
       }
     }
+    return rc;
+  }
 
-    /* free full path and name of original file */
-    scr_free(&name);
-    scr_free(&path);
+  /* if not enabled, bail with an error */
+  if (! scr_enabled) {
+    return SCR_FAILURE;
+  }
 
-    /* free directory and file name paths */
-    spath_delete(&path_name);
-    spath_delete(&path_abs);
+  /* bail out if not initialized -- will get bad results */
+  if (! scr_initialized) {
+    scr_abort(-1, "SCR has not been initialized @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
 
-    /* record the meta data for this file */
-    scr_filemap_set_meta(scr_map, newfile, meta);
+  /* route each file, recording the ones we write in the filemap */
+  int rc = SCR_SUCCESS;
+  for (i = 0; i < n; i++) {
+    if (scr_route_file(scr_dataset_id, files[i], newfiles[i], SCR_MAX_FILENAME) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+      continue;
+    }
+
+    if (scr_in_output) {
+      scr_route_file_clone(files[i], newfiles[i]);
+      scr_route_file_add(files[i], newfiles[i]);
+    } else if (scr_route_file_restart(newfiles[i]) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+  }
 
-    /* write out the filemap */
+  /* write out the filemap once for the whole list,
+   * or leave it for SCR_Complete_output */
+  if (scr_in_output && ! scr_map_defer) {
     scr_cache_set_map(scr_cindex, scr_dataset_id, scr_map);
+  }
 
-    /* delete the meta data object */
-    scr_meta_delete(&meta);
-  } else {
-    /* if user specified path to file within prefix, return */
-    if (scr_file_is_readable(newfile) == SCR_SUCCESS) {
-      return SCR_SUCCESS;
-    }
+  return rc;
+}
 
-    /* TODO: To support backwards compatibility, the user is allowed
-     * to pass just the file name with no path component during restart.
-     * This means that they cannot have two files in the same checkpoint
-     * with the same basename even if those files would be in two
-     * different directories, e.g., one can't do something like:
-     *   ckpt.1.root
-     *   ckpt.1/ckpt.1.root
-     *
-     * With bypass, we need to figure out which directory the file is
-     * in, so we have to scan through the filemap to find a match on
-     * the basename.
-     *
-     * The proper fix would be to force users to include path components
-     * even in restart.  This would make route_file symmetric in output
-     * and restart, which is better.  It would take a step in enabling
-     * two files with the same basename but in different directories.
-     * However, it also requires that users names their checkpoints,
-     * so SCR_Start_checkpoint must be deprecated ro changed to take a
-     * name argument. */
-
-    /* compute basename of new file */
-    spath* path = spath_from_str(newfile);
-    spath_basename(path);
-    char* newfilebase = spath_strdup(path);
-    spath_delete(&path);
+/* inform library that the current dataset is complete */
+int SCR_Complete_output(int valid)
+{
+  /* manage state transition */
+  if (scr_state != SCR_STATE_OUTPUT) {
+    scr_abort(-1, "Must call SCR_Start_output() before SCR_Complete_output() @ %s:%d",
+      __FILE__, __LINE__
+    );
+  }
+  scr_state = SCR_STATE_IDLE;
+
+  /* if not enabled, bail with an error */
+  if (! scr_enabled) {
+    return SCR_FAILURE;
+  }
+
+  /* bail out if not initialized -- will get bad results */
+  if (! scr_initialized) {
+    scr_abort(-1, "SCR has not been initialized @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  return scr_complete_output(valid);
+}
+
+/* inform library that the current dataset is complete,
+ * and return before SCR has finished with it */
+int SCR_Icomplete_output(int valid, SCR_Request* req)
+{
+  /* check that we have a request variable to write to before we change
+   * any state, so the caller can still complete the output */
+  if (req == NULL) {
+    return SCR_FAILURE;
+  }
+
+  /* manage state transition */
+  if (scr_state != SCR_STATE_OUTPUT) {
+    scr_abort(-1, "Must call SCR_Start_output() before SCR_Icomplete_output() @ %s:%d",
+      __FILE__, __LINE__
+    );
+  }
+  scr_state = SCR_STATE_IDLE;
+
+  /* if not enabled, bail with an error */
+  if (! scr_enabled) {
+    return SCR_FAILURE;
+  }
+
+  /* bail out if not initialized -- will get bad results */
+  if (! scr_initialized) {
+    scr_abort(-1, "SCR has not been initialized @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
 
-    /* get the filemap for this checkpoint */
-    scr_filemap* map = scr_filemap_new();
-    scr_cache_get_map(scr_cindex, scr_dataset_id, map);
+  /* the request refers to the dataset being completed */
+  *req = scr_dataset_id;
 
-    /* loop over each file in the map */
-    int found_file = 0;
-    kvtree_elem* file_elem;
-    for (file_elem = scr_filemap_first_file(map);
-         file_elem != NULL;
-         file_elem = kvtree_elem_next(file_elem))
-    {
-      /* get the filename */
-      char* mapfile = kvtree_elem_key(file_elem);
-
-      /* get meta data for this file */
-      scr_meta* meta = scr_meta_new();
-      if (scr_filemap_get_meta(map, mapfile, meta) == SCR_SUCCESS) {
-        /* lookup basename for this file from meta data */
-        char* origname = NULL;
-        if (scr_meta_get_origname(meta, &origname) == SCR_SUCCESS) {
-          /* check whether basename in meta matches basename of input file */
-          if (strcmp(origname, newfilebase) == 0) {
-            /* found a matching base name in our file map,
-             * overwrite output file path in newfile with
-             * full path to checkpoint file */
-            strncpy(newfile, mapfile, SCR_MAX_FILENAME);
-            found_file = 1;
-          }
-        }
-      }
-      scr_meta_delete(&meta);
+  return scr_complete_output_start(valid);
+}
 
-      /* stop looping early if we found the file */
-      if (found_file) {
-        break;
-      }
-    }
+/* set flag to 1 if SCR has finished with the output of req, 0 otherwise */
+int SCR_Test_output(SCR_Request req, int* flag)
+{
+  /* manage state transition */
+  if (scr_state != SCR_STATE_IDLE) {
+    scr_state_transition_error(scr_state, "SCR_Test_output()", __FILE__, __LINE__);
+  }
 
-    /* free the filemap */
-    scr_filemap_delete(&map);
+  /* if not enabled, bail with an error */
+  if (! scr_enabled) {
+    return SCR_FAILURE;
+  }
 
-    /* free the base name of new file */
-    scr_free(&newfilebase);
+  /* bail out if not initialized -- will get bad results */
+  if (! scr_initialized) {
+    scr_abort(-1, "SCR has not been initialized @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
 
-    /* return an error if we failed to find the basename in the file map */
-    if (! found_file) {
-      return SCR_FAILURE;
-    }
+  /* check that we have a flag variable to write to */
+  if (flag == NULL) {
+    return SCR_FAILURE;
+  }
 
-    /* if we can't read the file, return an error */
-    if (scr_file_is_readable(newfile) != SCR_SUCCESS) {
-      return SCR_FAILURE;
-    }
+  /* check that the request refers to the latest output */
+  if (req != scr_output_req_id) {
+    scr_err("Invalid output request %d @ %s:%d",
+      req, __FILE__, __LINE__
+    );
+    *flag = 0;
+    return SCR_FAILURE;
   }
 
+  /* make progress, and report the result once the output is done */
+  scr_complete_output_test(flag);
+  if (*flag) {
+    return scr_output_rc;
+  }
   return SCR_SUCCESS;
 }
 
-/* inform library that the current dataset is complete */
-int SCR_Complete_output(int valid)
+/* wait for SCR to finish with the output of req */
+int SCR_Wait_output(SCR_Request req)
 {
   /* manage state transition */
-  if (scr_state != SCR_STATE_OUTPUT) {
-    scr_abort(-1, "Must call SCR_Start_output() before SCR_Complete_output() @ %s:%d",
-      __FILE__, __LINE__
-    );
+  if (scr_state != SCR_STATE_IDLE) {
+    scr_state_transition_error(scr_state, "SCR_Wait_output()", __FILE__, __LINE__);
   }
-  scr_state = SCR_STATE_IDLE;
 
   /* if not enabled, bail with an error */
   if (! scr_enabled) {
@@ -3238,7 +5206,15 @@ int SCR_Complete_output(int valid)
     return SCR_FAILURE;
   }
 
-  return scr_complete_output(valid);
+  /* check that the request refers to the latest output */
+  if (req != scr_output_req_id) {
+    scr_err("Invalid output request %d @ %s:%d",
+      req, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  return scr_complete_output_wait();
 }
 
 /* completes the checkpoint set and marks it as valid or not */
@@ -3358,6 +5334,21 @@ int SCR_Start_restart(char* name)
     return SCR_FAILURE;
   }
 
+  /* look up the working directory again when routing files */
+  scr_route_cwd_valid = 0;
+
+  /* the application reads its files directly, so write out any
+   * files of the checkpoint kept compressed in cache */
+  int valid = (scr_cache_compress_restore(scr_cindex, scr_ckpt_dset_id) == SCR_SUCCESS);
+  if (! scr_alltrue(valid, scr_comm_world)) {
+    if (scr_my_rank_world == 0) {
+      scr_err("Failed to decompress files of checkpoint %d in cache @ %s:%d",
+        scr_ckpt_dset_id, __FILE__, __LINE__
+      );
+    }
+    return SCR_FAILURE;
+  }
+
   /* read dataset name from filemap */
   if (name != NULL) {
     char* dset_name;
@@ -3514,6 +5505,7 @@ int SCR_Complete_restart(int valid)
     /* set flag depending on whether checkpoint_id is greater than 0,
      * we'll take this to mean that we have a checkpoint in cache */
     scr_have_restart = (scr_checkpoint_id > 0);
+    scr_pmix_event_checkpoint(scr_cindex);
   }
 
   return rc;
@@ -3546,26 +5538,311 @@ int SCR_Should_exit(int* flag)
     return SCR_FAILURE;
   }
 
+  /* tell the application to exit right away after a failure,
+   * skipping collectives that may not complete */
+  if (flag != NULL && scr_pmix_event_failed()) {
+    scr_pmix_event_respond(scr_cindex);
+    *flag = 1;
+    return SCR_SUCCESS;
+  }
+
   /* this is not required, but it helps ensure apps
-   * are calling this as a collective */
-  MPI_Barrier(scr_comm_world);
+   * are calling this as a collective, skip it when
+   * deciding asynchronously to avoid synchronizing */
+  if (! scr_decide_async) {
+    MPI_Barrier(scr_comm_world);
+  }
+
+  /* make progress on any outstanding output and async encode */
+  scr_output_progress();
 
   /* check that we have a flag variable to write to */
   if (flag == NULL) {
     return SCR_FAILURE;
   }
 
-  /* assume we don't have to stop */
-  *flag = 0;
+  /* with async decisions, use the decision rank 0 made on our last call */
+  int decided = (scr_decide_async && scr_decide_get(&scr_decide_exit, flag));
+  if (! decided) {
+    /* assume we don't have to stop */
+    *flag = 0;
 
-  /* check whether a halt condition is active */
-  if (scr_bool_check_halt_and_decrement(SCR_TEST_BUT_DONT_HALT, 0)) {
-    *flag = 1;
+    /* check whether a halt condition is active */
+    if (scr_bool_check_halt_and_decrement(SCR_TEST_BUT_DONT_HALT, 0)) {
+      *flag = 1;
+    }
+  }
+
+  /* have rank 0 check the halt condition for our next call
+   * while the application runs */
+  if (scr_decide_async) {
+    int next = 0;
+    if (scr_my_rank_world == 0) {
+      next = scr_halt_test(0, 0);
+    }
+    scr_decide_post(&scr_decide_exit, next);
   }
 
   return SCR_SUCCESS;
 }
 
+/* get statistics on the cost of each phase */
+int SCR_Get_stats(SCR_Stats* stats)
+{
+  /* manage state transition */
+  if (scr_state != SCR_STATE_IDLE) {
+    scr_state_transition_error(scr_state, "SCR_Get_stats()", __FILE__, __LINE__);
+  }
+
+  /* if not enabled, bail with an error */
+  if (! scr_enabled) {
+    return SCR_FAILURE;
+  }
+
+  /* bail out if not initialized -- will get bad results */
+  if (! scr_initialized) {
+    scr_abort(-1, "SCR has not been initialized @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* reduce values across ranks, every rank must take part
+   * even if it has no place to write the result */
+  int rc = scr_stats_get(stats);
+
+  /* check that we have a struct to write to */
+  if (stats == NULL) {
+    return SCR_FAILURE;
+  }
+
+  return rc;
+}
+
+/* register a region of memory to be saved as the named file */
+int SCR_Register_buffer(const char* name, void* ptr, size_t size)
+{
+  /* if not enabled, bail with an error */
+  if (! scr_enabled) {
+    return SCR_FAILURE;
+  }
+
+  /* bail out if not initialized -- will get bad results */
+  if (! scr_initialized) {
+    scr_abort(-1, "SCR has not been initialized @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* check that user's filename is not too long */
+  if (name != NULL && strlen(name) >= SCR_MAX_FILENAME) {
+    scr_abort(-1, "file name (%s) is longer than SCR_MAX_FILENAME (%d) @ %s:%d",
+      name, SCR_MAX_FILENAME, __FILE__, __LINE__
+    );
+  }
+
+  return scr_buffer_register(name, ptr, size, 0);
+}
+
+/* register a region of GPU device memory to be saved as the named file */
+int SCR_Register_device_buffer(const char* name, void* ptr, size_t size)
+{
+  /* if not enabled, bail with an error */
+  if (! scr_enabled) {
+    return SCR_FAILURE;
+  }
+
+  /* bail out if not initialized -- will get bad results */
+  if (! scr_initialized) {
+    scr_abort(-1, "SCR has not been initialized @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* check that user's filename is not too long */
+  if (name != NULL && strlen(name) >= SCR_MAX_FILENAME) {
+    scr_abort(-1, "file name (%s) is longer than SCR_MAX_FILENAME (%d) @ %s:%d",
+      name, SCR_MAX_FILENAME, __FILE__, __LINE__
+    );
+  }
+
+  /* we can only move device memory if we were built with CUDA */
+  if (! scr_buffer_device_available()) {
+    scr_err("SCR was built without GPU support, can not register device buffer %s @ %s:%d",
+      (name != NULL) ? name : "NULL", __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  return scr_buffer_register(name, ptr, size, 1);
+}
+
+/* forget a region registered with SCR_Register_buffer */
+int SCR_Unregister_buffer(const char* name)
+{
+  /* if not enabled, bail with an error */
+  if (! scr_enabled) {
+    return SCR_FAILURE;
+  }
+
+  /* bail out if not initialized -- will get bad results */
+  if (! scr_initialized) {
+    scr_abort(-1, "SCR has not been initialized @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  if (name == NULL) {
+    return SCR_FAILURE;
+  }
+
+  return scr_buffer_unregister(name);
+}
+
+/* returns 1 if the cache of the current dataset is backed by memory */
+static int scr_buffer_in_memory(void)
+{
+  const scr_storedesc* store = scr_cache_get_storedesc(scr_cindex, scr_dataset_id);
+  if (store != NULL && store->memory) {
+    return 1;
+  }
+  return 0;
+}
+
+/* copy contents of a registered region into the current output set */
+int SCR_Write_buffer(const char* name)
+{
+  /* manage state transition */
+  if (scr_state != SCR_STATE_CHECKPOINT &&
+      scr_state != SCR_STATE_OUTPUT)
+  {
+    scr_state_transition_error(scr_state, "SCR_Write_buffer()", __FILE__, __LINE__);
+  }
+
+  /* if not enabled, bail with an error */
+  if (! scr_enabled) {
+    return SCR_FAILURE;
+  }
+
+  /* bail out if not initialized -- will get bad results */
+  if (! scr_initialized) {
+    scr_abort(-1, "SCR has not been initialized @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* look up the region */
+  void* ptr;
+  size_t size;
+  int device;
+  if (name == NULL || scr_buffer_lookup(name, &ptr, &size, &device) != SCR_SUCCESS) {
+    scr_err("No buffer registered as %s @ %s:%d",
+      (name != NULL) ? name : "NULL", __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* route the name so the file is recorded in the filemap
+   * and then protected and flushed like any other file */
+  char file[SCR_MAX_FILENAME];
+  if (SCR_Route_file(name, file) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+
+  if (device) {
+    return scr_buffer_write_device(file, ptr, size, scr_buffer_in_memory());
+  }
+  return scr_buffer_write(file, ptr, size, scr_buffer_in_memory());
+}
+
+/* copy contents of the named file in the current restart set into its registered region */
+int SCR_Read_buffer(const char* name)
+{
+  /* manage state transition */
+  if (scr_state != SCR_STATE_RESTART) {
+    scr_state_transition_error(scr_state, "SCR_Read_buffer()", __FILE__, __LINE__);
+  }
+
+  /* if not enabled, bail with an error */
+  if (! scr_enabled) {
+    return SCR_FAILURE;
+  }
+
+  /* bail out if not initialized -- will get bad results */
+  if (! scr_initialized) {
+    scr_abort(-1, "SCR has not been initialized @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* look up the region */
+  void* ptr;
+  size_t size;
+  int device;
+  if (name == NULL || scr_buffer_lookup(name, &ptr, &size, &device) != SCR_SUCCESS) {
+    scr_err("No buffer registered as %s @ %s:%d",
+      (name != NULL) ? name : "NULL", __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* get the path to the file in cache */
+  char file[SCR_MAX_FILENAME];
+  if (SCR_Route_file(name, file) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+
+  if (device) {
+    return scr_buffer_read_device(file, ptr, size, scr_buffer_in_memory());
+  }
+  return scr_buffer_read(file, ptr, size, scr_buffer_in_memory());
+}
+
+/* map a file of the current restart set read-only into memory */
+int SCR_Map_file(const char* name, const void** ptr, size_t* size)
+{
+  /* manage state transition */
+  if (scr_state != SCR_STATE_RESTART) {
+    scr_state_transition_error(scr_state, "SCR_Map_file()", __FILE__, __LINE__);
+  }
+
+  /* if not enabled, bail with an error */
+  if (! scr_enabled) {
+    return SCR_FAILURE;
+  }
+
+  /* bail out if not initialized -- will get bad results */
+  if (! scr_initialized) {
+    scr_abort(-1, "SCR has not been initialized @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  if (name == NULL || ptr == NULL || size == NULL) {
+    return SCR_FAILURE;
+  }
+
+  /* get the path to the file, this is the prefix directory in bypass mode */
+  char file[SCR_MAX_FILENAME];
+  if (SCR_Route_file(name, file) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+
+  return scr_buffer_map(file, ptr, size);
+}
+
+/* release a mapping made by SCR_Map_file */
+int SCR_Unmap_file(const void* ptr, size_t size)
+{
+  return scr_buffer_unmap(ptr, size);
+}
+
 /* user is telling us which checkpoint they loaded,
  * lookup the dataset and checkpoint ids from the index file,
  * update the current marker */
@@ -3768,6 +6045,9 @@ int SCR_Delete(const char* name)
    * are calling this as a collective */
   MPI_Barrier(scr_comm_world);
 
+  /* finish completing and encoding the latest dataset in case it is the one to delete */
+  scr_output_finish();
+
   /* NOTE: It is possible that two datasets exist with the same name
    * if one is on the parallel file system and a newer one is in cache
    * but has yet to have been flushed.  Those will have two different
@@ -9,6 +9,11 @@
  * Please also read this file: LICENSE.TXT.
 */
 
+#ifndef SCR_H
+#define SCR_H
+
+#include <stddef.h>
+
 /* enable C++ codes to include this header directly */
 #ifdef __cplusplus
 extern "C" {
@@ -69,6 +74,16 @@ const char* SCR_Configf(const char* format, ...);
 /* determine the path and filename to be used to open a file */
 int SCR_Route_file(const char* name, char* file);
 
+/* route each of n files in names, writing each path into a buffer of
+ * SCR_MAX_FILENAME chars in files, equivalent to calling SCR_Route_file
+ * on each name but updates the file list of the dataset only once */
+int SCR_Route_files(int n, const char* names[], char* files[]);
+
+/* tell SCR that the application has closed file, the path returned by
+ * SCR_Route_file, so that SCR can check it while the application
+ * writes its remaining files, called before SCR_Complete_output */
+int SCR_Complete_file(const char* file);
+
 /*****************
  * Restart routines
  ****************/
@@ -107,6 +122,20 @@ int SCR_Start_output(const char* name, int flags);
 /* inform library that the current dataset is complete */
 int SCR_Complete_output(int valid);
 
+/* handle to an output completed with SCR_Icomplete_output */
+typedef int SCR_Request;
+
+/* inform library that the current dataset is complete, but return
+ * before SCR has finished with it, the caller must complete the
+ * request with SCR_Test_output or SCR_Wait_output */
+int SCR_Icomplete_output(int valid, SCR_Request* req);
+
+/* set flag to 1 if SCR has finished with the output of req, 0 otherwise */
+int SCR_Test_output(SCR_Request req, int* flag);
+
+/* wait for SCR to finish with the output of req */
+int SCR_Wait_output(SCR_Request req);
+
 /*****************
  * Dataset management routines
  ****************/
@@ -132,7 +161,79 @@ char* SCR_Get_version(void);
 /* query whether it is time to exit */
 int SCR_Should_exit(int* flag);
 
+/*****************
+ * Statistics routines
+ ****************/
+
+/* phases reported by SCR_Get_stats */
+#define SCR_STATS_WRITE  (0) /* application writing a dataset to cache */
+#define SCR_STATS_ENCODE (1) /* applying the redundancy scheme */
+#define SCR_STATS_FLUSH  (2) /* copying a dataset to the prefix directory */
+#define SCR_STATS_FETCH  (3) /* copying a dataset from the prefix directory */
+#define SCR_STATS_PHASES (4)
+
+/* statistics for one phase, per-rank values give the
+ * min, max, and average across ranks */
+typedef struct {
+  int    count;          /* number of times the phase has run */
+  double bytes;          /* bytes summed across ranks */
+  double secs;           /* seconds, the max across ranks */
+  double bw;             /* bytes / secs in MB/s */
+  double rank_bytes_min; /* bytes on each rank */
+  double rank_bytes_max;
+  double rank_bytes_avg;
+  double rank_secs_min;  /* seconds on each rank */
+  double rank_secs_max;
+  double rank_secs_avg;
+} SCR_Stats_phase;
+
+typedef struct {
+  SCR_Stats_phase last[SCR_STATS_PHASES];  /* most recent run of each phase */
+  SCR_Stats_phase total[SCR_STATS_PHASES]; /* cumulative since SCR_Init */
+  double flush_async_rate;    /* current async flush bandwidth limit in bytes/sec, summed across ranks */
+  double flush_async_backlog; /* bytes left to flush asynchronously, summed across ranks */
+  double flush_async_percent; /* percent of queued async flush bytes that have been flushed */
+  double flush_async_bw;      /* bytes/sec moved by queued async flushes since the oldest started */
+  double flush_async_eta;     /* estimated seconds until queued async flushes finish, -1 if unknown */
+} SCR_Stats;
+
+/* get statistics on the cost of each phase */
+int SCR_Get_stats(SCR_Stats* stats);
+
+/*****************
+ * Memory buffer routines
+ ****************/
+
+/* register size bytes at ptr to be saved as the named file,
+ * registering a name again replaces its region */
+int SCR_Register_buffer(const char* name, void* ptr, size_t size);
+
+/* same as SCR_Register_buffer, but ptr is GPU device memory,
+ * fails if SCR was built without GPU support */
+int SCR_Register_device_buffer(const char* name, void* ptr, size_t size);
+
+/* forget a region registered with SCR_Register_buffer */
+int SCR_Unregister_buffer(const char* name);
+
+/* copy a registered region into the current output set,
+ * called between SCR_Start_output and SCR_Complete_output */
+int SCR_Write_buffer(const char* name);
+
+/* copy a file of the current restart set into its registered region,
+ * called between SCR_Start_restart and SCR_Complete_restart */
+int SCR_Read_buffer(const char* name);
+
+/* map a file of the current restart set read-only into memory,
+ * called between SCR_Start_restart and SCR_Complete_restart,
+ * release the mapping with SCR_Unmap_file */
+int SCR_Map_file(const char* name, const void** ptr, size_t* size);
+
+/* release a mapping made by SCR_Map_file */
+int SCR_Unmap_file(const void* ptr, size_t size);
+
 /* enable C++ codes to include this header directly */
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
+
+#endif
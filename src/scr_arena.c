@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#include "scr_globals.h"
+
+#include "spath.h"
+
+/* name of the file holding the reserve in the cache directory */
+#define SCR_ARENA_FILE (".arena")
+
+/* returns newly allocated path to the arena file in cache directory dir */
+static char* scr_arena_file(const char* dir)
+{
+  spath* path = spath_from_str(dir);
+  spath_append_str(path, SCR_ARENA_FILE);
+  spath_reduce(path);
+  char* file = spath_strdup(path);
+  spath_delete(&path);
+  return file;
+}
+
+/* resize the arena file to bytes, allocating every page of it if it grows */
+static int scr_arena_set_size(const char* file, unsigned long bytes)
+{
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int fd = scr_open(file, O_RDWR | O_CREAT, mode_file);
+  if (fd < 0) {
+    scr_err("Opening arena file: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  int rc = SCR_SUCCESS;
+  struct stat statbuf;
+  if (fstat(fd, &statbuf) != 0) {
+    rc = SCR_FAILURE;
+  } else if ((unsigned long) statbuf.st_size > bytes) {
+    /* hand pages back to the device for files we are about to write */
+    if (ftruncate(fd, (off_t) bytes) != 0) {
+      scr_err("Failed to shrink arena file %s to %lu bytes: errno=%d %s @ %s:%d",
+        file, bytes, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+  } else if ((unsigned long) statbuf.st_size < bytes) {
+    /* claim pages up front so they are ours when we need them,
+     * the device may be full of datasets that are still being deleted */
+    int ret = posix_fallocate(fd, 0, (off_t) bytes);
+    if (ret != 0) {
+      scr_dbg(2, "Failed to grow arena file %s to %lu bytes: %s @ %s:%d",
+        file, bytes, strerror(ret), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+  }
+
+  scr_close(file, fd);
+  return rc;
+}
+
+/* reserve the arena of each enabled redundancy descriptor in its cache
+ * directory, less what datasets rebuilt or fetched into cache already
+ * hold, must be called by all procs after cache index is rebuilt */
+int scr_arena_create(const scr_cache_index* cindex)
+{
+  int rc = SCR_SUCCESS;
+
+  /* get the list of datasets we have in cache */
+  int ndsets;
+  int* dsets;
+  scr_cache_index_list_datasets(cindex, &ndsets, &dsets);
+
+  int i;
+  for (i = 0; i < scr_nreddescs; i++) {
+    scr_reddesc* reddesc = &scr_reddescs[i];
+    scr_storedesc* store = scr_reddesc_get_store(reddesc);
+    if (! reddesc->enabled || store == NULL || store->arena_bytes == 0) {
+      continue;
+    }
+
+    /* count the bytes we hold on this store */
+    unsigned long used = 0;
+    int j;
+    for (j = 0; j < ndsets; j++) {
+      char* dataset_dir;
+      scr_cache_index_get_dir(cindex, dsets[j], &dataset_dir);
+      if (scr_storedescs_index_from_child_path(dataset_dir) == store->index) {
+        used += scr_cache_get_bytes(cindex, dsets[j]);
+      }
+    }
+
+    double time_start = MPI_Wtime();
+    if (scr_arena_fit(store, reddesc->directory, used, 0) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+    if (store->rank == 0) {
+      scr_dbg(2, "Reserved arena in %s in %f secs",
+        reddesc->directory, MPI_Wtime() - time_start
+      );
+    }
+  }
+
+  scr_free(&dsets);
+  return rc;
+}
+
+/* delete the arena of each redundancy descriptor from its cache directory */
+void scr_arena_delete(void)
+{
+  int i;
+  for (i = 0; i < scr_nreddescs; i++) {
+    scr_reddesc* reddesc = &scr_reddescs[i];
+    scr_storedesc* store = scr_reddesc_get_store(reddesc);
+    if (! reddesc->enabled || store == NULL || store->arena_bytes == 0) {
+      continue;
+    }
+
+    if (store->rank == 0) {
+      char* file = scr_arena_file(reddesc->directory);
+      scr_file_unlink(file);
+      scr_free(&file);
+    }
+  }
+}
+
+/* return number of bytes currently held by the arena in cache directory
+ * dir, only meaningful on rank 0 of the store */
+unsigned long scr_arena_bytes(const scr_storedesc* store, const char* dir)
+{
+  if (store == NULL || store->arena_bytes == 0 || dir == NULL || store->rank != 0) {
+    return 0;
+  }
+
+  char* file = scr_arena_file(dir);
+  unsigned long bytes = scr_file_size(file);
+  scr_free(&file);
+  return bytes;
+}
+
+/* shrink or grow the arena in cache directory dir so that it holds what
+ * is left of the store arena after the used bytes that procs hold in
+ * cache and the bytes they need for the next dataset, collective over
+ * the procs of the store */
+int scr_arena_fit(
+  const scr_storedesc* store,
+  const char* dir,
+  unsigned long used,
+  unsigned long need)
+{
+  if (store == NULL || store->arena_bytes == 0 || dir == NULL) {
+    return SCR_SUCCESS;
+  }
+
+  /* sum over procs that share the device */
+  unsigned long bytes[2] = {used, need};
+  unsigned long sums[2];
+  MPI_Allreduce(bytes, sums, 2, MPI_UNSIGNED_LONG, MPI_SUM, store->comm);
+
+  int rc = SCR_SUCCESS;
+  if (store->rank == 0) {
+    unsigned long take = sums[0] + sums[1];
+    unsigned long size = (take < store->arena_bytes) ? store->arena_bytes - take : 0;
+    char* file = scr_arena_file(dir);
+    rc = scr_arena_set_size(file, size);
+    scr_free(&file);
+  }
+
+  MPI_Bcast(&rc, 1, MPI_INT, 0, store->comm);
+  return rc;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_ARENA_H
+#define SCR_ARENA_H
+
+#include "scr_storedesc.h"
+#include "scr_cache_index.h"
+
+/*
+=========================================
+This file reserves memory for datasets on stores backed by memory.
+With an ARENA size set on a store, one process on each node allocates a
+file of that many bytes in the cache directory during SCR_Init, so the
+pages are claimed before the application grows into them.  The arena is
+sized once rebuild and fetch have placed any restart dataset in cache,
+so it only claims what those datasets left over.  Before each new
+dataset, the arena gives back what datasets in cache and the next
+dataset need, and it takes back pages of datasets that were deleted.
+The file is removed when the cache is purged and in SCR_Finalize.
+=========================================
+*/
+
+/* reserve the arena of each enabled redundancy descriptor in its cache
+ * directory, less what datasets rebuilt or fetched into cache already
+ * hold, must be called by all procs after cache index is rebuilt */
+int scr_arena_create(const scr_cache_index* cindex);
+
+/* delete the arena of each redundancy descriptor from its cache directory */
+void scr_arena_delete(void);
+
+/* return number of bytes currently held by the arena in cache directory
+ * dir, only meaningful on rank 0 of the store */
+unsigned long scr_arena_bytes(const scr_storedesc* store, const char* dir);
+
+/* shrink or grow the arena in cache directory dir so that it holds what
+ * is left of the store arena after the used bytes that procs hold in
+ * cache and the bytes they need for the next dataset, collective over
+ * the procs of the store */
+int scr_arena_fit(
+  const scr_storedesc* store,
+  const char* dir,
+  unsigned long used,
+  unsigned long need
+);
+
+#endif
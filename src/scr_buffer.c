@@ -0,0 +1,683 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+/* O_DIRECT */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "scr_conf.h"
+#include "scr.h"
+#include "scr_err.h"
+#include "scr_io.h"
+#include "scr_util.h"
+#include "scr_buffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#ifdef HAVE_CUDA
+#include <cuda_runtime.h>
+#endif
+
+#ifdef HAVE_CUFILE
+#include <cufile.h>
+#endif
+
+/* a region of application memory registered with SCR */
+typedef struct {
+  char*  name;   /* name of file the region is saved as */
+  void*  ptr;    /* start of region */
+  size_t size;   /* number of bytes in region */
+  int    device; /* whether region is in GPU device memory */
+} scr_buffer;
+
+static scr_buffer* scr_buffers = NULL; /* list of registered regions */
+static int scr_buffers_count   = 0;    /* number of entries in list */
+
+#ifdef HAVE_CUFILE
+/* whether the GPUDirect Storage driver is open (1), failed to open (-1),
+ * or has not been tried (0) */
+static int scr_buffer_gds_state = 0;
+#endif
+
+/* fault in all pages of a file in memory when we map it, rather than
+ * one page at a time during the copy */
+#ifdef MAP_POPULATE
+#define SCR_BUFFER_MAP_FLAGS (MAP_SHARED | MAP_POPULATE)
+#else
+#define SCR_BUFFER_MAP_FLAGS (MAP_SHARED)
+#endif
+
+/* ask for huge pages to back a large mapping of a file in memory,
+ * which tmpfs honors when mounted with huge=advise or huge=within_size */
+static void scr_buffer_advise_huge(void* addr, size_t size)
+{
+#ifdef MADV_HUGEPAGE
+  madvise(addr, size, MADV_HUGEPAGE);
+#endif
+}
+
+/* return index of region registered under name, or -1 if there is none */
+static int scr_buffer_find(const char* name)
+{
+  int i;
+  for (i = 0; i < scr_buffers_count; i++) {
+    if (strcmp(scr_buffers[i].name, name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* returns 1 if SCR was built with support for GPU device buffers */
+int scr_buffer_device_available(void)
+{
+#ifdef HAVE_CUDA
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+/* register region of size bytes at ptr under name, device is set
+ * if ptr is GPU device memory, replaces any region already registered
+ * with that name */
+int scr_buffer_register(const char* name, void* ptr, size_t size, int device)
+{
+  if (name == NULL || strcmp(name, "") == 0 || (ptr == NULL && size > 0)) {
+    return SCR_FAILURE;
+  }
+
+  /* update the region if the name is already registered */
+  int i = scr_buffer_find(name);
+  if (i >= 0) {
+    scr_buffers[i].ptr    = ptr;
+    scr_buffers[i].size   = size;
+    scr_buffers[i].device = device;
+    return SCR_SUCCESS;
+  }
+
+  /* otherwise add a new entry */
+  scr_buffer* list = (scr_buffer*) realloc(scr_buffers, (scr_buffers_count + 1) * sizeof(scr_buffer));
+  if (list == NULL) {
+    scr_err("Failed to allocate buffer list @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+  scr_buffers = list;
+  scr_buffers[scr_buffers_count].name = strdup(name);
+  scr_buffers[scr_buffers_count].ptr  = ptr;
+  scr_buffers[scr_buffers_count].size = size;
+  scr_buffers[scr_buffers_count].device = device;
+  scr_buffers_count++;
+
+  return SCR_SUCCESS;
+}
+
+/* forget region registered under name */
+int scr_buffer_unregister(const char* name)
+{
+  int i = scr_buffer_find(name);
+  if (i < 0) {
+    return SCR_FAILURE;
+  }
+
+  /* move the last entry into this slot */
+  scr_free(&scr_buffers[i].name);
+  scr_buffers_count--;
+  scr_buffers[i] = scr_buffers[scr_buffers_count];
+  if (scr_buffers_count == 0) {
+    scr_free(&scr_buffers);
+  }
+
+  return SCR_SUCCESS;
+}
+
+/* look up region registered under name, sets device if it is GPU device memory */
+int scr_buffer_lookup(const char* name, void** ptr, size_t* size, int* device)
+{
+  int i = scr_buffer_find(name);
+  if (i < 0) {
+    return SCR_FAILURE;
+  }
+  *ptr    = scr_buffers[i].ptr;
+  *size   = scr_buffers[i].size;
+  *device = scr_buffers[i].device;
+  return SCR_SUCCESS;
+}
+
+/* forget all registered regions */
+int scr_buffer_finalize(void)
+{
+  int i;
+  for (i = 0; i < scr_buffers_count; i++) {
+    scr_free(&scr_buffers[i].name);
+  }
+  scr_free(&scr_buffers);
+  scr_buffers_count = 0;
+
+#ifdef HAVE_CUFILE
+  /* release the GPUDirect Storage driver if we opened it */
+  if (scr_buffer_gds_state > 0) {
+    cuFileDriverClose();
+  }
+  scr_buffer_gds_state = 0;
+#endif
+
+  return SCR_SUCCESS;
+}
+
+/* write size bytes at ptr to file, memory is set if file is on a store backed by memory */
+int scr_buffer_write(const char* file, const void* ptr, size_t size, int memory)
+{
+  int rc = SCR_SUCCESS;
+
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int fd = scr_open(file, O_RDWR | O_CREAT | O_TRUNC, mode_file);
+  if (fd < 0) {
+    scr_err("Opening file for write: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  if (memory && size > 0) {
+    /* size the file and copy the region straight into its pages */
+    if (ftruncate(fd, (off_t) size) != 0) {
+      scr_err("Failed to size file: %s errno=%d %s @ %s:%d",
+        file, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    } else {
+      void* addr = mmap(NULL, size, PROT_WRITE, SCR_BUFFER_MAP_FLAGS, fd, 0);
+      if (addr == MAP_FAILED) {
+        scr_err("Failed to mmap file: %s errno=%d %s @ %s:%d",
+          file, errno, strerror(errno), __FILE__, __LINE__
+        );
+        rc = SCR_FAILURE;
+      } else {
+        scr_buffer_advise_huge(addr, size);
+        memcpy(addr, ptr, size);
+        munmap(addr, size);
+      }
+    }
+  } else if (size > 0) {
+    ssize_t nwrite = scr_write(file, fd, ptr, size);
+    if (nwrite != (ssize_t) size) {
+      rc = SCR_FAILURE;
+    }
+  }
+
+  if (scr_close(file, fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+
+  return rc;
+}
+
+/* read size bytes from file into ptr, fails if the file size differs,
+ * memory is set if file is on a store backed by memory */
+int scr_buffer_read(const char* file, void* ptr, size_t size, int memory)
+{
+  int rc = SCR_SUCCESS;
+
+  int fd = scr_open(file, O_RDONLY);
+  if (fd < 0) {
+    scr_err("Opening file for read: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* the file must hold exactly the registered region */
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) != 0 || (size_t) stat_buf.st_size != size) {
+    scr_err("Size of file %s does not match size of buffer %lu @ %s:%d",
+      file, (unsigned long) size, __FILE__, __LINE__
+    );
+    scr_close(file, fd);
+    return SCR_FAILURE;
+  }
+
+  if (memory && size > 0) {
+    /* copy straight out of the pages of the file */
+    void* addr = mmap(NULL, size, PROT_READ, SCR_BUFFER_MAP_FLAGS, fd, 0);
+    if (addr == MAP_FAILED) {
+      scr_err("Failed to mmap file: %s errno=%d %s @ %s:%d",
+        file, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    } else {
+      memcpy(ptr, addr, size);
+      munmap(addr, size);
+    }
+  } else if (size > 0) {
+    ssize_t nread = scr_read(file, fd, ptr, size);
+    if (nread != (ssize_t) size) {
+      rc = SCR_FAILURE;
+    }
+  }
+
+  scr_close(file, fd);
+
+  return rc;
+}
+
+#ifdef HAVE_CUFILE
+/* open the GPUDirect Storage driver the first time we need it,
+ * returns 1 if it can be used */
+static int scr_buffer_gds_open(void)
+{
+  if (scr_buffer_gds_state == 0) {
+    CUfileError_t status = cuFileDriverOpen();
+    scr_buffer_gds_state = (status.err == CU_FILE_SUCCESS) ? 1 : -1;
+    if (scr_buffer_gds_state < 0) {
+      scr_dbg(1, "GPUDirect Storage is not available, staging device buffers through host memory");
+    }
+  }
+  return (scr_buffer_gds_state > 0);
+}
+
+/* move size bytes between device memory at ptr and file with GPUDirect
+ * Storage, writing if write is set and reading otherwise, sets fallback
+ * if the file can not be used with GPUDirect Storage, e.g., because its
+ * file system does not support O_DIRECT, so the caller can stage it */
+static int scr_buffer_gds_xfer(const char* file, void* ptr, size_t size, int write, int* fallback)
+{
+  *fallback = 1;
+  if (! scr_buffer_gds_open()) {
+    return SCR_FAILURE;
+  }
+
+  int fd;
+  if (write) {
+    mode_t mode_file = scr_getmode(1, 1, 0);
+    fd = open(file, O_RDWR | O_CREAT | O_TRUNC | O_DIRECT, mode_file);
+  } else {
+    fd = open(file, O_RDONLY | O_DIRECT);
+  }
+  if (fd < 0) {
+    return SCR_FAILURE;
+  }
+
+  CUfileDescr_t descr;
+  memset(&descr, 0, sizeof(descr));
+  descr.handle.fd = fd;
+  descr.type      = CU_FILE_HANDLE_TYPE_OPAQUE_FD;
+
+  CUfileHandle_t handle;
+  CUfileError_t status = cuFileHandleRegister(&handle, &descr);
+  if (status.err != CU_FILE_SUCCESS) {
+    close(fd);
+    return SCR_FAILURE;
+  }
+
+  /* from here on errors are real errors */
+  *fallback = 0;
+
+  int rc = SCR_SUCCESS;
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n;
+    if (write) {
+      n = cuFileWrite(handle, ptr, size - done, (off_t) done, (off_t) done);
+    } else {
+      n = cuFileRead(handle, ptr, size - done, (off_t) done, (off_t) done);
+    }
+    if (n <= 0) {
+      scr_err("GPUDirect Storage %s failed: %s rc=%ld @ %s:%d",
+        (write ? "write" : "read"), file, (long) n, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+      break;
+    }
+    done += (size_t) n;
+  }
+
+  cuFileHandleDeregister(handle);
+
+  if (scr_close(file, fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+
+  return rc;
+}
+#endif
+
+#ifdef HAVE_CUDA
+/* report a failed CUDA call, returns SCR_FAILURE if err is an error */
+static int scr_buffer_cuda_check(cudaError_t err, const char* what, const char* file)
+{
+  if (err != cudaSuccess) {
+    scr_err("%s failed for %s: %s",
+      what, file, cudaGetErrorString(err)
+    );
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
+
+/* write size bytes of device memory at ptr to the open file, copying
+ * the next chunk off the device while the current one is written */
+static int scr_buffer_stage_write(const char* file, int fd, const void* ptr, size_t size)
+{
+  size_t chunk = SCR_DEVICE_STAGE_SIZE;
+  char* host[2] = {NULL, NULL};
+  cudaStream_t stream;
+  if (scr_buffer_cuda_check(cudaStreamCreate(&stream), "cudaStreamCreate", file) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+  if (scr_buffer_cuda_check(cudaMallocHost((void**) &host[0], chunk), "cudaMallocHost", file) != SCR_SUCCESS ||
+      scr_buffer_cuda_check(cudaMallocHost((void**) &host[1], chunk), "cudaMallocHost", file) != SCR_SUCCESS)
+  {
+    cudaFreeHost(host[0]);
+    cudaStreamDestroy(stream);
+    return SCR_FAILURE;
+  }
+
+  int rc = SCR_SUCCESS;
+  const char* src = (const char*) ptr;
+  size_t offset = 0;
+  size_t count = (size < chunk) ? size : chunk;
+  int cur = 0;
+  if (count > 0) {
+    cudaMemcpyAsync(host[cur], src, count, cudaMemcpyDeviceToHost, stream);
+  }
+  while (offset < size) {
+    if (scr_buffer_cuda_check(cudaStreamSynchronize(stream), "cudaMemcpyAsync", file) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+      break;
+    }
+
+    /* start on the next chunk before writing this one */
+    size_t next_offset = offset + count;
+    size_t next_count  = (size - next_offset < chunk) ? (size - next_offset) : chunk;
+    if (next_count > 0) {
+      cudaMemcpyAsync(host[!cur], src + next_offset, next_count, cudaMemcpyDeviceToHost, stream);
+    }
+
+    ssize_t nwrite = scr_write(file, fd, host[cur], count);
+    if (nwrite != (ssize_t) count) {
+      rc = SCR_FAILURE;
+      break;
+    }
+
+    offset = next_offset;
+    count  = next_count;
+    cur    = !cur;
+  }
+
+  /* wait on any copy still in flight before releasing its buffer */
+  cudaStreamSynchronize(stream);
+  cudaFreeHost(host[0]);
+  cudaFreeHost(host[1]);
+  cudaStreamDestroy(stream);
+
+  return rc;
+}
+
+/* read size bytes from the open file into device memory at ptr,
+ * reading the next chunk while the current one is copied to the device */
+static int scr_buffer_stage_read(const char* file, int fd, void* ptr, size_t size)
+{
+  size_t chunk = SCR_DEVICE_STAGE_SIZE;
+  char* host[2] = {NULL, NULL};
+  cudaStream_t stream;
+  if (scr_buffer_cuda_check(cudaStreamCreate(&stream), "cudaStreamCreate", file) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+  if (scr_buffer_cuda_check(cudaMallocHost((void**) &host[0], chunk), "cudaMallocHost", file) != SCR_SUCCESS ||
+      scr_buffer_cuda_check(cudaMallocHost((void**) &host[1], chunk), "cudaMallocHost", file) != SCR_SUCCESS)
+  {
+    cudaFreeHost(host[0]);
+    cudaStreamDestroy(stream);
+    return SCR_FAILURE;
+  }
+
+  int rc = SCR_SUCCESS;
+  char* dst = (char*) ptr;
+  size_t offset = 0;
+  int cur = 0;
+  while (offset < size) {
+    size_t count = (size - offset < chunk) ? (size - offset) : chunk;
+    ssize_t nread = scr_read(file, fd, host[cur], count);
+    if (nread != (ssize_t) count) {
+      rc = SCR_FAILURE;
+      break;
+    }
+
+    /* the copy out of the other buffer must finish before we reuse it */
+    if (scr_buffer_cuda_check(cudaStreamSynchronize(stream), "cudaMemcpyAsync", file) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+      break;
+    }
+    cudaMemcpyAsync(dst + offset, host[cur], count, cudaMemcpyHostToDevice, stream);
+
+    offset += count;
+    cur = !cur;
+  }
+
+  if (scr_buffer_cuda_check(cudaStreamSynchronize(stream), "cudaMemcpyAsync", file) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  cudaFreeHost(host[0]);
+  cudaFreeHost(host[1]);
+  cudaStreamDestroy(stream);
+
+  return rc;
+}
+#endif
+
+/* same as scr_buffer_write, but ptr is GPU device memory */
+int scr_buffer_write_device(const char* file, const void* ptr, size_t size, int memory)
+{
+#ifdef HAVE_CUDA
+#ifdef HAVE_CUFILE
+  /* write straight from the device to the file if we can */
+  if (! memory && size > 0) {
+    int fallback;
+    int gds_rc = scr_buffer_gds_xfer(file, (void*) ptr, size, 1, &fallback);
+    if (! fallback) {
+      return gds_rc;
+    }
+  }
+#endif
+
+  int rc = SCR_SUCCESS;
+
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int fd = scr_open(file, O_RDWR | O_CREAT | O_TRUNC, mode_file);
+  if (fd < 0) {
+    scr_err("Opening file for write: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  if (memory && size > 0) {
+    /* size the file and copy the region from the device into its pages */
+    if (ftruncate(fd, (off_t) size) != 0) {
+      scr_err("Failed to size file: %s errno=%d %s @ %s:%d",
+        file, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    } else {
+      void* addr = mmap(NULL, size, PROT_WRITE, SCR_BUFFER_MAP_FLAGS, fd, 0);
+      if (addr == MAP_FAILED) {
+        scr_err("Failed to mmap file: %s errno=%d %s @ %s:%d",
+          file, errno, strerror(errno), __FILE__, __LINE__
+        );
+        rc = SCR_FAILURE;
+      } else {
+        scr_buffer_advise_huge(addr, size);
+        rc = scr_buffer_cuda_check(cudaMemcpy(addr, ptr, size, cudaMemcpyDeviceToHost), "cudaMemcpy", file);
+        munmap(addr, size);
+      }
+    }
+  } else if (size > 0) {
+    rc = scr_buffer_stage_write(file, fd, ptr, size);
+  }
+
+  if (scr_close(file, fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+
+  return rc;
+#else
+  scr_err("SCR was built without CUDA support, can not write device buffer to %s @ %s:%d",
+    file, __FILE__, __LINE__
+  );
+  return SCR_FAILURE;
+#endif
+}
+
+/* same as scr_buffer_read, but ptr is GPU device memory */
+int scr_buffer_read_device(const char* file, void* ptr, size_t size, int memory)
+{
+#ifdef HAVE_CUDA
+  /* the file must hold exactly the registered region */
+  unsigned long filesize = scr_file_size(file);
+  if (scr_file_exists(file) != SCR_SUCCESS || (size_t) filesize != size) {
+    scr_err("Size of file %s does not match size of buffer %lu @ %s:%d",
+      file, (unsigned long) size, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+#ifdef HAVE_CUFILE
+  /* read straight from the file into the device if we can */
+  if (! memory && size > 0) {
+    int fallback;
+    int gds_rc = scr_buffer_gds_xfer(file, ptr, size, 0, &fallback);
+    if (! fallback) {
+      return gds_rc;
+    }
+  }
+#endif
+
+  int rc = SCR_SUCCESS;
+
+  int fd = scr_open(file, O_RDONLY);
+  if (fd < 0) {
+    scr_err("Opening file for read: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  if (memory && size > 0) {
+    /* copy straight out of the pages of the file onto the device */
+    void* addr = mmap(NULL, size, PROT_READ, SCR_BUFFER_MAP_FLAGS, fd, 0);
+    if (addr == MAP_FAILED) {
+      scr_err("Failed to mmap file: %s errno=%d %s @ %s:%d",
+        file, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    } else {
+      rc = scr_buffer_cuda_check(cudaMemcpy(ptr, addr, size, cudaMemcpyHostToDevice), "cudaMemcpy", file);
+      munmap(addr, size);
+    }
+  } else if (size > 0) {
+    rc = scr_buffer_stage_read(file, fd, ptr, size);
+  }
+
+  scr_close(file, fd);
+
+  return rc;
+#else
+  scr_err("SCR was built without CUDA support, can not read device buffer from %s @ %s:%d",
+    file, __FILE__, __LINE__
+  );
+  return SCR_FAILURE;
+#endif
+}
+
+/* map file read-only into memory and ask the kernel to read it ahead,
+ * sets ptr to NULL for an empty file */
+int scr_buffer_map(const char* file, const void** ptr, size_t* size)
+{
+  *ptr  = NULL;
+  *size = 0;
+
+  int fd = scr_open(file, O_RDONLY);
+  if (fd < 0) {
+    scr_err("Opening file for read: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) != 0) {
+    scr_err("Failed to stat file: %s errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_close(file, fd);
+    return SCR_FAILURE;
+  }
+
+  /* nothing to map */
+  size_t len = (size_t) stat_buf.st_size;
+  if (len == 0) {
+    scr_close(file, fd);
+    return SCR_SUCCESS;
+  }
+
+#if !defined(__APPLE__)
+  /* start reading the file in before the first page fault,
+   * the advice values are not flags, so each takes its own call */
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+
+  void* addr = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    scr_err("Failed to mmap file: %s errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_close(file, fd);
+    return SCR_FAILURE;
+  }
+
+  /* the mapping holds its own reference to the file */
+  scr_close(file, fd);
+
+  madvise(addr, len, MADV_SEQUENTIAL);
+  madvise(addr, len, MADV_WILLNEED);
+
+  *ptr  = addr;
+  *size = len;
+  return SCR_SUCCESS;
+}
+
+/* release a mapping made by scr_buffer_map */
+int scr_buffer_unmap(const void* ptr, size_t size)
+{
+  if (ptr == NULL || size == 0) {
+    return SCR_SUCCESS;
+  }
+
+  if (munmap((void*) ptr, size) != 0) {
+    scr_err("Failed to munmap region of %lu bytes errno=%d %s @ %s:%d",
+      (unsigned long) size, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_BUFFER_H
+#define SCR_BUFFER_H
+
+#include <stddef.h>
+
+/*
+=========================================
+This file tracks memory regions registered with SCR_Register_buffer
+and copies them between memory and files in cache.  For stores backed
+by memory, the file is mapped so its pages are filled and read with
+a single memcpy.  Regions in GPU device memory are written with
+GPUDirect Storage where it is available, copied straight into the
+pages of memory-backed files, and otherwise staged through pinned
+host buffers.
+=========================================
+*/
+
+/* returns 1 if SCR was built with support for GPU device buffers */
+int scr_buffer_device_available(void);
+
+/* register region of size bytes at ptr under name, device is set
+ * if ptr is GPU device memory, replaces any region already registered
+ * with that name */
+int scr_buffer_register(const char* name, void* ptr, size_t size, int device);
+
+/* forget region registered under name */
+int scr_buffer_unregister(const char* name);
+
+/* look up region registered under name, sets device if it is GPU device memory */
+int scr_buffer_lookup(const char* name, void** ptr, size_t* size, int* device);
+
+/* forget all registered regions */
+int scr_buffer_finalize(void);
+
+/* write size bytes at ptr to file, memory is set if file is on a store backed by memory */
+int scr_buffer_write(const char* file, const void* ptr, size_t size, int memory);
+
+/* read size bytes from file into ptr, fails if the file size differs,
+ * memory is set if file is on a store backed by memory */
+int scr_buffer_read(const char* file, void* ptr, size_t size, int memory);
+
+/* same as scr_buffer_write, but ptr is GPU device memory */
+int scr_buffer_write_device(const char* file, const void* ptr, size_t size, int memory);
+
+/* same as scr_buffer_read, but ptr is GPU device memory */
+int scr_buffer_read_device(const char* file, void* ptr, size_t size, int memory);
+
+/* map file read-only into memory and ask the kernel to read it ahead,
+ * sets ptr to NULL for an empty file */
+int scr_buffer_map(const char* file, const void** ptr, size_t* size);
+
+/* release a mapping made by scr_buffer_map */
+int scr_buffer_unmap(const void* ptr, size_t size);
+
+#endif
@@ -16,12 +16,64 @@
 #include "spath.h"
 #include "kvtree.h"
 
+#include <pthread.h>
+#include <limits.h>
+
 /*
 =========================================
 Dataset cache functions
 =========================================
 */
 
+/* directories of the next dataset, made ahead of time by a background
+ * thread on the process that creates directories on their store */
+static pthread_t scr_cache_prep_thread;
+static int   scr_cache_prep_started = 0;    /* whether thread was started */
+static int   scr_cache_prep_rc      = SCR_SUCCESS; /* result of thread */
+static char* scr_cache_prep_dir     = NULL; /* dataset directory */
+static char* scr_cache_prep_dir_scr = NULL; /* hidden .scr directory within it */
+
+/* create the prepared directories, runs in its own thread */
+static void* scr_cache_prep_run(void* arg)
+{
+  mode_t mode_dir = S_IRWXU | S_IRWXG;
+  int rc = scr_mkdir(scr_cache_prep_dir, mode_dir);
+  if (rc == SCR_SUCCESS) {
+    rc = scr_mkdir(scr_cache_prep_dir_scr, mode_dir);
+  }
+  scr_cache_prep_rc = rc;
+  return NULL;
+}
+
+/* wait for the thread, and unless the prepared directories are dir,
+ * remove them again if nothing was written to them */
+static void scr_cache_prep_finish(const char* dir)
+{
+  if (scr_cache_prep_dir == NULL) {
+    return;
+  }
+
+  if (scr_cache_prep_started) {
+    pthread_join(scr_cache_prep_thread, NULL);
+    scr_cache_prep_started = 0;
+    if (scr_cache_prep_rc != SCR_SUCCESS) {
+      scr_dbg(1, "Failed to create %s ahead of time @ %s:%d",
+        scr_cache_prep_dir, __FILE__, __LINE__
+      );
+    }
+
+    /* rmdir only removes empty directories, so this never drops data */
+    if (dir == NULL || strcmp(dir, scr_cache_prep_dir) != 0) {
+      scr_dbg(2, "Removing unused directory %s", scr_cache_prep_dir);
+      rmdir(scr_cache_prep_dir_scr);
+      rmdir(scr_cache_prep_dir);
+    }
+  }
+
+  scr_free(&scr_cache_prep_dir_scr);
+  scr_free(&scr_cache_prep_dir);
+}
+
 static char* scr_cache_dir_from_str(const char* dir, const char* storage_view, int id)
 {
   /* build the dataset directory name */
@@ -100,6 +152,91 @@ char* scr_cache_dir_hidden_get(const scr_reddesc* red, int id)
   return str;
 }
 
+/* returns name of the dataset directory on the given stripe store of a
+ * redundancy descriptor, caller must free returned string */
+char* scr_cache_stripe_dir_get(const scr_reddesc* red, int stripe, int id)
+{
+  scr_storedesc* store = scr_reddesc_get_stripe_store(red, stripe);
+  if (store == NULL) {
+    scr_abort(-1, "Invalid stripe %d of redundancy descriptor @ %s:%d",
+      stripe, __FILE__, __LINE__
+    );
+  }
+  return scr_cache_dir_from_str(red->stripe_dirs[stripe], store->view, id);
+}
+
+/* return the redundancy descriptor that places dataset id in dir if it
+ * stripes files across other stores, returns NULL on all procs unless
+ * all procs find the same descriptor */
+static const scr_reddesc* scr_cache_stripe_reddesc(const char* dir, int id)
+{
+  /* all procs have the same descriptors, so skip the
+   * collective if none of them stripes files */
+  int any = 0;
+  int i;
+  for (i = 0; i < scr_nreddescs; i++) {
+    if (scr_reddescs[i].enabled && scr_reddescs[i].stripe_count > 0) {
+      any = 1;
+    }
+  }
+  if (! any) {
+    return NULL;
+  }
+
+  int index = -1;
+  for (i = 0; i < scr_nreddescs && dir != NULL; i++) {
+    const scr_reddesc* d = &scr_reddescs[i];
+    if (! d->enabled || d->stripe_count == 0) {
+      continue;
+    }
+    char* d_dir = scr_cache_dir_get(d, id);
+    int match = (strcmp(d_dir, dir) == 0);
+    scr_free(&d_dir);
+    if (match) {
+      index = i;
+      break;
+    }
+  }
+
+  /* stripe directories are created and removed collectively */
+  int range[2] = {index, -index};
+  int all[2];
+  scr_allreduce(range, all, 2, MPI_INT, MPI_MIN, scr_comm_world);
+  if (index < 0 || all[0] != index || -all[1] != index) {
+    return NULL;
+  }
+  return &scr_reddescs[index];
+}
+
+/* create the directories on the stripe stores for dataset id that is
+ * placed in dir, does nothing if its descriptor does not stripe files,
+ * must be called by all procs */
+int scr_cache_stripe_dirs_create(const char* dir, int id)
+{
+  int rc = SCR_SUCCESS;
+
+  const scr_reddesc* red = scr_cache_stripe_reddesc(dir, id);
+  if (red == NULL) {
+    return rc;
+  }
+
+  int i;
+  for (i = 0; i < red->stripe_count; i++) {
+    scr_storedesc* store = scr_reddesc_get_stripe_store(red, i);
+    char* stripe_dir = scr_cache_stripe_dir_get(red, i, id);
+    scr_reclaim_reuse(stripe_dir);
+    if (scr_storedesc_dir_create(store, stripe_dir) != SCR_SUCCESS) {
+      scr_err("Failed to create dataset directory %s @ %s:%d",
+        stripe_dir, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+    scr_free(&stripe_dir);
+  }
+
+  return rc;
+}
+
 /* create a dataset directory given a redundancy descriptor and dataset id,
  * waits for all tasks on the same node before returning */
 int scr_cache_dir_create(const scr_reddesc* red, int id)
@@ -109,8 +246,10 @@ int scr_cache_dir_create(const scr_reddesc* red, int id)
   /* get store descriptor for this redudancy descriptor */
   scr_storedesc* store = scr_reddesc_get_store(red);
   if (store != NULL) {
-    /* create directory on store */
+    /* create directory on store, it may have been made ahead of time */
     char* dir = scr_cache_dir_get(red, id);
+    scr_cache_prep_finish(dir);
+    scr_reclaim_reuse(dir);
     if (scr_storedesc_dir_create(store, dir) != SCR_SUCCESS) {
       /* check that we created the directory successfully,
        * fatal error if not */
@@ -128,6 +267,19 @@ int scr_cache_dir_create(const scr_reddesc* red, int id)
       );
     }
     scr_free(&dir_scr);
+
+    /* create directories on the other stores we stripe files across,
+     * files of an earlier dataset with this id in them were queued
+     * with the dataset directory we waited for above */
+    if (red->stripe_count > 0) {
+      char* dir = scr_cache_dir_get(red, id);
+      if (scr_cache_stripe_dirs_create(dir, id) != SCR_SUCCESS) {
+        scr_abort(-1, "Failed to create stripe directories of dataset %d, aborting @ %s:%d",
+          id, __FILE__, __LINE__
+        );
+      }
+      scr_free(&dir);
+    }
   } else {
     scr_abort(-1, "Invalid store descriptor @ %s:%d",
       __FILE__, __LINE__
@@ -137,6 +289,47 @@ int scr_cache_dir_create(const scr_reddesc* red, int id)
   return rc;
 }
 
+/* start creating the directories of dataset id for red in the
+ * background, so creating them again later only has to sync */
+int scr_cache_dir_prepare(const scr_reddesc* red, int id)
+{
+  /* drop what we prepared before */
+  scr_cache_prep_finish(NULL);
+
+  scr_storedesc* store = scr_reddesc_get_store(red);
+  if (store == NULL || ! store->enabled) {
+    return SCR_FAILURE;
+  }
+
+  scr_cache_prep_dir     = scr_cache_dir_get(red, id);
+  scr_cache_prep_dir_scr = scr_cache_dir_hidden_get(red, id);
+
+  /* the directories may still be queued for removal from an earlier
+   * dataset with the same id, leave them to scr_cache_dir_create then */
+  if (! scr_storedesc_dir_owner(store) ||
+      access(scr_cache_prep_dir, F_OK) == 0)
+  {
+    return SCR_SUCCESS;
+  }
+
+  scr_cache_prep_rc = SCR_SUCCESS;
+  if (pthread_create(&scr_cache_prep_thread, NULL, scr_cache_prep_run, NULL) != 0) {
+    scr_dbg(1, "Failed to start thread to create %s @ %s:%d",
+      scr_cache_prep_dir, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+  scr_cache_prep_started = 1;
+
+  return SCR_SUCCESS;
+}
+
+/* wait for directories being prepared, and remove them if unused */
+void scr_cache_dir_prepare_finalize(void)
+{
+  scr_cache_prep_finish(NULL);
+}
+
 /* create and return spath object for map file for calling rank,
  * returns NULL on failure */
 static spath* scr_cache_get_map_path(const scr_cache_index* cindex, int id)
@@ -234,6 +427,100 @@ int scr_cache_unset_map(const scr_cache_index* cindex, int id)
   return SCR_SUCCESS;
 }
 
+/* files that were stat'd when their output was completed, mapped to the
+ * size we found, the checks below trust the meta data of these
+ * files rather than asking the file system again */
+static kvtree* scr_cache_known = NULL;
+
+/* record that file had size bytes when its output was completed */
+void scr_cache_known_set(const char* file, unsigned long size)
+{
+  if (scr_cache_known == NULL) {
+    scr_cache_known = kvtree_new();
+  }
+  kvtree_util_set_unsigned_long(scr_cache_known, file, size);
+}
+
+/* forget what we recorded for file */
+void scr_cache_known_unset(const char* file)
+{
+  if (scr_cache_known != NULL) {
+    kvtree_unset(scr_cache_known, file);
+  }
+}
+
+/* forget about all files */
+void scr_cache_known_free(void)
+{
+  kvtree_delete(&scr_cache_known);
+}
+
+/* return 1 if file was stat'd when its output was completed and its meta
+ * data still agrees, with SCR_FILE_REVALIDATE, also check that its size
+ * and mtime have not changed since then */
+static int scr_cache_known_check(const char* file, const scr_meta* meta)
+{
+  unsigned long size, meta_size;
+  if (scr_cache_known == NULL ||
+      kvtree_util_get_unsigned_long(scr_cache_known, file, &size) != KVTREE_SUCCESS ||
+      scr_meta_get_filesize(meta, &meta_size) != SCR_SUCCESS ||
+      size != meta_size)
+  {
+    return 0;
+  }
+
+  if (scr_file_revalidate) {
+    struct stat stat_buf;
+    if (stat(file, &stat_buf) != 0 ||
+        (unsigned long) stat_buf.st_size != meta_size ||
+        scr_meta_check_mtime(meta, &stat_buf) != SCR_SUCCESS)
+    {
+      scr_dbg(2, "File changed since it was completed: %s @ %s:%d",
+        file, __FILE__, __LINE__
+      );
+      kvtree_unset(scr_cache_known, file);
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/* check in one batch the files of map that scr_bool_have_file and
+ * scr_cache_check_files would otherwise look up one at a time,
+ * call scr_statx_clear once done with the checks */
+int scr_cache_stat_files(const scr_filemap* map)
+{
+  int count = 0;
+  const char** files = (const char**) SCR_MALLOC((scr_filemap_num_files(map) + 1) * sizeof(char*));
+
+  kvtree_elem* file_elem;
+  for (file_elem = scr_filemap_first_file(map);
+       file_elem != NULL;
+       file_elem = kvtree_elem_next(file_elem))
+  {
+    const char* file = kvtree_elem_key(file_elem);
+
+    /* skip files we already trust and files held as blocks */
+    if (scr_cache_known != NULL && kvtree_get(scr_cache_known, file) != NULL) {
+      continue;
+    }
+    scr_meta* meta = scr_meta_new();
+    scr_filemap_get_meta(map, file, meta);
+    int dedup = (scr_meta_get_dedup(meta) != NULL);
+    scr_meta_delete(&meta);
+    if (dedup) {
+      continue;
+    }
+
+    files[count++] = file;
+  }
+
+  int rc = scr_statx_files(count, files);
+  scr_free(&files);
+  return rc;
+}
+
 /* remove all files associated with specified dataset */
 int scr_cache_delete(scr_cache_index* cindex, int id)
 {
@@ -244,6 +531,9 @@ int scr_cache_delete(scr_cache_index* cindex, int id)
     return SCR_SUCCESS;
   }
 
+  scr_trace_mark_begin("delete");
+  scr_stats_add(SCR_STATS_EV_DELETE, 1.0);
+
   /* print a debug messages */
   if (scr_my_rank_world == 0) {
     scr_dataset* dataset = scr_dataset_new();
@@ -273,7 +563,7 @@ int scr_cache_delete(scr_cache_index* cindex, int id)
   scr_filemap* map = scr_filemap_new();
   scr_cache_get_map(cindex, id, map);
   
-  /* for each file we have for this dataset, delete the file */
+  /* for each file we have for this dataset, forget what we know about it */
   kvtree_elem* file_elem;
   for (file_elem = scr_filemap_first_file(map);
        file_elem != NULL;
@@ -281,62 +571,25 @@ int scr_cache_delete(scr_cache_index* cindex, int id)
   {
     /* get the filename */
     char* file = kvtree_elem_key(file_elem); 
-  
-    /* verify that file mtime and ctime have not changed since scr_complete_output,
-     * which could idenitfy a bug in the user's code */
-    struct stat statbuf;
-    int stat_rc = stat(file, &statbuf);
-    if (stat_rc == 0) {
-      scr_meta* meta = scr_meta_new();
-      scr_filemap_get_meta(map, file, meta);
-
-      int file_changed = 0;
-
-      /* check that file contents have not been modified */
-      if (scr_meta_check_mtime(meta, &statbuf) != SCR_SUCCESS) {
-        file_changed = 1;
-        scr_warn("Detected mtime change in file `%s' since it was completed @ %s:%d",
-          file, __FILE__, __LINE__
-        );
-      }
 
-      /* check that permission bits, uid, and gid have not changed */
-      if (scr_meta_check_metadata(meta, &statbuf) != SCR_SUCCESS) {
-        file_changed = 1;
-        scr_warn("Detected change in mode bits, uid, or gid on file `%s' since it was completed @ %s:%d",
-          file, __FILE__, __LINE__
-        );
-      }
-
-      if (file_changed) {
-        scr_warn("Detected change in file `%s' since it was completed @ %s:%d",
-          file, __FILE__, __LINE__
-        );
-      }
-
-      scr_meta_delete(&meta);
-    }
+    /* the file is going away */
+    scr_cache_known_unset(file);
   
-    /* check file's crc value (monitor that cache hardware isn't corrupting
-     * files on us) */
-    if (scr_crc_on_delete) {
-      /* TODO: if corruption, need to log */
-      if (scr_compute_crc(map, file) != SCR_SUCCESS) {
-        scr_err("Failed to verify CRC32 before deleting file %s, bad drive? @ %s:%d",
-          file, __FILE__, __LINE__
-        );
-      }
-    }
-
-    /* if we're not using bypass, delete data files from cache */
-    if (! bypass) {
-      /* delete the file */
-      scr_file_unlink(file);
+    /* a deduplicated file only holds references to blocks in the store,
+     * dropping them deletes any blocks no other file refers to */
+    scr_meta* dedup_meta = scr_meta_new();
+    scr_filemap_get_meta(map, file, dedup_meta);
+    const kvtree* manifest = scr_meta_get_dedup(dedup_meta);
+    if (manifest != NULL) {
+      scr_dedup_release(manifest);
+      scr_meta_delete(&dedup_meta);
+      continue;
     }
+    scr_meta_delete(&dedup_meta);
   }
-  
-  /* delete map object */
-  scr_filemap_delete(&map);
+
+  /* check and delete the files in the background */
+  scr_reclaim_add(dir, map, bypass);
 
   /* delete the map file */
   scr_cache_unset_map(cindex, id);
@@ -347,22 +600,28 @@ int scr_cache_delete(scr_cache_index* cindex, int id)
   /* remove the cache directory for this dataset */
   int store_index = scr_storedescs_index_from_child_path(dir);
   int have_dir = (store_index >= 0 && store_index < scr_nstoredescs && dir != NULL);
-  if (scr_alltrue(have_dir, scr_comm_world)) {
-    /* get store descriptor */
-    scr_storedesc* store = &scr_storedescs[store_index];
 
-    /* remove hidden .scr subdirectory from cache */
-    if (scr_storedesc_dir_delete(store, dir_scr) != SCR_SUCCESS) {
-      scr_err("Failed to remove dataset directory: %s @ %s:%d",
-        dir_scr, __FILE__, __LINE__
-      );
-    }
-    
-    /* remove the dataset directory from cache */
-    if (scr_storedesc_dir_delete(store, dir) != SCR_SUCCESS) {
-      scr_err("Failed to remove dataset directory: %s @ %s:%d",
-        dir, __FILE__, __LINE__
-      );
+  /* if any proc deferred writing its filemap during an output that
+   * never completed, the directories may hold files no filemap lists */
+  int deferred = 0;
+  scr_cache_index_get_map_deferred(cindex, id, &deferred);
+  int flags[2] = {have_dir, ! (deferred && ! bypass)};
+  int all_flags[2];
+  scr_allreduce(flags, all_flags, 2, MPI_INT, MPI_LAND, scr_comm_world);
+  int sweep = ! all_flags[1];
+  if (all_flags[0]) {
+    /* remove the directories once the files in them are gone */
+    scr_reclaim_dir_add(store_index, dir_scr, dir, sweep);
+
+    /* and those on the other stores files were striped across */
+    const scr_reddesc* red = scr_cache_stripe_reddesc(dir, id);
+    if (red != NULL) {
+      int i;
+      for (i = 0; i < red->stripe_count; i++) {
+        char* stripe_dir = scr_cache_stripe_dir_get(red, i, id);
+        scr_reclaim_dir_add(red->stripe_index[i], NULL, stripe_dir, sweep);
+        scr_free(&stripe_dir);
+      }
     }
   } else {
     /* TODO: We end up here if at least one process does not have its
@@ -387,47 +646,101 @@ int scr_cache_delete(scr_cache_index* cindex, int id)
   /* free path to hidden directory */
   scr_free(&dir_scr);
 
+  scr_trace_mark_end("delete");
   return SCR_SUCCESS;
 }
 
-/* each process passes in an ordered list of dataset ids along with a current
- * index, this function identifies the next smallest id across all processes
- * and returns this id in current, it also updates index on processes as
- * appropriate */
-int scr_next_dataset(int ndsets, const int* dsets, int* index, int* current)
+/* largest span of dataset ids we agree on with a single reduction */
+#define SCR_CACHE_MAX_RANGE (4096)
+
+/* compare ints for qsort */
+static int scr_cache_int_cmp(const void* a, const void* b)
 {
-  int dset_index = *index;
+  int x = *(const int*) a;
+  int y = *(const int*) b;
+  return (x > y) - (x < y);
+}
 
-  /* get the next dataset we have in our list */
-  int id = -1;
-  if (dset_index < ndsets) {
-    id = dsets[dset_index];
+/* given our sorted list of dataset ids, return the sorted list of ids
+ * held by any rank, the caller must free the list, this takes two
+ * allreduces when the ids span a modest range, one for the range and
+ * one to mark ids, and otherwise an allreduce for the range followed
+ * by an allgather of counts and an allgatherv of every list, so callers
+ * can walk all datasets without further collectives to agree on which
+ * comes next */
+int scr_cache_list_all_datasets(int ndsets, const int* dsets, int* n, int** ids)
+{
+  *n   = 0;
+  *ids = NULL;
+
+  /* find the smallest and largest id held by anyone */
+  int range[2] = {INT_MIN, -1};
+  if (ndsets > 0) {
+    range[0] = -dsets[0];
+    range[1] = dsets[ndsets - 1];
+  }
+  int all_range[2];
+  scr_allreduce(range, all_range, 2, MPI_INT, MPI_MAX, scr_comm_world);
+  if (all_range[1] == -1) {
+    return SCR_SUCCESS;
   }
+  int low  = -all_range[0];
+  int high = all_range[1];
+
+  int i;
+  long span = (long) high - (long) low + 1;
+  if (span <= SCR_CACHE_MAX_RANGE) {
+    /* mark the ids we have and combine marks across procs */
+    int count = (int) span;
+    int* have     = (int*) SCR_MALLOC(count * sizeof(int));
+    int* have_any = (int*) SCR_MALLOC(count * sizeof(int));
+    for (i = 0; i < count; i++) {
+      have[i] = 0;
+    }
+    for (i = 0; i < ndsets; i++) {
+      have[dsets[i] - low] = 1;
+    }
+    scr_allreduce(have, have_any, count, MPI_INT, MPI_MAX, scr_comm_world);
 
-  /* find the maximum dataset id across all ranks */
-  int current_id;
-  MPI_Allreduce(&id, &current_id, 1, MPI_INT, MPI_MAX, scr_comm_world);
+    *ids = (int*) SCR_MALLOC(count * sizeof(int));
+    for (i = 0; i < count; i++) {
+      if (have_any[i]) {
+        (*ids)[*n] = low + i;
+        (*n)++;
+      }
+    }
 
-  /* if any process has any dataset, identify the smallest */
-  if (current_id != -1) {
-    /* now find the minimum dataset id (that's not -1) */
-    if (id == -1) {
-      /* if we don't have a dataset, set our id to the max to avoid
-       * picking -1 as the minimum */
-      id = current_id;
+    scr_free(&have_any);
+    scr_free(&have);
+  } else {
+    /* ids are spread too far apart to mark, so gather every list,
+     * which is short since each proc holds only a few datasets */
+    int* counts = (int*) SCR_MALLOC(scr_ranks_world * sizeof(int));
+    int* displs = (int*) SCR_MALLOC(scr_ranks_world * sizeof(int));
+    MPI_Allgather(&ndsets, 1, MPI_INT, counts, 1, MPI_INT, scr_comm_world);
+
+    int total = 0;
+    for (i = 0; i < scr_ranks_world; i++) {
+      displs[i] = total;
+      total += counts[i];
     }
-    MPI_Allreduce(&id, &current_id, 1, MPI_INT, MPI_MIN, scr_comm_world);
 
-    /* if the current id matches our id, increment our index for the next
-     * iteration */
-    if (current_id == id) {
-      dset_index++;
+    int* all = (int*) SCR_MALLOC(total * sizeof(int));
+    MPI_Allgatherv((void*) dsets, ndsets, MPI_INT, all, counts, displs, MPI_INT, scr_comm_world);
+
+    /* sort and drop duplicates */
+    qsort(all, (size_t) total, sizeof(int), scr_cache_int_cmp);
+    for (i = 0; i < total; i++) {
+      if (*n == 0 || all[*n - 1] != all[i]) {
+        all[*n] = all[i];
+        (*n)++;
+      }
     }
-  }
+    *ids = all;
 
-  /* update caller's current index value and the dataset id we settled on */
-  *index   = dset_index;
-  *current = current_id;
+    scr_free(&displs);
+    scr_free(&counts);
+  }
 
   return SCR_SUCCESS;
 }
@@ -444,27 +757,26 @@ int scr_cache_purge(scr_cache_index* cindex)
 
   /* TODO: also attempt to recover datasets which we were in the
    * middle of flushing */
-  int current_id;
-  int dset_index = 0;
-  do {
-    /* get the smallest index across all processes (returned in current_id),
-     * this also updates our dset_index value if appropriate */
-    scr_next_dataset(ndsets, dsets, &dset_index, &current_id);
-    
-    /* if we found a dataset, delete it */
-    if (current_id != -1) {
-      /* remove this dataset from all tasks */
-      scr_cache_delete(cindex, current_id);
-    }
-  } while (current_id != -1);
+  /* agree on the datasets any process holds, oldest first */
+  int nall;
+  int* all;
+  scr_cache_list_all_datasets(ndsets, dsets, &nall, &all);
+
+  int i;
+  for (i = 0; i < nall; i++) {
+    /* remove this dataset from all tasks */
+    scr_cache_delete(cindex, all[i]);
+  }
 
   /* free our list of dataset ids */
+  scr_free(&all);
   scr_free(&dsets);
 
   /* delete the cache index file itself */
-  char* file = spath_strdup(scr_cindex_file);
-  scr_file_unlink(file);
-  scr_free(&file);
+  scr_cache_index_unlink(scr_cindex_file);
+
+  /* the arena is sized again once the cache is rebuilt */
+  scr_arena_delete();
 
   /* clear the cache index object */
   scr_cache_index_clear(cindex);
@@ -472,6 +784,49 @@ int scr_cache_purge(scr_cache_index* cindex)
   return 1;
 }
 
+/* return number of bytes the calling process holds in cache for dataset,
+ * returns 0 for datasets that bypass the cache */
+unsigned long scr_cache_get_bytes(const scr_cache_index* cindex, int id)
+{
+  /* files of a bypass dataset are on the file system */
+  int bypass = 0;
+  scr_cache_index_get_bypass(cindex, id, &bypass);
+  if (bypass) {
+    return 0;
+  }
+
+  /* add up sizes recorded for our files */
+  unsigned long bytes = 0;
+  scr_filemap* map = scr_filemap_new();
+  scr_cache_get_map(cindex, id, map);
+  kvtree_elem* file_elem;
+  for (file_elem = scr_filemap_first_file(map);
+       file_elem != NULL;
+       file_elem = kvtree_elem_next(file_elem))
+  {
+    char* file = kvtree_elem_key(file_elem);
+    scr_meta* meta = scr_meta_new();
+    unsigned long size;
+    if (scr_filemap_get_meta(map, file, meta) == SCR_SUCCESS &&
+        scr_meta_get_filesize(meta, &size) == SCR_SUCCESS)
+    {
+      /* count what a file kept compressed takes in cache */
+      int type;
+      unsigned long compsize;
+      if (scr_meta_get_cache_compress(meta, &type, &compsize) == SCR_SUCCESS &&
+          type != SCR_COMPRESS_NONE)
+      {
+        size = compsize;
+      }
+      bytes += size;
+    }
+    scr_meta_delete(&meta);
+  }
+  scr_filemap_delete(&map);
+
+  return bytes;
+}
+
 /* delete dataset with matching name from cache, if one exists */
 int scr_cache_delete_by_name(scr_cache_index* cindex, const char* name)
 {
@@ -485,43 +840,43 @@ int scr_cache_delete_by_name(scr_cache_index* cindex, const char* name)
 
   /* TODO: also attempt to recover datasets which we were in the
    * middle of flushing */
-  int current_id;
-  int dset_index = 0;
-  do {
+  /* agree on the datasets any process holds, oldest first */
+  int nall;
+  int* all;
+  scr_cache_list_all_datasets(ndsets, dsets, &nall, &all);
+
+  int i;
+  for (i = 0; i < nall; i++) {
+    int current_id = all[i];
+
     /* we'll set this to the dataset id if we find one that matches the target name */
     int delete_id = -1;
 
-    /* get the smallest index across all processes (returned in current_id),
-     * this also updates our dset_index value if appropriate */
-    scr_next_dataset(ndsets, dsets, &dset_index, &current_id);
-    
-    /* if we found a dataset id, check its name against target name */
-    if (current_id != -1) {
-      /* get dataset for this id */
-      scr_dataset* dataset = scr_dataset_new();
-      scr_cache_index_get_dataset(cindex, current_id, dataset);
-
-      /* check the name of this dataset to the given name */
-      char* dset_name;
-      if (scr_dataset_get_name(dataset, &dset_name) == SCR_SUCCESS) {
-        if (strcmp(name, dset_name) == 0) {
-          /* found a match, record the id */
-          delete_id = current_id;
-        }
-      }
+    /* get dataset for this id */
+    scr_dataset* dataset = scr_dataset_new();
+    scr_cache_index_get_dataset(cindex, current_id, dataset);
 
-      /* release the dataset and lookup the id of the next oldest dataset */
-      scr_dataset_delete(&dataset);
+    /* check the name of this dataset to the given name */
+    char* dset_name;
+    if (scr_dataset_get_name(dataset, &dset_name) == SCR_SUCCESS) {
+      if (strcmp(name, dset_name) == 0) {
+        /* found a match, record the id */
+        delete_id = current_id;
+      }
     }
 
+    /* release the dataset */
+    scr_dataset_delete(&dataset);
+
     /* if we found a matching dataset, delete it */
     if (delete_id != -1) {
       /* remove this dataset from all tasks */
       scr_cache_delete(cindex, delete_id);
     }
-  } while (current_id != -1);
+  }
 
   /* free our list of dataset ids */
+  scr_free(&all);
   scr_free(&dsets);
 
   return SCR_SUCCESS;
@@ -644,6 +999,9 @@ int scr_cache_check_files(const scr_cache_index* cindex, int id)
   scr_filemap* map = scr_filemap_new();
   scr_cache_get_map(cindex, id, map);
 
+  /* look up all files at once */
+  scr_cache_stat_files(map);
+
   /* loop over each file in the map */
   kvtree_elem* file_elem;
   for (file_elem = scr_filemap_first_file(map);
@@ -653,16 +1011,25 @@ int scr_cache_check_files(const scr_cache_index* cindex, int id)
     /* get the filename */
     char* file = kvtree_elem_key(file_elem);
 
-    /* check that we can read the file */
-    if (scr_file_is_readable(file) != SCR_SUCCESS) {
-      failed_read = 1;
-    }
-
     /* get meta data for this file */
     scr_meta* meta = scr_meta_new();
     if (scr_filemap_get_meta(map, file, meta) != SCR_SUCCESS) {
       failed_read = 1;
     } else {
+      /* check that we can read the file, or all of its blocks */
+      const kvtree* manifest = scr_meta_get_dedup(meta);
+      if (manifest != NULL) {
+        if (! scr_dedup_check(manifest)) {
+          failed_read = 1;
+        }
+      } else if (! scr_cache_known_check(file, meta)) {
+        unsigned long size;
+        int stat_rc = scr_statx_get(file, &size);
+        if (stat_rc == 0 || (stat_rc < 0 && scr_file_is_readable(file) != SCR_SUCCESS)) {
+          failed_read = 1;
+        }
+      }
+
       /* check that the file is complete */
       if (scr_meta_is_complete(meta) != SCR_SUCCESS) {
         failed_read = 1;
@@ -671,8 +1038,9 @@ int scr_cache_check_files(const scr_cache_index* cindex, int id)
     scr_meta_delete(&meta);
   }
 
-  /* free the map */
+  /* free the map and the results of the lookups */
   scr_filemap_delete(&map);
+  scr_statx_clear();
 
   /* if we failed to read a file, assume the set is incomplete */
   if (failed_read) {
@@ -682,6 +1050,359 @@ int scr_cache_check_files(const scr_cache_index* cindex, int id)
   return SCR_SUCCESS;
 }
 
+/* returns newly allocated path to the block store shared by all
+ * datasets in the same cache directory as the given dataset */
+static char* scr_cache_dedup_dir(const scr_cache_index* cindex, int id)
+{
+  char* dir = NULL;
+  if (scr_cache_index_get_dir(cindex, id, &dir) != SCR_SUCCESS) {
+    return NULL;
+  }
+
+  spath* path = spath_from_str(dir);
+  spath_reduce(path);
+  spath_dirname(path);
+  spath_append_str(path, "dedup");
+  char* str = spath_strdup(path);
+  spath_delete(&path);
+  return str;
+}
+
+/* replace each file of the dataset with references to blocks in a
+ * block store in the cache directory, so identical blocks written by
+ * any rank on the store into any dataset are kept once */
+int scr_cache_dedup_dataset(scr_cache_index* cindex, int id)
+{
+  /* only deduplicate datasets that live in cache on a store that asks
+   * for it, and never while an async flush may be reading the files */
+  int bypass = 0;
+  scr_cache_index_get_bypass(cindex, id, &bypass);
+  scr_storedesc* store = scr_cache_get_storedesc(cindex, id);
+  int dedup = (store != NULL && store->dedup && ! bypass &&
+               ! scr_flush_file_is_flushing(id));
+  if (! scr_alltrue(dedup, scr_comm_world)) {
+    return SCR_SUCCESS;
+  }
+
+  /* create block store next to the dataset directories */
+  char* dir = scr_cache_dedup_dir(cindex, id);
+  int have_dir = (dir != NULL);
+  if (have_dir && scr_storedesc_dir_create(store, dir) != SCR_SUCCESS) {
+    scr_err("Failed to create dedup directory %s @ %s:%d",
+      dir, __FILE__, __LINE__
+    );
+    have_dir = 0;
+  }
+
+  int rc = SCR_SUCCESS;
+  unsigned long bytes = 0;
+  if (have_dir) {
+    scr_filemap* map = scr_filemap_new();
+    scr_cache_get_map(cindex, id, map);
+
+    int i = 0;
+    kvtree_elem* elem;
+    for (elem = scr_filemap_first_file(map);
+         elem != NULL;
+         elem = kvtree_elem_next(elem))
+    {
+      const char* file = kvtree_elem_key(elem);
+
+      scr_meta* meta = scr_meta_new();
+      scr_filemap_get_meta(map, file, meta);
+      if (scr_meta_get_dedup(meta) == NULL) {
+        /* name references after rank, dataset, and file so they are
+         * unique among all procs sharing the store */
+        char ref[256];
+        snprintf(ref, sizeof(ref), "r%d.d%d.f%d", scr_my_rank_world, id, i);
+
+        kvtree* manifest = kvtree_new();
+        if (scr_dedup_file(dir, file, ref, scr_cache_dedup_block_size, manifest) == SCR_SUCCESS) {
+          bytes += scr_dedup_size(manifest);
+          scr_meta_set_dedup(meta, manifest);
+          scr_filemap_set_meta(map, file, meta);
+        } else {
+          rc = SCR_FAILURE;
+        }
+        kvtree_delete(&manifest);
+      }
+      scr_meta_delete(&meta);
+      i++;
+    }
+
+    /* record manifests, files left whole on failure are still valid */
+    scr_cache_set_map(cindex, id, map);
+    scr_filemap_delete(&map);
+  }
+  scr_free(&dir);
+
+  scr_dbg(2, "Deduplicated %lu bytes of dataset %d", bytes, id);
+
+  return rc;
+}
+
+/* write out any deduplicated files of the dataset in full,
+ * and drop their references to the block store */
+int scr_cache_dedup_restore(const scr_cache_index* cindex, int id)
+{
+  int rc = SCR_SUCCESS;
+
+  scr_filemap* map = scr_filemap_new();
+  scr_cache_get_map(cindex, id, map);
+
+  int restored = 0;
+  kvtree_elem* elem;
+  for (elem = scr_filemap_first_file(map);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    const char* file = kvtree_elem_key(elem);
+
+    scr_meta* meta = scr_meta_new();
+    scr_filemap_get_meta(map, file, meta);
+    const kvtree* manifest = scr_meta_get_dedup(meta);
+    if (manifest != NULL) {
+      if (scr_dedup_write(manifest, file) == SCR_SUCCESS) {
+        /* the file holds its own data again */
+        scr_meta_apply_stat(meta, file);
+        scr_dedup_release(manifest);
+        scr_meta_set_dedup(meta, NULL);
+        scr_filemap_set_meta(map, file, meta);
+        restored = 1;
+      } else {
+        scr_err("Failed to restore deduplicated file %s @ %s:%d",
+          file, __FILE__, __LINE__
+        );
+        rc = SCR_FAILURE;
+      }
+    }
+    scr_meta_delete(&meta);
+  }
+
+  if (restored) {
+    scr_cache_set_map(cindex, id, map);
+  }
+  scr_filemap_delete(&map);
+
+  return rc;
+}
+
+/* compress each file of the dataset in place with the codec of its store,
+ * so a store backed by memory holds more datasets, files that do not
+ * shrink are kept as they are */
+int scr_cache_compress_dataset(scr_cache_index* cindex, int id)
+{
+  /* only compress datasets that live in cache on a store that asks
+   * for it, and never while an async flush may be reading the files */
+  int bypass = 0;
+  scr_cache_index_get_bypass(cindex, id, &bypass);
+  scr_storedesc* store = scr_cache_get_storedesc(cindex, id);
+  int compress = (store != NULL && store->cache_compress != SCR_COMPRESS_NONE &&
+                  ! bypass && ! scr_flush_file_is_flushing(id));
+  if (! scr_alltrue(compress, scr_comm_world)) {
+    return SCR_SUCCESS;
+  }
+  int type = store->cache_compress;
+
+  int rc = SCR_SUCCESS;
+  unsigned long bytes = 0;
+  unsigned long savings = 0;
+
+  scr_filemap* map = scr_filemap_new();
+  scr_cache_get_map(cindex, id, map);
+
+  kvtree_elem* elem;
+  for (elem = scr_filemap_first_file(map);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    const char* file = kvtree_elem_key(elem);
+
+    /* skip files whose blocks live in the dedup store,
+     * and files we compressed already */
+    scr_meta* meta = scr_meta_new();
+    scr_filemap_get_meta(map, file, meta);
+    int comp_type = SCR_COMPRESS_NONE;
+    scr_meta_get_cache_compress(meta, &comp_type, NULL);
+    if (scr_meta_get_dedup(meta) != NULL || comp_type != SCR_COMPRESS_NONE) {
+      scr_meta_delete(&meta);
+      continue;
+    }
+
+    /* compress into a temporary file next to the original */
+    char tmp[SCR_MAX_FILENAME];
+    snprintf(tmp, sizeof(tmp), "%s.scrz", file);
+    unsigned long size = 0;
+    unsigned long compsize = 0;
+    if (scr_compress_file(file, tmp, type, scr_file_buf_size, &size, &compsize, NULL) != SCR_SUCCESS) {
+      scr_err("Failed to compress file in cache %s @ %s:%d",
+        file, __FILE__, __LINE__
+      );
+      scr_file_unlink(tmp);
+      rc = SCR_FAILURE;
+    } else if (compsize >= size) {
+      /* not worth it, keep the original */
+      scr_file_unlink(tmp);
+    } else if (rename(tmp, file) != 0) {
+      scr_err("Failed to rename %s to %s: errno=%d %s @ %s:%d",
+        tmp, file, errno, strerror(errno), __FILE__, __LINE__
+      );
+      scr_file_unlink(tmp);
+      rc = SCR_FAILURE;
+    } else {
+      /* keep the mode and timestamps recorded for the file */
+      scr_meta_apply_stat(meta, file);
+      scr_meta_set_cache_compress(meta, type, compsize);
+      scr_filemap_set_meta(map, file, meta);
+      scr_cache_known_unset(file);
+      bytes += size;
+      savings += size - compsize;
+    }
+    scr_meta_delete(&meta);
+  }
+
+  /* record compressed files, files left as is on failure are still valid */
+  scr_cache_set_map(cindex, id, map);
+  scr_filemap_delete(&map);
+
+  scr_dbg(2, "Compressed %lu bytes of dataset %d, saving %lu bytes", bytes, id, savings);
+
+  return rc;
+}
+
+/* returns 1 if the calling process keeps any file of the dataset
+ * compressed in cache */
+int scr_cache_is_compressed(const scr_cache_index* cindex, int id)
+{
+  int compressed = 0;
+
+  scr_filemap* map = scr_filemap_new();
+  scr_cache_get_map(cindex, id, map);
+
+  kvtree_elem* elem;
+  for (elem = scr_filemap_first_file(map);
+       elem != NULL && ! compressed;
+       elem = kvtree_elem_next(elem))
+  {
+    const char* file = kvtree_elem_key(elem);
+    scr_meta* meta = scr_meta_new();
+    scr_filemap_get_meta(map, file, meta);
+    int type = SCR_COMPRESS_NONE;
+    scr_meta_get_cache_compress(meta, &type, NULL);
+    if (type != SCR_COMPRESS_NONE) {
+      compressed = 1;
+    }
+    scr_meta_delete(&meta);
+  }
+
+  scr_filemap_delete(&map);
+  return compressed;
+}
+
+/* decompress any files of the dataset kept compressed in cache */
+int scr_cache_compress_restore(const scr_cache_index* cindex, int id)
+{
+  int rc = SCR_SUCCESS;
+
+  scr_filemap* map = scr_filemap_new();
+  scr_cache_get_map(cindex, id, map);
+
+  int restored = 0;
+  kvtree_elem* elem;
+  for (elem = scr_filemap_first_file(map);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    const char* file = kvtree_elem_key(elem);
+
+    scr_meta* meta = scr_meta_new();
+    scr_filemap_get_meta(map, file, meta);
+    int type = SCR_COMPRESS_NONE;
+    if (scr_meta_get_cache_compress(meta, &type, NULL) != SCR_SUCCESS) {
+      scr_err("Unknown compression recorded for file in cache %s @ %s:%d",
+        file, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    } else if (type != SCR_COMPRESS_NONE) {
+      char tmp[SCR_MAX_FILENAME];
+      snprintf(tmp, sizeof(tmp), "%s.scrz", file);
+      unsigned long size = 0;
+      int ok = (scr_decompress_file(file, tmp, type, &size, NULL) == SCR_SUCCESS &&
+                scr_meta_check_filesize(meta, size) == SCR_SUCCESS &&
+                rename(tmp, file) == 0);
+      if (ok) {
+        /* the file holds its data as is again */
+        scr_meta_apply_stat(meta, file);
+        scr_meta_set_cache_compress(meta, SCR_COMPRESS_NONE, 0);
+        scr_filemap_set_meta(map, file, meta);
+        restored = 1;
+      } else {
+        scr_err("Failed to decompress file in cache %s @ %s:%d",
+          file, __FILE__, __LINE__
+        );
+        scr_file_unlink(tmp);
+        rc = SCR_FAILURE;
+      }
+    }
+    scr_meta_delete(&meta);
+  }
+
+  if (restored) {
+    scr_cache_set_map(cindex, id, map);
+  }
+  scr_filemap_delete(&map);
+
+  return rc;
+}
+
+/* compute checksum of given type for a file in cache with the method
+ * picked by the store holding the file */
+static int scr_cache_checksum_file_store(const char* file, int type, uint64_t* value)
+{
+  /* use mmap, O_DIRECT, or threads if the store holding this file asks for it */
+  int memory = 0;
+  int direct = 0;
+  int threads = scr_crc_threads;
+  int store_index = scr_storedescs_index_from_child_path(file);
+  if (store_index >= 0) {
+    memory  = scr_storedescs[store_index].memory;
+    direct  = scr_storedescs[store_index].direct;
+    threads = scr_storedescs[store_index].crc_threads;
+  }
+
+  /* data on a memory-backed store is already in memory, so checksum
+   * straight from a mapping of the file */
+  if (memory && scr_checksum_file_mmap(file, type, value) == SCR_SUCCESS) {
+    return SCR_SUCCESS;
+  }
+
+  int rc;
+  if (type == SCR_CHECKSUM_CRC32) {
+    uLong crc_file;
+    if (direct) {
+      rc = scr_crc32_direct(file, (size_t) scr_page_size, &crc_file);
+    } else {
+      rc = scr_crc32_parallel(file, threads, scr_crc_thread_min_size, &crc_file);
+    }
+    *value = (uint64_t) crc_file;
+  } else {
+    rc = scr_checksum_file(file, type, value);
+  }
+  return rc;
+}
+
+/* compute checksum of given type for a file in cache, picks the method
+ * based on the store holding the file */
+int scr_cache_checksum_file(const char* file, int type, uint64_t* value)
+{
+  double time_start = MPI_Wtime();
+  int rc = scr_cache_checksum_file_store(file, type, value);
+  if (rc == SCR_SUCCESS && scr_iohist) {
+    scr_iohist_record(SCR_IOHIST_CRC, (double) scr_file_size(file), MPI_Wtime() - time_start);
+  }
+  return rc;
+}
+
 /* checks whether specifed file exists, is readable, and is complete */
 int scr_bool_have_file(const scr_filemap* map, const char* file)
 {
@@ -693,14 +1414,6 @@ int scr_bool_have_file(const scr_filemap* map, const char* file)
     return 0;
   }
 
-  /* check that we can read the file */
-  if (scr_file_is_readable(file) != SCR_SUCCESS) {
-    scr_dbg(2, "Do not have read access to file: %s @ %s:%d",
-      file, __FILE__, __LINE__
-    );
-    return 0;
-  }
-
   /* allocate object to read meta data into */
   scr_meta* meta = scr_meta_new();
 
@@ -722,6 +1435,36 @@ int scr_bool_have_file(const scr_filemap* map, const char* file)
     return 0;
   }
 
+  /* a deduplicated file is good if all of its blocks are there */
+  const kvtree* manifest = scr_meta_get_dedup(meta);
+  if (manifest != NULL) {
+    int have_blocks = (scr_dedup_check(manifest) &&
+      scr_meta_check_filesize(meta, scr_dedup_size(manifest)) == SCR_SUCCESS);
+    if (! have_blocks) {
+      scr_dbg(2, "Missing blocks of deduplicated file: %s @ %s:%d",
+        file, __FILE__, __LINE__
+      );
+    }
+    scr_meta_delete(&meta);
+    return have_blocks;
+  }
+
+  /* we checked this file when its output was completed */
+  int known = scr_cache_known_check(file, meta);
+
+  /* use the result of a batch lookup if the file was in one */
+  unsigned long stat_size = 0;
+  int stat_rc = known ? -1 : scr_statx_get(file, &stat_size);
+
+  /* check that we can read the file */
+  if (! known && (stat_rc == 0 || (stat_rc < 0 && scr_file_is_readable(file) != SCR_SUCCESS))) {
+    scr_dbg(2, "Do not have read access to file: %s @ %s:%d",
+      file, __FILE__, __LINE__
+    );
+    scr_meta_delete(&meta);
+    return 0;
+  }
+
   /* TODODSET: enable check for correct dataset / checkpoint id */
 
 #if 0
@@ -782,7 +1525,6 @@ int scr_bool_have_file(const scr_filemap* map, const char* file)
 #endif
 
   /* check that the file size matches */
-  unsigned long size = scr_file_size(file);
   unsigned long meta_size = 0;
   if (scr_meta_get_filesize(meta, &meta_size) != SCR_SUCCESS) {
     scr_dbg(2, "Failed to read filesize field in meta data: %s @ %s:%d",
@@ -791,6 +1533,18 @@ int scr_bool_have_file(const scr_filemap* map, const char* file)
     scr_meta_delete(&meta);
     return 0;
   }
+  /* a file kept compressed in cache holds fewer bytes than it records */
+  int comp_type = SCR_COMPRESS_NONE;
+  unsigned long comp_size = 0;
+  scr_meta_get_cache_compress(meta, &comp_type, &comp_size);
+  if (comp_type != SCR_COMPRESS_NONE) {
+    meta_size = comp_size;
+  }
+
+  unsigned long size = meta_size;
+  if (! known) {
+    size = (stat_rc > 0) ? stat_size : scr_file_size(file);
+  }
   if (size != meta_size) {
     scr_dbg(2, "Filesize is incorrect, currently %lu, expected %lu for %s @ %s:%d",
       size, meta_size, file, __FILE__, __LINE__
@@ -799,7 +1553,24 @@ int scr_bool_have_file(const scr_filemap* map, const char* file)
     return 0;
   }
 
-  /* TODO: check that crc32 match if set (this would be expensive) */
+  /* check that the checksum matches if set, this is only cheap enough
+   * to do here for files that are already in memory */
+  int type;
+  uint64_t meta_value;
+  int store_index = scr_storedescs_index_from_child_path(file);
+  if (store_index >= 0 && scr_storedescs[store_index].memory &&
+      comp_type == SCR_COMPRESS_NONE &&
+      scr_meta_get_checksum(meta, &type, &meta_value) == SCR_SUCCESS)
+  {
+    uint64_t value;
+    if (scr_checksum_file_mmap(file, type, &value) != SCR_SUCCESS || value != meta_value) {
+      scr_dbg(2, "%s does not match for %s @ %s:%d",
+        scr_checksum_type_to_str(type), file, __FILE__, __LINE__
+      );
+      scr_meta_delete(&meta);
+      return 0;
+    }
+  }
 
   /* free meta data object */
   scr_meta_delete(&meta);
@@ -808,19 +1579,11 @@ int scr_bool_have_file(const scr_filemap* map, const char* file)
   return 1;
 }
 
-/* compute and store crc32 value for specified file in given dataset and rank,
- * check against current value if one is set */
+/* compute and store checksum value for specified file in given dataset and rank,
+ * check against current value if one is set, files that already have a
+ * checksum are verified with the algorithm recorded in their meta data */
 int scr_compute_crc(scr_filemap* map, const char* file)
 {
-  /* compute crc for the file */
-  uLong crc_file;
-  if (scr_crc32(file, &crc_file) != SCR_SUCCESS) {
-    scr_err("Failed to compute crc for file %s @ %s:%d",
-      file, __FILE__, __LINE__
-    );
-    return SCR_FAILURE;
-  }
-
   /* allocate a new meta data object */
   scr_meta* meta = scr_meta_new();
   if (meta == NULL) {
@@ -831,21 +1594,37 @@ int scr_compute_crc(scr_filemap* map, const char* file)
 
   /* read meta data from filemap */
   if (scr_filemap_get_meta(map, file, meta) != SCR_SUCCESS) {
+    scr_meta_delete(&meta);
+    return SCR_FAILURE;
+  }
+
+  /* read checksum value from meta data if there is one,
+   * otherwise we'll compute and record one with the default type */
+  int type = scr_checksum_type;
+  uint64_t value_meta;
+  int have_meta = (scr_meta_get_checksum(meta, &type, &value_meta) == SCR_SUCCESS);
+
+  /* compute checksum for the file */
+  uint64_t value_file;
+  int crc_rc = scr_cache_checksum_file(file, type, &value_file);
+  if (crc_rc != SCR_SUCCESS) {
+    scr_err("Failed to compute %s for file %s @ %s:%d",
+      scr_checksum_type_to_str(type), file, __FILE__, __LINE__
+    );
+    scr_meta_delete(&meta);
     return SCR_FAILURE;
   }
 
   int rc = SCR_SUCCESS;
 
-  /* read crc value from meta data */
-  uLong crc_meta;
-  if (scr_meta_get_crc32(meta, &crc_meta) == SCR_SUCCESS) {
+  if (have_meta) {
     /* check that the values are the same */
-    if (crc_file != crc_meta) {
+    if (value_file != value_meta) {
       rc = SCR_FAILURE;
     }
   } else {
-    /* record crc in filemap */
-    scr_meta_set_crc32(meta, crc_file);
+    /* record checksum in filemap */
+    scr_meta_set_checksum(meta, type, value_file);
     scr_filemap_set_meta(map, file, meta);
   }
 
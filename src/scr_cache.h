@@ -41,17 +41,37 @@ const char* scr_cache_get_map_file(const scr_cache_index* cindex, int id);
  * waits for all tasks on the same node before returning */
 int scr_cache_dir_create(const scr_reddesc* reddesc, int id);
 
+/* returns name of the dataset directory on the given stripe store of a
+ * redundancy descriptor, caller must free returned string */
+char* scr_cache_stripe_dir_get(const scr_reddesc* reddesc, int stripe, int id);
+
+/* create the directories on the stripe stores for dataset id that is
+ * placed in dir, does nothing if its descriptor does not stripe files,
+ * must be called by all procs */
+int scr_cache_stripe_dirs_create(const char* dir, int id);
+
+/* start creating the directories of dataset id for reddesc in the
+ * background, a later scr_cache_dir_create of the same dataset then
+ * finds them in place, prepared directories that go unused are removed */
+int scr_cache_dir_prepare(const scr_reddesc* reddesc, int id);
+
+/* wait for directories being prepared, and remove them if unused */
+void scr_cache_dir_prepare_finalize(void);
+
 /* remove all files associated with specified dataset */
 int scr_cache_delete(scr_cache_index* cindex, int id);
 
 /* delete dataset with matching name from cache, if one exists */
 int scr_cache_delete_by_name(scr_cache_index* cindex, const char* name);
 
-/* each process passes in an ordered list of dataset ids along with a current
- * index, this function identifies the next smallest id across all processes
- * and returns this id in current, it also updates index on processes as
- * appropriate */
-int scr_next_dataset(int ndsets, const int* dsets, int* index, int* current);
+/* return number of bytes the calling process holds in cache for dataset,
+ * returns 0 for datasets that bypass the cache */
+unsigned long scr_cache_get_bytes(const scr_cache_index* cindex, int id);
+
+/* given our sorted list of dataset ids, return the sorted list of ids
+ * held by any rank, the caller must free the list, agrees on all ids
+ * with a fixed number of collectives regardless of how many there are */
+int scr_cache_list_all_datasets(int ndsets, const int* dsets, int* n, int** ids);
 
 /* remove all files from cache */
 int scr_cache_purge(scr_cache_index* cindex);
@@ -60,16 +80,53 @@ int scr_cache_purge(scr_cache_index* cindex);
  * unlinks any that are not */
 //int scr_cache_clean(scr_cache_index* cindex);
 
+/* check in one batch the files of map that scr_bool_have_file and
+ * scr_cache_check_files would otherwise look up one at a time,
+ * call scr_statx_clear once done with the checks */
+int scr_cache_stat_files(const scr_filemap* map);
+
 /* returns true iff each file in the cache can be read */
 int scr_cache_check_files(const scr_cache_index* cindex, int id);
 
 /* checks whether specifed file exists, is readable, and is complete */
 int scr_bool_have_file(const scr_filemap* map, const char* file);
 
-/* compute and store crc32 value for specified file in given dataset and rank,
+/* record that file had size bytes when its output was completed,
+ * later checks then trust its meta data rather than stat it again */
+void scr_cache_known_set(const char* file, unsigned long size);
+
+/* forget what we recorded for file */
+void scr_cache_known_unset(const char* file);
+
+/* forget about all files */
+void scr_cache_known_free(void);
+
+/* compute and store checksum value for specified file in given dataset and rank,
  * check against current value if one is set */
 int scr_compute_crc(scr_filemap* map, const char* file);
 
+/* compute checksum of given type for a file in cache, picks the method
+ * based on the store holding the file */
+int scr_cache_checksum_file(const char* file, int type, uint64_t* value);
+
+/* keep identical blocks of the files of the dataset only once in cache,
+ * if its store asks for it */
+int scr_cache_dedup_dataset(scr_cache_index* cindex, int id);
+
+/* write out deduplicated files of the dataset in full */
+int scr_cache_dedup_restore(const scr_cache_index* cindex, int id);
+
+/* keep the files of the dataset compressed in cache,
+ * if its store asks for it */
+int scr_cache_compress_dataset(scr_cache_index* cindex, int id);
+
+/* returns 1 if the calling process keeps any file of the dataset
+ * compressed in cache */
+int scr_cache_is_compressed(const scr_cache_index* cindex, int id);
+
+/* decompress files of the dataset kept compressed in cache */
+int scr_cache_compress_restore(const scr_cache_index* cindex, int id);
+
 /* return store descriptor associated with dataset, returns NULL if not found */
 scr_storedesc* scr_cache_get_storedesc(const scr_cache_index* cindex, int id);
 
@@ -21,6 +21,7 @@
 #include <fcntl.h>
 #include <string.h>
 #include <unistd.h>
+#include <stdint.h>
 
 #include "mpi.h"
 
@@ -40,6 +41,36 @@
 #define SCR_CINDEX_KEY_DATA      ("DSETDESC")
 #define SCR_CINDEX_KEY_PATH      ("PATH")
 #define SCR_CINDEX_KEY_BYPASS    ("BYPASS")
+#define SCR_CINDEX_KEY_REBUILD   ("REBUILD")
+#define SCR_CINDEX_KEY_MAPDEFER  ("MAPDEFER")
+#define SCR_CINDEX_KEY_JOURNAL   ("JOURNAL")
+#define SCR_CINDEX_KEY_RECLAIM   ("RECLAIM")
+
+/* marks the start of each record in the journal */
+#define SCR_CINDEX_JOURNAL_MAGIC (0x53434a31)
+
+/* kinds of journal records */
+#define SCR_CINDEX_JOURNAL_SET (1) /* replace the entry of a dataset */
+#define SCR_CINDEX_JOURNAL_DEL (2) /* remove a dataset */
+#define SCR_CINDEX_JOURNAL_CUR (3) /* replace the CURRENT name */
+#define SCR_CINDEX_JOURNAL_RCL (4) /* replace the RECLAIM directories */
+
+/* fixed-size header of a journal record, followed by size bytes of a packed kvtree */
+typedef struct {
+  uint32_t magic; /* SCR_CINDEX_JOURNAL_MAGIC */
+  uint32_t op;    /* kind of record */
+  uint32_t gen;   /* generation of snapshot this record applies to */
+  int32_t  dset;  /* dataset id for SET and DEL */
+  uint32_t size;  /* number of bytes that follow */
+  uint32_t crc;   /* crc32 of bytes that follow */
+} scr_cache_index_record;
+
+/* rank 0 of the control store remembers what it last wrote,
+ * so that each write only appends what changed since then */
+static char*    scr_cache_index_disk_file = NULL; /* name of snapshot file */
+static kvtree*  scr_cache_index_disk      = NULL; /* index as recorded in snapshot and journal */
+static uint32_t scr_cache_index_gen       = 0;    /* generation of snapshot */
+static int      scr_cache_index_records   = 0;    /* number of records in journal */
 
 /* returns the DSET hash */
 static kvtree* scr_cache_index_get_dh(const kvtree* h)
@@ -206,6 +237,89 @@ int scr_cache_index_get_bypass(const scr_cache_index* cindex, int dset, int* byp
   return SCR_FAILURE; 
 }
 
+/* mark dataset as needing a rebuild, e.g., after a node failure was reported */
+int scr_cache_index_set_rebuild(scr_cache_index* cindex, int dset, int rebuild)
+{
+  /* set indicies and get hash reference */
+  kvtree* d = scr_cache_index_set_d(cindex, dset);
+
+  /* set the REBUILD value under the RANK/DSET hash */
+  kvtree_util_set_int(d, SCR_CINDEX_KEY_REBUILD, rebuild);
+
+  return SCR_SUCCESS;
+}
+
+/* get value of rebuild flag for dataset */
+int scr_cache_index_get_rebuild(const scr_cache_index* cindex, int dset, int* rebuild)
+{
+  /* assume the dataset has not been marked for rebuild */
+  *rebuild = 0;
+
+  /* get RANK/CKPT hash */
+  kvtree* d = scr_cache_index_get_d(cindex, dset);
+
+  /* get the REBUILD value under the RANK/DSET hash */
+  if (kvtree_util_get_int(d, SCR_CINDEX_KEY_REBUILD, rebuild) == KVTREE_SUCCESS) {
+    return SCR_SUCCESS;
+  }
+
+  return SCR_FAILURE;
+}
+
+/* mark whether the filemap of dataset may lack files routed during output */
+int scr_cache_index_set_map_deferred(scr_cache_index* cindex, int dset, int deferred)
+{
+  /* set indicies and get hash reference */
+  kvtree* d = scr_cache_index_set_d(cindex, dset);
+
+  /* set the MAPDEFER value under the RANK/DSET hash */
+  kvtree_util_set_int(d, SCR_CINDEX_KEY_MAPDEFER, deferred);
+
+  return SCR_SUCCESS;
+}
+
+/* get value of deferred filemap flag for dataset */
+int scr_cache_index_get_map_deferred(const scr_cache_index* cindex, int dset, int* deferred)
+{
+  /* assume the filemap was written as files were routed */
+  *deferred = 0;
+
+  /* get RANK/CKPT hash */
+  kvtree* d = scr_cache_index_get_d(cindex, dset);
+
+  /* get the MAPDEFER value under the RANK/DSET hash */
+  if (kvtree_util_get_int(d, SCR_CINDEX_KEY_MAPDEFER, deferred) == KVTREE_SUCCESS) {
+    return SCR_SUCCESS;
+  }
+
+  return SCR_FAILURE;
+}
+
+/* record that directory dir of a deleted dataset is still to be removed */
+int scr_cache_index_set_reclaim(scr_cache_index* cindex, const char* dir)
+{
+  kvtree_set_kv(cindex, SCR_CINDEX_KEY_RECLAIM, dir);
+  return SCR_SUCCESS;
+}
+
+/* record that directory dir has been removed or is in use again */
+int scr_cache_index_unset_reclaim(scr_cache_index* cindex, const char* dir)
+{
+  kvtree_unset_kv(cindex, SCR_CINDEX_KEY_RECLAIM, dir);
+  if (kvtree_size(kvtree_get(cindex, SCR_CINDEX_KEY_RECLAIM)) == 0) {
+    kvtree_unset(cindex, SCR_CINDEX_KEY_RECLAIM);
+  }
+  return SCR_SUCCESS;
+}
+
+/* returns elem of first directory still to be removed, the key is its path */
+kvtree_elem* scr_cache_index_first_reclaim(const scr_cache_index* cindex)
+{
+  kvtree* rh = kvtree_get(cindex, SCR_CINDEX_KEY_RECLAIM);
+  kvtree_elem* elem = kvtree_elem_first(rh);
+  return elem;
+}
+
 /* remove all associations for a given dataset */
 int scr_cache_index_remove_dataset(scr_cache_index* cindex, int dset)
 {
@@ -290,6 +404,114 @@ int scr_cache_index_merge(scr_cache_index* cindex1, scr_cache_index* cindex2)
   return SCR_SUCCESS;
 }
 
+/* returns name of journal file that goes with snapshot file, caller must free */
+static char* scr_cache_index_journal_name(const char* file)
+{
+  size_t len = strlen(file) + strlen(".journal") + 1;
+  char* name = (char*) SCR_MALLOC(len);
+  snprintf(name, len, "%s.journal", file);
+  return name;
+}
+
+/* remember cindex as the contents of file on disk */
+static void scr_cache_index_disk_set(const char* file, const kvtree* cindex, uint32_t gen, int records)
+{
+  if (scr_cache_index_disk_file == NULL || strcmp(scr_cache_index_disk_file, file) != 0) {
+    scr_free(&scr_cache_index_disk_file);
+    scr_cache_index_disk_file = strdup(file);
+  }
+  kvtree_delete(&scr_cache_index_disk);
+  scr_cache_index_disk = kvtree_new();
+  kvtree_merge(scr_cache_index_disk, cindex);
+  scr_cache_index_gen     = gen;
+  scr_cache_index_records = records;
+}
+
+/* forget what we know about the file on disk, the next write takes a snapshot */
+static void scr_cache_index_disk_clear(void)
+{
+  scr_free(&scr_cache_index_disk_file);
+  kvtree_delete(&scr_cache_index_disk);
+  scr_cache_index_records = 0;
+}
+
+/* apply journal records of snapshot generation gen onto cindex,
+ * returns number of records applied, or -1 if journal ends in a bad record */
+static int scr_cache_index_replay(const char* journal, uint32_t gen, scr_cache_index* cindex)
+{
+  if (access(journal, F_OK) != 0) {
+    return 0;
+  }
+
+  /* read the whole journal, it's small */
+  unsigned long size = scr_file_size(journal);
+  char* buf = (char*) SCR_MALLOC(size + 1);
+  int fd = scr_open(journal, O_RDONLY);
+  if (fd < 0) {
+    scr_free(&buf);
+    return -1;
+  }
+  ssize_t nread = scr_read(journal, fd, buf, size);
+  scr_close(journal, fd);
+  if (nread != (ssize_t) size) {
+    scr_free(&buf);
+    return -1;
+  }
+
+  int count = 0;
+  size_t offset = 0;
+  while (offset < size) {
+    /* stop at a record that was not written in full */
+    scr_cache_index_record rec;
+    if (size - offset < sizeof(rec)) {
+      count = -1;
+      break;
+    }
+    memcpy(&rec, buf + offset, sizeof(rec));
+    offset += sizeof(rec);
+    if (rec.magic != SCR_CINDEX_JOURNAL_MAGIC || size - offset < rec.size) {
+      count = -1;
+      break;
+    }
+    const char* data = buf + offset;
+    offset += rec.size;
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, (const Bytef*) data, (uInt) rec.size);
+    if ((uint32_t) crc != rec.crc) {
+      count = -1;
+      break;
+    }
+
+    /* skip records left over from before the last snapshot */
+    if (rec.gen != gen) {
+      continue;
+    }
+
+    kvtree* hash = kvtree_new();
+    if (rec.size > 0) {
+      kvtree_unpack(data, hash);
+    }
+    if (rec.op == SCR_CINDEX_JOURNAL_SET) {
+      kvtree* d = scr_cache_index_set_d(cindex, (int) rec.dset);
+      kvtree_unset_all(d);
+      kvtree_merge(d, hash);
+    } else if (rec.op == SCR_CINDEX_JOURNAL_DEL) {
+      scr_cache_index_remove_dataset(cindex, (int) rec.dset);
+    } else if (rec.op == SCR_CINDEX_JOURNAL_CUR) {
+      kvtree_unset(cindex, SCR_CINDEX_KEY_CURRENT);
+      kvtree_merge(cindex, hash);
+    } else if (rec.op == SCR_CINDEX_JOURNAL_RCL) {
+      kvtree_unset(cindex, SCR_CINDEX_KEY_RECLAIM);
+      kvtree_merge(cindex, hash);
+    }
+    kvtree_delete(&hash);
+    count++;
+  }
+
+  scr_free(&buf);
+  return count;
+}
+
 /* reads specified file and fills in cache index structure */
 int scr_cache_index_read(const spath* path_file, scr_cache_index* cindex)
 {
@@ -312,6 +534,25 @@ int scr_cache_index_read(const spath* path_file, scr_cache_index* cindex)
       if (kvtree_read_file(file, cindex) == KVTREE_SUCCESS) {
         /* successfully read the cache index file */
         rc = SCR_SUCCESS;
+
+        /* bring the snapshot up to date with changes recorded after it */
+        int gen = 0;
+        kvtree_util_get_int(cindex, SCR_CINDEX_KEY_JOURNAL, &gen);
+        kvtree_unset(cindex, SCR_CINDEX_KEY_JOURNAL);
+        char* journal = scr_cache_index_journal_name(file);
+        int records = scr_cache_index_replay(journal, (uint32_t) gen, cindex);
+        scr_free(&journal);
+
+        if (records >= 0) {
+          /* further changes can be appended to this journal */
+          scr_cache_index_disk_set(file, cindex, (uint32_t) gen, records);
+        } else {
+          /* records after a torn one are lost, so take a new snapshot on the next write */
+          scr_warn("Cache index journal of %s ends early, ignoring the remainder @ %s:%d",
+            file, __FILE__, __LINE__
+          );
+          scr_cache_index_disk_clear();
+        }
       } else {
         scr_err("Reading cache index %s @ %s:%d",
           file, __FILE__, __LINE__
@@ -334,8 +575,194 @@ int scr_cache_index_read(const spath* path_file, scr_cache_index* cindex)
   return rc;
 }
 
-/* writes given cache index to specified file */
-int scr_cache_index_write(const spath* file, const scr_cache_index* cindex)
+/* add a record to buf, which is extended as needed */
+static void scr_cache_index_record_add(
+  char** buf, size_t* len, uint32_t op, int dset, const kvtree* hash)
+{
+  scr_cache_index_record rec;
+  rec.magic = SCR_CINDEX_JOURNAL_MAGIC;
+  rec.op    = op;
+  rec.gen   = scr_cache_index_gen;
+  rec.dset  = (int32_t) dset;
+  rec.size  = (hash != NULL) ? (uint32_t) kvtree_pack_size(hash) : 0;
+
+  *buf = (char*) realloc(*buf, *len + sizeof(rec) + rec.size);
+  char* data = *buf + *len + sizeof(rec);
+  if (rec.size > 0) {
+    kvtree_pack(data, hash);
+  }
+  uLong crc = crc32(0L, Z_NULL, 0);
+  crc = crc32(crc, (const Bytef*) data, (uInt) rec.size);
+  rec.crc = (uint32_t) crc;
+  memcpy(*buf + *len, &rec, sizeof(rec));
+  *len += sizeof(rec) + rec.size;
+}
+
+/* returns 1 if both hashes pack to the same bytes */
+static int scr_cache_index_same(const kvtree* a, const kvtree* b)
+{
+  size_t size = kvtree_pack_size(a);
+  if (size != kvtree_pack_size(b)) {
+    return 0;
+  }
+  char* buf_a = (char*) SCR_MALLOC(size);
+  char* buf_b = (char*) SCR_MALLOC(size);
+  kvtree_pack(buf_a, a);
+  kvtree_pack(buf_b, b);
+  int same = (memcmp(buf_a, buf_b, size) == 0);
+  scr_free(&buf_a);
+  scr_free(&buf_b);
+  return same;
+}
+
+/* build records to turn the index on disk into cindex,
+ * returns number of records */
+static int scr_cache_index_diff(const kvtree* cindex, char** buf, size_t* len)
+{
+  int count = 0;
+
+  /* CURRENT name */
+  char* cur_old = NULL;
+  char* cur_new = NULL;
+  kvtree_util_get_str(scr_cache_index_disk, SCR_CINDEX_KEY_CURRENT, &cur_old);
+  kvtree_util_get_str(cindex, SCR_CINDEX_KEY_CURRENT, &cur_new);
+  if ((cur_old == NULL) != (cur_new == NULL) ||
+      (cur_old != NULL && strcmp(cur_old, cur_new) != 0))
+  {
+    kvtree* hash = kvtree_new();
+    if (cur_new != NULL) {
+      kvtree_util_set_str(hash, SCR_CINDEX_KEY_CURRENT, cur_new);
+    }
+    scr_cache_index_record_add(buf, len, SCR_CINDEX_JOURNAL_CUR, -1, hash);
+    kvtree_delete(&hash);
+    count++;
+  }
+
+  /* directories of deleted datasets still to be removed */
+  kvtree* rcl_old = kvtree_get(scr_cache_index_disk, SCR_CINDEX_KEY_RECLAIM);
+  kvtree* rcl_new = kvtree_get(cindex, SCR_CINDEX_KEY_RECLAIM);
+  if ((rcl_old == NULL) != (rcl_new == NULL) ||
+      (rcl_old != NULL && ! scr_cache_index_same(rcl_old, rcl_new)))
+  {
+    kvtree* hash = kvtree_new();
+    if (rcl_new != NULL) {
+      kvtree* copy = kvtree_new();
+      kvtree_merge(copy, rcl_new);
+      kvtree_set(hash, SCR_CINDEX_KEY_RECLAIM, copy);
+    }
+    scr_cache_index_record_add(buf, len, SCR_CINDEX_JOURNAL_RCL, -1, hash);
+    kvtree_delete(&hash);
+    count++;
+  }
+
+  /* datasets that were added or changed */
+  kvtree_elem* elem;
+  for (elem = scr_cache_index_first_dataset(cindex);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    int dset = kvtree_elem_key_int(elem);
+    kvtree* d_new = kvtree_elem_hash(elem);
+    kvtree* d_old = scr_cache_index_get_d(scr_cache_index_disk, dset);
+    if (d_old == NULL || ! scr_cache_index_same(d_old, d_new)) {
+      scr_cache_index_record_add(buf, len, SCR_CINDEX_JOURNAL_SET, dset, d_new);
+      count++;
+    }
+  }
+
+  /* datasets that were removed */
+  for (elem = scr_cache_index_first_dataset(scr_cache_index_disk);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    int dset = kvtree_elem_key_int(elem);
+    if (scr_cache_index_get_d(cindex, dset) == NULL) {
+      scr_cache_index_record_add(buf, len, SCR_CINDEX_JOURNAL_DEL, dset, NULL);
+      count++;
+    }
+  }
+
+  return count;
+}
+
+/* append changes since the last write to the journal of file,
+ * returns SCR_FAILURE if a snapshot must be written instead */
+static int scr_cache_index_append(const char* file, const scr_cache_index* cindex)
+{
+  /* without a record of what is on disk, we can't tell what changed */
+  if (scr_cache_index_journal <= 0 ||
+      scr_cache_index_disk == NULL ||
+      strcmp(scr_cache_index_disk_file, file) != 0)
+  {
+    return SCR_FAILURE;
+  }
+
+  char* buf  = NULL;
+  size_t len = 0;
+  int count = scr_cache_index_diff(cindex, &buf, &len);
+  if (count == 0) {
+    /* nothing changed, so there is nothing to write */
+    return SCR_SUCCESS;
+  }
+
+  /* compact the journal into a new snapshot once it gets long */
+  if (scr_cache_index_records + count > scr_cache_index_journal) {
+    scr_free(&buf);
+    return SCR_FAILURE;
+  }
+
+  /* append all records with a single write, scr_close syncs them */
+  int rc = SCR_FAILURE;
+  char* journal = scr_cache_index_journal_name(file);
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int fd = scr_open(journal, O_WRONLY | O_CREAT | O_APPEND, mode_file);
+  if (fd >= 0) {
+    if (scr_write(journal, fd, buf, len) == (ssize_t) len) {
+      rc = SCR_SUCCESS;
+    }
+    if (scr_close(journal, fd) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+  }
+  scr_free(&journal);
+  scr_free(&buf);
+
+  if (rc == SCR_SUCCESS) {
+    scr_cache_index_disk_set(file, cindex, scr_cache_index_gen, scr_cache_index_records + count);
+  }
+  return rc;
+}
+
+/* write cindex as a new snapshot of the next generation and drop the journal */
+static int scr_cache_index_snapshot(const spath* path_file, const char* file, const scr_cache_index* cindex)
+{
+  /* records written before now do not apply to the new snapshot */
+  uint32_t gen = scr_cache_index_gen + 1;
+
+  kvtree* hash = kvtree_new();
+  kvtree_merge(hash, cindex);
+  kvtree_util_set_int(hash, SCR_CINDEX_KEY_JOURNAL, (int) gen);
+  int kvtree_rc = kvtree_write_path(path_file, hash);
+  kvtree_delete(&hash);
+  if (kvtree_rc != KVTREE_SUCCESS) {
+    scr_cache_index_disk_clear();
+    return SCR_FAILURE;
+  }
+
+  char* journal = scr_cache_index_journal_name(file);
+  if (access(journal, F_OK) == 0) {
+    scr_file_unlink(journal);
+  }
+  scr_free(&journal);
+
+  scr_cache_index_disk_set(file, cindex, gen, 0);
+  return SCR_SUCCESS;
+}
+
+/* writes given cache index to specified file,
+ * appends only what changed since the last write to a journal next to the file,
+ * and rewrites the file itself once the journal grows long */
+int scr_cache_index_write(const spath* path_file, const scr_cache_index* cindex)
 {
   /* check that we have a cindex pointer */
   if (cindex == NULL) {
@@ -343,16 +770,37 @@ int scr_cache_index_write(const spath* file, const scr_cache_index* cindex)
   }
 
   if (scr_storedesc_cntl->rank == 0) {
-    /* write out the hash */
-    if (kvtree_write_path(file, cindex) != KVTREE_SUCCESS) {
-      char path_err[SCR_MAX_FILENAME];
-      spath_strcpy(path_err, sizeof(path_err), file);
+    char* file = spath_strdup(path_file);
+    int rc = scr_cache_index_append(file, cindex);
+    if (rc != SCR_SUCCESS) {
+      rc = scr_cache_index_snapshot(path_file, file, cindex);
+    }
+    if (rc != SCR_SUCCESS) {
       scr_err("Writing cache index %s @ %s:%d",
-        path_err, __FILE__, __LINE__
+        file, __FILE__, __LINE__
       );
-      return SCR_FAILURE;
     }
+    scr_free(&file);
+    return rc;
+  }
+
+  return SCR_SUCCESS;
+}
+
+/* deletes specified cache index file along with its journal */
+int scr_cache_index_unlink(const spath* path_file)
+{
+  char* file = spath_strdup(path_file);
+  char* journal = scr_cache_index_journal_name(file);
+  scr_file_unlink(file);
+  if (access(journal, F_OK) == 0) {
+    scr_file_unlink(journal);
   }
+  scr_free(&journal);
+  scr_free(&file);
+
+  /* the next write starts from a snapshot */
+  scr_cache_index_disk_clear();
 
   return SCR_SUCCESS;
 }
@@ -81,6 +81,18 @@ int scr_cache_index_set_bypass(scr_cache_index* cindex, int dset, int bypass);
 /* get value of bypass flag for dataset */
 int scr_cache_index_get_bypass(const scr_cache_index* cindex, int dset, int* bypass);
 
+/* mark dataset as needing a rebuild, e.g., after a node failure was reported */
+int scr_cache_index_set_rebuild(scr_cache_index* cindex, int dset, int rebuild);
+
+/* get value of rebuild flag for dataset */
+int scr_cache_index_get_rebuild(const scr_cache_index* cindex, int dset, int* rebuild);
+
+/* mark whether the filemap of dataset may lack files routed during output */
+int scr_cache_index_set_map_deferred(scr_cache_index* cindex, int dset, int deferred);
+
+/* get value of deferred filemap flag for dataset */
+int scr_cache_index_get_map_deferred(const scr_cache_index* cindex, int dset, int* deferred);
+
 /*
 =========================================
 Cache index clear and copy functions
@@ -90,6 +102,15 @@ Cache index clear and copy functions
 /* remove all associations for a given dataset */
 int scr_cache_index_remove_dataset(scr_cache_index* cindex, int dset);
 
+/* record that directory dir of a deleted dataset is still to be removed */
+int scr_cache_index_set_reclaim(scr_cache_index* cindex, const char* dir);
+
+/* record that directory dir has been removed or is in use again */
+int scr_cache_index_unset_reclaim(scr_cache_index* cindex, const char* dir);
+
+/* returns elem of first directory still to be removed, the key is its path */
+kvtree_elem* scr_cache_index_first_reclaim(const scr_cache_index* cindex);
+
 /* clear the cache index completely */
 int scr_cache_index_clear(scr_cache_index* cindex);
 
@@ -136,9 +157,14 @@ Cache index read/write/free functions
 /* reads specified file and fills in cache index structure */
 int scr_cache_index_read(const spath* file, scr_cache_index* cindex);
 
-/* writes given cache index to specified file */
+/* writes given cache index to specified file,
+ * appends only what changed since the last write to a journal next to the file,
+ * and rewrites the file itself once the journal grows long */
 int scr_cache_index_write(const spath* file, const scr_cache_index* cindex);
 
+/* deletes specified cache index file along with its journal */
+int scr_cache_index_unlink(const spath* file);
+
 /* create a new cache index structure */
 scr_cache_index* scr_cache_index_new(void);
 
@@ -32,112 +32,156 @@
 
 #include "scr_globals.h"
 
+#include <dirent.h>
+
 /*
 =========================================
 Distribute and file rebuild functions
 =========================================
 */
 
-/* broadcast dataset hash from smallest rank we can find that has a copy */
-static int scr_distribute_datasets(scr_cache_index* cindex, int id)
+/* keys of the hash that carries meta data of many datasets in one bcast */
+#define SCR_DISTRIBUTE_KEY_ID     ("ID")
+#define SCR_DISTRIBUTE_KEY_DSET   ("DSET")
+#define SCR_DISTRIBUTE_KEY_BYPASS ("BYPASS")
+#define SCR_DISTRIBUTE_KEY_DIR    ("DIR")
+
+/* distribute the dataset hash, bypass flag, and cache directory of each
+ * of the n datasets in ids from the smallest rank that has a copy,
+ * sets have_dset[i] if dataset i got its hash and bypass flag, and
+ * have_dir[i] if it also got its directory, the lowest ranks holding
+ * meta data usually hold it for every dataset, so this costs a single
+ * reduction and one bcast from each distinct source rank, rather than
+ * rounds of collectives for each dataset */
+static int scr_distribute_datasets(scr_cache_index* cindex, int n, const int* ids, int* have_dset, int* have_dir)
 {
-  /* attempt to read dataset from our index */
-  int source_rank = scr_ranks_world;
-  scr_dataset* dataset = scr_dataset_new();
-  if (scr_cache_index_get_dataset(cindex, id, dataset) == SCR_SUCCESS) {
-    source_rank = scr_my_rank_world;
-  }
-
-  /* identify the smallest rank that has the dataset */
-  int min_rank;
-  MPI_Allreduce(&source_rank, &min_rank, 1, MPI_INT, MPI_MIN, scr_comm_world);
-
-  /* if there is no rank, return with failure */
-  if (min_rank >= scr_ranks_world) {
+  int i;
+
+  /* note which items we could serve as a source for */
+  int* source = (int*) SCR_MALLOC(3 * n * sizeof(int));
+  int* min_rank = (int*) SCR_MALLOC(3 * n * sizeof(int));
+  for (i = 0; i < n; i++) {
+    int bypass;
+    char* dir;
+    scr_dataset* dataset = scr_dataset_new();
+    int got_dset = (scr_cache_index_get_dataset(cindex, ids[i], dataset) == SCR_SUCCESS);
+    int got_bypass = (scr_cache_index_get_bypass(cindex, ids[i], &bypass) == SCR_SUCCESS);
+    int got_dir = (scr_cache_index_get_dir(cindex, ids[i], &dir) == SCR_SUCCESS);
+    source[i * 3 + 0] = got_dset   ? scr_my_rank_world : scr_ranks_world;
+    source[i * 3 + 1] = got_bypass ? scr_my_rank_world : scr_ranks_world;
+    source[i * 3 + 2] = got_dir    ? scr_my_rank_world : scr_ranks_world;
     scr_dataset_delete(&dataset);
-    return SCR_FAILURE;
   }
 
-  /* otherwise, bcast the dataset from the minimum rank */
-  if (scr_my_rank_world != min_rank) {
-    kvtree_unset_all(dataset);
-  }
-  kvtree_bcast(dataset, min_rank, scr_comm_world);
+  /* identify the smallest rank that has each item */
+  MPI_Allreduce(source, min_rank, 3 * n, MPI_INT, MPI_MIN, scr_comm_world);
+
+  /* bcast items from each source rank in turn, lowest first,
+   * every proc computes the same sequence of sources */
+  int last = -1;
+  while (1) {
+    /* find the next source rank above the last one */
+    int root = scr_ranks_world;
+    for (i = 0; i < 3 * n; i++) {
+      if (min_rank[i] > last && min_rank[i] < root) {
+        root = min_rank[i];
+      }
+    }
+    if (root >= scr_ranks_world) {
+      break;
+    }
+    last = root;
 
-  /* attempt to read bypass property from our index */
-  source_rank = scr_ranks_world;
-  int bypass;
-  if (scr_cache_index_get_bypass(cindex, id, &bypass) == SCR_SUCCESS) {
-    source_rank = scr_my_rank_world;
-  }
+    /* the source packs every item it serves into one hash */
+    kvtree* hash = kvtree_new();
+    if (scr_my_rank_world == root) {
+      for (i = 0; i < n; i++) {
+        int id = ids[i];
+        kvtree* id_hash = NULL;
+        if (min_rank[i * 3 + 0] == root) {
+          id_hash = kvtree_set_kv_int(hash, SCR_DISTRIBUTE_KEY_ID, id);
+          scr_dataset* dataset = scr_dataset_new();
+          scr_cache_index_get_dataset(cindex, id, dataset);
+          kvtree_set(id_hash, SCR_DISTRIBUTE_KEY_DSET, dataset);
+        }
+        if (min_rank[i * 3 + 1] == root) {
+          id_hash = kvtree_set_kv_int(hash, SCR_DISTRIBUTE_KEY_ID, id);
+          int bypass;
+          scr_cache_index_get_bypass(cindex, id, &bypass);
+          kvtree_util_set_int(id_hash, SCR_DISTRIBUTE_KEY_BYPASS, bypass);
+        }
+        if (min_rank[i * 3 + 2] == root) {
+          id_hash = kvtree_set_kv_int(hash, SCR_DISTRIBUTE_KEY_ID, id);
+          char* dir;
+          scr_cache_index_get_dir(cindex, id, &dir);
+          kvtree_util_set_str(id_hash, SCR_DISTRIBUTE_KEY_DIR, dir);
+        }
+      }
+    }
+    kvtree_bcast(hash, root, scr_comm_world);
+
+    /* record what we got in our cache index */
+    for (i = 0; i < n; i++) {
+      int id = ids[i];
+      kvtree* id_hash = kvtree_get_kv_int(hash, SCR_DISTRIBUTE_KEY_ID, id);
+      if (id_hash == NULL) {
+        continue;
+      }
 
-  /* identify the smallest rank that has the value */
-  MPI_Allreduce(&source_rank, &min_rank, 1, MPI_INT, MPI_MIN, scr_comm_world);
+      kvtree* dataset = kvtree_get(id_hash, SCR_DISTRIBUTE_KEY_DSET);
+      if (dataset != NULL) {
+        scr_cache_index_set_dataset(cindex, id, dataset);
+      }
 
-  /* if there is no rank, return with failure */
-  if (min_rank >= scr_ranks_world) {
-    scr_dataset_delete(&dataset);
-    return SCR_FAILURE;
-  }
+      int bypass;
+      if (kvtree_util_get_int(id_hash, SCR_DISTRIBUTE_KEY_BYPASS, &bypass) == KVTREE_SUCCESS) {
+        scr_cache_index_set_bypass(cindex, id, bypass);
+      }
 
-  /* otherwise, bcast the bypass property from the minimum rank */
-  MPI_Bcast(&bypass, 1, MPI_INT, min_rank, scr_comm_world);
+      char* dir;
+      if (kvtree_util_get_str(id_hash, SCR_DISTRIBUTE_KEY_DIR, &dir) == KVTREE_SUCCESS) {
+        scr_cache_index_set_dir(cindex, id, dir);
+      }
+    }
+    kvtree_delete(&hash);
+  }
 
-  /* record the descriptor in our cache index */
-  scr_cache_index_set_dataset(cindex, id, dataset);
-  scr_cache_index_set_bypass(cindex, id, bypass);
+  /* write the cache index once for all datasets */
   scr_cache_index_write(scr_cindex_file, cindex);
 
-  /* free off dataset object */
-  scr_dataset_delete(&dataset);
+  /* a dataset is only usable if someone had each item */
+  for (i = 0; i < n; i++) {
+    have_dset[i] = (min_rank[i * 3 + 0] < scr_ranks_world &&
+                    min_rank[i * 3 + 1] < scr_ranks_world);
+    have_dir[i]  = (have_dset[i] && min_rank[i * 3 + 2] < scr_ranks_world);
+  }
+
+  scr_free(&min_rank);
+  scr_free(&source);
 
   return SCR_SUCCESS;
 }
 
-/* broadcast dir from smallest rank and lookup store descriptor we can find that has a copy */
+/* lookup store descriptor of the cache directory of dataset id, which
+ * scr_distribute_datasets has recorded on all procs, and create the
+ * directory along with its hidden .scr directory, which we return */
 static int scr_distribute_dir(scr_cache_index* cindex, int id, char** hidden_dir)
 {
   /* initialize output path to NULL */
   *hidden_dir = NULL;
 
-  /* determine whether we have the cache directory for this dataset */
-  char* dir  = NULL;
-  char* path = NULL;
-  int source_rank = scr_ranks_world;
-  if (scr_cache_index_get_dir(cindex, id, &path) == SCR_SUCCESS) {
-    /* we've got a copy, make a copy */
-    dir = strdup(path);
-    source_rank = scr_my_rank_world;
-  }
-
-  /* identify the smallest rank that has the dataset */
-  int min_rank;
-  MPI_Allreduce(&source_rank, &min_rank, 1, MPI_INT, MPI_MIN, scr_comm_world);
-
-  /* if there is no rank, return with failure */
-  if (min_rank >= scr_ranks_world) {
-    return SCR_FAILURE;
-  }
-
-  /* if we're not bcasting the string, free our copy if we have one,
-   * we'll get a new copy from the bcast */
-  if (scr_my_rank_world != min_rank) {
-    scr_free(&dir);
-  }
-
-  /* bcast the dataset from the minimum rank */
-  scr_str_bcast(&dir, min_rank, scr_comm_world);
-
-  /* record the directory in the cache index */
-  scr_cache_index_set_dir(cindex, id, dir);
-  scr_cache_index_write(scr_cindex_file, cindex);
+  /* get the cache directory for this dataset */
+  char* dir = NULL;
+  scr_cache_index_get_dir(cindex, id, &dir);
 
   /* lookup store descriptor for this path */
-  int store_index = scr_storedescs_index_from_child_path(dir);
+  int store_index = -1;
+  if (dir != NULL) {
+    store_index = scr_storedescs_index_from_child_path(dir);
+  }
 
   /* if someone fails to find their descriptor give up */
   if (! scr_alltrue(store_index >= 0, scr_comm_world)) {
-    scr_free(&dir);
     return SCR_FAILURE;
   }
 
@@ -150,21 +194,564 @@ static int scr_distribute_dir(scr_cache_index* cindex, int id, char** hidden_dir
   /* get store descriptor */
   scr_storedesc* store = &scr_storedescs[store_index];
 
+  /* keep a delete that is still reclaiming this directory off of it */
+  scr_reclaim_reuse(dir);
+
   /* create the directory */
   scr_storedesc_dir_create(store, dir);
 
   /* create the hidden directory */
   scr_storedesc_dir_create(store, *hidden_dir);
 
-  /* free direcotry string */
-  scr_free(&dir);
+  /* and directories for files striped across other stores */
+  scr_cache_stripe_dirs_create(dir, id);
+
+  return SCR_SUCCESS;
+}
+
+/* tags for messages that move files between caches */
+#define SCR_DISTRIBUTE_TAG_NEED (7272)
+#define SCR_DISTRIBUTE_TAG_DATA (7273)
+#define SCR_DISTRIBUTE_TAG_ACK  (7274)
+
+/* where we are in the stream of files sent to us */
+#define SCR_DISTRIBUTE_RECV_MAP    (0)
+#define SCR_DISTRIBUTE_RECV_HEADER (1)
+#define SCR_DISTRIBUTE_RECV_DATA   (2)
+#define SCR_DISTRIBUTE_RECV_DONE   (3)
+
+/* size we send for a file the sender could not read */
+#define SCR_DISTRIBUTE_MISSING (~0ULL)
+
+/* state of the stream of files we receive from the process holding them,
+ * the stream is our filemap, followed by a header of size and name for
+ * each file and its data in chunks, and ends with a header with no name */
+typedef struct {
+  int    src;        /* rank sending us our files, -1 if none */
+  int    state;      /* SCR_DISTRIBUTE_RECV_* */
+  int    rc;         /* SCR_FAILURE if we lost anything */
+  int    fd;         /* file we are writing, -1 if none */
+  char*  file;       /* name of file we are writing */
+  unsigned long long remaining; /* bytes of file still to come */
+  char*  buf;        /* buffer to receive messages */
+  int    buf_size;   /* size of buffer in bytes */
+  const scr_cache_index* cindex; /* cache index to write our filemap to */
+  int    id;         /* dataset id being moved */
+} scr_distribute_recv_t;
+
+/* handle the next message of count bytes in our stream */
+static void scr_distribute_recv_handle(scr_distribute_recv_t* r, int count)
+{
+  if (r->state == SCR_DISTRIBUTE_RECV_MAP) {
+    /* an empty map means the sender could not read ours */
+    if (count == 0) {
+      r->rc = SCR_FAILURE;
+      r->state = SCR_DISTRIBUTE_RECV_DONE;
+      return;
+    }
+    scr_filemap* map = scr_filemap_new();
+    kvtree_unpack(r->buf, map);
+    if (scr_cache_set_map(r->cindex, r->id, map) != SCR_SUCCESS) {
+      r->rc = SCR_FAILURE;
+    }
+    scr_filemap_delete(&map);
+    r->state = SCR_DISTRIBUTE_RECV_HEADER;
+  } else if (r->state == SCR_DISTRIBUTE_RECV_HEADER) {
+    /* header is the size of the file followed by its name */
+    unsigned long long size;
+    memcpy(&size, r->buf, sizeof(size));
+    const char* name = r->buf + sizeof(size);
+    if (strcmp(name, "") == 0) {
+      r->state = SCR_DISTRIBUTE_RECV_DONE;
+      return;
+    }
+    if (size == SCR_DISTRIBUTE_MISSING) {
+      scr_err("Holder of our cache lost %s @ %s:%d",
+        name, __FILE__, __LINE__
+      );
+      r->rc = SCR_FAILURE;
+      return;
+    }
+
+    mode_t mode_file = scr_getmode(1, 1, 0);
+    r->fd = scr_open(name, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+    if (r->fd < 0) {
+      scr_err("Failed to open file for writing: scr_open(%s) errno=%d %s @ %s:%d",
+        name, errno, strerror(errno), __FILE__, __LINE__
+      );
+      r->rc = SCR_FAILURE;
+    }
+    r->file = strdup(name);
+    r->remaining = size;
+    r->state = SCR_DISTRIBUTE_RECV_DATA;
+  } else if (r->state == SCR_DISTRIBUTE_RECV_DATA) {
+    if (r->fd >= 0 && scr_write(r->file, r->fd, r->buf, (size_t) count) != (ssize_t) count) {
+      scr_err("Failed to write %d bytes to %s @ %s:%d",
+        count, r->file, __FILE__, __LINE__
+      );
+      r->rc = SCR_FAILURE;
+    }
+    r->remaining -= (unsigned long long) count;
+  }
+
+  /* close the file once it is all here */
+  if (r->state == SCR_DISTRIBUTE_RECV_DATA && r->remaining == 0) {
+    if (r->fd >= 0 && scr_close(r->file, r->fd) != SCR_SUCCESS) {
+      r->rc = SCR_FAILURE;
+    }
+    r->fd = -1;
+    scr_free(&r->file);
+    r->state = SCR_DISTRIBUTE_RECV_HEADER;
+  }
+}
+
+/* receive any messages of our stream that have arrived,
+ * waits for the whole stream if block is set */
+static void scr_distribute_recv_progress(scr_distribute_recv_t* r, int block)
+{
+  while (r->state != SCR_DISTRIBUTE_RECV_DONE) {
+    int flag = 1;
+    MPI_Status status;
+    if (block) {
+      MPI_Probe(r->src, SCR_DISTRIBUTE_TAG_DATA, scr_comm_world, &status);
+    } else {
+      MPI_Iprobe(r->src, SCR_DISTRIBUTE_TAG_DATA, scr_comm_world, &flag, &status);
+    }
+    if (! flag) {
+      return;
+    }
+
+    int count;
+    MPI_Get_count(&status, MPI_BYTE, &count);
+    if (count > r->buf_size) {
+      scr_free(&r->buf);
+      r->buf = (char*) SCR_MALLOC(count);
+      r->buf_size = count;
+    }
+    MPI_Recv(r->buf, count, MPI_BYTE, r->src, SCR_DISTRIBUTE_TAG_DATA, scr_comm_world, &status);
+
+    scr_distribute_recv_handle(r, count);
+  }
+}
+
+/* send size bytes of buf to dest, receiving our own stream while we
+ * wait, so that procs that both send and receive files never deadlock */
+static void scr_distribute_send(const void* buf, int size, int dest, scr_distribute_recv_t* r)
+{
+  MPI_Request request;
+  MPI_Isend((void*) buf, size, MPI_BYTE, dest, SCR_DISTRIBUTE_TAG_DATA, scr_comm_world, &request);
+  int done = 0;
+  while (! done) {
+    MPI_Test(&request, &done, MPI_STATUS_IGNORE);
+    if (! done) {
+      scr_distribute_recv_progress(r, 0);
+    }
+  }
+}
+
+/* send a file header of size and name to dest */
+static void scr_distribute_send_header(
+  unsigned long long size, const char* name, int dest, scr_distribute_recv_t* r)
+{
+  int len = (int) (sizeof(size) + strlen(name) + 1);
+  char* header = (char*) SCR_MALLOC(len);
+  memcpy(header, &size, sizeof(size));
+  strcpy(header + sizeof(size), name);
+  scr_distribute_send(header, len, dest, r);
+  scr_free(&header);
+}
+
+/* send the filemap of rank and its files that we hold in hidden_dir
+ * to that rank, returns 1 if we sent every file intact */
+static int scr_distribute_send_files(const char* hidden_dir, int rank, scr_distribute_recv_t* r)
+{
+  spath* map_path = spath_from_str(hidden_dir);
+  spath_append_strf(map_path, "filemap_%d", rank);
+
+  /* send the filemap, an empty message if we can't read it */
+  scr_filemap* map = scr_filemap_new();
+  if (scr_filemap_read(map_path, map) != SCR_SUCCESS) {
+    scr_distribute_send(NULL, 0, rank, r);
+    scr_filemap_delete(&map);
+    spath_delete(&map_path);
+    return 0;
+  }
+  size_t map_size = kvtree_pack_size(map);
+  char* map_buf = (char*) SCR_MALLOC(map_size);
+  kvtree_pack(map_buf, map);
+  scr_distribute_send(map_buf, (int) map_size, rank, r);
+  scr_free(&map_buf);
+
+  /* send each file as a header followed by its data */
+  int sent_all = 1;
+  char* buf = (char*) SCR_MALLOC(scr_file_buf_size);
+  kvtree_elem* elem;
+  for (elem = scr_filemap_first_file(map);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    const char* file = kvtree_elem_key(elem);
+    int fd = scr_open(file, O_RDONLY);
+    if (fd < 0) {
+      scr_distribute_send_header(SCR_DISTRIBUTE_MISSING, file, rank, r);
+      sent_all = 0;
+      continue;
+    }
+    unsigned long long size = (unsigned long long) scr_file_size(file);
+    scr_distribute_send_header(size, file, rank, r);
+
+    /* we must send exactly size bytes, so pad with zeros on a short
+     * read, the receiver checks the file against its meta data */
+    while (size > 0) {
+      size_t chunk = scr_file_buf_size;
+      if ((unsigned long long) chunk > size) {
+        chunk = (size_t) size;
+      }
+      ssize_t nread = scr_read(file, fd, buf, chunk);
+      if (nread != (ssize_t) chunk) {
+        memset(buf, 0, chunk);
+        sent_all = 0;
+      }
+      scr_distribute_send(buf, (int) chunk, rank, r);
+      size -= (unsigned long long) chunk;
+    }
+    scr_close(file, fd);
+  }
+  scr_free(&buf);
+  scr_distribute_send_header(0, "", rank, r);
+
+  scr_filemap_delete(&map);
+  spath_delete(&map_path);
+
+  return sent_all;
+}
+
+/* delete the filemap of rank and its files that we hold in hidden_dir,
+ * call only after rank has confirmed that it has its own copies */
+static void scr_distribute_delete_files(const char* hidden_dir, int rank)
+{
+  spath* map_path = spath_from_str(hidden_dir);
+  spath_append_strf(map_path, "filemap_%d", rank);
+
+  scr_filemap* map = scr_filemap_new();
+  if (scr_filemap_read(map_path, map) == SCR_SUCCESS) {
+    kvtree_elem* elem;
+    for (elem = scr_filemap_first_file(map);
+         elem != NULL;
+         elem = kvtree_elem_next(elem))
+    {
+      scr_file_unlink(kvtree_elem_key(elem));
+    }
+    char* map_file = spath_strdup(map_path);
+    scr_file_unlink(map_file);
+    scr_free(&map_file);
+  }
+
+  scr_filemap_delete(&map);
+  spath_delete(&map_path);
+}
+
+/* when ranks run on different nodes than before, move the filemap and
+ * files of each rank from the cache of the node that holds them to the
+ * cache of the node the rank runs on now, sets moved on all procs if any
+ * files were moved, and returns SCR_SUCCESS if every rank has its files */
+static int scr_distribute_files(scr_cache_index* cindex, int id, const char* hidden_dir, int* moved)
+{
+  *moved = 0;
+
+  /* nothing to do if everyone finds its filemap */
+  spath* map_path = spath_from_str(hidden_dir);
+  spath_append_strf(map_path, "filemap_%d", scr_my_rank_world);
+  char* map_file = spath_strdup(map_path);
+  spath_delete(&map_path);
+  int have = (access(map_file, R_OK) == 0);
+  scr_free(&map_file);
+  if (scr_alltrue(have, scr_comm_world)) {
+    return SCR_SUCCESS;
+  }
+
+  /* get the store that holds the cache directory */
+  int store_index = scr_storedescs_index_from_child_path(hidden_dir);
+  if (! scr_alltrue(store_index >= 0, scr_comm_world)) {
+    scr_err("Failed to find store for %s @ %s:%d",
+      hidden_dir, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+  scr_storedesc* store = &scr_storedescs[store_index];
+
+  /* learn which ranks run on our node now */
+  int* local_ranks = (int*) SCR_MALLOC(store->ranks * sizeof(int));
+  MPI_Allgather(&scr_my_rank_world, 1, MPI_INT, local_ranks, 1, MPI_INT, store->comm);
 
+  /* one proc per node offers the filemaps it finds for ranks that
+   * now run elsewhere, the lowest offering rank wins */
+  int i;
+  int* owner = (int*) SCR_MALLOC(scr_ranks_world * sizeof(int));
+  for (i = 0; i < scr_ranks_world; i++) {
+    owner[i] = scr_ranks_world;
+  }
+  if (store->rank == 0) {
+    DIR* dirp = opendir(hidden_dir);
+    struct dirent* de;
+    while (dirp != NULL && (de = readdir(dirp)) != NULL) {
+      int rank, len;
+      if (sscanf(de->d_name, "filemap_%d%n", &rank, &len) != 1 ||
+          de->d_name[len] != '\0' || rank < 0 || rank >= scr_ranks_world)
+      {
+        continue;
+      }
+      int local = 0;
+      int j;
+      for (j = 0; j < store->ranks; j++) {
+        if (local_ranks[j] == rank) {
+          local = 1;
+        }
+      }
+      if (! local) {
+        owner[rank] = scr_my_rank_world;
+      }
+    }
+    if (dirp != NULL) {
+      closedir(dirp);
+    }
+  }
+  MPI_Allreduce(MPI_IN_PLACE, owner, scr_ranks_world, MPI_INT, MPI_MIN, scr_comm_world);
+  scr_free(&local_ranks);
+
+  /* tell our holder whether we need our files */
+  MPI_Request request = MPI_REQUEST_NULL;
+  int need = (! have);
+  int holder = owner[scr_my_rank_world];
+  if (holder < scr_ranks_world) {
+    MPI_Isend(&need, 1, MPI_INT, holder, SCR_DISTRIBUTE_TAG_NEED, scr_comm_world, &request);
+  }
+
+  /* and learn which of the ranks we hold files for need them */
+  int count = 0;
+  int* send_ranks = (int*) SCR_MALLOC(scr_ranks_world * sizeof(int));
+  for (i = 0; i < scr_ranks_world; i++) {
+    if (owner[i] == scr_my_rank_world) {
+      int flag;
+      MPI_Recv(&flag, 1, MPI_INT, i, SCR_DISTRIBUTE_TAG_NEED, scr_comm_world, MPI_STATUS_IGNORE);
+      if (flag) {
+        send_ranks[count] = i;
+        count++;
+      }
+    }
+  }
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
+  scr_free(&owner);
+
+  /* send the files we hold while receiving our own */
+  scr_distribute_recv_t r;
+  r.src       = (need && holder < scr_ranks_world) ? holder : -1;
+  r.state     = (r.src >= 0) ? SCR_DISTRIBUTE_RECV_MAP : SCR_DISTRIBUTE_RECV_DONE;
+  r.rc        = SCR_SUCCESS;
+  r.fd        = -1;
+  r.file      = NULL;
+  r.remaining = 0;
+  r.buf       = NULL;
+  r.buf_size  = 0;
+  r.cindex    = cindex;
+  r.id        = id;
+  int* sent = (int*) SCR_MALLOC(scr_ranks_world * sizeof(int));
+  for (i = 0; i < count; i++) {
+    sent[i] = scr_distribute_send_files(hidden_dir, send_ranks[i], &r);
+  }
+  scr_distribute_recv_progress(&r, 1);
+  scr_free(&r.buf);
+
+  /* tell our holder whether we have our files now, and delete the
+   * copies we hold only once their new owner confirms it has them */
+  int ack = (r.rc == SCR_SUCCESS);
+  request = MPI_REQUEST_NULL;
+  if (r.src >= 0) {
+    MPI_Isend(&ack, 1, MPI_INT, r.src, SCR_DISTRIBUTE_TAG_ACK, scr_comm_world, &request);
+  }
+  for (i = 0; i < count; i++) {
+    int flag;
+    MPI_Recv(&flag, 1, MPI_INT, send_ranks[i], SCR_DISTRIBUTE_TAG_ACK, scr_comm_world, MPI_STATUS_IGNORE);
+    if (flag && sent[i]) {
+      scr_distribute_delete_files(hidden_dir, send_ranks[i]);
+    }
+  }
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
+  scr_free(&sent);
+  scr_free(&send_ranks);
+
+  /* a rank has its files if it kept them or received them intact */
+  int received = (r.src >= 0 && r.rc == SCR_SUCCESS);
+  if (! scr_alltrue(r.src < 0, scr_comm_world)) {
+    *moved = 1;
+  }
+  if (! scr_alltrue(have || received, scr_comm_world)) {
+    return SCR_FAILURE;
+  }
   return SCR_SUCCESS;
 }
 
+/* returns 1 on all procs if every rank either finds its filemap in the
+ * cache of its node or runs on a spare node whose cache holds no
+ * filemap at all, in which case ranks on spare nodes take the place of
+ * a failed node and only their files need to be rebuilt, sets spares
+ * to the number of such nodes */
+static int scr_distribute_in_place(const char* hidden_dir, int* spares)
+{
+  *spares = 0;
+
+  /* check whether we find our own filemap */
+  spath* map_path = spath_from_str(hidden_dir);
+  spath_append_strf(map_path, "filemap_%d", scr_my_rank_world);
+  char* map_file = spath_strdup(map_path);
+  spath_delete(&map_path);
+  int have = (access(map_file, R_OK) == 0);
+  scr_free(&map_file);
+
+  /* get the store that holds the cache directory,
+   * without one we can't tell whether files are in place */
+  int store_index = scr_storedescs_index_from_child_path(hidden_dir);
+  if (! scr_alltrue(store_index >= 0, scr_comm_world)) {
+    return 0;
+  }
+  scr_storedesc* store = &scr_storedescs[store_index];
+
+  /* determine whether all or none of the ranks on our node have theirs */
+  int all_have, any_have;
+  MPI_Allreduce(&have, &all_have, 1, MPI_INT, MPI_LAND, store->comm);
+  MPI_Allreduce(&have, &any_have, 1, MPI_INT, MPI_LOR,  store->comm);
+
+  /* a node on which no rank finds its filemap is only a spare if it
+   * does not hold files for other ranks either, otherwise ranks moved */
+  int spare = 0;
+  if (! any_have && store->rank == 0) {
+    spare = 1;
+    DIR* dirp = opendir(hidden_dir);
+    struct dirent* de;
+    while (dirp != NULL && (de = readdir(dirp)) != NULL) {
+      if (strncmp(de->d_name, "filemap_", 8) == 0) {
+        spare = 0;
+        break;
+      }
+    }
+    if (dirp != NULL) {
+      closedir(dirp);
+    }
+  }
+  MPI_Bcast(&spare, 1, MPI_INT, 0, store->comm);
+
+  /* count the spare nodes */
+  int count = (spare && store->rank == 0);
+  MPI_Allreduce(&count, spares, 1, MPI_INT, MPI_SUM, scr_comm_world);
+
+  return scr_alltrue(all_have || spare, scr_comm_world);
+}
+
+/* return 1 if we have a filemap for dataset id and every file in it
+ * is intact, 0 otherwise */
+static int scr_distribute_have_files(const scr_cache_index* cindex, int id)
+{
+  scr_filemap* map = scr_filemap_new();
+  if (scr_cache_get_map(cindex, id, map) != SCR_SUCCESS) {
+    scr_filemap_delete(&map);
+    return 0;
+  }
+
+  int valid = 1;
+  scr_cache_stat_files(map);
+  kvtree_elem* elem;
+  for (elem = scr_filemap_first_file(map);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    const char* file = kvtree_elem_key(elem);
+    if (! scr_bool_have_file(map, file)) {
+      scr_dbg(2, "File determined to be invalid: %s", file);
+      valid = 0;
+    }
+  }
+  scr_statx_clear();
+
+  scr_filemap_delete(&map);
+  return valid;
+}
+
+/* after files were moved between nodes or fetched for some ranks, the
+ * redundancy data no longer matches the files, so check the files and
+ * apply the redundancy scheme again from scratch */
+static int scr_distribute_reapply(scr_cache_index* cindex, int id)
+{
+  /* the scheme encodes files as the application wrote them */
+  scr_cache_compress_restore(cindex, id);
+
+  /* check that we have all of our files */
+  int valid = scr_distribute_have_files(cindex, id);
+  if (! scr_alltrue(valid, scr_comm_world)) {
+    return SCR_FAILURE;
+  }
+  scr_filemap* map = scr_filemap_new();
+  scr_cache_get_map(cindex, id, map);
+
+  /* find the descriptor that placed the dataset in its directory,
+   * preferring the one we'd use for a checkpoint */
+  char* dir = NULL;
+  scr_cache_index_get_dir(cindex, id, &dir);
+  scr_reddesc* desc = NULL;
+  scr_dataset* dataset = scr_dataset_new();
+  scr_cache_index_get_dataset(cindex, id, dataset);
+  int ckpt_id;
+  if (scr_dataset_get_ckpt(dataset, &ckpt_id) == SCR_SUCCESS) {
+    desc = scr_reddesc_for_checkpoint(ckpt_id, scr_nreddescs, scr_reddescs);
+  }
+  scr_dataset_delete(&dataset);
+  int i;
+  for (i = -1; i < scr_nreddescs; i++) {
+    scr_reddesc* d = (i < 0) ? desc : &scr_reddescs[i];
+    if (d == NULL || ! d->enabled) {
+      continue;
+    }
+    char* d_dir = scr_cache_dir_get(d, id);
+    int match = (dir != NULL && strcmp(d_dir, dir) == 0);
+    scr_free(&d_dir);
+    if (match) {
+      desc = d;
+      break;
+    }
+    desc = NULL;
+  }
+  if (desc == NULL) {
+    if (scr_my_rank_world == 0) {
+      scr_err("No redundancy descriptor for dataset %d in %s @ %s:%d",
+        id, dir, __FILE__, __LINE__
+      );
+    }
+    scr_filemap_delete(&map);
+    return SCR_FAILURE;
+  }
+
+  /* copy the descriptor to apply the bypass setting of the dataset */
+  scr_reddesc rd;
+  kvtree* rd_hash = kvtree_new();
+  scr_reddesc_init(&rd);
+  scr_reddesc_store_to_hash(desc, rd_hash);
+  scr_reddesc_create_from_hash(&rd, -1, rd_hash);
+  kvtree_delete(&rd_hash);
+  int bypass = 0;
+  scr_cache_index_get_bypass(cindex, id, &bypass);
+  rd.bypass = bypass;
+
+  int rc = scr_reddesc_apply(map, &rd, id);
+
+  scr_reddesc_free(&rd);
+  scr_filemap_delete(&map);
+  return rc;
+}
+
 /* distribute and rebuild files in cache */
 int scr_cache_rebuild(scr_cache_index* cindex)
 {
+  scr_trace_mark_begin("rebuild");
+
   int rc = SCR_FAILURE;
 
   /* start timer */
@@ -220,158 +807,238 @@ int scr_cache_rebuild(scr_cache_index* cindex)
   int* dsets;
   scr_cache_index_list_datasets(cindex, &ndsets, &dsets);
 
-  /* TODO: put dataset selection logic into a function */
+  /* the application and the redundancy schemes read files directly,
+   * so write out any files that were deduplicated, files kept compressed
+   * are written out only for datasets we rebuild, restart from, or flush */
+  int i;
+  for (i = 0; i < ndsets; i++) {
+    scr_cache_dedup_restore(cindex, dsets[i]);
+  }
+
+  /* agree on the datasets that anyone has up front */
+  int nall;
+  int* all;
+  scr_cache_list_all_datasets(ndsets, dsets, &nall, &all);
+
+  /* distribute meta data of all of them at once, so that each rebuild
+   * below only has its own directory and files left to deal with */
+  int* have_dset = (int*) SCR_MALLOC(nall * sizeof(int));
+  int* have_dir  = (int*) SCR_MALLOC(nall * sizeof(int));
+  scr_distribute_datasets(cindex, nall, all, have_dset, have_dir);
 
   /* TODO: also attempt to recover datasets which we were in the
    * middle of flushing */
   int current_id;
-  int dset_index = 0;
+  int dset_index;
   int output_failed_rebuild = 0;
-  do {
-    /* get the smallest index across all processes (returned in current_id),
-     * this also updates our dset_index value if appropriate */
-    scr_next_dataset(ndsets, dsets, &dset_index, &current_id);
-
-    /* if we found a dataset, try to distribute and rebuild it */
-    if (current_id != -1) {
-      /* remember that we made an attempt to distribute at least one dataset */
-      distribute_attempted = 1;
-      
-      /* log the attempt */
-      if (scr_my_rank_world == 0) {
-        scr_dbg(1, "Attempting to distribute and rebuild dataset %d", current_id);
-        if (scr_log_enable) {
-          scr_log_event("REBUILD_START", NULL, &current_id, NULL, NULL, NULL);
-        }
+  for (dset_index = 0; dset_index < nall; dset_index++) {
+    current_id = all[dset_index];
+
+    /* remember that we made an attempt to distribute at least one dataset */
+    distribute_attempted = 1;
+    
+    /* log the attempt */
+    if (scr_my_rank_world == 0) {
+      scr_dbg(1, "Attempting to distribute and rebuild dataset %d", current_id);
+      if (scr_log_enable) {
+        scr_log_event("REBUILD_START", NULL, &current_id, NULL, NULL, NULL);
       }
+    }
+
+    /* if the previous run saw a failure while it held this dataset,
+     * writes to cache may have been cut short, so check the files
+     * against the redundancy data rather than take them on trust */
+    int marked = 0;
+    scr_cache_index_get_rebuild(cindex, current_id, &marked);
+    marked = ! scr_alltrue(! marked, scr_comm_world);
+    if (marked && scr_my_rank_world == 0) {
+      scr_dbg(1, "Dataset %d was marked for rebuild after a reported failure", current_id);
+    }
 
-      /* assume we'll fail to rebuild */
-      int rebuild_succeeded = 0;
-
-      /* distribute dataset descriptor for this dataset */
-      if (scr_distribute_datasets(cindex, current_id) == SCR_SUCCESS) {
-        /* get dataset for this id */
-        scr_dataset* dataset = scr_dataset_new();
-        scr_cache_index_get_dataset(cindex, current_id, dataset);
-
-        /* get and recreate directory from cindex */
-        char* path;
-        if (scr_distribute_dir(cindex, current_id, &path) == SCR_SUCCESS) {
-          /* rebuild files for this dataset */
-          int tmp_rc = scr_reddesc_recover(cindex, current_id, path);
-          if (tmp_rc == SCR_SUCCESS) {
-            /* rebuild succeeded */
-            rebuild_succeeded = 1;
-
-            /* if we have a checkpoint, update dataset and checkpoint counters,
-             * however skip this if we failed to rebuild an output set, in this
-             * case we'll restart from the checkpoint before the lost output set */
-            int is_ckpt = scr_dataset_is_ckpt(dataset);
-            if (is_ckpt && !output_failed_rebuild) {
-              /* if we rebuild any checkpoint, return success */
-              rc = SCR_SUCCESS;
-
-              /* if id of dataset we just rebuilt is newer,
-               * update scr_dataset_id */
-              if (current_id > scr_dataset_id) {
-                scr_dataset_id = current_id;
-              }
-
-              /* get checkpoint id for dataset */
-              int ckpt_id;
-              scr_dataset_get_ckpt(dataset, &ckpt_id);
-
-              /* if checkpoint id of dataset we just rebuilt is newer,
-               * update scr_checkpoint_id and scr_ckpt_dset_id */
-              if (ckpt_id > scr_checkpoint_id) {
-                /* got a more recent checkpoint, update our checkpoint info */
-                scr_checkpoint_id = ckpt_id;
-                scr_ckpt_dset_id = current_id;
-              }
+    /* assume we'll fail to rebuild */
+    int rebuild_succeeded = 0;
+
+    /* check that we got the dataset descriptor for this dataset */
+    if (have_dset[dset_index]) {
+      /* get dataset for this id */
+      scr_dataset* dataset = scr_dataset_new();
+      scr_cache_index_get_dataset(cindex, current_id, dataset);
+
+      /* recreate directory from cindex */
+      char* path;
+      if (have_dir[dset_index] &&
+          scr_distribute_dir(cindex, current_id, &path) == SCR_SUCCESS)
+      {
+        /* if ranks moved to other nodes, first move their files over
+         * from the caches that hold them, in which case we protect the
+         * files again rather than rebuild them from redundancy data */
+        int moved = 0;
+        int in_place = 0;
+        int tmp_rc;
+        if (scr_distribute_spare) {
+          /* if spare nodes took the place of failed nodes and every other
+           * rank kept its node, leave the surviving caches as they are */
+          int spares;
+          in_place = scr_distribute_in_place(path, &spares);
+          if (in_place && spares > 0 && scr_my_rank_world == 0) {
+            scr_dbg(1, "Rebuilding dataset %d in place on %d spare nodes", current_id, spares);
+          }
+        }
+        if (! in_place && scr_distribute_peer &&
+            scr_distribute_files(cindex, current_id, path, &moved) == SCR_SUCCESS && moved)
+        {
+          if (scr_my_rank_world == 0) {
+            scr_dbg(1, "Moved files of dataset %d between node caches", current_id);
+          }
+          tmp_rc = scr_distribute_reapply(cindex, current_id);
+        } else {
+          /* files kept compressed in cache do not match what the redundancy
+           * scheme encoded, so if every rank has its files there is nothing
+           * to rebuild, and otherwise write them out in full first */
+          int compressed = ! scr_alltrue(! scr_cache_is_compressed(cindex, current_id), scr_comm_world);
+          if (compressed && ! marked &&
+              scr_alltrue(scr_distribute_have_files(cindex, current_id), scr_comm_world))
+          {
+            tmp_rc = SCR_SUCCESS;
+          } else {
+            if (compressed) {
+              scr_cache_compress_restore(cindex, current_id);
             }
 
-            /* update our flush file to indicate this dataset is in cache */
-            scr_flush_file_location_set(current_id, SCR_FLUSH_KEY_LOCATION_CACHE);
+            /* rebuild files for this dataset */
+            scr_trace_begin("recover");
+            double recover_start = MPI_Wtime();
+            tmp_rc = scr_reddesc_recover(cindex, current_id, path);
+            scr_inject_recover_time(MPI_Wtime() - recover_start);
+            scr_trace_end();
+          }
+        }
 
-            /* TODO: if storing flush file in control directory on each node,
-             * if we find any process that has marked the dataset as flushed,
-             * marked it as flushed in every flush file */
+        /* if some redundancy sets could not be rebuilt, only the ranks
+         * that lack their files read them from the prefix directory,
+         * everyone else keeps what is in cache */
+        if (tmp_rc != SCR_SUCCESS && scr_fetch_partial &&
+            scr_dataset_is_ckpt(dataset) && ! scr_global_restart)
+        {
+          int need = ! scr_distribute_have_files(cindex, current_id);
+          if (scr_fetch_ranks(cindex, current_id, need) == SCR_SUCCESS) {
+            tmp_rc = scr_distribute_reapply(cindex, current_id);
+          }
+        }
+        if (tmp_rc == SCR_SUCCESS) {
+          /* rebuild succeeded */
+          rebuild_succeeded = 1;
+          scr_cache_index_set_rebuild(cindex, current_id, 0);
+
+          /* if we have a checkpoint, update dataset and checkpoint counters,
+           * however skip this if we failed to rebuild an output set, in this
+           * case we'll restart from the checkpoint before the lost output set */
+          int is_ckpt = scr_dataset_is_ckpt(dataset);
+          if (is_ckpt && !output_failed_rebuild) {
+            /* if we rebuild any checkpoint, return success */
+            rc = SCR_SUCCESS;
+
+            /* if id of dataset we just rebuilt is newer,
+             * update scr_dataset_id */
+            if (current_id > scr_dataset_id) {
+              scr_dataset_id = current_id;
+            }
 
-            /* TODO: would like to restore flushing status to datasets that
-             * were in the middle of a flush, but we need to better manage
-             * the transfer file to do this, so for now just forget about
-             * flushing this dataset */
-            scr_flush_file_location_unset(current_id, SCR_FLUSH_KEY_LOCATION_FLUSHING);
+            /* get checkpoint id for dataset */
+            int ckpt_id;
+            scr_dataset_get_ckpt(dataset, &ckpt_id);
+
+            /* if checkpoint id of dataset we just rebuilt is newer,
+             * update scr_checkpoint_id and scr_ckpt_dset_id */
+            if (ckpt_id > scr_checkpoint_id) {
+              /* got a more recent checkpoint, update our checkpoint info */
+              scr_checkpoint_id = ckpt_id;
+              scr_ckpt_dset_id = current_id;
+            }
           }
 
-          /* free path */
-          scr_free(&path);
-        }
+          /* update our flush file to indicate this dataset is in cache */
+          scr_flush_file_batch_begin();
+          scr_flush_file_location_set(current_id, SCR_FLUSH_KEY_LOCATION_CACHE);
+
+          /* TODO: if storing flush file in control directory on each node,
+           * if we find any process that has marked the dataset as flushed,
+           * marked it as flushed in every flush file */
 
-        /* remember if we fail to rebuild an output set */
-        int is_output = scr_dataset_is_output(dataset);
-        if (!rebuild_succeeded && is_output) {
-          output_failed_rebuild = 1;
+          /* TODO: would like to restore flushing status to datasets that
+           * were in the middle of a flush, but we need to better manage
+           * the transfer file to do this, so for now just forget about
+           * flushing this dataset */
+          scr_flush_file_location_unset(current_id, SCR_FLUSH_KEY_LOCATION_FLUSHING);
+          scr_flush_file_batch_end();
         }
 
-        /* free dataset */
-        scr_dataset_delete(&dataset);
-      } else {
-        /* if we failed to distribute dataset info, then we can't know
-         * whether this was output or not, so we have to assume it was */
+        /* free path */
+        scr_free(&path);
+      }
+
+      /* remember if we fail to rebuild an output set */
+      int is_output = scr_dataset_is_output(dataset);
+      if (!rebuild_succeeded && is_output) {
         output_failed_rebuild = 1;
       }
 
-      /* if the distribute or rebuild failed, delete the dataset */
-      if (! rebuild_succeeded) {
-        /* log that we failed */
-        if (scr_my_rank_world == 0) {
-          scr_dbg(1, "Failed to rebuild dataset %d", current_id);
-          if (scr_log_enable) {
-            scr_log_event("REBUILD_FAIL", NULL, &current_id, NULL, NULL, NULL);
-          }
+      /* free dataset */
+      scr_dataset_delete(&dataset);
+    } else {
+      /* if we failed to distribute dataset info, then we can't know
+       * whether this was output or not, so we have to assume it was */
+      output_failed_rebuild = 1;
+    }
+
+    /* if the distribute or rebuild failed, delete the dataset */
+    if (! rebuild_succeeded) {
+      /* log that we failed */
+      if (scr_my_rank_world == 0) {
+        scr_dbg(1, "Failed to rebuild dataset %d", current_id);
+        if (scr_log_enable) {
+          scr_log_event("REBUILD_FAIL", NULL, &current_id, NULL, NULL, NULL);
         }
+      }
 
-        /* TODO: there is a bug here, since scr_cache_delete needs to read
-         * the redundancy descriptor from the filemap in order to delete the
-         * cache directory, but we may have failed to distribute the reddescs
-         * above so not every task has one */
+      /* TODO: there is a bug here, since scr_cache_delete needs to read
+       * the redundancy descriptor from the filemap in order to delete the
+       * cache directory, but we may have failed to distribute the reddescs
+       * above so not every task has one */
 
-        /* rebuild failed, delete this dataset from cache */
-        scr_cache_delete(cindex, current_id);
-      } else {
-        /* rebuid worked, log success */
-        if (scr_my_rank_world == 0) {
-          scr_dbg(1, "Rebuilt dataset %d", current_id);
-          if (scr_log_enable) {
-            scr_log_event("REBUILD_SUCCESS", NULL, &current_id, NULL, NULL, NULL);
-          }
+      /* rebuild failed, delete this dataset from cache */
+      scr_cache_delete(cindex, current_id);
+    } else {
+      /* rebuid worked, log success */
+      if (scr_my_rank_world == 0) {
+        scr_dbg(1, "Rebuilt dataset %d", current_id);
+        if (scr_log_enable) {
+          scr_log_event("REBUILD_SUCCESS", NULL, &current_id, NULL, NULL, NULL);
         }
       }
     }
-  } while (current_id != -1);
+  }
 
-  /* free our list of dataset ids */
+  /* free our lists of dataset ids */
+  scr_free(&have_dir);
+  scr_free(&have_dset);
+  scr_free(&all);
   scr_free(&dsets);
 
   /* get an updated list of datasets since we may have rebuilt/deleted some */
   scr_cache_index_list_datasets(cindex, &ndsets, &dsets);
+  scr_cache_list_all_datasets(ndsets, dsets, &nall, &all);
 
   /* delete all datasets following the most recent checkpoint */
-  dset_index = 0;
-  do {
-    /* get the smallest index across all processes (returned in current_id),
-     * this also updates our dset_index value if appropriate */
-    scr_next_dataset(ndsets, dsets, &dset_index, &current_id);
-
-    /* if we found a dataset, try to distribute and rebuild it */
-    if (current_id != -1 && current_id > scr_ckpt_dset_id) {
-      /* rebuild failed, delete this dataset from cache */
+  for (dset_index = 0; dset_index < nall; dset_index++) {
+    current_id = all[dset_index];
+    if (current_id > scr_ckpt_dset_id) {
       scr_cache_delete(cindex, current_id);
     }
-  } while (current_id != -1);
+  }
 
-  /* free our list of dataset ids */
+  /* free our lists of dataset ids */
+  scr_free(&all);
   scr_free(&dsets);
 
   /* stop timer and report performance */
@@ -397,6 +1064,7 @@ int scr_cache_rebuild(scr_cache_index* cindex)
     }
   }
 
+  scr_trace_mark_end("rebuild");
   return rc;
 }
 
@@ -476,5 +1144,9 @@ int scr_flush_file_rebuild(const scr_cache_index* cindex)
     /* delete the hash */
     kvtree_delete(&hash);
   }
+
+  /* refresh the copy of the flush file held by each process */
+  scr_flush_file_load();
+
   return SCR_SUCCESS;
 }
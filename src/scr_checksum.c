@@ -0,0 +1,504 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+/* Implements checksum algorithms to verify file contents.
+ * CRC32C uses hardware instructions when the CPU supports them,
+ * which is selected at runtime, and otherwise falls back to a table. */
+
+#include "scr.h"
+#include "scr_err.h"
+#include "scr_io.h"
+#include "scr_util.h"
+#include "scr_checksum.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+/* compute crc32 */
+#include <zlib.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define SCR_CHECKSUM_HAVE_SSE42
+#endif
+
+#if defined(__aarch64__) && defined(__GNUC__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#include <arm_acle.h>
+#ifdef HWCAP_CRC32
+#define SCR_CHECKSUM_HAVE_ARMV8_CRC
+#endif
+#endif
+
+/*
+=========================================
+CRC32C
+=========================================
+*/
+
+/* reflected Castagnoli polynomial */
+#define SCR_CRC32C_POLY (0x82F63B78)
+
+static uint32_t scr_crc32c_table[256];
+static pthread_once_t scr_crc32c_once = PTHREAD_ONCE_INIT;
+
+/* signature of function that updates a CRC32C value */
+typedef uint32_t (*scr_crc32c_fn)(uint32_t crc, const unsigned char* buf, size_t size);
+static scr_crc32c_fn scr_crc32c_update = NULL;
+
+static uint32_t scr_crc32c_sw(uint32_t crc, const unsigned char* buf, size_t size)
+{
+  while (size > 0) {
+    crc = scr_crc32c_table[(crc ^ *buf) & 0xFF] ^ (crc >> 8);
+    buf++;
+    size--;
+  }
+  return crc;
+}
+
+#ifdef SCR_CHECKSUM_HAVE_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t scr_crc32c_sse42(uint32_t crc, const unsigned char* buf, size_t size)
+{
+  uint64_t c = crc;
+  while (size >= 8) {
+    uint64_t word;
+    memcpy(&word, buf, sizeof(word));
+    c = _mm_crc32_u64(c, word);
+    buf  += 8;
+    size -= 8;
+  }
+  uint32_t c32 = (uint32_t) c;
+  while (size > 0) {
+    c32 = _mm_crc32_u8(c32, *buf);
+    buf++;
+    size--;
+  }
+  return c32;
+}
+#endif
+
+#ifdef SCR_CHECKSUM_HAVE_ARMV8_CRC
+__attribute__((target("+crc")))
+static uint32_t scr_crc32c_armv8(uint32_t crc, const unsigned char* buf, size_t size)
+{
+  while (size >= 8) {
+    uint64_t word;
+    memcpy(&word, buf, sizeof(word));
+    crc = __crc32cd(crc, word);
+    buf  += 8;
+    size -= 8;
+  }
+  while (size > 0) {
+    crc = __crc32cb(crc, *buf);
+    buf++;
+    size--;
+  }
+  return crc;
+}
+#endif
+
+/* build lookup table and pick the fastest implementation this CPU supports */
+static void scr_crc32c_setup(void)
+{
+  uint32_t i;
+  for (i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    int j;
+    for (j = 0; j < 8; j++) {
+      crc = (crc & 1) ? (crc >> 1) ^ SCR_CRC32C_POLY : (crc >> 1);
+    }
+    scr_crc32c_table[i] = crc;
+  }
+
+  scr_crc32c_update = scr_crc32c_sw;
+
+#ifdef SCR_CHECKSUM_HAVE_SSE42
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.2")) {
+    scr_crc32c_update = scr_crc32c_sse42;
+  }
+#endif
+
+#ifdef SCR_CHECKSUM_HAVE_ARMV8_CRC
+  if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+    scr_crc32c_update = scr_crc32c_armv8;
+  }
+#endif
+}
+
+/*
+=========================================
+XXH64
+=========================================
+*/
+
+#define SCR_XXH_PRIME64_1 (0x9E3779B185EBCA87ULL)
+#define SCR_XXH_PRIME64_2 (0xC2B2AE3D27D4EB4FULL)
+#define SCR_XXH_PRIME64_3 (0x165667B19E3779F9ULL)
+#define SCR_XXH_PRIME64_4 (0x85EBCA77C2B2AE63ULL)
+#define SCR_XXH_PRIME64_5 (0x27D4EB2F165667C5ULL)
+
+static uint64_t scr_xxh_rotl(uint64_t x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+/* read little-endian values regardless of host byte order */
+static uint64_t scr_xxh_read64(const unsigned char* p)
+{
+  return ((uint64_t) p[0])       | ((uint64_t) p[1] << 8)  |
+         ((uint64_t) p[2] << 16) | ((uint64_t) p[3] << 24) |
+         ((uint64_t) p[4] << 32) | ((uint64_t) p[5] << 40) |
+         ((uint64_t) p[6] << 48) | ((uint64_t) p[7] << 56);
+}
+
+static uint64_t scr_xxh_read32(const unsigned char* p)
+{
+  return ((uint64_t) p[0])       | ((uint64_t) p[1] << 8) |
+         ((uint64_t) p[2] << 16) | ((uint64_t) p[3] << 24);
+}
+
+static uint64_t scr_xxh_round(uint64_t acc, uint64_t input)
+{
+  acc += input * SCR_XXH_PRIME64_2;
+  acc  = scr_xxh_rotl(acc, 31);
+  acc *= SCR_XXH_PRIME64_1;
+  return acc;
+}
+
+static uint64_t scr_xxh_merge(uint64_t acc, uint64_t val)
+{
+  acc ^= scr_xxh_round(0, val);
+  acc  = acc * SCR_XXH_PRIME64_1 + SCR_XXH_PRIME64_4;
+  return acc;
+}
+
+/* consume one 32-byte stripe */
+static void scr_xxh_stripe(uint64_t* v, const unsigned char* p)
+{
+  v[0] = scr_xxh_round(v[0], scr_xxh_read64(p));
+  v[1] = scr_xxh_round(v[1], scr_xxh_read64(p + 8));
+  v[2] = scr_xxh_round(v[2], scr_xxh_read64(p + 16));
+  v[3] = scr_xxh_round(v[3], scr_xxh_read64(p + 24));
+}
+
+static void scr_xxh64_init(scr_checksum* c)
+{
+  c->v[0] = SCR_XXH_PRIME64_1 + SCR_XXH_PRIME64_2;
+  c->v[1] = SCR_XXH_PRIME64_2;
+  c->v[2] = 0;
+  c->v[3] = 0 - SCR_XXH_PRIME64_1;
+  c->memsize = 0;
+}
+
+static void scr_xxh64_update(scr_checksum* c, const unsigned char* p, size_t size)
+{
+  /* fill up any partial stripe left from last time */
+  if (c->memsize > 0) {
+    size_t fill = 32 - c->memsize;
+    if (size < fill) {
+      memcpy(c->mem + c->memsize, p, size);
+      c->memsize += size;
+      return;
+    }
+    memcpy(c->mem + c->memsize, p, fill);
+    scr_xxh_stripe(c->v, c->mem);
+    p    += fill;
+    size -= fill;
+    c->memsize = 0;
+  }
+
+  /* process full stripes directly from the input */
+  while (size >= 32) {
+    scr_xxh_stripe(c->v, p);
+    p    += 32;
+    size -= 32;
+  }
+
+  /* hold on to the remainder */
+  if (size > 0) {
+    memcpy(c->mem, p, size);
+    c->memsize = size;
+  }
+}
+
+static uint64_t scr_xxh64_final(const scr_checksum* c)
+{
+  uint64_t h;
+  if (c->total >= 32) {
+    h = scr_xxh_rotl(c->v[0], 1)  + scr_xxh_rotl(c->v[1], 7) +
+        scr_xxh_rotl(c->v[2], 12) + scr_xxh_rotl(c->v[3], 18);
+    h = scr_xxh_merge(h, c->v[0]);
+    h = scr_xxh_merge(h, c->v[1]);
+    h = scr_xxh_merge(h, c->v[2]);
+    h = scr_xxh_merge(h, c->v[3]);
+  } else {
+    h = c->v[2] + SCR_XXH_PRIME64_5;
+  }
+  h += c->total;
+
+  const unsigned char* p   = c->mem;
+  const unsigned char* end = c->mem + c->memsize;
+  while (p + 8 <= end) {
+    h ^= scr_xxh_round(0, scr_xxh_read64(p));
+    h  = scr_xxh_rotl(h, 27) * SCR_XXH_PRIME64_1 + SCR_XXH_PRIME64_4;
+    p += 8;
+  }
+  if (p + 4 <= end) {
+    h ^= scr_xxh_read32(p) * SCR_XXH_PRIME64_1;
+    h  = scr_xxh_rotl(h, 23) * SCR_XXH_PRIME64_2 + SCR_XXH_PRIME64_3;
+    p += 4;
+  }
+  while (p < end) {
+    h ^= (*p) * SCR_XXH_PRIME64_5;
+    h  = scr_xxh_rotl(h, 11) * SCR_XXH_PRIME64_1;
+    p++;
+  }
+
+  h ^= h >> 33;
+  h *= SCR_XXH_PRIME64_2;
+  h ^= h >> 29;
+  h *= SCR_XXH_PRIME64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+/*
+=========================================
+Checksum interface
+=========================================
+*/
+
+int scr_checksum_type_from_str(const char* name)
+{
+  if (name == NULL) {
+    return -1;
+  }
+  if (strcasecmp(name, "CRC32") == 0) {
+    return SCR_CHECKSUM_CRC32;
+  }
+  if (strcasecmp(name, "CRC32C") == 0) {
+    return SCR_CHECKSUM_CRC32C;
+  }
+  if (strcasecmp(name, "XXH64") == 0 || strcasecmp(name, "XXHASH") == 0) {
+    return SCR_CHECKSUM_XXH64;
+  }
+  return -1;
+}
+
+const char* scr_checksum_type_to_str(int type)
+{
+  switch (type) {
+  case SCR_CHECKSUM_CRC32:
+    return "CRC32";
+  case SCR_CHECKSUM_CRC32C:
+    return "CRC32C";
+  case SCR_CHECKSUM_XXH64:
+    return "XXH64";
+  }
+  return NULL;
+}
+
+int scr_checksum_init(scr_checksum* c, int type)
+{
+  c->type    = type;
+  c->total   = 0;
+  c->memsize = 0;
+
+  switch (type) {
+  case SCR_CHECKSUM_CRC32:
+    c->value = (uint64_t) crc32(0L, Z_NULL, 0);
+    break;
+  case SCR_CHECKSUM_CRC32C:
+    pthread_once(&scr_crc32c_once, scr_crc32c_setup);
+    c->value = 0xFFFFFFFF;
+    break;
+  case SCR_CHECKSUM_XXH64:
+    scr_xxh64_init(c);
+    break;
+  default:
+    scr_err("Unknown checksum type %d @ %s:%d",
+      type, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  return SCR_SUCCESS;
+}
+
+void scr_checksum_update(scr_checksum* c, const void* buf, size_t size)
+{
+  const unsigned char* p = (const unsigned char*) buf;
+  c->total += size;
+
+  switch (c->type) {
+  case SCR_CHECKSUM_CRC32:
+    /* crc32 takes a uInt length, so process large buffers in pieces */
+    while (size > 0) {
+      uInt count = (size > (1024*1024*1024)) ? (1024*1024*1024) : (uInt) size;
+      c->value = (uint64_t) crc32((uLong) c->value, (const Bytef*) p, count);
+      p    += count;
+      size -= count;
+    }
+    break;
+  case SCR_CHECKSUM_CRC32C:
+    c->value = (uint64_t) scr_crc32c_update((uint32_t) c->value, p, size);
+    break;
+  case SCR_CHECKSUM_XXH64:
+    scr_xxh64_update(c, p, size);
+    break;
+  }
+}
+
+uint64_t scr_checksum_final(const scr_checksum* c)
+{
+  switch (c->type) {
+  case SCR_CHECKSUM_CRC32:
+    return c->value;
+  case SCR_CHECKSUM_CRC32C:
+    return (uint64_t) ((uint32_t) c->value ^ 0xFFFFFFFF);
+  case SCR_CHECKSUM_XXH64:
+    return scr_xxh64_final(c);
+  }
+  return 0;
+}
+
+/* opens, reads, and computes the checksum of given type for the given filename */
+int scr_checksum_file(const char* filename, int type, uint64_t* value)
+{
+  /* check that we got a variable to write our answer to */
+  if (value == NULL) {
+    return SCR_FAILURE;
+  }
+
+  scr_checksum c;
+  if (scr_checksum_init(&c, type) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+
+  /* open the file for reading */
+  int fd = scr_open(filename, O_RDONLY);
+  if (fd < 0) {
+    scr_dbg(1, "Failed to open file to compute checksum: %s errno=%d @ %s:%d",
+      filename, errno, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* allocate buffer to read file */
+  size_t buffer_size = 1024*1024;
+  char* buf = (char*) malloc(buffer_size);
+  if (buf == NULL) {
+    scr_err("Allocating memory: malloc(%lu) errno=%d %s @ %s:%d",
+      (unsigned long) buffer_size, errno, strerror(errno), __FILE__, __LINE__
+    );
+    close(fd);
+    return SCR_FAILURE;
+  }
+
+  /* read the file data in and compute its checksum */
+  ssize_t nread = 0;
+  do {
+    nread = scr_read_attempt(filename, fd, buf, buffer_size);
+    if (nread > 0) {
+      scr_checksum_update(&c, buf, (size_t) nread);
+    }
+  } while (nread == buffer_size);
+
+  scr_free(&buf);
+
+  /* if we got an error, don't print anything and bailout */
+  if (nread < 0) {
+    scr_dbg(1, "Error while reading file to compute checksum: %s @ %s:%d",
+      filename, __FILE__, __LINE__
+    );
+    close(fd);
+    return SCR_FAILURE;
+  }
+
+  /* close the file */
+  scr_close(filename, fd);
+
+  *value = scr_checksum_final(&c);
+
+  return SCR_SUCCESS;
+}
+
+int scr_checksum_file_mmap(const char* filename, int type, uint64_t* value)
+{
+  /* check that we got a variable to write our answer to */
+  if (value == NULL) {
+    return SCR_FAILURE;
+  }
+
+  scr_checksum c;
+  if (scr_checksum_init(&c, type) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+
+  /* open the file for reading */
+  int fd = scr_open(filename, O_RDONLY);
+  if (fd < 0) {
+    scr_dbg(1, "Failed to open file to compute checksum: %s errno=%d @ %s:%d",
+      filename, errno, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* get the size of the file to map */
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) != 0) {
+    scr_dbg(1, "Failed to stat file to compute checksum: %s errno=%d @ %s:%d",
+      filename, errno, __FILE__, __LINE__
+    );
+    scr_close(filename, fd);
+    return SCR_FAILURE;
+  }
+  size_t size = (size_t) stat_buf.st_size;
+
+  /* checksum straight from the mapping, pages of a file in memory
+   * are mapped without copying them through a buffer */
+  if (size > 0) {
+    void* addr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+      scr_dbg(1, "Failed to mmap file to compute checksum: %s errno=%d @ %s:%d",
+        filename, errno, __FILE__, __LINE__
+      );
+      scr_close(filename, fd);
+      return SCR_FAILURE;
+    }
+
+#if !defined(__APPLE__)
+    madvise(addr, size, MADV_SEQUENTIAL);
+#endif
+
+    scr_checksum_update(&c, addr, size);
+
+    munmap(addr, size);
+  }
+
+  /* close the file */
+  scr_close(filename, fd);
+
+  *value = scr_checksum_final(&c);
+
+  return SCR_SUCCESS;
+}
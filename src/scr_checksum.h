@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_CHECKSUM_H
+#define SCR_CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+=========================================
+This file defines a set of checksum algorithms that can be used to
+verify file contents.  SCR_CHECKSUM_CRC32 is the zlib crc32 that has
+always been recorded in meta data under the CRC key.
+=========================================
+*/
+
+#define SCR_CHECKSUM_CRC32  (0) /* zlib crc32 */
+#define SCR_CHECKSUM_CRC32C (1) /* Castagnoli crc32, uses SSE4.2 / ARMv8 CRC instructions if available */
+#define SCR_CHECKSUM_XXH64  (2) /* 64-bit xxHash */
+
+/* state of a running checksum computation */
+typedef struct {
+  int type;          /* one of SCR_CHECKSUM_* values */
+  uint64_t value;    /* running value for crc algorithms */
+  uint64_t total;    /* number of bytes processed so far */
+  uint64_t v[4];     /* xxhash accumulators */
+  unsigned char mem[32]; /* xxhash bytes waiting for a full stripe */
+  size_t memsize;    /* number of bytes in mem */
+} scr_checksum;
+
+/* given a checksum name like "CRC32C", return its SCR_CHECKSUM_* value,
+ * returns -1 if name is not recognized */
+int scr_checksum_type_from_str(const char* name);
+
+/* return name string for given SCR_CHECKSUM_* type, or NULL if not valid */
+const char* scr_checksum_type_to_str(int type);
+
+/* initialize checksum state for given type, returns SCR_SUCCESS if type is valid */
+int scr_checksum_init(scr_checksum* c, int type);
+
+/* add size bytes from buf to the checksum */
+void scr_checksum_update(scr_checksum* c, const void* buf, size_t size);
+
+/* return the checksum value of all bytes added so far */
+uint64_t scr_checksum_final(const scr_checksum* c);
+
+/* opens, reads, and computes the checksum of given type for the given filename */
+int scr_checksum_file(const char* filename, int type, uint64_t* value);
+
+/* computes the checksum of given type for the given filename by mapping
+ * the file into memory rather than reading it, intended for files on
+ * memory-backed storage like tmpfs */
+int scr_checksum_file_mmap(const char* filename, int type, uint64_t* value);
+
+#endif
@@ -0,0 +1,497 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+/* Implements block compression of files for flush and fetch.
+ * Each block is compressed independently so that memory use is
+ * bounded by the buffer size and a damaged block is detected
+ * when it is read back. */
+
+#include "scr_conf.h"
+#include "scr.h"
+#include "scr_err.h"
+#include "scr_io.h"
+#include "scr_util.h"
+#include "scr_compress.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+
+/* compute crc32 */
+#include <zlib.h>
+
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+/* magic string at the start of each compressed file */
+#define SCR_COMPRESS_MAGIC   ("SCRZ")
+#define SCR_COMPRESS_VERSION (1)
+
+/* limit block size so lengths fit in 32 bits and below the LZ4 maximum */
+#define SCR_COMPRESS_MAX_BLOCK (1024*1024*1024)
+
+/* file header, all integers are stored in network byte order */
+typedef struct {
+  char     magic[4];   /* SCR_COMPRESS_MAGIC */
+  uint8_t  version;    /* SCR_COMPRESS_VERSION */
+  uint8_t  type;       /* SCR_COMPRESS_* codec used for blocks */
+  uint16_t reserved;
+  uint32_t block_size; /* maximum number of original bytes in a block */
+} scr_compress_header;
+
+/* each block starts with its original length and its stored length,
+ * a block is stored uncompressed if the two are equal */
+typedef struct {
+  uint32_t size;
+  uint32_t compsize;
+} scr_compress_block;
+
+int scr_compress_type_from_str(const char* name)
+{
+  if (name == NULL) {
+    return -1;
+  }
+  if (strcasecmp(name, "NONE") == 0) {
+    return SCR_COMPRESS_NONE;
+  }
+  if (strcasecmp(name, "LZ4") == 0) {
+    return SCR_COMPRESS_LZ4;
+  }
+  if (strcasecmp(name, "ZSTD") == 0) {
+    return SCR_COMPRESS_ZSTD;
+  }
+  return -1;
+}
+
+const char* scr_compress_type_to_str(int type)
+{
+  switch (type) {
+  case SCR_COMPRESS_NONE:
+    return "NONE";
+  case SCR_COMPRESS_LZ4:
+    return "LZ4";
+  case SCR_COMPRESS_ZSTD:
+    return "ZSTD";
+  }
+  return NULL;
+}
+
+int scr_compress_available(int type)
+{
+  switch (type) {
+  case SCR_COMPRESS_NONE:
+    return 1;
+#ifdef HAVE_LZ4
+  case SCR_COMPRESS_LZ4:
+    return 1;
+#endif
+#ifdef HAVE_ZSTD
+  case SCR_COMPRESS_ZSTD:
+    return 1;
+#endif
+  }
+  return 0;
+}
+
+/* return the max number of bytes needed to compress size bytes */
+static size_t scr_compress_bound(int type, size_t size)
+{
+  switch (type) {
+#ifdef HAVE_LZ4
+  case SCR_COMPRESS_LZ4:
+    return (size_t) LZ4_compressBound((int) size);
+#endif
+#ifdef HAVE_ZSTD
+  case SCR_COMPRESS_ZSTD:
+    return ZSTD_compressBound(size);
+#endif
+  }
+  return size;
+}
+
+/* compress size bytes from src into dst, returns number of bytes
+ * written to dst or 0 if the block could not be compressed */
+static size_t scr_compress_block_data(
+  int type, const char* src, size_t size, char* dst, size_t dst_size)
+{
+  switch (type) {
+#ifdef HAVE_LZ4
+  case SCR_COMPRESS_LZ4:
+  {
+    int n = LZ4_compress_default(src, dst, (int) size, (int) dst_size);
+    return (n > 0) ? (size_t) n : 0;
+  }
+#endif
+#ifdef HAVE_ZSTD
+  case SCR_COMPRESS_ZSTD:
+  {
+    size_t n = ZSTD_compress(dst, dst_size, src, size, SCR_COMPRESS_ZSTD_LEVEL);
+    return ZSTD_isError(n) ? 0 : n;
+  }
+#endif
+  }
+  return 0;
+}
+
+/* decompress compsize bytes from src into dst, which must decompress
+ * to exactly size bytes, returns SCR_SUCCESS if successful */
+static int scr_decompress_block_data(
+  int type, const char* src, size_t compsize, char* dst, size_t size)
+{
+  switch (type) {
+#ifdef HAVE_LZ4
+  case SCR_COMPRESS_LZ4:
+  {
+    int n = LZ4_decompress_safe(src, dst, (int) compsize, (int) size);
+    return (n >= 0 && (size_t) n == size) ? SCR_SUCCESS : SCR_FAILURE;
+  }
+#endif
+#ifdef HAVE_ZSTD
+  case SCR_COMPRESS_ZSTD:
+  {
+    size_t n = ZSTD_decompress(dst, size, src, compsize);
+    return (! ZSTD_isError(n) && n == size) ? SCR_SUCCESS : SCR_FAILURE;
+  }
+#endif
+  }
+  return SCR_FAILURE;
+}
+
+int scr_compress_file(
+  const char* src_file,
+  const char* dst_file,
+  int type,
+  unsigned long buf_size,
+  unsigned long* size,
+  unsigned long* compsize,
+  uLong* crc)
+{
+  /* check that we support this codec */
+  if (type == SCR_COMPRESS_NONE || ! scr_compress_available(type)) {
+    scr_err("Compression type %d not supported @ %s:%d",
+      type, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* limit the block size, which also bounds memory usage */
+  size_t block_size = (size_t) buf_size;
+  if (block_size == 0 || block_size > SCR_COMPRESS_MAX_BLOCK) {
+    block_size = SCR_COMPRESS_MAX_BLOCK;
+  }
+
+  /* open src_file for reading */
+  int src_fd = scr_open(src_file, O_RDONLY);
+  if (src_fd < 0) {
+    scr_err("Opening file to compress: scr_open(%s) errno=%d %s @ %s:%d",
+      src_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* open dst_file for writing */
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int dst_fd = scr_open(dst_file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (dst_fd < 0) {
+    scr_err("Opening file for writing: scr_open(%s) errno=%d %s @ %s:%d",
+      dst_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_close(src_file, src_fd);
+    return SCR_FAILURE;
+  }
+
+#if !defined(__APPLE__)
+  posix_fadvise(src_fd, 0, 0, POSIX_FADV_DONTNEED | POSIX_FADV_SEQUENTIAL);
+  posix_fadvise(dst_fd, 0, 0, POSIX_FADV_DONTNEED | POSIX_FADV_SEQUENTIAL);
+#endif
+
+  /* allocate buffers for original and compressed data */
+  size_t comp_buf_size = scr_compress_bound(type, block_size);
+  char* buf      = (char*) malloc(block_size);
+  char* comp_buf = (char*) malloc(comp_buf_size);
+  if (buf == NULL || comp_buf == NULL) {
+    scr_err("Allocating memory: malloc(%lu) errno=%d %s @ %s:%d",
+      (unsigned long) (block_size + comp_buf_size), errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_free(&comp_buf);
+    scr_free(&buf);
+    scr_close(dst_file, dst_fd);
+    scr_close(src_file, src_fd);
+    unlink(dst_file);
+    return SCR_FAILURE;
+  }
+
+  /* initialize crc value */
+  if (crc != NULL) {
+    *crc = crc32(0L, Z_NULL, 0);
+  }
+
+  int rc = SCR_SUCCESS;
+
+  /* write the file header */
+  scr_compress_header header;
+  memcpy(header.magic, SCR_COMPRESS_MAGIC, sizeof(header.magic));
+  header.version    = (uint8_t) SCR_COMPRESS_VERSION;
+  header.type       = (uint8_t) type;
+  header.reserved   = 0;
+  header.block_size = htonl((uint32_t) block_size);
+  if (scr_write_attempt(dst_file, dst_fd, &header, sizeof(header)) != sizeof(header)) {
+    rc = SCR_FAILURE;
+  }
+  unsigned long total     = 0;
+  unsigned long comptotal = sizeof(header);
+
+  /* compress the file one block at a time */
+  int copying = (rc == SCR_SUCCESS);
+  while (copying) {
+    ssize_t nread = scr_read_attempt(src_file, src_fd, buf, block_size);
+    if (nread < 0) {
+      rc = SCR_FAILURE;
+      break;
+    }
+
+    if (nread > 0) {
+      /* optionally compute crc value as we go */
+      if (crc != NULL) {
+        *crc = crc32(*crc, (const Bytef*) buf, (uInt) nread);
+      }
+
+      /* store the block uncompressed if it would not get smaller */
+      size_t n = scr_compress_block_data(type, buf, (size_t) nread, comp_buf, comp_buf_size);
+      const char* data = comp_buf;
+      if (n == 0 || n >= (size_t) nread) {
+        n    = (size_t) nread;
+        data = buf;
+      }
+
+      /* write the block header followed by its data */
+      scr_compress_block block;
+      block.size     = htonl((uint32_t) nread);
+      block.compsize = htonl((uint32_t) n);
+      if (scr_write_attempt(dst_file, dst_fd, &block, sizeof(block)) != sizeof(block) ||
+          scr_write_attempt(dst_file, dst_fd, data, n) != (ssize_t) n)
+      {
+        rc = SCR_FAILURE;
+        break;
+      }
+
+      total     += (unsigned long) nread;
+      comptotal += (unsigned long) (sizeof(block) + n);
+    }
+
+    /* assume a short read means we hit the end of the file */
+    if ((size_t) nread < block_size) {
+      copying = 0;
+    }
+  }
+
+  /* free buffers */
+  scr_free(&comp_buf);
+  scr_free(&buf);
+
+  /* close source and destination files */
+  if (scr_close(dst_file, dst_fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  if (scr_close(src_file, src_fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+
+  /* delete the destination if anything went wrong */
+  if (rc != SCR_SUCCESS) {
+    scr_err("Failed to compress %s to %s @ %s:%d",
+      src_file, dst_file, __FILE__, __LINE__
+    );
+    unlink(dst_file);
+    return rc;
+  }
+
+  if (size != NULL) {
+    *size = total;
+  }
+  if (compsize != NULL) {
+    *compsize = comptotal;
+  }
+
+  return rc;
+}
+
+int scr_decompress_file(
+  const char* src_file,
+  const char* dst_file,
+  int type,
+  unsigned long* size,
+  uLong* crc)
+{
+  /* check that we support this codec */
+  if (type == SCR_COMPRESS_NONE || ! scr_compress_available(type)) {
+    scr_err("Compression type %d not supported @ %s:%d",
+      type, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* open src_file for reading */
+  int src_fd = scr_open(src_file, O_RDONLY);
+  if (src_fd < 0) {
+    scr_err("Opening file to decompress: scr_open(%s) errno=%d %s @ %s:%d",
+      src_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* read and check the file header */
+  scr_compress_header header;
+  if (scr_read_attempt(src_file, src_fd, &header, sizeof(header)) != sizeof(header) ||
+      memcmp(header.magic, SCR_COMPRESS_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != SCR_COMPRESS_VERSION ||
+      header.type != (uint8_t) type)
+  {
+    scr_err("Invalid header in compressed file %s @ %s:%d",
+      src_file, __FILE__, __LINE__
+    );
+    scr_close(src_file, src_fd);
+    return SCR_FAILURE;
+  }
+  size_t block_size = (size_t) ntohl(header.block_size);
+  if (block_size == 0 || block_size > SCR_COMPRESS_MAX_BLOCK) {
+    scr_err("Invalid block size %lu in compressed file %s @ %s:%d",
+      (unsigned long) block_size, src_file, __FILE__, __LINE__
+    );
+    scr_close(src_file, src_fd);
+    return SCR_FAILURE;
+  }
+
+  /* open dst_file for writing */
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int dst_fd = scr_open(dst_file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (dst_fd < 0) {
+    scr_err("Opening file for writing: scr_open(%s) errno=%d %s @ %s:%d",
+      dst_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_close(src_file, src_fd);
+    return SCR_FAILURE;
+  }
+
+#if !defined(__APPLE__)
+  posix_fadvise(src_fd, 0, 0, POSIX_FADV_DONTNEED | POSIX_FADV_SEQUENTIAL);
+#endif
+
+  /* allocate buffers for original and compressed data */
+  size_t comp_buf_size = scr_compress_bound(type, block_size);
+  char* buf      = (char*) malloc(block_size);
+  char* comp_buf = (char*) malloc(comp_buf_size);
+  if (buf == NULL || comp_buf == NULL) {
+    scr_err("Allocating memory: malloc(%lu) errno=%d %s @ %s:%d",
+      (unsigned long) (block_size + comp_buf_size), errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_free(&comp_buf);
+    scr_free(&buf);
+    scr_close(dst_file, dst_fd);
+    scr_close(src_file, src_fd);
+    unlink(dst_file);
+    return SCR_FAILURE;
+  }
+
+  /* initialize crc value */
+  if (crc != NULL) {
+    *crc = crc32(0L, Z_NULL, 0);
+  }
+
+  /* decompress the file one block at a time */
+  int rc = SCR_SUCCESS;
+  unsigned long total = 0;
+  while (1) {
+    /* read the block header, stop cleanly at the end of the file */
+    scr_compress_block block;
+    ssize_t nread = scr_read_attempt(src_file, src_fd, &block, sizeof(block));
+    if (nread == 0) {
+      break;
+    }
+    if (nread != sizeof(block)) {
+      rc = SCR_FAILURE;
+      break;
+    }
+
+    /* check that the block lengths are sane */
+    size_t n        = (size_t) ntohl(block.size);
+    size_t compsize = (size_t) ntohl(block.compsize);
+    if (n == 0 || n > block_size || compsize > comp_buf_size || compsize > n) {
+      rc = SCR_FAILURE;
+      break;
+    }
+
+    /* read the block data */
+    char* data = (compsize == n) ? buf : comp_buf;
+    if (scr_read_attempt(src_file, src_fd, data, compsize) != (ssize_t) compsize) {
+      rc = SCR_FAILURE;
+      break;
+    }
+
+    /* blocks that did not compress are stored as is */
+    if (compsize != n) {
+      if (scr_decompress_block_data(type, comp_buf, compsize, buf, n) != SCR_SUCCESS) {
+        rc = SCR_FAILURE;
+        break;
+      }
+    }
+
+    /* optionally compute crc value as we go */
+    if (crc != NULL) {
+      *crc = crc32(*crc, (const Bytef*) buf, (uInt) n);
+    }
+
+    /* write out the original data */
+    if (scr_write_attempt(dst_file, dst_fd, buf, n) != (ssize_t) n) {
+      rc = SCR_FAILURE;
+      break;
+    }
+    total += (unsigned long) n;
+  }
+
+  /* free buffers */
+  scr_free(&comp_buf);
+  scr_free(&buf);
+
+  /* close source and destination files */
+  if (scr_close(dst_file, dst_fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  if (scr_close(src_file, src_fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+
+  /* delete the destination if anything went wrong */
+  if (rc != SCR_SUCCESS) {
+    scr_err("Failed to decompress %s to %s @ %s:%d",
+      src_file, dst_file, __FILE__, __LINE__
+    );
+    unlink(dst_file);
+    return rc;
+  }
+
+  if (size != NULL) {
+    *size = total;
+  }
+
+  return rc;
+}
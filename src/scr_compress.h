@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_COMPRESS_H
+#define SCR_COMPRESS_H
+
+/* needed for uLong type */
+#include "zlib.h"
+
+/*
+=========================================
+This file defines codecs used to compress files as they are flushed
+to the prefix directory.  A compressed file is a short header followed
+by a sequence of blocks, each block records its original and compressed
+lengths so the file can be decompressed one block at a time.
+=========================================
+*/
+
+#define SCR_COMPRESS_NONE (0) /* file is stored as is */
+#define SCR_COMPRESS_LZ4  (1) /* LZ4 block compression, requires liblz4 */
+#define SCR_COMPRESS_ZSTD (2) /* Zstandard compression, requires libzstd */
+
+/* given a codec name like "LZ4", return its SCR_COMPRESS_* value,
+ * returns -1 if name is not recognized */
+int scr_compress_type_from_str(const char* name);
+
+/* return name string for given SCR_COMPRESS_* type, or NULL if not valid */
+const char* scr_compress_type_to_str(int type);
+
+/* returns 1 if this build of SCR supports the given codec, 0 otherwise */
+int scr_compress_available(int type);
+
+/* compress src_file into dst_file using given codec, reading buf_size bytes
+ * at a time, returns original and compressed file sizes, and optionally
+ * computes the crc32 of the original data */
+int scr_compress_file(
+  const char* src_file,
+  const char* dst_file,
+  int type,
+  unsigned long buf_size,
+  unsigned long* size,
+  unsigned long* compsize,
+  uLong* crc
+);
+
+/* decompress src_file written by scr_compress_file with given codec into
+ * dst_file, returns the size of the decompressed file, and optionally
+ * computes its crc32 */
+int scr_decompress_file(
+  const char* src_file,
+  const char* dst_file,
+  int type,
+  unsigned long* size,
+  uLong* crc
+);
+
+#endif
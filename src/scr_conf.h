@@ -31,6 +31,7 @@
 
 #define SCR_GROUP_NODE  "NODE"
 #define SCR_GROUP_WORLD "WORLD"
+#define SCR_GROUP_SWITCH "SWITCH"
 
 /* whether SCR is enabled by default */
 #ifndef SCR_ENABLE
@@ -42,6 +43,43 @@
 #define SCR_DEBUG (0)
 #endif
 
+/* whether to log and record the time of each phase of init and finalize */
+#ifndef SCR_TRACE
+#define SCR_TRACE (0)
+#endif
+
+/* whether to write a timeline of library phases on all ranks at finalize */
+#ifndef SCR_TRACE_TIMELINE
+#define SCR_TRACE_TIMELINE (0)
+#endif
+
+/* whether to keep per-rank histograms of file operation latency
+ * and report the slowest ranks at finalize */
+#ifndef SCR_IOHIST
+#define SCR_IOHIST (0)
+#endif
+
+/* number of slowest ranks to list for each kind of file operation */
+#ifndef SCR_IOHIST_TOP
+#define SCR_IOHIST_TOP (8)
+#endif
+
+/* number of outputs between latency reports, 0 to report only at finalize */
+#ifndef SCR_IOHIST_INTERVAL
+#define SCR_IOHIST_INTERVAL (0)
+#endif
+
+/* kind of failure to inject into cache before the rebuild in SCR_Init,
+ * see scr_inject.h */
+#ifndef SCR_INJECT
+#define SCR_INJECT (0)
+#endif
+
+/* comma-separated list of ranks to inject failures into */
+#ifndef SCR_INJECT_RANKS
+#define SCR_INJECT_RANKS ("0")
+#endif
+
 /* whether to enable logging in SCR */
 #ifndef SCR_LOG_ENABLE
 #define SCR_LOG_ENABLE (0)
@@ -52,6 +90,11 @@
 #define SCR_LOG_TXT_ENABLE (1)
 #endif
 
+/* whether to also log SCR events as newline-delimited JSON records */
+#ifndef SCR_LOG_JSON_ENABLE
+#define SCR_LOG_JSON_ENABLE (0)
+#endif
+
 /* whether to enable syslog logging in SCR */
 #ifndef SCR_LOG_SYSLOG_ENABLE
 #define SCR_LOG_SYSLOG_ENABLE (1)
@@ -72,6 +115,17 @@
 #define SCR_LOG_SYSLOG_LEVEL LOG_INFO
 #endif
 
+/* whether to write log records from a background thread */
+#ifndef SCR_LOG_ASYNC
+#define SCR_LOG_ASYNC (1)
+#endif
+
+/* number of log records to queue for the background thread
+ * before dropping new records */
+#ifndef SCR_LOG_QUEUE_SIZE
+#define SCR_LOG_QUEUE_SIZE (1024)
+#endif
+
 /* default number of halt seconds to apply to a job */
 #ifndef SCR_HALT_SECONDS
 #define SCR_HALT_SECONDS (0)
@@ -82,6 +136,25 @@
 #define SCR_HALT_EXIT (0)
 #endif
 
+/* most seconds to wait for an async flush that has not moved any
+ * bytes yet before deciding whether to let it finish on exit */
+#ifndef SCR_HALT_ETA_WAIT
+#define SCR_HALT_ETA_WAIT (5)
+#endif
+
+/* whether rank 0 decides SCR_Need_checkpoint and SCR_Should_exit one
+ * call ahead of time and broadcasts the result with MPI_Ibcast */
+#ifndef SCR_DECIDE_ASYNC
+#define SCR_DECIDE_ASYNC (0)
+#endif
+
+/* whether to subscribe to PMIx process and node failure events,
+ * only has an effect when built with PMIx, off by default since the
+ * handler starts scr_copy from the PMIx progress thread */
+#ifndef SCR_PMIX_EVENTS
+#define SCR_PMIX_EVENTS (0)
+#endif
+
 /* =========================================================================
  * Default config file location, control directory, and cache and checkpoint configuration.
  * ========================================================================= */
@@ -112,6 +185,37 @@
 #define SCR_CACHE_SIZE (1)
 #endif
 
+/* number of changes to append to the cache index journal before
+ * the index is rewritten in full, 0 to rewrite the index on every change */
+#ifndef SCR_CACHE_INDEX_JOURNAL
+#define SCR_CACHE_INDEX_JOURNAL (64)
+#endif
+
+/* default max number of bytes of datasets to keep in each cache device, 0 for no limit */
+#ifndef SCR_CACHE_BYTES
+#define SCR_CACHE_BYTES (0)
+#endif
+
+/* default number of bytes to reserve on each cache device during SCR_Init, 0 for none */
+#ifndef SCR_CACHE_ARENA
+#define SCR_CACHE_ARENA (0)
+#endif
+
+/* whether to evict datasets until the next output fits in the free space of cache */
+#ifndef SCR_CACHE_FIT
+#define SCR_CACHE_FIT (0)
+#endif
+
+/* bytes each process expects to write to cache per output, 0 to use the previous output */
+#ifndef SCR_CACHE_EXPECT_BYTES
+#define SCR_CACHE_EXPECT_BYTES (0)
+#endif
+
+/* order to evict datasets from cache: OLDEST, FLUSHED, or LARGEST */
+#ifndef SCR_CACHE_EVICT
+#define SCR_CACHE_EVICT ("OLDEST")
+#endif
+
 /* default redundancy scheme */
 #ifndef SCR_COPY_TYPE
 #define SCR_COPY_TYPE (SCR_COPY_XOR)
@@ -122,6 +226,18 @@
 #define SCR_GROUP (SCR_GROUP_NODE)
 #endif
 
+/* name of group each redundancy set should stay within,
+ * e.g., SCR_GROUP_SWITCH, NULL lets sets span all procs */
+#ifndef SCR_SET_GROUP
+#define SCR_SET_GROUP (NULL)
+#endif
+
+/* file listing the switch of each node as "hostname switch" lines,
+ * NULL to take the switch from the resource manager */
+#ifndef SCR_TOPOLOGY_FILE
+#define SCR_TOPOLOGY_FILE (NULL)
+#endif
+
 /* default failure group set size */
 #ifndef SCR_SET_SIZE
 #define SCR_SET_SIZE (8)
@@ -147,11 +263,51 @@
 #define SCR_MPI_BUF_SIZE (128*1024)  /* very strange that this lower number beats the upper one, but whatever ... */
 #endif
 
+/* whether to measure buffer sizes for each store the first time it is used */
+#ifndef SCR_BUF_TUNE
+#define SCR_BUF_TUNE (0)
+#endif
+
+/* bytes each buffer size is measured with when tuning a store */
+#ifndef SCR_BUF_TUNE_BYTES
+#define SCR_BUF_TUNE_BYTES (16*1024*1024)
+#endif
+
 /* buffer size to use for file I/O operations */
 #ifndef SCR_FILE_BUF_SIZE
 #define SCR_FILE_BUF_SIZE (1024*1024)
 #endif
 
+/* bytes per pinned host buffer used to stage GPU device buffers
+ * to and from files when GPUDirect Storage can not be used */
+#ifndef SCR_DEVICE_STAGE_SIZE
+#define SCR_DEVICE_STAGE_SIZE (16*1024*1024)
+#endif
+
+/* whether to use O_DIRECT for file I/O on a store unless
+ * the store descriptor specifies otherwise */
+#ifndef SCR_STORE_DIRECT
+#define SCR_STORE_DIRECT (0)
+#endif
+
+/* number of reads and writes to keep in flight with io_uring
+ * when copying files, 0 uses POSIX I/O */
+#ifndef SCR_IO_URING_DEPTH
+#define SCR_IO_URING_DEPTH (0)
+#endif
+
+/* number of file I/O buffers to overlap read, crc, and write during
+ * a file copy, values less than 2 copy with a single buffer */
+#ifndef SCR_COPY_PIPELINE_DEPTH
+#define SCR_COPY_PIPELINE_DEPTH (0)
+#endif
+
+/* number of threads scr_copy uses to copy files on each node during
+ * a scavenge */
+#ifndef SCR_COPY_THREADS
+#define SCR_COPY_THREADS (4)
+#endif
+
 /* whether file metadata should also be copied */
 #ifndef SCR_COPY_METADATA
 #define SCR_COPY_METADATA (1)
@@ -172,6 +328,16 @@
 #define SCR_DISTRIBUTE (1)
 #endif
 
+/* whether to move cached files between nodes when ranks run on different nodes after restart */
+#ifndef SCR_DISTRIBUTE_PEER
+#define SCR_DISTRIBUTE_PEER (1)
+#endif
+
+/* whether to rebuild only the files of replacement nodes when every other rank kept its node */
+#ifndef SCR_DISTRIBUTE_SPARE
+#define SCR_DISTRIBUTE_SPARE (1)
+#endif
+
 /* whether fetch operations should be enabled by default */
 #ifndef SCR_FETCH
 #define SCR_FETCH (1)
@@ -187,6 +353,47 @@
 #define SCR_FETCH_TYPE ("SYNC")
 #endif
 
+/* whether to fetch each file of a checkpoint when the application
+ * first routes it during restart rather than all files up front */
+#ifndef SCR_FETCH_LAZY
+#define SCR_FETCH_LAZY (0)
+#endif
+
+/* whether each file routed for a checkpoint starts as a copy of the
+ * same file in the previous checkpoint */
+#ifndef SCR_ROUTE_CLONE
+#define SCR_ROUTE_CLONE (0)
+#endif
+
+/* whether only ranks in redundancy sets that could not be rebuilt
+ * fetch their files when a checkpoint in cache cannot be rebuilt */
+#ifndef SCR_FETCH_PARTIAL
+#define SCR_FETCH_PARTIAL (1)
+#endif
+
+/* whether to check the next older checkpoint in the background
+ * while fetching, so a failed fetch can skip a bad fallback */
+#ifndef SCR_FETCH_PREFETCH
+#define SCR_FETCH_PREFETCH (0)
+#endif
+
+/* number of the most recent checkpoints whose summary and rank2file
+ * files are checked up front on different ranks before fetching */
+#ifndef SCR_FETCH_SCREEN
+#define SCR_FETCH_SCREEN (0)
+#endif
+
+/* whether to print a summary of time and bytes spent in SCR at finalize */
+#ifndef SCR_REPORT
+#define SCR_REPORT (0)
+#endif
+
+/* whether to reduce flags and counters across the job within each node
+ * first and then across one process per node */
+#ifndef SCR_COLL_HIER
+#define SCR_COLL_HIER (0)
+#endif
+
 /* whether to use implied bypass on fetch to read files from file system rather than actually copy to cache */
 #ifndef SCR_FETCH_BYPASS
 #define SCR_FETCH_BYPASS (0)
@@ -202,11 +409,106 @@
 #define SCR_FLUSH_WIDTH (SCR_FETCH_WIDTH)
 #endif
 
+/* max number of redundancy sets scr_index rebuilds at the same time */
+#ifndef SCR_REBUILD_JOBS
+#define SCR_REBUILD_JOBS (8)
+#endif
+
+/* max number of threads scr_index uses to read filemaps of a dataset */
+#ifndef SCR_SCAN_THREADS
+#define SCR_SCAN_THREADS (8)
+#endif
+
+/* max number of threads scr_inspect_cache uses to read filemaps on a node */
+#ifndef SCR_INSPECT_THREADS
+#define SCR_INSPECT_THREADS (8)
+#endif
+
+/* whether to adapt the flush and fetch widths to observed bandwidth */
+#ifndef SCR_FLOW_ADAPT
+#define SCR_FLOW_ADAPT (1)
+#endif
+
 /* AXL type to use when flushing datasets */
 #ifndef SCR_FLUSH_TYPE
 #define SCR_FLUSH_TYPE ("SYNC")
 #endif
 
+/* codec to keep files compressed with in cache, NONE, LZ4, or ZSTD */
+#ifndef SCR_CACHE_COMPRESS
+#define SCR_CACHE_COMPRESS ("NONE")
+#endif
+
+/* codec to compress files with when flushing datasets, NONE, LZ4, or ZSTD */
+#ifndef SCR_FLUSH_COMPRESS
+#define SCR_FLUSH_COMPRESS ("NONE")
+#endif
+
+/* whether to keep identical blocks of datasets in cache only once */
+#ifndef SCR_CACHE_DEDUP
+#define SCR_CACHE_DEDUP (0)
+#endif
+
+/* size of blocks compared when deduplicating datasets in cache */
+#ifndef SCR_CACHE_DEDUP_BLOCK_SIZE
+#define SCR_CACHE_DEDUP_BLOCK_SIZE (1024*1024)
+#endif
+
+/* max number of consecutive sync flushes written as block deltas against
+ * the last full flush, 0 disables delta flushes */
+#ifndef SCR_FLUSH_DELTA
+#define SCR_FLUSH_DELTA (0)
+#endif
+
+/* size of blocks compared when writing a delta flush */
+#ifndef SCR_FLUSH_DELTA_BLOCK_SIZE
+#define SCR_FLUSH_DELTA_BLOCK_SIZE (1024*1024)
+#endif
+
+/* whether synchronous flushes link files unchanged since the last flush */
+#ifndef SCR_FLUSH_INCREMENTAL
+#define SCR_FLUSH_INCREMENTAL (0)
+#endif
+
+/* whether files of output datasets are copied to the prefix directory
+ * as soon as the application completes them */
+#ifndef SCR_FLUSH_THROUGH
+#define SCR_FLUSH_THROUGH (0)
+#endif
+
+/* number of bytes per stripe of flushed files, sets the stripe count
+ * of each file from its size, set to 0 to keep the default layout */
+#ifndef SCR_FLUSH_STRIPE_BYTES
+#define SCR_FLUSH_STRIPE_BYTES (0)
+#endif
+
+/* max number of stripes of a flushed file, set to 0 for no limit */
+#ifndef SCR_FLUSH_STRIPE_MAX
+#define SCR_FLUSH_STRIPE_MAX (0)
+#endif
+
+/* stripe size of flushed files, set to 0 for the file system default */
+#ifndef SCR_FLUSH_STRIPE_SIZE
+#define SCR_FLUSH_STRIPE_SIZE (0)
+#endif
+
+/* number of metadata targets to spread flushed directories over,
+ * set to 0 to create directories on the default target */
+#ifndef SCR_FLUSH_MDT_COUNT
+#define SCR_FLUSH_MDT_COUNT (0)
+#endif
+
+/* number of ranks in each shard file of the binary rank2file map,
+ * set to 0 to write the kvtree format instead */
+#ifndef SCR_RANK2FILE_SHARD
+#define SCR_RANK2FILE_SHARD (8192)
+#endif
+
+/* compression level to use with ZSTD, lower levels are faster */
+#ifndef SCR_COMPRESS_ZSTD_LEVEL
+#define SCR_COMPRESS_ZSTD_LEVEL (1)
+#endif
+
 /* whether to force a flush on a restart (useful for codes that must restart from parallel file system) */
 #ifndef SCR_FLUSH_ON_RESTART
 #define SCR_FLUSH_ON_RESTART (0)
@@ -222,14 +524,47 @@
 #define SCR_FLUSH_ASYNC (0)
 #endif
 
-/* aggregrate bandwidth limit to impose during asynchronous flushes */
+/* bandwidth limit per node in bytes/sec to impose during asynchronous flushes (0 disables) */
 #ifndef SCR_FLUSH_ASYNC_BW
-#define SCR_FLUSH_ASYNC_BW (200*1024*1024)
+#define SCR_FLUSH_ASYNC_BW (0)
 #endif
 
-/* maximum percent cpu time allowed during asynchronous flushes (does not yet work well) */
+/* maximum percent slowdown of the time between SCR_Need_checkpoint calls
+ * allowed during asynchronous flushes (0 disables) */
 #ifndef SCR_FLUSH_ASYNC_PERCENT
-#define SCR_FLUSH_ASYNC_PERCENT (0.0) /* TODO: the fsync complicates this throttling, disable it for now */
+#define SCR_FLUSH_ASYNC_PERCENT (0.0)
+#endif
+
+/* maximum number of datasets to have in flight with asynchronous flush */
+#ifndef SCR_FLUSH_ASYNC_DEPTH
+#define SCR_FLUSH_ASYNC_DEPTH (1)
+#endif
+
+/* whether a new asynchronous flush of a checkpoint cancels
+ * ongoing flushes of older checkpoints */
+#ifndef SCR_FLUSH_ASYNC_LATEST
+#define SCR_FLUSH_ASYNC_LATEST (0)
+#endif
+
+/* per-process bandwidth limits in bytes/sec on the hops from cache
+ * to the drain store and from the drain store to the prefix directory (0 disables) */
+#ifndef SCR_DRAIN_BW
+#define SCR_DRAIN_BW (0.0)
+#endif
+
+#ifndef SCR_DRAIN_FLUSH_BW
+#define SCR_DRAIN_FLUSH_BW (0.0)
+#endif
+
+/* whether to gather file lists to one leader per store descriptor group
+ * and run a single AXL transfer per group during sync flush and fetch */
+#ifndef SCR_AXL_AGGREGATE
+#define SCR_AXL_AGGREGATE (0)
+#endif
+
+/* whether to return from complete output while redundancy encoding continues */
+#ifndef SCR_ENCODE_ASYNC
+#define SCR_ENCODE_ASYNC (0)
 #endif
 
 /* max number of checkpoints to keep in prefix (0 disables) */
@@ -237,6 +572,16 @@
 #define SCR_PREFIX_SIZE (0)
 #endif
 
+/* whether to delete datasets from prefix with a background thread */
+#ifndef SCR_PREFIX_DELETE_ASYNC
+#define SCR_PREFIX_DELETE_ASYNC (1)
+#endif
+
+/* number of threads on each node to delete files of datasets from prefix */
+#ifndef SCR_PREFIX_DELETE_THREADS
+#define SCR_PREFIX_DELETE_THREADS (16)
+#endif
+
 /* =========================================================================
  * Default checksum settings.
  * ========================================================================= */
@@ -256,6 +601,54 @@
 #define SCR_CRC_ON_DELETE (0)
 #endif
 
+/* whether to delete files of datasets from cache with a background thread */
+#ifndef SCR_CACHE_DELETE_ASYNC
+#define SCR_CACHE_DELETE_ASYNC (0)
+#endif
+
+/* whether to create the cache directories of the next checkpoint
+ * in the background once a checkpoint completes */
+#ifndef SCR_CACHE_PREPARE
+#define SCR_CACHE_PREPARE (0)
+#endif
+
+/* whether to write the filemap once when an output completes,
+ * rather than each time a file is routed during the output */
+#ifndef SCR_MAP_DEFER
+#define SCR_MAP_DEFER (0)
+#endif
+
+/* whether to stat files again to check their mtime and size before
+ * trusting the meta data recorded when the output was completed */
+#ifndef SCR_FILE_REVALIDATE
+#define SCR_FILE_REVALIDATE (0)
+#endif
+
+/* number of threads to look up the files of a dataset in cache */
+#ifndef SCR_STAT_THREADS
+#define SCR_STAT_THREADS (4)
+#endif
+
+/* number of threads to compute the crc32 of a large file,
+ * and the minimum file size in bytes before threads are used */
+#ifndef SCR_CRC_THREADS
+#define SCR_CRC_THREADS (1)
+#endif
+
+#ifndef SCR_CRC_THREAD_MIN_SIZE
+#define SCR_CRC_THREAD_MIN_SIZE (64*1024*1024)
+#endif
+
+/* NUMA node to place copy and checksum buffers on, NONE, AUTO, LOCAL, or a number */
+#ifndef SCR_NUMA
+#define SCR_NUMA ("NONE")
+#endif
+
+/* checksum algorithm to record for new files, see scr_checksum.h */
+#ifndef SCR_CHECKSUM_TYPE
+#define SCR_CHECKSUM_TYPE (SCR_CHECKSUM_CRC32)
+#endif
+
 /* =========================================================================
  * The following settings adjust when SCR_Need_checkpoint() will return true.
  * If all settings are 0, all options are disabled and Need_checkpoint() always returns true.
@@ -276,6 +669,24 @@
 #define SCR_CHECKPOINT_OVERHEAD (0)
 #endif
 
+/* mean seconds between failures used to compute the checkpoint interval,
+ * set to 0 to estimate from the log */
+#ifndef SCR_CHECKPOINT_MTBF
+#define SCR_CHECKPOINT_MTBF (0)
+#endif
+
+/* mean seconds between failures that need the prefix directory used to
+ * compute the flush interval, set to 0 to estimate from the log */
+#ifndef SCR_CHECKPOINT_MTBF_PFS
+#define SCR_CHECKPOINT_MTBF_PFS (0)
+#endif
+
+/* whether to pick the redundancy descriptor of each checkpoint from the
+ * measured cost of each one and the failure rates rather than by interval */
+#ifndef SCR_REDDESC_MODEL
+#define SCR_REDDESC_MODEL (0)
+#endif
+
 /* =========================================================================
  * The following applies to scr_io operations
  * ========================================================================= */
@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#include "scr_globals.h"
+
+#include "spath.h"
+#include "kvtree_util.h"
+
+/* copy length bytes from the current position of src_fd to the
+ * current position of dst_fd through buf of buf_size bytes */
+static int scr_container_copy(
+  const char* src_file, int src_fd,
+  const char* dst_file, int dst_fd,
+  unsigned long length, char* buf, size_t buf_size)
+{
+  unsigned long remaining = length;
+  while (remaining > 0) {
+    size_t chunk = buf_size;
+    if ((unsigned long) chunk > remaining) {
+      chunk = (size_t) remaining;
+    }
+
+    /* the source must hold all length bytes */
+    ssize_t nread = scr_read(src_file, src_fd, buf, chunk);
+    if (nread != (ssize_t) chunk) {
+      scr_err("Failed to read %lu bytes from %s @ %s:%d",
+        (unsigned long) chunk, src_file, __FILE__, __LINE__
+      );
+      return SCR_FAILURE;
+    }
+
+    ssize_t nwrite = scr_write(dst_file, dst_fd, buf, chunk);
+    if (nwrite != (ssize_t) chunk) {
+      scr_err("Failed to write %lu bytes to %s @ %s:%d",
+        (unsigned long) chunk, dst_file, __FILE__, __LINE__
+      );
+      return SCR_FAILURE;
+    }
+
+    remaining -= (unsigned long) chunk;
+  }
+  return SCR_SUCCESS;
+}
+
+/* copy count files in src_filelist into a container file in dir shared
+ * with all processes in comm, records the location of each file under
+ * its dst_filelist name in filelist, must be called by all procs in comm */
+int scr_container_write(
+  const char* dir,
+  int count,
+  const char** src_filelist,
+  const char** dst_filelist,
+  kvtree* filelist,
+  MPI_Comm comm,
+  double* moved)
+{
+  int rc = SCR_SUCCESS;
+  *moved = 0.0;
+
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+
+  /* pack our files one after another, so our offset in the
+   * container is the total size of files on lower ranks */
+  int i;
+  unsigned long total = 0;
+  unsigned long* sizes = (unsigned long*) SCR_MALLOC(count * sizeof(unsigned long));
+  for (i = 0; i < count; i++) {
+    sizes[i] = scr_file_size(src_filelist[i]);
+    total += sizes[i];
+  }
+  unsigned long offset = 0;
+  MPI_Exscan(&total, &offset, 1, MPI_UNSIGNED_LONG, MPI_SUM, comm);
+  if (rank == 0) {
+    offset = 0;
+  }
+
+  /* name the container after the world rank of the group leader,
+   * which is unique across groups */
+  int leader = scr_my_rank_world;
+  MPI_Bcast(&leader, 1, MPI_INT, 0, comm);
+  spath* container_path = spath_from_str(dir);
+  spath_append_strf(container_path, "container.%d", leader);
+  spath_reduce(container_path);
+  char* container = spath_strdup(container_path);
+
+  /* rank2file entries are relative to the prefix directory */
+  spath* base = spath_from_str(scr_prefix);
+  spath* rel  = spath_relative(base, container_path);
+  char* relname = spath_strdup(rel);
+  spath_delete(&rel);
+  spath_delete(&base);
+  spath_delete(&container_path);
+
+  /* leader creates the container before anyone writes to it,
+   * and records it so that it can be deleted with the dataset */
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int created = 1;
+  if (rank == 0) {
+    int fd = scr_open(container, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+    if (fd < 0) {
+      scr_err("Failed to create container: scr_open(%s) errno=%d %s @ %s:%d",
+        container, errno, strerror(errno), __FILE__, __LINE__
+      );
+      created = 0;
+    } else {
+      scr_close(container, fd);
+    }
+    kvtree_set_kv(filelist, SCR_KEY_CONTAINER, relname);
+  }
+  MPI_Bcast(&created, 1, MPI_INT, 0, comm);
+  if (! created) {
+    scr_free(&sizes);
+    scr_free(&relname);
+    scr_free(&container);
+    return SCR_FAILURE;
+  }
+
+  /* write our files into our range of the container */
+  if (count > 0) {
+    int fd = scr_open(container, O_WRONLY);
+    char* buf = (char*) SCR_MALLOC(scr_file_buf_size);
+    if (fd < 0) {
+      scr_err("Failed to open container: scr_open(%s) errno=%d %s @ %s:%d",
+        container, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    } else if (scr_lseek(container, fd, (off_t) offset, SEEK_SET) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+
+    for (i = 0; i < count && rc == SCR_SUCCESS; i++) {
+      int src_fd = scr_open(src_filelist[i], O_RDONLY);
+      if (src_fd < 0) {
+        scr_err("Failed to open file to copy: scr_open(%s) errno=%d %s @ %s:%d",
+          src_filelist[i], errno, strerror(errno), __FILE__, __LINE__
+        );
+        rc = SCR_FAILURE;
+        break;
+      }
+      if (scr_container_copy(src_filelist[i], src_fd, container, fd,
+          sizes[i], buf, scr_file_buf_size) != SCR_SUCCESS)
+      {
+        rc = SCR_FAILURE;
+      }
+      scr_close(src_filelist[i], src_fd);
+
+      /* record where this file lives in the container */
+      kvtree* file_hash = scr_flush_rank2file_add(filelist, dst_filelist[i]);
+      kvtree_util_set_str(file_hash, SCR_KEY_CONTAINER, relname);
+      kvtree_util_set_unsigned_long(file_hash, SCR_KEY_OFFSET, offset);
+      kvtree_util_set_unsigned_long(file_hash, SCR_KEY_LENGTH, sizes[i]);
+      offset += sizes[i];
+      *moved += (double) sizes[i];
+    }
+
+    if (fd >= 0) {
+      if (fsync(fd) < 0) {
+        scr_err("Failed to fsync container %s errno=%d %s @ %s:%d",
+          container, errno, strerror(errno), __FILE__, __LINE__
+        );
+        rc = SCR_FAILURE;
+      }
+      if (scr_close(container, fd) != SCR_SUCCESS) {
+        rc = SCR_FAILURE;
+      }
+    }
+    scr_free(&buf);
+  }
+
+  scr_free(&sizes);
+  scr_free(&relname);
+  scr_free(&container);
+
+  return rc;
+}
+
+/* copy length bytes starting at offset in container into file */
+int scr_container_read(
+  const char* container,
+  unsigned long offset,
+  unsigned long length,
+  const char* file)
+{
+  int src_fd = scr_open(container, O_RDONLY);
+  if (src_fd < 0) {
+    scr_err("Failed to open container: scr_open(%s) errno=%d %s @ %s:%d",
+      container, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int dst_fd = scr_open(file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (dst_fd < 0) {
+    scr_err("Failed to open file for writing: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_close(container, src_fd);
+    return SCR_FAILURE;
+  }
+
+  int rc = scr_lseek(container, src_fd, (off_t) offset, SEEK_SET);
+  if (rc == SCR_SUCCESS) {
+    char* buf = (char*) SCR_MALLOC(scr_file_buf_size);
+    rc = scr_container_copy(container, src_fd, file, dst_fd,
+      length, buf, scr_file_buf_size
+    );
+    scr_free(&buf);
+  }
+
+  if (scr_close(file, dst_fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  scr_close(container, src_fd);
+
+  if (rc != SCR_SUCCESS) {
+    unlink(file);
+  }
+  return rc;
+}
+
+/* given rank2file entry of a file, return newly allocated path to its
+ * container along with offset and length, returns SCR_FAILURE if the
+ * file was not written to a container */
+int scr_container_get(
+  const kvtree* file_hash,
+  char** container,
+  unsigned long* offset,
+  unsigned long* length)
+{
+  char* relname = NULL;
+  if (kvtree_util_get_str(file_hash, SCR_KEY_CONTAINER, &relname) != KVTREE_SUCCESS) {
+    return SCR_FAILURE;
+  }
+  if (kvtree_util_get_unsigned_long(file_hash, SCR_KEY_OFFSET, offset) != KVTREE_SUCCESS ||
+      kvtree_util_get_unsigned_long(file_hash, SCR_KEY_LENGTH, length) != KVTREE_SUCCESS)
+  {
+    scr_err("Missing offset or length for file in container %s @ %s:%d",
+      relname, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  spath* path = spath_from_str(scr_prefix);
+  spath_append_str(path, relname);
+  spath_reduce(path);
+  *container = spath_strdup(path);
+  spath_delete(&path);
+
+  return SCR_SUCCESS;
+}
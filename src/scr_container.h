@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_CONTAINER_H
+#define SCR_CONTAINER_H
+
+#include "mpi.h"
+#include "kvtree.h"
+
+/*
+=========================================
+This file packs the files of a group of processes into a single
+container file on the parallel file system.  Each process writes its
+files back to back at an offset computed from the sizes of the files
+on lower ranks in the group, and records the container, offset, and
+length of each file in its rank2file entry.  This creates one file
+per group rather than one per user file, which cuts metadata load on
+the file system.  A restart reads just the byte range for each file.
+=========================================
+*/
+
+/* copy count files in src_filelist into a container file in dir shared
+ * with all processes in comm, records the location of each file under
+ * its dst_filelist name in filelist, must be called by all procs in comm */
+int scr_container_write(
+  const char* dir,
+  int count,
+  const char** src_filelist,
+  const char** dst_filelist,
+  kvtree* filelist,
+  MPI_Comm comm,
+  double* moved
+);
+
+/* copy length bytes starting at offset in container into file */
+int scr_container_read(
+  const char* container,
+  unsigned long offset,
+  unsigned long length,
+  const char* file
+);
+
+/* given rank2file entry of a file, return newly allocated path to its
+ * container along with offset and length, returns SCR_FAILURE if the
+ * file was not written to a container */
+int scr_container_get(
+  const kvtree* file_hash,
+  char** container,
+  unsigned long* offset,
+  unsigned long* length
+);
+
+#endif
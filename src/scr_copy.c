@@ -20,8 +20,13 @@
 #include "scr_err.h"
 #include "scr_util.h"
 #include "scr_meta.h"
+#include "scr_checksum.h"
 #include "scr_filemap.h"
 #include "scr_dataset.h"
+#include "scr_dedup.h"
+#include "scr_compress.h"
+#include "scr_numa.h"
+#include "scr_keys.h"
 
 #include "spath.h"
 #include "kvtree.h"
@@ -40,6 +45,7 @@
 #include <getopt.h>
 #include <dirent.h>
 #include <regex.h>
+#include <pthread.h>
 
 #ifdef SCR_GLOBALS_H
 #error "globals.h accessed from tools"
@@ -61,8 +67,14 @@ struct arglist {
   int id;                 /* dataset id */
   char* prefix;           /* prefix directory */
   unsigned long buf_size; /* number of bytes to copy file data to file system */
+  int pipeline_depth;     /* number of buffers to overlap read, crc, and write */
+  int direct_flag;        /* whether to read and write files with O_DIRECT */
+  int uring_depth;        /* number of reads and writes in flight with io_uring */
   int crc_flag;           /* whether to compute crc32 during copy */
   int partner_flag;       /* whether to copy data for partner */
+  int threads;            /* number of threads to copy files with */
+  int container_flag;     /* whether to pack files of this node into a container */
+  int numa;               /* NUMA setting to run copies and place buffers with */
 };
 
 int process_args(int argc, char **argv, struct arglist* args)
@@ -73,8 +85,14 @@ int process_args(int argc, char **argv, struct arglist* args)
     {"id",         required_argument, NULL, 'i'},
     {"prefix",     required_argument, NULL, 'd'},
     {"buf",        required_argument, NULL, 'b'},
+    {"pipeline",   required_argument, NULL, 'l'},
     {"crc",        no_argument,       NULL, 'r'},
+    {"direct",     no_argument,       NULL, 'o'},
+    {"uring",      required_argument, NULL, 'u'},
     {"partner",    no_argument,       NULL, 'p'},
+    {"threads",    required_argument, NULL, 't'},
+    {"containers", no_argument,       NULL, 'k'},
+    {"numa",       required_argument, NULL, 'n'},
     {0, 0, 0, 0}
   };
 
@@ -83,8 +101,14 @@ int process_args(int argc, char **argv, struct arglist* args)
   args->id             = -1;
   args->prefix         = NULL;
   args->buf_size       = SCR_FILE_BUF_SIZE;
+  args->pipeline_depth = SCR_COPY_PIPELINE_DEPTH;
+  args->direct_flag    = SCR_STORE_DIRECT;
+  args->uring_depth    = SCR_IO_URING_DEPTH;
   args->crc_flag       = SCR_CRC_ON_FLUSH;
   args->partner_flag   = 0;
+  args->threads        = SCR_COPY_THREADS;
+  args->container_flag = 0;
+  args->numa           = scr_numa_from_str(SCR_NUMA);
 
   /* loop through and process all options */
   int c, id;
@@ -92,7 +116,7 @@ int process_args(int argc, char **argv, struct arglist* args)
   do {
     /* read in our next option */
     int option_index = 0;
-    c = getopt_long(argc, argv, "c:i:d:b:rph", long_options, &option_index);
+    c = getopt_long(argc, argv, "c:i:d:b:l:rou:pt:kn:h", long_options, &option_index);
     switch (c) {
       case 'c':
         /* control directory */
@@ -123,14 +147,56 @@ int process_args(int argc, char **argv, struct arglist* args)
         }
         args->buf_size = (unsigned long) bytes;
         break;
+      case 'l':
+        /* number of buffers to use in copy pipeline */
+        args->pipeline_depth = atoi(optarg);
+        if (args->pipeline_depth < 0) {
+          scr_err("%s: Pipeline depth must be non-negative '--pipeline %s'",
+            PROG, optarg
+          );
+          return 0;
+        }
+        break;
       case 'r':
         /* compute and record crc32 during copy */
         args->crc_flag = 1;
         break;
+      case 'o':
+        /* read and write files with O_DIRECT */
+        args->direct_flag = 1;
+        break;
+      case 'u':
+        /* number of reads and writes in flight with io_uring */
+        args->uring_depth = atoi(optarg);
+        break;
       case 'p':
         /* copy out partner files */
         args->partner_flag = 1;
         break;
+      case 't':
+        /* number of threads to copy files with */
+        args->threads = atoi(optarg);
+        if (args->threads < 1) {
+          scr_err("%s: Number of threads must be positive '--threads %s'",
+            PROG, optarg
+          );
+          return 0;
+        }
+        break;
+      case 'k':
+        /* pack files into a container for this node */
+        args->container_flag = 1;
+        break;
+      case 'n':
+        /* NUMA node to copy files on */
+        args->numa = scr_numa_from_str(optarg);
+        if (args->numa < SCR_NUMA_LOCAL) {
+          scr_err("%s: NUMA setting must be NONE, AUTO, LOCAL, or a node '--numa %s'",
+            PROG, optarg
+          );
+          return 0;
+        }
+        break;
       case 'h':
         /* print help message and exit */
         print_usage();
@@ -186,12 +252,6 @@ static int scr_bool_have_file(
     return 0;
   }
 
-  /* check that we can read the file */
-  if (scr_file_is_readable(file) != SCR_SUCCESS) {
-    scr_dbg(2, "%s: Do not have read access to file: %s", PROG, file);
-    return 0;
-  }
-
   int valid = 1;
 
   /* check that we can read meta file for the file */
@@ -201,6 +261,17 @@ static int scr_bool_have_file(
     valid = 0;
   }
 
+  /* check that we can read the file, a deduplicated file is
+   * readable if all of its blocks are in the block store */
+  const kvtree* manifest = scr_meta_get_dedup(meta);
+  if (valid && manifest != NULL && ! scr_dedup_check(manifest)) {
+    scr_dbg(2, "%s: Missing blocks of deduplicated file: %s", PROG, file);
+    valid = 0;
+  } else if (valid && manifest == NULL && scr_file_is_readable(file) != SCR_SUCCESS) {
+    scr_dbg(2, "%s: Do not have read access to file: %s", PROG, file);
+    valid = 0;
+  }
+
   /* check that the file is complete */
   if (valid && scr_meta_is_complete(meta) != SCR_SUCCESS) {
     scr_dbg(2, "%s: File is marked as incomplete: %s", PROG, file);
@@ -229,9 +300,23 @@ static int scr_bool_have_file(
   }
 #endif
 
-  /* check that the file size matches (use strtol while reading data) */
-  unsigned long size = scr_file_size(file);
-  if (valid && scr_meta_check_filesize(meta, size) != SCR_SUCCESS) {
+  /* check that the file size matches (use strtol while reading data),
+   * a file kept compressed in cache must match its compressed size */
+  int comp_type = SCR_COMPRESS_NONE;
+  unsigned long compsize = 0;
+  if (valid && scr_meta_get_cache_compress(meta, &comp_type, &compsize) != SCR_SUCCESS) {
+    scr_dbg(2, "%s: Unknown compression recorded for file: %s", PROG, file);
+    valid = 0;
+  }
+  unsigned long size = (manifest != NULL) ? scr_dedup_size(manifest) : scr_file_size(file);
+  if (valid && comp_type != SCR_COMPRESS_NONE) {
+    if (size != compsize) {
+      scr_dbg(2, "%s: Compressed filesize is incorrect, currently %lu for %s",
+        PROG, size, file
+      );
+      valid = 0;
+    }
+  } else if (valid && scr_meta_check_filesize(meta, size) != SCR_SUCCESS) {
     scr_dbg(2, "%s: Filesize is incorrect, currently %lu for %s",
       PROG, size, file
     );
@@ -268,6 +353,184 @@ static int scr_bool_have_files(scr_filemap* map)
 }
 #endif
 
+/* name of the file in the cache dataset directory that lists files
+ * this node has already copied and verified, so a scavenge that is
+ * killed and run again picks up where it left off */
+#define SCR_COPY_DONE_FILE ("scr_copy.done")
+
+/* an entry in the cache dataset directory to copy, either a filemap
+ * whose files we copy or a redundancy file */
+typedef struct {
+  char* name; /* entry name in cache dataset directory */
+  int   rank; /* rank of filemap, -1 for a redundancy file */
+} scr_copy_job;
+
+/* state shared by the threads that copy files of this node */
+typedef struct {
+  const spath* path_prefix;   /* prefix directory */
+  const spath* path_scr;      /* dataset metadata directory in prefix */
+  const spath* cache_path;    /* dataset metadata directory in cache */
+  const struct arglist* args;
+  scr_copy_job* jobs;         /* entries to copy */
+  int count;                  /* number of entries */
+  int next;                   /* index of next entry to copy */
+  int rc;                     /* non-zero if any copy failed */
+  int skipped;                /* number of files an earlier run copied */
+  kvtree* done;               /* files copied by earlier runs, read-only once threads start */
+  int done_fd;                /* high-water mark file we append newly copied files to */
+  char* done_file;            /* path to high-water mark file */
+  char* container;            /* path to container of this node, NULL if not packing */
+  char* container_rel;        /* path to container relative to prefix */
+  int container_fd;           /* open file descriptor of container */
+  unsigned long container_end; /* offset of next free byte in container */
+  pthread_mutex_t mutex;      /* protects next, rc, skipped, done_fd, and container_end */
+} scr_copy_pool;
+
+/* read the list of files earlier runs copied, the last line may be cut
+ * short if a run was killed while writing it, in which case we drop it */
+static void scr_copy_done_read(scr_copy_pool* pool)
+{
+  pool->done = kvtree_new();
+
+  int fd = scr_open(pool->done_file, O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+
+  char line[SCR_MAX_FILENAME + 64];
+  while (scr_read_line(pool->done_file, fd, line, sizeof(line)) > 0) {
+    /* each line is <size> <offset or -> <file> */
+    size_t len = strlen(line);
+    if (len == 0 || line[len - 1] != '\n') {
+      break;
+    }
+    line[len - 1] = '\0';
+
+    unsigned long size;
+    char offset[32];
+    int pos;
+    if (sscanf(line, "%lu %31s %n", &size, offset, &pos) != 2) {
+      break;
+    }
+    kvtree* file_hash = kvtree_set_kv(pool->done, SCR_KEY_FILE, line + pos);
+    kvtree_util_set_unsigned_long(file_hash, SCR_KEY_SIZE, size);
+    if (strcmp(offset, "-") != 0) {
+      unsigned long off = strtoul(offset, NULL, 10);
+      kvtree_util_set_unsigned_long(file_hash, SCR_KEY_OFFSET, off);
+      if (off + size > pool->container_end) {
+        pool->container_end = off + size;
+      }
+    }
+  }
+  scr_close(pool->done_file, fd);
+}
+
+/* record that file of size bytes has been copied and verified,
+ * at offset in the container if offset is not NULL */
+static void scr_copy_done_add(scr_copy_pool* pool, const char* file, unsigned long size, const unsigned long* offset)
+{
+  char line[SCR_MAX_FILENAME + 64];
+  int len;
+  if (offset != NULL) {
+    len = snprintf(line, sizeof(line), "%lu %lu %s\n", size, *offset, file);
+  } else {
+    len = snprintf(line, sizeof(line), "%lu - %s\n", size, file);
+  }
+  if (len < 0 || len >= (int) sizeof(line)) {
+    return;
+  }
+
+  /* one write of the whole line, so threads do not interleave */
+  pthread_mutex_lock(&pool->mutex);
+  if (pool->done_fd >= 0) {
+    scr_write(pool->done_file, pool->done_fd, line, (size_t) len);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+/* returns 1 if an earlier run copied file to dst_file, or into the
+ * container at an offset it returns in offset if packed is set, and
+ * the copy of size bytes is still there, 0 otherwise */
+static int scr_copy_done_check(scr_copy_pool* pool, const char* file, const char* dst_file, int packed, unsigned long size, unsigned long* offset)
+{
+  kvtree* file_hash = kvtree_get_kv(pool->done, SCR_KEY_FILE, file);
+  unsigned long done_size;
+  if (kvtree_util_get_unsigned_long(file_hash, SCR_KEY_SIZE, &done_size) != KVTREE_SUCCESS ||
+      done_size != size)
+  {
+    return 0;
+  }
+
+  unsigned long off = 0;
+  int in_container = (kvtree_util_get_unsigned_long(file_hash, SCR_KEY_OFFSET, &off) == KVTREE_SUCCESS);
+  int done = 0;
+  if (packed) {
+    done = (in_container && scr_file_size(pool->container) >= off + size);
+    *offset = off;
+  } else if (! in_container) {
+    done = (scr_file_exists(dst_file) == SCR_SUCCESS && scr_file_size(dst_file) == size);
+  }
+
+  if (done) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->skipped++;
+    pthread_mutex_unlock(&pool->mutex);
+  }
+  return done;
+}
+
+/* copy size bytes of file to offset in the container, and compute
+ * crc32 on the way if crc is not NULL */
+static int scr_copy_to_container(scr_copy_pool* pool, const char* file, unsigned long offset, unsigned long size, uLong* crc)
+{
+  int fd = scr_open(file, O_RDONLY);
+  if (fd < 0) {
+    scr_err("scr_copy: Failed to open file to copy: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  int rc = SCR_SUCCESS;
+  size_t buf_size = (size_t) pool->args->buf_size;
+  char* buf = (char*) SCR_MALLOC(buf_size);
+  unsigned long remaining = size;
+  off_t pos = (off_t) offset;
+  while (remaining > 0) {
+    size_t chunk = buf_size;
+    if ((unsigned long) chunk > remaining) {
+      chunk = (size_t) remaining;
+    }
+
+    ssize_t nread = scr_read(file, fd, buf, chunk);
+    if (nread != (ssize_t) chunk) {
+      scr_err("scr_copy: Failed to read %lu bytes from %s @ %s:%d",
+        (unsigned long) chunk, file, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+      break;
+    }
+    if (crc != NULL) {
+      *crc = crc32(*crc, (const Bytef*) buf, (uInt) chunk);
+    }
+
+    if (pwrite(pool->container_fd, buf, chunk, pos) != (ssize_t) chunk) {
+      scr_err("scr_copy: Failed to write %lu bytes to %s errno=%d %s @ %s:%d",
+        (unsigned long) chunk, pool->container, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+      break;
+    }
+
+    pos       += (off_t) chunk;
+    remaining -= (unsigned long) chunk;
+  }
+  scr_free(&buf);
+  scr_close(file, fd);
+
+  return rc;
+}
+
 static int copy_files_for_filemap(
   const spath* path_prefix,
   const spath* path_scr,
@@ -275,10 +538,19 @@ static int copy_files_for_filemap(
   const char* entryname,
   int rank,
   const struct arglist* args,
-  const char* hostname)
+  const char* hostname,
+  scr_copy_pool* pool,
+  int owner)
 {
   int rc = 0;
 
+  /* records where files we pack into the container went, the owner
+   * also lists the container itself so it is deleted with the dataset */
+  kvtree* ctrmap = kvtree_new();
+  if (owner && pool->container != NULL) {
+    kvtree_set_kv(ctrmap, SCR_KEY_CONTAINER, pool->container_rel);
+  }
+
   /* define full path to the filemap */
   spath* path_filemap = spath_dup(cache_path);
   spath_append_str(path_filemap, entryname);
@@ -321,6 +593,7 @@ static int copy_files_for_filemap(
         scr_meta_delete(&meta);
         scr_filemap_delete(&map);
         scr_filemap_delete(&rank_map);
+        kvtree_delete(&ctrmap);
         return 1;
       }
   
@@ -335,6 +608,7 @@ static int copy_files_for_filemap(
         scr_meta_delete(&meta);
         scr_filemap_delete(&map);
         scr_filemap_delete(&rank_map);
+        kvtree_delete(&ctrmap);
         return 1;
       }
   
@@ -353,21 +627,74 @@ static int copy_files_for_filemap(
         crc_valid = 1;
         crc_p = &crc;
       }
-      if (strcmp(file, dst_file) != 0) {
+
+      /* deduplicated and compressed files are written out in full,
+       * others may be packed */
+      const kvtree* manifest = scr_meta_get_dedup(meta);
+      int comp_type = SCR_COMPRESS_NONE;
+      scr_meta_get_cache_compress(meta, &comp_type, NULL);
+      int packed = (pool->container != NULL && manifest == NULL &&
+                    comp_type == SCR_COMPRESS_NONE && strcmp(file, dst_file) != 0);
+      unsigned long size = scr_file_size(file);
+      if (comp_type != SCR_COMPRESS_NONE) {
+        scr_meta_get_filesize(meta, &size);
+      }
+      unsigned long offset = 0;
+      int copied = 0;
+      int file_rc = 0;
+      if (scr_copy_done_check(pool, file, dst_file, packed, size, &offset)) {
+        /* an earlier run copied and verified this file */
+        crc_valid = 0;
+      } else if (comp_type != SCR_COMPRESS_NONE) {
+        /* file was compressed in cache, so write out its original data */
+        unsigned long decomp_size = 0;
+        if (scr_decompress_file(file, dst_file, comp_type, &decomp_size, crc_p) != SCR_SUCCESS ||
+            decomp_size != size)
+        {
+          crc_valid = 0;
+          file_rc = 1;
+        }
+        copied = 1;
+      } else if (manifest != NULL) {
+        /* file was deduplicated in cache, so assemble it from its blocks */
+        if (scr_dedup_write(manifest, dst_file) != SCR_SUCCESS) {
+          file_rc = 1;
+        }
+        crc_valid = 0;
+        copied = 1;
+      } else if (packed) {
+        /* claim the next range of the container */
+        pthread_mutex_lock(&pool->mutex);
+        offset = pool->container_end;
+        pool->container_end += size;
+        pthread_mutex_unlock(&pool->mutex);
+        if (scr_copy_to_container(pool, file, offset, size, crc_p) != SCR_SUCCESS) {
+          crc_valid = 0;
+          file_rc = 1;
+        }
+        copied = 1;
+      } else if (strcmp(file, dst_file) != 0) {
         /* in case of bypass, only copy file if source and dest paths are different */
-        if (scr_file_copy(file, dst_file, args->buf_size, crc_p) != SCR_SUCCESS) {
+        int copy_rc;
+        if (args->direct_flag) {
+          copy_rc = scr_file_copy_direct(file, dst_file, args->buf_size, (size_t) getpagesize(), crc_p);
+        } else {
+          copy_rc = scr_file_copy_pipeline(file, dst_file, args->buf_size, args->pipeline_depth, crc_p);
+        }
+        if (copy_rc != SCR_SUCCESS) {
           crc_valid = 0;
-          rc = 1;
+          file_rc = 1;
         }
+        copied = 1;
       } else {
         /* TODO: should we stat file and check its size? */
         /* didn't attempt a copy, so we don't have a valid crc */
         crc_valid = 0;
       }
 
-      /* apply metadata to file */
-      if (scr_meta_apply_stat(meta, dst_file) != SCR_SUCCESS) {
-        rc = 1;
+      /* apply metadata to file, a packed file has none of its own */
+      if (! packed && scr_meta_apply_stat(meta, dst_file) != SCR_SUCCESS) {
+        file_rc = 1;
         scr_err("scr_copy: Failed to copy file metadata properties from %s to %s @ %s:%d",
           file, dst_file, __FILE__, __LINE__
         );
@@ -375,10 +702,31 @@ static int copy_files_for_filemap(
   
       /* add this file to the rank_map */
       scr_filemap_add_file(rank_map, file);
+
+      /* the copy holds the original data */
+      scr_meta_set_cache_compress(meta, SCR_COMPRESS_NONE, 0);
   
       /* if file has crc32, check it against the one computed during
        * the copy, otherwise if crc_flag is set, record crc32 */
-      if (crc_valid) {
+      int meta_type;
+      uint64_t meta_value;
+      if (crc_valid && ! packed &&
+          scr_meta_get_checksum(meta, &meta_type, &meta_value) == SCR_SUCCESS &&
+          meta_type != SCR_CHECKSUM_CRC32)
+      {
+        /* file was recorded with a different checksum algorithm than
+         * the crc32 we computed during the copy, so check the copy */
+        uint64_t dst_value;
+        if (scr_checksum_file(dst_file, meta_type, &dst_value) != SCR_SUCCESS ||
+            dst_value != meta_value)
+        {
+          scr_meta_set_complete(meta, 0);
+          file_rc = 1;
+          scr_err("scr_copy: %s mismatch detected when flushing file %s to %s @ %s:%d",
+            scr_checksum_type_to_str(meta_type), file, dst_file, __FILE__, __LINE__
+          );
+        }
+      } else if (crc_valid) {
         uLong meta_crc;
         if (scr_meta_get_crc32(meta, &meta_crc) == SCR_SUCCESS) {
           if (crc != meta_crc) {
@@ -390,7 +738,7 @@ static int copy_files_for_filemap(
             /* mark the file as invalid */
             scr_meta_set_complete(meta, 0);
   
-            rc = 1;
+            file_rc = 1;
             scr_err("scr_copy: CRC32 mismatch detected when flushing file %s to %s @ %s:%d",
               file, dst_file, __FILE__, __LINE__
             );
@@ -412,6 +760,22 @@ static int copy_files_for_filemap(
   
       /* record its meta data in the filemap */
       scr_filemap_set_meta(rank_map, file, meta);
+
+      /* note files we copied and verified so a rerun can skip them,
+       * and where packed files went in the container */
+      if (file_rc != 0) {
+        rc = 1;
+      } else {
+        if (copied) {
+          scr_copy_done_add(pool, file, size, packed ? &offset : NULL);
+        }
+        if (packed) {
+          kvtree* ctr_hash = kvtree_set_kv(ctrmap, SCR_KEY_FILE, file);
+          kvtree_util_set_str(ctr_hash, SCR_KEY_CONTAINER, pool->container_rel);
+          kvtree_util_set_unsigned_long(ctr_hash, SCR_KEY_OFFSET, offset);
+          kvtree_util_set_unsigned_long(ctr_hash, SCR_KEY_LENGTH, size);
+        }
+      }
   
       /* free the destination file path and string */
       scr_free(&dst_file);
@@ -447,6 +811,17 @@ static int copy_files_for_filemap(
   scr_free(&src_filemap);
   spath_delete(&path_rank);
 
+  /* write out where packed files are for scr_index */
+  if (kvtree_size(ctrmap) > 0) {
+    spath* path_ctrmap = spath_dup(path_scr);
+    spath_append_strf(path_ctrmap, "ctrmap_%d", rank);
+    if (kvtree_write_path(path_ctrmap, ctrmap) != KVTREE_SUCCESS) {
+      rc = 1;
+    }
+    spath_delete(&path_ctrmap);
+  }
+  kvtree_delete(&ctrmap);
+
   /* delete the rank filemap object */
   scr_filemap_delete(&rank_map);
   scr_filemap_delete(&map);
@@ -460,7 +835,8 @@ static int copy_files_redset(
   const spath* cache_path,
   const char* entryname,
   const struct arglist* args,
-  const char* hostname)
+  const char* hostname,
+  scr_copy_pool* pool)
 {
   int rc = 0;
 
@@ -476,9 +852,14 @@ static int copy_files_redset(
   spath_reduce(dst_path);
   char* dst_file = spath_strdup(dst_path);
 
-  /* copy redset file to prefix directory */
-  if (scr_file_copy(file, dst_file, args->buf_size, NULL) != SCR_SUCCESS) {
-    rc = 1;
+  /* copy redset file to prefix directory, unless an earlier run did */
+  unsigned long offset;
+  if (! scr_copy_done_check(pool, file, dst_file, 0, scr_file_size(file), &offset)) {
+    if (scr_file_copy_pipeline(file, dst_file, args->buf_size, args->pipeline_depth, NULL) != SCR_SUCCESS) {
+      rc = 1;
+    } else {
+      scr_copy_done_add(pool, file, scr_file_size(file), NULL);
+    }
   }
 
   /* free our paths */
@@ -490,6 +871,50 @@ static int copy_files_redset(
   return rc;
 }
 
+/* pull entries from the pool and copy them until none are left,
+ * the first filemap in the list owns the container */
+static void* scr_copy_worker(void* arg)
+{
+  scr_copy_pool* pool = (scr_copy_pool*) arg;
+  while (1) {
+    pthread_mutex_lock(&pool->mutex);
+    int i = pool->next;
+    pool->next++;
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (i >= pool->count) {
+      break;
+    }
+
+    int tmp_rc;
+    const scr_copy_job* job = &pool->jobs[i];
+    if (job->rank >= 0) {
+      int owner = 1;
+      int j;
+      for (j = 0; j < i; j++) {
+        if (pool->jobs[j].rank >= 0) {
+          owner = 0;
+          break;
+        }
+      }
+      tmp_rc = copy_files_for_filemap(pool->path_prefix, pool->path_scr, pool->cache_path,
+        job->name, job->rank, pool->args, hostname, pool, owner
+      );
+    } else {
+      tmp_rc = copy_files_redset(pool->path_prefix, pool->path_scr, pool->cache_path,
+        job->name, pool->args, hostname, pool
+      );
+    }
+
+    if (tmp_rc != 0) {
+      pthread_mutex_lock(&pool->mutex);
+      pool->rc = tmp_rc;
+      pthread_mutex_unlock(&pool->mutex);
+    }
+  }
+  return NULL;
+}
+
 int main (int argc, char *argv[])
 {
   /* get my hostname */
@@ -508,6 +933,19 @@ int main (int argc, char *argv[])
     return 1;
   }
 
+  /* use io_uring for file copies if asked */
+  scr_io_set_uring_depth(args.uring_depth);
+
+  /* run this process and the threads it starts on the chosen node,
+   * buffers are then placed there as they are first touched,
+   * AUTO picks the node of the device holding the control directory */
+  if (args.numa != SCR_NUMA_NONE) {
+    int node = scr_numa_resolve(args.numa, args.cntldir);
+    if (node >= 0 && scr_numa_bind_thread(node) != SCR_SUCCESS) {
+      scr_dbg(1, "%s: Failed to bind to NUMA node %d", PROG, node);
+    }
+  }
+
 #if 0
   /* read cindex file to get metadata for dataset */
   scr_cache_index* scr_cindex = scr_cache_index_new();
@@ -565,7 +1003,10 @@ int main (int argc, char *argv[])
 
   int rc = 0;
 
-  /* iterate over each rank we have for this dataset */
+  /* list the filemaps and redundancy files we have for this dataset */
+  int count = 0;
+  int cap = 0;
+  scr_copy_job* jobs = NULL;
   errno = 0;
   DIR* d = opendir(cache_str);
   if (d != NULL) {
@@ -575,12 +1016,13 @@ int main (int argc, char *argv[])
       /* get pointer to name of entry */
       const char* entryname = de->d_name;
 
-      int rank;
+      int rank = -1;
       char* value = NULL;
       size_t nmatch = 5;
       regmatch_t pmatch[5];
 
       /* look for file names like: "filemap_0" */
+      int found = 0;
       if (regexec(&re_filemap_file, entryname, nmatch, pmatch, 0) == 0) {
         /* get the MPI rank of the file */
         value = strndup(entryname + pmatch[1].rm_so, (size_t)(pmatch[1].rm_eo - pmatch[1].rm_so));
@@ -588,53 +1030,31 @@ int main (int argc, char *argv[])
           rank = atoi(value);
           scr_free(&value);
         }
-
-        /* found a filemap, copy its files */
-        int tmp_rc = copy_files_for_filemap(path_prefix, path_scr, cache_path, entryname, rank, &args, hostname);
-        if (tmp_rc != 0) {
-          rc = tmp_rc;
-        }
-        continue;
+        found = 1;
+      } else if (regexec(&re_redsetmap_file, entryname, nmatch, pmatch, 0) == 0 ||
+                 regexec(&re_redsetmap_type_file, entryname, nmatch, pmatch, 0) == 0 ||
+                 regexec(&re_redset_file, entryname, nmatch, pmatch, 0) == 0 ||
+                 regexec(&re_redset_type_file, entryname, nmatch, pmatch, 0) == 0)
+      {
+        /* look for file names like: "reddescmap.er.0.redset",
+         * "reddescmap.er.0.partner.0_1.redset", "reddesc.er.0.redset",
+         * and "reddesc.er.0.partner.0_1.redset" */
+        found = 1;
       }
 
-      /* look for file names like: "reddescmap.er.0.redset" */
-      if (regexec(&re_redsetmap_file, entryname, nmatch, pmatch, 0) == 0) {
-        /* found a filemap, copy its files */
-        int tmp_rc = copy_files_redset(path_prefix, path_scr, cache_path, entryname, &args, hostname);
-        if (tmp_rc != 0) {
-          rc = tmp_rc;
-        }
-        continue;
-      }
-
-      /* look for file names like: "reddescmap.er.0.partner.0_1.redset" */
-      if (regexec(&re_redsetmap_type_file, entryname, nmatch, pmatch, 0) == 0) {
-        /* found a filemap, copy its files */
-        int tmp_rc = copy_files_redset(path_prefix, path_scr, cache_path, entryname, &args, hostname);
-        if (tmp_rc != 0) {
-          rc = tmp_rc;
-        }
-        continue;
-      }
-
-      /* look for file names like: "reddesc.er.0.redset" */
-      if (regexec(&re_redset_file, entryname, nmatch, pmatch, 0) == 0) {
-        /* found a filemap, copy its files */
-        int tmp_rc = copy_files_redset(path_prefix, path_scr, cache_path, entryname, &args, hostname);
-        if (tmp_rc != 0) {
-          rc = tmp_rc;
-        }
-        continue;
-      }
-
-      /* look for file names like: "reddesc.er.0.partner.0_1.redset" */
-      if (regexec(&re_redset_type_file, entryname, nmatch, pmatch, 0) == 0) {
-        /* found a filemap, copy its files */
-        int tmp_rc = copy_files_redset(path_prefix, path_scr, cache_path, entryname, &args, hostname);
-        if (tmp_rc != 0) {
-          rc = tmp_rc;
+      if (found) {
+        if (count == cap) {
+          cap = (cap > 0) ? cap * 2 : 64;
+          scr_copy_job* bigger = (scr_copy_job*) SCR_MALLOC(cap * sizeof(scr_copy_job));
+          if (count > 0) {
+            memcpy(bigger, jobs, count * sizeof(scr_copy_job));
+          }
+          scr_free(&jobs);
+          jobs = bigger;
         }
-        continue;
+        jobs[count].name = strdup(entryname);
+        jobs[count].rank = rank;
+        count++;
       }
     }
 
@@ -651,6 +1071,106 @@ int main (int argc, char *argv[])
     rc = 1;
   }
 
+  /* set up what the copy threads share */
+  scr_copy_pool pool;
+  pool.path_prefix   = path_prefix;
+  pool.path_scr      = path_scr;
+  pool.cache_path    = cache_path;
+  pool.args          = &args;
+  pool.jobs          = jobs;
+  pool.count         = count;
+  pool.next          = 0;
+  pool.rc            = 0;
+  pool.skipped       = 0;
+  pool.container     = NULL;
+  pool.container_rel = NULL;
+  pool.container_fd  = -1;
+  pool.container_end = 0;
+  pthread_mutex_init(&pool.mutex, NULL);
+
+  /* read what earlier runs copied, and open the list to add to it */
+  spath* done_path = spath_dup(cache_path);
+  spath_append_str(done_path, SCR_COPY_DONE_FILE);
+  pool.done_file = spath_strdup(done_path);
+  spath_delete(&done_path);
+  scr_copy_done_read(&pool);
+  pool.done_fd = scr_open(pool.done_file, O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR);
+
+  /* pack files into one container for this node if asked, a rerun
+   * keeps the files earlier runs packed and adds to the end */
+  if (args.container_flag && rc == 0) {
+    spath* ctr_path = spath_dup(path_scr);
+    spath_append_strf(ctr_path, "container.%s", hostname);
+    pool.container = spath_strdup(ctr_path);
+    spath* ctr_rel = spath_relative(path_prefix, ctr_path);
+    pool.container_rel = spath_strdup(ctr_rel);
+    spath_delete(&ctr_rel);
+    spath_delete(&ctr_path);
+
+    int flags = O_WRONLY | O_CREAT;
+    if (pool.container_end == 0) {
+      flags |= O_TRUNC;
+    }
+    pool.container_fd = scr_open(pool.container, flags, S_IRUSR | S_IWUSR);
+    if (pool.container_fd < 0) {
+      printf("scr_copy: %s: Failed to open container %s in dataset id %d\n",
+        hostname, pool.container, args.id
+      );
+      rc = 1;
+    }
+  }
+
+  /* copy with a pool of threads, this thread serves as one of them */
+  if (rc == 0 && count > 0) {
+    int workers = args.threads;
+    if (workers > count) {
+      workers = count;
+    }
+    pthread_t* threads = (pthread_t*) SCR_MALLOC(workers * sizeof(pthread_t));
+    int nthreads = 1;
+    while (nthreads < workers &&
+           pthread_create(&threads[nthreads], NULL, scr_copy_worker, &pool) == 0)
+    {
+      nthreads++;
+    }
+    scr_copy_worker(&pool);
+    int i;
+    for (i = 1; i < nthreads; i++) {
+      pthread_join(threads[i], NULL);
+    }
+    scr_free(&threads);
+    rc = pool.rc;
+  }
+
+  if (pool.skipped > 0) {
+    printf("scr_copy: %s: Skipped %d files copied by an earlier run\n",
+      hostname, pool.skipped
+    );
+  }
+
+  /* the container holds the packed files, so it must reach disk */
+  if (pool.container_fd >= 0) {
+    if (fsync(pool.container_fd) < 0 ||
+        scr_close(pool.container, pool.container_fd) != SCR_SUCCESS)
+    {
+      rc = 1;
+    }
+  }
+  if (pool.done_fd >= 0) {
+    scr_close(pool.done_file, pool.done_fd);
+  }
+  pthread_mutex_destroy(&pool.mutex);
+  kvtree_delete(&pool.done);
+  scr_free(&pool.done_file);
+  scr_free(&pool.container);
+  scr_free(&pool.container_rel);
+
+  int i;
+  for (i = 0; i < count; i++) {
+    scr_free(&jobs[i].name);
+  }
+  scr_free(&jobs);
+
   /* free our regular expressions */
   regfree(&re_filemap_file);
   regfree(&re_redsetmap_file);
@@ -52,6 +52,7 @@
 #define SCR_DATASET_KEY_CLUSTER  ("CLUSTER")
 #define SCR_DATASET_KEY_CKPT     ("CKPT")
 #define SCR_DATASET_KEY_COMPLETE ("COMPLETE")
+#define SCR_DATASET_KEY_BASE     ("BASE")
 #define SCR_DATASET_KEY_FLAG_CKPT   ("FLAG_CKPT")
 #define SCR_DATASET_KEY_FLAG_OUTPUT ("FLAG_OUTPUT")
 
@@ -167,6 +168,13 @@ int scr_dataset_set_complete(scr_dataset* dataset, int complete)
   return convert_kvtree_rc(kvtree_rc);
 }
 
+/* sets the id of the dataset this dataset was flushed as a delta against */
+int scr_dataset_set_base(scr_dataset* dataset, int id)
+{
+  int kvtree_rc = kvtree_util_set_int(dataset, SCR_DATASET_KEY_BASE, id);
+  return convert_kvtree_rc(kvtree_rc);
+}
+
 /*
 =========================================
 Get field values
@@ -250,6 +258,13 @@ int scr_dataset_get_complete(const scr_dataset* dataset, int* complete)
   return convert_kvtree_rc(kvtree_rc);
 }
 
+/* gets id of base dataset recorded in dataset, returns SCR_SUCCESS if successful */
+int scr_dataset_get_base(const scr_dataset* dataset, int* id)
+{
+  int kvtree_rc = kvtree_util_get_int(dataset, SCR_DATASET_KEY_BASE, id);
+  return convert_kvtree_rc(kvtree_rc);
+}
+
 /*
 =========================================
 Check field values
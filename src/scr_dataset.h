@@ -94,6 +94,9 @@ int scr_dataset_set_ckpt(scr_dataset* dataset, int id);
 /* sets the complete flag for the dataset to be the value specified */
 int scr_dataset_set_complete(scr_dataset* dataset, int complete);
 
+/* sets the id of the dataset this dataset was flushed as a delta against */
+int scr_dataset_set_base(scr_dataset* dataset, int id);
+
 /*
 =========================================
 Get field values
@@ -133,6 +136,9 @@ int scr_dataset_get_ckpt(const scr_dataset* dataset, int* id);
 /* gets complete flag recorded in dataset, returns SCR_SUCCESS if successful */
 int scr_dataset_get_complete(const scr_dataset* dataset, int* complete);
 
+/* gets id of base dataset recorded in dataset, returns SCR_SUCCESS if successful */
+int scr_dataset_get_base(const scr_dataset* dataset, int* id);
+
 /*
 =========================================
 Check field values
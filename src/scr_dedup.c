@@ -0,0 +1,441 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+/* Implements the block store used to deduplicate files in cache.
+ * Blocks are found by their hash, but two blocks are only shared
+ * if their contents compare equal, so a hash collision costs an
+ * extra copy of the block rather than corrupting a file. */
+
+#include "scr_conf.h"
+#include "scr.h"
+#include "scr_err.h"
+#include "scr_io.h"
+#include "scr_util.h"
+#include "scr_checksum.h"
+#include "scr_dedup.h"
+
+#include "spath.h"
+#include "kvtree.h"
+#include "kvtree_util.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define SCR_DEDUP_KEY_STORE     ("STORE")
+#define SCR_DEDUP_KEY_REF       ("REF")
+#define SCR_DEDUP_KEY_SIZE      ("SIZE")
+#define SCR_DEDUP_KEY_BLOCKSIZE ("BLOCKSIZE")
+#define SCR_DEDUP_KEY_BLOCK     ("BLOCK")
+#define SCR_DEDUP_KEY_NAME      ("NAME")
+
+/* number of different blocks we allow to share a hash before we give up */
+#define SCR_DEDUP_MAX_COLLISIONS (16)
+
+/* limit block size to bound memory usage */
+#define SCR_DEDUP_MAX_BLOCK (1024*1024*1024)
+
+/* return newly allocated path to the named block in the store */
+static char* scr_dedup_block_path(const char* store, const char* name)
+{
+  spath* path = spath_from_str(store);
+  spath_append_str(path, name);
+  char* str = spath_strdup(path);
+  spath_delete(&path);
+  return str;
+}
+
+/* return newly allocated path to the link that block index of
+ * file refname holds on the named block */
+static char* scr_dedup_ref_path(const char* store, const char* name, const char* ref, unsigned long index)
+{
+  spath* path = spath_from_str(store);
+  spath_append_strf(path, "%s.%s.%lu", name, ref, index);
+  char* str = spath_strdup(path);
+  spath_delete(&path);
+  return str;
+}
+
+/* read up to size bytes of file into buf, returns number of bytes read or -1 */
+static ssize_t scr_dedup_read(const char* file, void* buf, size_t size)
+{
+  int fd = scr_open(file, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+  ssize_t nread = scr_read_attempt(file, fd, buf, size);
+  scr_close(file, fd);
+  return nread;
+}
+
+/* write size bytes from buf to file, returns SCR_SUCCESS if successful */
+static int scr_dedup_write_block(const char* file, const void* buf, size_t size)
+{
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int fd = scr_open(file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (fd < 0) {
+    scr_err("Opening file for writing: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  int rc = SCR_SUCCESS;
+  if (scr_write_attempt(file, fd, buf, size) != (ssize_t) size) {
+    rc = SCR_FAILURE;
+  }
+  if (scr_close(file, fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  if (rc != SCR_SUCCESS) {
+    unlink(file);
+  }
+  return rc;
+}
+
+/* compare contents of block file to len bytes in buf using cmp as scratch
+ * space of at least len+1 bytes, returns 1 if same, 0 if different,
+ * and -1 if the block file does not exist */
+static int scr_dedup_same(const char* file, const char* buf, size_t len, char* cmp)
+{
+  /* check first so a missing block is not reported as an error */
+  if (access(file, R_OK) != 0) {
+    return -1;
+  }
+
+  ssize_t nread = scr_dedup_read(file, cmp, len + 1);
+  if (nread < 0) {
+    return -1;
+  }
+  if ((size_t) nread != len || memcmp(buf, cmp, len) != 0) {
+    return 0;
+  }
+  return 1;
+}
+
+/* record a reference from block index of file refname to a block
+ * holding len bytes of buf, returns name of block in name */
+static int scr_dedup_store_block(
+  const char* store,
+  const char* ref,
+  unsigned long index,
+  const char* buf,
+  size_t len,
+  char* cmp,
+  char* name,
+  size_t name_size)
+{
+  /* compute the hash of the block */
+  scr_checksum c;
+  scr_checksum_init(&c, SCR_CHECKSUM_XXH64);
+  scr_checksum_update(&c, buf, len);
+  unsigned long long hash = (unsigned long long) scr_checksum_final(&c);
+
+  int rc = SCR_FAILURE;
+  int suffix;
+  for (suffix = 0; suffix < SCR_DEDUP_MAX_COLLISIONS; suffix++) {
+    /* blocks with the same hash but different contents get a suffix */
+    if (suffix == 0) {
+      snprintf(name, name_size, "%016llx", hash);
+    } else {
+      snprintf(name, name_size, "%016llx_%d", hash, suffix);
+    }
+    char* block_path = scr_dedup_block_path(store, name);
+    char* ref_path   = scr_dedup_ref_path(store, name, ref, index);
+
+    /* link to an existing copy of this block if its contents match */
+    int same = scr_dedup_same(block_path, buf, len, cmp);
+    if (same == 1 && link(block_path, ref_path) == 0) {
+      rc = SCR_SUCCESS;
+    } else if (same != 0) {
+      /* there is no copy of this block yet, or another process deleted
+       * it since we looked, so write our own and publish it under the
+       * block name, if someone beats us to that name we keep our copy
+       * private, which costs space but not correctness */
+      if (scr_dedup_write_block(ref_path, buf, len) == SCR_SUCCESS) {
+        link(ref_path, block_path);
+        rc = SCR_SUCCESS;
+      }
+    }
+
+    scr_free(&ref_path);
+    scr_free(&block_path);
+
+    /* we're done unless the block name is taken by different data */
+    if (rc == SCR_SUCCESS || same != 0) {
+      break;
+    }
+  }
+
+  return rc;
+}
+
+int scr_dedup_file(
+  const char* store_dir,
+  const char* file,
+  const char* refname,
+  unsigned long block_size,
+  kvtree* manifest)
+{
+  if (block_size == 0 || block_size > SCR_DEDUP_MAX_BLOCK) {
+    scr_err("Invalid dedup block size %lu @ %s:%d",
+      block_size, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* allocate buffer for block, and one to compare against stored blocks */
+  char* buf = (char*) malloc((size_t) block_size);
+  char* cmp = (char*) malloc((size_t) block_size + 1);
+  if (buf == NULL || cmp == NULL) {
+    scr_err("Allocating memory: malloc(%lu) errno=%d %s @ %s:%d",
+      block_size, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_free(&cmp);
+    scr_free(&buf);
+    return SCR_FAILURE;
+  }
+
+  /* open file for reading */
+  int fd = scr_open(file, O_RDONLY);
+  if (fd < 0) {
+    scr_err("Opening file to deduplicate: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_free(&cmp);
+    scr_free(&buf);
+    return SCR_FAILURE;
+  }
+
+  kvtree_util_set_str(manifest, SCR_DEDUP_KEY_STORE, store_dir);
+  kvtree_util_set_str(manifest, SCR_DEDUP_KEY_REF, refname);
+  kvtree_util_set_unsigned_long(manifest, SCR_DEDUP_KEY_BLOCKSIZE, block_size);
+
+  /* store file one block at a time */
+  int rc = SCR_SUCCESS;
+  unsigned long index = 0;
+  unsigned long total = 0;
+  while (1) {
+    ssize_t nread = scr_read_attempt(file, fd, buf, (size_t) block_size);
+    if (nread < 0) {
+      rc = SCR_FAILURE;
+      break;
+    }
+
+    if (nread > 0) {
+      char name[64];
+      if (scr_dedup_store_block(store_dir, refname, index, buf, (size_t) nread,
+          cmp, name, sizeof(name)) != SCR_SUCCESS)
+      {
+        rc = SCR_FAILURE;
+        break;
+      }
+
+      /* record block in manifest */
+      kvtree* block_hash = kvtree_set_kv_int(manifest, SCR_DEDUP_KEY_BLOCK, (int) index);
+      kvtree_util_set_str(block_hash, SCR_DEDUP_KEY_NAME, name);
+
+      total += (unsigned long) nread;
+      index++;
+    }
+
+    /* assume a short read means we hit the end of the file */
+    if ((unsigned long) nread < block_size) {
+      break;
+    }
+  }
+
+  scr_close(file, fd);
+  scr_free(&cmp);
+  scr_free(&buf);
+
+  kvtree_util_set_unsigned_long(manifest, SCR_DEDUP_KEY_SIZE, total);
+
+  /* on failure, drop the blocks we stored and leave the file alone */
+  if (rc != SCR_SUCCESS) {
+    scr_err("Failed to deduplicate %s @ %s:%d",
+      file, __FILE__, __LINE__
+    );
+    scr_dedup_release(manifest);
+    kvtree_unset_all(manifest);
+    return rc;
+  }
+
+  /* the blocks hold the data now */
+  scr_file_unlink(file);
+
+  scr_dbg(2, "Stored %lu blocks of %s in %s", index, file, store_dir);
+
+  return SCR_SUCCESS;
+}
+
+/* return number of blocks in manifest */
+static unsigned long scr_dedup_count(const kvtree* manifest)
+{
+  return (unsigned long) kvtree_size(kvtree_get(manifest, SCR_DEDUP_KEY_BLOCK));
+}
+
+/* return newly allocated path to the link held by block index, or NULL */
+static char* scr_dedup_manifest_ref(const kvtree* manifest, unsigned long index, char** block_path)
+{
+  char* store = NULL;
+  char* ref   = NULL;
+  char* name  = NULL;
+  kvtree* block_hash = kvtree_get_kv_int(manifest, SCR_DEDUP_KEY_BLOCK, (int) index);
+  if (kvtree_util_get_str(manifest, SCR_DEDUP_KEY_STORE, &store) != KVTREE_SUCCESS ||
+      kvtree_util_get_str(manifest, SCR_DEDUP_KEY_REF, &ref) != KVTREE_SUCCESS ||
+      kvtree_util_get_str(block_hash, SCR_DEDUP_KEY_NAME, &name) != KVTREE_SUCCESS)
+  {
+    return NULL;
+  }
+
+  if (block_path != NULL) {
+    *block_path = scr_dedup_block_path(store, name);
+  }
+  return scr_dedup_ref_path(store, name, ref, index);
+}
+
+int scr_dedup_check(const kvtree* manifest)
+{
+  unsigned long count = scr_dedup_count(manifest);
+  unsigned long i;
+  for (i = 0; i < count; i++) {
+    char* ref_path = scr_dedup_manifest_ref(manifest, i, NULL);
+    int readable = (ref_path != NULL && access(ref_path, R_OK) == 0);
+    scr_free(&ref_path);
+    if (! readable) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+unsigned long scr_dedup_size(const kvtree* manifest)
+{
+  unsigned long size = 0;
+  kvtree_util_get_unsigned_long(manifest, SCR_DEDUP_KEY_SIZE, &size);
+  return size;
+}
+
+int scr_dedup_write(const kvtree* manifest, const char* file)
+{
+  unsigned long block_size = 0;
+  kvtree_util_get_unsigned_long(manifest, SCR_DEDUP_KEY_BLOCKSIZE, &block_size);
+  if (block_size == 0 || block_size > SCR_DEDUP_MAX_BLOCK) {
+    scr_err("Invalid dedup block size %lu for %s @ %s:%d",
+      block_size, file, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  char* buf = (char*) malloc((size_t) block_size);
+  if (buf == NULL) {
+    scr_err("Allocating memory: malloc(%lu) errno=%d %s @ %s:%d",
+      block_size, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int fd = scr_open(file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (fd < 0) {
+    scr_err("Opening file for writing: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_free(&buf);
+    return SCR_FAILURE;
+  }
+
+  /* copy each block in order */
+  int rc = SCR_SUCCESS;
+  unsigned long total = 0;
+  unsigned long count = scr_dedup_count(manifest);
+  unsigned long i;
+  for (i = 0; i < count; i++) {
+    char* ref_path = scr_dedup_manifest_ref(manifest, i, NULL);
+    ssize_t nread = -1;
+    if (ref_path != NULL) {
+      nread = scr_dedup_read(ref_path, buf, (size_t) block_size);
+    }
+    if (nread < 0) {
+      scr_err("Failed to read block %lu of %s from %s @ %s:%d",
+        i, file, (ref_path != NULL) ? ref_path : "(none)", __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    } else if (scr_write_attempt(file, fd, buf, (size_t) nread) != nread) {
+      rc = SCR_FAILURE;
+    }
+    scr_free(&ref_path);
+    if (rc != SCR_SUCCESS) {
+      break;
+    }
+    total += (unsigned long) nread;
+  }
+
+  if (scr_close(file, fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  scr_free(&buf);
+
+  /* check that we got the whole file back */
+  if (rc == SCR_SUCCESS && total != scr_dedup_size(manifest)) {
+    scr_err("Restored %lu bytes of %s but expected %lu @ %s:%d",
+      total, file, scr_dedup_size(manifest), __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  if (rc != SCR_SUCCESS) {
+    unlink(file);
+  }
+  return rc;
+}
+
+int scr_dedup_release(const kvtree* manifest)
+{
+  int rc = SCR_SUCCESS;
+
+  unsigned long count = scr_dedup_count(manifest);
+  unsigned long i;
+  for (i = 0; i < count; i++) {
+    char* block_path = NULL;
+    char* ref_path = scr_dedup_manifest_ref(manifest, i, &block_path);
+    if (ref_path == NULL) {
+      rc = SCR_FAILURE;
+      continue;
+    }
+
+    /* drop our reference */
+    if (unlink(ref_path) != 0 && errno != ENOENT) {
+      scr_err("Failed to delete block reference %s errno=%d %s @ %s:%d",
+        ref_path, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+
+    /* delete the block once only its own name refers to it */
+    struct stat statbuf;
+    if (stat(block_path, &statbuf) == 0 && statbuf.st_nlink == 1) {
+      unlink(block_path);
+    }
+
+    scr_free(&block_path);
+    scr_free(&ref_path);
+  }
+
+  return rc;
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_DEDUP_H
+#define SCR_DEDUP_H
+
+#include "kvtree.h"
+
+/*
+=========================================
+This file defines a content-addressed block store used to keep
+identical blocks of cached files only once.  A file is split into
+fixed-size blocks, each unique block is stored once in the store
+directory under the name of its hash, and the file is replaced by a
+manifest listing its blocks.  Each file holds a hard link to every
+block it references, so the link count of a block is its reference
+count and a block is deleted once no file refers to it.
+=========================================
+*/
+
+/* split file into blocks of block_size bytes, store each block in
+ * store_dir unless an identical block is already there, and record the
+ * blocks in manifest, refname must be unique among the files sharing
+ * store_dir, file is deleted on success */
+int scr_dedup_file(
+  const char* store_dir,
+  const char* file,
+  const char* refname,
+  unsigned long block_size,
+  kvtree* manifest
+);
+
+/* returns 1 if every block listed in manifest exists, 0 otherwise */
+int scr_dedup_check(const kvtree* manifest);
+
+/* returns size of file listed in manifest */
+unsigned long scr_dedup_size(const kvtree* manifest);
+
+/* write the contents of the file listed in manifest to file */
+int scr_dedup_write(const kvtree* manifest, const char* file);
+
+/* drop references held by manifest, deleting any blocks that are
+ * no longer referenced */
+int scr_dedup_release(const kvtree* manifest);
+
+#endif
@@ -0,0 +1,454 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+/* Implements block-level delta files for flush and fetch.
+ * A delta file is a header followed by a sequence of records,
+ * each record is the index of a changed block followed by the
+ * contents of that block in the new file. */
+
+#include "scr_conf.h"
+#include "scr.h"
+#include "scr_err.h"
+#include "scr_io.h"
+#include "scr_util.h"
+#include "scr_checksum.h"
+#include "scr_delta.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+
+/* magic string at the start of each delta file */
+#define SCR_DELTA_MAGIC   ("SCRD")
+#define SCR_DELTA_VERSION (1)
+
+/* header is magic, version, block size, file size, and number of
+ * changed blocks, all integers are stored in big-endian order */
+#define SCR_DELTA_HEADER_SIZE (32)
+
+/* limit block size to bound memory usage */
+#define SCR_DELTA_MAX_BLOCK (1024*1024*1024)
+
+/* encode value as 8 bytes in big-endian order */
+static void scr_delta_pack64(unsigned char* buf, uint64_t value)
+{
+  int i;
+  for (i = 7; i >= 0; i--) {
+    buf[i] = (unsigned char) (value & 0xff);
+    value >>= 8;
+  }
+}
+
+/* decode 8 bytes in big-endian order */
+static uint64_t scr_delta_unpack64(const unsigned char* buf)
+{
+  uint64_t value = 0;
+  int i;
+  for (i = 0; i < 8; i++) {
+    value = (value << 8) | (uint64_t) buf[i];
+  }
+  return value;
+}
+
+/* compute the hash of a single block */
+static uint64_t scr_delta_hash_block(const void* buf, size_t size)
+{
+  scr_checksum c;
+  scr_checksum_init(&c, SCR_CHECKSUM_XXH64);
+  scr_checksum_update(&c, buf, size);
+  return scr_checksum_final(&c);
+}
+
+/* return length of block index in a file of size bytes */
+static unsigned long scr_delta_block_len(
+  unsigned long index, unsigned long block_size, unsigned long size)
+{
+  unsigned long offset = index * block_size;
+  if (offset >= size) {
+    return 0;
+  }
+  unsigned long remaining = size - offset;
+  return (remaining < block_size) ? remaining : block_size;
+}
+
+/* check that block_size is usable and allocate a buffer for one block */
+static char* scr_delta_alloc_block(unsigned long block_size)
+{
+  if (block_size == 0 || block_size > SCR_DELTA_MAX_BLOCK) {
+    scr_err("Invalid delta block size %lu @ %s:%d",
+      block_size, __FILE__, __LINE__
+    );
+    return NULL;
+  }
+
+  char* buf = (char*) malloc((size_t) block_size);
+  if (buf == NULL) {
+    scr_err("Allocating memory: malloc(%lu) errno=%d %s @ %s:%d",
+      block_size, errno, strerror(errno), __FILE__, __LINE__
+    );
+  }
+  return buf;
+}
+
+int scr_delta_hash_file(
+  const char* file,
+  unsigned long block_size,
+  uint64_t** hashes,
+  unsigned long* count,
+  unsigned long* size)
+{
+  *hashes = NULL;
+  *count  = 0;
+  *size   = 0;
+
+  /* get size of file to know how many hashes we'll have */
+  unsigned long filesize = scr_file_size(file);
+
+  char* buf = scr_delta_alloc_block(block_size);
+  if (buf == NULL) {
+    return SCR_FAILURE;
+  }
+
+  /* open file for reading */
+  int fd = scr_open(file, O_RDONLY);
+  if (fd < 0) {
+    scr_err("Opening file to hash: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_free(&buf);
+    return SCR_FAILURE;
+  }
+
+#if !defined(__APPLE__)
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  /* allocate one hash per block, the file could grow while we read */
+  unsigned long max = (filesize + block_size - 1) / block_size;
+  uint64_t* list = NULL;
+  if (max > 0) {
+    list = (uint64_t*) SCR_MALLOC(max * sizeof(uint64_t));
+  }
+
+  int rc = SCR_SUCCESS;
+  unsigned long n = 0;
+  unsigned long total = 0;
+  while (n < max) {
+    ssize_t nread = scr_read_attempt(file, fd, buf, (size_t) block_size);
+    if (nread < 0) {
+      rc = SCR_FAILURE;
+      break;
+    }
+    if (nread == 0) {
+      break;
+    }
+
+    list[n] = scr_delta_hash_block(buf, (size_t) nread);
+    total  += (unsigned long) nread;
+    n++;
+
+    /* assume a short read means we hit the end of the file */
+    if ((unsigned long) nread < block_size) {
+      break;
+    }
+  }
+
+  scr_close(file, fd);
+  scr_free(&buf);
+
+  /* the file changed size while we read it, so the hashes are no good */
+  if (rc == SCR_SUCCESS && total != filesize) {
+    scr_err("File %s changed size while hashing @ %s:%d",
+      file, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  if (rc != SCR_SUCCESS) {
+    scr_free(&list);
+    return rc;
+  }
+
+  *hashes = list;
+  *count  = n;
+  *size   = total;
+  return SCR_SUCCESS;
+}
+
+int scr_delta_write(
+  const char* src_file,
+  const char* dst_file,
+  unsigned long block_size,
+  const uint64_t* base_hashes,
+  unsigned long base_count,
+  unsigned long base_size,
+  unsigned long* moved)
+{
+  char* buf = scr_delta_alloc_block(block_size);
+  if (buf == NULL) {
+    return SCR_FAILURE;
+  }
+
+  /* open src_file for reading */
+  int src_fd = scr_open(src_file, O_RDONLY);
+  if (src_fd < 0) {
+    scr_err("Opening file to copy: scr_open(%s) errno=%d %s @ %s:%d",
+      src_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_free(&buf);
+    return SCR_FAILURE;
+  }
+
+  /* open dst_file for writing */
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int dst_fd = scr_open(dst_file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (dst_fd < 0) {
+    scr_err("Opening file for writing: scr_open(%s) errno=%d %s @ %s:%d",
+      dst_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_close(src_file, src_fd);
+    scr_free(&buf);
+    return SCR_FAILURE;
+  }
+
+#if !defined(__APPLE__)
+  posix_fadvise(src_fd, 0, 0, POSIX_FADV_DONTNEED | POSIX_FADV_SEQUENTIAL);
+  posix_fadvise(dst_fd, 0, 0, POSIX_FADV_DONTNEED | POSIX_FADV_SEQUENTIAL);
+#endif
+
+  int rc = SCR_SUCCESS;
+
+  /* leave room for the header, we fill it in once we know the counts */
+  unsigned char header[SCR_DELTA_HEADER_SIZE];
+  memset(header, 0, sizeof(header));
+  if (scr_write_attempt(dst_file, dst_fd, header, sizeof(header)) != sizeof(header)) {
+    rc = SCR_FAILURE;
+  }
+
+  /* read the file one block at a time, writing only changed blocks */
+  unsigned long index    = 0;
+  unsigned long total    = 0;
+  unsigned long nchanged = 0;
+  unsigned long written  = sizeof(header);
+  int copying = (rc == SCR_SUCCESS);
+  while (copying) {
+    ssize_t nread = scr_read_attempt(src_file, src_fd, buf, (size_t) block_size);
+    if (nread < 0) {
+      rc = SCR_FAILURE;
+      break;
+    }
+
+    if (nread > 0) {
+      /* a block is unchanged only if the base has a block of the
+       * same length at this position with the same hash */
+      int changed = 1;
+      if (index < base_count &&
+          scr_delta_block_len(index, block_size, base_size) == (unsigned long) nread &&
+          scr_delta_hash_block(buf, (size_t) nread) == base_hashes[index])
+      {
+        changed = 0;
+      }
+
+      if (changed) {
+        /* write block index followed by block data */
+        unsigned char rec[8];
+        scr_delta_pack64(rec, (uint64_t) index);
+        if (scr_write_attempt(dst_file, dst_fd, rec, sizeof(rec)) != sizeof(rec) ||
+            scr_write_attempt(dst_file, dst_fd, buf, (size_t) nread) != nread)
+        {
+          rc = SCR_FAILURE;
+          break;
+        }
+        written += sizeof(rec) + (unsigned long) nread;
+        nchanged++;
+      }
+
+      total += (unsigned long) nread;
+      index++;
+    }
+
+    /* assume a short read means we hit the end of the file */
+    if ((unsigned long) nread < block_size) {
+      copying = 0;
+    }
+  }
+
+  /* now fill in the header */
+  if (rc == SCR_SUCCESS) {
+    memcpy(header, SCR_DELTA_MAGIC, 4);
+    header[7] = (unsigned char) SCR_DELTA_VERSION;
+    scr_delta_pack64(&header[8],  (uint64_t) block_size);
+    scr_delta_pack64(&header[16], (uint64_t) total);
+    scr_delta_pack64(&header[24], (uint64_t) nchanged);
+    if (pwrite(dst_fd, header, sizeof(header), 0) != sizeof(header)) {
+      scr_err("Writing delta header: pwrite(%s) errno=%d %s @ %s:%d",
+        dst_file, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+  }
+
+  scr_free(&buf);
+
+  /* close source and destination files */
+  if (scr_close(dst_file, dst_fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  if (scr_close(src_file, src_fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+
+  /* delete the destination if anything went wrong */
+  if (rc != SCR_SUCCESS) {
+    scr_err("Failed to write delta of %s to %s @ %s:%d",
+      src_file, dst_file, __FILE__, __LINE__
+    );
+    unlink(dst_file);
+    return rc;
+  }
+
+  scr_dbg(2, "Wrote %lu of %lu blocks of %s to %s",
+    nchanged, index, src_file, dst_file
+  );
+
+  if (moved != NULL) {
+    *moved = written;
+  }
+  return SCR_SUCCESS;
+}
+
+int scr_delta_apply(
+  const char* base_file,
+  const char* delta_file,
+  const char* dst_file,
+  unsigned long buf_size,
+  unsigned long* size)
+{
+  /* open delta file and read its header */
+  int delta_fd = scr_open(delta_file, O_RDONLY);
+  if (delta_fd < 0) {
+    scr_err("Opening delta file: scr_open(%s) errno=%d %s @ %s:%d",
+      delta_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  unsigned char header[SCR_DELTA_HEADER_SIZE];
+  if (scr_read_attempt(delta_file, delta_fd, header, sizeof(header)) != sizeof(header) ||
+      memcmp(header, SCR_DELTA_MAGIC, 4) != 0 ||
+      header[7] != (unsigned char) SCR_DELTA_VERSION)
+  {
+    scr_err("Invalid delta file header in %s @ %s:%d",
+      delta_file, __FILE__, __LINE__
+    );
+    scr_close(delta_file, delta_fd);
+    return SCR_FAILURE;
+  }
+  unsigned long block_size = (unsigned long) scr_delta_unpack64(&header[8]);
+  unsigned long filesize   = (unsigned long) scr_delta_unpack64(&header[16]);
+  unsigned long nchanged   = (unsigned long) scr_delta_unpack64(&header[24]);
+
+  char* buf = scr_delta_alloc_block(block_size);
+  if (buf == NULL) {
+    scr_close(delta_file, delta_fd);
+    return SCR_FAILURE;
+  }
+
+  /* start with a copy of the base file */
+  if (scr_file_copy(base_file, dst_file, buf_size, NULL) != SCR_SUCCESS) {
+    scr_err("Failed to copy base file %s to %s @ %s:%d",
+      base_file, dst_file, __FILE__, __LINE__
+    );
+    scr_free(&buf);
+    scr_close(delta_file, delta_fd);
+    return SCR_FAILURE;
+  }
+
+  /* open the copy to overwrite changed blocks */
+  int dst_fd = scr_open(dst_file, O_WRONLY);
+  if (dst_fd < 0) {
+    scr_err("Opening file for writing: scr_open(%s) errno=%d %s @ %s:%d",
+      dst_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_free(&buf);
+    scr_close(delta_file, delta_fd);
+    unlink(dst_file);
+    return SCR_FAILURE;
+  }
+
+  int rc = SCR_SUCCESS;
+
+  /* set the file to its new size, this drops any blocks past the end
+   * and zero fills any space that the delta will write into */
+  if (ftruncate(dst_fd, (off_t) filesize) != 0) {
+    scr_err("Failed to truncate file: ftruncate(%s, %lu) errno=%d %s @ %s:%d",
+      dst_file, filesize, errno, strerror(errno), __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  /* write each changed block into place */
+  unsigned long i;
+  for (i = 0; i < nchanged && rc == SCR_SUCCESS; i++) {
+    unsigned char rec[8];
+    if (scr_read_attempt(delta_file, delta_fd, rec, sizeof(rec)) != sizeof(rec)) {
+      rc = SCR_FAILURE;
+      break;
+    }
+
+    unsigned long index = (unsigned long) scr_delta_unpack64(rec);
+    unsigned long len = scr_delta_block_len(index, block_size, filesize);
+    if (len == 0) {
+      scr_err("Invalid block %lu in delta file %s @ %s:%d",
+        index, delta_file, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+      break;
+    }
+
+    if (scr_read_attempt(delta_file, delta_fd, buf, (size_t) len) != (ssize_t) len) {
+      rc = SCR_FAILURE;
+      break;
+    }
+
+    off_t offset = (off_t) index * (off_t) block_size;
+    if (pwrite(dst_fd, buf, (size_t) len, offset) != (ssize_t) len) {
+      scr_err("Writing block: pwrite(%s) errno=%d %s @ %s:%d",
+        dst_file, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+  }
+
+  scr_free(&buf);
+
+  if (scr_close(dst_file, dst_fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  scr_close(delta_file, delta_fd);
+
+  if (rc != SCR_SUCCESS) {
+    scr_err("Failed to apply delta %s to %s @ %s:%d",
+      delta_file, base_file, __FILE__, __LINE__
+    );
+    unlink(dst_file);
+    return rc;
+  }
+
+  if (size != NULL) {
+    *size = filesize;
+  }
+  return SCR_SUCCESS;
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_DELTA_H
+#define SCR_DELTA_H
+
+#include <stdint.h>
+
+/*
+=========================================
+This file defines functions to write a file as a delta against an
+earlier version of the same file.  The file is split into fixed-size
+blocks and each block is hashed.  A delta file records the size of
+the new file and holds only those blocks whose hash differs from the
+corresponding block of the base file.
+=========================================
+*/
+
+/* split file into blocks of block_size bytes and compute a hash of each,
+ * returns newly allocated array of count hashes that caller must free,
+ * and the size of the file */
+int scr_delta_hash_file(
+  const char* file,
+  unsigned long block_size,
+  uint64_t** hashes,
+  unsigned long* count,
+  unsigned long* size
+);
+
+/* write blocks of src_file that differ from a base file of base_size bytes
+ * with the given block hashes into dst_file, returns the number of bytes
+ * written to dst_file in moved */
+int scr_delta_write(
+  const char* src_file,
+  const char* dst_file,
+  unsigned long block_size,
+  const uint64_t* base_hashes,
+  unsigned long base_count,
+  unsigned long base_size,
+  unsigned long* moved
+);
+
+/* rebuild dst_file by copying base_file and then applying the blocks
+ * recorded in delta_file, returns the size of the rebuilt file */
+int scr_delta_apply(
+  const char* base_file,
+  const char* delta_file,
+  const char* dst_file,
+  unsigned long buf_size,
+  unsigned long* size
+);
+
+#endif
@@ -0,0 +1,669 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#include "scr_globals.h"
+
+#include "spath.h"
+
+#include <pthread.h>
+#include <time.h>
+#include <dirent.h>
+
+/* name of file written to the top of the drain store once all files
+ * of a dataset are there, it records the id of that dataset */
+#define SCR_DRAIN_MARKER "drained.scr"
+#define SCR_DRAIN_KEY_ID "ID"
+
+/* tracks background thread that copies files for one hop */
+typedef struct {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  int     active;       /* whether the thread was started and not yet joined */
+  int     done;         /* set by the thread once all files are written */
+  int     stop;         /* set to ask the thread to give up early */
+  int     rc;           /* return code from copying files */
+  int     count;        /* number of files to copy */
+  char**  src_filelist; /* list of files to read */
+  char**  dst_filelist; /* list of files to write */
+  double  bw;           /* bandwidth limit in bytes/sec, 0 for none */
+  double  bytes;        /* number of bytes copied */
+} scr_drain_hop_t;
+
+static scr_drain_hop_t scr_drain_hop = {
+  .lock   = PTHREAD_MUTEX_INITIALIZER,
+  .active = 0,
+};
+
+static char* scr_drain_base = NULL; /* mirror of root directory on the drain store */
+
+static int    scr_drain_stage = 0;            /* 0 when idle, otherwise the hop in progress */
+static int    scr_drain_rc    = SCR_SUCCESS;  /* whether any hop has failed */
+static int    scr_drain_id    = -1;           /* id of dataset being drained */
+static int    scr_drain_count = 0;            /* number of files in lists below */
+static char** scr_drain_src_filelist = NULL;  /* files in cache */
+static char** scr_drain_mid_filelist = NULL;  /* files on the drain store */
+static char** scr_drain_dst_filelist = NULL;  /* files in prefix directory */
+
+/* copy of the most recent dataset drained by this run */
+static int    scr_drain_kept_id       = -1;
+static int    scr_drain_kept_count    = 0;
+static char** scr_drain_kept_filelist = NULL;
+
+/* free a list of count file names */
+static void scr_drain_list_free(int count, char*** ptr_filelist)
+{
+  char** filelist = *ptr_filelist;
+  if (filelist != NULL) {
+    int i;
+    for (i = 0; i < count; i++) {
+      scr_free(&filelist[i]);
+    }
+  }
+  scr_free(ptr_filelist);
+}
+
+/* returns newly allocated path of the directory holding the copy
+ * of the given dataset on the drain store */
+static char* scr_drain_dir(int id)
+{
+  return scr_strdupf("%s/scr.dataset.%d", scr_drain_base, id);
+}
+
+/* returns newly allocated path of the marker file */
+static char* scr_drain_marker(void)
+{
+  return scr_strdupf("%s/%s", scr_drain_base, SCR_DRAIN_MARKER);
+}
+
+/* returns the id of the dataset the marker records as drained,
+ * or -1 if there is none, only called by rank 0 */
+static int scr_drain_marker_read(void)
+{
+  int id = -1;
+  char* marker = scr_drain_marker();
+  if (scr_file_exists(marker) == SCR_SUCCESS) {
+    kvtree* hash = kvtree_new();
+    if (kvtree_read_file(marker, hash) != KVTREE_SUCCESS ||
+        kvtree_util_get_int(hash, SCR_DRAIN_KEY_ID, &id) != KVTREE_SUCCESS)
+    {
+      id = -1;
+    }
+    kvtree_delete(&hash);
+  }
+  scr_free(&marker);
+  return id;
+}
+
+/* record id as the dataset held on the drain store, the marker is
+ * replaced with a rename so it never names a partial copy,
+ * only called by rank 0 */
+static int scr_drain_marker_write(int id)
+{
+  int rc = SCR_SUCCESS;
+  char* marker = scr_drain_marker();
+  char* tmp = scr_strdupf("%s.tmp", marker);
+
+  kvtree* hash = kvtree_new();
+  kvtree_util_set_int(hash, SCR_DRAIN_KEY_ID, id);
+  if (kvtree_write_file(tmp, hash) != KVTREE_SUCCESS ||
+      rename(tmp, marker) != 0)
+  {
+    scr_err("Failed to write drain marker %s @ %s:%d",
+      marker, __FILE__, __LINE__
+    );
+    scr_file_unlink(tmp);
+    rc = SCR_FAILURE;
+  }
+  kvtree_delete(&hash);
+
+  scr_free(&tmp);
+  scr_free(&marker);
+  return rc;
+}
+
+/* remove dir and everything below it */
+static void scr_drain_remove_tree(const char* dir)
+{
+  DIR* dirp = opendir(dir);
+  if (dirp == NULL) {
+    return;
+  }
+
+  struct dirent* de;
+  while ((de = readdir(dirp)) != NULL) {
+    if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+      continue;
+    }
+
+    char* path = scr_strdupf("%s/%s", dir, de->d_name);
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+      scr_drain_remove_tree(path);
+    } else {
+      scr_file_unlink(path);
+    }
+    scr_free(&path);
+  }
+  closedir(dirp);
+
+  scr_rmdir(dir);
+}
+
+/* remove copies of datasets on the drain store other than the one
+ * the marker names, these are left by runs that ended before they
+ * replaced their previous copy or finished their first hop,
+ * only called by rank 0 */
+static void scr_drain_remove_stale(void)
+{
+  int kept = scr_drain_marker_read();
+
+  DIR* dirp = opendir(scr_drain_base);
+  if (dirp == NULL) {
+    return;
+  }
+
+  struct dirent* de;
+  while ((de = readdir(dirp)) != NULL) {
+    int id;
+    char extra;
+    if (sscanf(de->d_name, "scr.dataset.%d%c", &id, &extra) != 1 || id == kept) {
+      continue;
+    }
+
+    char* dir = scr_drain_dir(id);
+    scr_dbg(1, "Removing stale copy of dataset %d from drain store: %s", id, dir);
+    scr_drain_remove_tree(dir);
+    scr_free(&dir);
+  }
+  closedir(dirp);
+}
+
+/* look up the drain store named by SCR_DRAIN_STORE, drain is disabled
+ * if it is not set or does not name a global store */
+int scr_drain_init(void)
+{
+  scr_free(&scr_drain_base);
+
+  if (scr_drain_store == NULL) {
+    return SCR_SUCCESS;
+  }
+
+  /* lookup the store descriptor */
+  int index = scr_storedescs_index_from_name(scr_drain_store);
+  if (index < 0) {
+    if (scr_my_rank_world == 0) {
+      scr_err("SCR_DRAIN_STORE %s is not a configured store, drain disabled @ %s:%d",
+        scr_drain_store, __FILE__, __LINE__
+      );
+    }
+    return SCR_FAILURE;
+  }
+
+  /* every process must see the same files, so the store must be global */
+  const scr_storedesc* store = &scr_storedescs[index];
+  if (strcmp(store->view, "GLOBAL") != 0) {
+    if (scr_my_rank_world == 0) {
+      scr_err("SCR_DRAIN_STORE %s must have a GLOBAL view, drain disabled @ %s:%d",
+        scr_drain_store, __FILE__, __LINE__
+      );
+    }
+    return SCR_FAILURE;
+  }
+
+  /* files are mirrored by their full paths under a directory for this user */
+  spath* path = spath_from_str(store->name);
+  spath_append_str(path, scr_username);
+  spath_append_str(path, "scr.drain");
+  spath_reduce(path);
+  scr_drain_base = spath_strdup(path);
+  spath_delete(&path);
+
+  /* only the dataset recorded in the marker is worth keeping */
+  if (scr_my_rank_world == 0) {
+    scr_drain_remove_stale();
+  }
+
+  return SCR_SUCCESS;
+}
+
+/* free resources held for the drain */
+int scr_drain_finalize(void)
+{
+  scr_drain_stop();
+
+  /* the kept copy stays on the drain store for a later run,
+   * which removes it once it drains a newer dataset */
+  scr_drain_list_free(scr_drain_kept_count, &scr_drain_kept_filelist);
+  scr_drain_kept_count = 0;
+  scr_drain_kept_id    = -1;
+
+  scr_free(&scr_drain_base);
+  return SCR_SUCCESS;
+}
+
+/* returns 1 if datasets should be staged through the drain store */
+int scr_drain_enabled(void)
+{
+  return (scr_drain_base != NULL);
+}
+
+/* returns newly allocated path of the copy of file of dataset id
+ * on the drain store, file must be an absolute path */
+char* scr_drain_path(int id, const char* file)
+{
+  char* dir = scr_drain_dir(id);
+  spath* path = spath_from_str(file);
+  spath_prepend_str(path, dir);
+  spath_reduce(path);
+  scr_free(&dir);
+  char* str = spath_strdup(path);
+  spath_delete(&path);
+  return str;
+}
+
+/* returns a monotonic time in seconds, safe to call from the copy thread */
+static double scr_drain_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec / 1.0e9;
+}
+
+/* copy src to dst, sleeping as needed to keep the bytes copied
+ * by this hop since start under its bandwidth limit */
+static int scr_drain_copy(scr_drain_hop_t* h, const char* src, const char* dst, char* buf, double start)
+{
+  int rc = SCR_SUCCESS;
+
+  /* create the directory to hold the file */
+  spath* dir = spath_from_str(dst);
+  spath_dirname(dir);
+  char* dir_str = spath_strdup(dir);
+  spath_delete(&dir);
+  mode_t mode_dir = scr_getmode(1, 1, 1);
+  if (scr_mkdir(dir_str, mode_dir) != SCR_SUCCESS) {
+    scr_err("Failed to create directory %s @ %s:%d",
+      dir_str, __FILE__, __LINE__
+    );
+    scr_free(&dir_str);
+    return SCR_FAILURE;
+  }
+  scr_free(&dir_str);
+
+  int fd_src = scr_open(src, O_RDONLY);
+  if (fd_src < 0) {
+    scr_err("Opening file to copy: scr_open(%s) errno=%d %s @ %s:%d",
+      src, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int fd_dst = scr_open(dst, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (fd_dst < 0) {
+    scr_err("Opening file for write: scr_open(%s) errno=%d %s @ %s:%d",
+      dst, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_close(src, fd_src);
+    return SCR_FAILURE;
+  }
+
+  while (1) {
+    /* give up if we've been asked to stop */
+    pthread_mutex_lock(&h->lock);
+    int stop = h->stop;
+    pthread_mutex_unlock(&h->lock);
+    if (stop) {
+      rc = SCR_FAILURE;
+      break;
+    }
+
+    ssize_t nread = scr_read(src, fd_src, buf, scr_file_buf_size);
+    if (nread < 0) {
+      rc = SCR_FAILURE;
+      break;
+    }
+    if (nread == 0) {
+      break;
+    }
+
+    ssize_t nwrite = scr_write(dst, fd_dst, buf, (size_t) nread);
+    if (nwrite != nread) {
+      rc = SCR_FAILURE;
+      break;
+    }
+    h->bytes += (double) nwrite;
+
+    /* sleep until the time the limit allows for the bytes copied so far */
+    if (h->bw > 0.0) {
+      double wait = h->bytes / h->bw - (scr_drain_seconds() - start);
+      if (wait > 0.0) {
+        usleep((useconds_t) (wait * 1.0e6));
+      }
+    }
+  }
+
+  if (scr_close(dst, fd_dst) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  scr_close(src, fd_src);
+
+  return rc;
+}
+
+/* copy files for one hop in the background */
+static void* scr_drain_thread(void* arg)
+{
+  scr_drain_hop_t* h = (scr_drain_hop_t*) arg;
+
+  int rc = SCR_SUCCESS;
+  char* buf = (char*) malloc(scr_file_buf_size);
+  if (buf == NULL) {
+    scr_err("Failed to allocate buffer to copy files @ %s:%d",
+      __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  double start = scr_drain_seconds();
+  int i;
+  for (i = 0; i < h->count && rc == SCR_SUCCESS; i++) {
+    rc = scr_drain_copy(h, h->src_filelist[i], h->dst_filelist[i], buf, start);
+  }
+  scr_free(&buf);
+
+  pthread_mutex_lock(&h->lock);
+  h->rc   = rc;
+  h->done = 1;
+  pthread_mutex_unlock(&h->lock);
+
+  return NULL;
+}
+
+/* start thread to copy files for one hop */
+static int scr_drain_hop_start(int count, char** src_filelist, char** dst_filelist, double bw, MPI_Comm comm)
+{
+  scr_drain_hop_t* h = &scr_drain_hop;
+  h->done         = 0;
+  h->stop         = 0;
+  h->rc           = SCR_SUCCESS;
+  h->count        = count;
+  h->src_filelist = src_filelist;
+  h->dst_filelist = dst_filelist;
+  h->bw           = bw;
+  h->bytes        = 0.0;
+
+  int rc = SCR_SUCCESS;
+  if (pthread_create(&h->thread, NULL, scr_drain_thread, h) == 0) {
+    h->active = 1;
+  } else {
+    scr_err("Failed to create thread to drain files @ %s:%d",
+      __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  /* if any process failed to start, stop the others */
+  if (! scr_alltrue(rc == SCR_SUCCESS, comm)) {
+    if (h->active) {
+      pthread_mutex_lock(&h->lock);
+      h->stop = 1;
+      pthread_mutex_unlock(&h->lock);
+      pthread_join(h->thread, NULL);
+      h->active = 0;
+    }
+    return SCR_FAILURE;
+  }
+
+  return SCR_SUCCESS;
+}
+
+/* join the thread of the current hop and record whether all processes succeeded */
+static void scr_drain_hop_finish(MPI_Comm comm)
+{
+  scr_drain_hop_t* h = &scr_drain_hop;
+
+  int rc = SCR_FAILURE;
+  if (h->active) {
+    pthread_join(h->thread, NULL);
+    h->active = 0;
+    rc = h->rc;
+  }
+
+  if (! scr_alltrue(rc == SCR_SUCCESS, comm)) {
+    scr_drain_rc = SCR_FAILURE;
+  }
+}
+
+/* delete our copies of files on the drain store */
+static void scr_drain_unlink(int count, char** filelist)
+{
+  int i;
+  for (i = 0; i < count; i++) {
+    scr_file_unlink(filelist[i]);
+  }
+}
+
+/* free the lists of the current drain and return to idle */
+static void scr_drain_free(void)
+{
+  scr_drain_list_free(scr_drain_count, &scr_drain_src_filelist);
+  scr_drain_list_free(scr_drain_count, &scr_drain_mid_filelist);
+  scr_drain_list_free(scr_drain_count, &scr_drain_dst_filelist);
+  scr_drain_count = 0;
+  scr_drain_id    = -1;
+  scr_drain_stage = 0;
+}
+
+/* once all processes have their files on the drain store,
+ * record this copy in the marker, remove the copy of the dataset the
+ * marker named before, and start copying to the prefix directory */
+static void scr_drain_second_hop(MPI_Comm comm)
+{
+  /* mark that the drain store now holds a complete copy of this dataset */
+  int info[2] = {SCR_SUCCESS, -1};
+  if (scr_my_rank_world == 0) {
+    info[1] = scr_drain_marker_read();
+    info[0] = scr_drain_marker_write(scr_drain_id);
+  }
+  MPI_Bcast(info, 2, MPI_INT, 0, comm);
+  int rc     = info[0];
+  int old_id = info[1];
+
+  /* delete our files of the copy we kept from our last drain,
+   * unless the marker still names it */
+  if (rc == SCR_SUCCESS && scr_drain_kept_id >= 0 && scr_drain_kept_id != scr_drain_id) {
+    scr_drain_unlink(scr_drain_kept_count, scr_drain_kept_filelist);
+  }
+  MPI_Barrier(comm);
+
+  /* and remove what is left of that copy and of the one the marker
+   * named, which may have been drained by an earlier run */
+  if (scr_my_rank_world == 0 && rc == SCR_SUCCESS) {
+    int ids[2] = {scr_drain_kept_id, old_id};
+    int i;
+    for (i = 0; i < 2; i++) {
+      if (ids[i] >= 0 && ids[i] != scr_drain_id && (i == 0 || ids[1] != ids[0])) {
+        char* dir = scr_drain_dir(ids[i]);
+        scr_drain_remove_tree(dir);
+        scr_free(&dir);
+      }
+    }
+  }
+  scr_drain_list_free(scr_drain_kept_count, &scr_drain_kept_filelist);
+
+  /* keep this copy until the next drain replaces it */
+  scr_drain_kept_id       = scr_drain_id;
+  scr_drain_kept_count    = scr_drain_count;
+  scr_drain_kept_filelist = scr_drain_mid_filelist;
+  scr_drain_mid_filelist  = NULL;
+
+  if (rc == SCR_SUCCESS) {
+    scr_flush_file_location_set(scr_drain_id, SCR_FLUSH_KEY_LOCATION_DRAIN);
+    if (scr_my_rank_world == 0) {
+      scr_dbg(1, "Drained dataset %d to %s", scr_drain_id, scr_drain_store);
+    }
+  }
+
+  /* copy the files on to the prefix directory */
+  scr_drain_stage = 2;
+  if (scr_drain_hop_start(scr_drain_kept_count, scr_drain_kept_filelist,
+    scr_drain_dst_filelist, scr_drain_flush_bw, comm) != SCR_SUCCESS)
+  {
+    scr_drain_rc = SCR_FAILURE;
+  }
+}
+
+/* start copying count files in src_filelist to their copies on the drain
+ * store and then on to dst_filelist, takes ownership of the file lists */
+int scr_drain_start(
+  int id,
+  int count,
+  char** src_filelist,
+  char** dst_filelist,
+  MPI_Comm comm)
+{
+  /* build list of files on the drain store */
+  char** mid_filelist = NULL;
+  if (count > 0) {
+    mid_filelist = (char**) SCR_MALLOC(count * sizeof(char*));
+  }
+  int i;
+  for (i = 0; i < count; i++) {
+    mid_filelist[i] = scr_drain_path(id, dst_filelist[i]);
+  }
+
+  scr_drain_stage        = 1;
+  scr_drain_rc           = SCR_SUCCESS;
+  scr_drain_id           = id;
+  scr_drain_count        = count;
+  scr_drain_src_filelist = src_filelist;
+  scr_drain_mid_filelist = mid_filelist;
+  scr_drain_dst_filelist = dst_filelist;
+
+  /* copy files from cache to the drain store */
+  if (scr_drain_hop_start(count, src_filelist, mid_filelist, scr_drain_bw, comm) != SCR_SUCCESS) {
+    scr_drain_free();
+    return SCR_FAILURE;
+  }
+
+  return SCR_SUCCESS;
+}
+
+/* returns 1 if a drain has been started and not yet waited on */
+int scr_drain_active(void)
+{
+  return (scr_drain_stage != 0);
+}
+
+/* returns SCR_SUCCESS if all processes have finished draining,
+ * starts the second hop once all processes finish the first */
+int scr_drain_test(MPI_Comm comm)
+{
+  if (! scr_drain_active()) {
+    return SCR_SUCCESS;
+  }
+
+  /* check whether the current hop is done everywhere */
+  scr_drain_hop_t* h = &scr_drain_hop;
+  if (h->active) {
+    pthread_mutex_lock(&h->lock);
+    int done = h->done;
+    pthread_mutex_unlock(&h->lock);
+
+    if (! scr_alltrue(done, comm)) {
+      return SCR_FAILURE;
+    }
+    scr_drain_hop_finish(comm);
+  }
+
+  /* the first hop finished, move on to the second */
+  if (scr_drain_stage == 1 && scr_drain_rc == SCR_SUCCESS) {
+    scr_drain_second_hop(comm);
+    if (h->active) {
+      return SCR_FAILURE;
+    }
+  }
+
+  return SCR_SUCCESS;
+}
+
+/* wait for both hops to finish, returns SCR_SUCCESS if all processes
+ * copied their files to the prefix directory */
+int scr_drain_wait(MPI_Comm comm)
+{
+  if (! scr_drain_active()) {
+    return SCR_FAILURE;
+  }
+
+  scr_drain_hop_t* h = &scr_drain_hop;
+  if (h->active) {
+    scr_drain_hop_finish(comm);
+  }
+
+  if (scr_drain_stage == 1 && scr_drain_rc == SCR_SUCCESS) {
+    scr_drain_second_hop(comm);
+    if (h->active) {
+      scr_drain_hop_finish(comm);
+    }
+  }
+
+  /* remove any partial copy left on the drain store by a failed first hop */
+  if (scr_drain_stage == 1) {
+    scr_drain_unlink(scr_drain_count, scr_drain_mid_filelist);
+  }
+
+  int rc = scr_drain_rc;
+  scr_drain_free();
+  return rc;
+}
+
+/* stop an ongoing drain and drop its results */
+int scr_drain_stop(void)
+{
+  scr_drain_hop_t* h = &scr_drain_hop;
+  if (h->active) {
+    pthread_mutex_lock(&h->lock);
+    h->stop = 1;
+    pthread_mutex_unlock(&h->lock);
+    pthread_join(h->thread, NULL);
+    h->active = 0;
+  }
+
+  /* a copy still in its first hop is incomplete, so delete it */
+  if (scr_drain_stage == 1) {
+    scr_drain_unlink(scr_drain_count, scr_drain_mid_filelist);
+  }
+  if (scr_drain_active()) {
+    scr_drain_free();
+  }
+
+  return SCR_SUCCESS;
+}
+
+/* returns 1 on all processes if the drain store holds a complete copy
+ * of the dataset with the given id */
+int scr_drain_have(int id)
+{
+  if (! scr_drain_enabled()) {
+    return 0;
+  }
+
+  /* the marker only names the last dataset drained in full,
+   * a copy of any other dataset may be partial */
+  int have = 0;
+  if (scr_my_rank_world == 0) {
+    have = (scr_drain_marker_read() == id);
+  }
+  MPI_Bcast(&have, 1, MPI_INT, 0, scr_comm_world);
+
+  return have;
+}
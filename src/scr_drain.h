@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_DRAIN_H
+#define SCR_DRAIN_H
+
+#include "mpi.h"
+
+/*
+=========================================
+This file implements a staged drain of datasets from cache to the
+prefix directory through an intermediate store, such as a shared
+burst buffer.  An asynchronous flush first copies files from cache
+into a mirror of the prefix directory on the drain store, and once
+every process has its files there it copies them on to the prefix
+directory.  Each hop is paced to its own bandwidth limit.  Each
+dataset is copied to its own directory on the drain store.  The most
+recent complete copy is kept so that a restart can read from it
+instead of the parallel file system, and a marker file at the top of
+the drain store records its dataset id.  Copies of any other dataset
+are removed at the next drain or when SCR starts.
+=========================================
+*/
+
+/* look up the drain store named by SCR_DRAIN_STORE, drain is disabled
+ * if it is not set or does not name a global store */
+int scr_drain_init(void);
+
+/* free resources held for the drain */
+int scr_drain_finalize(void);
+
+/* returns 1 if datasets should be staged through the drain store */
+int scr_drain_enabled(void);
+
+/* returns newly allocated path of the copy of file of dataset id
+ * on the drain store, file must be an absolute path */
+char* scr_drain_path(int id, const char* file);
+
+/* start copying count files in src_filelist to their copies on the drain
+ * store and then on to dst_filelist, takes ownership of the file lists */
+int scr_drain_start(
+  int id,
+  int count,
+  char** src_filelist,
+  char** dst_filelist,
+  MPI_Comm comm
+);
+
+/* returns 1 if a drain has been started and not yet waited on */
+int scr_drain_active(void);
+
+/* returns SCR_SUCCESS if all processes have finished draining,
+ * starts the second hop once all processes finish the first */
+int scr_drain_test(MPI_Comm comm);
+
+/* wait for both hops to finish, returns SCR_SUCCESS if all processes
+ * copied their files to the prefix directory */
+int scr_drain_wait(MPI_Comm comm);
+
+/* stop an ongoing drain and drop its results */
+int scr_drain_stop(void);
+
+/* returns 1 on all processes if the drain store holds a complete copy
+ * of the dataset with the given id */
+int scr_drain_have(int id);
+
+#endif
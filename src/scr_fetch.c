@@ -32,6 +32,8 @@
 
 #include "scr_globals.h"
 
+#include <pthread.h>
+
 #include "spath.h"
 #include "kvtree.h"
 #include "kvtree_util.h"
@@ -54,7 +56,7 @@ Fetch functions
  *        - File data may exist as physical file on parallel file
  *          system or be encapsulated in a "container" (physical file
  *          that contains bytes for one or more application files)
- *        - Optionally check CRC32 values as files are read in
+ *        - Optionally verify checksums as files are read in
  *   6) If successful, stop, otherwise mark this checkpoint as bad
  *      and repeat #2
  */
@@ -149,13 +151,149 @@ cleanup:
   return rc;
 }
 
-/* fetch files from fetch_dir into cache_dir and update filemap */
+/* copy src_file to dst_file while computing the checksum of given
+ * type over the bytes as they go by, so the copy is verified without
+ * reading it back */
+static int scr_fetch_copy_checksum(
+  const char* src_file,
+  const char* dst_file,
+  int type,
+  uint64_t* value)
+{
+  /* the regular copy computes zlib crc32 on its own */
+  if (type == SCR_CHECKSUM_CRC32) {
+    uLong crc;
+    int rc = scr_file_copy(src_file, dst_file, scr_storedescs_buf_size(dst_file), &crc);
+    *value = (uint64_t) crc;
+    return rc;
+  }
+
+  scr_checksum c;
+  if (scr_checksum_init(&c, type) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+
+  int src_fd = scr_open(src_file, O_RDONLY);
+  if (src_fd < 0) {
+    scr_err("Opening file to copy: scr_open(%s) errno=%d %s @ %s:%d",
+      src_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int dst_fd = scr_open(dst_file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (dst_fd < 0) {
+    scr_err("Opening file for writing: scr_open(%s) errno=%d %s @ %s:%d",
+      dst_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_close(src_file, src_fd);
+    return SCR_FAILURE;
+  }
+
+  int rc = SCR_SUCCESS;
+  char* buf = (char*) SCR_MALLOC(scr_file_buf_size);
+  while (1) {
+    ssize_t nread = scr_read(src_file, src_fd, buf, scr_file_buf_size);
+    if (nread < 0) {
+      rc = SCR_FAILURE;
+      break;
+    }
+    if (nread == 0) {
+      break;
+    }
+    scr_checksum_update(&c, buf, (size_t) nread);
+    if (scr_write(dst_file, dst_fd, buf, (size_t) nread) != nread) {
+      rc = SCR_FAILURE;
+      break;
+    }
+  }
+  scr_free(&buf);
+
+  if (scr_close(dst_file, dst_fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  scr_close(src_file, src_fd);
+
+  *value = scr_checksum_final(&c);
+  return rc;
+}
+
+/* read a single file into dest_file, reading its byte range from a
+ * container, rebuilding it from its extents in a shared file, rebuilding
+ * it from a delta against base, or decompressing it as needed, a plain
+ * file is copied as is, if type is a valid
+ * checksum type the file must match value, which is checked on the
+ * stream for plain and crc32 compressed files */
+static int scr_fetch_file(
+  const char* read_file,
+  const char* dest_file,
+  int compress,
+  const char* base,
+  const char* container,
+  unsigned long offset,
+  unsigned long length,
+  const char* shared,
+  const kvtree* extents,
+  int type,
+  uint64_t value)
+{
+  int rc;
+  int verified = 0;
+  uint64_t computed = 0;
+  if (container != NULL) {
+    rc = scr_container_read(container, offset, length, dest_file);
+  } else if (shared != NULL) {
+    rc = scr_segment_read(shared, extents, dest_file);
+  } else if (base != NULL) {
+    rc = scr_delta_apply(base, read_file, dest_file, scr_file_buf_size, NULL);
+  } else if (compress < 0) {
+    return SCR_FAILURE;
+  } else if (compress != SCR_COMPRESS_NONE) {
+    uLong crc;
+    uLong* crc_ptr = (type == SCR_CHECKSUM_CRC32) ? &crc : NULL;
+    rc = scr_decompress_file(read_file, dest_file, compress, NULL, crc_ptr);
+    if (crc_ptr != NULL) {
+      computed = (uint64_t) crc;
+      verified = 1;
+    }
+  } else if (type >= 0) {
+    rc = scr_fetch_copy_checksum(read_file, dest_file, type, &computed);
+    verified = 1;
+  } else {
+    rc = scr_file_copy(read_file, dest_file, scr_storedescs_buf_size(dest_file), NULL);
+  }
+
+  /* files we could not check on the way in are read back from cache */
+  if (rc == SCR_SUCCESS && type >= 0 && ! verified) {
+    rc = scr_checksum_file(dest_file, type, &computed);
+  }
+
+  if (rc == SCR_SUCCESS && type >= 0 && computed != value) {
+    scr_err("%s mismatch for %s, got %lx, expected %lx @ %s:%d",
+      scr_checksum_type_to_str(type), read_file,
+      (unsigned long) computed, (unsigned long) value, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  return rc;
+}
+
+/* fetch files from fetch_dir into cache_dir and update filemap,
+ * reads the copies on the drain store if from_drain is set,
+ * if lazy is set only the filemap is written, and each file is
+ * fetched when it is first routed, if keep is set the calling proc
+ * keeps the files and filemap it has in cache and reads nothing */
 static int scr_fetch_data(
   const kvtree* summary_hash,
   const char* fetch_dir,
   const char* cache_dir,
   scr_cache_index* cindex,
-  int id)
+  int id,
+  int from_drain,
+  int lazy,
+  int keep)
 {
   int rc = SCR_SUCCESS;
 
@@ -166,7 +304,7 @@ static int scr_fetch_data(
 
   /* get the list of files to read */
   kvtree* filelist = kvtree_new();
-  if (kvtree_read_scatter(rank2file, filelist, scr_comm_world) != KVTREE_SUCCESS) {
+  if (scr_rank2file_read(rank2file, filelist, scr_comm_world) != SCR_SUCCESS) {
     scr_err("Failed to rank2file map: `%s' @ %s:%d",
       rank2file, __FILE__, __LINE__
     );
@@ -177,15 +315,31 @@ static int scr_fetch_data(
   scr_free(&rank2file);
   spath_delete(&rank2file_path);
 
-  /* TODO: gather list of files to leader for each store descriptor,
-   * then use comm of store descriptor leaders in axl call,
-   * have leaders bcast success/fail back to all procs */
+  /* drop our entries if we have our files already */
+  if (keep) {
+    kvtree_delete(&filelist);
+    filelist = kvtree_new();
+  }
 
   /* allocate list of file names */
   kvtree* files = kvtree_get(filelist, "FILE");
   int num_files = kvtree_size(files);
   const char** src_filelist  = (const char**) SCR_MALLOC(num_files * sizeof(char*));
   const char** dest_filelist = (const char**) SCR_MALLOC(num_files * sizeof(char*));
+  int* compress_list = (int*) SCR_MALLOC(num_files * sizeof(int));
+  char** base_filelist = (char**) SCR_MALLOC(num_files * sizeof(char*));
+  char** read_filelist = (char**) SCR_MALLOC(num_files * sizeof(char*));
+  char** container_list = (char**) SCR_MALLOC(num_files * sizeof(char*));
+  unsigned long* offset_list = (unsigned long*) SCR_MALLOC(num_files * sizeof(unsigned long));
+  unsigned long* length_list = (unsigned long*) SCR_MALLOC(num_files * sizeof(unsigned long));
+  char** shared_list = (char**) SCR_MALLOC(num_files * sizeof(char*));
+  kvtree** extents_list = (kvtree**) SCR_MALLOC(num_files * sizeof(kvtree*));
+  int* type_list = (int*) SCR_MALLOC(num_files * sizeof(int));
+  uint64_t* value_list = (uint64_t*) SCR_MALLOC(num_files * sizeof(uint64_t));
+  unsigned long* size_list = (unsigned long*) SCR_MALLOC(num_files * sizeof(unsigned long));
+  int* sized_list = (int*) SCR_MALLOC(num_files * sizeof(int));
+  struct stat* stat_list = (struct stat*) SCR_MALLOC(num_files * sizeof(struct stat));
+  int* statted_list = (int*) SCR_MALLOC(num_files * sizeof(int));
 
   /* create list of file names */
   int i = 0;
@@ -197,6 +351,44 @@ static int scr_fetch_data(
     /* get the filename */
     const char* file = kvtree_elem_key(elem);
 
+    /* check whether file was compressed when it was flushed */
+    const kvtree* file_hash = kvtree_elem_hash(elem);
+    if (scr_meta_get_compress(file_hash, &compress_list[i], NULL) != SCR_SUCCESS) {
+      scr_err("Unknown compression type for file %s @ %s:%d",
+        file, __FILE__, __LINE__
+      );
+      compress_list[i] = -1;
+    }
+
+    /* check whether file was flushed as a delta against an earlier file */
+    base_filelist[i] = NULL;
+    char* base = NULL;
+    if (kvtree_util_get_str(file_hash, SCR_META_KEY_DELTA, &base) == KVTREE_SUCCESS) {
+      spath* basepath = spath_from_str(scr_prefix);
+      spath_append_str(basepath, base);
+      spath_reduce(basepath);
+      base_filelist[i] = spath_strdup(basepath);
+      spath_delete(&basepath);
+    }
+
+    /* check whether file was packed into a container when it was flushed */
+    container_list[i] = NULL;
+    scr_container_get(file_hash, &container_list[i], &offset_list[i], &length_list[i]);
+
+    /* check whether file is a segment written into a shared file */
+    shared_list[i] = NULL;
+    extents_list[i] = NULL;
+    scr_segment_get(file_hash, &shared_list[i], &extents_list[i]);
+
+    /* get the checksum recorded when the file was flushed, if any */
+    if (scr_meta_get_checksum(file_hash, &type_list[i], &value_list[i]) != SCR_SUCCESS) {
+      type_list[i] = -1;
+    }
+
+    /* and its size */
+    sized_list[i] = (scr_meta_get_filesize(file_hash, &size_list[i]) == SCR_SUCCESS);
+    statted_list[i] = 0;
+
     /* prepend prefix directory to each file */
     spath* srcpath = spath_from_str(scr_prefix);
     spath_append_str(srcpath, file);
@@ -204,6 +396,14 @@ static int scr_fetch_data(
     src_filelist[i] = spath_strdup(srcpath);
     spath_delete(&srcpath);
 
+    /* files keep their names in the prefix directory,
+     * but we may read them from their copies on the drain store */
+    if (from_drain) {
+      read_filelist[i] = scr_drain_path(id, src_filelist[i]);
+    } else {
+      read_filelist[i] = strdup(src_filelist[i]);
+    }
+
     /* compute and strdup detination name into dest list */
     if (cache_dir != NULL) {
       /* take basename of file and prepend cache directory */
@@ -227,7 +427,9 @@ static int scr_fetch_data(
 
   /* now we can finally fetch the actual files */
   int success = 1;
-  if (cache_dir != NULL) {
+  if (cache_dir != NULL && lazy) {
+    /* files are read as the application routes them */
+  } else if (cache_dir != NULL) {
     /* get the dataset corresponding to this id */
     scr_dataset* dataset = scr_dataset_new();
     scr_cache_index_get_dataset(cindex, id, dataset);
@@ -237,24 +439,153 @@ static int scr_fetch_data(
     scr_dataset_get_name(dataset, &dset_name);
 
     /* get AXL transfer type */
-    //const scr_storedesc* storedesc = scr_cache_get_storedesc(cindex, id);
+    const scr_storedesc* storedesc = scr_cache_get_storedesc(cindex, id);
     axl_xfer_t xfer_type = scr_xfer_str_to_axl_type(SCR_FETCH_TYPE);
 
-    /* fetch these files into the directory */
-    if (scr_axl(dset_name, num_files, src_filelist, dest_filelist, xfer_type, scr_comm_world) != SCR_SUCCESS) {
-      success = 0;
+    /* decompress any files that were compressed during flush,
+     * rebuild any that were written as deltas, copy files that we
+     * verify against their checksum as we read them, and build list of
+     * remaining files to copy as is */
+    int copy_files = 0;
+    int fetch_files = 0;
+    const char** src_copylist  = (const char**) SCR_MALLOC(num_files * sizeof(char*));
+    const char** dest_copylist = (const char**) SCR_MALLOC(num_files * sizeof(char*));
+    int* fetch_list = (int*) SCR_MALLOC(num_files * sizeof(int));
+    for (i = 0; i < num_files; i++) {
+      int type = scr_crc_on_flush ? type_list[i] : -1;
+      if (container_list[i] == NULL && shared_list[i] == NULL && base_filelist[i] == NULL &&
+          compress_list[i] == SCR_COMPRESS_NONE && type < 0)
+      {
+        src_copylist[copy_files]  = read_filelist[i];
+        dest_copylist[copy_files] = dest_filelist[i];
+        copy_files++;
+      } else {
+        fetch_list[fetch_files] = i;
+        fetch_files++;
+      }
+    }
+
+    /* we read the other files ourselves, so take turns in the same
+     * window that limits the bulk transfer, if anyone has such files */
+    if (! scr_alltrue(fetch_files == 0, scr_comm_world)) {
+      scr_flow_wait(scr_fetch_width, scr_comm_world);
+      int j;
+      for (j = 0; j < fetch_files; j++) {
+        i = fetch_list[j];
+        int type = scr_crc_on_flush ? type_list[i] : -1;
+        if (scr_fetch_file(read_filelist[i], dest_filelist[i], compress_list[i],
+            base_filelist[i], container_list[i], offset_list[i], length_list[i],
+            shared_list[i], extents_list[i], type, value_list[i]) != SCR_SUCCESS)
+        {
+          success = 0;
+          if (scr_crc_on_flush) {
+            /* the dataset is no good to us, stop reading it */
+            break;
+          }
+        }
+      }
+      scr_flow_signal(scr_fetch_width, scr_comm_world);
+    }
+    scr_free(&fetch_list);
+
+    /* a file that fails its checksum dooms the dataset, so don't start
+     * the bulk transfer if any proc found one, this way we move on to
+     * an older dataset sooner */
+    int proceed = 1;
+    if (scr_crc_on_flush) {
+      proceed = scr_alltrue(success, scr_comm_world);
     }
 
+    if (! proceed) {
+      /* nothing more to read */
+    } else if (storedesc != NULL && storedesc->direct) {
+      /* cache asks for O_DIRECT, so copy files ourselves to keep
+       * fetched data out of the page cache */
+      for (i = 0; i < copy_files; i++) {
+        if (scr_file_copy_direct(src_copylist[i], dest_copylist[i],
+            scr_file_buf_size, (size_t) scr_page_size, NULL) != SCR_SUCCESS)
+        {
+          success = 0;
+        }
+      }
+    } else {
+      /* fetch these files into the directory, either from each process or
+       * with one transfer per store descriptor group run by its leader */
+      if (scr_axl_aggregate && storedesc != NULL) {
+        if (scr_axl_leaders(dset_name, copy_files, src_copylist, dest_copylist, xfer_type,
+            storedesc->comm, storedesc->leaders, scr_comm_world) != SCR_SUCCESS)
+        {
+          success = 0;
+        }
+      } else if (scr_flow_axl(SCR_FLOW_FETCH, dset_name, copy_files, src_copylist, dest_copylist,
+          xfer_type, scr_comm_world) != SCR_SUCCESS)
+      {
+        success = 0;
+      }
+    }
+
+    /* free the lists, the strings belong to the full lists */
+    scr_free(&src_copylist);
+    scr_free(&dest_copylist);
+
     /* free datase */
     scr_dataset_delete(&dataset);
   } else {
-    /* just stat the file to check that it exists */
+    /* just stat the file to check that it exists, we keep the result
+     * for the filemap so that each file costs a single stat */
     for (i = 0; i < num_files; i++) {
-      if (access(src_filelist[i], R_OK) < 0) {
+      /* files in a container have no file of their own to read */
+      if (container_list[i] != NULL) {
+        scr_err("Cannot fetch file %s from container in bypass mode @ %s:%d",
+          src_filelist[i], __FILE__, __LINE__
+        );
+        success = 0;
+        break;
+      }
+
+      /* the application reads the shared file of a segment in place */
+      if (shared_list[i] != NULL) {
+        if (access(shared_list[i], R_OK) < 0) {
+          success = 0;
+          break;
+        }
+        continue;
+      }
+
+      /* the application can't read compressed files in place */
+      if (compress_list[i] != SCR_COMPRESS_NONE) {
+        scr_err("Cannot fetch compressed file %s in bypass mode @ %s:%d",
+          src_filelist[i], __FILE__, __LINE__
+        );
+        success = 0;
+        break;
+      }
+
+      /* nor can it read files written as deltas */
+      if (base_filelist[i] != NULL) {
+        scr_err("Cannot fetch delta file %s in bypass mode @ %s:%d",
+          src_filelist[i], __FILE__, __LINE__
+        );
+        success = 0;
+        break;
+      }
+
+      if (stat(src_filelist[i], &stat_list[i]) < 0 || ! S_ISREG(stat_list[i].st_mode)) {
         /* either can't read this file or it doesn't exist */
         success = 0;
         break;
       }
+      statted_list[i] = 1;
+
+      /* a file that is shorter or longer than we flushed is no good */
+      if (sized_list[i] && (unsigned long) stat_list[i].st_size != size_list[i]) {
+        scr_err("File %s has %lu bytes, expected %lu @ %s:%d",
+          src_filelist[i], (unsigned long) stat_list[i].st_size, size_list[i],
+          __FILE__, __LINE__
+        );
+        success = 0;
+        break;
+      }
     }
   }
 
@@ -299,22 +630,56 @@ static int scr_fetch_data(
     spath_delete(&path_name);
     spath_delete(&path_abs);
 
-    /* stat the file to get its size and other metadata */
+    /* stat the file to get its size and other metadata, which we
+     * already did for files read in place, files that a lazy fetch
+     * has not read yet don't exist in cache */
     struct stat stat_buf;
-    int stat_rc = stat(dest_file, &stat_buf);
+    int stat_rc = -1;
+    if (statted_list[i]) {
+      stat_buf = stat_list[i];
+      stat_rc = 0;
+    } else if (! (cache_dir != NULL && lazy)) {
+      stat_rc = stat(dest_file, &stat_buf);
+    }
     if (stat_rc == 0) {
       unsigned long filesize = (unsigned long) stat_buf.st_size;
       scr_meta_set_filesize(meta, filesize);
       scr_meta_set_stat(meta, &stat_buf);
     }
 
+    /* carry the checksum recorded at flush time */
+    if (type_list[i] >= 0) {
+      scr_meta_set_checksum(meta, type_list[i], value_list[i]);
+    }
+
+    /* record how to read files that we have not fetched yet */
+    if (cache_dir != NULL && lazy) {
+      kvtree* fetch_hash = kvtree_new();
+      kvtree_util_set_int(fetch_hash, SCR_META_KEY_COMPRESS, compress_list[i]);
+      if (base_filelist[i] != NULL) {
+        kvtree_util_set_str(fetch_hash, SCR_META_KEY_DELTA, base_filelist[i]);
+      }
+      if (container_list[i] != NULL) {
+        kvtree_util_set_str(fetch_hash, SCR_KEY_CONTAINER, container_list[i]);
+        kvtree_util_set_unsigned_long(fetch_hash, SCR_KEY_OFFSET, offset_list[i]);
+        kvtree_util_set_unsigned_long(fetch_hash, SCR_KEY_LENGTH, length_list[i]);
+      }
+      if (shared_list[i] != NULL) {
+        kvtree_util_set_str(fetch_hash, SCR_KEY_SHARED, shared_list[i]);
+        kvtree_merge(fetch_hash, extents_list[i]);
+      }
+      kvtree_set(meta, SCR_META_KEY_FETCH, fetch_hash);
+    }
+
     /* add meta to map */
     scr_filemap_set_meta(map, dest_file, meta);
     scr_meta_delete(&meta);
   }
 
   /* write out filemap */
-  scr_cache_set_map(cindex, id, map);
+  if (! keep) {
+    scr_cache_set_map(cindex, id, map);
+  }
   scr_filemap_delete(&map);
 
   /* free memory allocated for file list */
@@ -322,9 +687,28 @@ static int scr_fetch_data(
     /* free filename strings */
     scr_free(&src_filelist[i]);
     scr_free(&dest_filelist[i]);
+    scr_free(&base_filelist[i]);
+    scr_free(&read_filelist[i]);
+    scr_free(&container_list[i]);
+    scr_free(&shared_list[i]);
+    kvtree_delete(&extents_list[i]);
   }
   scr_free(&src_filelist);
   scr_free(&dest_filelist);
+  scr_free(&compress_list);
+  scr_free(&base_filelist);
+  scr_free(&read_filelist);
+  scr_free(&container_list);
+  scr_free(&shared_list);
+  scr_free(&extents_list);
+  scr_free(&offset_list);
+  scr_free(&length_list);
+  scr_free(&type_list);
+  scr_free(&value_list);
+  scr_free(&size_list);
+  scr_free(&sized_list);
+  scr_free(&stat_list);
+  scr_free(&statted_list);
 
   return rc;
 }
@@ -348,10 +732,9 @@ int scr_fetch_dset(scr_cache_index* cindex, int dset_id, const char* dset_name,
 
   /* start timer */
   time_t timestamp_start;
-  double time_start;
+  double time_start = MPI_Wtime();
   if (scr_my_rank_world == 0) {
     timestamp_start = scr_log_seconds();
-    time_start = MPI_Wtime();
   }
 
   /* log the fetch attempt */
@@ -451,10 +834,28 @@ int scr_fetch_dset(scr_cache_index* cindex, int dset_id, const char* dset_name,
     target_dir = NULL;
   }
 
+  /* read from the drain store if it holds a complete copy,
+   * and fall back to the prefix directory if that fails */
+  int from_drain = 0;
+  if (target_dir != NULL && ! scr_fetch_lazy) {
+    from_drain = scr_drain_have(dset_id);
+  }
+
+  /* with a lazy fetch, files are read as the application routes them */
+  int lazy = (target_dir != NULL && scr_fetch_lazy);
+
   /* now we can finally fetch the actual files */
   int success = 1;
-  if (scr_fetch_data(summary_hash, fetch_dir, target_dir, cindex, dset_id) != SCR_SUCCESS) {
+  if (scr_fetch_data(summary_hash, fetch_dir, target_dir, cindex, dset_id, from_drain, lazy, 0) != SCR_SUCCESS) {
     success = 0;
+    if (from_drain) {
+      if (scr_my_rank_world == 0) {
+        scr_dbg(1, "Failed to fetch from drain store, reading from prefix directory");
+      }
+      if (scr_fetch_data(summary_hash, fetch_dir, target_dir, cindex, dset_id, 0, 0, 0) == SCR_SUCCESS) {
+        success = 1;
+      }
+    }
   }
 
   /* free the hash holding the summary file data */
@@ -491,7 +892,31 @@ int scr_fetch_dset(scr_cache_index* cindex, int dset_id, const char* dset_name,
   scr_filemap* map = scr_filemap_new();
   scr_cache_get_map(cindex, dset_id, map);
 
-  /* apply redundancy scheme */
+  /* tally up the bytes this process fetched */
+  double my_bytes = 0.0;
+  kvtree_elem* file_elem;
+  for (file_elem = scr_filemap_first_file(map);
+       file_elem != NULL;
+       file_elem = kvtree_elem_next(file_elem))
+  {
+    char* file = kvtree_elem_key(file_elem);
+    scr_meta* meta = scr_meta_new();
+    unsigned long filesize;
+    if (scr_filemap_get_meta(map, file, meta) == SCR_SUCCESS &&
+        scr_meta_get_filesize(meta, &filesize) == SCR_SUCCESS)
+    {
+      my_bytes += (double) filesize;
+    }
+    scr_meta_delete(&meta);
+  }
+  scr_stats_record(SCR_STATS_FETCH, my_bytes, MPI_Wtime() - time_start);
+
+  /* apply redundancy scheme, files of a lazy fetch are not in cache
+   * yet, so we protect just the filemap as with bypass, and we
+   * fetch the dataset again if we lose the cache */
+  if (lazy) {
+    c->bypass = 1;
+  }
   int rc = scr_reddesc_apply(map, c, dset_id);
   if (rc == SCR_SUCCESS) {
     /* record checkpoint id */
@@ -501,9 +926,11 @@ int scr_fetch_dset(scr_cache_index* cindex, int dset_id, const char* dset_name,
      * as well as the parallel file system */
     /* TODO: should we place SCR_FLUSH_KEY_LOCATION_PFS before
      * scr_reddesc_apply? */
+    scr_flush_file_batch_begin();
     scr_flush_file_location_set(dset_id, SCR_FLUSH_KEY_LOCATION_CACHE);
     scr_flush_file_location_set(dset_id, SCR_FLUSH_KEY_LOCATION_PFS);
     scr_flush_file_location_unset(dset_id, SCR_FLUSH_KEY_LOCATION_FLUSHING);
+    scr_flush_file_batch_end();
   } else {
     /* something went wrong, so delete this checkpoint from the cache */
     scr_cache_delete(cindex, dset_id);
@@ -536,7 +963,7 @@ int scr_fetch_dset(scr_cache_index* cindex, int dset_id, const char* dset_name,
         scr_log_event("FETCH_FAIL", fetch_dir, &dset_id, dset_name, NULL, &time_diff);
       }
       scr_log_transfer("FETCH", fetch_dir, cache_dir, &dset_id, dset_name,
-        &timestamp_start, &time_diff, &total_bytes, &files
+        &timestamp_start, &time_diff, &total_bytes, NULL, &files
       );
     }
   }
@@ -550,11 +977,479 @@ int scr_fetch_dset(scr_cache_index* cindex, int dset_id, const char* dset_name,
   return rc;
 }
 
+/* if file is in the filemap of dataset id but was not fetched yet
+ * by a lazy fetch, read it into cache now and update the filemap,
+ * returns SCR_SUCCESS if the file is in cache or is not ours to fetch */
+int scr_fetch_lazy_file(scr_cache_index* cindex, int id, const char* file)
+{
+  /* look up the file in the filemap */
+  scr_filemap* map = scr_filemap_new();
+  scr_cache_get_map(cindex, id, map);
+  scr_meta* meta = scr_meta_new();
+  if (scr_filemap_get_meta(map, file, meta) != SCR_SUCCESS) {
+    scr_meta_delete(&meta);
+    scr_filemap_delete(&map);
+    return SCR_SUCCESS;
+  }
+
+  /* nothing to do unless the file is waiting to be fetched */
+  kvtree* fetch_hash = kvtree_get(meta, SCR_META_KEY_FETCH);
+  if (fetch_hash == NULL) {
+    scr_meta_delete(&meta);
+    scr_filemap_delete(&map);
+    return SCR_SUCCESS;
+  }
+
+  /* read the file from where the flush left it */
+  int rc = SCR_FAILURE;
+  char* src_file = NULL;
+  if (scr_meta_get_orig(meta, &src_file) == SCR_SUCCESS) {
+    int compress = SCR_COMPRESS_NONE;
+    char* base = NULL;
+    char* container = NULL;
+    unsigned long offset = 0;
+    unsigned long length = 0;
+    char* shared = NULL;
+    kvtree_util_get_int(fetch_hash, SCR_META_KEY_COMPRESS, &compress);
+    kvtree_util_get_str(fetch_hash, SCR_META_KEY_DELTA, &base);
+    kvtree_util_get_str(fetch_hash, SCR_KEY_CONTAINER, &container);
+    kvtree_util_get_unsigned_long(fetch_hash, SCR_KEY_OFFSET, &offset);
+    kvtree_util_get_unsigned_long(fetch_hash, SCR_KEY_LENGTH, &length);
+    kvtree_util_get_str(fetch_hash, SCR_KEY_SHARED, &shared);
+
+    /* verify against the checksum from the flush if we have one */
+    int type = -1;
+    uint64_t value = 0;
+    if (! scr_crc_on_flush || scr_meta_get_checksum(meta, &type, &value) != SCR_SUCCESS) {
+      type = -1;
+    }
+    rc = scr_fetch_file(src_file, file, compress, base, container, offset, length,
+      shared, fetch_hash, type, value
+    );
+  }
+  if (rc != SCR_SUCCESS) {
+    scr_err("Failed to fetch %s on demand @ %s:%d",
+      file, __FILE__, __LINE__
+    );
+    scr_meta_delete(&meta);
+    scr_filemap_delete(&map);
+    return SCR_FAILURE;
+  }
+
+  /* the file is in cache now, record its size */
+  kvtree_unset(meta, SCR_META_KEY_FETCH);
+  struct stat stat_buf;
+  if (stat(file, &stat_buf) == 0) {
+    scr_meta_set_filesize(meta, (unsigned long) stat_buf.st_size);
+    scr_meta_set_stat(meta, &stat_buf);
+  }
+  scr_filemap_set_meta(map, file, meta);
+  scr_cache_set_map(cindex, id, map);
+
+  scr_meta_delete(&meta);
+  scr_filemap_delete(&map);
+  return SCR_SUCCESS;
+}
+
+/* fetch files of dataset id from the prefix directory into its cache
+ * directory on procs that set need, while other procs keep the files
+ * they have in cache, the dataset must be complete in the prefix
+ * directory, returns SCR_SUCCESS on all procs if every proc read its files */
+int scr_fetch_ranks(scr_cache_index* cindex, int id, int need)
+{
+  if (! scr_fetch) {
+    return SCR_FAILURE;
+  }
+
+  /* get name of dataset */
+  char* name = NULL;
+  scr_dataset* dataset = scr_dataset_new();
+  scr_cache_index_get_dataset(cindex, id, dataset);
+  scr_dataset_get_name(dataset, &name);
+
+  /* check that a complete copy of the dataset was flushed */
+  int complete = 0;
+  if (scr_my_rank_world == 0 && name != NULL) {
+    kvtree* index_hash = kvtree_new();
+    if (scr_index_read(scr_prefix_path, index_hash) == SCR_SUCCESS) {
+      scr_index_get_complete(index_hash, id, name, &complete);
+    }
+    kvtree_delete(&index_hash);
+  }
+  MPI_Bcast(&complete, 1, MPI_INT, 0, scr_comm_world);
+  if (! complete) {
+    scr_dataset_delete(&dataset);
+    return SCR_FAILURE;
+  }
+
+  /* tell user how many procs read from the prefix directory */
+  int count = 0;
+  MPI_Reduce(&need, &count, 1, MPI_INT, MPI_SUM, 0, scr_comm_world);
+  if (scr_my_rank_world == 0) {
+    scr_dbg(1, "Fetching files of %d of %d ranks for dataset %d: %s",
+      count, scr_ranks_world, id, name
+    );
+  }
+
+  /* get path to dataset metadata directory in prefix */
+  spath* path = spath_from_str(scr_prefix_scr);
+  spath_append_strf(path, "scr.dataset.%d", id);
+  char* fetch_dir = spath_strdup(path);
+  spath_delete(&path);
+
+  /* read the summary file for this dataset */
+  int rc = SCR_FAILURE;
+  kvtree* summary_hash = kvtree_new();
+  if (scr_fetch_summary(fetch_dir, summary_hash) == SCR_SUCCESS) {
+    /* files of bypass datasets are read in place */
+    char* cache_dir = NULL;
+    int bypass = 0;
+    scr_cache_index_get_dir(cindex, id, &cache_dir);
+    scr_cache_index_get_bypass(cindex, id, &bypass);
+    bypass = ! scr_alltrue(! bypass, scr_comm_world);
+    if (bypass) {
+      cache_dir = NULL;
+    }
+
+    /* procs on new nodes only know what the dataset told them,
+     * so record the same bypass setting everywhere */
+    scr_cache_index_set_bypass(cindex, id, bypass);
+    scr_cache_index_write(scr_cindex_file, cindex);
+
+    rc = scr_fetch_data(summary_hash, fetch_dir, cache_dir, cindex, id, 0, 0, ! need);
+  }
+  kvtree_delete(&summary_hash);
+
+  scr_free(&fetch_dir);
+  scr_dataset_delete(&dataset);
+  return rc;
+}
+
+/* state for checking the next older checkpoint in the background
+ * while the current one is being fetched */
+typedef struct {
+  pthread_t thread;   /* thread running the check */
+  int   started;      /* whether the thread is running */
+  int   id;           /* dataset id of the candidate */
+  char* fetch_dir;    /* metadata directory of the candidate */
+  int   shard_ranks;  /* ranks per shard of its binary rank2file map, 0 if none */
+  int   valid;        /* set by thread, whether our part of the candidate checks out */
+} scr_fetch_check_t;
+
+/* check that a file named in a rank2file entry can be read */
+static int scr_fetch_check_path(const char* relname)
+{
+  spath* path = spath_from_str(scr_prefix);
+  spath_append_str(path, relname);
+  spath_reduce(path);
+  char* file = spath_strdup(path);
+  spath_delete(&path);
+
+  int rc = scr_file_is_readable(file);
+  if (rc != SCR_SUCCESS) {
+    scr_dbg(1, "Fallback checkpoint is missing %s @ %s:%d",
+      file, __FILE__, __LINE__
+    );
+  }
+  scr_free(&file);
+  return rc;
+}
+
+/* reads the summary file of the candidate on rank 0 and, if it has a
+ * binary rank2file map, checks that every file our rank needs exists,
+ * this touches only the file system so it can run beside a fetch */
+static void* scr_fetch_check_thread(void* arg)
+{
+  scr_fetch_check_t* c = (scr_fetch_check_t*) arg;
+  int valid = 1;
+
+  /* rank 0 checks that the summary file describes a dataset */
+  if (scr_my_rank_world == 0) {
+    spath* summary_path = spath_from_str(c->fetch_dir);
+    spath_append_str(summary_path, "summary.scr");
+    char* summary_file = spath_strdup(summary_path);
+    spath_delete(&summary_path);
+
+    kvtree* summary = kvtree_new();
+    if (kvtree_read_file(summary_file, summary) != KVTREE_SUCCESS ||
+        kvtree_get(summary, SCR_SUMMARY_6_KEY_DATASET) == NULL)
+    {
+      scr_dbg(1, "Failed to read summary file %s of fallback checkpoint @ %s:%d",
+        summary_file, __FILE__, __LINE__
+      );
+      valid = 0;
+    }
+    kvtree_delete(&summary);
+    scr_free(&summary_file);
+  }
+
+  /* each rank reads its own entry and checks its files */
+  if (valid && c->shard_ranks > 0) {
+    spath* rank2file_path = spath_from_str(c->fetch_dir);
+    spath_append_str(rank2file_path, "rank2file");
+    char* rank2file = spath_strdup(rank2file_path);
+    spath_delete(&rank2file_path);
+
+    kvtree* filelist = kvtree_new();
+    if (scr_rank2file_read_rank(rank2file, scr_my_rank_world, c->shard_ranks, filelist) == SCR_SUCCESS) {
+      kvtree_elem* elem;
+      kvtree* files = kvtree_get(filelist, "FILE");
+      for (elem = kvtree_elem_first(files);
+           elem != NULL && valid;
+           elem = kvtree_elem_next(elem))
+      {
+        /* files in a container or a shared file, or written as a delta,
+         * need those files too */
+        const kvtree* file_hash = kvtree_elem_hash(elem);
+        char* container = NULL;
+        char* shared = NULL;
+        char* base = NULL;
+        if (kvtree_util_get_str(file_hash, SCR_KEY_CONTAINER, &container) == KVTREE_SUCCESS) {
+          if (scr_fetch_check_path(container) != SCR_SUCCESS) {
+            valid = 0;
+          }
+          continue;
+        }
+        if (kvtree_util_get_str(file_hash, SCR_KEY_SHARED, &shared) == KVTREE_SUCCESS) {
+          if (scr_fetch_check_path(shared) != SCR_SUCCESS) {
+            valid = 0;
+          }
+          continue;
+        }
+        if (kvtree_util_get_str(file_hash, SCR_META_KEY_DELTA, &base) == KVTREE_SUCCESS &&
+            scr_fetch_check_path(base) != SCR_SUCCESS)
+        {
+          valid = 0;
+        }
+        if (scr_fetch_check_path(kvtree_elem_key(elem)) != SCR_SUCCESS) {
+          valid = 0;
+        }
+      }
+    } else {
+      valid = 0;
+    }
+    kvtree_delete(&filelist);
+    scr_free(&rank2file);
+  }
+
+  c->valid = valid;
+  return NULL;
+}
+
+/* start checking the checkpoint that we'd fall back to if fetching
+ * target_id fails, rank 0 picks the candidate from index_hash,
+ * must be called by all procs */
+static void scr_fetch_check_start(scr_fetch_check_t* c, const kvtree* index_hash, int target_id)
+{
+  c->started = 0;
+  c->id = -1;
+  c->fetch_dir = NULL;
+  c->shard_ranks = 0;
+  c->valid = 0;
+
+  /* rank 0 picks the candidate, and looks up the shard size of its
+   * rank2file map so that each rank can read just its own entry */
+  int info[2] = {-1, 0};
+  if (scr_my_rank_world == 0) {
+    char name[SCR_MAX_FILENAME];
+    scr_index_get_most_recent_complete(index_hash, target_id, &info[0], name);
+    if (info[0] != -1) {
+      spath* path = spath_from_str(scr_prefix_scr);
+      spath_append_strf(path, "scr.dataset.%d", info[0]);
+      spath_append_str(path, "rank2file");
+      char* rank2file = spath_strdup(path);
+      spath_delete(&path);
+
+      int map_ranks, shard_ranks;
+      if (scr_rank2file_read_header(rank2file, &map_ranks, &shard_ranks) == SCR_SUCCESS &&
+          map_ranks == scr_ranks_world)
+      {
+        info[1] = shard_ranks;
+      }
+      scr_free(&rank2file);
+    }
+  }
+  MPI_Bcast(info, 2, MPI_INT, 0, scr_comm_world);
+  if (info[0] == -1) {
+    return;
+  }
+
+  c->id = info[0];
+  c->shard_ranks = info[1];
+  spath* path = spath_from_str(scr_prefix_scr);
+  spath_append_strf(path, "scr.dataset.%d", c->id);
+  c->fetch_dir = spath_strdup(path);
+  spath_delete(&path);
+
+  /* if we can't start a thread, we'll find out about the candidate
+   * when we try to fetch it */
+  if (pthread_create(&c->thread, NULL, scr_fetch_check_thread, c) == 0) {
+    c->started = 1;
+  }
+}
+
+/* wait for the check to finish, returns 1 on all procs if the candidate
+ * failed the check, 0 if it passed or could not be checked */
+static int scr_fetch_check_finish(scr_fetch_check_t* c)
+{
+  int invalid = 0;
+  if (c->started) {
+    pthread_join(c->thread, NULL);
+    invalid = ! c->valid;
+  }
+  scr_free(&c->fetch_dir);
+
+  /* a candidate is bad if any rank found it bad */
+  if (c->id != -1 && ! scr_alltrue(! invalid, scr_comm_world)) {
+    return 1;
+  }
+  return 0;
+}
+
+/* returns 1 if dataset id is in the list of n bad ids, 0 otherwise */
+static int scr_fetch_is_bad(int id, int n, const int* bad)
+{
+  int i;
+  for (i = 0; i < n; i++) {
+    if (bad[i] == id) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* add dataset id to the list of bad ids */
+static void scr_fetch_add_bad(int id, int* n, int** bad)
+{
+  if (id == -1 || scr_fetch_is_bad(id, *n, *bad)) {
+    return;
+  }
+  *bad = (int*) realloc(*bad, (*n + 1) * sizeof(int));
+  (*bad)[*n] = id;
+  (*n)++;
+}
+
+/* returns 1 if the summary file of checkpoint id describes a dataset
+ * and its rank2file map can be read and matches our job, 0 otherwise */
+static int scr_fetch_screen_check(int id)
+{
+  int valid = 1;
+
+  spath* path = spath_from_str(scr_prefix_scr);
+  spath_append_strf(path, "scr.dataset.%d", id);
+  spath* summary_path  = spath_dup(path);
+  spath* rank2file_path = spath_dup(path);
+  spath_append_str(summary_path, "summary.scr");
+  spath_append_str(rank2file_path, "rank2file");
+  char* summary_file = spath_strdup(summary_path);
+  char* rank2file    = spath_strdup(rank2file_path);
+  spath_delete(&rank2file_path);
+  spath_delete(&summary_path);
+  spath_delete(&path);
+
+  /* fetch reads the dataset from the summary file */
+  kvtree* summary = kvtree_new();
+  if (kvtree_read_file(summary_file, summary) != KVTREE_SUCCESS ||
+      kvtree_get(summary, SCR_SUMMARY_6_KEY_DATASET) == NULL)
+  {
+    scr_dbg(1, "Failed to read summary file %s of checkpoint %d @ %s:%d",
+      summary_file, id, __FILE__, __LINE__
+    );
+    valid = 0;
+  }
+  kvtree_delete(&summary);
+
+  /* a binary map records how many ranks wrote it, which the read
+   * tolerates, others we can only check for being there */
+  int map_ranks, shard_ranks;
+  if (valid && scr_rank2file_read_header(rank2file, &map_ranks, &shard_ranks) == SCR_SUCCESS) {
+    if (map_ranks != scr_ranks_world) {
+      scr_dbg(1, "Checkpoint %d was written by %d ranks, not %d @ %s:%d",
+        id, map_ranks, scr_ranks_world, __FILE__, __LINE__
+      );
+    }
+  } else if (valid && scr_file_is_readable(rank2file) != SCR_SUCCESS) {
+    scr_dbg(1, "Failed to read rank2file %s of checkpoint %d @ %s:%d",
+      rank2file, id, __FILE__, __LINE__
+    );
+    valid = 0;
+  }
+
+  scr_free(&rank2file);
+  scr_free(&summary_file);
+  return valid;
+}
+
+/* check up to scr_fetch_screen of the most recent complete checkpoints
+ * at once, spread across ranks so each reads the files of a different
+ * one, and add those that fail to the list of bad ids, rank 0 picks the
+ * candidates from index_hash, must be called by all procs */
+static void scr_fetch_screen_candidates(const kvtree* index_hash, int* nbad, int** bad)
+{
+  int n = scr_fetch_screen;
+  if (n <= 0) {
+    return;
+  }
+
+  /* rank 0 lists the candidates newest first */
+  int* ids = (int*) SCR_MALLOC(n * sizeof(int));
+  int count = 0;
+  if (scr_my_rank_world == 0) {
+    int id = -1;
+    while (count < n) {
+      char name[SCR_MAX_FILENAME];
+      int next_id = -1;
+      scr_index_get_most_recent_complete(index_hash, id, &next_id, name);
+      if (next_id == -1) {
+        break;
+      }
+      ids[count++] = next_id;
+      id = next_id;
+    }
+  }
+  MPI_Bcast(&count, 1, MPI_INT, 0, scr_comm_world);
+  if (count == 0) {
+    scr_free(&ids);
+    return;
+  }
+  MPI_Bcast(ids, count, MPI_INT, 0, scr_comm_world);
+
+  /* spread candidates evenly over the ranks, procs that have
+   * nothing to check count every candidate as valid */
+  int* valid     = (int*) SCR_MALLOC(count * sizeof(int));
+  int* all_valid = (int*) SCR_MALLOC(count * sizeof(int));
+  int i;
+  for (i = 0; i < count; i++) {
+    int reader = (int) ((long) i * (long) scr_ranks_world / (long) count);
+    valid[i] = 1;
+    if (reader == scr_my_rank_world) {
+      valid[i] = scr_fetch_screen_check(ids[i]);
+    }
+  }
+  scr_allreduce(valid, all_valid, count, MPI_INT, MPI_MIN, scr_comm_world);
+
+  for (i = 0; i < count; i++) {
+    if (! all_valid[i]) {
+      scr_fetch_add_bad(ids[i], nbad, bad);
+    }
+  }
+
+  if (scr_my_rank_world == 0) {
+    scr_dbg(1, "Checked %d checkpoints before fetch, %d failed", count, *nbad);
+  }
+
+  scr_free(&all_valid);
+  scr_free(&valid);
+  scr_free(&ids);
+}
+
 /* attempt to fetch most recent checkpoint from prefix directory into
  * cache, fills in map if successful and sets fetch_attempted to 1 if
  * any fetch is attempted, returns SCR_SUCCESS if successful */
 int scr_fetch_latest(scr_cache_index* cindex, int* fetch_attempted)
 {
+  scr_trace_mark_begin("fetch");
+
   /* we only return success if we successfully fetch a checkpoint */
   int rc = SCR_FAILURE;
 
@@ -623,6 +1518,14 @@ int scr_fetch_latest(scr_cache_index* cindex, int* fetch_attempted)
     scr_free(&scr_fetch_current);
   }
 
+  /* check the recent checkpoints up front, so we go straight
+   * to the newest one that looks complete */
+  int nbad = 0;
+  int* bad = NULL;
+  if (continue_fetching) {
+    scr_fetch_screen_candidates(index_hash, &nbad, &bad);
+  }
+
   /* now start fetching, we keep trying until we exhaust all valid
    * checkpoints */
   char target[SCR_MAX_FILENAME];
@@ -681,9 +1584,33 @@ int scr_fetch_latest(scr_cache_index* cindex, int* fetch_attempted)
 
     /* check whether we've got a path */
     if (strcmp(target, "") != 0) {
-      /* got something, attempt to fetch the checkpoint */
+      /* while we fetch, check the checkpoint we'd fall back to */
+      scr_fetch_check_t check;
+      check.id = -1;
+      check.started = 0;
+      check.fetch_dir = NULL;
+      int target_bad = scr_fetch_is_bad(target_id, nbad, bad);
+      if (scr_fetch_prefetch && ! target_bad) {
+        scr_fetch_check_start(&check, index_hash, target_id);
+      }
+
+      /* got something, attempt to fetch the checkpoint,
+       * skipping it if a check already found it to be bad */
       int ckpt_id;
-      rc = scr_fetch_dset(cindex, target_id, target, &ckpt_id);
+      if (! target_bad) {
+        rc = scr_fetch_dset(cindex, target_id, target, &ckpt_id);
+      } else {
+        if (scr_my_rank_world == 0) {
+          scr_dbg(1, "Skipping fetch of %s, which is missing files", target);
+        }
+        rc = SCR_FAILURE;
+      }
+
+      /* remember whether the fallback is bad so we can skip it */
+      if (scr_fetch_check_finish(&check)) {
+        scr_fetch_add_bad(check.id, &nbad, &bad);
+      }
+
       if (rc == SCR_SUCCESS) {
         /* set the dataset and checkpoint ids */
         scr_dataset_id    = target_id;
@@ -714,6 +1641,9 @@ int scr_fetch_latest(scr_cache_index* cindex, int* fetch_attempted)
     }
   }
 
+  /* free the list of bad checkpoints */
+  scr_free(&bad);
+
   /* delete the index hash */
   if (scr_my_rank_world == 0) {
     kvtree_delete(&index_hash);
@@ -730,5 +1660,6 @@ int scr_fetch_latest(scr_cache_index* cindex, int* fetch_attempted)
     scr_dbg(1, "scr_fetch_latest: return code %d, %f secs", rc, time_diff);
   }
 
+  scr_trace_mark_end("fetch");
   return rc;
 }
@@ -19,4 +19,15 @@ int scr_fetch_latest(scr_filemap* map, int* fetch_attempted);
  * return its checkpoint id */
 int scr_fetch_dset(scr_cache_index* cindex, int dset_id, const char* dset_name, int* checkpoint_id);
 
+/* if file is in the filemap of dataset id but was not fetched yet
+ * by a lazy fetch, read it into cache now and update the filemap,
+ * returns SCR_SUCCESS if the file is in cache or is not ours to fetch */
+int scr_fetch_lazy_file(scr_cache_index* cindex, int id, const char* file);
+
+/* fetch files of dataset id from the prefix directory into its cache
+ * directory on procs that set need, while other procs keep the files
+ * they have in cache, the dataset must be complete in the prefix
+ * directory, returns SCR_SUCCESS on all procs if every proc read its files */
+int scr_fetch_ranks(scr_cache_index* cindex, int id, int need);
+
 #endif
@@ -43,6 +43,8 @@ WRITE:
 #include <fcntl.h>
 #include <string.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <sys/mman.h>
 
 #include "scr.h"
 #include "scr_io.h"
@@ -252,6 +254,457 @@ int scr_filemap_merge(scr_filemap* map1, scr_filemap* map2)
   return SCR_SUCCESS;
 }
 
+/*
+=========================================
+Binary filemap files
+
+A filemap with many files is mostly the same few meta data keys over
+and over again, so files are written in columns: every distinct string
+is stored once in a pool, each single-valued meta data key of the
+files becomes a column of string ids with one entry per file, and
+whatever else is in the filemap (the dataset, nested meta data) is
+encoded as a tree of string ids.  The file is read with mmap and
+decoded straight into the kvtree.  Layout, in host byte order:
+
+  header
+  uint32 string offsets[nstrings]
+  string pool, NUL-terminated strings, padded to 4 bytes
+  uint32 file name ids[nfiles]
+  for each column: uint32 key id, uint32 value ids[nfiles]
+  tree: uint32 count, then count of (uint32 key id, tree)
+  uint32 crc32 of everything above
+=========================================
+*/
+
+#define SCR_FILEMAP_MAGIC   ("SCRFMAP\0")
+#define SCR_FILEMAP_BOM     (0x01020304)
+#define SCR_FILEMAP_VERSION (1)
+
+/* marks a file that has no value for a column */
+#define SCR_FILEMAP_NONE (UINT32_MAX)
+
+/* deepest tree we accept when reading, guards against damaged files */
+#define SCR_FILEMAP_MAX_DEPTH (64)
+
+typedef struct {
+  char     magic[8];
+  uint32_t bom;
+  uint32_t version;
+  uint32_t nstrings;
+  uint32_t pool_bytes;
+  uint32_t nfiles;
+  uint32_t ncols;
+  uint32_t tree_bytes;
+  uint32_t reserved;
+} scr_filemap_header;
+
+/* growable byte buffer used to assemble the file */
+typedef struct {
+  char*  buf;
+  size_t size;
+  size_t cap;
+} scr_filemap_buf;
+
+static void scr_filemap_buf_put(scr_filemap_buf* b, const void* data, size_t n)
+{
+  if (b->size + n > b->cap) {
+    size_t cap = (b->cap > 0) ? b->cap : 4096;
+    while (b->size + n > cap) {
+      cap *= 2;
+    }
+    b->buf = (char*) realloc(b->buf, cap);
+    if (b->buf == NULL) {
+      scr_abort(-1, "Failed to allocate %lu bytes for filemap @ %s:%d",
+        (unsigned long) cap, __FILE__, __LINE__
+      );
+    }
+    b->cap = cap;
+  }
+  memcpy(b->buf + b->size, data, n);
+  b->size += n;
+}
+
+static void scr_filemap_buf_put_u32(scr_filemap_buf* b, uint32_t value)
+{
+  scr_filemap_buf_put(b, &value, sizeof(value));
+}
+
+/* pool of distinct strings, the strings themselves belong to the map */
+typedef struct {
+  uint32_t     count;
+  uint32_t     slots; /* size of table, a power of two */
+  uint32_t*    table; /* id + 1 of the string in each slot, 0 if empty */
+  const char** strs;
+  uint32_t     bytes; /* total bytes of strings including terminators */
+} scr_filemap_pool;
+
+static uint32_t scr_filemap_hash(const char* str)
+{
+  /* FNV-1a */
+  uint32_t h = 2166136261u;
+  const unsigned char* p;
+  for (p = (const unsigned char*) str; *p != '\0'; p++) {
+    h ^= *p;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/* return the id of str in the pool, adding it if needed */
+static uint32_t scr_filemap_pool_id(scr_filemap_pool* pool, const char* str)
+{
+  /* keep the table at most half full */
+  if (2 * (pool->count + 1) > pool->slots) {
+    uint32_t slots = (pool->slots > 0) ? 2 * pool->slots : 256;
+    uint32_t* table = (uint32_t*) calloc(slots, sizeof(uint32_t));
+    uint32_t i;
+    for (i = 0; i < pool->count; i++) {
+      uint32_t slot = scr_filemap_hash(pool->strs[i]) & (slots - 1);
+      while (table[slot] != 0) {
+        slot = (slot + 1) & (slots - 1);
+      }
+      table[slot] = i + 1;
+    }
+    scr_free(&pool->table);
+    pool->table = table;
+    pool->slots = slots;
+    pool->strs  = (const char**) realloc((void*) pool->strs, slots * sizeof(char*));
+  }
+
+  uint32_t slot = scr_filemap_hash(str) & (pool->slots - 1);
+  while (pool->table[slot] != 0) {
+    uint32_t id = pool->table[slot] - 1;
+    if (strcmp(pool->strs[id], str) == 0) {
+      return id;
+    }
+    slot = (slot + 1) & (pool->slots - 1);
+  }
+
+  uint32_t id = pool->count;
+  pool->strs[id]     = str;
+  pool->table[slot]  = id + 1;
+  pool->bytes       += (uint32_t) strlen(str) + 1;
+  pool->count++;
+  return id;
+}
+
+/* returns 1 if elem holds a single value, as set by kvtree_set_kv */
+static int scr_filemap_is_scalar(const kvtree_elem* elem)
+{
+  kvtree* hash = kvtree_elem_hash(elem);
+  if (kvtree_size(hash) != 1) {
+    return 0;
+  }
+  return (kvtree_size(kvtree_elem_hash(kvtree_elem_first(hash))) == 0);
+}
+
+/* kinds of nodes in the tree, the single-valued entries of META
+ * hashes are left out of the tree since they are in the columns */
+enum {
+  SCR_FILEMAP_NODE_PLAIN,
+  SCR_FILEMAP_NODE_ROOT,
+  SCR_FILEMAP_NODE_FILES,
+  SCR_FILEMAP_NODE_FILE,
+  SCR_FILEMAP_NODE_META,
+};
+
+static void scr_filemap_encode_tree(
+  scr_filemap_buf* b,
+  scr_filemap_pool* pool,
+  const kvtree* hash,
+  int kind)
+{
+  /* count the entries we'll write */
+  uint32_t count = 0;
+  kvtree_elem* elem;
+  for (elem = kvtree_elem_first(hash); elem != NULL; elem = kvtree_elem_next(elem)) {
+    if (kind != SCR_FILEMAP_NODE_META || ! scr_filemap_is_scalar(elem)) {
+      count++;
+    }
+  }
+  scr_filemap_buf_put_u32(b, count);
+
+  for (elem = kvtree_elem_first(hash); elem != NULL; elem = kvtree_elem_next(elem)) {
+    if (kind == SCR_FILEMAP_NODE_META && scr_filemap_is_scalar(elem)) {
+      continue;
+    }
+
+    const char* key = kvtree_elem_key(elem);
+    scr_filemap_buf_put_u32(b, scr_filemap_pool_id(pool, key));
+
+    int child = SCR_FILEMAP_NODE_PLAIN;
+    if (kind == SCR_FILEMAP_NODE_ROOT && strcmp(key, SCR_FILEMAP_KEY_FILE) == 0) {
+      child = SCR_FILEMAP_NODE_FILES;
+    } else if (kind == SCR_FILEMAP_NODE_FILES) {
+      child = SCR_FILEMAP_NODE_FILE;
+    } else if (kind == SCR_FILEMAP_NODE_FILE && strcmp(key, SCR_FILEMAP_KEY_META) == 0) {
+      child = SCR_FILEMAP_NODE_META;
+    }
+    scr_filemap_encode_tree(b, pool, kvtree_elem_hash(elem), child);
+  }
+}
+
+/* serialize map into a newly allocated buffer */
+static int scr_filemap_encode(const scr_filemap* map, scr_filemap_buf* out)
+{
+  scr_filemap_pool pool;
+  memset(&pool, 0, sizeof(pool));
+
+  /* list the files, each is a row of the columns */
+  kvtree* fh = scr_filemap_get_fh(map);
+  uint32_t nfiles = (uint32_t) kvtree_size(fh);
+  uint32_t* names = (uint32_t*) SCR_MALLOC((nfiles + 1) * sizeof(uint32_t));
+
+  /* one column for each single-valued meta data key */
+  uint32_t ncols = 0;
+  uint32_t* col_keys = NULL;
+  uint32_t** col_vals = NULL;
+
+  uint32_t row = 0;
+  kvtree_elem* file_elem;
+  for (file_elem = kvtree_elem_first(fh);
+       file_elem != NULL;
+       file_elem = kvtree_elem_next(file_elem), row++)
+  {
+    names[row] = scr_filemap_pool_id(&pool, kvtree_elem_key(file_elem));
+
+    kvtree* meta = kvtree_get(kvtree_elem_hash(file_elem), SCR_FILEMAP_KEY_META);
+    kvtree_elem* elem;
+    for (elem = kvtree_elem_first(meta); elem != NULL; elem = kvtree_elem_next(elem)) {
+      if (! scr_filemap_is_scalar(elem)) {
+        continue;
+      }
+
+      /* find the column of this key, there are only a few */
+      uint32_t key = scr_filemap_pool_id(&pool, kvtree_elem_key(elem));
+      uint32_t col;
+      for (col = 0; col < ncols; col++) {
+        if (col_keys[col] == key) {
+          break;
+        }
+      }
+      if (col == ncols) {
+        col_keys = (uint32_t*)  realloc(col_keys, (ncols + 1) * sizeof(uint32_t));
+        col_vals = (uint32_t**) realloc(col_vals, (ncols + 1) * sizeof(uint32_t*));
+        col_vals[ncols] = (uint32_t*) SCR_MALLOC((nfiles + 1) * sizeof(uint32_t));
+        uint32_t i;
+        for (i = 0; i < nfiles; i++) {
+          col_vals[ncols][i] = SCR_FILEMAP_NONE;
+        }
+        col_keys[ncols] = key;
+        ncols++;
+      }
+
+      const char* value = kvtree_elem_key(kvtree_elem_first(kvtree_elem_hash(elem)));
+      col_vals[col][row] = scr_filemap_pool_id(&pool, value);
+    }
+  }
+
+  /* everything else goes into the tree */
+  scr_filemap_buf tree = {NULL, 0, 0};
+  scr_filemap_encode_tree(&tree, &pool, map, SCR_FILEMAP_NODE_ROOT);
+
+  /* now that the pool is complete, assemble the file */
+  scr_filemap_header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SCR_FILEMAP_MAGIC, sizeof(header.magic));
+  header.bom        = SCR_FILEMAP_BOM;
+  header.version    = SCR_FILEMAP_VERSION;
+  header.nstrings   = pool.count;
+  header.pool_bytes = (pool.bytes + 3) & ~3u;
+  header.nfiles     = nfiles;
+  header.ncols      = ncols;
+  header.tree_bytes = (uint32_t) tree.size;
+  scr_filemap_buf_put(out, &header, sizeof(header));
+
+  uint32_t i;
+  uint32_t offset = 0;
+  for (i = 0; i < pool.count; i++) {
+    scr_filemap_buf_put_u32(out, offset);
+    offset += (uint32_t) strlen(pool.strs[i]) + 1;
+  }
+  for (i = 0; i < pool.count; i++) {
+    scr_filemap_buf_put(out, pool.strs[i], strlen(pool.strs[i]) + 1);
+  }
+  char pad[4] = {0, 0, 0, 0};
+  scr_filemap_buf_put(out, pad, header.pool_bytes - pool.bytes);
+
+  scr_filemap_buf_put(out, names, nfiles * sizeof(uint32_t));
+  for (i = 0; i < ncols; i++) {
+    scr_filemap_buf_put_u32(out, col_keys[i]);
+    scr_filemap_buf_put(out, col_vals[i], nfiles * sizeof(uint32_t));
+    scr_free(&col_vals[i]);
+  }
+  scr_filemap_buf_put(out, tree.buf, tree.size);
+
+  uint32_t crc = (uint32_t) crc32(0L, (const Bytef*) out->buf, (uInt) out->size);
+  scr_filemap_buf_put_u32(out, crc);
+
+  scr_free(&tree.buf);
+  scr_free(&col_vals);
+  scr_free(&col_keys);
+  scr_free(&names);
+  scr_free(&pool.table);
+  scr_free(&pool.strs);
+
+  return SCR_SUCCESS;
+}
+
+/* state for decoding a mapped file */
+typedef struct {
+  const char*     base;
+  size_t          size;
+  const uint32_t* offsets;
+  const char*     pool;
+  uint32_t        nstrings;
+  uint32_t        pool_bytes;
+} scr_filemap_decoder;
+
+/* return the string with id, NULL if id is not valid */
+static const char* scr_filemap_decode_str(const scr_filemap_decoder* d, uint32_t id)
+{
+  if (id >= d->nstrings || d->offsets[id] >= d->pool_bytes) {
+    return NULL;
+  }
+  return d->pool + d->offsets[id];
+}
+
+static int scr_filemap_decode_u32(const char** pos, const char* end, uint32_t* value)
+{
+  if ((size_t) (end - *pos) < sizeof(uint32_t)) {
+    return SCR_FAILURE;
+  }
+  memcpy(value, *pos, sizeof(uint32_t));
+  *pos += sizeof(uint32_t);
+  return SCR_SUCCESS;
+}
+
+static int scr_filemap_decode_tree(
+  const scr_filemap_decoder* d,
+  const char** pos,
+  const char* end,
+  kvtree* hash,
+  int depth)
+{
+  if (depth > SCR_FILEMAP_MAX_DEPTH) {
+    return SCR_FAILURE;
+  }
+
+  uint32_t count;
+  if (scr_filemap_decode_u32(pos, end, &count) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+
+  uint32_t i;
+  for (i = 0; i < count; i++) {
+    uint32_t id;
+    if (scr_filemap_decode_u32(pos, end, &id) != SCR_SUCCESS) {
+      return SCR_FAILURE;
+    }
+    const char* key = scr_filemap_decode_str(d, id);
+    if (key == NULL) {
+      return SCR_FAILURE;
+    }
+
+    /* merge into what is there, as kvtree_read_file does */
+    kvtree* child = kvtree_get(hash, key);
+    if (child == NULL) {
+      child = kvtree_set(hash, key, kvtree_new());
+    }
+    if (scr_filemap_decode_tree(d, pos, end, child, depth + 1) != SCR_SUCCESS) {
+      return SCR_FAILURE;
+    }
+  }
+
+  return SCR_SUCCESS;
+}
+
+/* decode a binary filemap of size bytes at buf into map */
+static int scr_filemap_decode(const char* buf, size_t size, scr_filemap* map)
+{
+  scr_filemap_header header;
+  if (size < sizeof(header) + sizeof(uint32_t)) {
+    return SCR_FAILURE;
+  }
+  memcpy(&header, buf, sizeof(header));
+  if (header.bom != SCR_FILEMAP_BOM || header.version != SCR_FILEMAP_VERSION) {
+    return SCR_FAILURE;
+  }
+
+  /* check the file is intact before we trust any offsets */
+  uint32_t crc;
+  memcpy(&crc, buf + size - sizeof(uint32_t), sizeof(uint32_t));
+  if (crc != (uint32_t) crc32(0L, (const Bytef*) buf, (uInt) (size - sizeof(uint32_t)))) {
+    return SCR_FAILURE;
+  }
+
+  /* check that the sections fit */
+  uint64_t need = sizeof(header) +
+    (uint64_t) header.nstrings * sizeof(uint32_t) +
+    (uint64_t) header.pool_bytes +
+    (uint64_t) header.nfiles * sizeof(uint32_t) +
+    (uint64_t) header.ncols * (1 + (uint64_t) header.nfiles) * sizeof(uint32_t) +
+    (uint64_t) header.tree_bytes + sizeof(uint32_t);
+  if (need != (uint64_t) size || (header.pool_bytes % 4) != 0 ||
+      (header.pool_bytes > 0 && buf[sizeof(header) + header.nstrings * sizeof(uint32_t) + header.pool_bytes - 1] != '\0'))
+  {
+    return SCR_FAILURE;
+  }
+
+  scr_filemap_decoder d;
+  d.base       = buf;
+  d.size       = size;
+  d.offsets    = (const uint32_t*) (buf + sizeof(header));
+  d.pool       = buf + sizeof(header) + header.nstrings * sizeof(uint32_t);
+  d.nstrings   = header.nstrings;
+  d.pool_bytes = header.pool_bytes;
+
+  const uint32_t* names = (const uint32_t*) (d.pool + header.pool_bytes);
+  const uint32_t* cols  = names + header.nfiles;
+  const char* tree      = (const char*) (cols + (size_t) header.ncols * (1 + header.nfiles));
+  const char* tree_end  = tree + header.tree_bytes;
+
+  /* the tree holds everything but the columns */
+  const char* pos = tree;
+  if (scr_filemap_decode_tree(&d, &pos, tree_end, map, 0) != SCR_SUCCESS || pos != tree_end) {
+    return SCR_FAILURE;
+  }
+
+  /* fill in the meta data of each file from the columns */
+  uint32_t row;
+  for (row = 0; row < header.nfiles; row++) {
+    const char* file = scr_filemap_decode_str(&d, names[row]);
+    if (file == NULL) {
+      return SCR_FAILURE;
+    }
+    kvtree* f = scr_filemap_get_f(map, file);
+    if (f == NULL) {
+      f = kvtree_set_kv(map, SCR_FILEMAP_KEY_FILE, file);
+    }
+    kvtree* meta = kvtree_get(f, SCR_FILEMAP_KEY_META);
+
+    uint32_t col;
+    for (col = 0; col < header.ncols; col++) {
+      const uint32_t* column = cols + (size_t) col * (1 + header.nfiles);
+      uint32_t id = column[1 + row];
+      if (id == SCR_FILEMAP_NONE) {
+        continue;
+      }
+      const char* key   = scr_filemap_decode_str(&d, column[0]);
+      const char* value = scr_filemap_decode_str(&d, id);
+      if (key == NULL || value == NULL) {
+        return SCR_FAILURE;
+      }
+      if (meta == NULL) {
+        meta = kvtree_set(f, SCR_FILEMAP_KEY_META, kvtree_new());
+      }
+      kvtree_set_kv(meta, key, value);
+    }
+  }
+
+  return SCR_SUCCESS;
+}
+
 /* reads specified file and fills in filemap structure */
 int scr_filemap_read(const spath* path_file, scr_filemap* map)
 {
@@ -271,7 +724,32 @@ int scr_filemap_read(const spath* path_file, scr_filemap* map)
     goto cleanup;
   }
 
-  /* ok, now try to read the file */
+  /* map the file and decode it if it is in the binary format */
+  int fd = scr_open(file, O_RDONLY);
+  if (fd >= 0) {
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(scr_filemap_header)) {
+      void* buf = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (buf != MAP_FAILED) {
+        if (memcmp(buf, SCR_FILEMAP_MAGIC, 8) == 0) {
+          if (scr_filemap_decode((const char*) buf, (size_t) st.st_size, map) == SCR_SUCCESS) {
+            rc = SCR_SUCCESS;
+          } else {
+            scr_err("Reading filemap %s @ %s:%d",
+              file, __FILE__, __LINE__
+            );
+          }
+          munmap(buf, (size_t) st.st_size);
+          scr_close(file, fd);
+          goto cleanup;
+        }
+        munmap(buf, (size_t) st.st_size);
+      }
+    }
+    scr_close(file, fd);
+  }
+
+  /* otherwise it was written as a kvtree, by an older version of SCR */
   if (kvtree_read_file(file, map) != KVTREE_SUCCESS) {
     scr_err("Reading filemap %s @ %s:%d",
       file, __FILE__, __LINE__
@@ -292,22 +770,36 @@ cleanup:
 }
 
 /* writes given filemap to specified file */
-int scr_filemap_write(const spath* file, const scr_filemap* map)
+int scr_filemap_write(const spath* path_file, const scr_filemap* map)
 {
   /* check that we have a map pointer */
   if (map == NULL) {
     return SCR_FAILURE;
   }
 
-  /* write out the hash */
-  if (kvtree_write_path(file, map) != KVTREE_SUCCESS) {
-    char path_err[SCR_MAX_FILENAME];
-    spath_strcpy(path_err, sizeof(path_err), file);
+  int rc = SCR_SUCCESS;
+  char* file = spath_strdup(path_file);
+
+  /* encode the map and write it out with a single call */
+  scr_filemap_buf buf = {NULL, 0, 0};
+  scr_filemap_encode(map, &buf);
+
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int fd = scr_open(file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (fd < 0 ||
+      scr_write(file, fd, buf.buf, buf.size) != (ssize_t) buf.size)
+  {
     scr_err("Writing filemap %s @ %s:%d",
-      path_err, __FILE__, __LINE__
+      file, __FILE__, __LINE__
     );
-    return SCR_FAILURE;
+    rc = SCR_FAILURE;
+  }
+  if (fd >= 0 && scr_close(file, fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
   }
 
-  return SCR_SUCCESS;
+  scr_free(&buf.buf);
+  scr_free(&file);
+
+  return rc;
 }
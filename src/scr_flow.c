@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#include "scr_globals.h"
+
+/* tag used to pass tokens between ranks of a window */
+#define SCR_FLOW_TAG (7171)
+
+/* fraction by which bandwidth must change before we move the window */
+#define SCR_FLOW_TOLERANCE (0.05)
+
+/* window state for each kind of transfer */
+typedef struct {
+  int    width; /* current width of window, 0 until first transfer */
+  int    dir;   /* 1 to grow window after next transfer, -1 to shrink it */
+  double bw;    /* aggregate bandwidth of the last transfer in bytes/sec */
+} scr_flow_state;
+
+static scr_flow_state scr_flow_states[2] = {
+  {0, 1, 0.0},
+  {0, 1, 0.0},
+};
+
+/* wait for the token from the rank width below us in comm */
+void scr_flow_wait(int width, MPI_Comm comm)
+{
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  if (width > 0 && rank >= width) {
+    int token;
+    MPI_Recv(&token, 1, MPI_INT, rank - width, SCR_FLOW_TAG, comm, MPI_STATUS_IGNORE);
+  }
+}
+
+/* pass the token to the rank width above us in comm */
+void scr_flow_signal(int width, MPI_Comm comm)
+{
+  int rank, ranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+  if (width > 0 && rank + width < ranks) {
+    int token = 1;
+    MPI_Send(&token, 1, MPI_INT, rank + width, SCR_FLOW_TAG, comm);
+  }
+}
+
+/* transfer files with an AXL handle of our own, independent of other procs */
+static int scr_flow_axl_files(
+  const char* name,
+  int num_files,
+  const char** src_filelist,
+  const char** dest_filelist,
+  axl_xfer_t type)
+{
+  if (num_files == 0) {
+    return SCR_SUCCESS;
+  }
+
+  int id = AXL_Create(type, name, NULL);
+  if (id < 0) {
+    scr_err("Failed to create AXL transfer handle @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  int rc = SCR_SUCCESS;
+  int i;
+  for (i = 0; i < num_files; i++) {
+    if (AXL_Add(id, src_filelist[i], dest_filelist[i]) != AXL_SUCCESS) {
+      scr_err("Failed to add file to AXL transfer handle %d: %s --> %s @ %s:%d",
+        id, src_filelist[i], dest_filelist[i], __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+  }
+
+  if (AXL_Dispatch(id) != AXL_SUCCESS) {
+    scr_err("Failed to dispatch AXL transfer handle %d @ %s:%d",
+      id, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  } else if (AXL_Wait(id) != AXL_SUCCESS) {
+    scr_err("Failed to wait on AXL transfer handle %d @ %s:%d",
+      id, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  if (AXL_Free(id) != AXL_SUCCESS) {
+    scr_err("Failed to free AXL transfer handle %d @ %s:%d",
+      id, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  return rc;
+}
+
+/* given bandwidth of the last transfer, pick width for the next one */
+static int scr_flow_adapt_width(scr_flow_state* s, double bw, int ranks)
+{
+  int width = s->width;
+  if (s->bw > 0.0) {
+    if (bw < s->bw * (1.0 - SCR_FLOW_TOLERANCE)) {
+      /* bandwidth dropped, so turn around */
+      s->dir = -s->dir;
+    } else if (bw <= s->bw * (1.0 + SCR_FLOW_TOLERANCE)) {
+      /* no real change, hold the window where it is */
+      s->bw = bw;
+      return width;
+    }
+  }
+  s->bw = bw;
+
+  /* move the window in the current direction */
+  if (s->dir > 0) {
+    width *= 2;
+  } else {
+    width /= 2;
+  }
+  if (width < 1) {
+    width = 1;
+    s->dir = 1;
+  }
+  if (width > ranks) {
+    width = ranks;
+    s->dir = -1;
+  }
+  return width;
+}
+
+/* same as scr_axl, but at most a window of procs in comm transfer files
+ * at a time, where the window starts at SCR_FLUSH_WIDTH or
+ * SCR_FETCH_WIDTH depending on kind, returns the same value on all procs */
+int scr_flow_axl(
+  int kind,
+  const char* name,
+  int num_files,
+  const char** src_filelist,
+  const char** dest_filelist,
+  axl_xfer_t type,
+  MPI_Comm comm)
+{
+  /* without a width, everyone transfers at once */
+  int configured = (kind == SCR_FLOW_FETCH) ? scr_fetch_width : scr_flush_width;
+  if (configured <= 0) {
+    return scr_axl(name, num_files, src_filelist, dest_filelist, type, comm);
+  }
+
+  int rank, ranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+
+  /* start from the configured width, or from where we adapted to */
+  scr_flow_state* s = &scr_flow_states[kind];
+  if (s->width <= 0 || ! scr_flow_adapt) {
+    s->width = configured;
+  }
+  if (s->width > ranks) {
+    s->width = ranks;
+  }
+  int width = s->width;
+
+  /* count bytes we move to measure bandwidth */
+  int i;
+  double bytes = 0.0;
+  for (i = 0; i < num_files; i++) {
+    bytes += (double) scr_file_size(src_filelist[i]);
+  }
+
+  /* wait our turn, transfer our files, and let the next rank go */
+  double time_start = MPI_Wtime();
+  scr_flow_wait(width, comm);
+  int rc = scr_flow_axl_files(name, num_files, src_filelist, dest_filelist, type);
+  scr_flow_signal(width, comm);
+
+  /* determine whether everyone succeeded */
+  int success = scr_alltrue(rc == SCR_SUCCESS, comm);
+  double time_end = MPI_Wtime();
+
+  /* move the window based on the bandwidth we got */
+  if (scr_flow_adapt) {
+    double total = 0.0;
+    MPI_Reduce(&bytes, &total, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+    if (rank == 0) {
+      double secs = time_end - time_start;
+      if (total > 0.0 && secs > 0.0) {
+        double bw = total / secs;
+        int next = scr_flow_adapt_width(s, bw, ranks);
+        scr_dbg(2, "Transfer with width %d got %f MB/s, next width %d @ %s:%d",
+          width, bw / (1024.0 * 1024.0), next, __FILE__, __LINE__
+        );
+        s->width = next;
+      }
+    }
+    MPI_Bcast(&s->width, 1, MPI_INT, 0, comm);
+  }
+
+  if (! success) {
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
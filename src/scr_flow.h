@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_FLOW_H
+#define SCR_FLOW_H
+
+#include "mpi.h"
+#include "axl.h"
+
+/*
+=========================================
+This file limits the number of processes that access the parallel file
+system at once.  Processes in a window of width ranks run together.
+Rank r waits for a token from rank r-width, and it passes a token to
+rank r+width as soon as it is done, so each process that finishes lets
+the next one start without a global barrier.  After each transfer, the
+width is moved up or down depending on whether the aggregate bandwidth
+improved over the last transfer.
+=========================================
+*/
+
+/* kinds of transfers, each adapts its own window */
+#define SCR_FLOW_FLUSH (0)
+#define SCR_FLOW_FETCH (1)
+
+/* wait for the token from the rank width below us in comm */
+void scr_flow_wait(int width, MPI_Comm comm);
+
+/* pass the token to the rank width above us in comm */
+void scr_flow_signal(int width, MPI_Comm comm);
+
+/* same as scr_axl, but at most a window of procs in comm transfer files
+ * at a time, where the window starts at SCR_FLUSH_WIDTH or
+ * SCR_FETCH_WIDTH depending on kind, returns the same value on all procs */
+int scr_flow_axl(
+  int kind,
+  const char* name,
+  int num_files,
+  const char** src_filelist,
+  const char** dest_filelist,
+  axl_xfer_t type,
+  MPI_Comm comm
+);
+
+#endif
@@ -16,6 +16,8 @@
 #include "kvtree_util.h"
 #include "dtcmp.h"
 
+#include <dirent.h>
+
 /*
 =========================================
 Prepare for flush by building list of files, creating directories,
@@ -122,80 +124,244 @@ int scr_flush_list_free(
   return SCR_SUCCESS;
 }
 
+/* given file list from flush_prepare, return the number of bytes
+ * in the files this process is flushing */
+double scr_flush_list_bytes(const kvtree* file_list)
+{
+  double bytes = 0.0;
+
+  kvtree* files = kvtree_get(file_list, SCR_KEY_FILE);
+  kvtree_elem* elem = NULL;
+  for (elem = kvtree_elem_first(files);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    /* get meta data for this file */
+    kvtree* hash = kvtree_elem_hash(elem);
+    scr_meta* meta = kvtree_get(hash, SCR_KEY_META);
+
+    /* add in its size */
+    unsigned long filesize;
+    if (scr_meta_get_filesize(meta, &filesize) == SCR_SUCCESS) {
+      bytes += (double) filesize;
+    }
+  }
+
+  return bytes;
+}
+
+/* record dir and each of its parents below base in dirs, mapped to
+ * their depth below base, a dir outside of base is recorded with
+ * depth 0 to be created along with any missing parents */
+static void scr_flush_dirs_add(kvtree* dirs, const char* base, const char* dir)
+{
+  if (strcmp(dir, base) == 0) {
+    return;
+  }
+
+  /* find where the part of dir below base starts */
+  size_t len = strlen(base);
+  size_t start;
+  if (strncmp(dir, base, len) != 0) {
+    start = 0;
+  } else if (len > 0 && base[len - 1] == '/') {
+    start = len;
+  } else if (dir[len] == '/') {
+    start = len + 1;
+  } else {
+    start = 0;
+  }
+  if (start == 0) {
+    kvtree_util_set_int(dirs, dir, 0);
+    return;
+  }
+
+  /* add the path up to each separator, then dir itself */
+  char* tmp = strdup(dir);
+  int depth = 0;
+  char* p;
+  for (p = tmp + start; ; p++) {
+    if (*p == '/' || *p == '\0') {
+      char c = *p;
+      *p = '\0';
+      depth++;
+      kvtree_util_set_int(dirs, tmp, depth);
+      if (c == '\0') {
+        break;
+      }
+      *p = c;
+    }
+  }
+  scr_free(&tmp);
+}
+
 /* create directories from basepath down to each file as needed */
 int scr_flush_create_dirs(
   const char* basepath,       /* top-level directory, assumed to exist */
   int count,                  /* number of files */
   const char** dest_filelist, /* list of files */
+  int mdt_count,              /* number of metadata targets to spread directories over */
   MPI_Comm comm)              /* communicator of participating processes */
 {
-  /* TODO: need to list dirs in order from parent to child */
+  int i;
 
-  /* allocate buffers to hold the directory needed for each file */
-  int* leader           = (int*)         SCR_MALLOC(sizeof(int)         * count);
-  const char** dirs     = (const char**) SCR_MALLOC(sizeof(const char*) * count);
-  uint64_t* group_id    = (uint64_t*)    SCR_MALLOC(sizeof(uint64_t)    * count);
-  uint64_t* group_ranks = (uint64_t*)    SCR_MALLOC(sizeof(uint64_t)    * count);
-  uint64_t* group_rank  = (uint64_t*)    SCR_MALLOC(sizeof(uint64_t)    * count);
+  /* reduce basepath so that it compares equal to the start of each dir */
+  spath* base_path = spath_from_str(basepath);
+  spath_reduce(base_path);
+  char* base = spath_strdup(base_path);
+  spath_delete(&base_path);
+
+  /* rank 0 lists the directories right below basepath once, so no one
+   * creates a tree at the top that already exists */
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  kvtree* existing = kvtree_new();
+  if (rank == 0) {
+    DIR* dirp = opendir(base);
+    struct dirent* de;
+    while (dirp != NULL && (de = readdir(dirp)) != NULL) {
+      if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+        continue;
+      }
+      int is_dir = (de->d_type == DT_DIR);
+      if (de->d_type == DT_UNKNOWN) {
+        struct stat st;
+        char* path = scr_strdupf("%s/%s", base, de->d_name);
+        is_dir = (stat(path, &st) == 0 && S_ISDIR(st.st_mode));
+        scr_free(&path);
+      }
+      if (is_dir) {
+        kvtree_set(existing, de->d_name, kvtree_new());
+      }
+    }
+    if (dirp != NULL) {
+      closedir(dirp);
+    }
+  }
+  kvtree_bcast(existing, 0, comm);
 
-  /* lookup directory from meta data for each file */
-  int i;
+  /* collect the directory of each file along with its parents, each
+   * one once, and note the directories that hold files */
+  kvtree* needed = kvtree_new();
+  kvtree* leaves = kvtree_new();
   for (i = 0; i < count; i++) {
-    /* extract directory from filename */
-    const char* filename = dest_filelist[i];
-    spath* path = spath_from_str(filename);
+    spath* path = spath_from_str(dest_filelist[i]);
+    spath_reduce(path);
     spath_dirname(path);
-    dirs[i] = spath_strdup(path);
+    char* dir = spath_strdup(path);
     spath_delete(&path);
 
-    /* we'll use DTCMP to select one leader for each directory later */
-    leader[i] = 0;
+    scr_flush_dirs_add(needed, base, dir);
+    kvtree_set(leaves, dir, kvtree_new());
+    scr_free(&dir);
   }
 
-  /* with DTCMP we identify a single process to create each directory */
+  /* list what is left to create along with its depth, a directory
+   * right below basepath is named in the listing after this offset */
+  size_t base_len = strlen(base);
+  size_t name_offset = (base_len > 0 && base[base_len - 1] == '/') ? base_len : base_len + 1;
+  int num_dirs = kvtree_size(needed);
+  const char** dirs  = (const char**) SCR_MALLOC((num_dirs + 1) * sizeof(const char*));
+  int* depths        = (int*)         SCR_MALLOC((num_dirs + 1) * sizeof(int));
+  int max_depth = 0;
+  int n = 0;
+  kvtree_elem* elem;
+  for (elem = kvtree_elem_first(needed);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    const char* dir = kvtree_elem_key(elem);
+    int depth = 0;
+    kvtree_util_get_int(needed, dir, &depth);
+
+    /* skip directories we found right below basepath, deeper
+     * directories are not listed, so we still call mkdir on those
+     * and an existing one just returns EEXIST */
+    if (depth == 1 && kvtree_get(existing, dir + name_offset) != NULL) {
+      continue;
+    }
 
-  /* identify the set of unique directories */
+    dirs[n]   = dir;
+    depths[n] = depth;
+    n++;
+    if (depth > max_depth) {
+      max_depth = depth;
+    }
+  }
+
+  /* with DTCMP we identify a single process to create each directory */
+  uint64_t* group_id    = (uint64_t*) SCR_MALLOC((n + 1) * sizeof(uint64_t));
+  uint64_t* group_ranks = (uint64_t*) SCR_MALLOC((n + 1) * sizeof(uint64_t));
+  uint64_t* group_rank  = (uint64_t*) SCR_MALLOC((n + 1) * sizeof(uint64_t));
   uint64_t groups;
   DTCMP_Rankv_strings(
-    count, dirs, &groups, group_id, group_ranks, group_rank,
+    n, dirs, &groups, group_id, group_ranks, group_rank,
     DTCMP_FLAG_NONE, comm
   );
 
-  /* select leader for each directory */
-  for (i = 0; i < count; i++) {
-    if (group_rank[i] == 0) {
-      leader[i] = 1;
-    }
-  }
+  /* everyone steps through the same number of levels */
+  int levels;
+  scr_allreduce(&max_depth, &levels, 1, MPI_INT, MPI_MAX, comm);
 
   /* get file mode for directory permissions */
   mode_t mode_dir = scr_getmode(1, 1, 1);
 
-  /* TODO: add flow control here */
-
-  /* create other directories in file list */
+  /* create directories a level at a time from the top, so that each
+   * leader makes a single mkdir call for its directory */
+  int width = scr_flush_width;
   int success = 1;
-  for (i = 0; i < count; i++) {
-    /* get directory name */
-    const char* dir = dirs[i];
-
-    /* if we're the leader, create directory */
-    if (leader[i]) {
-      if (scr_mkdir(dir, mode_dir) != SCR_SUCCESS) {
+  int level;
+  for (level = 0; level <= levels; level++) {
+    /* limit the number of procs creating directories at once */
+    scr_flow_wait(width, comm);
+
+    for (i = 0; i < n; i++) {
+      if (depths[i] != level || group_rank[i] != 0) {
+        continue;
+      }
+      const char* dir = dirs[i];
+
+      if (level == 0) {
+        /* a directory outside of basepath may need its parents too */
+        if (scr_mkdir(dir, mode_dir) != SCR_SUCCESS) {
+          success = 0;
+        }
+      } else if (mdt_count > 1 && groups >= (uint64_t) mdt_count &&
+                 kvtree_get(leaves, dir) != NULL)
+      {
+        /* spread directories that hold files over metadata targets
+         * when there are enough of them */
+        int mdt = (int) (group_id[i] % (uint64_t) mdt_count);
+        if (scr_layout_dir_create(dir, mode_dir, mdt) != SCR_SUCCESS) {
+          success = 0;
+        }
+      } else if (mkdir(dir, mode_dir) != 0 && errno != EEXIST) {
+        scr_err("Creating directory: mkdir(%s, %x) errno=%d %s @ %s:%d",
+          dir, mode_dir, errno, strerror(errno), __FILE__, __LINE__
+        );
         success = 0;
       }
     }
 
-    /* free the dirname we strdup'd */
-    scr_free(&dir);
+    /* let the next proc create its directories */
+    scr_flow_signal(width, comm);
+
+    /* parents must exist before anyone creates their children */
+    if (level < levels) {
+      MPI_Barrier(comm);
+    }
   }
 
   /* free buffers */
   scr_free(&group_id);
   scr_free(&group_ranks);
   scr_free(&group_rank);
+  scr_free(&depths);
   scr_free(&dirs);
-  scr_free(&leader);
+  kvtree_delete(&leaves);
+  kvtree_delete(&needed);
+  kvtree_delete(&existing);
+  scr_free(&base);
 
   /* determine whether all leaders successfully created their directories */
   if (! scr_alltrue(success == 1, comm)) {
@@ -204,6 +370,189 @@ int scr_flush_create_dirs(
   return SCR_SUCCESS;
 }
 
+/* create each destination file with a layout picked from its size
+ * under the rules of store s before the transfer writes it */
+int scr_flush_layout_files(
+  const scr_storedesc* s,
+  const kvtree* file_list,
+  int count,
+  const char** src_filelist,
+  const char** dst_filelist)
+{
+  if (s == NULL || s->stripe_bytes == 0) {
+    return SCR_SUCCESS;
+  }
+
+  int rc = SCR_SUCCESS;
+  int i;
+  for (i = 0; i < count; i++) {
+    /* look up size of the file from its meta data */
+    kvtree* files = kvtree_get(file_list, SCR_KEY_FILE);
+    kvtree* file_hash = kvtree_get(files, src_filelist[i]);
+    scr_meta* meta = kvtree_get(file_hash, SCR_KEY_META);
+    unsigned long filesize;
+    if (scr_meta_get_filesize(meta, &filesize) != SCR_SUCCESS) {
+      continue;
+    }
+
+    /* files we fail to lay out are written with the default layout */
+    if (scr_layout_file_create(s, dst_filelist[i], filesize) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+  }
+  return rc;
+}
+
+/* add an entry for the given destination file to the rank2file list,
+ * recorded relative to the prefix directory, and return its hash */
+kvtree* scr_flush_rank2file_add(kvtree* filelist, const char* file)
+{
+  /* compute path relative to prefix directory */
+  spath* base = spath_from_str(scr_prefix);
+  spath* dest = spath_from_str(file);
+  spath* rel = spath_relative(base, dest);
+  char* relfile = spath_strdup(rel);
+
+  kvtree* file_hash = kvtree_set_kv(filelist, "FILE", relfile);
+
+  scr_free(&relfile);
+  spath_delete(&rel);
+  spath_delete(&dest);
+  spath_delete(&base);
+
+  return file_hash;
+}
+
+/* copy the size and checksum recorded in the cache meta data of src_file
+ * in file_list to its rank2file entry, so fetch can verify the file */
+void scr_flush_rank2file_meta(kvtree* file_hash, const kvtree* file_list, const char* src_file)
+{
+  kvtree* hash = kvtree_get_kv(file_list, SCR_KEY_FILE, src_file);
+  scr_meta* meta = kvtree_get(hash, SCR_KEY_META);
+  if (meta == NULL) {
+    return;
+  }
+
+  unsigned long size;
+  if (scr_meta_get_filesize(meta, &size) == SCR_SUCCESS) {
+    scr_meta_set_filesize(file_hash, size);
+  }
+
+  int type;
+  uint64_t value;
+  if (scr_meta_get_checksum(meta, &type, &value) == SCR_SUCCESS) {
+    scr_meta_set_checksum(file_hash, type, value);
+  }
+}
+
+/* move files that were written through to their destination when the
+ * application completed them to the end of the lists, and return the
+ * number of files left to copy at the front */
+int scr_flush_list_through(
+  const kvtree* file_list,
+  int count,
+  char** src_filelist,
+  char** dst_filelist,
+  double* skipped)
+{
+  int kept = 0;
+  int i;
+  for (i = 0; i < count; i++) {
+    /* the file must have been copied to where we flush it,
+     * and the copy must still be whole */
+    int through = 0;
+    kvtree* hash = kvtree_get_kv(file_list, SCR_KEY_FILE, src_filelist[i]);
+    scr_meta* meta = kvtree_get(hash, SCR_KEY_META);
+    char* dest;
+    unsigned long size;
+    if (kvtree_util_get_str(meta, SCR_META_KEY_THROUGH, &dest) == KVTREE_SUCCESS &&
+        strcmp(dest, dst_filelist[i]) == 0 &&
+        scr_meta_get_filesize(meta, &size) == SCR_SUCCESS &&
+        scr_file_size(dst_filelist[i]) == size)
+    {
+      through = 1;
+      *skipped += (double) size;
+    }
+
+    if (! through) {
+      char* src = src_filelist[i];
+      char* dst = dst_filelist[i];
+      src_filelist[i] = src_filelist[kept];
+      dst_filelist[i] = dst_filelist[kept];
+      src_filelist[kept] = src;
+      dst_filelist[kept] = dst;
+      kept++;
+    }
+  }
+  return kept;
+}
+
+/* compress each source file into its destination file and record
+ * codec and sizes in rank2file list */
+int scr_flush_compress_files(
+  int type,
+  int count,
+  const char** src_filelist,
+  const char** dst_filelist,
+  kvtree* filelist,
+  double* moved)
+{
+  int rc = SCR_SUCCESS;
+  *moved = 0.0;
+
+  int i;
+  for (i = 0; i < count; i++) {
+    /* can't compress a file onto itself, so leave it as is */
+    if (strcmp(src_filelist[i], dst_filelist[i]) == 0) {
+      continue;
+    }
+
+    /* compress file into prefix directory */
+    unsigned long size, compsize;
+    if (scr_compress_file(src_filelist[i], dst_filelist[i], type,
+        scr_file_buf_size, &size, &compsize, NULL) != SCR_SUCCESS)
+    {
+      rc = SCR_FAILURE;
+      continue;
+    }
+
+    scr_dbg(2, "Compressed %s from %lu to %lu bytes with %s",
+      src_filelist[i], size, compsize, scr_compress_type_to_str(type)
+    );
+
+    /* record codec and sizes so fetch can restore the original file */
+    kvtree* file_hash = scr_flush_rank2file_add(filelist, dst_filelist[i]);
+    scr_meta_set_filesize(file_hash, size);
+    scr_meta_set_compress(file_hash, type, compsize);
+    *moved += (double) compsize;
+  }
+
+  return rc;
+}
+
+/* returns 1 on all procs if any proc holds a segment of a shared file
+ * in dataset id, only a synchronous flush writes segments back into
+ * their shared files */
+int scr_flush_has_segments(const scr_cache_index* cindex, int id)
+{
+  int have = 0;
+  scr_filemap* map = scr_filemap_new();
+  scr_cache_get_map(cindex, id, map);
+  kvtree_elem* elem;
+  for (elem = scr_filemap_first_file(map);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    if (scr_segment_is(kvtree_elem_key(elem))) {
+      have = 1;
+      break;
+    }
+  }
+  scr_filemap_delete(&map);
+
+  return ! scr_alltrue(! have, scr_comm_world);
+}
+
 /* given a dataset, return a newly allocated string specifying the
  * metadata directory for that dataset, must be freed by caller */
 char* scr_flush_dataset_metadir(const scr_dataset* dataset)
@@ -232,8 +581,17 @@ int scr_flush_prepare(const scr_cache_index* cindex, int id, kvtree* file_list)
   /* assume we'll succeed */
   int rc = SCR_SUCCESS;
 
-  /* check that we have all of our files */
+  /* the flush reads files directly, so write out any that
+   * were deduplicated or compressed in cache */
   int have_files = 1;
+  if (scr_cache_dedup_restore(cindex, id) != SCR_SUCCESS) {
+    have_files = 0;
+  }
+  if (scr_cache_compress_restore(cindex, id) != SCR_SUCCESS) {
+    have_files = 0;
+  }
+
+  /* check that we have all of our files */
   if (scr_cache_check_files(cindex, id) != SCR_SUCCESS) {
     scr_err("Missing one or more files for dataset %d @ %s:%d",
       id, __FILE__, __LINE__
@@ -350,6 +708,11 @@ static int scr_flush_summary(
       kvtree_merge(dataset_hash, dataset);
       kvtree_set(summary_hash, SCR_SUMMARY_6_KEY_DATASET, dataset_hash);
 
+      /* record the number of ranks, so tools can size the dataset
+       * without opening every shard of the rank2file map */
+      kvtree* rank2file_hash = kvtree_set(summary_hash, SCR_SUMMARY_6_KEY_RANK2FILE, kvtree_new());
+      kvtree_util_set_int(rank2file_hash, SCR_SUMMARY_6_KEY_RANKS, scr_ranks_world);
+
       /* write the hash to a file */
       ssize_t write_rc = kvtree_write_fd(summary_file, fd, summary_hash);
       if (write_rc < 0) {
@@ -385,6 +748,10 @@ int scr_flush_init_index(scr_dataset* dataset)
 {
   int rc = SCR_SUCCESS;
 
+  /* finish deleting older datasets before we write files
+   * that may land in the same directories */
+  scr_prefix_wait();
+
   /* update index file */
   if (scr_my_rank_world == 0) {
     /* read the index file */
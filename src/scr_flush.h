@@ -32,14 +32,66 @@ int scr_flush_list_free(
   char*** ptr_dst_filelist
 );
 
+/* given file list from flush_prepare, return the number of bytes
+ * in the files this process is flushing */
+double scr_flush_list_bytes(const kvtree* file_list);
+
 /* create directories from basepath down to each file as needed */
 int scr_flush_create_dirs(
   const char* basepath,       /* top-level directory, assumed to exist */
   int count,                  /* number of files */
   const char** dest_filelist, /* list of files */
+  int mdt_count,              /* number of metadata targets to spread directories over */
   MPI_Comm comm               /* communicator of participating processes */
 );
 
+/* create each destination file with a layout picked from its size
+ * under the rules of store s before the transfer writes it */
+int scr_flush_layout_files(
+  const scr_storedesc* s,     /* store the files are flushed from */
+  const kvtree* file_list,    /* file list from flush_prepare */
+  int count,                  /* number of files */
+  const char** src_filelist,  /* list of files in cache */
+  const char** dst_filelist   /* list of files in prefix directory */
+);
+
+/* add an entry for the given destination file to the rank2file list,
+ * recorded relative to the prefix directory, and return its hash */
+kvtree* scr_flush_rank2file_add(kvtree* filelist, const char* file);
+
+/* copy the size and checksum recorded in the cache meta data of src_file
+ * in file_list to its rank2file entry, so fetch can verify the file */
+void scr_flush_rank2file_meta(kvtree* file_hash, const kvtree* file_list, const char* src_file);
+
+/* move files that were written through to their destination when the
+ * application completed them to the end of the lists, and return the
+ * number of files left to copy at the front, adds the bytes of the
+ * files that need no copy to skipped */
+int scr_flush_list_through(
+  const kvtree* file_list,    /* file list from flush_prepare */
+  int count,                  /* number of files */
+  char** src_filelist,        /* list of files in cache */
+  char** dst_filelist,        /* list of files in prefix directory */
+  double* skipped             /* number of bytes already written */
+);
+
+/* compress each source file into its destination file with the given
+ * SCR_COMPRESS_* codec, and record the codec and the original and
+ * compressed sizes of each file in the rank2file list */
+int scr_flush_compress_files(
+  int type,                   /* SCR_COMPRESS_* codec to apply */
+  int count,                  /* number of files */
+  const char** src_filelist,  /* list of files in cache */
+  const char** dst_filelist,  /* list of files in prefix directory */
+  kvtree* filelist,           /* rank2file list for this process */
+  double* moved               /* number of compressed bytes written */
+);
+
+/* returns 1 on all procs if any proc holds a segment of a shared file
+ * in dataset id, only a synchronous flush writes segments back into
+ * their shared files */
+int scr_flush_has_segments(const scr_cache_index* cindex, int id);
+
 /* given a dataset, return a newly allocated string specifying the
  * metadata directory for that dataset, must be freed by caller */
 char* scr_flush_dataset_metadir(const scr_dataset* dataset);
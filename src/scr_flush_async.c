@@ -16,27 +16,214 @@
 #include "kvtree_util.h"
 #include "axl_mpi.h"
 
+#include <pthread.h>
+
 #define ASYNC_KEY_OUT_NAME "NAME"
 #define ASYNC_KEY_OUT_AXL  "AXL"
 
-/* records the time the async flush started */
-static time_t scr_flush_async_timestamp_start;
+/* the ways the files of a dataset may be moved during async flush */
+#define SCR_FLUSH_ASYNC_AXL      (0) /* a single AXL transfer for all files */
+#define SCR_FLUSH_ASYNC_THROTTLE (1) /* background thread pacing its copies to a bandwidth limit */
+#define SCR_FLUSH_ASYNC_COMPRESS (2) /* background thread compressing files */
+#define SCR_FLUSH_ASYNC_DRAIN    (3) /* staged through the drain store */
+
+/* tracks background thread that compresses files into the prefix
+ * directory in place of AXL when the store enables compression */
+typedef struct {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  int     active;       /* whether the thread was started for current flush */
+  int     done;         /* set by the thread once all files are written */
+  int     rc;           /* return code from compressing files */
+  int     type;         /* SCR_COMPRESS_* codec to apply */
+  int     count;        /* number of files to compress */
+  char**  src_filelist; /* list of files in cache */
+  char**  dst_filelist; /* list of files in prefix directory */
+  kvtree* filelist;     /* rank2file list, written once sizes are known */
+  double  moved;        /* number of compressed bytes written */
+} scr_flush_async_compress_t;
+
+static scr_flush_async_compress_t scr_flush_async_compress = {
+  .lock   = PTHREAD_MUTEX_INITIALIZER,
+  .active = 0,
+};
+
+/* tracks files of a dataset copied by a background thread to hold the
+ * flush to SCR_FLUSH_ASYNC_BW, each process fills a token bucket at
+ * its share of the limit for its node, and the thread draws each buffer
+ * it copies from the bucket and sleeps while the bucket is in debt */
+typedef struct {
+  pthread_t thread;
+  int     active;       /* whether the thread was started */
+  int     done;         /* set by the thread once all files are copied */
+  int     stop;         /* tells the thread to give up */
+  int     count;        /* number of files to flush */
+  int     rc;           /* whether any file failed to transfer */
+  char**  src_filelist; /* list of files in cache */
+  char**  dst_filelist; /* list of files in prefix directory */
+  double  backlog;      /* bytes not yet transferred */
+} scr_flush_async_throttle_t;
+
+/* tracks a dataset being flushed */
+typedef struct {
+  int     id;              /* id of dataset */
+  int     method;          /* SCR_FLUSH_ASYNC_* method moving its files */
+  int     flushed;         /* whether we have detected failure at any point */
+  time_t  timestamp_start; /* time the flush started */
+  double  time_start;      /* time the flush started from MPI_Wtime */
+  kvtree* file_list;       /* list of files written with flush */
+  char*   rankfile;        /* path to rankfile for flush */
+  double  bytes;           /* bytes this process flushes */
+  double  moved;           /* bytes this process is known to have flushed */
+  int     dst_count;       /* number of files in lists below */
+  char**  dst_filelist;    /* where each file lands in prefix directory */
+  unsigned long* dst_sizes; /* size of each file in cache */
+  scr_flush_async_throttle_t throttle; /* files left to pace with THROTTLE */
+} scr_flush_async_t;
+
+/* datasets being flushed, oldest first, flushes complete in this order */
+static scr_flush_async_t* scr_flush_async_queue = NULL;
+static int scr_flush_async_queue_size = 0;
+static int scr_flush_async_count = 0;
+
+/* tracks AXL id for outstanding transfers */
+static kvtree* scr_flush_async_axl_list = NULL;
 
-/* records the time the async flush started from MPI_Wtime */
-static double scr_flush_async_time_start;
+/* current rate limit of this process in bytes/sec, adapted between flushes,
+ * along with the configured limit and the tokens in the bucket, the lock
+ * guards these and the progress of paced flushes against their threads,
+ * and the gate is cleared while a paced flush is waited on */
+static pthread_mutex_t scr_throttle_lock = PTHREAD_MUTEX_INITIALIZER;
+static int    scr_throttle_gate        = 1;
+static double scr_flush_async_rate     = 0.0;
+static double scr_flush_async_max_rate = 0.0;
+static double scr_flush_async_tokens   = 0.0;
+static double scr_flush_async_last     = 0.0;
+
+/* time of last call to SCR_Need_checkpoint, and the average time
+ * between calls while no flush is running */
+static double scr_flush_async_need_last = 0.0;
+static double scr_flush_async_need_base = 0.0;
+
+/* bytes this process has flushed so far for queued flush e, paced
+ * flushes count each buffer as it is copied, other methods only tell
+ * us once the whole transfer is done, so until then we count what has
+ * arrived in the prefix directory, this undercounts files that are
+ * compressed or still on the drain store, which errs on the side of
+ * a longer estimate */
+static double scr_flush_async_moved(const scr_flush_async_t* e)
+{
+  if (e->moved >= e->bytes) {
+    return e->moved;
+  }
 
-/* tracks list of files written with flush */
-static kvtree* scr_flush_async_file_list = NULL;
+  if (e->method == SCR_FLUSH_ASYNC_THROTTLE) {
+    pthread_mutex_lock(&scr_throttle_lock);
+    double moved = e->bytes - e->throttle.backlog;
+    pthread_mutex_unlock(&scr_throttle_lock);
+    return moved;
+  }
 
-/* tracks AXL id for outstanding transfer */
-static kvtree* scr_flush_async_axl_list = NULL;
+  double moved = 0.0;
+  int i;
+  for (i = 0; i < e->dst_count; i++) {
+    unsigned long size = scr_file_size(e->dst_filelist[i]);
+    if (size > e->dst_sizes[i]) {
+      size = e->dst_sizes[i];
+    }
+    moved += (double) size;
+  }
+  return moved;
+}
 
-/* path to rankfile for ongoing flush */
-static char* scr_flush_async_rankfile = NULL;
+/* remember where each file of flush e lands and its size,
+ * so we can measure progress of transfers that do not report it */
+static void scr_flush_async_track(
+  scr_flush_async_t* e,
+  int count,
+  char** src_filelist,
+  char** dst_filelist)
+{
+  e->dst_count = 0;
+  if (count <= 0) {
+    return;
+  }
 
-/* flag indicating whether we have detected failure
- * at any point in process of async flush */
-static int scr_flush_async_flushed = SCR_FAILURE;
+  e->dst_filelist = (char**) SCR_MALLOC(count * sizeof(char*));
+  e->dst_sizes    = (unsigned long*) SCR_MALLOC(count * sizeof(unsigned long));
+
+  int i;
+  for (i = 0; i < count; i++) {
+    unsigned long size = 0;
+    kvtree* hash = kvtree_get_kv(e->file_list, SCR_KEY_FILE, src_filelist[i]);
+    scr_meta* meta = kvtree_get(hash, SCR_KEY_META);
+    scr_meta_get_filesize(meta, &size);
+    e->dst_filelist[i] = strdup(dst_filelist[i]);
+    e->dst_sizes[i]    = size;
+  }
+  e->dst_count = count;
+}
+
+/* return the queued flush of dataset id, or NULL if there is none */
+static scr_flush_async_t* scr_flush_async_find(int id)
+{
+  int i;
+  for (i = 0; i < scr_flush_async_count; i++) {
+    if (scr_flush_async_queue[i].id == id) {
+      return &scr_flush_async_queue[i];
+    }
+  }
+  return NULL;
+}
+
+/* returns 1 if any queued flush moves its files with method */
+static int scr_flush_async_uses(int method)
+{
+  int i;
+  for (i = 0; i < scr_flush_async_count; i++) {
+    if (scr_flush_async_queue[i].method == method) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* update globals that describe the queue */
+static void scr_flush_async_update(void)
+{
+  scr_flush_async_in_progress = scr_flush_async_count;
+  if (scr_flush_async_count > 0) {
+    scr_flush_async_dataset_id = scr_flush_async_queue[0].id;
+  }
+}
+
+/* drop the flush at position index from the queue */
+static void scr_flush_async_remove(int index)
+{
+  scr_flush_async_t* e = &scr_flush_async_queue[index];
+  kvtree_delete(&e->file_list);
+  scr_free(&e->rankfile);
+
+  int i;
+  for (i = 0; i < e->dst_count; i++) {
+    scr_free(&e->dst_filelist[i]);
+  }
+  scr_free(&e->dst_filelist);
+  scr_free(&e->dst_sizes);
+  e->dst_count = 0;
+
+  for (i = index + 1; i < scr_flush_async_count; i++) {
+    scr_flush_async_queue[i - 1] = scr_flush_async_queue[i];
+  }
+  scr_flush_async_count--;
+  scr_flush_async_update();
+}
+
+/* drop the oldest flush from the queue */
+static void scr_flush_async_pop(void)
+{
+  scr_flush_async_remove(0);
+}
 
 /*
 =========================================
@@ -54,13 +241,14 @@ static int scr_axl_start(
 {
   int rc = SCR_SUCCESS;
 
-  /* define a transfer handle */
-  int id = AXL_Create_comm(xfer_type, name, NULL, comm);
+  /* define a transfer handle, whether everyone succeeded is checked
+   * along with adding the files below */
+  int id = AXL_Create(xfer_type, name, NULL);
   if (id < 0) {
     scr_err("Failed to create AXL transfer handle @ %s:%d",
       __FILE__, __LINE__
     );
-    return SCR_FAILURE;
+    rc = SCR_FAILURE;
   }
 
   /* create record for this transfer in outstanding list, and record AXL id */
@@ -69,7 +257,7 @@ static int scr_axl_start(
 
   /* add files to transfer list */
   int i;
-  for (i = 0; i < num_files; i++) {
+  for (i = 0; i < num_files && id >= 0; i++) {
     const char* src_file = src_filelist[i];
     const char* dst_file = dst_filelist[i];
     if (AXL_Add(id, src_file, dst_file) != AXL_SUCCESS) {
@@ -86,7 +274,7 @@ static int scr_axl_start(
     kvtree_unset_kv(scr_flush_async_axl_list, ASYNC_KEY_OUT_NAME, name);
 
     /* release the handle */
-    if (AXL_Free_comm(id, comm) != AXL_SUCCESS) {
+    if (id >= 0 && AXL_Free(id) != AXL_SUCCESS) {
       scr_err("Failed to free AXL transfer handle %d @ %s:%d",
         id, __FILE__, __LINE__
       );
@@ -136,8 +324,8 @@ static int scr_axl_wait(const char* name, MPI_Comm comm)
   int id;
   kvtree* name_hash = kvtree_get_kv(scr_flush_async_axl_list, ASYNC_KEY_OUT_NAME, name);
   if (kvtree_util_get_int(name_hash, ASYNC_KEY_OUT_AXL, &id) == KVTREE_SUCCESS) {
-    /* test whether transfer is still active */
-    if (AXL_Wait_comm(id, comm) != AXL_SUCCESS) {
+    /* wait for our part of the transfer */
+    if (AXL_Wait(id) != AXL_SUCCESS) {
       scr_err("Failed to wait on AXL transfer handle %d @ %s:%d",
         id, __FILE__, __LINE__
       );
@@ -145,7 +333,7 @@ static int scr_axl_wait(const char* name, MPI_Comm comm)
     }
 
     /* release the handle */
-    if (AXL_Free_comm(id, comm) != AXL_SUCCESS) {
+    if (AXL_Free(id) != AXL_SUCCESS) {
       scr_err("Failed to free AXL transfer handle %d @ %s:%d",
         id, __FILE__, __LINE__
       );
@@ -159,9 +347,605 @@ static int scr_axl_wait(const char* name, MPI_Comm comm)
     rc = SCR_FAILURE;
   }
 
+  /* agree on the result of the wait and the free with one allreduce */
+  if (! scr_alltrue(rc == SCR_SUCCESS, comm)) {
+    rc = SCR_FAILURE;
+  }
+
   return rc;
 }
 
+/* cancel an outstanding transfer and release its handle,
+ * this only affects our own files and takes no communication */
+static int scr_axl_cancel(const char* name)
+{
+  int rc = SCR_SUCCESS;
+
+  /* lookup AXL id in outstanding list */
+  int id;
+  kvtree* name_hash = kvtree_get_kv(scr_flush_async_axl_list, ASYNC_KEY_OUT_NAME, name);
+  if (kvtree_util_get_int(name_hash, ASYNC_KEY_OUT_AXL, &id) == KVTREE_SUCCESS) {
+    if (AXL_Cancel(id) != AXL_SUCCESS) {
+      scr_err("Failed to cancel AXL transfer handle %d @ %s:%d",
+        id, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+
+    /* a cancelled transfer still needs to be waited on before it can be freed */
+    AXL_Wait(id);
+    if (AXL_Free(id) != AXL_SUCCESS) {
+      scr_err("Failed to free AXL transfer handle %d @ %s:%d",
+        id, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+
+    /* delete entry for this transfer from AXL list */
+    kvtree_unset_kv(scr_flush_async_axl_list, ASYNC_KEY_OUT_NAME, name);
+  }
+
+  return rc;
+}
+
+/* compress files in the background */
+static void* scr_compress_thread(void* arg)
+{
+  scr_flush_async_compress_t* c = (scr_flush_async_compress_t*) arg;
+
+  double moved;
+  int rc = scr_flush_compress_files(c->type, c->count,
+    (const char**) c->src_filelist, (const char**) c->dst_filelist, c->filelist, &moved
+  );
+
+  pthread_mutex_lock(&c->lock);
+  c->rc    = rc;
+  c->moved = moved;
+  c->done  = 1;
+  pthread_mutex_unlock(&c->lock);
+
+  return NULL;
+}
+
+/* free file lists held by compression state */
+static void scr_compress_free(scr_flush_async_compress_t* c)
+{
+  if (c->src_filelist != NULL) {
+    scr_flush_list_free(c->count, &c->src_filelist, &c->dst_filelist);
+  }
+  kvtree_delete(&c->filelist);
+  c->count = 0;
+}
+
+/* start thread to compress files, takes ownership of file lists */
+static int scr_compress_start(
+  int type,
+  int num_files,
+  char** src_filelist,
+  char** dst_filelist,
+  kvtree* filelist,
+  MPI_Comm comm)
+{
+  scr_flush_async_compress_t* c = &scr_flush_async_compress;
+  c->done         = 0;
+  c->rc           = SCR_SUCCESS;
+  c->moved        = 0.0;
+  c->type         = type;
+  c->count        = num_files;
+  c->src_filelist = src_filelist;
+  c->dst_filelist = dst_filelist;
+  c->filelist     = filelist;
+
+  int rc = SCR_SUCCESS;
+  if (pthread_create(&c->thread, NULL, scr_compress_thread, c) == 0) {
+    c->active = 1;
+  } else {
+    scr_err("Failed to create thread to compress files @ %s:%d",
+      __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  /* if any process failed to start, wait for others and give up */
+  if (! scr_alltrue(rc == SCR_SUCCESS, comm)) {
+    if (c->active) {
+      pthread_join(c->thread, NULL);
+      c->active = 0;
+    }
+    scr_compress_free(c);
+    return SCR_FAILURE;
+  }
+
+  return rc;
+}
+
+/* returns SCR_SUCCESS if all processes have compressed their files */
+static int scr_compress_test(MPI_Comm comm)
+{
+  scr_flush_async_compress_t* c = &scr_flush_async_compress;
+
+  pthread_mutex_lock(&c->lock);
+  int done = c->done;
+  pthread_mutex_unlock(&c->lock);
+
+  if (! scr_alltrue(done, comm)) {
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
+
+/* wait for thread to finish, then write rank2file with compressed sizes,
+ * returns total bytes written by all procs in moved on rank 0 of comm */
+static int scr_compress_wait(const char* rankfile, double* moved, MPI_Comm comm)
+{
+  scr_flush_async_compress_t* c = &scr_flush_async_compress;
+
+  int rc = SCR_SUCCESS;
+  if (c->active) {
+    pthread_join(c->thread, NULL);
+    c->active = 0;
+    rc = c->rc;
+  } else {
+    rc = SCR_FAILURE;
+  }
+
+  /* save our file list to disk */
+  if (c->filelist != NULL) {
+    scr_rank2file_write(rankfile, c->filelist, comm);
+  }
+  scr_compress_free(c);
+
+  /* total up compressed bytes written by all procs */
+  MPI_Reduce(&c->moved, moved, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+
+  if (! scr_alltrue(rc == SCR_SUCCESS, comm)) {
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
+
+/* returns 1 if any queued flush is being paced */
+static int scr_throttle_active(void)
+{
+  return scr_flush_async_uses(SCR_FLUSH_ASYNC_THROTTLE);
+}
+
+/* report the current rate and the bytes left to flush */
+static void scr_throttle_stats(void)
+{
+  double backlog = 0.0;
+  int i;
+  pthread_mutex_lock(&scr_throttle_lock);
+  for (i = 0; i < scr_flush_async_count; i++) {
+    scr_flush_async_t* e = &scr_flush_async_queue[i];
+    if (e->method == SCR_FLUSH_ASYNC_THROTTLE) {
+      backlog += e->throttle.backlog;
+    }
+  }
+  double rate = scr_flush_async_rate;
+  pthread_mutex_unlock(&scr_throttle_lock);
+
+  int active = scr_throttle_active();
+  scr_stats_set_flush(active ? rate : 0.0, backlog);
+}
+
+/* add tokens for the time since we last added them,
+ * keep at most one second worth so idle time does not turn into a burst,
+ * called with scr_throttle_lock held */
+static void scr_throttle_refill(void)
+{
+  double now = MPI_Wtime();
+  scr_flush_async_tokens += scr_flush_async_rate * (now - scr_flush_async_last);
+  if (scr_flush_async_tokens > scr_flush_async_rate) {
+    scr_flush_async_tokens = scr_flush_async_rate;
+  }
+  scr_flush_async_last = now;
+}
+
+/* draw bytes just copied from the bucket, and sleep while the bucket is
+ * in debt unless the flush is being waited on, returns 1 if the thread
+ * has been asked to stop */
+static int scr_throttle_take(scr_flush_async_throttle_t* t, double bytes)
+{
+  pthread_mutex_lock(&scr_throttle_lock);
+  t->backlog -= bytes;
+  scr_throttle_refill();
+  scr_flush_async_tokens -= bytes;
+  while (scr_throttle_gate && ! t->stop && scr_flush_async_tokens < 0.0) {
+    /* wake up now and then to pick up a new rate or a request to stop */
+    double wait = -scr_flush_async_tokens / scr_flush_async_rate;
+    if (wait > 0.1) {
+      wait = 0.1;
+    }
+    pthread_mutex_unlock(&scr_throttle_lock);
+    usleep((useconds_t) (wait * 1.0e6));
+    pthread_mutex_lock(&scr_throttle_lock);
+    scr_throttle_refill();
+  }
+  int stop = t->stop;
+  pthread_mutex_unlock(&scr_throttle_lock);
+  return stop;
+}
+
+/* copy src to dst a buffer at a time, drawing each buffer from the bucket */
+static int scr_throttle_copy(scr_flush_async_throttle_t* t, const char* src, const char* dst, char* buf)
+{
+  int rc = SCR_SUCCESS;
+
+  int fd_src = scr_open(src, O_RDONLY);
+  if (fd_src < 0) {
+    scr_err("Opening file to copy: scr_open(%s) errno=%d %s @ %s:%d",
+      src, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* the file may already exist with the layout picked for it */
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int fd_dst = scr_open(dst, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (fd_dst < 0) {
+    scr_err("Opening file for write: scr_open(%s) errno=%d %s @ %s:%d",
+      dst, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_close(src, fd_src);
+    return SCR_FAILURE;
+  }
+
+  while (1) {
+    ssize_t nread = scr_read(src, fd_src, buf, scr_file_buf_size);
+    if (nread < 0) {
+      rc = SCR_FAILURE;
+      break;
+    }
+    if (nread == 0) {
+      break;
+    }
+
+    ssize_t nwrite = scr_write(dst, fd_dst, buf, (size_t) nread);
+    if (nwrite != nread) {
+      rc = SCR_FAILURE;
+      break;
+    }
+
+    /* give up if we've been asked to stop */
+    if (scr_throttle_take(t, (double) nwrite)) {
+      rc = SCR_FAILURE;
+      break;
+    }
+  }
+
+  if (scr_close(dst, fd_dst) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  scr_close(src, fd_src);
+
+  return rc;
+}
+
+/* copy the files of a paced flush in the background */
+static void* scr_throttle_thread(void* arg)
+{
+  scr_flush_async_throttle_t* t = (scr_flush_async_throttle_t*) arg;
+
+  int rc = SCR_SUCCESS;
+  char* buf = (char*) SCR_MALLOC(scr_file_buf_size);
+  int i;
+  for (i = 0; i < t->count && rc == SCR_SUCCESS; i++) {
+    if (scr_throttle_copy(t, t->src_filelist[i], t->dst_filelist[i], buf) != SCR_SUCCESS) {
+      scr_err("Failed to copy %s to %s @ %s:%d",
+        t->src_filelist[i], t->dst_filelist[i], __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+  }
+  scr_free(&buf);
+
+  pthread_mutex_lock(&scr_throttle_lock);
+  t->rc   = rc;
+  t->done = 1;
+  pthread_mutex_unlock(&scr_throttle_lock);
+
+  return NULL;
+}
+
+/* returns 1 if every file has been transferred */
+static int scr_throttle_done(scr_flush_async_throttle_t* t)
+{
+  pthread_mutex_lock(&scr_throttle_lock);
+  int done = t->done;
+  pthread_mutex_unlock(&scr_throttle_lock);
+  return done;
+}
+
+/* start the thread of the oldest paced flush that still has files
+ * to send, paced flushes share the bucket and go out oldest first */
+static void scr_throttle_progress(void)
+{
+  int i;
+  for (i = 0; i < scr_flush_async_count; i++) {
+    scr_flush_async_t* e = &scr_flush_async_queue[i];
+    if (e->method != SCR_FLUSH_ASYNC_THROTTLE) {
+      continue;
+    }
+
+    scr_flush_async_throttle_t* t = &e->throttle;
+    if (! t->active && ! scr_throttle_done(t)) {
+      if (pthread_create(&t->thread, NULL, scr_throttle_thread, t) == 0) {
+        t->active = 1;
+      } else {
+        scr_err("Failed to create thread to flush files @ %s:%d",
+          __FILE__, __LINE__
+        );
+        t->rc   = SCR_FAILURE;
+        t->done = 1;
+      }
+    }
+
+    /* newer flushes wait until this one has sent all of its files */
+    if (! scr_throttle_done(t)) {
+      break;
+    }
+  }
+
+  scr_throttle_stats();
+}
+
+/* free the file lists of a paced flush */
+static void scr_throttle_free(scr_flush_async_throttle_t* t)
+{
+  scr_flush_list_free(t->count, &t->src_filelist, &t->dst_filelist);
+  t->count = 0;
+}
+
+/* stop the thread of a paced flush and drop its files */
+static void scr_throttle_cancel(scr_flush_async_throttle_t* t)
+{
+  if (t->active) {
+    pthread_mutex_lock(&scr_throttle_lock);
+    t->stop = 1;
+    pthread_mutex_unlock(&scr_throttle_lock);
+    pthread_join(t->thread, NULL);
+    t->active = 0;
+  }
+  scr_throttle_free(t);
+}
+
+/* start flushing files in the background, takes ownership of file lists */
+static int scr_throttle_start(
+  scr_flush_async_throttle_t* t,
+  int num_files,
+  char** src_filelist,
+  char** dst_filelist)
+{
+  t->count        = num_files;
+  t->active       = 0;
+  t->done         = (num_files == 0);
+  t->stop         = 0;
+  t->rc           = SCR_SUCCESS;
+  t->src_filelist = src_filelist;
+  t->dst_filelist = dst_filelist;
+
+  double backlog = 0.0;
+  int i;
+  for (i = 0; i < num_files; i++) {
+    backlog += (double) scr_file_size(src_filelist[i]);
+  }
+
+  /* the limit applies to each node, so split it among the processes on the node */
+  int ranks_node;
+  MPI_Comm_size(scr_comm_node, &ranks_node);
+
+  /* start even so the first bytes go out right away,
+   * unless earlier flushes are still drawing on the bucket */
+  int paced = 0;
+  for (i = 0; i < scr_flush_async_count; i++) {
+    if (scr_flush_async_queue[i].method == SCR_FLUSH_ASYNC_THROTTLE) {
+      paced++;
+    }
+  }
+
+  pthread_mutex_lock(&scr_throttle_lock);
+  t->backlog = backlog;
+  scr_flush_async_max_rate = scr_flush_async_bw / (double) ranks_node;
+
+  /* start at the limit, or keep the rate we adapted to in earlier flushes */
+  if (scr_flush_async_rate <= 0.0 || scr_flush_async_rate > scr_flush_async_max_rate) {
+    scr_flush_async_rate = scr_flush_async_max_rate;
+  }
+
+  if (paced <= 1) {
+    scr_flush_async_tokens = 0.0;
+    scr_flush_async_last   = MPI_Wtime();
+  }
+  pthread_mutex_unlock(&scr_throttle_lock);
+
+  scr_throttle_progress();
+
+  return SCR_SUCCESS;
+}
+
+/* wait for all files of a paced flush to be transferred, ignoring the bucket */
+static int scr_throttle_wait(scr_flush_async_throttle_t* t, MPI_Comm comm)
+{
+  /* older flushes have completed, so this one has its thread */
+  pthread_mutex_lock(&scr_throttle_lock);
+  scr_throttle_gate = 0;
+  pthread_mutex_unlock(&scr_throttle_lock);
+  scr_throttle_progress();
+
+  if (t->active) {
+    pthread_join(t->thread, NULL);
+    t->active = 0;
+  }
+
+  pthread_mutex_lock(&scr_throttle_lock);
+  scr_throttle_gate = 1;
+  pthread_mutex_unlock(&scr_throttle_lock);
+
+  int rc = t->rc;
+  scr_throttle_free(t);
+
+  if (! scr_alltrue(rc == SCR_SUCCESS, comm)) {
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
+
+/* called from SCR_Need_checkpoint, lowers the rate of an ongoing flush if
+ * the time between calls grows by more than SCR_FLUSH_ASYNC_PERCENT over
+ * the time between calls while no flush runs, and raises it back toward
+ * the limit otherwise, then starts the next paced flush if allowed */
+int scr_flush_async_progress(void)
+{
+  double now = MPI_Wtime();
+  pthread_mutex_lock(&scr_throttle_lock);
+  if (scr_flush_async_need_last > 0.0) {
+    double interval = now - scr_flush_async_need_last;
+    if (! scr_throttle_active()) {
+      /* track a running average of the time between calls without a flush */
+      if (scr_flush_async_need_base > 0.0) {
+        scr_flush_async_need_base = 0.75 * scr_flush_async_need_base + 0.25 * interval;
+      } else {
+        scr_flush_async_need_base = interval;
+      }
+    } else if (scr_flush_async_percent > 0.0 && scr_flush_async_need_base > 0.0) {
+      double slowdown = 100.0 * (interval - scr_flush_async_need_base) / scr_flush_async_need_base;
+      if (slowdown > scr_flush_async_percent) {
+        /* back off quickly, but keep moving */
+        scr_flush_async_rate *= 0.5;
+        if (scr_flush_async_rate < scr_flush_async_max_rate / 64.0) {
+          scr_flush_async_rate = scr_flush_async_max_rate / 64.0;
+        }
+      } else if (slowdown < scr_flush_async_percent / 2.0) {
+        scr_flush_async_rate *= 1.25;
+        if (scr_flush_async_rate > scr_flush_async_max_rate) {
+          scr_flush_async_rate = scr_flush_async_max_rate;
+        }
+      }
+    }
+  }
+  scr_flush_async_need_last = now;
+  pthread_mutex_unlock(&scr_throttle_lock);
+
+  scr_throttle_progress();
+
+  return SCR_SUCCESS;
+}
+
+/* determine how the files of dataset id would be flushed */
+static int scr_flush_async_method(scr_cache_index* cindex, int id)
+{
+  const scr_storedesc* storedesc = scr_cache_get_storedesc(cindex, id);
+  int compress = storedesc->compress;
+  if (compress == SCR_COMPRESS_NONE && scr_drain_enabled()) {
+    return SCR_FLUSH_ASYNC_DRAIN;
+  } else if (compress != SCR_COMPRESS_NONE) {
+    return SCR_FLUSH_ASYNC_COMPRESS;
+  } else if (scr_flush_async_bw > 0.0) {
+    return SCR_FLUSH_ASYNC_THROTTLE;
+  }
+  return SCR_FLUSH_ASYNC_AXL;
+}
+
+/* complete the oldest flush if it is done, otherwise sleep to get out of the way */
+static void scr_flush_async_step(scr_cache_index* cindex)
+{
+  int id = scr_flush_async_queue[0].id;
+  if (scr_flush_async_test(cindex, id) == SCR_SUCCESS) {
+    scr_flush_async_complete(cindex, id);
+  } else {
+    usleep(10*1000*1000);
+  }
+}
+
+/* complete older flushes until a flush of dataset id may be queued,
+ * the queue holds at most SCR_FLUSH_ASYNC_DEPTH flushes and leaves room
+ * in the store for the next dataset, while compression and the drain
+ * store each serve a single flush at a time */
+static void scr_flush_async_reserve(scr_cache_index* cindex, int id)
+{
+  int method = scr_flush_async_method(cindex, id);
+
+  int limit = scr_flush_async_queue_size;
+  const scr_storedesc* storedesc = scr_cache_get_storedesc(cindex, id);
+  if (storedesc != NULL && storedesc->max_count - 1 < limit) {
+    limit = storedesc->max_count - 1;
+  }
+  if (limit < 1) {
+    limit = 1;
+  }
+
+  int exclusive = (method == SCR_FLUSH_ASYNC_COMPRESS || method == SCR_FLUSH_ASYNC_DRAIN);
+  while (scr_flush_async_count > 0 &&
+         (scr_flush_async_count >= limit || (exclusive && scr_flush_async_uses(method))))
+  {
+    scr_flush_async_step(cindex);
+  }
+}
+
+/* with the latest-wins policy, cancel flushes of pure checkpoints that
+ * are superseded by a flush of checkpoint id, and delete the files they
+ * have written so far from the prefix directory, flushes that compress
+ * or stage through the drain store can't be interrupted, so let them run */
+static void scr_flush_async_supersede(scr_cache_index* cindex, int id)
+{
+  /* only a checkpoint supersedes older checkpoints */
+  scr_dataset* dataset = scr_dataset_new();
+  scr_cache_index_get_dataset(cindex, id, dataset);
+  int is_ckpt = scr_dataset_is_ckpt(dataset);
+  scr_dataset_delete(&dataset);
+  if (! is_ckpt) {
+    return;
+  }
+
+  int i = 0;
+  while (i < scr_flush_async_count) {
+    scr_flush_async_t* e = &scr_flush_async_queue[i];
+    if (e->method != SCR_FLUSH_ASYNC_AXL && e->method != SCR_FLUSH_ASYNC_THROTTLE) {
+      i++;
+      continue;
+    }
+
+    /* output datasets must reach the prefix directory */
+    scr_dataset* old = scr_dataset_new();
+    scr_cache_index_get_dataset(cindex, e->id, old);
+    char* name = NULL;
+    scr_dataset_get_name(old, &name);
+    if (! scr_dataset_is_ckpt(old) || scr_dataset_is_output(old)) {
+      scr_dataset_delete(&old);
+      i++;
+      continue;
+    }
+
+    if (scr_my_rank_world == 0) {
+      scr_dbg(1, "Cancelling async flush of dataset %d `%s' superseded by dataset %d",
+        e->id, name, id
+      );
+      if (scr_log_enable) {
+        double time_diff = MPI_Wtime() - e->time_start;
+        scr_log_event("ASYNC_FLUSH_CANCEL", "Superseded by newer checkpoint",
+                      &e->id, name, NULL, &time_diff);
+      }
+    }
+
+    /* stop moving its files */
+    if (e->method == SCR_FLUSH_ASYNC_THROTTLE) {
+      scr_throttle_cancel(&e->throttle);
+    } else {
+      scr_axl_cancel(name);
+    }
+
+    /* clean up whatever made it to the prefix directory */
+    scr_flush_file_location_unset(e->id, SCR_FLUSH_KEY_LOCATION_FLUSHING);
+    scr_prefix_delete(e->id, name);
+
+    scr_dataset_delete(&old);
+    scr_flush_async_remove(i);
+  }
+
+  scr_throttle_stats();
+}
+
 /* stop all ongoing asynchronous flush operations */
 int scr_flush_async_stop()
 {
@@ -175,15 +959,33 @@ int scr_flush_async_stop()
     return SCR_FAILURE;
   }
 
-  /* remove FLUSHING state from flush file */
-  scr_flush_async_in_progress = 0;
-  /*
-  scr_flush_file_location_unset(id, SCR_FLUSH_KEY_LOCATION_FLUSHING);
-  */
+  /* stop copying files through the drain store */
+  scr_drain_stop();
 
-  /* clear internal flush_async variables to indicate there is no flush */
-  kvtree_delete(&scr_flush_async_file_list);
-  scr_free(&scr_flush_async_rankfile);
+  /* AXL has stopped any files in flight, stop paced flushes, and drop the rest */
+  while (scr_flush_async_count > 0) {
+    scr_flush_async_t* e = &scr_flush_async_queue[0];
+    if (e->method == SCR_FLUSH_ASYNC_THROTTLE) {
+      scr_throttle_cancel(&e->throttle);
+    }
+
+    /* remove FLUSHING state from flush file */
+    /*
+    scr_flush_file_location_unset(e->id, SCR_FLUSH_KEY_LOCATION_FLUSHING);
+    */
+
+    /* clear internal flush_async variables to indicate there is no flush */
+    scr_flush_async_pop();
+  }
+  scr_throttle_stats();
+
+  /* compression can't be interrupted, so let it finish and drop the results */
+  scr_flush_async_compress_t* c = &scr_flush_async_compress;
+  if (c->active) {
+    pthread_join(c->thread, NULL);
+    c->active = 0;
+    scr_compress_free(c);
+  }
 
   /* make sure all processes have made it this far before we leave */
   MPI_Barrier(scr_comm_world);
@@ -199,6 +1001,16 @@ int scr_flush_async_start(scr_cache_index* cindex, int id)
     return SCR_SUCCESS;
   }
 
+  scr_trace_mark_begin("flush_start");
+
+  /* drop flushes of checkpoints this one supersedes */
+  if (scr_flush_async_latest) {
+    scr_flush_async_supersede(cindex, id);
+  }
+
+  /* wait for older flushes to complete until this one fits in the queue */
+  scr_flush_async_reserve(cindex, id);
+
   /* get the dataset corresponding to this id */
   scr_dataset* dataset = scr_dataset_new();
   scr_cache_index_get_dataset(cindex, id, dataset);
@@ -215,51 +1027,61 @@ int scr_flush_async_start(scr_cache_index* cindex, int id)
   /* make sure all processes make it this far before progressing */
   MPI_Barrier(scr_comm_world);
 
+  /* add an entry to the end of the queue */
+  scr_flush_async_t* e = &scr_flush_async_queue[scr_flush_async_count];
+  memset(e, 0, sizeof(scr_flush_async_t));
+  e->id           = id;
+  e->method       = scr_flush_async_method(cindex, id);
+  scr_flush_async_count++;
+
   /* start timer */
+  e->time_start = MPI_Wtime();
   if (scr_my_rank_world == 0) {
-    scr_flush_async_timestamp_start = scr_log_seconds();
-    scr_flush_async_time_start = MPI_Wtime();
+    e->timestamp_start = scr_log_seconds();
 
     /* log the start of the flush */
     if (scr_log_enable) {
       scr_log_event("ASYNC_FLUSH_START", NULL, &id, dset_name,
-                    &scr_flush_async_timestamp_start, NULL);
+                    &e->timestamp_start, NULL);
     }
   }
 
   /* mark that we've started a flush */
-  scr_flush_async_in_progress = 1;
-  scr_flush_async_dataset_id = id;
+  scr_flush_async_update();
   scr_flush_file_location_set(id, SCR_FLUSH_KEY_LOCATION_FLUSHING);
 
   /* this flag will remember whether any stage fails */
-  scr_flush_async_flushed = SCR_SUCCESS;
+  e->flushed = SCR_SUCCESS;
 
   /* get list of files to flush */
-  scr_flush_async_file_list = kvtree_new();
-  if (scr_flush_prepare(cindex, id, scr_flush_async_file_list) != SCR_SUCCESS) {
+  e->file_list = kvtree_new();
+  if (scr_flush_prepare(cindex, id, e->file_list) != SCR_SUCCESS) {
     if (scr_my_rank_world == 0) {
       scr_err("scr_flush_async_start: Failed to prepare flush @ %s:%d",
         __FILE__, __LINE__
       );
       if (scr_log_enable) {
         double time_end = MPI_Wtime();
-        double time_diff = time_end - scr_flush_async_time_start;
+        double time_diff = time_end - e->time_start;
         scr_log_event("ASYNC_FLUSH_FAIL", "Failed to prepare flush",
                       &id, dset_name, NULL, &time_diff);
       }
     }
     scr_dataset_delete(&dataset);
-    kvtree_delete(&scr_flush_async_file_list);
-    scr_flush_async_flushed = SCR_FAILURE;
+    kvtree_delete(&e->file_list);
+    e->flushed = SCR_FAILURE;
+    scr_trace_mark_end("flush_start");
     return SCR_FAILURE;
   }
 
+  /* record how much this process has to flush to report progress */
+  e->bytes = scr_flush_list_bytes(e->file_list);
+
   /* allocate lists of source and destination paths */
   int numfiles;
   char** src_filelist;
   char** dst_filelist;
-  scr_flush_list_alloc(scr_flush_async_file_list, &numfiles, &src_filelist, &dst_filelist);
+  scr_flush_list_alloc(e->file_list, &numfiles, &src_filelist, &dst_filelist);
 
   /* create entry in index file to indicate that dataset may exist,
    * but is not yet complete */
@@ -286,7 +1108,7 @@ int scr_flush_async_start(scr_cache_index* cindex, int id)
 
   /* define path for rank2file map */
   spath_append_str(dataset_path, "rank2file");
-  scr_flush_async_rankfile = spath_strdup(dataset_path);
+  e->rankfile = spath_strdup(dataset_path);
   spath_delete(&dataset_path);
 
   /* build a list of files for this rank */
@@ -296,51 +1118,99 @@ int scr_flush_async_start(scr_cache_index* cindex, int id)
     /* get path to destination file */
     const char* filename = dst_filelist[i];
 
-    /* compute path relative to prefix directory */
-    spath* base = spath_from_str(scr_prefix);
-    spath* dest = spath_from_str(filename);
-    spath* rel = spath_relative(base, dest);
-    char* relfile = spath_strdup(rel);
+    /* record file relative to prefix directory, along with its size and checksum */
+    kvtree* file_hash = scr_flush_rank2file_add(filelist, filename);
+    scr_flush_rank2file_meta(file_hash, e->file_list, src_filelist[i]);
+  }
 
-    kvtree_set_kv(filelist, "FILE", relfile);
+  /* check whether files should be compressed as they are flushed */
+  const scr_storedesc* storedesc = scr_cache_get_storedesc(cindex, id);
+  int compress = storedesc->compress;
 
-    scr_free(&relfile);
-    spath_delete(&rel);
-    spath_delete(&dest);
-    spath_delete(&base);
+  /* save our file list to disk, if compressing we wait until we
+   * know the compressed size of each file */
+  if (compress == SCR_COMPRESS_NONE) {
+    scr_rank2file_write(e->rankfile, filelist, scr_comm_world);
+    kvtree_delete(&filelist);
   }
 
-  /* save our file list to disk */
-  kvtree_write_gather(scr_flush_async_rankfile, filelist, scr_comm_world);
-  kvtree_delete(&filelist);
-
   /* create directories */
-  scr_flush_create_dirs(scr_prefix, numfiles, (const char**) dst_filelist, scr_comm_world);
-
-  /* get AXL transfer type to use */
-  const scr_storedesc* storedesc = scr_cache_get_storedesc(cindex, id);
-  axl_xfer_t xfer_type = scr_xfer_str_to_axl_type(storedesc->xfer);
+  scr_flush_create_dirs(scr_prefix, numfiles, (const char**) dst_filelist,
+    storedesc->mdt_count, scr_comm_world
+  );
+
+  /* track progress of every file, including those already in place */
+  scr_flush_async_track(e, numfiles, src_filelist, dst_filelist);
+
+  /* files written through to the prefix directory as they were
+   * completed are already in place, so AXL only copies the rest */
+  if (e->method == SCR_FLUSH_ASYNC_THROTTLE || e->method == SCR_FLUSH_ASYNC_AXL) {
+    double through = 0.0;
+    int copy_files = scr_flush_list_through(e->file_list, numfiles,
+      src_filelist, dst_filelist, &through
+    );
+    for (i = copy_files; i < numfiles; i++) {
+      scr_free(&src_filelist[i]);
+      scr_free(&dst_filelist[i]);
+    }
+    numfiles = copy_files;
+  }
 
-  /* TODO: gather list of files to leader of store descriptor,
-   * use communicator of leaders for AXL, then bcast result back */
+  /* lay out files copied by AXL or the throttle based on their size */
+  if (e->method == SCR_FLUSH_ASYNC_THROTTLE || e->method == SCR_FLUSH_ASYNC_AXL) {
+    scr_flush_layout_files(storedesc, e->file_list, numfiles,
+      (const char**) src_filelist, (const char**) dst_filelist
+    );
+  }
 
-  /* start writing files via AXL */
   int rc = SCR_SUCCESS;
-  if (scr_axl_start(dset_name, numfiles, (const char**) src_filelist, (const char**) dst_filelist,
-    xfer_type, scr_comm_world) != SCR_SUCCESS)
-  {
-    /* failed to initiate AXL transfer */
-    /* TODO: auto delete files? */
-    rc = SCR_FAILURE;
-    scr_flush_async_flushed = SCR_FAILURE;
-  }
+  if (e->method == SCR_FLUSH_ASYNC_DRAIN) {
+    /* stage files through the drain store in the background,
+     * this hands our file lists over to the drain */
+    if (scr_drain_start(id, numfiles, src_filelist, dst_filelist,
+      scr_comm_world) != SCR_SUCCESS)
+    {
+      rc = SCR_FAILURE;
+      e->flushed = SCR_FAILURE;
+    }
+  } else if (e->method == SCR_FLUSH_ASYNC_COMPRESS) {
+    /* compress files into prefix directory in the background,
+     * this hands our file lists over to the compression thread */
+    if (scr_compress_start(compress, numfiles, src_filelist, dst_filelist,
+      filelist, scr_comm_world) != SCR_SUCCESS)
+    {
+      rc = SCR_FAILURE;
+      e->flushed = SCR_FAILURE;
+    }
+  } else if (e->method == SCR_FLUSH_ASYNC_THROTTLE) {
+    /* copy files in the background a buffer at a time to hold to the
+     * bandwidth limit, this hands our file lists over to the throttle */
+    scr_throttle_start(&e->throttle, numfiles, src_filelist, dst_filelist);
+  } else {
+    /* get AXL transfer type to use */
+    axl_xfer_t xfer_type = scr_xfer_str_to_axl_type(storedesc->xfer);
+
+    /* TODO: gather list of files to leader of store descriptor,
+     * use communicator of leaders for AXL, then bcast result back */
+
+    /* start writing files via AXL */
+    if (scr_axl_start(dset_name, numfiles, (const char**) src_filelist, (const char**) dst_filelist,
+      xfer_type, scr_comm_world) != SCR_SUCCESS)
+    {
+      /* failed to initiate AXL transfer */
+      /* TODO: auto delete files? */
+      rc = SCR_FAILURE;
+      e->flushed = SCR_FAILURE;
+    }
 
-  /* free our file list */
-  scr_flush_list_free(numfiles, &src_filelist, &dst_filelist);
+    /* free our file list */
+    scr_flush_list_free(numfiles, &src_filelist, &dst_filelist);
+  }
 
   /* free the dataset */
   scr_dataset_delete(&dataset);
 
+  scr_trace_mark_end("flush_start");
   return rc;
 }
 
@@ -349,11 +1219,15 @@ int scr_flush_async_start(scr_cache_index* cindex, int id)
  * can be completed with either success or error without waiting */
 int scr_flush_async_test(scr_cache_index* cindex, int id)
 {
-  /* if the transfer failed, indicate that transfer has completed */
-  if (scr_flush_async_flushed != SCR_SUCCESS) {
+  /* if there is no such flush or the transfer failed,
+   * indicate that transfer has completed */
+  scr_flush_async_t* e = scr_flush_async_find(id);
+  if (e == NULL || e->flushed != SCR_SUCCESS) {
     return SCR_SUCCESS;
   }
 
+  scr_trace_mark_begin("flush_test");
+
   /* get the dataset corresponding to this id */
   scr_dataset* dataset = scr_dataset_new();
   scr_cache_index_get_dataset(cindex, id, dataset);
@@ -364,19 +1238,51 @@ int scr_flush_async_test(scr_cache_index* cindex, int id)
 
   /* test whether transfer is done */
   int rc = SCR_SUCCESS;
-  if (scr_axl_test(dset_name, scr_comm_world) != SCR_SUCCESS) {
+  if (e->method == SCR_FLUSH_ASYNC_DRAIN) {
+    if (scr_drain_test(scr_comm_world) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+  } else if (e->method == SCR_FLUSH_ASYNC_COMPRESS) {
+    if (scr_compress_test(scr_comm_world) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+  } else if (e->method == SCR_FLUSH_ASYNC_THROTTLE) {
+    scr_throttle_progress();
+    if (! scr_alltrue(scr_throttle_done(&e->throttle), scr_comm_world)) {
+      rc = SCR_FAILURE;
+    }
+  } else if (scr_axl_test(dset_name, scr_comm_world) != SCR_SUCCESS) {
     rc = SCR_FAILURE;
   }
 
+  /* all of our bytes have arrived once the transfer can be completed */
+  if (rc == SCR_SUCCESS) {
+    e->moved = e->bytes;
+  }
+
   /* free the dataset */
   scr_dataset_delete(&dataset);
 
+  scr_trace_mark_end("flush_test");
   return rc;
 }
 
 /* complete the flush from cache to parallel file system */
 int scr_flush_async_complete(scr_cache_index* cindex, int id)
 {
+  /* nothing to do if this dataset is not being flushed */
+  if (scr_flush_async_find(id) == NULL) {
+    return SCR_FAILURE;
+  }
+
+  scr_trace_mark_begin("flush_complete");
+
+  /* flushes complete in the order they were started */
+  while (scr_flush_async_queue[0].id != id) {
+    scr_flush_async_complete(cindex, scr_flush_async_queue[0].id);
+  }
+  scr_flush_async_t* e = &scr_flush_async_queue[0];
+
   /* get the dataset corresponding to this id */
   scr_dataset* dataset = scr_dataset_new();
   scr_cache_index_get_dataset(cindex, id, dataset);
@@ -390,32 +1296,57 @@ int scr_flush_async_complete(scr_cache_index* cindex, int id)
   }
 
   /* TODO: wait on Filo if we failed to start? */
-  /* wait for transfer to complete */
-  if (scr_axl_wait(dset_name, scr_comm_world) != SCR_SUCCESS) {
-    scr_flush_async_flushed = SCR_FAILURE;
+  /* wait for transfer to complete, moved is set if bytes written
+   * to the prefix directory differs from the dataset size */
+  double moved_bytes = -1.0;
+  if (e->flushed != SCR_SUCCESS) {
+    /* the flush failed to start, so there is nothing to wait on */
+  } else if (e->method == SCR_FLUSH_ASYNC_DRAIN) {
+    if (scr_drain_wait(scr_comm_world) != SCR_SUCCESS) {
+      e->flushed = SCR_FAILURE;
+    }
+  } else if (e->method == SCR_FLUSH_ASYNC_COMPRESS) {
+    if (scr_compress_wait(e->rankfile, &moved_bytes, scr_comm_world) != SCR_SUCCESS) {
+      e->flushed = SCR_FAILURE;
+    }
+  } else if (e->method == SCR_FLUSH_ASYNC_THROTTLE) {
+    if (scr_throttle_wait(&e->throttle, scr_comm_world) != SCR_SUCCESS) {
+      e->flushed = SCR_FAILURE;
+    }
+  } else if (scr_axl_wait(dset_name, scr_comm_world) != SCR_SUCCESS) {
+    e->flushed = SCR_FAILURE;
   }
 
+  /* marking the dataset as flushed and clearing the flushing marker
+   * is a single update to the flush file */
+  scr_flush_file_batch_begin();
+
   /* write summary file */
-  if (scr_flush_async_flushed == SCR_SUCCESS &&
-      scr_flush_complete(cindex, id, scr_flush_async_file_list) != SCR_SUCCESS)
+  if (e->flushed == SCR_SUCCESS &&
+      scr_flush_complete(cindex, id, e->file_list) != SCR_SUCCESS)
   {
-    scr_flush_async_flushed = SCR_FAILURE;
+    e->flushed = SCR_FAILURE;
   }
 
   /* mark that we've stopped the flush */
-  scr_flush_async_in_progress = 0;
   scr_flush_file_location_unset(id, SCR_FLUSH_KEY_LOCATION_FLUSHING);
+  scr_flush_file_batch_end();
 
-  /* free the file list for this checkpoint */
-  kvtree_delete(&scr_flush_async_file_list);
-  scr_free(&scr_flush_async_rankfile);
+  /* record the bytes this process flushed */
+  double my_bytes = scr_flush_list_bytes(e->file_list);
+
+  /* remember what we need from the entry, then drop it from the queue */
+  int flushed = e->flushed;
+  double time_start = e->time_start;
+  time_t timestamp_start = e->timestamp_start;
+  scr_flush_async_pop();
+  e = NULL;
 
   /* stop timer, compute bandwidth, and report performance */
+  if (flushed == SCR_SUCCESS) {
+    scr_stats_record(SCR_STATS_FLUSH, my_bytes, MPI_Wtime() - time_start);
+  }
   if (scr_my_rank_world == 0) {
-    /* get the dataset corresponding to this id */
-    scr_dataset* dataset = scr_dataset_new();
-    scr_cache_index_get_dataset(cindex, id, dataset);
-
     /* get the number of bytes in the dataset */
     double total_bytes = 0.0;
     unsigned long dataset_bytes;
@@ -427,12 +1358,9 @@ int scr_flush_async_complete(scr_cache_index* cindex, int id)
     int total_files = 0.0;
     scr_dataset_get_files(dataset, &total_files);
 
-    /* delete the dataset object */
-    scr_dataset_delete(&dataset);
-
     /* stop timer and compute bandwidth */
     double time_end = MPI_Wtime();
-    double time_diff = time_end - scr_flush_async_time_start;
+    double time_diff = time_end - time_start;
     double bw = 0.0;
     if (time_diff > 0.0) {
       bw = scr_flush_async_bytes / (1024.0 * 1024.0 * time_diff);
@@ -442,7 +1370,7 @@ int scr_flush_async_complete(scr_cache_index* cindex, int id)
     );
 
     /* log messages about flush */
-    if (scr_flush_async_flushed == SCR_SUCCESS) {
+    if (flushed == SCR_SUCCESS) {
       /* the flush worked, print a debug message */
       scr_dbg(1, "scr_flush_async_complete: Flush of dataset succeeded %d `%s'", id, dset_name);
 
@@ -465,7 +1393,8 @@ int scr_flush_async_complete(scr_cache_index* cindex, int id)
       char* dir = NULL;
       scr_cache_index_get_dir(cindex, id, &dir);
       scr_log_transfer("FLUSH_ASYNC", dir, scr_prefix, &id, dset_name,
-        &scr_flush_async_timestamp_start, &time_diff, &total_bytes, &total_files
+        &timestamp_start, &time_diff, &total_bytes,
+        (moved_bytes >= 0.0) ? &moved_bytes : NULL, &total_files
       );
     }
   }
@@ -473,32 +1402,112 @@ int scr_flush_async_complete(scr_cache_index* cindex, int id)
   /* free the dataset */
   scr_dataset_delete(&dataset);
 
-  return scr_flush_async_flushed;
+  scr_trace_mark_end("flush_complete");
+  return flushed;
 }
 
-/* wait until the checkpoint currently being flushed completes */
-int scr_flush_async_wait(scr_cache_index* cindex)
+/* reduce bytes flushed by queued flushes across all procs and estimate
+ * percent complete, bandwidth in bytes/sec since the oldest flush started,
+ * and seconds until all queued flushes complete, eta is -1 if it can not
+ * be estimated yet, returns SCR_FAILURE if no flush is queued,
+ * must be called by all procs */
+int scr_flush_async_status(double* percent, double* bw, double* eta)
 {
-  if (scr_flush_async_in_progress) {
-    while (scr_flush_file_is_flushing(scr_flush_async_dataset_id)) {
-      /* test whether the flush has completed, and if so complete the flush */
-      if (scr_flush_async_test(cindex, scr_flush_async_dataset_id) == SCR_SUCCESS) {
-        /* complete the flush */
-        scr_flush_async_complete(cindex, scr_flush_async_dataset_id);
-      } else {
-        /* otherwise, sleep to get out of the way */
-        usleep(10*1000*1000);
-      }
+  *percent = 0.0;
+  *bw      = 0.0;
+  *eta     = -1.0;
+
+  if (scr_flush_async_count == 0) {
+    return SCR_FAILURE;
+  }
+
+  /* sum our bytes over the queue so we need a single allreduce */
+  double vals[2] = {0.0, 0.0};
+  int i;
+  for (i = 0; i < scr_flush_async_count; i++) {
+    scr_flush_async_t* e = &scr_flush_async_queue[i];
+    vals[0] += e->bytes;
+    vals[1] += scr_flush_async_moved(e);
+  }
+  double sums[2];
+  scr_allreduce(vals, sums, 2, MPI_DOUBLE, MPI_SUM, scr_comm_world);
+  double total = sums[0];
+  double moved = sums[1];
+
+  *percent = 100.0;
+  if (total > 0.0) {
+    *percent = 100.0 * moved / total;
+  }
+
+  /* the oldest flush has been running the longest, so measure from its start */
+  double secs = MPI_Wtime() - scr_flush_async_queue[0].time_start;
+  if (secs > 0.0) {
+    *bw = moved / secs;
+  }
+
+  if (moved >= total) {
+    *eta = 0.0;
+  } else if (*bw > 0.0) {
+    *eta = (total - moved) / *bw;
+  }
+
+  return SCR_SUCCESS;
+}
+
+/* returns 1 if dataset id is queued for async flush */
+int scr_flush_async_pending(int id)
+{
+  return (scr_flush_async_find(id) != NULL);
+}
+
+/* complete the oldest flushes until at most count remain */
+int scr_flush_async_wait_count(scr_cache_index* cindex, int count)
+{
+  if (scr_flush_async_count > count) {
+    double start = MPI_Wtime();
+    while (scr_flush_async_count > count) {
+      scr_flush_async_step(cindex);
     }
+    scr_stats_add(SCR_STATS_EV_FLUSH_WAIT, MPI_Wtime() - start);
   }
   return SCR_SUCCESS;
 }
 
+/* complete flushes in order until dataset id is no longer being flushed */
+int scr_flush_async_wait_id(scr_cache_index* cindex, int id)
+{
+  if (scr_flush_async_find(id) != NULL) {
+    double start = MPI_Wtime();
+    while (scr_flush_async_find(id) != NULL) {
+      scr_flush_async_step(cindex);
+    }
+    scr_stats_add(SCR_STATS_EV_FLUSH_WAIT, MPI_Wtime() - start);
+  }
+  return SCR_SUCCESS;
+}
+
+/* wait until all datasets currently being flushed complete */
+int scr_flush_async_wait(scr_cache_index* cindex)
+{
+  return scr_flush_async_wait_count(cindex, 0);
+}
+
 /* start any processes for later asynchronous flush operations */
 int scr_flush_async_init()
 {
   scr_flush_async_axl_list = kvtree_new();
 
+  /* allocate space to track each flush we may have in flight */
+  scr_flush_async_queue_size = scr_flush_async_depth;
+  if (scr_flush_async_queue_size < 1) {
+    scr_flush_async_queue_size = 1;
+  }
+  scr_flush_async_queue = (scr_flush_async_t*) SCR_MALLOC(
+    scr_flush_async_queue_size * sizeof(scr_flush_async_t)
+  );
+  scr_flush_async_count = 0;
+  scr_flush_async_update();
+
   return SCR_SUCCESS;
 }
 
@@ -506,6 +1515,8 @@ int scr_flush_async_init()
 int scr_flush_async_finalize()
 {
   kvtree_delete(&scr_flush_async_axl_list);
+  scr_free(&scr_flush_async_queue);
+  scr_flush_async_queue_size = 0;
 
   return SCR_SUCCESS;
 }
@@ -26,7 +26,26 @@ int scr_flush_async_test(scr_cache_index* cindex, int id);
 /* complete the flush from cache to parallel file system */
 int scr_flush_async_complete(scr_cache_index* cindex, int id);
 
-/* wait until the checkpoint currently being flushed completes */
+/* pace an ongoing flush and adapt its rate, called from SCR_Need_checkpoint */
+int scr_flush_async_progress(void);
+
+/* reduce bytes flushed by queued flushes across all procs and estimate
+ * percent complete, bandwidth in bytes/sec since the oldest flush started,
+ * and seconds until all queued flushes complete, eta is -1 if it can not
+ * be estimated yet, returns SCR_FAILURE if no flush is queued,
+ * must be called by all procs */
+int scr_flush_async_status(double* percent, double* bw, double* eta);
+
+/* returns 1 if dataset id is queued for async flush */
+int scr_flush_async_pending(int id);
+
+/* complete the oldest flushes until at most count remain */
+int scr_flush_async_wait_count(scr_cache_index* cindex, int count);
+
+/* complete flushes in order until dataset id is no longer being flushed */
+int scr_flush_async_wait_id(scr_cache_index* cindex, int id);
+
+/* wait until all datasets currently being flushed complete */
 int scr_flush_async_wait(scr_cache_index* cindex);
 
 /* initialize the async transfer processes */
@@ -54,6 +54,20 @@ int print_usage()
   printf("  --need-flush <id>  Exit with 0 if checkpoint needs to be flushed, 1 otherwise\n");
   printf("  --location <id>    Print location of specified id\n");
   printf("  --name <id>        Print name of specified id\n");
+  printf("  --batch            Read queries from stdin, one per line, and answer each\n");
+  printf("\n");
+  printf("  BATCH QUERIES:\n");
+  printf("\n");
+  printf("  datasets                 List all dataset ids in ascending order\n");
+  printf("  list-output [<before>]   Same as --list-output\n");
+  printf("  list-ckpt [<before>]     Same as --list-ckpt\n");
+  printf("  need-flush <id>          Same as --need-flush\n");
+  printf("  location <id>            Same as --location\n");
+  printf("  name <id>                Same as --name\n");
+  printf("  latest                   Same as --latest\n");
+  printf("\n");
+  printf("  Each answer is printed as one line: the query, a tab, the exit code\n");
+  printf("  the single query would have, a tab, and its output if any.\n");
   printf("\n");
   exit(1);
 }
@@ -67,6 +81,7 @@ struct arglist {
   int latest;     /* return the id of the latest (most recent) dataset in cache */
   int location;   /* return the location of dataset with specified id in cache */
   int name;       /* dataset name (label) */
+  int batch;      /* read queries from stdin */
 };
 
 int process_args(int argc, char **argv, struct arglist* args)
@@ -84,6 +99,7 @@ int process_args(int argc, char **argv, struct arglist* args)
     {"latest",      no_argument,       NULL, 'l'},
     {"location",    required_argument, NULL, 'L'},
     {"name",        required_argument, NULL, 's'},
+    {"batch",       no_argument,       NULL, 'B'},
     {"help",        no_argument,       NULL, 'h'},
     {0, 0, 0, 0}
   };
@@ -97,6 +113,7 @@ int process_args(int argc, char **argv, struct arglist* args)
   args->latest     = 0;
   args->location   = -1;
   args->name       = -1;
+  args->batch      = 0;
 
   /* loop through and process all options */
   int c;
@@ -155,6 +172,11 @@ int process_args(int argc, char **argv, struct arglist* args)
         args->name = tmp_dset;
         ++opCount;
         break;
+      case 'B':
+        /* read queries from stdin */
+        args->batch = 1;
+        ++opCount;
+        break;
       case 'h':
         /* print help message and exit */
         print_usage();
@@ -189,6 +211,267 @@ int process_args(int argc, char **argv, struct arglist* args)
   return 1;
 }
 
+/* what we need to know about one dataset in the flush file */
+typedef struct {
+  int id;               /* dataset id */
+  int ckpt;             /* whether dataset is a checkpoint */
+  int output;           /* whether dataset is output */
+  int on_pfs;           /* whether dataset has the PFS location marker */
+  int has_location;     /* whether dataset has a location hash */
+  const char* location; /* first location of dataset, NULL if none */
+  const char* name;     /* name of dataset, NULL if none */
+} scr_flush_entry;
+
+/* the flush file reduced to an array of datasets sorted by id, so
+ * that many queries are answered from a single read of the file,
+ * strings point into the hash the index was built from */
+typedef struct {
+  int num;                 /* number of datasets */
+  scr_flush_entry* dsets;  /* datasets in ascending order of id */
+} scr_flush_index;
+
+/* build index of datasets from flush file hash */
+static void scr_flush_index_build(const kvtree* hash, scr_flush_index* index)
+{
+  index->num   = 0;
+  index->dsets = NULL;
+
+  /* get ids in ascending order */
+  kvtree* dset_hash = kvtree_get(hash, SCR_FLUSH_KEY_DATASET);
+  if (dset_hash == NULL) {
+    return;
+  }
+  int num;
+  int* list;
+  kvtree_list_int(dset_hash, &num, &list);
+  if (num == 0) {
+    scr_free(&list);
+    return;
+  }
+
+  index->dsets = (scr_flush_entry*) SCR_MALLOC(num * sizeof(scr_flush_entry));
+  index->num   = num;
+
+  int i;
+  for (i = 0; i < num; i++) {
+    scr_flush_entry* entry = &index->dsets[i];
+    kvtree* dhash = kvtree_getf(dset_hash, "%d", list[i]);
+
+    entry->id = list[i];
+
+    int flag;
+    entry->ckpt = 0;
+    if (kvtree_util_get_int(dhash, SCR_FLUSH_KEY_CKPT, &flag) == KVTREE_SUCCESS) {
+      entry->ckpt = (flag == 1);
+    }
+    entry->output = 0;
+    if (kvtree_util_get_int(dhash, SCR_FLUSH_KEY_OUTPUT, &flag) == KVTREE_SUCCESS) {
+      entry->output = (flag == 1);
+    }
+
+    kvtree* location_hash = kvtree_get(dhash, SCR_FLUSH_KEY_LOCATION);
+    entry->has_location = (location_hash != NULL);
+    entry->on_pfs = (kvtree_elem_get(location_hash, SCR_FLUSH_KEY_LOCATION_PFS) != NULL);
+    entry->location = NULL;
+    kvtree_elem* loc_elem = kvtree_elem_first(location_hash);
+    if (loc_elem != NULL) {
+      entry->location = kvtree_elem_key(loc_elem);
+    }
+
+    char* name = NULL;
+    kvtree_util_get_str(dhash, SCR_FLUSH_KEY_NAME, &name);
+    entry->name = name;
+  }
+
+  /* free sorted list of ints */
+  scr_free(&list);
+}
+
+/* free index of datasets */
+static void scr_flush_index_free(scr_flush_index* index)
+{
+  scr_free(&index->dsets);
+  index->num = 0;
+}
+
+/* returns entry of dataset with given id, NULL if not in flush file */
+static const scr_flush_entry* scr_flush_index_find(const scr_flush_index* index, int id)
+{
+  /* binary search the sorted ids */
+  int low  = 0;
+  int high = index->num - 1;
+  while (low <= high) {
+    int mid = low + (high - low) / 2;
+    int mid_id = index->dsets[mid].id;
+    if (mid_id == id) {
+      return &index->dsets[mid];
+    } else if (mid_id < id) {
+      low = mid + 1;
+    } else {
+      high = mid - 1;
+    }
+  }
+  return NULL;
+}
+
+/* print ids of datasets before given id (or all if before is 0) that
+ * are checkpoints if ckpt is set or output otherwise, in descending
+ * order if descend is set, returns 0 if any id is printed */
+static int scr_flush_query_list(FILE* out, const scr_flush_index* index, int ckpt, int before, int descend)
+{
+  int found_one = 0;
+  int i;
+  for (i = 0; i < index->num; i++) {
+    const scr_flush_entry* entry = &index->dsets[descend ? index->num - 1 - i : i];
+    int flag = ckpt ? entry->ckpt : entry->output;
+    if (flag && (before == 0 || entry->id < before)) {
+      if (found_one) {
+        fprintf(out, " ");
+      }
+      fprintf(out, "%d", entry->id);
+      found_one = 1;
+    }
+  }
+  return found_one ? 0 : 1;
+}
+
+/* print ids of all datasets in ascending order,
+ * returns 0 if any id is printed */
+static int scr_flush_query_datasets(FILE* out, const scr_flush_index* index)
+{
+  int i;
+  for (i = 0; i < index->num; i++) {
+    if (i > 0) {
+      fprintf(out, " ");
+    }
+    fprintf(out, "%d", index->dsets[i].id);
+  }
+  return (index->num > 0) ? 0 : 1;
+}
+
+/* returns 0 if we have the dataset but it lacks the PFS location
+ * marker, meaning that it still needs to be flushed */
+static int scr_flush_query_need_flush(const scr_flush_index* index, int id)
+{
+  const scr_flush_entry* entry = scr_flush_index_find(index, id);
+  if (entry != NULL && ! entry->on_pfs) {
+    return 0;
+  }
+  return 1;
+}
+
+/* print location of dataset, returns 0 if it has a location hash */
+static int scr_flush_query_location(FILE* out, const scr_flush_index* index, int id)
+{
+  const scr_flush_entry* entry = scr_flush_index_find(index, id);
+  if (entry == NULL || ! entry->has_location) {
+    /* if specified dataset is not found, we return error */
+    return 1;
+  }
+
+  if (entry->location != NULL) {
+    /* if the location exists in the file, print it */
+    fprintf(out, "%s", entry->location);
+  } else {
+    /* if there is no location information for some reason,
+     * print none */
+    fprintf(out, "NONE");
+  }
+  return 0;
+}
+
+/* print name of dataset, returns 0 if it has one */
+static int scr_flush_query_name(FILE* out, const scr_flush_index* index, int id)
+{
+  const scr_flush_entry* entry = scr_flush_index_find(index, id);
+  if (entry != NULL && entry->name != NULL) {
+    fprintf(out, "%s", entry->name);
+    return 0;
+  }
+  return 1;
+}
+
+/* print id of most recent dataset, returns 0 if there is one */
+static int scr_flush_query_latest(FILE* out, const scr_flush_index* index)
+{
+  if (index->num > 0) {
+    fprintf(out, "%d", index->dsets[index->num - 1].id);
+    return 0;
+  }
+  return 1;
+}
+
+/* answers one batch query, printing any output and returning the exit
+ * code the equivalent single query would have */
+static int scr_flush_query(FILE* out, const scr_flush_index* index, const char* query)
+{
+  char op[32];
+  int id = 0;
+  int count = sscanf(query, "%31s %d", op, &id);
+  if (count < 1) {
+    return 1;
+  }
+
+  if (strcmp(op, "datasets") == 0) {
+    return scr_flush_query_datasets(out, index);
+  } else if (strcmp(op, "list-output") == 0) {
+    return scr_flush_query_list(out, index, 0, id, 0);
+  } else if (strcmp(op, "list-ckpt") == 0) {
+    return scr_flush_query_list(out, index, 1, id, 1);
+  } else if (strcmp(op, "latest") == 0) {
+    return scr_flush_query_latest(out, index);
+  }
+
+  /* remaining queries take a positive dataset id */
+  if (count < 2 || id <= 0) {
+    scr_err("%s: Query requires a dataset id '%s'", PROG, query);
+    return 1;
+  }
+
+  if (strcmp(op, "need-flush") == 0) {
+    return scr_flush_query_need_flush(index, id);
+  } else if (strcmp(op, "location") == 0) {
+    return scr_flush_query_location(out, index, id);
+  } else if (strcmp(op, "name") == 0) {
+    return scr_flush_query_name(out, index, id);
+  }
+
+  scr_err("%s: Unknown query '%s'", PROG, query);
+  return 1;
+}
+
+/* read queries from stdin until EOF and print an answer line for each */
+static void scr_flush_batch(const scr_flush_index* index)
+{
+  char line[256];
+  while (fgets(line, sizeof(line), stdin) != NULL) {
+    /* strip trailing newline */
+    size_t len = strlen(line);
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+      line[--len] = '\0';
+    }
+
+    /* skip blank lines */
+    if (strspn(line, " \t") == len) {
+      continue;
+    }
+
+    /* collect the output of the query so that we can print the query
+     * text first to match up answers, then the exit code, then the output */
+    char* buf = NULL;
+    size_t size = 0;
+    FILE* out = open_memstream(&buf, &size);
+    if (out == NULL) {
+      printf("%s\t1\t\n", line);
+      continue;
+    }
+    int query_rc = scr_flush_query(out, index, line);
+    fclose(out);
+    printf("%s\t%d\t%s\n", line, query_rc, (buf != NULL) ? buf : "");
+    free(buf);
+  }
+}
+
 int main (int argc, char *argv[])
 {
   /* process command line arguments */
@@ -219,177 +502,82 @@ int main (int argc, char *argv[])
   /* create a new hash to hold the file data */
   kvtree* hash = kvtree_new();
 
+  /* index of datasets in the flush file */
+  scr_flush_index index;
+  index.num   = 0;
+  index.dsets = NULL;
+
   /* read in our flush file */
   if (kvtree_read_file(file, hash) != KVTREE_SUCCESS) {
     /* failed to read the flush file */
     goto cleanup;
   }
 
+  /* read the flush file once and answer every query from its index */
+  scr_flush_index_build(hash, &index);
+
+  /* answer queries from stdin */
+  if (args.batch) {
+    scr_flush_batch(&index);
+    rc = 0;
+    goto cleanup;
+  }
+
   /* list output sets (if any) in ascending order */
   if (args.list_out == 1) {
-    /* first, see if we have this dataset */
-    kvtree* dset_hash = kvtree_get(hash, SCR_FLUSH_KEY_DATASET);
-    if (dset_hash != NULL) {
-      /* get ids in ascending order */
-      int num;
-      int* list;
-      kvtree_list_int(dset_hash, &num, &list);
-
-      /* print list of ids in ascending order */
-      int i;
-      int found_one = 0;
-      for (i = 0; i < num; i++) {
-        int id = list[i];
-        if (args.before == 0 || id < args.before) {
-          kvtree* dhash = kvtree_getf(dset_hash, "%d", id);
-          int flag;
-          if (kvtree_util_get_int(dhash, SCR_FLUSH_KEY_OUTPUT, &flag) == KVTREE_SUCCESS) {
-            if (flag == 1) {
-              if (found_one) {
-                printf(" ");
-              }
-              printf("%d", id);
-              found_one = 1;
-            }
-          }
-        }
-      }
-      if (found_one) {
-        printf("\n");
-        rc = 0;
-      }
-
-      /* free sorted list of ints */
-      scr_free(&list);
+    rc = scr_flush_query_list(stdout, &index, 0, args.before, 0);
+    if (rc == 0) {
+      printf("\n");
     }
     goto cleanup;
   }
 
   /* list checkpoint sets (if any) in descending order */
   if (args.list_ckpt == 1) {
-    /* first, see if we have this dataset */
-    kvtree* dset_hash = kvtree_get(hash, SCR_FLUSH_KEY_DATASET);
-    if (dset_hash != NULL) {
-      /* get ids in ascending order */
-      int num;
-      int* list;
-      kvtree_list_int(dset_hash, &num, &list);
-
-      /* print list of ids in reverse order */
-      int i;
-      int found_one = 0;
-      for (i = num-1; i >= 0; i--) {
-        int id = list[i];
-        if (args.before == 0 || id < args.before) {
-          kvtree* dhash = kvtree_getf(dset_hash, "%d", id);
-          int flag;
-          if (kvtree_util_get_int(dhash, SCR_FLUSH_KEY_CKPT, &flag) == KVTREE_SUCCESS) {
-            if (flag == 1) {
-              if (found_one) {
-                printf(" ");
-              }
-              printf("%d", id);
-              found_one = 1;
-            }
-          }
-        }
-      }
-      if (found_one) {
-        printf("\n");
-        rc = 0;
-      }
-
-      /* free sorted list of ints */
-      scr_free(&list);
+    rc = scr_flush_query_list(stdout, &index, 1, args.before, 1);
+    if (rc == 0) {
+      printf("\n");
     }
     goto cleanup;
   }
 
   /* check whether a specified dataset id needs to be flushed */
   if (args.need_flush != -1) {
-    /* first, see if we have this dataset */
-    kvtree* dset_hash = kvtree_get_kv_int(hash, SCR_FLUSH_KEY_DATASET, args.need_flush);
-    if (dset_hash != NULL) {
-      /* now check for the PFS location marker */
-      kvtree* location_hash = kvtree_get(dset_hash, SCR_FLUSH_KEY_LOCATION);
-      kvtree_elem* pfs_elem = kvtree_elem_get(location_hash, SCR_FLUSH_KEY_LOCATION_PFS);
-      if (pfs_elem == NULL) {
-        /* we have the dataset, but we didn't find the PFS marker,
-         * so return success to indicate that we do need to flush it */
-        rc = 0;
-      }
-    }
+    rc = scr_flush_query_need_flush(&index, args.need_flush);
     goto cleanup;
   }
 
+  /* report the location of the specified data set */
   if (args.location != -1) {
-    /* report the location of the specified data set */
-    kvtree* dset_hash = kvtree_get_kv_int(hash, SCR_FLUSH_KEY_DATASET, args.location);
-    if (dset_hash != NULL) {
-      /* now check for the location marker */
-      kvtree* location_hash = kvtree_get(dset_hash, SCR_FLUSH_KEY_LOCATION);
-      if (location_hash != NULL) {
-         rc = 0;
-         kvtree_elem* loc_elem = kvtree_elem_first(location_hash);
-         if (loc_elem != NULL) {
-            /* if the location exists in the file, print it */
-            char* loc = kvtree_elem_key(loc_elem);
-            if (loc != NULL) {
-              printf("%s\n", loc);
-            }
-         } else {
-            /* if there is no location information for some reason,
-             * print none */
-            printf("NONE\n");
-         }
-      }
-      /* if specified dataset is not found, we return error in rc (1) */
+    rc = scr_flush_query_location(stdout, &index, args.location);
+    if (rc == 0) {
+      printf("\n");
     }
     goto cleanup;
   }
 
   /* check whether we should report name for dataset */
   if (args.name != -1) {
-    /* first check whether we have the requested dataset */
-    kvtree* dset_hash = kvtree_get_kv_int(hash, SCR_FLUSH_KEY_DATASET, args.name);
-    if (dset_hash != NULL) {
-      /* now check for the name */
-      char* name;
-      if (kvtree_util_get_str(dset_hash, SCR_FLUSH_KEY_NAME, &name) == KVTREE_SUCCESS) {
-        /* got name, print it and return success */
-        printf("%s\n", name);
-        rc = 0;
-      }
+    rc = scr_flush_query_name(stdout, &index, args.name);
+    if (rc == 0) {
+      printf("\n");
     }
     goto cleanup;
   }
 
   /* print the latest dataset id to stdout */
   if (args.latest) {
-    /* scan through the dataset ids to find the most recent */
-    int latest_dset = -1;
-    kvtree_elem* elem;
-    kvtree* latest_hash = kvtree_get(hash, SCR_FLUSH_KEY_DATASET);
-    for (elem = kvtree_elem_first(latest_hash);
-         elem != NULL;
-         elem = kvtree_elem_next(elem))
-    {
-      /* update our latest dataset id if this dataset is more recent */
-      int dset = kvtree_elem_key_int(elem);
-      if (dset > latest_dset) {
-        latest_dset = dset;
-      }
-    }
-
-    /* if we found a dataset, print its id and return success */
-    if (latest_dset != -1) {
-      printf("%d\n", latest_dset);
-      rc = 0;
+    rc = scr_flush_query_latest(stdout, &index);
+    if (rc == 0) {
+      printf("\n");
     }
     goto cleanup;
   }
 
 cleanup:
+  /* free the index of datasets */
+  scr_flush_index_free(&index);
+
   /* delete the hash holding the flush file data */
   kvtree_delete(&hash);
 
@@ -20,33 +20,106 @@ Flush file functions
 =========================================
 */
 
+/* every process keeps a copy of the flush file in memory, since all
+ * updates are applied collectively, queries are answered from the local
+ * copy without reading the file or communicating, and rank 0 writes the
+ * file back after each update so that scavenge sees the latest state */
+static kvtree* scr_flush_file_hash = NULL;
+
+/* depth of nested batches, updates are only written when this is 0 */
+static int scr_flush_file_batch_depth = 0;
+
+/* records whether an update has not yet been written to the file */
+static int scr_flush_file_dirty = 0;
+
+/* write flush file from rank 0 unless we are in the middle of a batch */
+static int scr_flush_file_write(void)
+{
+  /* defer the write until the end of the batch */
+  if (scr_flush_file_batch_depth > 0) {
+    scr_flush_file_dirty = 1;
+    return SCR_SUCCESS;
+  }
+
+  /* only rank 0 writes the file */
+  if (scr_my_rank_world == 0) {
+    kvtree_write_path(scr_flush_file, scr_flush_file_hash);
+  }
+  scr_flush_file_dirty = 0;
+
+  return SCR_SUCCESS;
+}
+
+/* rank 0 reads the flush file and broadcasts it to all procs,
+ * replaces any copy that is currently loaded */
+int scr_flush_file_load(void)
+{
+  kvtree_delete(&scr_flush_file_hash);
+  scr_flush_file_hash = kvtree_new();
+  if (scr_my_rank_world == 0) {
+    /* the file may not exist yet, in which case we start empty */
+    kvtree_read_path(scr_flush_file, scr_flush_file_hash);
+  }
+  kvtree_bcast(scr_flush_file_hash, 0, scr_comm_world);
+  scr_flush_file_dirty = 0;
+  return SCR_SUCCESS;
+}
+
+/* writes any pending update and frees the in-memory copy */
+int scr_flush_file_finalize(void)
+{
+  if (scr_flush_file_hash != NULL && scr_flush_file_dirty) {
+    scr_flush_file_batch_depth = 0;
+    scr_flush_file_write();
+  }
+  kvtree_delete(&scr_flush_file_hash);
+  return SCR_SUCCESS;
+}
+
+/* starts a batch of updates, the flush file is written once when
+ * the outermost batch ends rather than on every update */
+void scr_flush_file_batch_begin(void)
+{
+  scr_flush_file_batch_depth++;
+}
+
+/* ends a batch of updates, writes the flush file if this ends the
+ * outermost batch and something changed */
+int scr_flush_file_batch_end(void)
+{
+  if (scr_flush_file_batch_depth > 0) {
+    scr_flush_file_batch_depth--;
+  }
+  if (scr_flush_file_batch_depth == 0 && scr_flush_file_dirty) {
+    return scr_flush_file_write();
+  }
+  return SCR_SUCCESS;
+}
+
+/* returns the in-memory flush file, loading it on first use */
+static kvtree* scr_flush_file_get(void)
+{
+  if (scr_flush_file_hash == NULL) {
+    scr_flush_file_load();
+  }
+  return scr_flush_file_hash;
+}
+
 /* returns true if the given dataset id needs to be flushed */
 int scr_flush_file_need_flush(int id)
 {
   int need_flush = 0;
 
-  /* just have rank 0 read the file */
-  if (scr_my_rank_world == 0) {
-    /* read the flush file */
-    kvtree* hash = kvtree_new();
-    kvtree_read_path(scr_flush_file, hash);
-
-    /* if we have the dataset in cache, but not on the parallel file system,
-     * then it needs to be flushed */
-    kvtree* dset_hash = kvtree_get_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
-    kvtree* in_cache  = kvtree_get_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, SCR_FLUSH_KEY_LOCATION_CACHE);
-    kvtree* in_pfs    = kvtree_get_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, SCR_FLUSH_KEY_LOCATION_PFS);
-    if (in_cache != NULL && in_pfs == NULL) {
-      need_flush = 1;
-    }
-
-    /* free the hash object */
-    kvtree_delete(&hash);
+  /* if we have the dataset in cache, but not on the parallel file system,
+   * then it needs to be flushed */
+  kvtree* hash = scr_flush_file_get();
+  kvtree* dset_hash = kvtree_get_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
+  kvtree* in_cache  = kvtree_get_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, SCR_FLUSH_KEY_LOCATION_CACHE);
+  kvtree* in_pfs    = kvtree_get_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, SCR_FLUSH_KEY_LOCATION_PFS);
+  if (in_cache != NULL && in_pfs == NULL) {
+    need_flush = 1;
   }
 
-  /* broadcast decision from rank 0 */
-  MPI_Bcast(&need_flush, 1, MPI_INT, 0, scr_comm_world);
-
   return need_flush;
 }
 
@@ -56,95 +129,46 @@ int scr_flush_file_is_flushing(int id)
   /* assume we are not flushing this checkpoint */
   int is_flushing = 0;
 
-  /* only rank 0 tests the file */
-  if (scr_my_rank_world == 0) {
-    /* read flush file into hash */
-    kvtree* hash = kvtree_new();
-    kvtree_read_path(scr_flush_file, hash);
-
-    /* attempt to look up the FLUSHING state for this checkpoint */
-    kvtree* dset_hash = kvtree_get_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
-    kvtree* flushing_hash = kvtree_get_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, SCR_FLUSH_KEY_LOCATION_FLUSHING);
-    if (flushing_hash != NULL) {
-      is_flushing = 1;
-    }
-
-    /* delete the hash */
-    kvtree_delete(&hash);
+  /* attempt to look up the FLUSHING state for this checkpoint */
+  kvtree* hash = scr_flush_file_get();
+  kvtree* dset_hash = kvtree_get_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
+  kvtree* flushing_hash = kvtree_get_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, SCR_FLUSH_KEY_LOCATION_FLUSHING);
+  if (flushing_hash != NULL) {
+    is_flushing = 1;
   }
 
-  /* broadcast decision from rank 0 */
-  MPI_Bcast(&is_flushing, 1, MPI_INT, 0, scr_comm_world);
-
   return is_flushing;
 }
 
 /* removes entries in flush file for given dataset id */
 int scr_flush_file_dataset_remove(int id)
 {
-  /* only rank 0 needs to write the file */
-  if (scr_my_rank_world == 0) {
-    /* read the flush file into hash */
-    kvtree* hash = kvtree_new();
-    kvtree_read_path(scr_flush_file, hash);
-
-    /* delete this dataset id from the flush file */
-    kvtree_unset_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
+  /* delete this dataset id from the flush file */
+  kvtree* hash = scr_flush_file_get();
+  kvtree_unset_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
 
-    /* write the hash back to the flush file */
-    kvtree_write_path(scr_flush_file, hash);
-
-    /* delete the hash */
-    kvtree_delete(&hash);
-  }
-  return SCR_SUCCESS;
+  return scr_flush_file_write();
 }
 
 /* adds a location for the specified dataset id to the flush file */
 int scr_flush_file_location_set(int id, const char* location)
 {
-  /* only rank 0 updates the file */
-  if (scr_my_rank_world == 0) {
-    /* read the flush file into hash */
-    kvtree* hash = kvtree_new();
-    kvtree_read_path(scr_flush_file, hash);
-
-    /* set the location for this dataset */
-    kvtree* dset_hash = kvtree_set_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
-    kvtree_set_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, location);
-
-    /* write the hash back to the flush file */
-    kvtree_write_path(scr_flush_file, hash);
+  /* set the location for this dataset */
+  kvtree* hash = scr_flush_file_get();
+  kvtree* dset_hash = kvtree_set_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
+  kvtree_set_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, location);
 
-    /* delete the hash */
-    kvtree_delete(&hash);
-  }
-  return SCR_SUCCESS;
+  return scr_flush_file_write();
 }
 
 /* returns SCR_SUCCESS if specified dataset id is at specified location */
 int scr_flush_file_location_test(int id, const char* location)
 {
-  /* only rank 0 checks the status, bcasts the results to everyone else */
-  int at_location = 0;
-  if (scr_my_rank_world == 0) {
-    /* read the flush file into hash */
-    kvtree* hash = kvtree_new();
-    kvtree_read_path(scr_flush_file, hash);
-
-    /* check the location for this dataset */
-    kvtree* dset_hash = kvtree_get_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
-    kvtree* value     = kvtree_get_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, location);
-    if (value != NULL) {
-      at_location = 1;
-    }
-
-    /* delete the hash */
-    kvtree_delete(&hash);
-  }
-  MPI_Bcast(&at_location, 1, MPI_INT, 0, scr_comm_world);
-
-  if (! at_location) {
+  /* check the location for this dataset */
+  kvtree* hash = scr_flush_file_get();
+  kvtree* dset_hash = kvtree_get_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
+  kvtree* value     = kvtree_get_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, location);
+  if (value == NULL) {
     return SCR_FAILURE;
   }
   return SCR_SUCCESS;
@@ -153,58 +177,35 @@ int scr_flush_file_location_test(int id, const char* location)
 /* removes a location for the specified dataset id from the flush file */
 int scr_flush_file_location_unset(int id, const char* location)
 {
-  /* only rank 0 updates the file */
-  if (scr_my_rank_world == 0) {
-    /* read the flush file into hash */
-    kvtree* hash = kvtree_new();
-    kvtree_read_path(scr_flush_file, hash);
-
-    /* unset the location for this dataset */
-    kvtree* dset_hash = kvtree_get_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
-    kvtree_unset_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, location);
-
-    /* write the hash back to the flush file */
-    kvtree_write_path(scr_flush_file, hash);
+  /* unset the location for this dataset */
+  kvtree* hash = scr_flush_file_get();
+  kvtree* dset_hash = kvtree_get_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
+  kvtree_unset_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, location);
 
-    /* delete the hash */
-    kvtree_delete(&hash);
-  }
-  return SCR_SUCCESS;
+  return scr_flush_file_write();
 }
 
 /* create an entry in the flush file for a dataset for scavenge,
  * including name, location, and flags */
 int scr_flush_file_new_entry(int id, const char* name, const scr_dataset* dataset, const char* location, int ckpt, int output)
 {
-  /* only rank 0 updates the file */
-  if (scr_my_rank_world == 0) {
-    /* read the flush file into hash */
-    kvtree* hash = kvtree_new();
-    kvtree_read_path(scr_flush_file, hash);
-
-    /* set the name, location, and flags for this dataset */
-    kvtree* dset_hash = kvtree_set_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
-    kvtree_util_set_str(dset_hash, SCR_FLUSH_KEY_NAME, name);
-    kvtree_util_set_str(dset_hash, SCR_FLUSH_KEY_LOCATION, location);
-    if (ckpt) {
-      kvtree_util_set_int(dset_hash, SCR_FLUSH_KEY_CKPT, ckpt);
-    }
-    if (output) {
-      kvtree_util_set_int(dset_hash, SCR_FLUSH_KEY_OUTPUT, output);
-    }
-
-    /* record metadata for dataset */
-    /* TODO: this feels hacky since it breaks abstraction of scr_dataset type */
-    kvtree* dataset_copy = kvtree_new();
-    kvtree_merge(dataset_copy, dataset);
-    kvtree_set(dset_hash, SCR_FLUSH_KEY_DSETDESC, dataset_copy);
-
-    /* write the hash back to the flush file */
-    kvtree_write_path(scr_flush_file, hash);
-
-    /* delete the hash */
-    kvtree_delete(&hash);
+  /* set the name, location, and flags for this dataset */
+  kvtree* hash = scr_flush_file_get();
+  kvtree* dset_hash = kvtree_set_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
+  kvtree_util_set_str(dset_hash, SCR_FLUSH_KEY_NAME, name);
+  kvtree_util_set_str(dset_hash, SCR_FLUSH_KEY_LOCATION, location);
+  if (ckpt) {
+    kvtree_util_set_int(dset_hash, SCR_FLUSH_KEY_CKPT, ckpt);
+  }
+  if (output) {
+    kvtree_util_set_int(dset_hash, SCR_FLUSH_KEY_OUTPUT, output);
   }
-  return SCR_SUCCESS;
-}
 
+  /* record metadata for dataset */
+  /* TODO: this feels hacky since it breaks abstraction of scr_dataset type */
+  kvtree* dataset_copy = kvtree_new();
+  kvtree_merge(dataset_copy, dataset);
+  kvtree_set(dset_hash, SCR_FLUSH_KEY_DSETDESC, dataset_copy);
+
+  return scr_flush_file_write();
+}
@@ -12,6 +12,21 @@
 #ifndef SCR_FLUSH_FILE_MPI_H
 #define SCR_FLUSH_FILE_MPI_H
 
+/* rank 0 reads the flush file and broadcasts it to all procs,
+ * replaces any copy that is currently loaded */
+int scr_flush_file_load(void);
+
+/* writes any pending update and frees the in-memory copy */
+int scr_flush_file_finalize(void);
+
+/* starts a batch of updates, the flush file is written once when
+ * the outermost batch ends rather than on every update */
+void scr_flush_file_batch_begin(void);
+
+/* ends a batch of updates, writes the flush file if this ends the
+ * outermost batch and something changed */
+int scr_flush_file_batch_end(void);
+
 /* returns true if the given dataset id needs to be flushed */
 int scr_flush_file_need_flush(int id);
 
@@ -17,6 +17,383 @@
 
 #include "axl_mpi.h"
 
+/*
+=========================================
+Delta flush functions
+=========================================
+*/
+
+/* block hashes of a file written in the last full flush,
+ * used to write later flushes as deltas against that file */
+typedef struct {
+  char* name;           /* file name, used to match files between datasets */
+  char* file;           /* flushed file relative to prefix directory */
+  unsigned long size;   /* size of file in bytes */
+  unsigned long count;  /* number of blocks in file */
+  uint64_t* hashes;     /* hash of each block */
+} scr_flush_delta_file;
+
+static int scr_flush_delta_base_id = -1;  /* id of dataset deltas are written against */
+static int scr_flush_delta_count   = 0;   /* number of delta flushes since base */
+static int scr_flush_delta_nfiles  = 0;   /* number of files in base */
+static scr_flush_delta_file* scr_flush_delta_files = NULL; /* block hashes of base files */
+
+/* hashes of files from the full flush in progress, they replace the
+ * base once the flush completes */
+static int scr_flush_delta_next_nfiles = 0;
+static scr_flush_delta_file* scr_flush_delta_next_files = NULL;
+
+/* set if the flush in progress was written as a delta */
+static int scr_flush_delta_used = 0;
+
+/* free list of file hashes */
+static void scr_flush_delta_free(scr_flush_delta_file** files, int* nfiles)
+{
+  if (*files != NULL) {
+    int i;
+    for (i = 0; i < *nfiles; i++) {
+      scr_free(&(*files)[i].name);
+      scr_free(&(*files)[i].file);
+      scr_free(&(*files)[i].hashes);
+    }
+  }
+  scr_free(files);
+  *nfiles = 0;
+}
+
+/* return newly allocated basename of given path */
+static char* scr_flush_delta_name(const char* file)
+{
+  spath* path = spath_from_str(file);
+  spath_basename(path);
+  char* name = spath_strdup(path);
+  spath_delete(&path);
+  return name;
+}
+
+/* compute block hashes of each cached file to use as the base of later
+ * delta flushes, recording the path each was flushed to */
+static int scr_flush_delta_hash(int numfiles, char** src_filelist, char** dst_filelist)
+{
+  int rc = SCR_SUCCESS;
+
+  scr_flush_delta_file* files = NULL;
+  if (numfiles > 0) {
+    files = (scr_flush_delta_file*) SCR_MALLOC(numfiles * sizeof(scr_flush_delta_file));
+  }
+
+  int i;
+  for (i = 0; i < numfiles; i++) {
+    scr_flush_delta_file* f = &files[i];
+    f->name = scr_flush_delta_name(src_filelist[i]);
+
+    /* record path relative to prefix directory */
+    spath* base = spath_from_str(scr_prefix);
+    spath* dest = spath_from_str(dst_filelist[i]);
+    spath* rel  = spath_relative(base, dest);
+    f->file = spath_strdup(rel);
+    spath_delete(&rel);
+    spath_delete(&dest);
+    spath_delete(&base);
+
+    if (scr_delta_hash_file(src_filelist[i], scr_flush_delta_block_size,
+        &f->hashes, &f->count, &f->size) != SCR_SUCCESS)
+    {
+      rc = SCR_FAILURE;
+    }
+  }
+
+  /* only keep hashes if everyone has them */
+  if (! scr_alltrue(rc == SCR_SUCCESS, scr_comm_world)) {
+    scr_flush_delta_free(&files, &numfiles);
+    return SCR_FAILURE;
+  }
+
+  scr_flush_delta_free(&scr_flush_delta_next_files, &scr_flush_delta_next_nfiles);
+  scr_flush_delta_next_files  = files;
+  scr_flush_delta_next_nfiles = numfiles;
+  return SCR_SUCCESS;
+}
+
+/* find base file to compare the given cached file to, match by name
+ * and otherwise by position if both datasets have the same number of
+ * files, any base gives a correct delta so this only affects its size */
+static const scr_flush_delta_file* scr_flush_delta_lookup(const char* file, int index, int numfiles)
+{
+  const scr_flush_delta_file* found = NULL;
+
+  char* name = scr_flush_delta_name(file);
+  int i;
+  for (i = 0; i < scr_flush_delta_nfiles; i++) {
+    if (strcmp(scr_flush_delta_files[i].name, name) == 0) {
+      found = &scr_flush_delta_files[i];
+      break;
+    }
+  }
+  scr_free(&name);
+
+  if (found == NULL && numfiles == scr_flush_delta_nfiles) {
+    found = &scr_flush_delta_files[index];
+  }
+
+  return found;
+}
+
+/* returns 1 if any destination file would overwrite a base file,
+ * in which case we can't write a delta against that base */
+static int scr_flush_delta_overlaps(int count, char** dst_filelist)
+{
+  int overlap = 0;
+  int j;
+  for (j = 0; j < scr_flush_delta_nfiles && ! overlap; j++) {
+    /* build full path to base file */
+    spath* path = spath_from_str(scr_prefix);
+    spath_append_str(path, scr_flush_delta_files[j].file);
+    spath_reduce(path);
+    char* base = spath_strdup(path);
+    spath_delete(&path);
+
+    int i;
+    for (i = 0; i < count; i++) {
+      path = spath_from_str(dst_filelist[i]);
+      spath_reduce(path);
+      char* dest = spath_strdup(path);
+      spath_delete(&path);
+      if (strcmp(base, dest) == 0) {
+        overlap = 1;
+      }
+      scr_free(&dest);
+      if (overlap) {
+        break;
+      }
+    }
+    scr_free(&base);
+  }
+  return overlap;
+}
+
+/* write each source file to its destination as a delta against the
+ * base, record base file and size in rank2file list */
+static int scr_flush_delta_write(
+  int count,
+  const char** src_filelist,
+  const char** dst_filelist,
+  kvtree* filelist,
+  double* moved)
+{
+  int rc = SCR_SUCCESS;
+  *moved = 0.0;
+
+  int i;
+  for (i = 0; i < count; i++) {
+    /* get base file to compare against */
+    const scr_flush_delta_file* f = scr_flush_delta_lookup(src_filelist[i], i, count);
+    kvtree* file_hash = scr_flush_rank2file_add(filelist, dst_filelist[i]);
+
+    if (f == NULL) {
+      /* no base to compare to, so copy the full file */
+      if (scr_file_copy(src_filelist[i], dst_filelist[i], scr_storedescs_buf_size(src_filelist[i]), NULL) != SCR_SUCCESS) {
+        rc = SCR_FAILURE;
+        continue;
+      }
+      *moved += (double) scr_file_size(dst_filelist[i]);
+      continue;
+    }
+
+    unsigned long written;
+    if (scr_delta_write(src_filelist[i], dst_filelist[i], scr_flush_delta_block_size,
+        f->hashes, f->count, f->size, &written) != SCR_SUCCESS)
+    {
+      rc = SCR_FAILURE;
+      continue;
+    }
+
+    /* record base file so fetch can rebuild the original file */
+    scr_meta_set_filesize(file_hash, scr_file_size(src_filelist[i]));
+    kvtree_util_set_str(file_hash, SCR_META_KEY_DELTA, f->file);
+    *moved += (double) written;
+  }
+
+  return rc;
+}
+
+/* update the delta base once the flush of the given dataset is done */
+static void scr_flush_delta_complete(int id, int flushed)
+{
+  if (flushed == SCR_SUCCESS) {
+    if (scr_flush_delta_next_files != NULL) {
+      /* this was a full flush, so it is the new base */
+      scr_flush_delta_free(&scr_flush_delta_files, &scr_flush_delta_nfiles);
+      scr_flush_delta_files  = scr_flush_delta_next_files;
+      scr_flush_delta_nfiles = scr_flush_delta_next_nfiles;
+      scr_flush_delta_next_files  = NULL;
+      scr_flush_delta_next_nfiles = 0;
+      scr_flush_delta_base_id = id;
+      scr_flush_delta_count   = 0;
+    } else if (scr_flush_delta_used) {
+      scr_flush_delta_count++;
+    }
+  }
+
+  scr_flush_delta_free(&scr_flush_delta_next_files, &scr_flush_delta_next_nfiles);
+  scr_flush_delta_used = 0;
+}
+
+/*
+=========================================
+Incremental flush functions
+=========================================
+*/
+
+/* size and checksum of a file written in the last flush, used to link
+ * files that have not changed into later flushes instead of copying them */
+typedef struct {
+  char* name;           /* file name, used to match files between datasets */
+  char* file;           /* full path the file was flushed to */
+  unsigned long size;   /* size of file in bytes */
+  int type;             /* SCR_CHECKSUM_* type of value */
+  uint64_t value;       /* checksum of file */
+} scr_flush_incr_file;
+
+static int scr_flush_incr_nfiles = 0;                  /* number of files in last flush */
+static scr_flush_incr_file* scr_flush_incr_files = NULL; /* files of last flush */
+
+/* files of the flush in progress, they replace the above once the flush completes */
+static int scr_flush_incr_next_nfiles = 0;
+static scr_flush_incr_file* scr_flush_incr_next_files = NULL;
+
+/* free list of flushed files */
+static void scr_flush_incr_free(scr_flush_incr_file** files, int* nfiles)
+{
+  if (*files != NULL) {
+    int i;
+    for (i = 0; i < *nfiles; i++) {
+      scr_free(&(*files)[i].name);
+      scr_free(&(*files)[i].file);
+    }
+  }
+  scr_free(files);
+  *nfiles = 0;
+}
+
+/* record size and checksum of each file in the flush in progress,
+ * computing a checksum from the cached file if meta data has none */
+static void scr_flush_incr_record(
+  const kvtree* file_list,
+  int numfiles,
+  char** src_filelist,
+  char** dst_filelist)
+{
+  scr_flush_incr_file* files = NULL;
+  if (numfiles > 0) {
+    files = (scr_flush_incr_file*) SCR_MALLOC(numfiles * sizeof(scr_flush_incr_file));
+  }
+
+  int i;
+  for (i = 0; i < numfiles; i++) {
+    scr_flush_incr_file* f = &files[i];
+    f->name  = scr_flush_delta_name(src_filelist[i]);
+    f->file  = strdup(dst_filelist[i]);
+    f->size  = 0;
+    f->type  = scr_checksum_type;
+    f->value = 0;
+
+    kvtree* hash = kvtree_get_kv(file_list, SCR_KEY_FILE, src_filelist[i]);
+    scr_meta* meta = kvtree_get(hash, SCR_KEY_META);
+    if (scr_meta_get_filesize(meta, &f->size) != SCR_SUCCESS) {
+      f->size = scr_file_size(src_filelist[i]);
+    }
+    if (scr_meta_get_checksum(meta, &f->type, &f->value) != SCR_SUCCESS) {
+      f->type = scr_checksum_type;
+      if (scr_checksum_file(src_filelist[i], f->type, &f->value) != SCR_SUCCESS) {
+        /* without a checksum, never match this file */
+        f->type = -1;
+      }
+    }
+  }
+
+  scr_flush_incr_free(&scr_flush_incr_next_files, &scr_flush_incr_next_nfiles);
+  scr_flush_incr_next_files  = files;
+  scr_flush_incr_next_nfiles = numfiles;
+}
+
+/* hard link each file with the same name, size, and checksum as a file
+ * in the last flush to that file, and return the remaining files to be
+ * copied in src_copylist and dst_copylist, a hard link keeps the data
+ * alive even after the last flush is deleted from the prefix directory */
+static int scr_flush_incr_link(
+  int numfiles,
+  char** src_filelist,
+  char** dst_filelist,
+  int* copy_files,
+  const char** src_copylist,
+  const char** dst_copylist,
+  double* linked)
+{
+  *copy_files = 0;
+  *linked = 0.0;
+
+  int i;
+  for (i = 0; i < numfiles; i++) {
+    const scr_flush_incr_file* f = &scr_flush_incr_next_files[i];
+    const char* dst = dst_filelist[i];
+
+    /* look for the matching file from the last flush */
+    const scr_flush_incr_file* last = NULL;
+    int j;
+    for (j = 0; j < scr_flush_incr_nfiles; j++) {
+      if (strcmp(scr_flush_incr_files[j].name, f->name) == 0) {
+        last = &scr_flush_incr_files[j];
+        break;
+      }
+    }
+
+    /* never write through a link into a file held by an earlier flush */
+    struct stat stat_buf;
+    if (stat(dst, &stat_buf) == 0 && stat_buf.st_nlink > 1) {
+      unlink(dst);
+    }
+
+    if (last != NULL && f->type >= 0 &&
+        last->type  == f->type  &&
+        last->value == f->value &&
+        last->size  == f->size  &&
+        strcmp(last->file, dst) != 0)
+    {
+      unlink(dst);
+      if (link(last->file, dst) == 0) {
+        *linked += (double) f->size;
+        continue;
+      }
+
+      /* the file system may not support links, or the file is gone */
+      scr_dbg(2, "Failed to link %s to %s, copying instead: errno=%d %s @ %s:%d",
+        dst, last->file, errno, strerror(errno), __FILE__, __LINE__
+      );
+    }
+
+    src_copylist[*copy_files] = src_filelist[i];
+    dst_copylist[*copy_files] = dst;
+    (*copy_files)++;
+  }
+
+  return SCR_SUCCESS;
+}
+
+/* files of a successful flush are the reference for the next one,
+ * any other outcome leaves nothing to compare to */
+static void scr_flush_incr_complete(int flushed)
+{
+  scr_flush_incr_free(&scr_flush_incr_files, &scr_flush_incr_nfiles);
+  if (flushed == SCR_SUCCESS) {
+    scr_flush_incr_files  = scr_flush_incr_next_files;
+    scr_flush_incr_nfiles = scr_flush_incr_next_nfiles;
+    scr_flush_incr_next_files  = NULL;
+    scr_flush_incr_next_nfiles = 0;
+  }
+  scr_flush_incr_free(&scr_flush_incr_next_files, &scr_flush_incr_next_nfiles);
+}
+
 /*
 =========================================
 Synchronous flush functions
@@ -25,7 +402,7 @@ Synchronous flush functions
 
 /* flushes data for files specified in file_list (with flow control),
  * and records status of each file in data */
-static int scr_flush_sync_data(scr_cache_index* cindex, int id, kvtree* file_list)
+static int scr_flush_sync_data(scr_cache_index* cindex, int id, kvtree* file_list, double* moved)
 {
   /* allocate lists for source and destination paths */
   int numfiles;
@@ -59,6 +436,9 @@ static int scr_flush_sync_data(scr_cache_index* cindex, int id, kvtree* file_lis
   }
   MPI_Barrier(scr_comm_world);
 
+  /* container files are written to the dataset directory */
+  char* dataset_dir = spath_strdup(dataset_path);
+
   /* define path for rank2file map */
   spath_append_str(dataset_path, "rank2file");
   const char* rank2file = spath_strdup(dataset_path);
@@ -78,44 +458,233 @@ static int scr_flush_sync_data(scr_cache_index* cindex, int id, kvtree* file_lis
       skip_transfer = 0;
     }
 
-    /* compute path relative to prefix directory */
-    spath* base = spath_from_str(scr_prefix);
-    spath* dest = spath_from_str(filename);
-    spath* rel = spath_relative(base, dest);
-    char* relfile = spath_strdup(rel);
+    /* record file relative to prefix directory, along with its size and checksum */
+    kvtree* file_hash = scr_flush_rank2file_add(filelist, filename);
+    scr_flush_rank2file_meta(file_hash, file_list, src_filelist[i]);
+  }
 
-    kvtree_set_kv(filelist, "FILE", relfile);
+  /* we can't compress files in place, so only compress if we transfer */
+  int transfer = ! scr_alltrue(skip_transfer, scr_comm_world);
+  const scr_storedesc* storedesc = scr_cache_get_storedesc(cindex, id);
+  int compress = SCR_COMPRESS_NONE;
+  if (transfer && storedesc != NULL) {
+    compress = storedesc->compress;
+  }
 
-    scr_free(&relfile);
-    spath_delete(&rel);
-    spath_delete(&dest);
-    spath_delete(&base);
+  /* write the dataset as a delta against the last full flush if we
+   * have one, output datasets are always written in full so that
+   * the application can read them from the prefix directory */
+  int delta = 0;
+  if (transfer && compress == SCR_COMPRESS_NONE && scr_flush_delta > 0 &&
+      ! scr_dataset_is_output(dataset))
+  {
+    int have_base = (scr_flush_delta_base_id >= 0 &&
+                     scr_flush_delta_count < scr_flush_delta &&
+                     ! scr_flush_delta_overlaps(numfiles, dst_filelist));
+    delta = scr_alltrue(have_base, scr_comm_world);
+    if (delta) {
+      scr_dataset_set_base(dataset, scr_flush_delta_base_id);
+    }
+  }
+  scr_flush_delta_used = delta;
+
+  /* pack the files of each group into a single container file,
+   * output datasets are left as regular files for the application */
+  MPI_Comm container_comm = MPI_COMM_NULL;
+  if (transfer && compress == SCR_COMPRESS_NONE && ! delta &&
+      scr_flush_container != NULL && ! scr_dataset_is_output(dataset))
+  {
+    scr_groupdesc* group = scr_groupdescs_from_name(scr_flush_container);
+    if (group != NULL && group->enabled) {
+      container_comm = group->comm;
+    } else if (scr_my_rank_world == 0) {
+      scr_err("Unknown group %s for SCR_FLUSH_CONTAINER, flushing files individually @ %s:%d",
+        scr_flush_container, __FILE__, __LINE__
+      );
+    }
   }
 
-  /* save our file list to disk */
-  kvtree_write_gather(rank2file, filelist, scr_comm_world);
-  kvtree_delete(&filelist);
+  /* save our file list to disk, if compressing, writing a delta, or
+   * packing a container we wait until we know where each file goes,
+   * segments of shared files record the extents they write otherwise */
+  int success = 1;
+  int segments = 0;
+  if (compress == SCR_COMPRESS_NONE && ! delta && container_comm == MPI_COMM_NULL) {
+    for (i = 0; i < numfiles && transfer; i++) {
+      if (scr_segment_is(src_filelist[i])) {
+        kvtree* file_hash = scr_flush_rank2file_add(filelist, dst_filelist[i]);
+        if (scr_segment_record(src_filelist[i], dst_filelist[i], file_hash) != SCR_SUCCESS) {
+          success = 0;
+        }
+        segments++;
+      }
+    }
+    scr_rank2file_write(rank2file, filelist, scr_comm_world);
+    kvtree_delete(&filelist);
+  }
 
   /* after writing out file above, see if we can skip the transfer */
-  int success = 1;
-  if (! scr_alltrue(skip_transfer, scr_comm_world)) {
-    /* create directories */
-    scr_flush_create_dirs(scr_prefix, numfiles, (const char**) dst_filelist, scr_comm_world);
+  if (transfer) {
+    /* create directories, files in a container do not need them */
+    if (container_comm == MPI_COMM_NULL) {
+      int mdt_count = (storedesc != NULL) ? storedesc->mdt_count : 0;
+      scr_flush_create_dirs(scr_prefix, numfiles, (const char**) dst_filelist,
+        mdt_count, scr_comm_world
+      );
+    }
 
     /* get name of dataset */
     char* dset_name = NULL;
     scr_dataset_get_name(dataset, &dset_name);
 
-    /* get AXL transfer type to use */
-    const scr_storedesc* storedesc = scr_cache_get_storedesc(cindex, id);
-    axl_xfer_t xfer_type = scr_xfer_str_to_axl_type(storedesc->xfer);
+    if (delta) {
+      /* write blocks that changed since the base from cache into the prefix directory */
+      double bytes;
+      if (scr_flush_delta_write(numfiles, (const char**) src_filelist,
+          (const char**) dst_filelist, filelist, &bytes) != SCR_SUCCESS)
+      {
+        success = 0;
+      }
+
+      /* total up delta bytes written by all procs */
+      MPI_Reduce(&bytes, moved, 1, MPI_DOUBLE, MPI_SUM, 0, scr_comm_world);
+
+      /* now that we know which files are deltas, save our file list to disk */
+      scr_rank2file_write(rank2file, filelist, scr_comm_world);
+      kvtree_delete(&filelist);
+    } else if (container_comm != MPI_COMM_NULL) {
+      /* copy files from cache into the container for our group,
+       * this writes as many bytes as the dataset holds */
+      double bytes;
+      if (scr_container_write(dataset_dir, numfiles, (const char**) src_filelist,
+          (const char**) dst_filelist, filelist, container_comm, &bytes) != SCR_SUCCESS)
+      {
+        success = 0;
+      }
+
+      /* now that we have offsets into containers, save our file list to disk */
+      scr_rank2file_write(rank2file, filelist, scr_comm_world);
+      kvtree_delete(&filelist);
+    } else if (compress != SCR_COMPRESS_NONE) {
+      /* compress files from cache straight into the prefix directory */
+      double bytes;
+      if (scr_flush_compress_files(compress, numfiles, (const char**) src_filelist,
+          (const char**) dst_filelist, filelist, &bytes) != SCR_SUCCESS)
+      {
+        success = 0;
+      }
+
+      /* total up compressed bytes written by all procs */
+      MPI_Reduce(&bytes, moved, 1, MPI_DOUBLE, MPI_SUM, 0, scr_comm_world);
+
+      /* now that we have compressed sizes, save our file list to disk */
+      scr_rank2file_write(rank2file, filelist, scr_comm_world);
+      kvtree_delete(&filelist);
+    } else {
+      /* get AXL transfer type to use */
+      axl_xfer_t xfer_type = scr_xfer_str_to_axl_type(storedesc->xfer);
+
+      /* link files that are unchanged since the last flush,
+       * and only copy the rest */
+      int copy_files = numfiles;
+      const char** src_copylist = (const char**) SCR_MALLOC((numfiles + 1) * sizeof(char*));
+      const char** dst_copylist = (const char**) SCR_MALLOC((numfiles + 1) * sizeof(char*));
+      if (scr_flush_incremental) {
+        double linked;
+        scr_flush_incr_record(file_list, numfiles, src_filelist, dst_filelist);
+        scr_flush_incr_link(numfiles, src_filelist, dst_filelist,
+          &copy_files, src_copylist, dst_copylist, &linked
+        );
+
+        /* total up bytes we actually wrote */
+        double bytes = scr_flush_list_bytes(file_list) - linked;
+        MPI_Reduce(&bytes, moved, 1, MPI_DOUBLE, MPI_SUM, 0, scr_comm_world);
+      } else {
+        for (i = 0; i < numfiles; i++) {
+          src_copylist[i] = src_filelist[i];
+          dst_copylist[i] = dst_filelist[i];
+        }
+      }
+
+      /* write the extents of each segment into its shared file,
+       * and copy the remaining files as usual */
+      if (segments > 0) {
+        int kept = 0;
+        for (i = 0; i < copy_files; i++) {
+          if (scr_segment_is(src_copylist[i])) {
+            double bytes;
+            double time_start = MPI_Wtime();
+            if (scr_segment_write(src_copylist[i], dst_copylist[i], &bytes) != SCR_SUCCESS) {
+              success = 0;
+            }
+            if (scr_iohist) {
+              scr_iohist_record(SCR_IOHIST_COPY, bytes, MPI_Wtime() - time_start);
+            }
+            continue;
+          }
+          src_copylist[kept] = src_copylist[i];
+          dst_copylist[kept] = dst_copylist[i];
+          kept++;
+        }
+        copy_files = kept;
+      }
+
+      /* files written through to the prefix directory as they were
+       * completed are already in place */
+      double through = 0.0;
+      copy_files = scr_flush_list_through(file_list, copy_files,
+        (char**) src_copylist, (char**) dst_copylist, &through
+      );
+      if (through > 0.0) {
+        scr_dbg(2, "Skipping %f bytes written through to the prefix directory @ %s:%d",
+          through, __FILE__, __LINE__
+        );
+      }
+
+      /* AXL writes the holes of sparse files out as zeros, so copy
+       * those ourselves and leave the holes in place */
+      int dense = 0;
+      for (i = 0; i < copy_files; i++) {
+        if (scr_file_is_sparse(src_copylist[i])) {
+          if (scr_file_copy(src_copylist[i], dst_copylist[i], scr_storedescs_buf_size(src_copylist[i]), NULL) != SCR_SUCCESS) {
+            success = 0;
+          }
+          continue;
+        }
+        src_copylist[dense] = src_copylist[i];
+        dst_copylist[dense] = dst_copylist[i];
+        dense++;
+      }
+      copy_files = dense;
+
+      /* lay out the files we copy based on their size */
+      scr_flush_layout_files(storedesc, file_list, copy_files, src_copylist, dst_copylist);
+
+      /* write files (via AXL), either from each process or with
+       * one transfer per store descriptor group run by its leader */
+      if (scr_axl_aggregate) {
+        if (scr_axl_leaders(dset_name, copy_files, src_copylist, dst_copylist,
+            xfer_type, storedesc->comm, storedesc->leaders, scr_comm_world) != SCR_SUCCESS)
+        {
+          success = 0;
+        }
+      } else if (scr_flow_axl(SCR_FLOW_FLUSH, dset_name, copy_files, src_copylist, dst_copylist,
+          xfer_type, scr_comm_world) != SCR_SUCCESS)
+      {
+        success = 0;
+      }
 
-    /* TODO: gather list of files to leader of store descriptor,
-     * use communicator of leaders for AXL, then bcast result back */
+      /* free the lists, the strings belong to the full lists */
+      scr_free(&src_copylist);
+      scr_free(&dst_copylist);
 
-    /* write files (via AXL) */
-    if (scr_axl(dset_name, numfiles, (const char**) src_filelist, (const char **) dst_filelist, xfer_type, scr_comm_world) != SCR_SUCCESS) {
-      success = 0;
+      /* remember block hashes of a full flush so later flushes can
+       * be written as deltas against it */
+      if (scr_flush_delta > 0 && scr_alltrue(success, scr_comm_world) &&
+          ! scr_dataset_is_output(dataset))
+      {
+        scr_flush_delta_hash(numfiles, src_filelist, dst_filelist);
+      }
     }
   } else {
     /* just stat the file to check that it exists */
@@ -130,6 +699,7 @@ static int scr_flush_sync_data(scr_cache_index* cindex, int id, kvtree* file_lis
 
   /* free path and file name */
   scr_free(&rank2file);
+  scr_free(&dataset_dir);
   spath_delete(&dataset_path);
 
   /* free our file list */
@@ -154,6 +724,8 @@ int scr_flush_sync(scr_cache_index* cindex, int id)
     return SCR_SUCCESS;
   }
 
+  scr_trace_mark_begin("flush_sync");
+
   /* get the dataset corresponding to this id */
   scr_dataset* dataset = scr_dataset_new();
   scr_cache_index_get_dataset(cindex, id, dataset);
@@ -172,10 +744,9 @@ int scr_flush_sync(scr_cache_index* cindex, int id)
 
   /* start timer */
   time_t timestamp_start;
-  double time_start;
+  double time_start = MPI_Wtime();
   if (scr_my_rank_world == 0) {
     timestamp_start = scr_log_seconds();
-    time_start = MPI_Wtime();
   }
 
   /* if we are flushing something asynchronously, wait on it */
@@ -186,6 +757,7 @@ int scr_flush_sync(scr_cache_index* cindex, int id)
      * so perhaps we're already done */
     if (! scr_flush_file_need_flush(id)) {
       scr_dataset_delete(&dataset);
+      scr_trace_mark_end("flush_sync");
       return SCR_SUCCESS;
     }
   }
@@ -208,13 +780,19 @@ int scr_flush_sync(scr_cache_index* cindex, int id)
     flushed = SCR_FAILURE;
   }
 
-  /* write the data out to files */
+  /* write the data out to files, moved is set if bytes written
+   * to the prefix directory differs from the dataset size */
+  double moved_bytes = -1.0;
   if (flushed == SCR_SUCCESS &&
-      scr_flush_sync_data(cindex, id, file_list) != SCR_SUCCESS)
+      scr_flush_sync_data(cindex, id, file_list, &moved_bytes) != SCR_SUCCESS)
   {
     flushed = SCR_FAILURE;
   }
 
+  /* marking the dataset as flushed and clearing the flushing marker
+   * is a single update to the flush file */
+  scr_flush_file_batch_begin();
+
   /* write summary file */
   if (flushed == SCR_SUCCESS &&
       scr_flush_complete(cindex, id, file_list) != SCR_SUCCESS)
@@ -222,13 +800,27 @@ int scr_flush_sync(scr_cache_index* cindex, int id)
     flushed = SCR_FAILURE;
   }
 
+  /* record the bytes this process flushed */
+  double my_bytes = scr_flush_list_bytes(file_list);
+
   /* free data structures */
   kvtree_delete(&file_list);
 
+  /* update base used for delta flushes */
+  scr_flush_delta_complete(id, flushed);
+
+  /* update files that later incremental flushes compare to */
+  scr_flush_incr_complete(flushed);
+
   /* remove sync flushing marker from flush file */
   scr_flush_file_location_unset(id, SCR_FLUSH_KEY_LOCATION_SYNC_FLUSHING);
+  scr_flush_file_batch_end();
 
   /* stop timer, compute bandwidth, and report performance */
+  double time_end = MPI_Wtime();
+  if (flushed == SCR_SUCCESS) {
+    scr_stats_record(SCR_STATS_FLUSH, my_bytes, time_end - time_start);
+  }
   if (scr_my_rank_world == 0) {
     /* get the number of bytes in the dataset */
     double total_bytes = 0.0;
@@ -241,8 +833,7 @@ int scr_flush_sync(scr_cache_index* cindex, int id)
     int total_files = 0.0;
     scr_dataset_get_files(dataset, &total_files);
 
-    /* stop timer and compute bandwidth */
-    double time_end = MPI_Wtime();
+    /* compute bandwidth */
     double time_diff = time_end - time_start;
     double bw = 0.0;
     if (time_diff > 0.0) {
@@ -276,7 +867,8 @@ int scr_flush_sync(scr_cache_index* cindex, int id)
       char* dir = NULL;
       scr_cache_index_get_dir(cindex, id, &dir);
       scr_log_transfer("FLUSH_SYNC", dir, scr_prefix, &id, dset_name,
-        &timestamp_start, &time_diff, &total_bytes, &total_files
+        &timestamp_start, &time_diff, &total_bytes,
+        (moved_bytes >= 0.0) ? &moved_bytes : NULL, &total_files
       );
     }
   }
@@ -284,5 +876,19 @@ int scr_flush_sync(scr_cache_index* cindex, int id)
   /* delete the dataset object */
   scr_dataset_delete(&dataset);
 
+  scr_trace_mark_end("flush_sync");
   return flushed;
 }
+
+/* free state kept between synchronous flushes */
+int scr_flush_sync_finalize()
+{
+  scr_flush_delta_free(&scr_flush_delta_files, &scr_flush_delta_nfiles);
+  scr_flush_delta_free(&scr_flush_delta_next_files, &scr_flush_delta_next_nfiles);
+  scr_flush_delta_base_id = -1;
+  scr_flush_delta_count   = 0;
+  scr_flush_incr_free(&scr_flush_incr_files, &scr_flush_incr_nfiles);
+  scr_flush_incr_free(&scr_flush_incr_next_files, &scr_flush_incr_next_nfiles);
+
+  return SCR_SUCCESS;
+}
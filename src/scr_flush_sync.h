@@ -17,4 +17,7 @@
 /* flush files from cache to parallel file system under SCR_PREFIX */
 int scr_flush_sync(scr_cache_index* cindex, int id);
 
+/* free state kept between synchronous flushes */
+int scr_flush_sync_finalize(void);
+
 #endif
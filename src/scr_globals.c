@@ -90,62 +90,135 @@ int scr_initialized   = 0;              /* indicates whether the library has bee
 int scr_enabled       = SCR_ENABLE;     /* indicates whether the library is enabled */
 int scr_debug         = SCR_DEBUG;      /* set debug verbosity */
 int scr_page_size     = 0;              /* records block size for aligning MPI and file buffers */
+int scr_trace         = SCR_TRACE;      /* whether to log and record time of init and finalize phases */
+int scr_trace_timeline = SCR_TRACE_TIMELINE; /* whether to record a timeline of library phases */
+int scr_iohist          = SCR_IOHIST;          /* whether to keep histograms of file operation latency */
+int scr_iohist_top      = SCR_IOHIST_TOP;      /* number of slowest ranks to list for each operation */
+int scr_iohist_interval = SCR_IOHIST_INTERVAL; /* number of outputs between reports, 0 for finalize only */
+int   scr_inject       = SCR_INJECT; /* kind of failure to inject before rebuild */
+char* scr_inject_ranks = NULL;       /* comma-separated list of ranks to inject failures into */
 
 int scr_log_enable        = SCR_LOG_ENABLE;        /* whether to log SCR events at all */
 int scr_log_txt_enable    = SCR_LOG_TXT_ENABLE;    /* whether to log SCR events to text file */
 int scr_log_syslog_enable = SCR_LOG_SYSLOG_ENABLE; /* whether to log SCR events to syslog */
+int scr_log_json_enable   = SCR_LOG_JSON_ENABLE;   /* whether to log SCR events as JSON records */
 int scr_log_db_enable     = 0;                     /* whether to log SCR events to database */
 int scr_log_db_debug      = 0;                     /* debug level for logging to database */
 char* scr_log_db_host     = NULL;                  /* mysql host name */
 char* scr_log_db_user     = NULL;                  /* mysql user name */
 char* scr_log_db_pass     = NULL;                  /* mysql password */
 char* scr_log_db_name     = NULL;                  /* mysql database name */
+int scr_log_async         = SCR_LOG_ASYNC;         /* whether to write log records from a background thread */
+int scr_log_queue_size    = SCR_LOG_QUEUE_SIZE;    /* max number of log records queued for background thread */
 
 int scr_cache_size    = SCR_CACHE_SIZE;   /* set number of checkpoints to keep at one time */
+int scr_cache_index_journal = SCR_CACHE_INDEX_JOURNAL; /* number of changes to journal before rewriting the cache index */
+unsigned long scr_cache_bytes = SCR_CACHE_BYTES; /* number of bytes of datasets to keep in each cache device, 0 for no limit */
+unsigned long scr_cache_arena = SCR_CACHE_ARENA; /* number of bytes to reserve on each cache device, 0 for none */
+int scr_cache_fit     = SCR_CACHE_FIT;    /* whether to evict datasets until the next output fits in free space */
+unsigned long scr_cache_expect_bytes = SCR_CACHE_EXPECT_BYTES; /* bytes each process expects to write per output, 0 for previous */
+char* scr_cache_evict = NULL;             /* order to evict datasets from cache */
 int scr_copy_type     = SCR_COPY_TYPE;    /* select which redundancy algorithm to use */
 char* scr_group       = NULL;             /* name of process group likely to fail */
+char* scr_set_group   = NULL;             /* name of process group each redundancy set stays within */
+char* scr_topology_file = NULL;           /* file listing the switch of each node */
 int scr_set_size      = SCR_SET_SIZE;     /* specify number of tasks in redundancy set */
 int scr_set_failures  = SCR_SET_FAILURES; /* specify number of failures to tolerate per set */
 int scr_cache_bypass  = SCR_CACHE_BYPASS; /* default bypass, whether to directly read/write parallel file system */
+int scr_cache_dedup   = SCR_CACHE_DEDUP;  /* default dedup, whether to keep identical blocks in cache once */
+char* scr_cache_compress = NULL;          /* default codec to keep files compressed with in cache */
+unsigned long scr_cache_dedup_block_size = SCR_CACHE_DEDUP_BLOCK_SIZE; /* block size to compare when deduplicating */
 
 int scr_mpi_buf_size  = SCR_MPI_BUF_SIZE;     /* set MPI buffer size to chunk file transfer */
 size_t scr_file_buf_size = SCR_FILE_BUF_SIZE; /* set buffer size to chunk file copies to/from parallel file system */
+int scr_buf_tune           = SCR_BUF_TUNE;       /* whether to measure buffer sizes for each store */
+unsigned long scr_buf_tune_bytes = SCR_BUF_TUNE_BYTES; /* bytes to measure each buffer size with */
 int scr_copy_metadata    = SCR_COPY_METADATA; /* whether file metadata should also be copied */
 int scr_axl_mkdir        = SCR_AXL_MKDIR;     /* whether to have AXL create directories for files during a flush */
 
 int scr_halt_seconds     = SCR_HALT_SECONDS; /* secs remaining in allocation before job should be halted */
 int scr_halt_exit        = SCR_HALT_EXIT;    /* whether SCR will call exit if halt condition is detected */
+int scr_decide_async     = SCR_DECIDE_ASYNC; /* whether rank 0 decides Need_checkpoint and Should_exit a call ahead */
+int scr_pmix_events      = SCR_PMIX_EVENTS;  /* whether to subscribe to PMIx failure events */
 
 int   scr_purge            = 0;                    /* whether to delete all datasets from cache during SCR_Init */
 int   scr_distribute       = SCR_DISTRIBUTE;       /* whether to call scr_distribute_files during SCR_Init */
+int   scr_distribute_peer  = SCR_DISTRIBUTE_PEER;  /* whether to move cached files of relocated ranks between nodes */
+int   scr_distribute_spare = SCR_DISTRIBUTE_SPARE; /* whether to rebuild only on replacement nodes when others kept theirs */
 int   scr_fetch            = SCR_FETCH;            /* whether to call scr_fetch_files during SCR_Init */
 int   scr_fetch_width      = SCR_FETCH_WIDTH;      /* specify number of processes to read files simultaneously */
+int   scr_fetch_lazy       = SCR_FETCH_LAZY;       /* whether to fetch files when the application first routes them */
+int   scr_route_clone      = SCR_ROUTE_CLONE;      /* whether checkpoint files start as copies of the previous checkpoint */
+int   scr_fetch_partial    = SCR_FETCH_PARTIAL;    /* whether only ranks that lost their files fetch them */
+int   scr_fetch_prefetch   = SCR_FETCH_PREFETCH;   /* whether to check the fallback checkpoint in the background during fetch */
+int   scr_fetch_screen     = SCR_FETCH_SCREEN;     /* number of recent checkpoints to check up front before fetching */
+int   scr_report           = SCR_REPORT;           /* whether to print a summary of SCR overhead at finalize */
+int   scr_coll_hier        = SCR_COLL_HIER;        /* whether to reduce within nodes and then across node leaders */
 int   scr_fetch_bypass     = SCR_FETCH_BYPASS;     /* whether to use implied bypass mode on fetch */
 char* scr_fetch_current    = NULL;                 /* name of checkpoint to start with during fetch */
 int   scr_flush            = SCR_FLUSH;            /* how many checkpoints between flushes */
 char* scr_flush_type       = NULL;                 /* AXL type to use when flushing data */
+char* scr_flush_compress   = NULL;                 /* codec to compress files with when flushing data */
+int   scr_flush_delta      = SCR_FLUSH_DELTA;      /* max number of delta flushes between full flushes */
+unsigned long scr_flush_delta_block_size = SCR_FLUSH_DELTA_BLOCK_SIZE; /* block size to compare in delta flushes */
+char* scr_flush_container  = NULL;                 /* name of group whose files are packed into one container on flush */
+int   scr_flush_incremental = SCR_FLUSH_INCREMENTAL; /* whether to link files unchanged since the last flush rather than copy them */
+int   scr_flush_through    = SCR_FLUSH_THROUGH;    /* whether to copy completed files of output datasets to the prefix directory right away */
+unsigned long scr_flush_stripe_bytes = SCR_FLUSH_STRIPE_BYTES; /* bytes per stripe of flushed files, 0 for default layout */
+int   scr_flush_stripe_max = SCR_FLUSH_STRIPE_MAX; /* max number of stripes of a flushed file, 0 for no limit */
+unsigned long scr_flush_stripe_size = SCR_FLUSH_STRIPE_SIZE; /* stripe size of flushed files, 0 for file system default */
+int   scr_flush_mdt_count  = SCR_FLUSH_MDT_COUNT;  /* number of metadata targets to spread flushed directories over */
+int   scr_rank2file_shard_ranks = SCR_RANK2FILE_SHARD; /* number of ranks per binary rank2file shard, 0 writes kvtree format */
 int   scr_flush_width      = SCR_FLUSH_WIDTH;      /* specify number of processes to write files simultaneously */
+int   scr_flow_adapt       = SCR_FLOW_ADAPT;       /* whether to adapt flush and fetch widths to observed bandwidth */
 int   scr_flush_on_restart = SCR_FLUSH_ON_RESTART; /* specify whether to flush cache on restart */
 int   scr_global_restart   = SCR_GLOBAL_RESTART;   /* set if code must be restarted from parallel file system */
 int   scr_drop_after_current = 0;                  /* whether to drop datasets from index that come after dataset named in SCR_Current */
 
 int    scr_flush_async             = SCR_FLUSH_ASYNC;         /* whether to use asynchronous flush */
-double scr_flush_async_bw          = SCR_FLUSH_ASYNC_BW;      /* bandwidth limit imposed during async flush */
+double scr_flush_async_bw          = SCR_FLUSH_ASYNC_BW;      /* per-node bandwidth limit imposed during async flush */
 double scr_flush_async_percent     = SCR_FLUSH_ASYNC_PERCENT; /* runtime limit imposed during async flush */
-int    scr_flush_async_in_progress = 0;                       /* tracks whether an async flush is currently underway */
-int    scr_flush_async_dataset_id  = -1;                      /* tracks the id of the checkpoint being flushed */
+int    scr_flush_async_depth       = SCR_FLUSH_ASYNC_DEPTH;   /* max number of datasets in flight with async flush */
+int    scr_flush_async_latest      = SCR_FLUSH_ASYNC_LATEST;  /* whether new checkpoint flushes cancel older ones */
+int    scr_flush_async_in_progress = 0;                       /* number of async flushes currently underway */
+int    scr_flush_async_dataset_id  = -1;                      /* tracks the id of the oldest checkpoint being flushed */
 double scr_flush_async_bytes       = 0.0;                     /* records the total number of bytes to be flushed */
 
+int scr_axl_aggregate = SCR_AXL_AGGREGATE; /* whether leaders run AXL transfers for their group */
+
+char*  scr_drain_store    = NULL;               /* name of store to stage async flushes through */
+double scr_drain_bw       = SCR_DRAIN_BW;       /* bandwidth limit copying from cache to drain store */
+double scr_drain_flush_bw = SCR_DRAIN_FLUSH_BW; /* bandwidth limit copying from drain store to prefix */
+
+int scr_encode_async             = SCR_ENCODE_ASYNC; /* whether to apply redundancy asynchronously */
+int scr_encode_async_in_progress = 0;                /* tracks whether an async encode is currently underway */
+int scr_encode_async_dataset_id  = -1;               /* tracks the id of the dataset being encoded */
+
 int scr_prefix_size  = SCR_PREFIX_SIZE; /* max number of checkpoints to keep in prefix directory */
 int scr_prefix_purge = 0;               /* whether to delete all datasets listed in index file during SCR_Init */
+int scr_prefix_delete_async   = SCR_PREFIX_DELETE_ASYNC;   /* whether to delete datasets from prefix in the background */
+int scr_prefix_delete_threads = SCR_PREFIX_DELETE_THREADS; /* number of threads per node to delete files from prefix */
 
 int scr_crc_on_copy   = SCR_CRC_ON_COPY;   /* whether to enable crc32 checks during scr_swap_files() */
 int scr_crc_on_flush  = SCR_CRC_ON_FLUSH;  /* whether to enable crc32 checks during flush and fetch */
 int scr_crc_on_delete = SCR_CRC_ON_DELETE; /* whether to enable crc32 checks when deleting checkpoints */
+int scr_cache_delete_async = SCR_CACHE_DELETE_ASYNC; /* whether to delete files of datasets from cache in the background */
+int scr_cache_prepare = SCR_CACHE_PREPARE; /* whether to create directories of the next checkpoint in the background */
+int scr_map_defer = SCR_MAP_DEFER; /* whether to write the filemap only when an output completes */
+int scr_file_revalidate = SCR_FILE_REVALIDATE; /* whether to check mtime of files before trusting their meta data */
+int scr_checksum_type = SCR_CHECKSUM_TYPE; /* checksum algorithm to record for new files */
+int scr_crc_threads   = SCR_CRC_THREADS;   /* number of threads to compute crc32 of large files */
+char* scr_numa        = NULL;              /* default NUMA placement of copy and checksum buffers */
+int scr_stat_threads  = SCR_STAT_THREADS;  /* number of threads to look up files in cache */
+unsigned long scr_crc_thread_min_size = SCR_CRC_THREAD_MIN_SIZE; /* minimum file size to compute crc32 with threads */
 
 int    scr_checkpoint_interval = SCR_CHECKPOINT_INTERVAL; /* times to call Need_checkpoint between checkpoints */
 int    scr_checkpoint_seconds  = SCR_CHECKPOINT_SECONDS;  /* min number of seconds between checkpoints */
 double scr_checkpoint_overhead = SCR_CHECKPOINT_OVERHEAD; /* max allowed overhead for checkpointing */
+int    scr_checkpoint_model    = SCR_INTERVAL_NONE;       /* model to compute optimal checkpoint interval */
+double scr_checkpoint_mtbf     = SCR_CHECKPOINT_MTBF;     /* mean seconds between failures */
+double scr_checkpoint_mtbf_pfs = SCR_CHECKPOINT_MTBF_PFS; /* mean seconds between failures that need the prefix directory */
+int    scr_reddesc_model       = SCR_REDDESC_MODEL;       /* whether to pick redundancy descriptors with a cost model */
 int    scr_need_checkpoint_count = 0;   /* tracks the number of times Need_checkpoint has been called */
 double scr_time_checkpoint_total = 0.0; /* keeps a running total of the time spent to checkpoint */
 int    scr_time_checkpoint_count = 0;   /* keeps a running count of the number of checkpoints taken */
@@ -159,6 +232,7 @@ int scr_ranks_world     = 0;             /* number of ranks in the job */
 int scr_my_rank_world   = MPI_PROC_NULL; /* my rank in world */
 
 MPI_Comm scr_comm_node = MPI_COMM_NULL; /* communicator of all tasks on the same node */
+MPI_Comm scr_comm_node_leaders = MPI_COMM_NULL; /* rank 0 of each node, MPI_COMM_NULL on other tasks */
 
 kvtree* scr_groupdesc_hash = NULL; /* hash defining group descriptors to be used */
 kvtree* scr_storedesc_hash = NULL; /* hash defining store descriptors to be used */
@@ -80,6 +80,10 @@
 #include "scr_util_mpi.h"
 #include "spath_mpi.h"
 #include "scr_meta.h"
+#include "scr_checksum.h"
+#include "scr_compress.h"
+#include "scr_delta.h"
+#include "scr_dedup.h"
 #include "scr_dataset.h"
 #include "scr_halt.h"
 #include "scr_log.h"
@@ -102,6 +106,26 @@
 #include "scr_flush.h"
 #include "scr_flush_sync.h"
 #include "scr_flush_async.h"
+#include "scr_stats.h"
+#include "scr_interval.h"
+#include "scr_buffer.h"
+#include "scr_drain.h"
+#include "scr_container.h"
+#include "scr_segment.h"
+#include "scr_layout.h"
+#include "scr_flow.h"
+#include "scr_trace.h"
+#include "scr_iohist.h"
+#include "scr_inject.h"
+#include "scr_stream.h"
+#include "scr_reclaim.h"
+#include "scr_statx.h"
+#include "scr_numa.h"
+#include "scr_pmix_event.h"
+#include "scr_tune.h"
+#include "scr_arena.h"
+#include "scr_rank2file.h"
+#include "scr_rank2file_mpi.h"
 
 #ifdef HAVE_LIBPMIX
 #include "pmix.h"
@@ -148,62 +172,135 @@ extern int scr_initialized;   /* indicates whether the library has been initiali
 extern int scr_enabled;       /* indicates whether the library is enabled */
 extern int scr_debug;         /* set debug verbosity */
 extern int scr_page_size;     /* records block size for aligning MPI and file buffers */
+extern int scr_trace;         /* whether to log and record time of init and finalize phases */
+extern int scr_trace_timeline; /* whether to record a timeline of library phases */
+extern int scr_iohist;          /* whether to keep histograms of file operation latency */
+extern int scr_iohist_top;      /* number of slowest ranks to list for each operation */
+extern int scr_iohist_interval; /* number of outputs between reports, 0 for finalize only */
+extern int   scr_inject;       /* kind of failure to inject before rebuild */
+extern char* scr_inject_ranks; /* comma-separated list of ranks to inject failures into */
 
 extern int scr_log_enable;        /* whether to log SCR events at all */
 extern int scr_log_txt_enable;    /* whether to log SCR events to text file */
 extern int scr_log_syslog_enable; /* whether to log SCR events to syslog */
+extern int scr_log_json_enable;   /* whether to log SCR events as JSON records */
 extern int scr_log_db_enable;     /* whether to log SCR events to database */
 extern int scr_log_db_debug;      /* debug level for logging to database */
 extern char* scr_log_db_host;     /* mysql host name */
 extern char* scr_log_db_user;     /* mysql user name */
 extern char* scr_log_db_pass;     /* mysql password */
 extern char* scr_log_db_name;     /* mysql database name */
+extern int scr_log_async;         /* whether to write log records from a background thread */
+extern int scr_log_queue_size;    /* max number of log records queued for background thread */
 
 extern int scr_cache_size;    /* number of checkpoints to keep in cache at one time */
+extern int scr_cache_index_journal; /* number of changes to journal before rewriting the cache index */
+extern unsigned long scr_cache_bytes; /* number of bytes of datasets to keep in each cache device, 0 for no limit */
+extern unsigned long scr_cache_arena; /* number of bytes to reserve on each cache device, 0 for none */
+extern int scr_cache_fit;     /* whether to evict datasets until the next output fits in free space */
+extern unsigned long scr_cache_expect_bytes; /* bytes each process expects to write per output, 0 for previous */
+extern char* scr_cache_evict; /* order to evict datasets from cache */
 extern int scr_copy_type;     /* select which redundancy algorithm to use */
 extern char* scr_group;       /* name of process group likely to fail */
+extern char* scr_set_group;   /* name of process group each redundancy set stays within */
+extern char* scr_topology_file; /* file listing the switch of each node */
 extern int scr_set_size;      /* specify number of tasks in redundancy set */
 extern int scr_set_failures;  /* specify number of failures to tolerate per set */
 extern int scr_cache_bypass;  /* default bypass, whether to directly read/write parallel file system */
+extern int scr_cache_dedup;   /* default dedup, whether to keep identical blocks in cache once */
+extern char* scr_cache_compress; /* default codec to keep files compressed with in cache */
+extern unsigned long scr_cache_dedup_block_size; /* block size to compare when deduplicating */
 
 extern int scr_mpi_buf_size;     /* set MPI buffer size to chunk file transfer, int due to MPI limits */
 extern size_t scr_file_buf_size; /* set buffer size to chunk file copies to/from parallel file system */
+extern int scr_buf_tune;         /* whether to measure buffer sizes for each store */
+extern unsigned long scr_buf_tune_bytes; /* bytes to measure each buffer size with */
 extern int scr_copy_metadata;    /* whether file metadata should also be copied */
 extern int scr_axl_mkdir;        /* whether to have AXL create directories for files during a flush */
 
 extern int scr_halt_seconds; /* secs remaining in allocation before job should be halted */
 extern int scr_halt_exit;    /* whether SCR will call exit if halt condition is detected */
+extern int scr_decide_async; /* whether rank 0 decides Need_checkpoint and Should_exit a call ahead */
+extern int scr_pmix_events;  /* whether to subscribe to PMIx failure events */
 
 extern int   scr_purge;            /* delete all datasets from cache on restart for debugging */
 extern int   scr_distribute;       /* whether to call scr_distribute_files during SCR_Init */
+extern int   scr_distribute_peer;  /* whether to move cached files of relocated ranks between nodes */
+extern int   scr_distribute_spare; /* whether to rebuild only on replacement nodes when others kept theirs */
 extern int   scr_fetch;            /* whether to call scr_fetch_files during SCR_Init */
 extern int   scr_fetch_width;      /* specify number of processes to read files simultaneously */
+extern int   scr_fetch_lazy;       /* whether to fetch files when the application first routes them */
+extern int   scr_route_clone;      /* whether checkpoint files start as copies of the previous checkpoint */
+extern int   scr_fetch_partial;    /* whether only ranks that lost their files fetch them */
+extern int   scr_fetch_prefetch;   /* whether to check the fallback checkpoint in the background during fetch */
+extern int   scr_fetch_screen;     /* number of recent checkpoints to check up front before fetching */
+extern int   scr_report;           /* whether to print a summary of SCR overhead at finalize */
+extern int   scr_coll_hier;        /* whether to reduce within nodes and then across node leaders */
 extern int   scr_fetch_bypass;     /* whether to use implied bypass on fetch operations */
 extern char* scr_fetch_current;    /* specify name of checkpoint to start with in fetch_latest */
 extern int   scr_flush;            /* how many checkpoints between flushes */
 extern char* scr_flush_type;       /* AXL type to use when flushing datasets */
+extern char* scr_flush_compress;   /* codec to compress files with when flushing datasets */
+extern int   scr_flush_delta;      /* max number of delta flushes between full flushes */
+extern unsigned long scr_flush_delta_block_size; /* block size to compare in delta flushes */
+extern char* scr_flush_container;  /* name of group whose files are packed into one container on flush */
+extern int   scr_flush_incremental; /* whether to link files unchanged since the last flush rather than copy them */
+extern int   scr_flush_through;    /* whether to copy completed files of output datasets to the prefix directory right away */
+extern unsigned long scr_flush_stripe_bytes; /* bytes per stripe of flushed files, 0 for default layout */
+extern int   scr_flush_stripe_max;  /* max number of stripes of a flushed file, 0 for no limit */
+extern unsigned long scr_flush_stripe_size; /* stripe size of flushed files, 0 for file system default */
+extern int   scr_flush_mdt_count;   /* number of metadata targets to spread flushed directories over */
+extern int   scr_rank2file_shard_ranks; /* number of ranks per binary rank2file shard, 0 writes kvtree format */
 extern int   scr_flush_width;      /* specify number of processes to write files simultaneously */
+extern int   scr_flow_adapt;       /* whether to adapt flush and fetch widths to observed bandwidth */
 extern int   scr_flush_on_restart; /* specify whether to flush cache on restart */
 extern int   scr_global_restart;   /* set if code must be restarted from parallel file system */
 extern int   scr_drop_after_current; /* auto-drop datasets from index that come after named checkpoint when calling SCR_Current */
 
 extern int scr_prefix_size;  /* max number of checkpoints to keep in prefix directory */
 extern int scr_prefix_purge; /* whether to delete all datasets listed in index file during SCR_Init */
+extern int scr_prefix_delete_async;   /* whether to delete datasets from prefix in the background */
+extern int scr_prefix_delete_threads; /* number of threads per node to delete files from prefix */
 
 extern int scr_flush_async;             /* whether to use asynchronous flush */
-extern double scr_flush_async_bw;       /* bandwidth limit imposed during async flush */
+extern double scr_flush_async_bw;       /* per-node bandwidth limit imposed during async flush */
 extern double scr_flush_async_percent;  /* runtime limit imposed during async flush */
-extern int scr_flush_async_in_progress; /* tracks whether an async flush is currently underway */
-extern int scr_flush_async_dataset_id;  /* tracks the id of the checkpoint being flushed */
+extern int scr_flush_async_depth;       /* max number of datasets in flight with async flush */
+extern int scr_flush_async_latest;      /* whether new checkpoint flushes cancel older ones */
+extern int scr_flush_async_in_progress; /* number of async flushes currently underway */
+extern int scr_flush_async_dataset_id;  /* tracks the id of the oldest checkpoint being flushed */
 extern double scr_flush_async_bytes;    /* records the total number of bytes to be flushed */
 
+extern int scr_axl_aggregate; /* whether leaders run AXL transfers for their group */
+
+extern char*  scr_drain_store;    /* name of store to stage async flushes through */
+extern double scr_drain_bw;       /* bandwidth limit copying from cache to drain store */
+extern double scr_drain_flush_bw; /* bandwidth limit copying from drain store to prefix */
+
+extern int scr_encode_async;             /* whether to apply redundancy asynchronously */
+extern int scr_encode_async_in_progress; /* tracks whether an async encode is currently underway */
+extern int scr_encode_async_dataset_id;  /* tracks the id of the dataset being encoded */
+
 extern int scr_crc_on_copy;   /* whether to enable crc32 checks during scr_swap_files() */
 extern int scr_crc_on_flush;  /* whether to enable crc32 checks during flush and fetch */
 extern int scr_crc_on_delete; /* whether to enable crc32 checks when deleting checkpoints */
+extern int scr_cache_delete_async; /* whether to delete files of datasets from cache in the background */
+extern int scr_cache_prepare; /* whether to create directories of the next checkpoint in the background */
+extern int scr_map_defer; /* whether to write the filemap only when an output completes */
+extern int scr_file_revalidate; /* whether to check mtime of files before trusting their meta data */
+extern int scr_checksum_type; /* checksum algorithm to record for new files */
+extern int scr_crc_threads;   /* number of threads to compute crc32 of large files */
+extern char* scr_numa;        /* default NUMA placement of copy and checksum buffers */
+extern int scr_stat_threads;  /* number of threads to look up files in cache */
+extern unsigned long scr_crc_thread_min_size; /* minimum file size to compute crc32 with threads */
 
 extern int    scr_checkpoint_interval;   /* times to call Need_checkpoint between checkpoints */
 extern int    scr_checkpoint_seconds;    /* min number of seconds between checkpoints */
 extern double scr_checkpoint_overhead;   /* max allowed overhead for checkpointing */
+extern int    scr_checkpoint_model;      /* model to compute optimal checkpoint interval */
+extern double scr_checkpoint_mtbf;       /* mean seconds between failures */
+extern double scr_checkpoint_mtbf_pfs;   /* mean seconds between failures that need the prefix directory */
+extern int    scr_reddesc_model;         /* whether to pick redundancy descriptors with a cost model */
 extern int    scr_need_checkpoint_count; /* tracks the number of times Need_checkpoint has been called */
 extern double scr_time_checkpoint_total; /* keeps a running total of the time spent to checkpoint */
 extern int    scr_time_checkpoint_count; /* keeps a running count of the number of checkpoints taken */
@@ -217,6 +314,7 @@ extern int scr_ranks_world;       /* number of ranks in the job */
 extern int  scr_my_rank_world;    /* my rank in world */
 
 extern MPI_Comm scr_comm_node; /* communicator of all tasks on the same node */
+extern MPI_Comm scr_comm_node_leaders; /* rank 0 of each node, MPI_COMM_NULL on other tasks */
 
 extern kvtree* scr_app_hash; /* records params set through SCR_Config */
 
@@ -17,6 +17,7 @@
 
 #include "kvtree.h"
 #include "kvtree_util.h"
+#include "kvtree_mpi.h"
 
 #include "rankstr_mpi.h"
 
@@ -86,6 +87,95 @@ static int scr_groupdesc_create_by_str(
   return SCR_SUCCESS;
 }
 
+/* build a group descriptor from a communicator we already have,
+ * the descriptor takes ownership of the communicator */
+static int scr_groupdesc_create_by_comm(
+  scr_groupdesc* d, int index, const char* key, MPI_Comm comm)
+{
+  /* initialize the descriptor */
+  scr_groupdesc_init(d);
+
+  /* enable descriptor, record its index, and copy its name */
+  d->enabled = 1;
+  d->index   = index;
+  d->name    = strdup(key);
+  d->comm    = comm;
+
+  /* find our position in the group communicator */
+  MPI_Comm_rank(d->comm, &d->rank);
+  MPI_Comm_size(d->comm, &d->ranks);
+
+  return SCR_SUCCESS;
+}
+
+/* read the switch of each node from SCR_TOPOLOGY_FILE on rank 0,
+ * where each line is "hostname switch", and return a strdup'd copy of
+ * the switch of our node, returns NULL if our node is not listed */
+static char* scr_groupdesc_switch_from_file(const char* file, MPI_Comm comm)
+{
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+
+  /* read the file once and send it to everyone */
+  kvtree* switches = kvtree_new();
+  if (rank == 0) {
+    FILE* fp = fopen(file, "r");
+    if (fp != NULL) {
+      char line[1024];
+      while (fgets(line, sizeof(line), fp) != NULL) {
+        /* skip blank lines and comments */
+        char host[256], name[256];
+        if (line[0] == '#' || sscanf(line, "%255s %255s", host, name) != 2) {
+          continue;
+        }
+        kvtree_util_set_str(switches, host, name);
+      }
+      fclose(fp);
+    } else {
+      scr_warn("Failed to open topology file %s @ %s:%d",
+        file, __FILE__, __LINE__
+      );
+    }
+  }
+  kvtree_bcast(switches, 0, comm);
+
+  /* look up the switch of our node */
+  char* value = NULL;
+  char* name;
+  if (kvtree_util_get_str(switches, scr_my_hostname, &name) == KVTREE_SUCCESS) {
+    value = strdup(name);
+  }
+  kvtree_delete(&switches);
+
+  return value;
+}
+
+/* return a strdup'd copy of the name of the network switch of our node,
+ * taken from SCR_TOPOLOGY_FILE if set, otherwise from the resource manager,
+ * returns NULL if the switch is not known */
+static char* scr_groupdesc_switch(MPI_Comm comm)
+{
+  if (scr_topology_file != NULL) {
+    return scr_groupdesc_switch_from_file(scr_topology_file, comm);
+  }
+
+  /* SLURM with the tree topology plugin lists the switches above
+   * our node down to the node itself, e.g., "s0.s2.node17",
+   * drop the node name to keep the path to our leaf switch */
+  const char* addr = getenv("SLURM_TOPOLOGY_ADDR");
+  if (addr != NULL) {
+    char* value = strdup(addr);
+    char* dot = strrchr(value, '.');
+    if (dot != NULL) {
+      *dot = '\0';
+      return value;
+    }
+    scr_free(&value);
+  }
+
+  return NULL;
+}
+
 /*
 =========================================
 Routines that operate on scr_groupdescs array
@@ -146,10 +236,11 @@ int scr_groupdescs_create(MPI_Comm comm)
   );
 
   /* set the number of group descriptors,
-   * we define one for all procs on the same node
-   * and another for the world */
+   * we define one for all procs on the same node,
+   * another for the world, and one for all procs
+   * on the same network switch */
   int num_groups = kvtree_size(groups);
-  int count = num_groups + 2;
+  int count = num_groups + 3;
 
   /* set our count to maximum count across all procs */
   MPI_Allreduce(
@@ -164,83 +255,129 @@ int scr_groupdescs_create(MPI_Comm comm)
     scr_groupdesc_init(&scr_groupdescs[i]);
   }
 
-  /* create group descriptor for all procs on the same node */
-  int index = 0;
-  scr_groupdesc_create_by_str(
-    &scr_groupdescs[index], index, SCR_GROUP_NODE, scr_my_hostname, comm
-  );
-  index++;
-
-  /* create group descriptor for all procs in job */
-  scr_groupdesc_create_by_str(
-    &scr_groupdescs[index], index, SCR_GROUP_WORLD, "ALL", comm
-  );
-  index++;
-
   /* in order to form groups in the same order on all procs,
-   * we have rank 0 decide the order */
-
-  /* determine number of entries on rank 0 */
-  MPI_Bcast(&num_groups, 1, MPI_INT, 0, comm);
-
-  /* iterate over each of our hash entries filling in each
-   * corresponding descriptor */
-  char* value;
-  int have_match;
+   * we have rank 0 decide the order, and it sends its list
+   * of group names in a single message, indexed by position */
+  kvtree* names = kvtree_new();
   if (rank == 0) {
+    int n = 0;
     kvtree_elem* elem;
     for (elem = kvtree_elem_first(groups);
          elem != NULL;
          elem = kvtree_elem_next(elem))
     {
-      /* get key for this group */
-      char* key = kvtree_elem_key(elem);
-
-      /* bcast key name */
-      scr_str_bcast(&key, 0, comm);
-
-      /* determine whether all procs have corresponding entry */
-      have_match = 1;
-      if (kvtree_util_get_str(groups, key, &value) != KVTREE_SUCCESS) {
-        have_match = 0;
-      }
-      if (scr_alltrue(have_match, comm)) {
-        /* create group */
-        scr_groupdesc_create_by_str(
-          &scr_groupdescs[index], index, key, value, comm
-        );
-        index++;
-      } else {
-        /* print warning that group is not defined */
-        scr_warn("Not all ranks have group %s defined @ %s:%d",
-          key, __FILE__, __LINE__
-        );
-      }
+      char idx[32];
+      snprintf(idx, sizeof(idx), "%d", n);
+      kvtree_util_set_str(names, idx, kvtree_elem_key(elem));
+      n++;
+    }
+  }
+  kvtree_bcast(names, 0, comm);
+  num_groups = kvtree_size(names);
+
+  /* procs sharing memory are usually procs on the same node, in which
+   * case we can get the node group without exchanging hostnames, check
+   * that our hostname matches the hostname of the first proc */
+  MPI_Comm comm_shared;
+  MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &comm_shared);
+  int rank_shared;
+  MPI_Comm_rank(comm_shared, &rank_shared);
+  char* leader_host = NULL;
+  if (rank_shared == 0) {
+    leader_host = strdup(scr_my_hostname);
+  }
+  scr_str_bcast(&leader_host, 0, comm_shared);
+  int same_host = (strcmp(leader_host, scr_my_hostname) == 0);
+  scr_free(&leader_host);
+
+  /* we can build a switch group if we know the switch of every node,
+   * unless the config file defines its own group of that name */
+  char* switch_name = scr_groupdesc_switch(comm);
+  int have_switch = (switch_name != NULL &&
+    kvtree_get(groups, SCR_GROUP_SWITCH) == NULL);
+
+  /* determine whether every proc has a value for each group,
+   * and check all of our conditions in one reduction */
+  int num_flags = num_groups + 2;
+  int* flags = (int*) SCR_MALLOC(num_flags * sizeof(int));
+  flags[0] = same_host;
+  flags[1] = have_switch;
+  char** values = NULL;
+  if (num_groups > 0) {
+    values = (char**) SCR_MALLOC(num_groups * sizeof(char*));
+  }
+  for (i = 0; i < num_groups; i++) {
+    char idx[32];
+    snprintf(idx, sizeof(idx), "%d", i);
+    char* key;
+    kvtree_util_get_str(names, idx, &key);
+
+    values[i] = NULL;
+    flags[i + 2] = 0;
+    if (kvtree_util_get_str(groups, key, &values[i]) == KVTREE_SUCCESS) {
+      flags[i + 2] = 1;
     }
+  }
+  MPI_Allreduce(MPI_IN_PLACE, flags, num_flags, MPI_INT, MPI_MIN, comm);
+
+  /* create group descriptor for all procs on the same node */
+  int index = 0;
+  if (flags[0]) {
+    scr_groupdesc_create_by_comm(
+      &scr_groupdescs[index], index, SCR_GROUP_NODE, comm_shared
+    );
   } else {
-    for (i = 0; i < num_groups; i++) {
-      /* bcast key name */
-      char* key;
-      scr_str_bcast(&key, 0, comm);
-
-      /* determine whether all procs have corresponding entry */
-      have_match = 1;
-      if (kvtree_util_get_str(groups, key, &value) != KVTREE_SUCCESS) {
-        have_match = 0;
-      }
-      if (scr_alltrue(have_match, comm)) {
-        /* create group */
-        scr_groupdesc_create_by_str(
-          &scr_groupdescs[index], index, key, value, comm
-        );
-        index++;
-      }
+    /* some node runs procs that share memory across hosts,
+     * fall back to splitting on hostname */
+    MPI_Comm_free(&comm_shared);
+    scr_groupdesc_create_by_str(
+      &scr_groupdescs[index], index, SCR_GROUP_NODE, scr_my_hostname, comm
+    );
+  }
+  index++;
 
-      /* free the key name */
-      scr_free(&key);
+  /* create group descriptor for all procs in job */
+  MPI_Comm comm_world;
+  MPI_Comm_dup(comm, &comm_world);
+  scr_groupdesc_create_by_comm(
+    &scr_groupdescs[index], index, SCR_GROUP_WORLD, comm_world
+  );
+  index++;
+
+  /* create group descriptor for all procs on the same switch */
+  if (flags[1]) {
+    scr_groupdesc_create_by_str(
+      &scr_groupdescs[index], index, SCR_GROUP_SWITCH, switch_name, comm
+    );
+    index++;
+  }
+  scr_free(&switch_name);
+
+  /* create each group defined by the config on all procs */
+  for (i = 0; i < num_groups; i++) {
+    char idx[32];
+    snprintf(idx, sizeof(idx), "%d", i);
+    char* key;
+    kvtree_util_get_str(names, idx, &key);
+
+    if (flags[i + 2]) {
+      /* create group */
+      scr_groupdesc_create_by_str(
+        &scr_groupdescs[index], index, key, values[i], comm
+      );
+      index++;
+    } else if (rank == 0) {
+      /* print warning that group is not defined */
+      scr_warn("Not all ranks have group %s defined @ %s:%d",
+        key, __FILE__, __LINE__
+      );
     }
   }
 
+  scr_free(&values);
+  scr_free(&flags);
+  kvtree_delete(&names);
+
   /* determine whether everyone found a valid group descriptor */
   if (! all_valid) {
     return SCR_FAILURE;
@@ -11,6 +11,7 @@
 
 /* Implements an interface to read and write a halt file. */
 
+#include "scr_conf.h"
 #include "scr.h"
 #include "scr_io.h"
 #include "scr_err.h"
@@ -30,6 +31,55 @@
 #include <errno.h>
 #include <unistd.h>
 
+/* attributes of the halt file from the last time we synced with it,
+ * used to skip reading the file again if no one has changed it */
+static int scr_halt_have_stat = 0;
+static struct stat scr_halt_stat;
+
+/* number of checkpoints we have taken off our in-memory count
+ * that we have not yet written to the halt file */
+static int scr_halt_pending = 0;
+
+/* checkpoints_left value we last wrote to the halt file, -1 if none */
+static int scr_halt_written = -1;
+
+/* record attributes of the halt file after we sync with it */
+static void scr_halt_stat_record(const char* file)
+{
+  scr_halt_have_stat = (stat(file, &scr_halt_stat) == 0);
+}
+
+/* return 1 if the halt file may have changed since we last synced with it */
+static int scr_halt_stat_changed(const char* file)
+{
+  if (! scr_halt_have_stat) {
+    return 1;
+  }
+
+  struct stat st;
+  if (stat(file, &st) != 0) {
+    /* file was deleted out from under us */
+    return 1;
+  }
+
+  if (st.st_ino   != scr_halt_stat.st_ino  ||
+      st.st_size  != scr_halt_stat.st_size ||
+      st.st_mtime != scr_halt_stat.st_mtime ||
+      st.st_ctime != scr_halt_stat.st_ctime)
+  {
+    return 1;
+  }
+
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+  /* compare sub-second times where we have them */
+  if (st.st_mtim.tv_nsec != scr_halt_stat.st_mtim.tv_nsec) {
+    return 1;
+  }
+#endif
+
+  return 0;
+}
+
 /* given the name of a halt file, read it and fill in hash */
 int scr_halt_read(const spath* path_file, kvtree* hash)
 {
@@ -120,6 +170,17 @@ int scr_halt_sync_and_decrement(const spath* file_path, kvtree* hash, int dec_co
   /* read in the file data */
   kvtree_read_fd(file, fd, file_hash);
 
+  /* our hash already counts the checkpoints we have not yet written,
+   * but we start over from the count in the file if there is one,
+   * and we only apply those to the count we wrote last, if someone
+   * has set a new count since then, it replaces ours */
+  if (exists && scr_halt_pending > 0) {
+    char* file_ckpts = kvtree_elem_get_first_val(file_hash, SCR_HALT_KEY_CHECKPOINTS);
+    if (file_ckpts != NULL && atoi(file_ckpts) == scr_halt_written) {
+      dec_count += scr_halt_pending;
+    }
+  }
+
   /* if the file already existed before we opened it, override our current settings with its values */
   if (exists) {
     /* for the exit reason, only override our current value if the file has a setting but we don't,
@@ -163,6 +224,9 @@ int scr_halt_sync_and_decrement(const spath* file_path, kvtree* hash, int dec_co
     /* write this new value back to the hash */
     kvtree_unset(hash, SCR_HALT_KEY_CHECKPOINTS);
     kvtree_setf(hash, NULL, "%s %d", SCR_HALT_KEY_CHECKPOINTS, ckpts);
+    scr_halt_written = ckpts;
+  } else {
+    scr_halt_written = -1;
   }
 
   /* wind file pointer back to the start of the file */
@@ -182,6 +246,10 @@ int scr_halt_sync_and_decrement(const spath* file_path, kvtree* hash, int dec_co
   /* close file */
   scr_close(file, fd);
 
+  /* the file now holds all of our decrements */
+  scr_halt_pending = 0;
+  scr_halt_stat_record(file);
+
   /* success if we make it this far */
   rc = SCR_SUCCESS;
 
@@ -192,3 +260,39 @@ cleanup:
   /* write current values to halt file */
   return rc;
 }
+
+/* same as scr_halt_sync_and_decrement, but only reads the halt file
+ * if it has changed since we last synced with it, otherwise decrements
+ * the checkpoints_left field in hash and holds off on writing the file
+ * until the count reaches zero or the file changes */
+int scr_halt_check_and_decrement(const spath* file_path, kvtree* hash, int dec_count)
+{
+  char* file = spath_strdup(file_path);
+  int changed = scr_halt_stat_changed(file);
+  scr_free(&file);
+
+  /* someone may have modified the file, so read it and write our count */
+  if (changed) {
+    return scr_halt_sync_and_decrement(file_path, hash, dec_count);
+  }
+
+  /* otherwise, just decrement our own copy of the count */
+  char* ckpts_str = kvtree_elem_get_first_val(hash, SCR_HALT_KEY_CHECKPOINTS);
+  if (ckpts_str != NULL && dec_count > 0) {
+    int ckpts = atoi(ckpts_str);
+    ckpts -= dec_count;
+    if (ckpts < 0) {
+      ckpts = 0;
+    }
+    kvtree_unset(hash, SCR_HALT_KEY_CHECKPOINTS);
+    kvtree_setf(hash, NULL, "%s %d", SCR_HALT_KEY_CHECKPOINTS, ckpts);
+    scr_halt_pending += dec_count;
+
+    /* write the file once we run out so that scripts see it */
+    if (ckpts == 0) {
+      return scr_halt_sync_and_decrement(file_path, hash, 0);
+    }
+  }
+
+  return SCR_SUCCESS;
+}
@@ -36,4 +36,10 @@ int scr_halt_read(const spath* file, kvtree* hash);
  * optionally decrement the checkpoints_left field, and write out halt file all while locked */
 int scr_halt_sync_and_decrement(const spath* file, kvtree* hash, int dec_count);
 
+/* same as scr_halt_sync_and_decrement, but only reads the halt file
+ * if it has changed since we last synced with it, otherwise decrements
+ * the checkpoints_left field in hash and holds off on writing the file
+ * until the count reaches zero or the file changes */
+int scr_halt_check_and_decrement(const spath* file, kvtree* hash, int dec_count);
+
 #endif
@@ -27,9 +27,12 @@
 #include "scr_err.h"
 #include "scr_util.h"
 #include "scr_meta.h"
+#include "scr_compress.h"
 #include "scr_filemap.h"
 #include "scr_param.h"
 #include "scr_index_api.h"
+#include "scr_rank2file.h"
+#include "scr_rebuild.h"
 
 #include "spath.h"
 #include "kvtree.h"
@@ -47,10 +50,14 @@
 #include <unistd.h>
 #include <sys/wait.h>
 #include <getopt.h>
+#include <pthread.h>
 
 #include <dirent.h>
+#include <stdint.h>
 
-#include <regex.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
 #define SCR_IO_KEY_DIR     ("DIR")
 #define SCR_IO_KEY_FILE    ("FILE")
@@ -376,6 +383,55 @@ static int kvtree_write_scatter_file(const spath* meta_path, const char* filenam
   return rc;
 }
 
+/* returns number of ranks in rank2file info, either as recorded
+ * or as one more than the highest rank with an entry */
+static int scr_rank2file_ranks(const kvtree* rank2file)
+{
+  int ranks;
+  if (kvtree_util_get_int(rank2file, SCR_SUMMARY_6_KEY_RANKS, &ranks) == KVTREE_SUCCESS) {
+    return ranks;
+  }
+
+  int max_rank = -1;
+  kvtree* ranks_hash = kvtree_get(rank2file, SCR_SUMMARY_6_KEY_RANK);
+  kvtree_elem* elem;
+  for (elem = kvtree_elem_first(ranks_hash);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    int rank = kvtree_elem_key_int(elem);
+    if (rank > max_rank) {
+      max_rank = rank;
+    }
+  }
+  return max_rank + 1;
+}
+
+/* write rank2file info to the binary map named filename in meta_path */
+static int scr_rank2file_write_binary(const spath* meta_path, const char* filename, const kvtree* rank2file)
+{
+  spath* path = spath_dup(meta_path);
+  spath_append_str(path, filename);
+  char* file = spath_strdup(path);
+  spath_delete(&path);
+
+  /* keep the shard size of a map already written there, which the
+   * library may have set at run time with SCR_RANK2FILE_SHARD */
+  int map_ranks;
+  int shard_ranks = SCR_RANK2FILE_SHARD;
+  if (scr_rank2file_read_header(file, &map_ranks, &shard_ranks) != SCR_SUCCESS ||
+      shard_ranks <= 0)
+  {
+    shard_ranks = (SCR_RANK2FILE_SHARD > 0) ? SCR_RANK2FILE_SHARD : 8192;
+  }
+
+  int ranks = scr_rank2file_ranks(rank2file);
+  int rc = scr_rank2file_write_ranks(file, rank2file, ranks, shard_ranks);
+
+  scr_free(&file);
+  return rc;
+}
+
 int scr_summary_write(const spath* prefix, const spath* dir, kvtree* hash)
 {
   int rc = SCR_SUCCESS;
@@ -386,8 +442,21 @@ int scr_summary_write(const spath* prefix, const spath* dir, kvtree* hash)
   /* get pointer to RANK2FILE info sorted by rank */
   kvtree* rank2file  = kvtree_get(hash, SCR_SUMMARY_6_KEY_RANK2FILE);
 
-  /* write rank2file map files */
-  rc = kvtree_write_scatter_file(meta_path, "rank2file", rank2file);
+  /* write rank2file map files, in the binary format if so configured
+   * or if the library wrote a binary map for this dataset */
+  spath* rank2file_path = spath_dup(meta_path);
+  spath_append_str(rank2file_path, "rank2file");
+  char* rank2file_file = spath_strdup(rank2file_path);
+  spath_delete(&rank2file_path);
+  int map_ranks, shard_ranks;
+  int binary = (SCR_RANK2FILE_SHARD > 0 ||
+    scr_rank2file_read_header(rank2file_file, &map_ranks, &shard_ranks) == SCR_SUCCESS);
+  scr_free(&rank2file_file);
+  if (binary) {
+    rc = scr_rank2file_write_binary(meta_path, "rank2file", rank2file);
+  } else {
+    rc = kvtree_write_scatter_file(meta_path, "rank2file", rank2file);
+  }
 
   /* remove RANK2FILE from summary hash */
   kvtree_unset(hash, SCR_SUMMARY_6_KEY_RANK2FILE);
@@ -408,34 +477,268 @@ int scr_summary_write(const spath* prefix, const spath* dir, kvtree* hash)
   return rc;
 }
 
-/* forks and execs processes to rebuild missing files and waits for them to complete,
+/* a set of ranks or set members, one bit each */
+typedef struct {
+  int bits;             /* number of bits in the set */
+  unsigned long* words; /* bits packed into words */
+} scr_bitmap;
+
+#define SCR_BITMAP_WORD_BITS (8 * sizeof(unsigned long))
+
+/* allocate an empty set of bits */
+static void scr_bitmap_init(scr_bitmap* b, int bits)
+{
+  if (bits < 0) {
+    bits = 0;
+  }
+  size_t words = (bits + SCR_BITMAP_WORD_BITS - 1) / SCR_BITMAP_WORD_BITS;
+  b->bits  = bits;
+  b->words = (unsigned long*) calloc(words + 1, sizeof(unsigned long));
+}
+
+/* free memory associated with set */
+static void scr_bitmap_free(scr_bitmap* b)
+{
+  scr_free(&b->words);
+  b->bits = 0;
+}
+
+/* add i to set, ignores values out of range */
+static void scr_bitmap_set(scr_bitmap* b, int i)
+{
+  if (b->words != NULL && i >= 0 && i < b->bits) {
+    b->words[i / SCR_BITMAP_WORD_BITS] |= 1UL << (i % SCR_BITMAP_WORD_BITS);
+  }
+}
+
+/* returns 1 if i is in set, 0 otherwise */
+static int scr_bitmap_test(const scr_bitmap* b, int i)
+{
+  if (b->words != NULL && i >= 0 && i < b->bits) {
+    return (b->words[i / SCR_BITMAP_WORD_BITS] >> (i % SCR_BITMAP_WORD_BITS)) & 1UL;
+  }
+  return 0;
+}
+
+/* returns number of values in set */
+static int scr_bitmap_count(const scr_bitmap* b)
+{
+  int count = 0;
+  if (b->words != NULL) {
+    size_t words = (b->bits + SCR_BITMAP_WORD_BITS - 1) / SCR_BITMAP_WORD_BITS;
+    size_t i;
+    for (i = 0; i < words; i++) {
+      count += __builtin_popcountl(b->words[i]);
+    }
+  }
+  return count;
+}
+
+/* returns values in set as a newly allocated string of ranges
+ * like "0-3,7,9-12", caller must free string */
+static char* scr_bitmap_ranges(const scr_bitmap* b)
+{
+  size_t size = 64;
+  size_t len = 0;
+  char* str = (char*) malloc(size);
+  if (str == NULL) {
+    return NULL;
+  }
+  str[0] = '\0';
+
+  int i = 0;
+  while (i < b->bits) {
+    if (! scr_bitmap_test(b, i)) {
+      i++;
+      continue;
+    }
+
+    /* found the start of a range, find where it ends */
+    int start = i;
+    while (i + 1 < b->bits && scr_bitmap_test(b, i + 1)) {
+      i++;
+    }
+
+    /* grow string if we need to, each range takes at most two ints */
+    if (len + 32 > size) {
+      size *= 2;
+      char* bigger = (char*) realloc(str, size);
+      if (bigger == NULL) {
+        scr_free(&str);
+        return NULL;
+      }
+      str = bigger;
+    }
+
+    const char* sep = (len > 0) ? "," : "";
+    if (start == i) {
+      len += snprintf(str + len, size - len, "%s%d", sep, start);
+    } else {
+      len += snprintf(str + len, size - len, "%s%d-%d", sep, start, i);
+    }
+    i++;
+  }
+
+  return str;
+}
+
+/* adds values from a string of ranges as written by scr_bitmap_ranges */
+static void scr_bitmap_add_ranges(scr_bitmap* b, const char* str)
+{
+  const char* p = str;
+  while (p != NULL && *p != '\0') {
+    char* end;
+    long start = strtol(p, &end, 10);
+    if (end == p) {
+      break;
+    }
+    long last = start;
+    if (*end == '-') {
+      p = end + 1;
+      last = strtol(p, &end, 10);
+      if (end == p) {
+        break;
+      }
+    }
+
+    long i;
+    for (i = start; i <= last && i < b->bits; i++) {
+      scr_bitmap_set(b, (int) i);
+    }
+
+    p = (*end == ',') ? end + 1 : NULL;
+  }
+}
+
+/* max number of rebuilds to run at the same time */
+static int scr_rebuild_jobs = SCR_REBUILD_JOBS;
+
+/* whether to fork and exec a scr_rebuild_<type> command for each
+ * rebuild rather than calling the rebuild in this process */
+static int scr_rebuild_exec = 0;
+
+/* a single rebuild command */
+typedef struct {
+  int argc;    /* number of arguments */
+  char** argv; /* command, "data" or "map", then redundancy files, NULL-terminated */
+  int rc;      /* 0 if rebuild succeeded */
+} scr_rebuild_job;
+
+/* rebuilds of one type of one dataset that workers pull from in order */
+typedef struct {
+  const spath* dir;       /* dataset directory */
+  const char* dir_str;    /* dataset directory as a string */
+  const char* build_cmd;  /* full path to rebuild command */
+  scr_rebuild_job* jobs;  /* list of rebuilds */
+  int count;              /* number of rebuilds in list */
+  int next;               /* index of next rebuild to start */
+  pthread_mutex_t mutex;  /* protects next */
+} scr_rebuild_pool;
+
+/* order rebuilds by decreasing number of redundancy files,
+ * so the largest sets start first and do not hold up the end */
+static int scr_rebuild_job_cmp(const void* a, const void* b)
+{
+  const scr_rebuild_job* ja = (const scr_rebuild_job*) a;
+  const scr_rebuild_job* jb = (const scr_rebuild_job*) b;
+  return jb->argc - ja->argc;
+}
+
+/* run a single rebuild, returns 0 on success */
+static int scr_rebuild_job_run(const scr_rebuild_pool* pool, const scr_rebuild_job* job)
+{
+  if (! scr_rebuild_exec && job->argc >= 2) {
+    /* call the rebuild in this process, files are named relative to
+     * the dataset directory, which is our working directory */
+    int build_data = (strcmp(job->argv[1], "map") != 0);
+    int numfiles = job->argc - 2;
+    const char** files = (const char**) &job->argv[2];
+    if (strcmp(pool->build_cmd, BUILD_XOR_CMD) == 0) {
+      return scr_rebuild_xor(pool->dir, build_data, numfiles, files);
+    } else if (strcmp(pool->build_cmd, BUILD_PARTNER_CMD) == 0) {
+      return scr_rebuild_partner(pool->dir, build_data, numfiles, files);
+    } else if (strcmp(pool->build_cmd, BUILD_RS_CMD) == 0) {
+      return scr_rebuild_rs(pool->dir, build_data, numfiles, files);
+    }
+  }
+
+  /* fork and exec the rebuild command, the child does nothing but
+   * chdir and execv since other threads may hold locks */
+  pid_t pid = fork();
+  if (pid == 0) {
+    if (chdir(pool->dir_str) == 0) {
+      execv(pool->build_cmd, job->argv);
+    }
+    _exit(1);
+  } else if (pid < 0) {
+    scr_err("Failed to fork rebuild command %s: errno=%d %s @ %s:%d",
+      pool->build_cmd, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return 1;
+  }
+
+  /* wait for the child to finish */
+  int stat = 0;
+  if (waitpid(pid, &stat, 0) == (pid_t)-1) {
+    scr_err("Got a -1 from waitpid @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return 1;
+  }
+  if (stat != 0) {
+    scr_err("Child returned with non-zero @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return 1;
+  }
+  return 0;
+}
+
+/* pull rebuilds from the pool and run them until none are left */
+static void* scr_rebuild_worker(void* arg)
+{
+  scr_rebuild_pool* pool = (scr_rebuild_pool*) arg;
+  while (1) {
+    pthread_mutex_lock(&pool->mutex);
+    int i = pool->next;
+    pool->next++;
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (i >= pool->count) {
+      break;
+    }
+    pool->jobs[i].rc = scr_rebuild_job_run(pool, &pool->jobs[i]);
+  }
+  return NULL;
+}
+
+/* runs commands to rebuild missing files with at most scr_rebuild_jobs
+ * running at once and waits for them to complete,
  * returns SCR_FAILURE if any dataset failed to rebuild, SCR_SUCCESS otherwise */
-int scr_fork_rebuilds(const spath* dir, const char* build_cmd, kvtree* cmds)
+int scr_run_rebuilds(const spath* dir, const char* build_cmd, kvtree* cmds)
 {
   int rc = SCR_SUCCESS;
 
   /* count the number of build commands */
   int builds = kvtree_size(cmds);
+  if (builds == 0) {
+    return rc;
+  }
 
-  /* allocate space to hold the pid for each child */
-  pid_t* pids = NULL;
-  if (builds > 0) {
-    pids = (pid_t*) malloc(builds * sizeof(pid_t));
-    if (pids == NULL) {
-      scr_err("Failed to allocate space to record pids @ %s:%d",
-        __FILE__, __LINE__
-      );
-      return SCR_FAILURE;
-    }
+  /* allocate space to hold each command */
+  scr_rebuild_job* jobs = (scr_rebuild_job*) malloc(builds * sizeof(scr_rebuild_job));
+  if (jobs == NULL) {
+    scr_err("Failed to allocate space to record rebuild commands @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
   }
 
   /* allocate character string for chdir */
   char* dir_str = spath_strdup(dir);
 
-  /* TODO: flow control the number of builds ongoing at a time */
-
-  /* step through and fork off each of our build commands */
-  int pid_count = 0;
+  /* step through and build the argv of each of our build commands */
+  int count = 0;
   kvtree_elem* elem = NULL;
   for (elem = kvtree_elem_first(cmds);
        elem != NULL;
@@ -447,9 +750,25 @@ int scr_fork_rebuilds(const spath* dir, const char* build_cmd, kvtree* cmds)
     /* sort the arguments by their index */
     kvtree_sort_int(cmd_hash, KVTREE_SORT_ASCENDING);
 
-    /* print the command to screen, so the user knows what's happening */
+    /* count the number of command line arguments */
+    int argc = kvtree_size(cmd_hash);
+
+    /* allocate space for the argv array */
+    char** argv = (char**) malloc((argc + 1) * sizeof(char*));
+    if (argv == NULL) {
+      scr_err("Failed to allocate memory for build argv @ %s:%d",
+        __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+      continue;
+    }
+
+    /* fill in our argv values and null-terminate the array,
+     * and print the command to screen, so the user knows what's happening */
+    int index = 0;
     int offset = 0;
     char full_cmd[SCR_MAX_FILENAME];
+    full_cmd[0] = '\0';
     kvtree_elem* arg_elem = NULL;
     for (arg_elem = kvtree_elem_first(cmd_hash);
          arg_elem != NULL;
@@ -457,80 +776,102 @@ int scr_fork_rebuilds(const spath* dir, const char* build_cmd, kvtree* cmds)
     {
       char* key = kvtree_elem_key(arg_elem);
       char* arg_str = kvtree_elem_get_first_val(cmd_hash, key);
+      argv[index] = arg_str;
+      index++;
+
       int remaining = sizeof(full_cmd) - offset;
       if (remaining > 0) {
         offset += snprintf(full_cmd + offset, remaining, "%s ", arg_str);
       }
     }
+    argv[index] = NULL;
     scr_dbg(0, "Rebuild command: %s\n", full_cmd);
 
-    /* count the number of command line arguments */
-    int argc = kvtree_size(cmd_hash);
+    jobs[count].argc = argc;
+    jobs[count].argv = argv;
+    jobs[count].rc   = 1;
+    count++;
+  }
 
-    /* issue build command */
-    pids[pid_count] = fork();
-    if (pids[pid_count] == 0) {
-      /* this is the child, which will do the exec, build the argv array */
+  /* start the largest rebuilds first */
+  qsort(jobs, count, sizeof(scr_rebuild_job), scr_rebuild_job_cmp);
 
-      /* allocate space for the argv array */
-      char** argv = (char**) malloc((argc + 1) * sizeof(char*));
-      if (argv == NULL) {
-        scr_err("Failed to allocate memory for build execv @ %s:%d",
-          __FILE__, __LINE__
-        );
-        exit(1);
-      }
+  /* rebuilds in this process open files relative to the dataset directory */
+  char cwd[SCR_MAX_FILENAME];
+  int changed_dir = 0;
+  int runnable = count;
+  if (! scr_rebuild_exec) {
+    if (getcwd(cwd, sizeof(cwd)) != NULL && chdir(dir_str) == 0) {
+      changed_dir = 1;
+    } else {
+      scr_err("Failed to change to directory %s @ %s:%d",
+        dir_str, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+      runnable = 0;
+    }
+  }
 
-      /* fill in our argv values and null-terminate the array */
-      int index = 0;
-      kvtree_elem* arg_elem = NULL;
-      for (arg_elem = kvtree_elem_first(cmd_hash);
-           arg_elem != NULL;
-           arg_elem = kvtree_elem_next(arg_elem))
+  /* run the rebuilds with a pool of workers,
+   * this thread serves as one of the workers */
+  scr_rebuild_pool pool;
+  pool.dir       = dir;
+  pool.dir_str   = dir_str;
+  pool.build_cmd = build_cmd;
+  pool.jobs      = jobs;
+  pool.count     = runnable;
+  pool.next      = 0;
+  pthread_mutex_init(&pool.mutex, NULL);
+
+  int workers = scr_rebuild_jobs;
+  if (workers > runnable) {
+    workers = runnable;
+  }
+  pthread_t* threads = NULL;
+  int nthreads = 0;
+  if (workers > 1) {
+    threads = (pthread_t*) malloc((workers - 1) * sizeof(pthread_t));
+    if (threads != NULL) {
+      while (nthreads < workers - 1 &&
+             pthread_create(&threads[nthreads], NULL, scr_rebuild_worker, &pool) == 0)
       {
-        char* key = kvtree_elem_key(arg_elem);
-        argv[index] = kvtree_elem_get_first_val(cmd_hash, key);
-        index++;
+        nthreads++;
       }
-      argv[index] = NULL;
+    }
+  }
+  scr_rebuild_worker(&pool);
 
-      /* cd to current working directory */
-      if (chdir(dir_str) != 0) {
-        scr_err("Failed to change to directory %s @ %s:%d",
-          dir_str, __FILE__, __LINE__
-        );
-        exit(1);
-      }
+  /* wait for the other workers to finish */
+  int i;
+  for (i = 0; i < nthreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  scr_free(&threads);
+  pthread_mutex_destroy(&pool.mutex);
 
-      /* execv the build command */
-      execv(build_cmd, argv);
-    }
-    pid_count++;
+  /* go back to where we started */
+  if (changed_dir && chdir(cwd) != 0) {
+    scr_err("Failed to change back to directory %s @ %s:%d",
+      cwd, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
   }
 
-  /* wait for for each child to finish */
-  while (pid_count > 0) {
-    int stat = 0;
-    int ret = wait(&stat);
-    if (ret == -1 || ret == (pid_t)-1) {
-      scr_err("Got a -1 from wait @ %s:%d",
-        __FILE__, __LINE__
-      );
-      rc = SCR_FAILURE;
-    } else if (stat != 0) {
-      scr_err("Child returned with non-zero @ %s:%d",
-        __FILE__, __LINE__
-      );
+  /* check that every rebuild succeeded */
+  for (i = 0; i < count; i++) {
+    if (jobs[i].rc != 0) {
       rc = SCR_FAILURE;
     }
-    pid_count--;
   }
 
   /* free the directory string */
   scr_free(&dir_str);
 
-  /* free the pid array */
-  scr_free(&pids);
+  /* free the commands, the arguments themselves belong to the hash */
+  for (i = 0; i < count; i++) {
+    scr_free(&jobs[i].argv);
+  }
+  scr_free(&jobs);
 
   return rc;
 }
@@ -540,7 +881,7 @@ static int scr_rebuild_redset(
   const spath* dir,
   int dset_id,
   kvtree* dset_hash,
-  const kvtree* missing_hash,
+  const scr_bitmap* missing,
   const char* type_key,
   const char* type_cmd,
   const char* rebuild_cmd,
@@ -575,38 +916,52 @@ static int scr_rebuild_redset(
       continue;
     }
 
+    /* note which members we have redundancy files for in one pass,
+     * members are numbered from 1, so bit 0 goes unused */
+    scr_bitmap present;
+    scr_bitmap_init(&present, members + 1);
+    kvtree** member_hashes = (kvtree**) calloc(members + 1, sizeof(kvtree*));
+
     /* attempt a rebuild if either:
      *   a member is missing (likely lost all files for that rank)
      *   or if we have all members but one of the corresponding ranks
      *     is missing files (got the redundancy file, but missing the data files) */
-    int missing_count = 0;
-    int member;
-    for (member = 1; member <= members; member++) {
-      kvtree* member_hash = kvtree_get_kv_int(set_hash, SCR_SCAN_KEY_MEMBER, member);
-      if (member_hash == NULL) {
-        /* we're missing the redundancy file for this member */
-        missing_count++;
-      } else {
-        /* get the rank this member corresponds to */
-        char* rank_str;
-        if (kvtree_util_get_str(member_hash, SCR_SUMMARY_6_KEY_RANK, &rank_str) == KVTREE_SUCCESS) {
-          /* check whether we're missing any files for this rank */
-          kvtree* missing_rank_hash = kvtree_get(missing_hash, rank_str);
-          if (missing_rank_hash != NULL) {
-            /* we have the redundancy file for this member,
-             * but we're missing one or more regular files */
-            missing_count++;
-          }
-        } else {
-          /* couldn't identify rank for this member, print an error */
-          scr_err("Could not identify rank corresponding to member %d of set %d in dataset %d @ %s:%d",
-            member, setid, dset_id, __FILE__, __LINE__
-          );
-          rc = SCR_FAILURE;
+    int lost_count = 0;
+    kvtree_elem* member_elem = NULL;
+    kvtree* members_hash = kvtree_get(set_hash, SCR_SCAN_KEY_MEMBER);
+    for (member_elem = kvtree_elem_first(members_hash);
+         member_elem != NULL;
+         member_elem = kvtree_elem_next(member_elem))
+    {
+      int member = kvtree_elem_key_int(member_elem);
+      kvtree* member_hash = kvtree_elem_hash(member_elem);
+      if (member < 1 || member > members || member_hashes == NULL) {
+        continue;
+      }
+      scr_bitmap_set(&present, member);
+      member_hashes[member] = member_hash;
+
+      /* get the rank this member corresponds to */
+      char* rank_str;
+      if (kvtree_util_get_str(member_hash, SCR_SUMMARY_6_KEY_RANK, &rank_str) == KVTREE_SUCCESS) {
+        /* check whether we're missing any files for this rank */
+        if (scr_bitmap_test(missing, atoi(rank_str))) {
+          /* we have the redundancy file for this member,
+           * but we're missing one or more regular files */
+          lost_count++;
         }
+      } else {
+        /* couldn't identify rank for this member, print an error */
+        scr_err("Could not identify rank corresponding to member %d of set %d in dataset %d @ %s:%d",
+          member, setid, dset_id, __FILE__, __LINE__
+        );
+        rc = SCR_FAILURE;
       }
     }
 
+    /* count members without redundancy files along with members missing data */
+    int missing_count = members - scr_bitmap_count(&present) + lost_count;
+
     /* attempt to rebuild if we're missing any member */
     if (max_missing != -1 && missing_count > max_missing) {
       /* TODO: unrecoverable */
@@ -626,15 +981,18 @@ static int scr_rebuild_redset(
       argc++;
 
       /* write each of the existing redundancy file names, skipping the missing member */
+      int member;
       for (member = 1; member <= members; member++) {
-        kvtree* member_hash = kvtree_get_kv_int(set_hash, SCR_SCAN_KEY_MEMBER, member);
-        if (member_hash != NULL) {
-          char* filename = kvtree_elem_get_first_val(member_hash, SCR_SUMMARY_6_KEY_FILE);
+        if (scr_bitmap_test(&present, member)) {
+          char* filename = kvtree_elem_get_first_val(member_hashes[member], SCR_SUMMARY_6_KEY_FILE);
           kvtree_setf(buildcmd_hash, NULL, "%d %s", argc, filename);
           argc++;
         }
       }
     }
+
+    scr_free(&member_hashes);
+    scr_bitmap_free(&present);
   }
 
   /* rebuild if we can */
@@ -649,7 +1007,7 @@ static int scr_rebuild_redset(
   } else {
     /* we have a shot to rebuild everything, let's give it a go */
     kvtree* builds_hash = kvtree_get(dset_hash, SCR_SCAN_KEY_BUILD);
-    if (scr_fork_rebuilds(dir, rebuild_cmd, builds_hash) != SCR_SUCCESS) {
+    if (scr_run_rebuilds(dir, rebuild_cmd, builds_hash) != SCR_SUCCESS) {
       scr_err("At least one rebuild failed for dataset %d in %s @ %s:%d",
         dset_id, dir_str, __FILE__, __LINE__
       );
@@ -686,15 +1044,23 @@ int scr_rebuild_scan(const spath* prefix, const spath* dir, kvtree* scan)
     }
 
     /* check whether there are any missing files in this dataset */
-    kvtree* missing_hash = kvtree_get(dset_hash, SCR_SCAN_KEY_MISSING);
-    if (missing_hash != NULL) {
+    char* missing_str;
+    if (kvtree_util_get_str(dset_hash, SCR_SCAN_KEY_MISSING, &missing_str) == KVTREE_SUCCESS) {
       /* need to rebuild some files, determine the encoding type
        * and call corresponding function to define rebuild command */
 
+      /* expand the ranges of missing ranks into a bitmap */
+      int ranks = 0;
+      kvtree* rank2file_hash = kvtree_get(dset_hash, SCR_SUMMARY_6_KEY_RANK2FILE);
+      kvtree_util_get_int(rank2file_hash, SCR_SUMMARY_6_KEY_RANKS, &ranks);
+      scr_bitmap missing;
+      scr_bitmap_init(&missing, ranks);
+      scr_bitmap_add_ranges(&missing, missing_str);
+
       /* rebuild filemap files with PARTNER */
       kvtree* mappartner_hash = kvtree_get(dset_hash, SCR_SCAN_KEY_MAPPARTNER);
       if (mappartner_hash != NULL) {
-        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, missing_hash, SCR_SCAN_KEY_MAPPARTNER, "map", BUILD_PARTNER_CMD, -1);
+        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, &missing, SCR_SCAN_KEY_MAPPARTNER, "map", BUILD_PARTNER_CMD, -1);
         if (tmp_rc != SCR_SUCCESS) {
           rc = SCR_FAILURE;
         }
@@ -703,7 +1069,7 @@ int scr_rebuild_scan(const spath* prefix, const spath* dir, kvtree* scan)
       /* rebuild filemap files with XOR */
       kvtree* mapxor_hash = kvtree_get(dset_hash, SCR_SCAN_KEY_MAPXOR);
       if (mapxor_hash != NULL) {
-        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, missing_hash, SCR_SCAN_KEY_MAPXOR, "map", BUILD_XOR_CMD, 1);
+        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, &missing, SCR_SCAN_KEY_MAPXOR, "map", BUILD_XOR_CMD, 1);
         if (tmp_rc != SCR_SUCCESS) {
           rc = SCR_FAILURE;
         }
@@ -712,7 +1078,7 @@ int scr_rebuild_scan(const spath* prefix, const spath* dir, kvtree* scan)
       /* rebuild filemap files with RS */
       kvtree* maprs_hash = kvtree_get(dset_hash, SCR_SCAN_KEY_MAPRS);
       if (maprs_hash != NULL) {
-        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, missing_hash, SCR_SCAN_KEY_MAPRS, "map", BUILD_RS_CMD, -1);
+        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, &missing, SCR_SCAN_KEY_MAPRS, "map", BUILD_RS_CMD, -1);
         if (tmp_rc != SCR_SUCCESS) {
           rc = SCR_FAILURE;
         }
@@ -721,7 +1087,7 @@ int scr_rebuild_scan(const spath* prefix, const spath* dir, kvtree* scan)
       /* rebuild data files with PARTNER */
       kvtree* partner_hash = kvtree_get(dset_hash, SCR_SCAN_KEY_PARTNER);
       if (partner_hash != NULL) {
-        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, missing_hash, SCR_SCAN_KEY_PARTNER, "partner", BUILD_PARTNER_CMD, -1);
+        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, &missing, SCR_SCAN_KEY_PARTNER, "partner", BUILD_PARTNER_CMD, -1);
         if (tmp_rc != SCR_SUCCESS) {
           rc = SCR_FAILURE;
         }
@@ -730,7 +1096,7 @@ int scr_rebuild_scan(const spath* prefix, const spath* dir, kvtree* scan)
       /* rebuild data files with XOR */
       kvtree* xor_hash = kvtree_get(dset_hash, SCR_SCAN_KEY_XOR);
       if (xor_hash != NULL) {
-        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, missing_hash, SCR_SCAN_KEY_XOR, "xor", BUILD_XOR_CMD, 1);
+        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, &missing, SCR_SCAN_KEY_XOR, "xor", BUILD_XOR_CMD, 1);
         if (tmp_rc != SCR_SUCCESS) {
           rc = SCR_FAILURE;
         }
@@ -739,11 +1105,13 @@ int scr_rebuild_scan(const spath* prefix, const spath* dir, kvtree* scan)
       /* rebuild data files with RS */
       kvtree* rs_hash = kvtree_get(dset_hash, SCR_SCAN_KEY_RS);
       if (rs_hash != NULL) {
-        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, missing_hash, SCR_SCAN_KEY_RS, "rs", BUILD_RS_CMD, -1);
+        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, &missing, SCR_SCAN_KEY_RS, "rs", BUILD_RS_CMD, -1);
         if (tmp_rc != SCR_SUCCESS) {
           rc = SCR_FAILURE;
         }
       }
+
+      scr_bitmap_free(&missing);
     }
   }
 
@@ -795,6 +1163,11 @@ int scr_inspect_scan(kvtree* scan)
     /* assume this dataset is valid */
     int dataset_valid = 1;
 
+    /* track ranks that are missing files in a bitmap,
+     * rather than adding an entry to the hash for each one */
+    scr_bitmap missing;
+    scr_bitmap_init(&missing, ranks);
+
     /* get the ranks hash and sort it by rank id */
     kvtree* ranks_hash = kvtree_get(rank2file_hash, SCR_SUMMARY_6_KEY_RANK);
     kvtree_sort_int(ranks_hash, KVTREE_SORT_ASCENDING);
@@ -832,7 +1205,7 @@ int scr_inspect_scan(kvtree* scan)
 
       /* if rank_id is higher than expected rank, mark the expected rank as missing */
       while (expected_rank < rank_id) {
-        kvtree_set_kv_int(dset_hash, SCR_SCAN_KEY_MISSING, expected_rank);
+        scr_bitmap_set(&missing, expected_rank);
         expected_rank++;
       }
 
@@ -875,7 +1248,7 @@ int scr_inspect_scan(kvtree* scan)
         if (kvtree_util_get_int(file_hash, SCR_SUMMARY_6_KEY_COMPLETE, &complete) == KVTREE_SUCCESS) {
           if (complete == 0) {
             /* file is explicitly marked as incomplete, add the rank to the missing list */
-            kvtree_set_kv_int(dset_hash, SCR_SCAN_KEY_MISSING, rank_id);
+            scr_bitmap_set(&missing, rank_id);
           }
         }
 
@@ -884,7 +1257,7 @@ int scr_inspect_scan(kvtree* scan)
 
       /* if we're missing any files, mark this rank as missing */
       if (file_count < files) {
-        kvtree_set_kv_int(dset_hash, SCR_SCAN_KEY_MISSING, rank_id);
+        scr_bitmap_set(&missing, rank_id);
       }
 
       /* if we found more files than expected, mark the dataset as incomplete */
@@ -902,7 +1275,7 @@ int scr_inspect_scan(kvtree* scan)
     /* check that we found all of the ranks */
     while (expected_rank < ranks) {
       /* mark the expected rank as missing */
-      kvtree_set_kv_int(dset_hash, SCR_SCAN_KEY_MISSING, expected_rank);
+      scr_bitmap_set(&missing, expected_rank);
       expected_rank++;
     }
 
@@ -921,14 +1294,24 @@ int scr_inspect_scan(kvtree* scan)
       kvtree_setf(dset_hash, NULL, "%s", SCR_SCAN_KEY_INVALID);
     }
 
-    /* check whether we have any missing files for this dataset */
-    kvtree* missing_hash = kvtree_get(dset_hash, SCR_SCAN_KEY_MISSING);
-    if (missing_hash != NULL) {
+    /* check whether we have any missing files for this dataset,
+     * and record missing ranks as ranges for the rebuild */
+    int missing_count = scr_bitmap_count(&missing);
+    if (missing_count > 0) {
       any_missing = 1;
+      char* missing_str = scr_bitmap_ranges(&missing);
+      if (missing_str != NULL) {
+        scr_dbg(0, "Dataset %d is missing files for %d of %d ranks: %s",
+          dset_id, missing_count, ranks, missing_str
+        );
+        kvtree_util_set_str(dset_hash, SCR_SCAN_KEY_MISSING, missing_str);
+        scr_free(&missing_str);
+      }
     }
+    scr_bitmap_free(&missing);
 
     /* if dataset is not marked invalid, and if there are no missing files, then mark it as complete */
-    if (dataset_valid && missing_hash == NULL) {
+    if (dataset_valid && missing_count == 0) {
       kvtree_set_kv_int(dset_hash, SCR_SUMMARY_6_KEY_COMPLETE, 1);
     }
   }
@@ -1020,6 +1403,25 @@ int scr_scan_filemap(const spath* path_prefix, const spath* path_filemap, int ds
   /* lookup rank hash for this rank */
   kvtree* rank_hash = kvtree_set_kv_int(rank2file_hash, SCR_SUMMARY_6_KEY_RANK, rank_id);
 
+  /* a scavenge may have packed files of this rank into a container,
+   * in which case it lists their locations beside the filemap */
+  kvtree* ctrmap = kvtree_new();
+  spath* path_ctrmap = spath_dup(path_filemap);
+  spath_dirname(path_ctrmap);
+  spath_append_strf(path_ctrmap, "ctrmap_%d", rank_id);
+  char* ctrmap_file = spath_strdup(path_ctrmap);
+  if (access(ctrmap_file, R_OK) == 0) {
+    kvtree_read_path(path_ctrmap, ctrmap);
+  }
+  scr_free(&ctrmap_file);
+  spath_delete(&path_ctrmap);
+
+  /* list the container with one rank so it is deleted with the dataset */
+  char* owned_container = NULL;
+  if (kvtree_util_get_str(ctrmap, SCR_KEY_CONTAINER, &owned_container) == KVTREE_SUCCESS) {
+    kvtree_set_kv(rank_hash, SCR_SUMMARY_6_KEY_CONTAINER, owned_container);
+  }
+
   /* set number of expected files for this rank */
   int num_expect = scr_filemap_num_files(rank_map);
   kvtree_set_kv_int(rank_hash, SCR_SUMMARY_6_KEY_FILES, num_expect);
@@ -1118,6 +1520,16 @@ int scr_scan_filemap(const spath* path_prefix, const spath* path_filemap, int ds
       continue;
     }
 
+    /* a file compressed during flush takes its compressed size on disk */
+    unsigned long expect_size = meta_filesize;
+    int comp_type = SCR_COMPRESS_NONE;
+    unsigned long compsize = 0;
+    if (scr_meta_get_compress(meta, &comp_type, &compsize) == SCR_SUCCESS &&
+        comp_type != SCR_COMPRESS_NONE && compsize > 0)
+    {
+      expect_size = compsize;
+    }
+
     /* set our ranks if it's not been set */
     if (*ranks == -1) {
       *ranks = meta_ranks;
@@ -1136,8 +1548,39 @@ int scr_scan_filemap(const spath* path_prefix, const spath* path_filemap, int ds
       continue;
     }
 
+    /* a packed file is where the container says it is */
+    char* container_rel = NULL;
+    unsigned long container_offset = 0;
+    unsigned long container_length = 0;
+    kvtree* ctr_hash = kvtree_get_kv(ctrmap, SCR_KEY_FILE, cache_file_name);
+    if (kvtree_util_get_str(ctr_hash, SCR_KEY_CONTAINER, &container_rel) == KVTREE_SUCCESS) {
+      kvtree_util_get_unsigned_long(ctr_hash, SCR_KEY_OFFSET, &container_offset);
+      kvtree_util_get_unsigned_long(ctr_hash, SCR_KEY_LENGTH, &container_length);
+
+      spath* path_container = spath_dup(path_prefix);
+      spath_append_str(path_container, container_rel);
+      char* container = spath_strdup(path_container);
+      spath_delete(&path_container);
+
+      int valid = (scr_file_exists(container) == SCR_SUCCESS &&
+                   scr_file_size(container) >= container_offset + container_length &&
+                   container_length == expect_size);
+      if (! valid) {
+        scr_err("Container %s does not hold %lu bytes at %lu for %s @ %s:%d",
+          container, expect_size, container_offset, full_filename, __FILE__, __LINE__
+        );
+      }
+      scr_free(&container);
+      if (! valid) {
+        scr_meta_delete(&meta);
+        scr_free(&relative_filename);
+        scr_free(&full_filename);
+        continue;
+      }
+    }
+
     /* check that the file exists */
-    if (scr_file_exists(full_filename) != SCR_SUCCESS) {
+    if (container_rel == NULL && scr_file_exists(full_filename) != SCR_SUCCESS) {
       scr_err("File does not exist: %s @ %s:%d",
         full_filename, __FILE__, __LINE__
       );
@@ -1148,10 +1591,10 @@ int scr_scan_filemap(const spath* path_prefix, const spath* path_filemap, int ds
     }
 
     /* check that the file size matches */
-    unsigned long size = scr_file_size(full_filename);
-    if (meta_filesize != size) {
+    unsigned long size = (container_rel != NULL) ? container_length : scr_file_size(full_filename);
+    if (expect_size != size) {
       scr_err("File is %lu bytes but expected to be %lu bytes: %s @ %s:%d",
-        size, meta_filesize, full_filename, __FILE__, __LINE__
+        size, expect_size, full_filename, __FILE__, __LINE__
       );
       scr_meta_delete(&meta);
       scr_free(&relative_filename);
@@ -1188,7 +1631,12 @@ int scr_scan_filemap(const spath* path_prefix, const spath* path_filemap, int ds
     kvtree* rank2file_hash = kvtree_get(list_hash, SCR_SUMMARY_6_KEY_RANK2FILE);
     kvtree_set_kv_int(rank2file_hash, SCR_SUMMARY_6_KEY_RANKS, meta_ranks);
     kvtree* rank_hash = kvtree_set_kv_int(rank2file_hash, SCR_SUMMARY_6_KEY_RANK, rank_id);
-    kvtree_set_kv(rank_hash, SCR_SUMMARY_6_KEY_FILE, relative_filename);
+    kvtree* file_hash = kvtree_set_kv(rank_hash, SCR_SUMMARY_6_KEY_FILE, relative_filename);
+    if (container_rel != NULL) {
+      kvtree_util_set_str(file_hash, SCR_SUMMARY_6_KEY_CONTAINER, container_rel);
+      kvtree_util_set_unsigned_long(file_hash, SCR_SUMMARY_6_KEY_OFFSET, container_offset);
+      kvtree_util_set_unsigned_long(file_hash, SCR_SUMMARY_6_KEY_LENGTH, container_length);
+    }
 
     uLong meta_crc;
     if (scr_meta_get_crc32(meta, &meta_crc) == SCR_SUCCESS) {
@@ -1201,6 +1649,7 @@ int scr_scan_filemap(const spath* path_prefix, const spath* path_filemap, int ds
   }
 
   /* delete the filemap */
+  kvtree_delete(&ctrmap);
   scr_filemap_delete(&rank_map);
 
   return SCR_SUCCESS;
@@ -1251,229 +1700,265 @@ int scr_scan_redset(
   return rc;
 }
 
-/* returns 1 if name matches "filemap_<rank>" regex and extracts rank value,
- * returns 0 if no match */
-int match_filemap(const char* name, const regex_t* re, int* rank)
+/* kinds of files scr_scan_files looks for */
+#define SCR_SCAN_FILE_NONE    (0)
+#define SCR_SCAN_FILE_FILEMAP (1)
+#define SCR_SCAN_FILE_REDSET  (2)
+
+/* what scr_scan_match extracts from a file name */
+typedef struct {
+  int kind;        /* SCR_SCAN_FILE_* */
+  const char* key; /* scan key of redundancy file */
+  int rank;
+  int group_id;
+  int group_num;
+  int group_rank;
+  int group_size;
+} scr_scan_match_t;
+
+/* classify a file name in one pass, replacing a regex per kind of file:
+ *   filemap_<rank>
+ *   reddesc[map].er.<rank>.<partner|xor|rs>.grp_<id>_of_<num>.mem_<rank>_of_<size>.redset
+ * returns 1 and fills in m if name is one of these, 0 otherwise */
+static int scr_scan_match(const char* name, scr_scan_match_t* m)
 {
-  /* assume we don't match */
-  int rc = 0;
-
-  /* check whether the regex matches */
-  size_t nmatch = 2;
-  regmatch_t pmatch[nmatch];
-  if (regexec(re, name, nmatch, pmatch, 0) == 0) {
-    /* made a match, now extract the rank value */
-    char* value = strndup(name + pmatch[1].rm_so, (size_t)(pmatch[1].rm_eo - pmatch[1].rm_so));
-    if (value != NULL) {
-      /* got the rank as a string */
-      rc = 1;
-      *rank = atoi(value);
-      scr_free(&value);
-    }
+  m->kind       = SCR_SCAN_FILE_NONE;
+  m->key        = NULL;
+  m->rank       = -1;
+  m->group_id   = -1;
+  m->group_num  = -1;
+  m->group_rank = -1;
+  m->group_size = -1;
+
+  /* filemap_<rank> */
+  const char* p = strstr(name, "filemap_");
+  if (p != NULL && p[8] >= '0' && p[8] <= '9') {
+    m->kind = SCR_SCAN_FILE_FILEMAP;
+    m->rank = atoi(p + 8);
+    return 1;
   }
 
-  return rc;
-}
-
-/* returns 1 if name matches partner regex and extracts rank and partner rank,
- * returns 0 if no match */
-int match_partner(
-  const char* name,
-  const regex_t* re,
-  int* rank,
-  int* group_id,
-  int* group_num,
-  int* group_rank,
-  int* group_size)
-{
-  /* assume we don't match */
-  int rc = 0;
+  /* redundancy files for data and for filemaps */
+  int map = 0;
+  if ((p = strstr(name, "reddescmap.er.")) != NULL) {
+    map = 1;
+    p += strlen("reddescmap.er.");
+  } else if ((p = strstr(name, "reddesc.er.")) != NULL) {
+    p += strlen("reddesc.er.");
+  } else {
+    return 0;
+  }
 
-  /* if the file is an partner file, read in the partner parameters */
-  size_t nmatch = 6;
-  regmatch_t pmatch[nmatch];
-  if (regexec(re, name, nmatch, pmatch, 0) == 0) {
-    /* got a match */
-    rc = 1;
+  char type[8];
+  int end = 0;
+  int n = sscanf(p, "%d.%7[a-z].grp_%d_of_%d.mem_%d_of_%d.redset%n",
+    &m->rank, type, &m->group_id, &m->group_num, &m->group_rank, &m->group_size, &end
+  );
+  if (n != 6 || end == 0) {
+    return 0;
+  }
 
-    /* intialize output variables */
-    *rank       = -1;
-    *group_id   = -1;
-    *group_num  = -1;
-    *group_rank = -1;
-    *group_size = -1;
+  if (strcmp(type, "partner") == 0) {
+    m->key = map ? SCR_SCAN_KEY_MAPPARTNER : SCR_SCAN_KEY_PARTNER;
+  } else if (strcmp(type, "xor") == 0) {
+    m->key = map ? SCR_SCAN_KEY_MAPXOR : SCR_SCAN_KEY_XOR;
+  } else if (strcmp(type, "rs") == 0) {
+    m->key = map ? SCR_SCAN_KEY_MAPRS : SCR_SCAN_KEY_RS;
+  } else {
+    return 0;
+  }
+  m->kind = SCR_SCAN_FILE_REDSET;
+  return 1;
+}
 
-    /* get our global rank */
-    char* value = strndup(name + pmatch[1].rm_so, (size_t)(pmatch[1].rm_eo - pmatch[1].rm_so));
-    if (value != NULL) {
-      *rank = atoi(value);
-      scr_free(&value);
-    }
+/* max number of threads to read filemaps with at the same time */
+static int scr_scan_threads = SCR_SCAN_THREADS;
 
-    /* get our group_id */
-    value = strndup(name + pmatch[2].rm_so, (size_t)(pmatch[2].rm_eo - pmatch[2].rm_so));
-    if (value != NULL) {
-      *group_id = atoi(value);
-      scr_free(&value);
-    }
+/* seconds between progress messages while scanning, 0 for none */
+static int scr_scan_progress = 0;
 
-    /* get the number of groups */
-    value = strndup(name + pmatch[3].rm_so, (size_t)(pmatch[3].rm_eo - pmatch[3].rm_so));
-    if (value != NULL) {
-      *group_num = atoi(value);
-      scr_free(&value);
-    }
+#if defined(__linux__) && defined(SYS_getdents64)
+/* record layout returned by getdents64, which glibc does not declare */
+struct scr_dirent64 {
+  uint64_t       d_ino;
+  int64_t        d_off;
+  unsigned short d_reclen;
+  unsigned char  d_type;
+  char           d_name[];
+};
 
-    /* get the rank */
-    value = strndup(name + pmatch[4].rm_so, (size_t)(pmatch[4].rm_eo - pmatch[4].rm_so));
-    if (value != NULL) {
-      *group_rank = atoi(value);
-      scr_free(&value);
-    }
+/* bytes of directory entries to read per system call */
+#define SCR_SCAN_DENTS_SIZE (1024 * 1024)
+#endif
 
-    /* get the rank of our right partner */
-    value = strndup(name + pmatch[5].rm_so, (size_t)(pmatch[5].rm_eo - pmatch[5].rm_so));
-    if (value != NULL) {
-      *group_size = atoi(value);
-      scr_free(&value);
-    }
+/* add name to list of names, growing it as needed */
+static void scr_scan_list_add(char*** names, int* count, int* cap, const char* name)
+{
+  if (*count == *cap) {
+    int newcap = (*cap > 0) ? *cap * 2 : 1024;
+    char** list = (char**) SCR_MALLOC(newcap * sizeof(char*));
+    if (*count > 0) {
+      memcpy(list, *names, *count * sizeof(char*));
+    }
+    scr_free(names);
+    *names = list;
+    *cap = newcap;
   }
-
-  return rc;
+  (*names)[*count] = strdup(name);
+  (*count)++;
 }
 
-/* returns 1 if name matches XOR regex and extracts rank, group, group size, and group rank,
- w returns 0 if no match */
-int match_xor(
-  const char* name,
-  const regex_t* re,
-  int* rank,
-  int* group_id,
-  int* group_num,
-  int* group_rank,
-  int* group_size)
+/* list names of entries in directory that are not directories,
+ * reads many entries per system call where we can */
+static int scr_scan_list(const char* dir_str, char*** names, int* count)
 {
-  /* assume we don't match */
-  int rc = 0;
-
-  /* if the file is an XOR file, read in the XOR set parameters */
-  size_t nmatch = 6;
-  regmatch_t pmatch[nmatch];
-  if (regexec(re, name, nmatch, pmatch, 0) == 0) {
-    /* got a match */
-    rc = 1;
+  *names = NULL;
+  *count = 0;
+  int cap = 0;
 
-    /* intialize output variables */
-    *rank       = -1;
-    *group_id   = -1;
-    *group_num  = -1;
-    *group_rank = -1;
-    *group_size = -1;
+#if defined(__linux__) && defined(SYS_getdents64)
+  int fd = open(dir_str, O_RDONLY | O_DIRECTORY);
+  if (fd < 0) {
+    scr_err("Failed to open directory %s (errno=%d %s) @ %s:%d",
+      dir_str, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
 
-    /* get the rank of the xor set */
-    char* value = strndup(name + pmatch[1].rm_so, (size_t)(pmatch[1].rm_eo - pmatch[1].rm_so));
-    if (value != NULL) {
-      *rank = atoi(value);
-      scr_free(&value);
+  int rc = SCR_SUCCESS;
+  char* buf = (char*) SCR_MALLOC(SCR_SCAN_DENTS_SIZE);
+  while (1) {
+    long nread = syscall(SYS_getdents64, fd, buf, SCR_SCAN_DENTS_SIZE);
+    if (nread < 0) {
+      scr_err("Failed to read directory %s (errno=%d %s) @ %s:%d",
+        dir_str, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+      break;
     }
-
-    /* get the id of the xor set */
-    value = strndup(name + pmatch[2].rm_so, (size_t)(pmatch[2].rm_eo - pmatch[2].rm_so));
-    if (value != NULL) {
-      *group_id = atoi(value);
-      scr_free(&value);
+    if (nread == 0) {
+      break;
     }
 
-    /* get the number of xor sets */
-    value = strndup(name + pmatch[3].rm_so, (size_t)(pmatch[3].rm_eo - pmatch[3].rm_so));
-    if (value != NULL) {
-      *group_num = atoi(value);
-      scr_free(&value);
+    long offset = 0;
+    while (offset < nread) {
+      struct scr_dirent64* d = (struct scr_dirent64*) (buf + offset);
+      if (d->d_type != DT_DIR) {
+        scr_scan_list_add(names, count, &cap, d->d_name);
+      }
+      offset += d->d_reclen;
     }
+  }
+  scr_free(&buf);
+  close(fd);
+  return rc;
+#else
+  DIR* dirp = opendir(dir_str);
+  if (dirp == NULL) {
+    scr_err("Failed to open directory %s (errno=%d %s) @ %s:%d",
+      dir_str, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
 
-    /* get the rank in the xor set */
-    value = strndup(name + pmatch[4].rm_so, (size_t)(pmatch[4].rm_eo - pmatch[4].rm_so));
-    if (value != NULL) {
-      *group_rank = atoi(value);
-      scr_free(&value);
+  int rc = SCR_SUCCESS;
+  struct dirent* dp = NULL;
+  do {
+    errno = 0;
+    dp = readdir(dirp);
+    if (dp != NULL) {
+      #ifdef _DIRENT_HAVE_D_TYPE
+        /* distinguish between directories and files if we can */
+        if (dp->d_type != DT_DIR) {
+          scr_scan_list_add(names, count, &cap, dp->d_name);
+        }
+      #else
+        scr_scan_list_add(names, count, &cap, dp->d_name);
+      #endif
+    } else if (errno != 0) {
+      scr_err("Failed to read directory %s (errno=%d %s) @ %s:%d",
+        dir_str, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
     }
+  } while (dp != NULL);
 
-    /* get the size of the xor set */
-    value = strndup(name + pmatch[5].rm_so, (size_t)(pmatch[5].rm_eo - pmatch[5].rm_so));
-    if (value != NULL) {
-      *group_size = atoi(value);
-      scr_free(&value);
-    }
+  if (closedir(dirp) < 0) {
+    scr_err("Failed to close directory %s (errno=%d %s) @ %s:%d",
+      dir_str, errno, strerror(errno), __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
   }
-
   return rc;
+#endif
 }
 
-/* returns 1 if name matches XOR regex and extracts rank, group, group size, and group rank,
- * returns 0 if no match */
-int match_rs(
-  const char* name,
-  const regex_t* re,
-  int* rank,
-  int* group_id,
-  int* group_num,
-  int* group_rank,
-  int* group_size)
+/* filemaps of one dataset that workers pull from in order */
+typedef struct {
+  const spath* prefix;    /* prefix directory */
+  const spath* dir;       /* dataset directory */
+  int dset_id;            /* dataset id */
+  char** names;           /* names of filemap files */
+  int* ranks_of;          /* rank of each filemap */
+  int count;              /* number of filemaps */
+  int next;               /* index of next filemap to read */
+  int done;               /* number of filemaps read */
+  int rc;                 /* SCR_FAILURE if any filemap failed to read */
+  double start;           /* time scan started */
+  pthread_mutex_t mutex;  /* protects next, done, and rc */
+} scr_scan_pool;
+
+/* what each worker accumulates on its own */
+typedef struct {
+  scr_scan_pool* pool;
+  kvtree* scan;   /* scan hash of filemaps this worker read */
+  int ranks;      /* ranks value found in those filemaps */
+  int report;     /* whether this worker prints progress */
+} scr_scan_worker_t;
+
+/* pull filemaps from the pool and read them until none are left */
+static void* scr_scan_worker(void* arg)
 {
-  /* assume we don't match */
-  int rc = 0;
-
-  /* if the file is an RS file, read in the RS set parameters */
-  size_t nmatch = 6;
-  regmatch_t pmatch[nmatch];
-  if (regexec(re, name, nmatch, pmatch, 0) == 0) {
-    /* got a match */
-    rc = 1;
-
-    /* intialize output variables */
-    *rank       = -1;
-    *group_id   = -1;
-    *group_num  = -1;
-    *group_rank = -1;
-    *group_size = -1;
-
-    /* get the rank of the xor set */
-    char* value = strndup(name + pmatch[1].rm_so, (size_t)(pmatch[1].rm_eo - pmatch[1].rm_so));
-    if (value != NULL) {
-      *rank = atoi(value);
-      scr_free(&value);
-    }
-
-    /* get the id of the xor set */
-    value = strndup(name + pmatch[2].rm_so, (size_t)(pmatch[2].rm_eo - pmatch[2].rm_so));
-    if (value != NULL) {
-      *group_id = atoi(value);
-      scr_free(&value);
-    }
-
-    /* get the number of xor sets */
-    value = strndup(name + pmatch[3].rm_so, (size_t)(pmatch[3].rm_eo - pmatch[3].rm_so));
-    if (value != NULL) {
-      *group_num = atoi(value);
-      scr_free(&value);
-    }
-
-    /* get the rank in the xor set */
-    value = strndup(name + pmatch[4].rm_so, (size_t)(pmatch[4].rm_eo - pmatch[4].rm_so));
-    if (value != NULL) {
-      *group_rank = atoi(value);
-      scr_free(&value);
-    }
-
-    /* get the size of the xor set */
-    value = strndup(name + pmatch[5].rm_so, (size_t)(pmatch[5].rm_eo - pmatch[5].rm_so));
-    if (value != NULL) {
-      *group_size = atoi(value);
-      scr_free(&value);
+  scr_scan_worker_t* w = (scr_scan_worker_t*) arg;
+  scr_scan_pool* pool = w->pool;
+  double last = pool->start;
+  while (1) {
+    pthread_mutex_lock(&pool->mutex);
+    int i = pool->next;
+    pool->next++;
+    int stop = (pool->rc != SCR_SUCCESS);
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (i >= pool->count || stop) {
+      break;
+    }
+
+    spath* filemap_path = spath_dup(pool->dir);
+    spath_append_str(filemap_path, pool->names[i]);
+    int tmp_rc = scr_scan_filemap(pool->prefix, filemap_path, pool->dset_id, pool->ranks_of[i], &w->ranks, w->scan);
+    spath_delete(&filemap_path);
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->done++;
+    if (tmp_rc != SCR_SUCCESS) {
+      pool->rc = tmp_rc;
+    }
+    int done = pool->done;
+    pthread_mutex_unlock(&pool->mutex);
+
+    /* let whoever runs us know we are still making progress */
+    if (w->report && scr_scan_progress > 0) {
+      double now = (double) time(NULL);
+      if (now - last >= (double) scr_scan_progress) {
+        printf("scr_index: Read %d of %d filemaps of dataset %d in %d secs\n",
+          done, pool->count, pool->dset_id, (int) (now - pool->start)
+        );
+        fflush(stdout);
+        last = now;
+      }
     }
   }
-
-  return rc;
+  return NULL;
 }
 
 /* Reads fmap files from given dataset directory and adds them to scan hash.
@@ -1485,174 +1970,140 @@ int scr_scan_files(const spath* prefix, const spath* dir, int dset_id, kvtree* s
   /* get dataset info from flush file */
   scr_scan_flush(prefix, dset_id, scan);
 
-  /* create path to scr subdirectory */
-  spath* meta_path = spath_dup(dir);
-
-  /* allocate directory in string form */
-  char* dir_str = spath_strdup(meta_path);
-
-  /* regex to identify filemap files and extract rank from filename */
-  regex_t re_filemap_file;
-  regcomp(&re_filemap_file, "filemap_([0-9]+)", REG_EXTENDED);
-
-  /* set up a regular expression so we can extract the partner set information from a file */
-  regex_t re_partner_file;
-  regcomp(&re_partner_file, "reddesc.er.([0-9]+).partner.grp_([0-9]+)_of_([0-9]+).mem_([0-9]+)_of_([0-9]+).redset", REG_EXTENDED);
-
-  /* set up a regular expression so we can extract the partner set information for filemaps */
-  regex_t re_mappartner_file;
-  regcomp(&re_mappartner_file, "reddescmap.er.([0-9]+).partner.grp_([0-9]+)_of_([0-9]+).mem_([0-9]+)_of_([0-9]+).redset", REG_EXTENDED);
-
-  /* set up a regular expression so we can extract the xor set information from a file */
-  regex_t re_xor_file;
-  regcomp(&re_xor_file, "reddesc.er.([0-9]+).xor.grp_([0-9]+)_of_([0-9]+).mem_([0-9]+)_of_([0-9]+).redset", REG_EXTENDED);
-
-  /* set up a regular expression so we can extract the xor set information for filemaps */
-  regex_t re_mapxor_file;
-  regcomp(&re_mapxor_file, "reddescmap.er.([0-9]+).xor.grp_([0-9]+)_of_([0-9]+).mem_([0-9]+)_of_([0-9]+).redset", REG_EXTENDED);
-
-  /* set up a regular expression so we can extract the rs set information from a file */
-  regex_t re_rs_file;
-  regcomp(&re_rs_file, "reddesc.er.([0-9]+).rs.grp_([0-9]+)_of_([0-9]+).mem_([0-9]+)_of_([0-9]+).redset", REG_EXTENDED);
-
-  /* set up a regular expression so we can extract the rs set information for filemaps */
-  regex_t re_maprs_file;
-  regcomp(&re_maprs_file, "reddescmap.er.([0-9]+).rs.grp_([0-9]+)_of_([0-9]+).mem_([0-9]+)_of_([0-9]+).redset", REG_EXTENDED);
-
-  /* function to track ranks value across a set of files to be scanned */
-  int ranks = -1;
+  /* list the directory up front */
+  char* dir_str = spath_strdup(dir);
+  char** names = NULL;
+  int count = 0;
+  if (scr_scan_list(dir_str, &names, &count) != SCR_SUCCESS) {
+    scr_free(&dir_str);
+    return SCR_FAILURE;
+  }
 
-  /* open the directory */
-  DIR* dirp = opendir(dir_str);
-  if (dirp == NULL) {
-    scr_err("Failed to open directory %s (errno=%d %s) @ %s:%d",
-      dir_str, errno, strerror(errno), __FILE__, __LINE__
-    );
-    rc = SCR_FAILURE;
-    goto cleanup;
+  /* record redundancy files as we go, and set filemaps aside to read */
+  int nmaps = 0;
+  char** maps = (char**) SCR_MALLOC((count + 1) * sizeof(char*));
+  int* map_ranks = (int*) SCR_MALLOC((count + 1) * sizeof(int));
+  int i;
+  for (i = 0; i < count; i++) {
+    scr_scan_match_t m;
+    if (! scr_scan_match(names[i], &m)) {
+      continue;
+    }
+    if (m.kind == SCR_SCAN_FILE_FILEMAP) {
+      maps[nmaps] = names[i];
+      map_ranks[nmaps] = m.rank;
+      nmaps++;
+    } else if (rc == SCR_SUCCESS) {
+      rc = scr_scan_redset(names[i], dset_id, m.key, m.rank,
+        m.group_id, m.group_num, m.group_rank, m.group_size, scan
+      );
+    }
   }
 
-  /* read each file from the directory */
-  struct dirent* dp = NULL;
-  int rank, group_id, group_num, group_rank, group_size;
-  do {
-    errno = 0;
-    dp = readdir(dirp);
-    if (dp != NULL) {
-      const char* name = NULL;
+  /* read filemaps with a pool of workers, each into a scan hash of its own,
+   * this thread serves as one of the workers and reports progress */
+  if (rc == SCR_SUCCESS && nmaps > 0) {
+    scr_scan_pool pool;
+    pool.prefix   = prefix;
+    pool.dir      = dir;
+    pool.dset_id  = dset_id;
+    pool.names    = maps;
+    pool.ranks_of = map_ranks;
+    pool.count    = nmaps;
+    pool.next     = 0;
+    pool.done     = 0;
+    pool.rc       = SCR_SUCCESS;
+    pool.start    = (double) time(NULL);
+    pthread_mutex_init(&pool.mutex, NULL);
+
+    int workers = scr_scan_threads;
+    if (workers > nmaps) {
+      workers = nmaps;
+    }
+    if (workers < 1) {
+      workers = 1;
+    }
+
+    scr_scan_worker_t* w = (scr_scan_worker_t*) SCR_MALLOC(workers * sizeof(scr_scan_worker_t));
+    pthread_t* threads = (pthread_t*) SCR_MALLOC(workers * sizeof(pthread_t));
+    for (i = 0; i < workers; i++) {
+      w[i].pool   = &pool;
+      w[i].scan   = kvtree_new();
+      w[i].ranks  = -1;
+      w[i].report = (i == 0);
+    }
+
+    int nthreads = 1;
+    while (nthreads < workers &&
+           pthread_create(&threads[nthreads], NULL, scr_scan_worker, &w[nthreads]) == 0)
+    {
+      nthreads++;
+    }
+    scr_scan_worker(&w[0]);
+    for (i = 1; i < nthreads; i++) {
+      pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&pool.mutex);
+    rc = pool.rc;
 
-      #ifdef _DIRENT_HAVE_D_TYPE
-        /* distinguish between directories and files if we can */
-        if (dp->d_type != DT_DIR) {
-          name = dp->d_name;
+    if (scr_scan_progress > 0) {
+      printf("scr_index: Read %d filemaps of dataset %d in %d secs\n",
+        pool.done, dset_id, (int) ((double) time(NULL) - pool.start)
+      );
+      fflush(stdout);
+    }
+
+    /* each worker checked that its files agree on the number of ranks,
+     * if workers disagree, read the filemaps again in order so the same
+     * files are dropped as when reading them one at a time */
+    int agree = 1;
+    int ranks = -1;
+    for (i = 0; i < nthreads; i++) {
+      if (w[i].ranks != -1) {
+        if (ranks == -1) {
+          ranks = w[i].ranks;
+        } else if (w[i].ranks != ranks) {
+          agree = 0;
         }
-      #else
-        /* TODO: throw a compile error here instead? */
-        name = dp->d_name;
-      #endif
-
-      /* we only process fmap files */
-      if (name != NULL) {
-        if (match_filemap(name, &re_filemap_file, &rank)) {
-          /* create a full path of the file name */
-          spath* filemap_path = spath_dup(meta_path);
-          spath_append_str(filemap_path, name);
-
-          /* read file contents into our scan hash */
-          int tmp_rc = scr_scan_filemap(prefix, filemap_path, dset_id, rank, &ranks, scan);
-          if (tmp_rc != SCR_SUCCESS) {
-            rc = tmp_rc;
-            spath_delete(&filemap_path);
-            break;
-          }
+      }
+    }
 
-          /* delete the path */
-          spath_delete(&filemap_path);
-        } else if (match_partner(name, &re_partner_file, &rank, &group_id, &group_num, &group_rank, &group_size)) {
-          /* add info for XOR file to our scan hash */
-          const char* keyname = SCR_SCAN_KEY_PARTNER;
-          int tmp_rc = scr_scan_redset(name, dset_id, keyname, rank, group_id, group_num, group_rank, group_size, scan);
-          if (tmp_rc != SCR_SUCCESS) {
-            rc = tmp_rc;
-            break;
-          }
-        } else if (match_partner(name, &re_mappartner_file, &rank, &group_id, &group_num, &group_rank, &group_size)) {
-          /* add info for XOR file to our scan hash */
-          const char* keyname = SCR_SCAN_KEY_MAPPARTNER;
-          int tmp_rc = scr_scan_redset(name, dset_id, keyname, rank, group_id, group_num, group_rank, group_size, scan);
-          if (tmp_rc != SCR_SUCCESS) {
-            rc = tmp_rc;
-            break;
-          }
-        } else if (match_xor(name, &re_xor_file, &rank, &group_id, &group_num, &group_rank, &group_size)) {
-          /* add info for XOR file to our scan hash */
-          const char* keyname = SCR_SCAN_KEY_XOR;
-          int tmp_rc = scr_scan_redset(name, dset_id, keyname, rank, group_id, group_num, group_rank, group_size, scan);
-          if (tmp_rc != SCR_SUCCESS) {
-            rc = tmp_rc;
-            break;
-          }
-        } else if (match_xor(name, &re_mapxor_file, &rank, &group_id, &group_num, &group_rank, &group_size)) {
-          /* add info for XOR file to our scan hash */
-          const char* keyname = SCR_SCAN_KEY_MAPXOR;
-          int tmp_rc = scr_scan_redset(name, dset_id, keyname, rank, group_id, group_num, group_rank, group_size, scan);
-          if (tmp_rc != SCR_SUCCESS) {
-            rc = tmp_rc;
-            break;
-          }
-        } else if (match_rs(name, &re_rs_file, &rank, &group_id, &group_num, &group_rank, &group_size)) {
-          /* add info for RS file to our scan hash */
-          const char* keyname = SCR_SCAN_KEY_RS;
-          int tmp_rc = scr_scan_redset(name, dset_id, keyname, rank, group_id, group_num, group_rank, group_size, scan);
-          if (tmp_rc != SCR_SUCCESS) {
-            rc = tmp_rc;
-            break;
-          }
-        } else if (match_rs(name, &re_maprs_file, &rank, &group_id, &group_num, &group_rank, &group_size)) {
-          /* add info for RS file to our scan hash */
-          const char* keyname = SCR_SCAN_KEY_MAPRS;
-          int tmp_rc = scr_scan_redset(name, dset_id, keyname, rank, group_id, group_num, group_rank, group_size, scan);
-          if (tmp_rc != SCR_SUCCESS) {
-            rc = tmp_rc;
-            break;
-          }
+    if (rc == SCR_SUCCESS && ! agree) {
+      ranks = -1;
+      for (i = 0; i < nmaps; i++) {
+        spath* filemap_path = spath_dup(dir);
+        spath_append_str(filemap_path, maps[i]);
+        int tmp_rc = scr_scan_filemap(prefix, filemap_path, dset_id, map_ranks[i], &ranks, scan);
+        spath_delete(&filemap_path);
+        if (tmp_rc != SCR_SUCCESS) {
+          rc = tmp_rc;
+          break;
         }
       }
-    } else {
-      if (errno != 0) {
-        scr_err("Failed to read directory %s (errno=%d %s) @ %s:%d",
-          dir_str, errno, strerror(errno), __FILE__, __LINE__
-        );
-        rc = SCR_FAILURE;
-        break;
+    } else if (rc == SCR_SUCCESS) {
+      for (i = 0; i < nthreads; i++) {
+        kvtree_merge(scan, w[i].scan);
       }
     }
-  } while (dp != NULL);
 
-  /* close the directory */
-  if (closedir(dirp) < 0) {
-    scr_err("Failed to close directory %s (errno=%d %s) @ %s:%d",
-      dir_str, errno, strerror(errno), __FILE__, __LINE__
-    );
-    rc = SCR_FAILURE;
+    for (i = 0; i < workers; i++) {
+      kvtree_delete(&w[i].scan);
+    }
+    scr_free(&threads);
+    scr_free(&w);
   }
 
-cleanup:
-  /* free the xor regular expression */
-  regfree(&re_filemap_file);
-  regfree(&re_partner_file);
-  regfree(&re_mappartner_file);
-  regfree(&re_xor_file);
-  regfree(&re_mapxor_file);
-  regfree(&re_rs_file);
-  regfree(&re_maprs_file);
+  /* free the lists */
+  for (i = 0; i < count; i++) {
+    scr_free(&names[i]);
+  }
+  scr_free(&names);
+  scr_free(&maps);
+  scr_free(&map_ranks);
 
   /* free our directory string */
   scr_free(&dir_str);
 
-  /* delete scr path */
-  spath_delete(&meta_path);
-
   return rc;
 }
 
@@ -2253,6 +2704,64 @@ int index_add(const spath* prefix, const char* name)
   return rc;
 }
 
+/* rewrite rank2file map of dataset id in the binary format,
+ * leaves the kvtree files in place for older tools */
+int index_convert(const spath* prefix, int id)
+{
+  int rc = SCR_SUCCESS;
+
+  /* build path to rank2file map of dataset */
+  spath* dataset_path = spath_dup(prefix);
+  spath_append_str(dataset_path, ".scr");
+  spath_append_strf(dataset_path, "scr.dataset.%d", id);
+  spath* rank2file_path = spath_dup(dataset_path);
+  spath_append_str(rank2file_path, "rank2file");
+  char* rank2file = spath_strdup(rank2file_path);
+  spath_delete(&rank2file_path);
+
+  /* nothing to do if the dataset already has a binary map */
+  int ranks, shard_ranks;
+  if (scr_rank2file_read_header(rank2file, &ranks, &shard_ranks) == SCR_SUCCESS) {
+    printf("Dataset %d already has a binary rank2file map\n", id);
+    scr_free(&rank2file);
+    spath_delete(&dataset_path);
+    return SCR_SUCCESS;
+  }
+
+  /* read all entries from the kvtree map */
+  kvtree* hash = kvtree_new();
+  if (scr_rank2file_read_levels(rank2file, hash) != SCR_SUCCESS) {
+    scr_err("Failed to read rank2file map for dataset %d: `%s'", id, rank2file);
+    rc = SCR_FAILURE;
+  }
+
+  /* take the number of ranks from the summary file if we can,
+   * since ranks without files may have no entry */
+  if (rc == SCR_SUCCESS) {
+    kvtree* summary = kvtree_new();
+    if (scr_summary_read(dataset_path, summary) == SCR_SUCCESS) {
+      kvtree* summary_rank2file = kvtree_get(summary, SCR_SUMMARY_6_KEY_RANK2FILE);
+      if (kvtree_util_get_int(summary_rank2file, SCR_SUMMARY_6_KEY_RANKS, &ranks) == KVTREE_SUCCESS) {
+        kvtree_util_set_int(hash, SCR_SUMMARY_6_KEY_RANKS, ranks);
+      }
+    }
+    kvtree_delete(&summary);
+
+    ranks = scr_rank2file_ranks(hash);
+    int shard = (SCR_RANK2FILE_SHARD > 0) ? SCR_RANK2FILE_SHARD : 8192;
+    rc = scr_rank2file_write_ranks(rank2file, hash, ranks, shard);
+    if (rc == SCR_SUCCESS) {
+      printf("Converted rank2file map of dataset %d with %d ranks\n", id, ranks);
+    }
+  }
+  kvtree_delete(&hash);
+
+  scr_free(&rank2file);
+  spath_delete(&dataset_path);
+
+  return rc;
+}
+
 int print_usage()
 {
   printf("\n");
@@ -2265,7 +2774,12 @@ int print_usage()
   printf("        --drop=<name>       Drop dataset <name> from index (does not delete files)\n");
   printf("        --drop-after=<name> Drop all datasets after <name> from index (does not delete files)\n");
   printf("    -c, --current=<name>    Set <name> as current restart dataset\n");
+  printf("        --convert=<id>      Rewrite rank2file map of dataset <id> in binary format\n");
   printf("    -p, --prefix=<dir>      Specify prefix directory (defaults to current working directory)\n");
+  printf("    -j, --jobs=<n>          Rebuild at most <n> redundancy sets at once (default %d)\n", SCR_REBUILD_JOBS);
+  printf("        --exec              Run scr_rebuild_* commands rather than rebuilding in this process\n");
+  printf("    -t, --threads=<n>       Read at most <n> filemaps at once while building (default %d)\n", SCR_SCAN_THREADS);
+  printf("        --progress=<secs>   Report progress every <secs> seconds while building (default 0 for none)\n");
   printf("    -h, --help              Print usage\n");
   printf("\n");
   return SCR_SUCCESS;
@@ -2281,6 +2795,11 @@ struct arglist {
   int drop;
   int drop_after;
   int current;
+  int convert;
+  int jobs;
+  int exec;
+  int threads;
+  int progress;
 };
 
 /* free any memory allocation during get_args */
@@ -2303,8 +2822,13 @@ int get_args(int argc, char **argv, struct arglist* args)
   args->drop       = 0;
   args->drop_after = 0;
   args->current    = 0;
+  args->convert    = 0;
+  args->jobs       = SCR_REBUILD_JOBS;
+  args->exec       = 0;
+  args->threads    = SCR_SCAN_THREADS;
+  args->progress   = 0;
 
-  static const char *opt_string = "lb:a:d:p:h";
+  static const char *opt_string = "lb:a:d:p:j:t:h";
   static struct option long_options[] = {
     {"list",       no_argument,       NULL, 'l'},
     {"build",      required_argument, NULL, 'b'},
@@ -2312,7 +2836,12 @@ int get_args(int argc, char **argv, struct arglist* args)
     {"drop",       required_argument, NULL, 'd'},
     {"drop-after", required_argument, NULL, 'z'},
     {"current",    required_argument, NULL, 'c'},
+    {"convert",    required_argument, NULL, 'v'},
     {"prefix",     required_argument, NULL, 'p'},
+    {"jobs",       required_argument, NULL, 'j'},
+    {"exec",       no_argument,       NULL, 'e'},
+    {"threads",    required_argument, NULL, 't'},
+    {"progress",   required_argument, NULL, 'r'},
     {"help",       no_argument,       NULL, 'h'},
     {NULL,         no_argument,       NULL,   0}
   };
@@ -2349,9 +2878,35 @@ int get_args(int argc, char **argv, struct arglist* args)
         args->current = 1;
         args->list    = 0;
         break;
+      case 'v':
+        args->id      = atoi(optarg);
+        args->convert = 1;
+        args->list    = 0;
+        break;
       case 'p':
         args->prefix = spath_from_str(optarg);
         break;
+      case 'j':
+        args->jobs = atoi(optarg);
+        if (args->jobs < 1) {
+          return SCR_FAILURE;
+        }
+        break;
+      case 'e':
+        args->exec = 1;
+        break;
+      case 't':
+        args->threads = atoi(optarg);
+        if (args->threads < 1) {
+          return SCR_FAILURE;
+        }
+        break;
+      case 'r':
+        args->progress = atoi(optarg);
+        if (args->progress < 0) {
+          return SCR_FAILURE;
+        }
+        break;
       case 'h':
         return SCR_FAILURE;
       default:
@@ -2392,13 +2947,19 @@ int main(int argc, char *argv[])
     return 1;
   }
 
+  /* set how we run rebuilds */
+  scr_rebuild_jobs = args.jobs;
+  scr_scan_threads = args.threads;
+  scr_scan_progress = args.progress;
+  scr_rebuild_exec = args.exec;
+
   /* get references to prefix and subdirectory paths */
   spath* prefix = args.prefix;
   char* name = args.name;
   int id = args.id;
 
   /* these options all require a prefix directory */
-  if (args.build == 1 || args.add == 1 || args.drop == 1 || args.drop_after == 1 || args.current == 1 || args.list == 1) {
+  if (args.build == 1 || args.add == 1 || args.drop == 1 || args.drop_after == 1 || args.current == 1 || args.convert == 1 || args.list == 1) {
     if (spath_is_null(prefix)) {
       print_usage();
       return 1;
@@ -2436,6 +2997,9 @@ int main(int argc, char *argv[])
   } else if (args.current == 1) {
     /* set named dataset as current restart */
     rc = index_current(prefix, name);
+  } else if (args.convert == 1) {
+    /* rewrite rank2file map of dataset in binary format */
+    rc = index_convert(prefix, id);
   } else if (args.list == 1) {
     /* list datasets recorded in index file */
     rc = index_list(prefix);
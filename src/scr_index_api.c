@@ -31,6 +31,7 @@
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#include <stdint.h>
 
 /* strdup */
 #include <string.h>
@@ -43,6 +44,7 @@
 #include <libgen.h>
 
 #define SCR_INDEX_FILENAME "index.scr"
+#define SCR_INDEX_IDS_FILENAME "index.ids"
 
 /* Example contents of an index file:
  * This contains:
@@ -182,7 +184,10 @@ int scr_index_read(const spath* dir, kvtree* index)
   return rc;
 }
 
-/* overwrite the contents of the index file in given directory with given hash */
+static int scr_index_summary_write(const spath* dir, const kvtree* index);
+
+/* overwrite the contents of the index file in given directory with given hash,
+ * and bring the index summary next to it up to date */
 int scr_index_write(const spath* dir, kvtree* index)
 {
   /* build the file name for the index file */
@@ -203,6 +208,12 @@ int scr_index_write(const spath* dir, kvtree* index)
   /* free path */
   spath_delete(&path_index);
 
+  /* the summary is rebuilt from the index file when it is out of date,
+   * so failing to write it is not an error */
+  if (rc == SCR_SUCCESS) {
+    scr_index_summary_write(dir, index);
+  }
+
   return rc;
 }
 
@@ -216,41 +227,28 @@ int scr_index_get_max_ids(const spath* dir, int* dset_id, int* ckpt_id, int* ckp
   *ckpt_id      = 0;
   *ckpt_dset_id = 0;
 
-  kvtree* index = kvtree_new();
-  if (scr_index_read(dir, index) == SCR_SUCCESS) {
-    /* search for the checkpoint with the maximum dataset id which is
-     * complete and less than earlier_than if earlier_than is set */
-    kvtree* dsets = kvtree_get(index, SCR_INDEX_1_KEY_DATASET);
-    kvtree_elem* dset = NULL;
-    for (dset = kvtree_elem_first(dsets);
-         dset != NULL;
-         dset = kvtree_elem_next(dset))
-    {
-      /* get the id for this dataset */
-      char* key = kvtree_elem_key(dset);
-      int current_id = atoi(key);
-      if (current_id > *dset_id) {
-        *dset_id = current_id;
-      }
+  /* the summary holds the ids without parsing the whole index */
+  scr_index_summary* summary = scr_index_summary_new();
+  if (scr_index_summary_read(dir, summary) == SCR_SUCCESS) {
+    /* entries are sorted, so the last one has the max dataset id */
+    if (summary->count > 0 && summary->entries[summary->count - 1].id > 0) {
+      *dset_id = summary->entries[summary->count - 1].id;
+    }
 
-      /* check that dataset is really a checkpoint */
-      kvtree* dset_hash = kvtree_elem_hash(dset);
-      kvtree* dataset = kvtree_get(dset_hash, SCR_INDEX_1_KEY_DATASET);
-      if (scr_dataset_is_ckpt(dataset)) {
-        int current_ckpt_id;
-        if (scr_dataset_get_ckpt(dataset, &current_ckpt_id) == SCR_SUCCESS) {
-          if (current_ckpt_id > *ckpt_id) {
-            *ckpt_id      = current_ckpt_id;
-            *ckpt_dset_id = current_id;
-          }
-        }
+    /* search for the checkpoint with the maximum checkpoint id */
+    int i;
+    for (i = 0; i < summary->count; i++) {
+      const scr_index_entry* e = &summary->entries[i];
+      if ((e->flags & SCR_INDEX_FLAG_CKPT) && e->ckpt > *ckpt_id) {
+        *ckpt_id      = e->ckpt;
+        *ckpt_dset_id = e->id;
       }
     }
 
     rc = SCR_SUCCESS;
   }
 
-  kvtree_delete(&index);
+  scr_index_summary_delete(&summary);
 
   return rc;
 }
@@ -595,6 +593,29 @@ int scr_index_get_most_recent_complete(const kvtree* index, int earlier_than, in
   return SCR_FAILURE;
 }
 
+/* returns 1 if any dataset in the index was flushed as a delta
+ * against the given dataset id, 0 otherwise */
+int scr_index_is_base(const kvtree* index, int id)
+{
+  kvtree* dsets = kvtree_get(index, SCR_INDEX_1_KEY_DATASET);
+  kvtree_elem* dset = NULL;
+  for (dset = kvtree_elem_first(dsets);
+       dset != NULL;
+       dset = kvtree_elem_next(dset))
+  {
+    /* get base id recorded for this dataset, if any */
+    kvtree* dset_hash = kvtree_elem_hash(dset);
+    kvtree* dataset_hash = kvtree_get(dset_hash, SCR_INDEX_1_KEY_DATASET);
+    int base_id;
+    if (scr_dataset_get_base(dataset_hash, &base_id) == SCR_SUCCESS &&
+        base_id == id)
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
 /* lookup the dataset having the lowest id, return its id and name,
  * sets id to -1 to indicate no dataset is left */
 int scr_index_get_oldest(const kvtree* index, int* id, char* name)
@@ -690,3 +711,619 @@ int scr_index_remove_later(kvtree* index, int target_id)
 
   return rc;
 }
+
+/*
+=========================================
+Index summary
+=========================================
+*/
+
+/* The index summary file holds a fixed-size header followed by records.
+ * Each record describes one dataset and is followed by the bytes of its
+ * name.  A later record for the same id replaces an earlier one, so
+ * changes to the index are appended, and the whole file is only written
+ * out again when it holds many more records than datasets. */
+
+/* leading bytes of an index summary file, and its format version */
+#define SCR_INDEX_IDS_MAGIC   (0x53434931)
+#define SCR_INDEX_IDS_VERSION (1)
+
+/* flag on a record that drops a dataset recorded earlier in the file */
+#define SCR_INDEX_IDS_REMOVED (0x100)
+
+/* header of an index summary file, records the size and mtime of the
+ * index file the summary was last brought up to date with */
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t index_size;
+  int64_t  index_mtime;
+  uint32_t records;
+  uint32_t reserved;
+} scr_index_ids_header;
+
+/* one record in an index summary file */
+typedef struct {
+  int32_t  id;
+  int32_t  ckpt;
+  int32_t  base;
+  uint32_t flags;
+  uint32_t namelen;
+} scr_index_ids_record;
+
+/* returns newly allocated name of file in hidden .scr directory of dir */
+static char* scr_index_file(const spath* dir, const char* name)
+{
+  spath* path = spath_dup(dir);
+  spath_append_str(path, ".scr");
+  spath_append_str(path, name);
+  char* file = spath_strdup(path);
+  spath_delete(&path);
+  return file;
+}
+
+/* allocate an empty index summary */
+scr_index_summary* scr_index_summary_new(void)
+{
+  scr_index_summary* summary = (scr_index_summary*) SCR_MALLOC(sizeof(scr_index_summary));
+  summary->count   = 0;
+  summary->entries = NULL;
+  return summary;
+}
+
+/* drop all entries from summary */
+static void scr_index_summary_clear(scr_index_summary* summary)
+{
+  int i;
+  for (i = 0; i < summary->count; i++) {
+    scr_free(&summary->entries[i].name);
+  }
+  scr_free(&summary->entries);
+  summary->count = 0;
+}
+
+/* free an index summary and set caller's pointer to NULL */
+int scr_index_summary_delete(scr_index_summary** ptr_summary)
+{
+  if (ptr_summary != NULL && *ptr_summary != NULL) {
+    scr_index_summary_clear(*ptr_summary);
+    scr_free(ptr_summary);
+  }
+  return SCR_SUCCESS;
+}
+
+/* sort entries by id */
+static int scr_index_entry_cmp(const void* a, const void* b)
+{
+  int id_a = ((const scr_index_entry*) a)->id;
+  int id_b = ((const scr_index_entry*) b)->id;
+  if (id_a < id_b) {
+    return -1;
+  } else if (id_a > id_b) {
+    return 1;
+  }
+  return 0;
+}
+
+/* return position of entry with given id, or the position where it
+ * would be inserted and sets found to 0 if there is none */
+static int scr_index_summary_find(const scr_index_summary* summary, int id, int* found)
+{
+  int low  = 0;
+  int high = summary->count;
+  while (low < high) {
+    int mid = low + (high - low) / 2;
+    if (summary->entries[mid].id < id) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  *found = (low < summary->count && summary->entries[low].id == id);
+  return low;
+}
+
+/* replace contents of summary with one entry for each dataset in index */
+int scr_index_summary_from_kvtree(scr_index_summary* summary, const kvtree* index)
+{
+  scr_index_summary_clear(summary);
+
+  kvtree* dsets = kvtree_get(index, SCR_INDEX_1_KEY_DATASET);
+  int size = kvtree_size(dsets);
+  if (size == 0) {
+    return SCR_SUCCESS;
+  }
+  summary->entries = (scr_index_entry*) SCR_MALLOC(size * sizeof(scr_index_entry));
+
+  kvtree_elem* dset = NULL;
+  for (dset = kvtree_elem_first(dsets);
+       dset != NULL;
+       dset = kvtree_elem_next(dset))
+  {
+    char* key = kvtree_elem_key(dset);
+    if (key == NULL) {
+      continue;
+    }
+
+    scr_index_entry* e = &summary->entries[summary->count];
+    e->id    = atoi(key);
+    e->ckpt  = 0;
+    e->base  = -1;
+    e->flags = 0;
+    e->name  = NULL;
+
+    /* a missing COMPLETE marker counts as incomplete */
+    kvtree* dset_hash = kvtree_elem_hash(dset);
+    int complete;
+    if (kvtree_util_get_int(dset_hash, SCR_INDEX_1_KEY_COMPLETE, &complete) == KVTREE_SUCCESS &&
+        complete == 1)
+    {
+      e->flags |= SCR_INDEX_FLAG_COMPLETE;
+    }
+    if (kvtree_get(dset_hash, SCR_INDEX_1_KEY_FAILED) != NULL) {
+      e->flags |= SCR_INDEX_FLAG_FAILED;
+    }
+
+    kvtree* dataset_hash = kvtree_get(dset_hash, SCR_INDEX_1_KEY_DATASET);
+    if (scr_dataset_is_ckpt(dataset_hash)) {
+      e->flags |= SCR_INDEX_FLAG_CKPT;
+      scr_dataset_get_ckpt(dataset_hash, &e->ckpt);
+    }
+    if (scr_dataset_is_output(dataset_hash)) {
+      e->flags |= SCR_INDEX_FLAG_OUTPUT;
+    }
+    scr_dataset_get_base(dataset_hash, &e->base);
+
+    char* name = NULL;
+    scr_dataset_get_name(dataset_hash, &name);
+    e->name = strdup((name != NULL) ? name : "");
+
+    summary->count++;
+  }
+
+  qsort(summary->entries, summary->count, sizeof(scr_index_entry), scr_index_entry_cmp);
+
+  return SCR_SUCCESS;
+}
+
+/* merge entries of summary into index as dataset records holding
+ * the name, ids, completeness, and flags of each dataset */
+int scr_index_summary_to_kvtree(const scr_index_summary* summary, kvtree* index)
+{
+  int i;
+  for (i = 0; i < summary->count; i++) {
+    const scr_index_entry* e = &summary->entries[i];
+
+    scr_dataset* dataset = scr_dataset_new();
+    scr_dataset_set_id(dataset, e->id);
+    scr_dataset_set_name(dataset, e->name);
+    int flags = 0;
+    if (e->flags & SCR_INDEX_FLAG_CKPT) {
+      flags |= SCR_FLAG_CHECKPOINT;
+    }
+    if (e->flags & SCR_INDEX_FLAG_OUTPUT) {
+      flags |= SCR_FLAG_OUTPUT;
+    }
+    scr_dataset_set_flags(dataset, flags);
+    if (e->flags & SCR_INDEX_FLAG_CKPT) {
+      scr_dataset_set_ckpt(dataset, e->ckpt);
+    }
+    if (e->base >= 0) {
+      scr_dataset_set_base(dataset, e->base);
+    }
+
+    int complete = (e->flags & SCR_INDEX_FLAG_COMPLETE) ? 1 : 0;
+    scr_index_set_dataset(index, e->id, e->name, dataset, complete);
+    scr_dataset_delete(&dataset);
+
+    /* the summary does not keep when a fetch failed, only that one did */
+    if (e->flags & SCR_INDEX_FLAG_FAILED) {
+      kvtree* dset_hash = kvtree_get_kv_int(index, SCR_INDEX_1_KEY_DATASET, e->id);
+      if (kvtree_get(dset_hash, SCR_INDEX_1_KEY_FAILED) == NULL) {
+        kvtree_util_set_str(dset_hash, SCR_INDEX_1_KEY_FAILED, "UNKNOWN");
+      }
+    }
+  }
+  return SCR_SUCCESS;
+}
+
+/* returns 1 if both entries record the same dataset the same way */
+static int scr_index_entry_same(const scr_index_entry* a, const scr_index_entry* b)
+{
+  return (a->id == b->id && a->ckpt == b->ckpt && a->base == b->base &&
+          a->flags == b->flags && strcmp(a->name, b->name) == 0);
+}
+
+/* append record for entry e with given extra flags to buffer */
+static void scr_index_ids_pack(char** buf, size_t* len, size_t* cap, const scr_index_entry* e, uint32_t extra)
+{
+  scr_index_ids_record rec;
+  rec.id      = (int32_t) e->id;
+  rec.ckpt    = (int32_t) e->ckpt;
+  rec.base    = (int32_t) e->base;
+  rec.flags   = (uint32_t) e->flags | extra;
+  rec.namelen = (uint32_t) strlen(e->name);
+
+  size_t need = *len + sizeof(rec) + rec.namelen;
+  if (need > *cap) {
+    size_t newcap = (*cap > 0) ? *cap : 4096;
+    while (newcap < need) {
+      newcap *= 2;
+    }
+    char* newbuf = (char*) SCR_MALLOC(newcap);
+    if (*len > 0) {
+      memcpy(newbuf, *buf, *len);
+    }
+    scr_free(buf);
+    *buf = newbuf;
+    *cap = newcap;
+  }
+
+  memcpy(*buf + *len, &rec, sizeof(rec));
+  memcpy(*buf + *len + sizeof(rec), e->name, rec.namelen);
+  *len = need;
+}
+
+/* read the records of the summary file into summary, applying later
+ * records over earlier ones, and sets header to the header of the file */
+static int scr_index_ids_load(const char* file, scr_index_summary* summary, scr_index_ids_header* header)
+{
+  scr_index_summary_clear(summary);
+
+  int fd = scr_open(file, O_RDONLY);
+  if (fd < 0) {
+    return SCR_FAILURE;
+  }
+
+  int rc = SCR_FAILURE;
+  struct stat statbuf;
+  char* buf = NULL;
+  size_t size = 0;
+  if (fstat(fd, &statbuf) == 0 && (size_t) statbuf.st_size >= sizeof(*header)) {
+    size = (size_t) statbuf.st_size;
+    buf = (char*) SCR_MALLOC(size);
+    if (scr_read(file, fd, buf, size) == (ssize_t) size) {
+      memcpy(header, buf, sizeof(*header));
+      if (header->magic == SCR_INDEX_IDS_MAGIC && header->version == SCR_INDEX_IDS_VERSION) {
+        rc = SCR_SUCCESS;
+      }
+    }
+  }
+  scr_close(file, fd);
+
+  if (rc != SCR_SUCCESS) {
+    scr_free(&buf);
+    return SCR_FAILURE;
+  }
+
+  /* walk the records, growing a list that we sort and reduce after */
+  int cap = 0;
+  int records = 0;
+  size_t offset = sizeof(*header);
+  while (offset + sizeof(scr_index_ids_record) <= size) {
+    scr_index_ids_record rec;
+    memcpy(&rec, buf + offset, sizeof(rec));
+    offset += sizeof(rec);
+    if (offset + rec.namelen > size) {
+      /* torn record at the end, drop it */
+      break;
+    }
+
+    if (summary->count == cap) {
+      cap = (cap > 0) ? cap * 2 : 64;
+      scr_index_entry* entries = (scr_index_entry*) SCR_MALLOC(cap * sizeof(scr_index_entry));
+      if (summary->count > 0) {
+        memcpy(entries, summary->entries, summary->count * sizeof(scr_index_entry));
+      }
+      scr_free(&summary->entries);
+      summary->entries = entries;
+    }
+
+    scr_index_entry* e = &summary->entries[summary->count];
+    e->id    = (int) rec.id;
+    e->ckpt  = (int) rec.ckpt;
+    e->base  = (int) rec.base;
+    e->flags = (int) rec.flags;
+    e->name  = (char*) SCR_MALLOC(rec.namelen + 1);
+    memcpy(e->name, buf + offset, rec.namelen);
+    e->name[rec.namelen] = '\0';
+    offset += rec.namelen;
+
+    summary->count++;
+    records++;
+  }
+  scr_free(&buf);
+  header->records = (uint32_t) records;
+
+  /* records are written in nearly sorted order, so an insertion sort
+   * is cheap, and being stable it keeps later records for an id after
+   * earlier ones */
+  int i;
+  for (i = 1; i < summary->count; i++) {
+    scr_index_entry e = summary->entries[i];
+    int j = i - 1;
+    while (j >= 0 && summary->entries[j].id > e.id) {
+      summary->entries[j + 1] = summary->entries[j];
+      j--;
+    }
+    summary->entries[j + 1] = e;
+  }
+
+  /* keep the last record for each id, unless it removes the dataset */
+  int count = 0;
+  for (i = 0; i < summary->count; i++) {
+    scr_index_entry* e = &summary->entries[i];
+    int last = (i + 1 == summary->count || summary->entries[i + 1].id != e->id);
+    if (last && ! (e->flags & SCR_INDEX_IDS_REMOVED)) {
+      summary->entries[count++] = *e;
+    } else {
+      scr_free(&e->name);
+    }
+  }
+  summary->count = count;
+
+  return SCR_SUCCESS;
+}
+
+/* stat the index file to record which version of it a summary reflects */
+static void scr_index_ids_stamp(const spath* dir, scr_index_ids_header* header)
+{
+  header->index_size  = 0;
+  header->index_mtime = 0;
+
+  char* index_file = scr_index_file(dir, SCR_INDEX_FILENAME);
+  struct stat statbuf;
+  if (stat(index_file, &statbuf) == 0) {
+    header->index_size  = (uint64_t) statbuf.st_size;
+    header->index_mtime = (int64_t) statbuf.st_mtime;
+  }
+  scr_free(&index_file);
+}
+
+/* write all entries of summary as a new summary file */
+static int scr_index_ids_rewrite(const spath* dir, const char* file, const scr_index_summary* summary)
+{
+  scr_index_ids_header header;
+  memset(&header, 0, sizeof(header));
+  header.magic   = SCR_INDEX_IDS_MAGIC;
+  header.version = SCR_INDEX_IDS_VERSION;
+  header.records = (uint32_t) summary->count;
+  scr_index_ids_stamp(dir, &header);
+
+  char* buf  = NULL;
+  size_t len = 0;
+  size_t cap = 0;
+  int i;
+  for (i = 0; i < summary->count; i++) {
+    scr_index_ids_pack(&buf, &len, &cap, &summary->entries[i], 0);
+  }
+
+  /* write to a temporary file and rename it over the old one,
+   * so readers see either the old summary or the new one */
+  char tmpfile[SCR_MAX_FILENAME];
+  snprintf(tmpfile, sizeof(tmpfile), "%s.tmp", file);
+
+  int rc = SCR_FAILURE;
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int fd = scr_open(tmpfile, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (fd >= 0) {
+    if (scr_write(tmpfile, fd, &header, sizeof(header)) == (ssize_t) sizeof(header) &&
+        scr_write(tmpfile, fd, buf, len) == (ssize_t) len)
+    {
+      rc = SCR_SUCCESS;
+    }
+    if (scr_close(tmpfile, fd) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+  }
+  scr_free(&buf);
+
+  if (rc == SCR_SUCCESS && rename(tmpfile, file) != 0) {
+    scr_err("Failed to rename %s to %s: errno=%d %s @ %s:%d",
+      tmpfile, file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+  if (rc != SCR_SUCCESS) {
+    unlink(tmpfile);
+  }
+
+  return rc;
+}
+
+/* bring the summary file in given directory up to date with index,
+ * appends records for datasets that changed, and writes the whole file
+ * again once it holds more than twice as many records as datasets */
+static int scr_index_summary_write(const spath* dir, const kvtree* index)
+{
+  char* file = scr_index_file(dir, SCR_INDEX_IDS_FILENAME);
+
+  scr_index_summary* summary = scr_index_summary_new();
+  scr_index_summary_from_kvtree(summary, index);
+
+  /* find records that differ from what the file holds now */
+  char* buf  = NULL;
+  size_t len = 0;
+  size_t cap = 0;
+  int appended = 0;
+  int rewrite = 1;
+  scr_index_ids_header header;
+  scr_index_summary* disk = scr_index_summary_new();
+  if (scr_index_ids_load(file, disk, &header) == SCR_SUCCESS) {
+    rewrite = 0;
+
+    int i;
+    for (i = 0; i < summary->count; i++) {
+      int found;
+      const scr_index_entry* e = &summary->entries[i];
+      int pos = scr_index_summary_find(disk, e->id, &found);
+      if (! found || ! scr_index_entry_same(e, &disk->entries[pos])) {
+        scr_index_ids_pack(&buf, &len, &cap, e, 0);
+        appended++;
+      }
+    }
+    for (i = 0; i < disk->count; i++) {
+      int found;
+      const scr_index_entry* e = &disk->entries[i];
+      scr_index_summary_find(summary, e->id, &found);
+      if (! found) {
+        scr_index_ids_pack(&buf, &len, &cap, e, SCR_INDEX_IDS_REMOVED);
+        appended++;
+      }
+    }
+
+    if ((int) header.records + appended > 2 * summary->count + 16) {
+      rewrite = 1;
+    }
+  }
+  scr_index_summary_delete(&disk);
+
+  int rc = SCR_SUCCESS;
+  if (rewrite) {
+    rc = scr_index_ids_rewrite(dir, file, summary);
+  } else {
+    /* append the records, then stamp the header with the new index */
+    rc = SCR_FAILURE;
+    int fd = scr_open(file, O_RDWR);
+    if (fd >= 0) {
+      header.records += (uint32_t) appended;
+      scr_index_ids_stamp(dir, &header);
+      off_t end = lseek(fd, 0, SEEK_END);
+      if (end >= 0 &&
+          (len == 0 || pwrite(fd, buf, len, end) == (ssize_t) len) &&
+          pwrite(fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header))
+      {
+        rc = SCR_SUCCESS;
+      }
+      if (scr_close(file, fd) != SCR_SUCCESS) {
+        rc = SCR_FAILURE;
+      }
+    }
+
+    /* readers rebuild from the index if the header does not match it */
+    if (rc != SCR_SUCCESS) {
+      rc = scr_index_ids_rewrite(dir, file, summary);
+    }
+  }
+  scr_free(&buf);
+
+  scr_index_summary_delete(&summary);
+  scr_free(&file);
+
+  return rc;
+}
+
+/* read the index summary from given directory, builds it from the
+ * index file if the summary is missing or older than the index file */
+int scr_index_summary_read(const spath* dir, scr_index_summary* summary)
+{
+  char* file = scr_index_file(dir, SCR_INDEX_IDS_FILENAME);
+
+  /* use the summary file if it matches the index file */
+  scr_index_ids_header header;
+  if (scr_index_ids_load(file, summary, &header) == SCR_SUCCESS) {
+    scr_index_ids_header now;
+    scr_index_ids_stamp(dir, &now);
+    if (now.index_size == header.index_size && now.index_mtime == header.index_mtime) {
+      scr_free(&file);
+      return SCR_SUCCESS;
+    }
+  }
+
+  /* otherwise parse the index file and write the summary for next time */
+  int rc = SCR_FAILURE;
+  kvtree* index = kvtree_new();
+  if (scr_index_read(dir, index) == SCR_SUCCESS) {
+    scr_index_summary_from_kvtree(summary, index);
+    scr_index_ids_rewrite(dir, file, summary);
+    rc = SCR_SUCCESS;
+  } else {
+    scr_index_summary_clear(summary);
+  }
+  kvtree_delete(&index);
+
+  scr_free(&file);
+  return rc;
+}
+
+/* return entry for given dataset id, or NULL if there is none */
+const scr_index_entry* scr_index_summary_get(const scr_index_summary* summary, int id)
+{
+  int found;
+  int pos = scr_index_summary_find(summary, id, &found);
+  return found ? &summary->entries[pos] : NULL;
+}
+
+/* drop entry for given dataset id from summary in memory */
+int scr_index_summary_remove(scr_index_summary* summary, int id)
+{
+  int found;
+  int pos = scr_index_summary_find(summary, id, &found);
+  if (! found) {
+    return SCR_FAILURE;
+  }
+
+  scr_free(&summary->entries[pos].name);
+  memmove(&summary->entries[pos], &summary->entries[pos + 1],
+    (summary->count - pos - 1) * sizeof(scr_index_entry)
+  );
+  summary->count--;
+  return SCR_SUCCESS;
+}
+
+/* lookup the most recent complete checkpoint id and name whose id is less than earlier_than
+ * setting earlier_than = -1 disables this filter, sets id to -1 if there is none */
+int scr_index_summary_most_recent_complete(const scr_index_summary* summary, int earlier_than, int* id, char* name)
+{
+  *id = -1;
+
+  /* find the first entry at or past the limit, and walk back from there */
+  int found;
+  int pos = summary->count;
+  if (earlier_than != -1) {
+    pos = scr_index_summary_find(summary, earlier_than, &found);
+  }
+
+  int want = SCR_INDEX_FLAG_COMPLETE | SCR_INDEX_FLAG_CKPT;
+  int i;
+  for (i = pos - 1; i >= 0; i--) {
+    const scr_index_entry* e = &summary->entries[i];
+    if ((e->flags & want) == want && ! (e->flags & SCR_INDEX_FLAG_FAILED)) {
+      *id = e->id;
+      strcpy(name, e->name);
+      return SCR_SUCCESS;
+    }
+  }
+
+  return SCR_FAILURE;
+}
+
+/* lookup the dataset having the lowest id, return its id and name,
+ * sets id to -1 to indicate no dataset is left */
+int scr_index_summary_oldest(const scr_index_summary* summary, int* id, char* name)
+{
+  *id = -1;
+  if (summary->count == 0) {
+    return SCR_FAILURE;
+  }
+
+  *id = summary->entries[0].id;
+  strcpy(name, summary->entries[0].name);
+  return SCR_SUCCESS;
+}
+
+/* returns 1 if any dataset in the summary was flushed as a delta
+ * against the given dataset id, 0 otherwise */
+int scr_index_summary_is_base(const scr_index_summary* summary, int id)
+{
+  /* a delta is always flushed after its base, so only later datasets count */
+  int found;
+  int pos = scr_index_summary_find(summary, id, &found);
+  int i;
+  for (i = pos; i < summary->count; i++) {
+    if (summary->entries[i].base == id) {
+      return 1;
+    }
+  }
+  return 0;
+}
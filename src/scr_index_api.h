@@ -19,10 +19,69 @@
 #include "kvtree.h"
 #include "scr_dataset.h"
 
+/* flags recorded for each dataset in an index summary */
+#define SCR_INDEX_FLAG_COMPLETE (0x1) /* dataset is marked as complete */
+#define SCR_INDEX_FLAG_FAILED   (0x2) /* some fetch of dataset failed */
+#define SCR_INDEX_FLAG_CKPT     (0x4) /* dataset is a checkpoint */
+#define SCR_INDEX_FLAG_OUTPUT   (0x8) /* dataset is marked as output */
+
+/* what queries over all datasets in an index need to know of one dataset */
+typedef struct {
+  int   id;    /* dataset id */
+  int   ckpt;  /* checkpoint id, or 0 if not a checkpoint */
+  int   base;  /* id of dataset this one was flushed as a delta against, or -1 */
+  int   flags; /* SCR_INDEX_FLAG_* bits */
+  char* name;  /* dataset name */
+} scr_index_entry;
+
+/* an index summary holds one entry per dataset sorted by id, so queries
+ * are binary searches rather than walks over every dataset in the index,
+ * it is kept as a compact binary file next to the index file */
+typedef struct {
+  int count;                /* number of entries */
+  scr_index_entry* entries; /* entries sorted by id */
+} scr_index_summary;
+
+/* allocate an empty index summary */
+scr_index_summary* scr_index_summary_new(void);
+
+/* free an index summary and set caller's pointer to NULL */
+int scr_index_summary_delete(scr_index_summary** ptr_summary);
+
+/* replace contents of summary with one entry for each dataset in index */
+int scr_index_summary_from_kvtree(scr_index_summary* summary, const kvtree* index);
+
+/* merge entries of summary into index as dataset records holding
+ * the name, ids, completeness, and flags of each dataset */
+int scr_index_summary_to_kvtree(const scr_index_summary* summary, kvtree* index);
+
+/* read the index summary from given directory, builds it from the
+ * index file if the summary is missing or older than the index file */
+int scr_index_summary_read(const spath* dir, scr_index_summary* summary);
+
+/* return entry for given dataset id, or NULL if there is none */
+const scr_index_entry* scr_index_summary_get(const scr_index_summary* summary, int id);
+
+/* drop entry for given dataset id from summary in memory */
+int scr_index_summary_remove(scr_index_summary* summary, int id);
+
+/* lookup the most recent complete checkpoint id and name whose id is less than earlier_than
+ * setting earlier_than = -1 disables this filter, sets id to -1 if there is none */
+int scr_index_summary_most_recent_complete(const scr_index_summary* summary, int earlier_than, int* id, char* name);
+
+/* lookup the dataset having the lowest id, return its id and name,
+ * sets id to -1 to indicate no dataset is left */
+int scr_index_summary_oldest(const scr_index_summary* summary, int* id, char* name);
+
+/* returns 1 if any dataset in the summary was flushed as a delta
+ * against the given dataset id, 0 otherwise */
+int scr_index_summary_is_base(const scr_index_summary* summary, int id);
+
 /* read the index file from given directory and merge its contents into the given hash */
 int scr_index_read(const spath* dir, kvtree* index);
 
-/* overwrite the contents of the index file in given directory with given hash */
+/* overwrite the contents of the index file in given directory with given hash,
+ * and bring the index summary next to it up to date */
 int scr_index_write(const spath* dir, kvtree* index);
 
 /* read index file and return max dataset and checkpoint ids,
@@ -75,6 +134,10 @@ int scr_index_get_id_by_name(const kvtree* index, const char* name, int* id);
  * setting earlier_than = -1 disables this filter */
 int scr_index_get_most_recent_complete(const kvtree* index, int earlier_than, int* id, char* name);
 
+/* returns 1 if any dataset in the index was flushed as a delta
+ * against the given dataset id, 0 otherwise */
+int scr_index_is_base(const kvtree* index, int id);
+
 /* lookup the dataset having the lowest id, return its id and name,
  * sets id to -1 to indicate no dataset is left */
 int scr_index_get_oldest(const kvtree* index, int* id, char* name);
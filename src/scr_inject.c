@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#include "scr_globals.h"
+#include "scr_inject.h"
+
+#include <dirent.h>
+
+/* time this process spent recovering datasets from redundancy data */
+static double scr_inject_recover_secs = 0.0;
+
+int scr_inject_type_from_str(const char* name)
+{
+  if (strcasecmp(name, "NONE") == 0 || strcmp(name, "0") == 0) {
+    return SCR_INJECT_NONE;
+  } else if (strcasecmp(name, "DELETE") == 0) {
+    return SCR_INJECT_DELETE;
+  } else if (strcasecmp(name, "CORRUPT") == 0) {
+    return SCR_INJECT_CORRUPT;
+  } else if (strcasecmp(name, "FILEMAP") == 0) {
+    return SCR_INJECT_FILEMAP;
+  } else if (strcasecmp(name, "NODE") == 0) {
+    return SCR_INJECT_NODE;
+  }
+  return -1;
+}
+
+const char* scr_inject_type_to_str(int type)
+{
+  switch (type) {
+    case SCR_INJECT_DELETE:
+      return "DELETE";
+    case SCR_INJECT_CORRUPT:
+      return "CORRUPT";
+    case SCR_INJECT_FILEMAP:
+      return "FILEMAP";
+    case SCR_INJECT_NODE:
+      return "NODE";
+  }
+  return "NONE";
+}
+
+/* returns 1 if rank is in the comma-separated list of ranks */
+static int scr_inject_rank_listed(const char* list, int rank)
+{
+  if (list == NULL) {
+    return 0;
+  }
+
+  char* copy = strdup(list);
+  char* saveptr = NULL;
+  char* tok = strtok_r(copy, ", ", &saveptr);
+  int found = 0;
+  while (tok != NULL && ! found) {
+    if (atoi(tok) == rank) {
+      found = 1;
+    }
+    tok = strtok_r(NULL, ", ", &saveptr);
+  }
+  scr_free(&copy);
+  return found;
+}
+
+/* flip a few bytes in the middle of file, leaving its size intact
+ * so that only a checksum can tell that it is damaged */
+static int scr_inject_corrupt_file(const char* file)
+{
+  int fd = scr_open(file, O_RDWR);
+  if (fd < 0) {
+    return SCR_FAILURE;
+  }
+
+  int rc = SCR_SUCCESS;
+  off_t size = lseek(fd, 0, SEEK_END);
+  if (size > 0) {
+    char buf[16];
+    size_t count = (size < (off_t) sizeof(buf)) ? (size_t) size : sizeof(buf);
+    off_t offset = (size - (off_t) count) / 2;
+    if (pread(fd, buf, count, offset) == (ssize_t) count) {
+      size_t i;
+      for (i = 0; i < count; i++) {
+        buf[i] ^= 0xFF;
+      }
+      if (pwrite(fd, buf, count, offset) != (ssize_t) count) {
+        rc = SCR_FAILURE;
+      }
+    } else {
+      rc = SCR_FAILURE;
+    }
+  }
+
+  scr_close(file, fd);
+  return rc;
+}
+
+/* delete all regular files in dir */
+static void scr_inject_empty_dir(const char* dir)
+{
+  DIR* dirp = opendir(dir);
+  if (dirp == NULL) {
+    return;
+  }
+
+  struct dirent* dp;
+  while ((dp = readdir(dirp)) != NULL) {
+    if (dp->d_type != DT_REG && dp->d_type != DT_UNKNOWN) {
+      continue;
+    }
+    char* file = scr_strdupf("%s/%s", dir, dp->d_name);
+    struct stat st;
+    if (stat(file, &st) == 0 && S_ISREG(st.st_mode)) {
+      scr_file_unlink(file);
+    }
+    scr_free(&file);
+  }
+  closedir(dirp);
+}
+
+int scr_inject_failures(const scr_cache_index* cindex)
+{
+  if (scr_inject == SCR_INJECT_NONE) {
+    return SCR_SUCCESS;
+  }
+
+  /* damage the latest dataset anyone has in cache,
+   * which is the first one the rebuild will attempt */
+  int latest = scr_cache_index_latest_dataset(cindex);
+  int id;
+  MPI_Allreduce(&latest, &id, 1, MPI_INT, MPI_MAX, scr_comm_world);
+  if (id < 0) {
+    if (scr_my_rank_world == 0) {
+      scr_dbg(0, "SCR_INJECT=%s: no dataset in cache to inject a failure into",
+        scr_inject_type_to_str(scr_inject)
+      );
+    }
+    return SCR_SUCCESS;
+  }
+
+  /* determine whether we are a victim, when losing a node,
+   * every rank on the node of a listed rank is a victim */
+  int victim = scr_inject_rank_listed(scr_inject_ranks, scr_my_rank_world);
+  if (scr_inject == SCR_INJECT_NODE) {
+    int node_victim;
+    MPI_Allreduce(&victim, &node_victim, 1, MPI_INT, MPI_MAX, scr_comm_node);
+    victim = node_victim;
+  }
+
+  int files = 0;
+  if (victim) {
+    /* get the list of files we have for this dataset */
+    scr_filemap* map = scr_filemap_new();
+    scr_cache_get_map(cindex, id, map);
+
+    /* delete or corrupt each of our files */
+    if (scr_inject == SCR_INJECT_DELETE ||
+        scr_inject == SCR_INJECT_CORRUPT ||
+        scr_inject == SCR_INJECT_NODE)
+    {
+      kvtree_elem* file_elem;
+      for (file_elem = scr_filemap_first_file(map);
+           file_elem != NULL;
+           file_elem = kvtree_elem_next(file_elem))
+      {
+        char* file = kvtree_elem_key(file_elem);
+        if (scr_inject == SCR_INJECT_CORRUPT) {
+          if (scr_inject_corrupt_file(file) == SCR_SUCCESS) {
+            files++;
+          }
+        } else {
+          scr_cache_known_unset(file);
+          if (scr_file_unlink(file) == SCR_SUCCESS) {
+            files++;
+          }
+        }
+      }
+    }
+    scr_filemap_delete(&map);
+
+    /* drop our filemap */
+    if (scr_inject == SCR_INJECT_FILEMAP || scr_inject == SCR_INJECT_NODE) {
+      const char* mapfile = scr_cache_get_map_file(cindex, id);
+      if (mapfile != NULL) {
+        scr_file_unlink(mapfile);
+        files++;
+      }
+      scr_free(&mapfile);
+    }
+
+    /* a lost node also loses the redundancy data it held */
+    char* dir = NULL;
+    if (scr_inject == SCR_INJECT_NODE && scr_my_rank_host == 0 &&
+        scr_cache_index_get_dir(cindex, id, &dir) == SCR_SUCCESS)
+    {
+      char* dir_scr = scr_strdupf("%s/.scr", dir);
+      scr_inject_empty_dir(dir_scr);
+      scr_free(&dir_scr);
+    }
+  }
+
+  /* report what we did */
+  int victims, total_files;
+  MPI_Reduce(&victim, &victims, 1, MPI_INT, MPI_SUM, 0, scr_comm_world);
+  MPI_Reduce(&files, &total_files, 1, MPI_INT, MPI_SUM, 0, scr_comm_world);
+  if (scr_my_rank_world == 0) {
+    scr_dbg(0, "SCR_INJECT=%s: damaged %d files of dataset %d on %d ranks",
+      scr_inject_type_to_str(scr_inject), total_files, id, victims
+    );
+    if (scr_log_enable) {
+      scr_log_event("INJECT", scr_inject_type_to_str(scr_inject), &id, NULL, NULL, NULL);
+    }
+  }
+
+  return SCR_SUCCESS;
+}
+
+void scr_inject_recover_time(double secs)
+{
+  scr_inject_recover_secs += secs;
+}
+
+void scr_inject_report(double rebuild_secs, double fetch_secs)
+{
+  if (scr_inject == SCR_INJECT_NONE) {
+    return;
+  }
+
+  /* recovery is only as fast as the slowest process */
+  double secs[3] = {rebuild_secs, scr_inject_recover_secs, fetch_secs};
+  double max[3];
+  MPI_Reduce(secs, max, 3, MPI_DOUBLE, MPI_MAX, 0, scr_comm_world);
+
+  if (scr_my_rank_world == 0) {
+    scr_dbg(0, "SCR_INJECT=%s: rebuild %f secs (recover %f secs), fetch %f secs",
+      scr_inject_type_to_str(scr_inject), max[0], max[1], max[2]
+    );
+    if (scr_log_enable) {
+      scr_log_event("INJECT_REBUILD", NULL, NULL, NULL, NULL, &max[0]);
+      scr_log_event("INJECT_RECOVER", NULL, NULL, NULL, NULL, &max[1]);
+      scr_log_event("INJECT_FETCH",   NULL, NULL, NULL, NULL, &max[2]);
+    }
+  }
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_INJECT_H
+#define SCR_INJECT_H
+
+#include "scr_cache_index.h"
+
+/*
+=========================================
+This file simulates failures so that the cost of recovery can be
+measured without killing nodes.  With SCR_INJECT set, SCR_Init damages
+the most recent dataset in cache on the ranks listed in SCR_INJECT_RANKS
+before it attempts to rebuild, and then reports how long the rebuild,
+the recovery from redundancy data within it, and any fetch took.
+=========================================
+*/
+
+/* kinds of failures we can inject */
+#define SCR_INJECT_NONE    (0) /* no failure */
+#define SCR_INJECT_DELETE  (1) /* delete the cached files of the ranks */
+#define SCR_INJECT_CORRUPT (2) /* flip bytes in the cached files of the ranks */
+#define SCR_INJECT_FILEMAP (3) /* delete the filemaps of the ranks */
+#define SCR_INJECT_NODE    (4) /* lose everything cached on the nodes of the ranks */
+
+/* given a name like "DELETE", return the SCR_INJECT value, or -1 if unknown */
+int scr_inject_type_from_str(const char* name);
+
+/* return the name of an SCR_INJECT value */
+const char* scr_inject_type_to_str(int type);
+
+/* damage the latest dataset in cache according to scr_inject
+ * and scr_inject_ranks, must be called by all procs */
+int scr_inject_failures(const scr_cache_index* cindex);
+
+/* report the time spent by the slowest process to rebuild, to recover
+ * from redundancy data within the rebuild, and to fetch,
+ * must be called by all procs */
+void scr_inject_report(double rebuild_secs, double fetch_secs);
+
+/* add time spent recovering a dataset from redundancy data */
+void scr_inject_recover_time(double secs);
+
+#endif
@@ -9,9 +9,13 @@
  * Please also read this file: LICENSE.TXT.
 */
 
-/* Executable that runs on each node during scavenge to read filemap
- * and report info about each dataset for which there are files. */
+/* Executable that runs on each node during scavenge to read filemaps
+ * and report info about each dataset for which there are files.
+ * Filemaps are read and their files checked by a pool of threads, and
+ * with --quick, files validated by an earlier run whose size and mtime
+ * have not changed are not checked again. */
 
+#include "scr_conf.h"
 #include "scr_keys.h"
 #include "scr.h"
 #include "scr_err.h"
@@ -19,9 +23,11 @@
 #include "scr_util.h"
 #include "scr_meta.h"
 #include "scr_filemap.h"
+#include "scr_dedup.h"
 
 #include "spath.h"
 #include "kvtree.h"
+#include "kvtree_util.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -29,6 +35,10 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <pthread.h>
 
 /* variable length args */
 #include <stdarg.h>
@@ -57,14 +67,6 @@ static int scr_bool_have_file(const scr_filemap* map, const char* file)
     return 0;
   }
 
-  /* check that we can read the file */
-  if (scr_file_is_readable(file) != SCR_SUCCESS) {
-    scr_dbg(2, "Do not have read access to file: %s @ %s:%d",
-      file, __FILE__, __LINE__
-    );
-    return 0;
-  }
-
   /* check that we can read meta file for the file */
   scr_meta* meta = scr_meta_new();
   if (scr_filemap_get_meta(map, file, meta) != SCR_SUCCESS) {
@@ -84,6 +86,23 @@ static int scr_bool_have_file(const scr_filemap* map, const char* file)
     return 0;
   }
 
+  /* check that we can read the file, a deduplicated file is
+   * readable if all of its blocks are in the block store */
+  const kvtree* manifest = scr_meta_get_dedup(meta);
+  int readable;
+  if (manifest != NULL) {
+    readable = scr_dedup_check(manifest);
+  } else {
+    readable = (scr_file_is_readable(file) == SCR_SUCCESS);
+  }
+  if (! readable) {
+    scr_dbg(2, "Do not have read access to file: %s @ %s:%d",
+      file, __FILE__, __LINE__
+    );
+    scr_meta_delete(&meta);
+    return 0;
+  }
+
   /* TODODSET: check that dataset id matches */
 #if 0
   /* check that the file really belongs to the checkpoint id we think it does */
@@ -143,7 +162,7 @@ static int scr_bool_have_file(const scr_filemap* map, const char* file)
 #endif
 
   /* check that the file size matches (use strtol while reading data) */
-  unsigned long size = scr_file_size(file);
+  unsigned long size = (manifest != NULL) ? scr_dedup_size(manifest) : scr_file_size(file);
   unsigned long meta_size = 0;
   if (scr_meta_get_filesize(meta, &meta_size) != SCR_SUCCESS) {
     scr_dbg(2, "Failed to read filesize field in meta data: %s @ %s:%d",
@@ -168,116 +187,445 @@ static int scr_bool_have_file(const scr_filemap* map, const char* file)
   return 1;
 }
 
-int main(int argc, char* argv[])
+/* name of file in control directory where we record files we have
+ * validated, so a later run with --quick can skip them */
+#define SCR_INSPECT_RECORD ("inspect.scrinfo")
+
+/* keys in the validation record */
+#define SCR_INSPECT_KEY_FILEMAP ("FILEMAP")
+#define SCR_INSPECT_KEY_SECS    ("SECS")
+#define SCR_INSPECT_KEY_NSECS   ("NSECS")
+
+/* a filemap of one rank of a dataset, along with the redundancy
+ * group of that rank if we found one */
+typedef struct {
+  int dset;          /* dataset id */
+  int rank;          /* rank of filemap */
+  char* filemap;     /* full path to filemap */
+  char type[8];      /* redundancy type from redset file name */
+  int groups;        /* number of redundancy groups */
+  int group_id;      /* id of our group, -1 if no redset file */
+  int group_size;    /* number of ranks in our group */
+  int group_rank;    /* our rank within the group */
+  int files;         /* number of files in filemap, set by worker */
+  int valid;         /* whether all files are intact, set by worker */
+  kvtree* record;    /* validation record of filemap, set by worker */
+} scr_inspect_job;
+
+/* filemaps that workers pull from in order */
+typedef struct {
+  scr_inspect_job* jobs;  /* filemaps to inspect */
+  int count;              /* number of filemaps */
+  int next;               /* index of next filemap to inspect */
+  const kvtree* prior;    /* record of an earlier run, NULL to check every file */
+  pthread_mutex_t mutex;  /* protects next */
+} scr_inspect_pool;
+
+/* records size and mtime of path in hash, returns 1 on success */
+static int scr_inspect_stat_record(const char* path, kvtree* hash)
 {
-  /* print usage if not enough arguments were given */
-  if (argc < 2) {
-    printf("Usage: scr_inspect_cache <cntldir>\n");
-    return 1;
+  struct stat st;
+  if (stat(path, &st) != 0) {
+    return 0;
   }
+  kvtree_util_set_unsigned_long(hash, SCR_KEY_SIZE, (unsigned long) st.st_size);
+  kvtree_util_set_unsigned_long(hash, SCR_INSPECT_KEY_SECS, (unsigned long) st.st_mtim.tv_sec);
+  kvtree_util_set_unsigned_long(hash, SCR_INSPECT_KEY_NSECS, (unsigned long) st.st_mtim.tv_nsec);
+  return 1;
+}
 
-  spath* scr_main_map_file = spath_from_str(strdup(argv[1]));
-
-  /* get my hostname */
-  if (gethostname(scr_my_hostname, sizeof(scr_my_hostname)) != 0) {
-    scr_err("scr_inspect_cache: Call to gethostname failed @ %s:%d",
-      __FILE__, __LINE__
-    );
-    return 1;
+/* returns 1 if size and mtime of path match those recorded in hash */
+static int scr_inspect_stat_match(const char* path, const kvtree* hash)
+{
+  unsigned long size, secs, nsecs;
+  if (kvtree_util_get_unsigned_long(hash, SCR_KEY_SIZE, &size) != KVTREE_SUCCESS ||
+      kvtree_util_get_unsigned_long(hash, SCR_INSPECT_KEY_SECS, &secs) != KVTREE_SUCCESS ||
+      kvtree_util_get_unsigned_long(hash, SCR_INSPECT_KEY_NSECS, &nsecs) != KVTREE_SUCCESS)
+  {
+    return 0;
   }
 
-  /* read in the main map */
-  kvtree* hash = kvtree_new();
-  kvtree_read_path(scr_main_map_file, hash);
+  struct stat st;
+  if (stat(path, &st) != 0) {
+    return 0;
+  }
+  return ((unsigned long) st.st_size == size &&
+          (unsigned long) st.st_mtim.tv_sec == secs &&
+          (unsigned long) st.st_mtim.tv_nsec == nsecs);
+}
 
-  /* create an empty filemap */
-  scr_filemap* map = scr_filemap_new();
+/* returns 1 if an earlier run validated the filemap of job and neither
+ * it nor any of its files has changed since, and fills in job */
+static int scr_inspect_quick(const kvtree* prior, scr_inspect_job* job)
+{
+  kvtree* map_hash = kvtree_get_kv(prior, SCR_INSPECT_KEY_FILEMAP, job->filemap);
+  if (map_hash == NULL || ! scr_inspect_stat_match(job->filemap, map_hash)) {
+    return 0;
+  }
 
-  /* for each filemap listed in the main map */
+  int files = 0;
   kvtree_elem* elem;
-  for (elem = kvtree_elem_first(kvtree_get(hash, "Filemap"));
+  for (elem = kvtree_elem_first(kvtree_get(map_hash, SCR_KEY_FILE));
        elem != NULL;
        elem = kvtree_elem_next(elem))
   {
-    /* get the filename of this filemap */
-    char* file = kvtree_elem_key(elem);
+    if (! scr_inspect_stat_match(kvtree_elem_key(elem), kvtree_elem_hash(elem))) {
+      return 0;
+    }
+    files++;
+  }
+
+  /* carry the record over to this run */
+  job->files  = files;
+  job->valid  = 1;
+  job->record = kvtree_new();
+  kvtree_merge(job->record, map_hash);
+  return 1;
+}
 
-    /* read in the filemap */
-    scr_filemap* tmp_map = scr_filemap_new();
-    spath* path_file = spath_from_str(file);
-    scr_filemap_read(path_file, tmp_map);
-    spath_delete(&path_file);
+/* reads the filemap of job and checks each of its files */
+static void scr_inspect_filemap(scr_inspect_job* job)
+{
+  job->files  = 0;
+  job->valid  = 0;
+  job->record = kvtree_new();
 
-    /* merge it with local 0 filemap */
-    scr_filemap_merge(map, tmp_map);
+  /* note size and mtime of the filemap before we read it */
+  int recorded = scr_inspect_stat_record(job->filemap, job->record);
 
-    /* delete filemap */
-    scr_filemap_delete(&tmp_map);
+  scr_filemap* map = scr_filemap_new();
+  spath* path_filemap = spath_from_str(job->filemap);
+  int read_rc = scr_filemap_read(path_filemap, map);
+  spath_delete(&path_filemap);
+  if (read_rc != SCR_SUCCESS) {
+    scr_dbg(1, "Failed to read filemap: Dataset %d, Rank %d, File: %s",
+      job->dset, job->rank, job->filemap
+    );
+    scr_filemap_delete(&map);
+    return;
   }
 
-  /* scan each file for each rank of each dataset */
-  kvtree_elem* dset_elem;
-  for (dset_elem = scr_filemap_first_dataset(map);
-       dset_elem != NULL;
-       dset_elem = kvtree_elem_next(dset_elem))
+  int valid = recorded;
+  kvtree_elem* file_elem;
+  for (file_elem = scr_filemap_first_file(map);
+       file_elem != NULL;
+       file_elem = kvtree_elem_next(file_elem))
   {
-    /* get dataset id */
-    int dset = kvtree_elem_key_int(dset_elem);
-
-    /* loop over each rank */
-    kvtree_elem* rank_elem;
-    for (rank_elem = scr_filemap_first_rank_by_dataset(map, dset);
-         rank_elem != NULL;
-         rank_elem = kvtree_elem_next(rank_elem))
-    {
-      /* get rank id */
-      int rank = kvtree_elem_key_int(rank_elem);
-
-      /* verify that the number of files matches the expected number */
-      int missing_file = 0;
-      /* first time through the file list, check that we have each file */
-      kvtree_elem* file_elem = NULL;
-      for (file_elem = scr_filemap_first_file(map);
-           file_elem != NULL;
-           file_elem = kvtree_elem_next(file_elem))
-      {
-        /* get filename */
-        char* file = kvtree_elem_key(file_elem);
-
-        /* check that we can read the file */
-        if (! scr_bool_have_file(map, dset, rank, file)) {
-            missing_file = 1;
-            scr_dbg(1, "File is unreadable or incomplete: Dataset %d, Rank %d, File: %s",
-              dset, rank, file
-            );
+    /* get filename */
+    char* file = kvtree_elem_key(file_elem);
+    job->files++;
+
+    /* check that we can read the file */
+    if (! scr_bool_have_file(map, file)) {
+      valid = 0;
+      scr_dbg(1, "File is unreadable or incomplete: Dataset %d, Rank %d, File: %s",
+        job->dset, job->rank, file
+      );
+      continue;
+    }
+
+    /* remember what the file looked like when we checked it */
+    kvtree* file_hash = kvtree_set_kv(job->record, SCR_KEY_FILE, file);
+    if (! scr_inspect_stat_record(file, file_hash)) {
+      valid = 0;
+    }
+  }
+  job->valid = valid;
+
+  scr_filemap_delete(&map);
+}
+
+/* pull filemaps from the pool and inspect them until none are left */
+static void* scr_inspect_worker(void* arg)
+{
+  scr_inspect_pool* pool = (scr_inspect_pool*) arg;
+  while (1) {
+    pthread_mutex_lock(&pool->mutex);
+    int i = pool->next;
+    pool->next++;
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (i >= pool->count) {
+      break;
+    }
+
+    scr_inspect_job* job = &pool->jobs[i];
+    if (pool->prior == NULL || ! scr_inspect_quick(pool->prior, job)) {
+      scr_inspect_filemap(job);
+    }
+  }
+  return NULL;
+}
+
+/* add a job for filemap of rank in dataset to list, growing it as needed */
+static void scr_inspect_add(scr_inspect_job** jobs, int* count, int* cap, int dset, int rank, const char* filemap)
+{
+  if (*count == *cap) {
+    int newcap = (*cap > 0) ? *cap * 2 : 64;
+    scr_inspect_job* list = (scr_inspect_job*) SCR_MALLOC(newcap * sizeof(scr_inspect_job));
+    if (*count > 0) {
+      memcpy(list, *jobs, *count * sizeof(scr_inspect_job));
+    }
+    scr_free(jobs);
+    *jobs = list;
+    *cap = newcap;
+  }
+
+  scr_inspect_job* job = &(*jobs)[*count];
+  job->dset       = dset;
+  job->rank       = rank;
+  job->filemap    = strdup(filemap);
+  job->type[0]    = '\0';
+  job->groups     = 0;
+  job->group_id   = -1;
+  job->group_size = 0;
+  job->group_rank = 0;
+  job->files      = 0;
+  job->valid      = 0;
+  job->record     = NULL;
+  (*count)++;
+}
+
+/* lists filemaps of dataset in its metadata directory and adds a job for
+ * each, then fills in redundancy groups from names of redset files,
+ * which look like: reddesc.er.<rank>.<type>.grp_<id>_of_<num>.mem_<rank>_of_<size>.redset */
+static void scr_inspect_dataset(const char* cntldir, int dset, scr_inspect_job** jobs, int* count, int* cap)
+{
+  spath* path_dset = spath_from_str(cntldir);
+  spath_append_strf(path_dset, "scr.dataset.%d", dset);
+  spath_append_str(path_dset, ".scr");
+  spath_reduce(path_dset);
+  char* dir = spath_strdup(path_dset);
+  spath_delete(&path_dset);
+
+  DIR* d = opendir(dir);
+  if (d == NULL) {
+    scr_free(&dir);
+    return;
+  }
+
+  /* first pass picks out filemaps */
+  int first = *count;
+  struct dirent* de;
+  while ((de = readdir(d)) != NULL) {
+    int rank, end = 0;
+    if (sscanf(de->d_name, "filemap_%d%n", &rank, &end) == 1 && de->d_name[end] == '\0') {
+      spath* path_filemap = spath_from_str(dir);
+      spath_append_str(path_filemap, de->d_name);
+      char* filemap = spath_strdup(path_filemap);
+      spath_delete(&path_filemap);
+      scr_inspect_add(jobs, count, cap, dset, rank, filemap);
+      scr_free(&filemap);
+    }
+  }
+
+  /* second pass attaches redundancy groups to filemaps of same rank */
+  rewinddir(d);
+  while ((de = readdir(d)) != NULL) {
+    int rank, group_id, groups, group_rank, group_size, end = 0;
+    char type[8];
+    int n = sscanf(de->d_name, "reddesc.er.%d.%7[a-z].grp_%d_of_%d.mem_%d_of_%d.redset%n",
+      &rank, type, &group_id, &groups, &group_rank, &group_size, &end
+    );
+    if (n != 6 || end == 0 || de->d_name[end] != '\0') {
+      continue;
+    }
+
+    int i;
+    for (i = first; i < *count; i++) {
+      scr_inspect_job* job = &(*jobs)[i];
+      if (job->rank == rank) {
+        /* report type in upper case, as the inspect scripts expect */
+        int j;
+        for (j = 0; type[j] != '\0'; j++) {
+          job->type[j] = (char) toupper((unsigned char) type[j]);
         }
+        job->type[j] = '\0';
+        job->groups     = groups;
+        job->group_id   = group_id;
+        job->group_size = group_size;
+        job->group_rank = group_rank;
+        break;
       }
+    }
+  }
 
-      /* TODO: print partner names */
-      /* if we're not missing a file for rank, print this info out */
-      if (! missing_file) {
-        kvtree* desc = kvtree_new();
-        scr_filemap_get_desc(map, dset, rank, desc);
-        char* type           = kvtree_elem_get_first_val(desc, SCR_CONFIG_KEY_TYPE);
-        char* groups_str     = kvtree_elem_get_first_val(desc, SCR_CONFIG_KEY_GROUPS);
-        char* group_id_str   = kvtree_elem_get_first_val(desc, SCR_CONFIG_KEY_GROUP_ID);
-        char* group_size_str = kvtree_elem_get_first_val(desc, SCR_CONFIG_KEY_GROUP_SIZE);
-        char* group_rank_str = kvtree_elem_get_first_val(desc, SCR_CONFIG_KEY_GROUP_RANK);
-        if (type != NULL && groups_str != NULL && group_id_str != NULL && group_size_str != NULL && group_rank_str != NULL) {
-          /* we already have a group id and rank, use that to rebuild the communicator */
-          int groups     = atoi(groups_str);
-          int group_id   = atoi(group_id_str);
-          int group_size = atoi(group_size_str);
-          int group_rank = atoi(group_rank_str);
-          printf("DSET=%d RANK=%d TYPE=%s GROUPS=%d GROUP_ID=%d GROUP_SIZE=%d GROUP_RANK=%d FILES=1\n",
-            dset, rank, type, groups, group_id, group_size, group_rank
-          );
+  closedir(d);
+  scr_free(&dir);
+}
+
+/* order jobs by dataset id and then by rank */
+static int scr_inspect_job_cmp(const void* a, const void* b)
+{
+  const scr_inspect_job* ja = (const scr_inspect_job*) a;
+  const scr_inspect_job* jb = (const scr_inspect_job*) b;
+  if (ja->dset != jb->dset) {
+    return (ja->dset < jb->dset) ? -1 : 1;
+  }
+  if (ja->rank != jb->rank) {
+    return (ja->rank < jb->rank) ? -1 : 1;
+  }
+  return 0;
+}
+
+static void print_usage(void)
+{
+  printf("Usage: scr_inspect_cache [--threads <n>] [--quick] <cntldir>\n");
+  printf("  --threads <n>  Number of threads to read filemaps with (default %d)\n", SCR_INSPECT_THREADS);
+  printf("  --quick        Skip files validated by an earlier run whose size and mtime are unchanged\n");
+}
+
+int main(int argc, char* argv[])
+{
+  static struct option long_options[] = {
+    {"threads", required_argument, NULL, 't'},
+    {"quick",   no_argument,       NULL, 'q'},
+    {"help",    no_argument,       NULL, 'h'},
+    {0, 0, 0, 0}
+  };
+
+  int threads = SCR_INSPECT_THREADS;
+  int quick = 0;
+  int c;
+  while ((c = getopt_long(argc, argv, "t:qh", long_options, NULL)) != -1) {
+    switch (c) {
+      case 't':
+        threads = atoi(optarg);
+        if (threads < 1) {
+          print_usage();
+          return 1;
         }
+        break;
+      case 'q':
+        quick = 1;
+        break;
+      default:
+        print_usage();
+        return 1;
+    }
+  }
+
+  /* print usage if not enough arguments were given */
+  if (optind >= argc) {
+    print_usage();
+    return 1;
+  }
+
+  /* get my hostname */
+  if (gethostname(scr_my_hostname, sizeof(scr_my_hostname)) != 0) {
+    scr_err("scr_inspect_cache: Call to gethostname failed @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return 1;
+  }
+
+  /* older scripts pass the path of a file in the control directory */
+  spath* path_cntl = spath_from_str(argv[optind]);
+  spath_reduce(path_cntl);
+  char* cntldir = spath_strdup(path_cntl);
+  struct stat st;
+  if (stat(cntldir, &st) == 0 && ! S_ISDIR(st.st_mode)) {
+    spath_dirname(path_cntl);
+    scr_free(&cntldir);
+    cntldir = spath_strdup(path_cntl);
+  }
+
+  /* list filemaps of each dataset in the control directory */
+  int count = 0;
+  int cap = 0;
+  scr_inspect_job* jobs = NULL;
+  DIR* d = opendir(cntldir);
+  if (d == NULL) {
+    scr_err("scr_inspect_cache: Failed to open directory %s (errno=%d %s) @ %s:%d",
+      cntldir, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_free(&cntldir);
+    spath_delete(&path_cntl);
+    return 1;
+  }
+  struct dirent* de;
+  while ((de = readdir(d)) != NULL) {
+    int dset, end = 0;
+    if (sscanf(de->d_name, "scr.dataset.%d%n", &dset, &end) == 1 && de->d_name[end] == '\0') {
+      scr_inspect_dataset(cntldir, dset, &jobs, &count, &cap);
+    }
+  }
+  closedir(d);
+
+  /* read what an earlier run validated */
+  spath* path_record = spath_dup(path_cntl);
+  spath_append_str(path_record, SCR_INSPECT_RECORD);
+  kvtree* prior = NULL;
+  if (quick) {
+    prior = kvtree_new();
+    char* record_file = spath_strdup(path_record);
+    if (access(record_file, R_OK) == 0) {
+      kvtree_read_path(path_record, prior);
+    }
+    scr_free(&record_file);
+  }
+
+  /* inspect filemaps with a pool of threads, this thread serves as one of them */
+  if (count > 0) {
+    scr_inspect_pool pool;
+    pool.jobs  = jobs;
+    pool.count = count;
+    pool.next  = 0;
+    pool.prior = prior;
+    pthread_mutex_init(&pool.mutex, NULL);
+
+    int workers = threads;
+    if (workers > count) {
+      workers = count;
+    }
+    pthread_t* tids = (pthread_t*) SCR_MALLOC(workers * sizeof(pthread_t));
+    int nthreads = 1;
+    while (nthreads < workers &&
+           pthread_create(&tids[nthreads], NULL, scr_inspect_worker, &pool) == 0)
+    {
+      nthreads++;
+    }
+    scr_inspect_worker(&pool);
+    int i;
+    for (i = 1; i < nthreads; i++) {
+      pthread_join(tids[i], NULL);
+    }
+    scr_free(&tids);
+    pthread_mutex_destroy(&pool.mutex);
+  }
+
+  /* print one line per intact rank in order, and record what we validated */
+  qsort(jobs, count, sizeof(scr_inspect_job), scr_inspect_job_cmp);
+  kvtree* record = kvtree_new();
+  int i;
+  for (i = 0; i < count; i++) {
+    scr_inspect_job* job = &jobs[i];
+    if (job->valid) {
+      /* TODO: print partner names */
+      if (job->group_id >= 0) {
+        printf("DSET=%d RANK=%d TYPE=%s GROUPS=%d GROUP_ID=%d GROUP_SIZE=%d GROUP_RANK=%d FILES=%d\n",
+          job->dset, job->rank, job->type, job->groups, job->group_id, job->group_size, job->group_rank, job->files
+        );
+      } else {
+        printf("DSET=%d RANK=%d FILES=%d\n", job->dset, job->rank, job->files);
       }
+
+      kvtree* map_hash = kvtree_set_kv(record, SCR_INSPECT_KEY_FILEMAP, job->filemap);
+      kvtree_merge(map_hash, job->record);
     }
+    kvtree_delete(&job->record);
+    scr_free(&job->filemap);
   }
+  scr_free(&jobs);
+
+  /* the record only helps later runs, so failing to write it is not an error */
+  kvtree_write_path(path_record, record);
+  kvtree_delete(&record);
+  kvtree_delete(&prior);
+  spath_delete(&path_record);
 
-  spath_delete(&scr_main_map_file);
+  scr_free(&cntldir);
+  spath_delete(&path_cntl);
 
   return 0;
 }
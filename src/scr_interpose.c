@@ -18,6 +18,24 @@
  *   3) open()/fopen() to call SCR_Start_checkpoint() and/or SCR_Route_file()
  *      before opening the file
  *   4) close()/fclose() to call SCR_Complete_checkpoint() after closing file
+ *   5) write()/pwrite()/writev() to checkpoint files to gather small writes
+ *      into a buffer for each file, which is passed to the file when it
+ *      fills up or before close(), fsync(), read(), pread(), readv(),
+ *      preadv(), pwritev(), fstat(), lseek(), or ftruncate() of the file,
+ *      and in MPI_Finalize(), checkpoint file streams get a stdio buffer of the same
+ *      size, set SCR_CHECKPOINT_BUFFER_SIZE to the size in bytes or 0 to
+ *      disable this
+ *   6) MPI_File_open() of a checkpoint file by all procs of MPI_COMM_WORLD
+ *      to write a shared file, when the app sets the scr_reroute hint to
+ *      true in the info object, each rank writes its part to a segment
+ *      file of its own that SCR routes to cache, MPI_File_write_at(),
+ *      MPI_File_write(), and their collective versions append the data
+ *      to the segment and note the extent it covers in the shared file,
+ *      and MPI_File_close() writes the extent table, SCR writes each
+ *      extent back into the shared file on flush, which is always done
+ *      synchronously for such datasets, only contiguous native file
+ *      views are supported, and reads, nonblocking writes, MPI_SEEK_END,
+ *      and resizing the file return MPI_ERR_UNSUPPORTED_OPERATION
  *
  * This library determines which files are checkpoint files by comparing them
  * to a regular expression provided by the user via an environment variable.
@@ -38,10 +56,13 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #include <stdarg.h>
 
 #include <string.h>
+#include <ctype.h>
+#include <stdint.h>
 #include <regex.h>
 
 #include <unistd.h>
@@ -60,15 +81,36 @@ static int scri_rank              = -1;
 
 static int scri_re_low_high_compiled = 0;
 static int scri_re_low_N_compiled    = 0;
-static int scri_re_scr_file_compiled = 0;
 static regex_t scri_re_low_high;
 static regex_t scri_re_low_N;
-static regex_t scri_re_scr_file;
 
 /* interpose MPI functions */
 int (* scri_real_mpi_init)  (int *, char ***) = NULL;
 int (* scri_real_mpi_fini)  ()                = NULL;
 
+/* interpose MPI-IO functions */
+int (* scri_real_mpi_file_open)        (MPI_Comm, const char *, int, MPI_Info, MPI_File *)                        = NULL;
+int (* scri_real_mpi_file_close)       (MPI_File *)                                                               = NULL;
+int (* scri_real_mpi_file_set_view)    (MPI_File, MPI_Offset, MPI_Datatype, MPI_Datatype, const char *, MPI_Info) = NULL;
+int (* scri_real_mpi_file_set_size)    (MPI_File, MPI_Offset)                                                     = NULL;
+int (* scri_real_mpi_file_write_at)    (MPI_File, MPI_Offset, const void *, int, MPI_Datatype, MPI_Status *)      = NULL;
+int (* scri_real_mpi_file_write_at_all)(MPI_File, MPI_Offset, const void *, int, MPI_Datatype, MPI_Status *)      = NULL;
+int (* scri_real_mpi_file_write)       (MPI_File, const void *, int, MPI_Datatype, MPI_Status *)                  = NULL;
+int (* scri_real_mpi_file_write_all)   (MPI_File, const void *, int, MPI_Datatype, MPI_Status *)                  = NULL;
+int (* scri_real_mpi_file_iwrite_at)   (MPI_File, MPI_Offset, const void *, int, MPI_Datatype, MPI_Request *)     = NULL;
+int (* scri_real_mpi_file_iwrite)      (MPI_File, const void *, int, MPI_Datatype, MPI_Request *)                 = NULL;
+int (* scri_real_mpi_file_read_at)     (MPI_File, MPI_Offset, void *, int, MPI_Datatype, MPI_Status *)            = NULL;
+int (* scri_real_mpi_file_read_at_all) (MPI_File, MPI_Offset, void *, int, MPI_Datatype, MPI_Status *)            = NULL;
+int (* scri_real_mpi_file_read)        (MPI_File, void *, int, MPI_Datatype, MPI_Status *)                        = NULL;
+int (* scri_real_mpi_file_read_all)    (MPI_File, void *, int, MPI_Datatype, MPI_Status *)                        = NULL;
+int (* scri_real_mpi_file_seek)        (MPI_File, MPI_Offset, int)                                                = NULL;
+int (* scri_real_mpi_file_get_position)(MPI_File, MPI_Offset *)                                                   = NULL;
+int (* scri_real_mpi_file_get_size)    (MPI_File, MPI_Offset *)                                                   = NULL;
+#if MPI_VERSION > 3 || (MPI_VERSION == 3 && MPI_SUBVERSION >= 1)
+int (* scri_real_mpi_file_iwrite_at_all)(MPI_File, MPI_Offset, const void *, int, MPI_Datatype, MPI_Request *)    = NULL;
+int (* scri_real_mpi_file_iwrite_all)  (MPI_File, const void *, int, MPI_Datatype, MPI_Request *)                 = NULL;
+#endif
+
 /* interpose open/close functions */
 /*
 int (* scri_real_open)      (const char *, int, mode_t);
@@ -89,10 +131,19 @@ int (* scri_real_mkdir)     (const char *, mode_t) = NULL;
  */
 
 /* interpose read/write functions */
-/*
-ssize_t (* real_read)  (int fd, void *buf, size_t count);
-ssize_t (* real_write) (int fd, const void *buf, size_t count);
-*/
+ssize_t (* scri_real_read)      (int, void *, size_t)               = NULL;
+ssize_t (* scri_real_write)     (int, const void *, size_t)         = NULL;
+ssize_t (* scri_real_pwrite)    (int, const void *, size_t, off_t)  = NULL;
+ssize_t (* scri_real_writev)    (int, const struct iovec *, int)    = NULL;
+off_t   (* scri_real_lseek)     (int, off_t, int)                   = NULL;
+int     (* scri_real_fsync)     (int)                               = NULL;
+int     (* scri_real_fdatasync) (int)                               = NULL;
+int     (* scri_real_ftruncate) (int, off_t)                        = NULL;
+ssize_t (* scri_real_pread)     (int, void *, size_t, off_t)        = NULL;
+ssize_t (* scri_real_readv)     (int, const struct iovec *, int)    = NULL;
+ssize_t (* scri_real_preadv)    (int, const struct iovec *, int, off_t) = NULL;
+ssize_t (* scri_real_pwritev)   (int, const struct iovec *, int, off_t) = NULL;
+int     (* scri_real_fstat)     (int, struct stat *)                = NULL;
 
 /*
 ==============================================================================
@@ -104,9 +155,44 @@ Checkpoint tracking functions and data structures
 #define MAX_CHECKPOINT_FILES (8)
 #endif
 
+/* default size in bytes of the buffer we gather small writes
+ * to each checkpoint file into */
+#ifndef SCRI_BUFFER_SIZE
+#define SCRI_BUFFER_SIZE (1024 * 1024)
+#endif
+
 #define SCRI_FNULL   (0)
 #define SCRI_FD      (1)
 #define SCRI_FSTREAM (2)
+#define SCRI_MPIFILE (3)
+
+/* a segment of a shared file is named after the shared file with this
+ * suffix and the rank appended, and it ends with a trailer holding the
+ * number of extents and the magic, these must match scr_segment.h */
+#define SCRI_SEGMENT_SUFFIX (".scrseg.")
+#define SCRI_SEGMENT_MAGIC  ("SCRSEG01")
+
+/* info key an app sets to "true" when it opens a shared checkpoint
+ * file to have it written as segments in cache */
+#define SCRI_REROUTE_HINT ("scr_reroute")
+
+/* number of slots in the hash of open checkpoint file streams */
+#define SCRI_FSTREAM_SLOTS (4 * MAX_CHECKPOINT_FILES)
+
+/* number of filenames whose lookup result we remember */
+#define SCRI_NAME_SLOTS (256)
+
+/* a compiled regular expression, along with a literal string that
+ * every match must contain, so most names can be rejected without
+ * running the regex */
+struct scri_matcher
+{
+  regex_t re;
+  char*   literal;  /* literal that every match contains, NULL if none */
+  size_t  len;      /* length of literal */
+  int     anchored; /* whether literal must be at the start of the name */
+  int     exact;    /* whether the whole regex is just the literal */
+};
 
 struct scri_checkpointfile
 {
@@ -115,14 +201,30 @@ struct scri_checkpointfile
   int   need_closed; /* whether checkpoint file is open and needs to be closed to complete a checkpoint */
   char* filename;
   char* tempname;
-  regex_t re;
+  struct scri_matcher re;
   int   ftype;
   int   fd;
   int   flags;
   FILE* fstream;
   char* mode;
+  char*  wbuf;     /* small writes not yet passed to the file */
+  size_t wbuf_len; /* number of bytes held in wbuf */
+  int    wbuf_pos; /* whether wbuf holds pwrite data rather than write data */
+  off_t  wbuf_off; /* file offset of the first byte of pwrite data in wbuf */
+  char*  fbuf;     /* stdio buffer given to the file stream */
+  MPI_File   mpifile;   /* MPI file handle of the segment we write the shared file to */
+  MPI_Offset mpi_disp;  /* displacement of the view the app set on the shared file */
+  int        mpi_etype; /* size in bytes of the etype of that view */
+  MPI_Offset seg_pos;   /* number of data bytes written to the segment */
+  MPI_Offset mpi_pos;   /* individual file pointer in etypes relative to the view */
+  uint64_t*  extents;   /* offset and length in the shared file of each extent */
+  int        ext_count; /* number of extents in the list */
+  int        ext_cap;   /* number of extents the list has room for */
 };
 
+/* size of buffer for small writes to each checkpoint file, 0 to disable */
+static size_t scri_buffer_size = SCRI_BUFFER_SIZE;
+
 /* TODO: change this fixed array to a linked list */
 /* keeps track of checkpoint files */
 static int    scri_checkpoint_files_valid = 0;
@@ -131,24 +233,235 @@ static struct scri_checkpointfile scri_checkpoint_files[MAX_CHECKPOINT_FILES];
 /* TODO: support a list of directories like we do for files */
 /* keeps track of checkpoint directory */
 static int     scri_checkpoint_dir_valid = 0;
-static regex_t scri_re_checkpoint_dir;
+static struct scri_matcher scri_re_checkpoint_dir;
 
-/* given a filename and regular expression, return whether there is a match */
-static int scri_file_matches(const char* filename, regex_t* re)
+/* maps an open file descriptor to one plus the index of its
+ * checkpoint file, 0 if the descriptor is not a checkpoint file */
+static int* scri_fd_map      = NULL;
+static int  scri_fd_map_size = 0;
+
+/* open addressing hash from file stream to checkpoint file index */
+struct scri_fstream_slot
+{
+  FILE* fstream; /* NULL if slot is empty */
+  int   index;
+};
+static struct scri_fstream_slot scri_fstream_slots[SCRI_FSTREAM_SLOTS];
+
+/* remembers which checkpoint file a filename matched, the regexs are
+ * fixed once defined, so apps that keep opening the same set of other
+ * files only run the regexs once for each name */
+struct scri_name_slot
+{
+  char* name;  /* NULL if slot is empty */
+  int   index; /* MAX_CHECKPOINT_FILES if name matches no checkpoint file */
+};
+static struct scri_name_slot scri_name_slots[SCRI_NAME_SLOTS];
+
+/* returns 1 if character has special meaning in an extended regex */
+static int scri_re_special(char c)
+{
+  return (strchr(".[]()*+?{}|^$\\", c) != NULL);
+}
+
+/* compile regex and pull out the leading run of literal characters
+ * that every match must contain, returns regcomp return code */
+static int scri_matcher_compile(struct scri_matcher* m, const char* pattern)
+{
+  m->literal  = NULL;
+  m->len      = 0;
+  m->anchored = 0;
+  m->exact    = 0;
+
+  int rc = regcomp(&m->re, pattern, REG_EXTENDED);
+  if (rc != 0) {
+    return rc;
+  }
+
+  /* with alternation, a match need not contain any one literal */
+  if (strchr(pattern, '|') != NULL) {
+    return rc;
+  }
+
+  const char* p = pattern;
+  if (*p == '^') {
+    m->anchored = 1;
+    p++;
+  }
+
+  char* literal = (char*) malloc(strlen(p) + 1);
+  if (literal == NULL) {
+    return rc;
+  }
+
+  size_t len = 0;
+  int complete = 1;
+  while (*p != '\0') {
+    /* take escaped punctuation as a literal character */
+    char c = *p;
+    const char* next = p + 1;
+    if (c == '\\' && p[1] != '\0' && ! isalnum((unsigned char) p[1])) {
+      c = p[1];
+      next = p + 2;
+    } else if (scri_re_special(c)) {
+      complete = 0;
+      break;
+    }
+
+    /* a quantifier makes this character optional, except for '+' */
+    if (*next == '*' || *next == '?' || *next == '{') {
+      complete = 0;
+      break;
+    }
+    literal[len++] = c;
+    p = next;
+    if (*next == '+') {
+      complete = 0;
+      break;
+    }
+  }
+  literal[len] = '\0';
+
+  if (len > 0) {
+    m->literal = literal;
+    m->len     = len;
+    m->exact   = complete;
+  } else {
+    free(literal);
+  }
+
+  return rc;
+}
+
+/* free the regex and literal of a matcher */
+static void scri_matcher_free(struct scri_matcher* m)
+{
+  regfree(&m->re);
+  if (m->literal != NULL) {
+    free(m->literal);
+    m->literal = NULL;
+  }
+}
+
+/* returns 1 if name matches, checking the literal before the regex */
+static int scri_matcher_test(const struct scri_matcher* m, const char* name)
+{
+  if (m->literal != NULL) {
+    if (m->anchored) {
+      if (strncmp(name, m->literal, m->len) != 0) {
+        return 0;
+      }
+    } else if (strstr(name, m->literal) == NULL) {
+      return 0;
+    }
+    if (m->exact) {
+      return 1;
+    }
+  }
+  return (regexec(&m->re, name, 0, NULL, 0) == 0);
+}
+
+/* returns 1 if filename matches the ".scr$" regex of SCR's own files */
+static int scri_is_scr_file(const char* filename)
 {
-  size_t nmatch = 0;
-  regmatch_t pmatch[5];
+  size_t len = strlen(filename);
+  return (len >= 4 && strcmp(filename + len - 3, "scr") == 0);
+}
 
+/* given a filename and regular expression, return whether there is a match */
+static int scri_file_matches(const char* filename, const struct scri_matcher* re)
+{
   /* check for a match on the filename, and check that it's *not* an .scr file */
-  memset(pmatch, 0, sizeof(regmatch_t) * nmatch);
-  if (regexec(re, filename, nmatch, pmatch, 0) == 0 &&
-      regexec(&scri_re_scr_file, filename, nmatch, pmatch, 0) == REG_NOMATCH)
-  {
+  if (scri_matcher_test(re, filename) && ! scri_is_scr_file(filename)) {
     return 1;
   }
   return 0;
 }
 
+/* hash a pointer to a slot in the file stream table */
+static size_t scri_fstream_hash(const FILE* fstream)
+{
+  uintptr_t x = (uintptr_t) fstream;
+  x ^= x >> 17;
+  x *= (uintptr_t) 0x9E3779B97F4A7C15ULL;
+  x ^= x >> 29;
+  return (size_t) (x % SCRI_FSTREAM_SLOTS);
+}
+
+/* record that file stream belongs to checkpoint file index */
+static void scri_fstream_insert(const FILE* fstream, int index)
+{
+  size_t slot = scri_fstream_hash(fstream);
+  while (scri_fstream_slots[slot].fstream != NULL &&
+         scri_fstream_slots[slot].fstream != fstream)
+  {
+    slot = (slot + 1) % SCRI_FSTREAM_SLOTS;
+  }
+  scri_fstream_slots[slot].fstream = (FILE*) fstream;
+  scri_fstream_slots[slot].index   = index;
+}
+
+/* return slot holding file stream, or SCRI_FSTREAM_SLOTS if none */
+static size_t scri_fstream_find(const FILE* fstream)
+{
+  size_t slot = scri_fstream_hash(fstream);
+  while (scri_fstream_slots[slot].fstream != NULL) {
+    if (scri_fstream_slots[slot].fstream == fstream) {
+      return slot;
+    }
+    slot = (slot + 1) % SCRI_FSTREAM_SLOTS;
+  }
+  return SCRI_FSTREAM_SLOTS;
+}
+
+/* forget file stream, and reinsert the entries that follow it
+ * in its run so that later lookups do not stop early */
+static void scri_fstream_remove(const FILE* fstream)
+{
+  size_t slot = scri_fstream_find(fstream);
+  if (slot == SCRI_FSTREAM_SLOTS) {
+    return;
+  }
+  scri_fstream_slots[slot].fstream = NULL;
+
+  slot = (slot + 1) % SCRI_FSTREAM_SLOTS;
+  while (scri_fstream_slots[slot].fstream != NULL) {
+    FILE* moved = scri_fstream_slots[slot].fstream;
+    int index   = scri_fstream_slots[slot].index;
+    scri_fstream_slots[slot].fstream = NULL;
+    scri_fstream_insert(moved, index);
+    slot = (slot + 1) % SCRI_FSTREAM_SLOTS;
+  }
+}
+
+/* record that file descriptor belongs to checkpoint file index */
+static void scri_fd_map_set(int fd, int value)
+{
+  if (fd < 0) {
+    return;
+  }
+
+  /* grow the map to cover this descriptor */
+  if (fd >= scri_fd_map_size) {
+    int size = (scri_fd_map_size > 0) ? scri_fd_map_size : 64;
+    while (size <= fd) {
+      size *= 2;
+    }
+    int* map = (int*) realloc(scri_fd_map, size * sizeof(int));
+    if (map == NULL) {
+      fprintf(stderr,"SCRI: ERROR: Failed to allocate file descriptor map for fd %d @ %s:%d\n",
+              fd, __FILE__, __LINE__
+      );
+      exit(1);
+    }
+    memset(map + scri_fd_map_size, 0, (size - scri_fd_map_size) * sizeof(int));
+    scri_fd_map = map;
+    scri_fd_map_size = size;
+  }
+
+  scri_fd_map[fd] = value;
+}
+
 /* start a new checkpoint if not already in one, mark each file as need_closed */
 static int scri_start_checkpoint()
 {
@@ -192,6 +505,15 @@ static int scri_complete_checkpoint(int index)
       }
     }
 
+    /* let SCR check this file while the others are still being written */
+    if (still_open && index < MAX_CHECKPOINT_FILES &&
+        scri_checkpoint_files[index].tempname != NULL)
+    {
+      scri_interpose_enabled = 0;
+      SCR_Complete_file(scri_checkpoint_files[index].tempname);
+      scri_interpose_enabled = 1;
+    }
+
     /* if there are no files yet to be completed, complete the checkpoint */
     if (!still_open) {
       /* disable the interposer since SCR_Complete_checkpoint calls open/close */
@@ -210,22 +532,46 @@ static int scri_complete_checkpoint(int index)
 /* lookup a checkpoint file index given a filename */
 static int scri_index_by_filename(const char* filename)
 {
+  /* check whether we have looked up this name before */
+  uint32_t hash = 2166136261u;
+  const char* c;
+  for (c = filename; *c != '\0'; c++) {
+    hash = (hash ^ (unsigned char) *c) * 16777619u;
+  }
+  struct scri_name_slot* slot = &scri_name_slots[hash % SCRI_NAME_SLOTS];
+  if (slot->name != NULL && strcmp(slot->name, filename) == 0) {
+    return slot->index;
+  }
+
+  int index = MAX_CHECKPOINT_FILES;
   int i;
   for(i=0; i<MAX_CHECKPOINT_FILES; i++) {
     if (scri_checkpoint_files[i].valid &&
         scri_file_matches(filename, &scri_checkpoint_files[i].re))
     {
-      return i;
+      index = i;
+      break;
     }
   }
-  return MAX_CHECKPOINT_FILES;
+
+  /* remember the result, replacing whatever name held this slot */
+  char* name = strdup(filename);
+  if (name != NULL) {
+    if (slot->name != NULL) {
+      free(slot->name);
+    }
+    slot->name  = name;
+    slot->index = index;
+  }
+
+  return index;
 }
 
 /* lookup a checkpoint file index given an open file descriptor */
 static int scri_index_by_fd(const int fd)
 {
-  int i;
-  for(i=0; i<MAX_CHECKPOINT_FILES; i++) {
+  if (fd >= 0 && fd < scri_fd_map_size && scri_fd_map[fd] > 0) {
+    int i = scri_fd_map[fd] - 1;
     if (scri_checkpoint_files[i].valid &&
         scri_checkpoint_files[i].ftype == SCRI_FD &&
         fd == scri_checkpoint_files[i].fd)
@@ -239,8 +585,9 @@ static int scri_index_by_fd(const int fd)
 /* lookup a checkpoint file index given an open file stream */
 static int scri_index_by_fstream(const FILE* fstream)
 {
-  int i;
-  for(i=0; i<MAX_CHECKPOINT_FILES; i++) {
+  size_t slot = scri_fstream_find(fstream);
+  if (fstream != NULL && slot < SCRI_FSTREAM_SLOTS) {
+    int i = scri_fstream_slots[slot].index;
     if (scri_checkpoint_files[i].valid &&
         scri_checkpoint_files[i].ftype == SCRI_FSTREAM &&
         fstream == scri_checkpoint_files[i].fstream)
@@ -251,6 +598,110 @@ static int scri_index_by_fstream(const FILE* fstream)
   return MAX_CHECKPOINT_FILES;
 }
 
+/* write all of buf to fd, at offset off if pos is set,
+ * returns 0 on success and -1 with errno set on error */
+static int scri_write_all(int fd, const char* buf, size_t count, int pos, off_t off)
+{
+  while (count > 0) {
+    ssize_t n;
+    if (pos) {
+      n = (*scri_real_pwrite)(fd, buf, count, off);
+    } else {
+      n = (*scri_real_write)(fd, buf, count);
+    }
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    buf   += n;
+    count -= (size_t) n;
+    off   += n;
+  }
+  return 0;
+}
+
+/* pass small writes held for checkpoint file index to the file,
+ * returns 0 on success and -1 with errno set on error */
+static int scri_flush_buffer(int index)
+{
+  struct scri_checkpointfile* f = &scri_checkpoint_files[index];
+  if (f->wbuf_len == 0) {
+    return 0;
+  }
+  int rc = scri_write_all(f->fd, f->wbuf, f->wbuf_len, f->wbuf_pos, f->wbuf_off);
+  f->wbuf_len = 0;
+  return rc;
+}
+
+/* pass small writes held for fd to the file if it's a checkpoint file */
+static int scri_flush_fd(int fd)
+{
+  int i = scri_index_by_fd(fd);
+  if (i < MAX_CHECKPOINT_FILES) {
+    return scri_flush_buffer(i);
+  }
+  return 0;
+}
+
+/* make room for a write of count bytes in the buffer of checkpoint
+ * file index, off is the file offset of a pwrite if pos is set,
+ * returns 1 if the data fits, 0 if the caller should write it to the
+ * file itself, and -1 with errno set if passing buffered data failed */
+static int scri_buffer_reserve(int index, size_t count, int pos, off_t off)
+{
+  struct scri_checkpointfile* f = &scri_checkpoint_files[index];
+
+  /* switching between write and pwrite, or a pwrite that skips
+   * ahead or back, ends the run of data we are holding */
+  if (f->wbuf_len > 0 &&
+      (f->wbuf_pos != pos || (pos && off != f->wbuf_off + (off_t) f->wbuf_len)))
+  {
+    if (scri_flush_buffer(index) != 0) {
+      return -1;
+    }
+  }
+
+  /* make room for this write, large writes go straight to the file */
+  if (count > scri_buffer_size - f->wbuf_len) {
+    if (scri_flush_buffer(index) != 0) {
+      return -1;
+    }
+  }
+  if (count >= scri_buffer_size) {
+    return 0;
+  }
+
+  if (f->wbuf == NULL) {
+    f->wbuf = (char*) malloc(scri_buffer_size);
+    if (f->wbuf == NULL) {
+      return 0;
+    }
+  }
+
+  if (f->wbuf_len == 0) {
+    f->wbuf_pos = pos;
+    f->wbuf_off = off;
+  }
+  return 1;
+}
+
+/* add a write of count bytes to the buffer of checkpoint file index,
+ * off is the file offset of a pwrite if pos is set, returns 1 if the
+ * data was buffered, 0 if the caller should write it to the file
+ * itself, and -1 with errno set if passing buffered data failed */
+static int scri_buffer_write(int index, const void* buf, size_t count, int pos, off_t off)
+{
+  int rc = scri_buffer_reserve(index, count, pos, off);
+  if (rc == 1) {
+    struct scri_checkpointfile* f = &scri_checkpoint_files[index];
+    memcpy(f->wbuf + f->wbuf_len, buf, count);
+    f->wbuf_len += count;
+  }
+  return rc;
+}
+
 /* returns 1 if the given filename is a checkpoint file, and 0 otherwise */
 static int scri_is_checkpoint_dirname(const char* name)
 {
@@ -266,9 +717,13 @@ static int scri_is_checkpoint_dirname(const char* name)
 /* returns 1 if the given filename is a checkpoint file, and 0 otherwise */
 static int scri_is_checkpoint_filename(const char* file)
 {
+  /* skip the lookup while SCR itself is opening files */
+  if (! scri_interpose_enabled) {
+    return 0;
+  }
+
   int i = scri_index_by_filename(file);
-  if (scri_interpose_enabled &&
-      i < MAX_CHECKPOINT_FILES &&
+  if (i < MAX_CHECKPOINT_FILES &&
       scri_checkpoint_files[i].enabled)
   {
     return 1;
@@ -307,10 +762,19 @@ static int scri_add_checkpoint_fd(const char* file, const char* temp, const int
 {
   int i = scri_index_by_filename(file);
   if (i < MAX_CHECKPOINT_FILES) {
+    /* forget any descriptor or stream this entry held before */
+    if (scri_checkpoint_files[i].ftype == SCRI_FD) {
+      scri_flush_buffer(i);
+      scri_fd_map_set(scri_checkpoint_files[i].fd, 0);
+    } else if (scri_checkpoint_files[i].ftype == SCRI_FSTREAM) {
+      scri_fstream_remove(scri_checkpoint_files[i].fstream);
+    }
+
     scri_checkpoint_files[i].tempname = strdup(temp);
     scri_checkpoint_files[i].ftype    = SCRI_FD;
     scri_checkpoint_files[i].fd       = fd;
     scri_checkpoint_files[i].flags    = flags;
+    scri_fd_map_set(fd, i + 1);
     return 0;
   }
 
@@ -332,6 +796,7 @@ static int scri_drop_checkpoint_fd(const int fd)
       free(scri_checkpoint_files[i].tempname);
       scri_checkpoint_files[i].tempname = NULL;
     }
+    scri_fd_map_set(fd, 0);
     scri_checkpoint_files[i].ftype = SCRI_FNULL;
     scri_checkpoint_files[i].fd    = -1;
     scri_checkpoint_files[i].flags = 0;
@@ -346,10 +811,32 @@ static int scri_add_checkpoint_fstream(const char* file, const char* temp, const
 {
   int i = scri_index_by_filename(file);
   if (i < MAX_CHECKPOINT_FILES) {
+    /* forget any descriptor or stream this entry held before */
+    if (scri_checkpoint_files[i].ftype == SCRI_FD) {
+      scri_fd_map_set(scri_checkpoint_files[i].fd, 0);
+    } else if (scri_checkpoint_files[i].ftype == SCRI_FSTREAM) {
+      scri_fstream_remove(scri_checkpoint_files[i].fstream);
+    }
+
     scri_checkpoint_files[i].tempname = strdup(temp);
     scri_checkpoint_files[i].ftype    = SCRI_FSTREAM;
     scri_checkpoint_files[i].fstream  = (FILE*) fstream;
     scri_checkpoint_files[i].mode     = strdup(mode);
+    scri_fstream_insert(fstream, i);
+
+    /* give streams we write a larger stdio buffer to gather small writes */
+    if (scri_buffer_size > 0 && scri_checkpoint_files[i].fbuf == NULL &&
+        strcmp(mode, "r") != 0 && strcmp(mode, "rb") != 0)
+    {
+      char* fbuf = (char*) malloc(scri_buffer_size);
+      if (fbuf != NULL) {
+        if (setvbuf((FILE*) fstream, fbuf, _IOFBF, scri_buffer_size) == 0) {
+          scri_checkpoint_files[i].fbuf = fbuf;
+        } else {
+          free(fbuf);
+        }
+      }
+    }
     return 0;
   }
 
@@ -371,8 +858,14 @@ static int scri_drop_checkpoint_fstream(const FILE* fstream)
       free(scri_checkpoint_files[i].tempname);
       scri_checkpoint_files[i].tempname = NULL;
     }
+    scri_fstream_remove(fstream);
     scri_checkpoint_files[i].ftype   = SCRI_FNULL;
     scri_checkpoint_files[i].fstream = NULL;
+    if (scri_checkpoint_files[i].fbuf != NULL) {
+      /* the stream has been closed, so it no longer uses its buffer */
+      free(scri_checkpoint_files[i].fbuf);
+      scri_checkpoint_files[i].fbuf = NULL;
+    }
     if (scri_checkpoint_files[i].mode != NULL) {
       free(scri_checkpoint_files[i].mode);
       scri_checkpoint_files[i].mode = NULL;
@@ -383,11 +876,126 @@ static int scri_drop_checkpoint_fstream(const FILE* fstream)
   return 1;
 }
 
+/* lookup a checkpoint file index given the MPI file handle of its segment */
+static int scri_index_by_mpifile(MPI_File fh)
+{
+  int i;
+  for(i=0; i<MAX_CHECKPOINT_FILES; i++) {
+    if (scri_checkpoint_files[i].valid &&
+        scri_checkpoint_files[i].ftype == SCRI_MPIFILE &&
+        fh == scri_checkpoint_files[i].mpifile)
+    {
+      return i;
+    }
+  }
+  return MAX_CHECKPOINT_FILES;
+}
+
+/* record the MPI file handle of the segment we write for this shared file */
+static int scri_add_checkpoint_mpifile(const char* file, const char* temp, MPI_File fh)
+{
+  int i = scri_index_by_filename(file);
+  if (i < MAX_CHECKPOINT_FILES) {
+    /* forget any descriptor or stream this entry held before */
+    if (scri_checkpoint_files[i].ftype == SCRI_FD) {
+      scri_flush_buffer(i);
+      scri_fd_map_set(scri_checkpoint_files[i].fd, 0);
+    } else if (scri_checkpoint_files[i].ftype == SCRI_FSTREAM) {
+      scri_fstream_remove(scri_checkpoint_files[i].fstream);
+    }
+
+    scri_checkpoint_files[i].tempname  = strdup(temp);
+    scri_checkpoint_files[i].ftype     = SCRI_MPIFILE;
+    scri_checkpoint_files[i].mpifile   = fh;
+    scri_checkpoint_files[i].mpi_disp  = 0;
+    scri_checkpoint_files[i].mpi_etype = 1;
+    scri_checkpoint_files[i].seg_pos   = 0;
+    scri_checkpoint_files[i].mpi_pos   = 0;
+    scri_checkpoint_files[i].ext_count = 0;
+    return 0;
+  }
+
+  /* couldn't find an empty slot for this file */
+  fprintf(stderr,"SCRI: ERROR: Too many checkpoint files open when registering %s, maximum supported is %d @ %s:%d\n",
+          file, MAX_CHECKPOINT_FILES, __FILE__, __LINE__
+  );
+  exit(1);
+
+  return 1;
+}
+
+/* drop the MPI file handle for this shared file (segment has been closed) */
+static int scri_drop_checkpoint_mpifile(int i)
+{
+  if (i < MAX_CHECKPOINT_FILES) {
+    if (scri_checkpoint_files[i].tempname != NULL) {
+      free(scri_checkpoint_files[i].tempname);
+      scri_checkpoint_files[i].tempname = NULL;
+    }
+    if (scri_checkpoint_files[i].extents != NULL) {
+      free(scri_checkpoint_files[i].extents);
+      scri_checkpoint_files[i].extents = NULL;
+    }
+    scri_checkpoint_files[i].ftype     = SCRI_FNULL;
+    scri_checkpoint_files[i].mpifile   = MPI_FILE_NULL;
+    scri_checkpoint_files[i].ext_count = 0;
+    scri_checkpoint_files[i].ext_cap   = 0;
+    return 0;
+  }
+  /* TODO: an error to get here */
+  return 1;
+}
+
+/* note that length bytes at offset in the shared file follow the data
+ * already in the segment, merging with the last extent if they touch */
+static void scri_add_extent(int i, MPI_Offset offset, MPI_Offset length)
+{
+  struct scri_checkpointfile* f = &scri_checkpoint_files[i];
+  if (length <= 0) {
+    return;
+  }
+
+  if (f->ext_count > 0) {
+    uint64_t* last = &f->extents[2 * (f->ext_count - 1)];
+    if (last[0] + last[1] == (uint64_t) offset) {
+      last[1] += (uint64_t) length;
+      return;
+    }
+  }
+
+  if (f->ext_count == f->ext_cap) {
+    int cap = (f->ext_cap > 0) ? 2 * f->ext_cap : 64;
+    uint64_t* extents = (uint64_t*) realloc(f->extents, 2 * cap * sizeof(uint64_t));
+    if (extents == NULL) {
+      fprintf(stderr,"SCRI: ERROR: Failed to allocate %d extents for %s @ %s:%d\n",
+              cap, f->tempname, __FILE__, __LINE__
+      );
+      exit(1);
+    }
+    f->extents = extents;
+    f->ext_cap = cap;
+  }
+
+  f->extents[2 * f->ext_count]     = (uint64_t) offset;
+  f->extents[2 * f->ext_count + 1] = (uint64_t) length;
+  f->ext_count++;
+}
+
+/* returns 1 if datatype covers its extent without holes, 0 otherwise */
+static int scri_type_is_contiguous(MPI_Datatype type)
+{
+  int size;
+  MPI_Aint lb, extent;
+  MPI_Type_size(type, &size);
+  MPI_Type_get_extent(type, &lb, &extent);
+  return (lb == 0 && (MPI_Aint) size == extent);
+}
+
 /* given a regular expression for a checkpoint directory, prepare it for testing */
 static int scri_define_checkpoint_dirname_regex(const char* dirname)
 {
   /* compile the filename regex pattern */
-  int rc = regcomp(&scri_re_checkpoint_dir, dirname, REG_EXTENDED);
+  int rc = scri_matcher_compile(&scri_re_checkpoint_dir, dirname);
   if (rc != 0) {
     fprintf(stderr,"SCRI: ERROR: Checkpoint directory name regex compilation for %s failed (rc=%d) @ %s:%d\n",
             dirname, rc, __FILE__, __LINE__
@@ -418,7 +1026,7 @@ static int scri_define_checkpoint_filename_regex(const char* filename)
       }
 
       /* compile the filename regex pattern */
-      int rc = regcomp(&scri_checkpoint_files[i].re, filename, REG_EXTENDED);
+      int rc = scri_matcher_compile(&scri_checkpoint_files[i].re, filename);
       if (rc != 0) {
         fprintf(stderr,"SCRI: ERROR: Failed to compile filename regex %s (rc=%d) @ %s:%d\n",
                 filename, rc, __FILE__, __LINE__
@@ -528,6 +1136,13 @@ static int scri_define_checkpoint_files()
     }
   }
 
+  /* read in the size of the buffer for small writes to checkpoint files */
+  if ((value = getenv("SCR_CHECKPOINT_BUFFER_SIZE")) != NULL) {
+    if (strcmp(value, "") != 0) {
+      scri_buffer_size = (size_t) strtoul(value, NULL, 0);
+    }
+  }
+
   /* add the regex patterns to our list */
   if (pattern != NULL) {
     int i = 0;
@@ -613,36 +1228,132 @@ static void scr_interpose_init()
     scri_real_mpi_fini = (int (*)()) mydlsym("MPI_Finalize");
   }
 
-  /* interpose open/close functions */
-  if (scri_real_open == NULL) {
-    scri_real_open  = (int (*)(const char *, int, ...)) mydlsym("open");
+  /* interpose MPI-IO functions */
+  if (scri_real_mpi_file_open == NULL) {
+    scri_real_mpi_file_open = (int (*)(MPI_Comm, const char *, int, MPI_Info, MPI_File *)) mydlsym("MPI_File_open");
   }
-  /*
-  scri_real_open  = (int (*)(const char *, int, mode_t)) mydlsym("open");
-  */
-  if (scri_real_close == NULL) {
-    scri_real_close = (int (*)(int fd)) mydlsym("close");
+  if (scri_real_mpi_file_close == NULL) {
+    scri_real_mpi_file_close = (int (*)(MPI_File *)) mydlsym("MPI_File_close");
   }
-
-  /* interpose fopen/fclose functions */
-  if (scri_real_fopen == NULL) {
-    scri_real_fopen  = (FILE* (*)(const char *, const char *)) mydlsym("fopen");
+  if (scri_real_mpi_file_set_view == NULL) {
+    scri_real_mpi_file_set_view = (int (*)(MPI_File, MPI_Offset, MPI_Datatype, MPI_Datatype, const char *, MPI_Info)) mydlsym("MPI_File_set_view");
   }
-  if (scri_real_fclose == NULL) {
-    scri_real_fclose = (int (*)(FILE*)) mydlsym("fclose");
+  if (scri_real_mpi_file_set_size == NULL) {
+    scri_real_mpi_file_set_size = (int (*)(MPI_File, MPI_Offset)) mydlsym("MPI_File_set_size");
   }
-
-  /* interpose mkdir */
-  if (scri_real_mkdir == NULL) {
-    scri_real_mkdir = (int (*)(const char*, mode_t)) mydlsym("mkdir");
+  if (scri_real_mpi_file_write_at == NULL) {
+    scri_real_mpi_file_write_at = (int (*)(MPI_File, MPI_Offset, const void *, int, MPI_Datatype, MPI_Status *)) mydlsym("MPI_File_write_at");
+  }
+  if (scri_real_mpi_file_write_at_all == NULL) {
+    scri_real_mpi_file_write_at_all = (int (*)(MPI_File, MPI_Offset, const void *, int, MPI_Datatype, MPI_Status *)) mydlsym("MPI_File_write_at_all");
+  }
+  if (scri_real_mpi_file_write == NULL) {
+    scri_real_mpi_file_write = (int (*)(MPI_File, const void *, int, MPI_Datatype, MPI_Status *)) mydlsym("MPI_File_write");
+  }
+  if (scri_real_mpi_file_write_all == NULL) {
+    scri_real_mpi_file_write_all = (int (*)(MPI_File, const void *, int, MPI_Datatype, MPI_Status *)) mydlsym("MPI_File_write_all");
+  }
+  if (scri_real_mpi_file_iwrite_at == NULL) {
+    scri_real_mpi_file_iwrite_at = (int (*)(MPI_File, MPI_Offset, const void *, int, MPI_Datatype, MPI_Request *)) mydlsym("MPI_File_iwrite_at");
+  }
+  if (scri_real_mpi_file_iwrite == NULL) {
+    scri_real_mpi_file_iwrite = (int (*)(MPI_File, const void *, int, MPI_Datatype, MPI_Request *)) mydlsym("MPI_File_iwrite");
+  }
+#if MPI_VERSION > 3 || (MPI_VERSION == 3 && MPI_SUBVERSION >= 1)
+  if (scri_real_mpi_file_iwrite_at_all == NULL) {
+    scri_real_mpi_file_iwrite_at_all = (int (*)(MPI_File, MPI_Offset, const void *, int, MPI_Datatype, MPI_Request *)) mydlsym("MPI_File_iwrite_at_all");
+  }
+  if (scri_real_mpi_file_iwrite_all == NULL) {
+    scri_real_mpi_file_iwrite_all = (int (*)(MPI_File, const void *, int, MPI_Datatype, MPI_Request *)) mydlsym("MPI_File_iwrite_all");
+  }
+#endif
+  if (scri_real_mpi_file_read_at == NULL) {
+    scri_real_mpi_file_read_at = (int (*)(MPI_File, MPI_Offset, void *, int, MPI_Datatype, MPI_Status *)) mydlsym("MPI_File_read_at");
+  }
+  if (scri_real_mpi_file_read_at_all == NULL) {
+    scri_real_mpi_file_read_at_all = (int (*)(MPI_File, MPI_Offset, void *, int, MPI_Datatype, MPI_Status *)) mydlsym("MPI_File_read_at_all");
+  }
+  if (scri_real_mpi_file_read == NULL) {
+    scri_real_mpi_file_read = (int (*)(MPI_File, void *, int, MPI_Datatype, MPI_Status *)) mydlsym("MPI_File_read");
+  }
+  if (scri_real_mpi_file_read_all == NULL) {
+    scri_real_mpi_file_read_all = (int (*)(MPI_File, void *, int, MPI_Datatype, MPI_Status *)) mydlsym("MPI_File_read_all");
+  }
+  if (scri_real_mpi_file_seek == NULL) {
+    scri_real_mpi_file_seek = (int (*)(MPI_File, MPI_Offset, int)) mydlsym("MPI_File_seek");
+  }
+  if (scri_real_mpi_file_get_position == NULL) {
+    scri_real_mpi_file_get_position = (int (*)(MPI_File, MPI_Offset *)) mydlsym("MPI_File_get_position");
+  }
+  if (scri_real_mpi_file_get_size == NULL) {
+    scri_real_mpi_file_get_size = (int (*)(MPI_File, MPI_Offset *)) mydlsym("MPI_File_get_size");
+  }
+
+  /* interpose open/close functions */
+  if (scri_real_open == NULL) {
+    scri_real_open  = (int (*)(const char *, int, ...)) mydlsym("open");
+  }
+  /*
+  scri_real_open  = (int (*)(const char *, int, mode_t)) mydlsym("open");
+  */
+  if (scri_real_close == NULL) {
+    scri_real_close = (int (*)(int fd)) mydlsym("close");
+  }
+
+  /* interpose fopen/fclose functions */
+  if (scri_real_fopen == NULL) {
+    scri_real_fopen  = (FILE* (*)(const char *, const char *)) mydlsym("fopen");
+  }
+  if (scri_real_fclose == NULL) {
+    scri_real_fclose = (int (*)(FILE*)) mydlsym("fclose");
+  }
+
+  /* interpose mkdir */
+  if (scri_real_mkdir == NULL) {
+    scri_real_mkdir = (int (*)(const char*, mode_t)) mydlsym("mkdir");
+  }
+
+  /* interpose read/write functions */
+  if (scri_real_read == NULL) {
+    scri_real_read = (ssize_t (*)(int, void *, size_t)) mydlsym("read");
+  }
+  if (scri_real_write == NULL) {
+    scri_real_write = (ssize_t (*)(int, const void *, size_t)) mydlsym("write");
+  }
+  if (scri_real_pwrite == NULL) {
+    scri_real_pwrite = (ssize_t (*)(int, const void *, size_t, off_t)) mydlsym("pwrite");
+  }
+  if (scri_real_writev == NULL) {
+    scri_real_writev = (ssize_t (*)(int, const struct iovec *, int)) mydlsym("writev");
+  }
+  if (scri_real_lseek == NULL) {
+    scri_real_lseek = (off_t (*)(int, off_t, int)) mydlsym("lseek");
+  }
+  if (scri_real_fsync == NULL) {
+    scri_real_fsync = (int (*)(int)) mydlsym("fsync");
+  }
+  if (scri_real_fdatasync == NULL) {
+    scri_real_fdatasync = (int (*)(int)) mydlsym("fdatasync");
+  }
+  if (scri_real_ftruncate == NULL) {
+    scri_real_ftruncate = (int (*)(int, off_t)) mydlsym("ftruncate");
+  }
+  if (scri_real_pread == NULL) {
+    scri_real_pread = (ssize_t (*)(int, void *, size_t, off_t)) mydlsym("pread");
+  }
+  if (scri_real_readv == NULL) {
+    scri_real_readv = (ssize_t (*)(int, const struct iovec *, int)) mydlsym("readv");
+  }
+  if (scri_real_preadv == NULL) {
+    scri_real_preadv = (ssize_t (*)(int, const struct iovec *, int, off_t)) mydlsym("preadv");
+  }
+  if (scri_real_pwritev == NULL) {
+    scri_real_pwritev = (ssize_t (*)(int, const struct iovec *, int, off_t)) mydlsym("pwritev");
+  }
+  if (scri_real_fstat == NULL) {
+    scri_real_fstat = (int (*)(int, struct stat *)) mydlsym("fstat");
   }
 
-  /* interpose read/write functions */
-/*
-  real_read  = (ssize_t (*)(int fd, void *buf, size_t count))       mydlsym("read");
-  real_write = (ssize_t (*)(int fd, const void *buf, size_t count)) mydlsym("write");
-*/
-
   /* initialize the data structures */
   if (!scri_checkpoint_files_valid) {
     scri_checkpoint_files_valid = 1;
@@ -657,6 +1368,19 @@ static void scr_interpose_init()
       scri_checkpoint_files[i].flags    = 0;
       scri_checkpoint_files[i].fstream  = NULL;
       scri_checkpoint_files[i].mode     = NULL;
+      scri_checkpoint_files[i].wbuf     = NULL;
+      scri_checkpoint_files[i].wbuf_len = 0;
+      scri_checkpoint_files[i].wbuf_pos = 0;
+      scri_checkpoint_files[i].wbuf_off = 0;
+      scri_checkpoint_files[i].fbuf     = NULL;
+      scri_checkpoint_files[i].mpifile   = MPI_FILE_NULL;
+      scri_checkpoint_files[i].mpi_disp  = 0;
+      scri_checkpoint_files[i].mpi_etype = 1;
+      scri_checkpoint_files[i].seg_pos   = 0;
+      scri_checkpoint_files[i].mpi_pos   = 0;
+      scri_checkpoint_files[i].extents   = NULL;
+      scri_checkpoint_files[i].ext_count = 0;
+      scri_checkpoint_files[i].ext_cap   = 0;
     }
   }
 
@@ -667,7 +1391,6 @@ static void scr_interpose_init()
   int rc;
   char low_high_range[] = "^([0-9]+)-([0-9]+):";
   char low_N_range[]    = "^([0-9]+)-(N):";
-  char scr_file_ext[]   = ".scr$";
   if (!scri_re_low_high_compiled) {
     scri_re_low_high_compiled = 1;
     rc = regcomp(&scri_re_low_high, low_high_range, REG_EXTENDED);
@@ -688,17 +1411,6 @@ static void scr_interpose_init()
       exit(1);
     }
   }
-  if (!scri_re_scr_file_compiled) {
-    scri_re_scr_file_compiled = 1;
-    rc = regcomp(&scri_re_scr_file, scr_file_ext, REG_EXTENDED);
-    if (rc != 0) {
-      fprintf(stderr,"SCRI: ERROR: Failed to compile scr file extension regex: %s (rc=%d) @ %s:%d\n",
-             scr_file_ext, rc, __FILE__, __LINE__
-      );
-      exit(1);
-    }
-  }
-
   scri_interpose_enabled = 1;
   scri_initialized = 1;
 }
@@ -755,6 +1467,22 @@ int MPI_Finalize ()
 
   /* initialize the interposer */
   if (!scri_initialized) { scr_interpose_init(); }
+
+  /* pass on small writes still held for files the app left open,
+   * so they are in the files before SCR finalizes the checkpoint */
+  if (scri_checkpoint_files_valid) {
+    int i;
+    for(i=0; i<MAX_CHECKPOINT_FILES; i++) {
+      if (scri_checkpoint_files[i].valid &&
+          scri_checkpoint_files[i].ftype == SCRI_FD &&
+          scri_flush_buffer(i) != 0)
+      {
+        fprintf(stderr,"SCRI: ERROR: Failed to write buffered data to %s errno=%d %s @ %s:%d\n",
+                scri_checkpoint_files[i].tempname, errno, strerror(errno), __FILE__, __LINE__
+        );
+      }
+    }
+  }
   
   /* finalize the SCR library */
   scri_interpose_enabled = 0;
@@ -765,9 +1493,8 @@ int MPI_Finalize ()
   /* free off the regular expression structures */
   regfree(&scri_re_low_high);
   regfree(&scri_re_low_N);
-  regfree(&scri_re_scr_file);
   if (scri_checkpoint_dir_valid) {
-    regfree(&scri_re_checkpoint_dir);
+    scri_matcher_free(&scri_re_checkpoint_dir);
   }
   if (scri_checkpoint_files_valid) {
     int i;
@@ -783,17 +1510,491 @@ int MPI_Finalize ()
           free(scri_checkpoint_files[i].tempname);
           scri_checkpoint_files[i].tempname = NULL;
         }
-        regfree(&scri_checkpoint_files[i].re);
+        if (scri_checkpoint_files[i].wbuf != NULL) {
+          free(scri_checkpoint_files[i].wbuf);
+          scri_checkpoint_files[i].wbuf = NULL;
+        }
+        if (scri_checkpoint_files[i].extents != NULL) {
+          free(scri_checkpoint_files[i].extents);
+          scri_checkpoint_files[i].extents = NULL;
+        }
+        scri_matcher_free(&scri_checkpoint_files[i].re);
       }
     }
   }
 
+  /* free the lookup tables */
+  int i;
+  for(i=0; i<SCRI_NAME_SLOTS; i++) {
+    if (scri_name_slots[i].name != NULL) {
+      free(scri_name_slots[i].name);
+      scri_name_slots[i].name = NULL;
+    }
+  }
+  if (scri_fd_map != NULL) {
+    free(scri_fd_map);
+    scri_fd_map = NULL;
+    scri_fd_map_size = 0;
+  }
+
   /* call the real MPI_Finalize */
   rc = (*scri_real_mpi_fini)();
 
   return rc;
 }
 
+/*
+==============================================================================
+Interpose MPI-IO functions
+==============================================================================
+*/
+
+/* returns 1 if info sets the hint that asks us to reroute a shared file */
+static int scri_info_reroute(MPI_Info info)
+{
+  if (info == MPI_INFO_NULL) {
+    return 0;
+  }
+
+  char value[16];
+  int flag = 0;
+  MPI_Info_get(info, SCRI_REROUTE_HINT, (int) sizeof(value) - 1, value, &flag);
+  return (flag && strcmp(value, "true") == 0);
+}
+
+/* report a call we can't apply to the segment of shared checkpoint file i */
+static int scri_segment_unsupported(int i, const char* call)
+{
+  fprintf(stderr,"SCRI: ERROR: %s is not supported on shared checkpoint file %s @ %s:%d\n",
+          call, scri_checkpoint_files[i].tempname, __FILE__, __LINE__
+  );
+  return MPI_ERR_UNSUPPORTED_OPERATION;
+}
+
+#ifdef MPI_File_open
+#undef MPI_File_open
+#endif
+int MPI_File_open(MPI_Comm comm, const char *filename, int amode, MPI_Info info, MPI_File *fh)
+{
+  if (!scri_initialized) { scr_interpose_init(); }
+
+  /* only a checkpoint file written by every proc becomes a shared file
+   * made of segments, and only if the app asks for it, every proc
+   * reaches the same answer here since all of them pass the same name
+   * and hints */
+  int shared = 0;
+  if ((amode & (MPI_MODE_WRONLY | MPI_MODE_RDWR)) &&
+      scri_info_reroute(info) &&
+      scri_is_checkpoint_filename(filename))
+  {
+    int result;
+    MPI_Comm_compare(comm, MPI_COMM_WORLD, &result);
+    if (result == MPI_IDENT || result == MPI_CONGRUENT) {
+      shared = 1;
+    }
+  }
+  if (!shared) {
+    return (*scri_real_mpi_file_open)(comm, filename, amode, info, fh);
+  }
+
+  scri_start_checkpoint();
+
+  /* reroute our segment of the file to cache */
+  char segname[SCR_MAX_FILENAME];
+  char temp[SCR_MAX_FILENAME];
+  snprintf(segname, sizeof(segname), "%s%s%d", filename, SCRI_SEGMENT_SUFFIX, scri_rank);
+  const char* name = segname;
+  scri_interpose_enabled = 0;
+  if (SCR_Route_file(segname, temp) == SCR_SUCCESS) {
+    name = temp;
+  }
+  scri_interpose_enabled = 1;
+
+  /* the segment is ours alone, and it always starts out empty */
+  int seg_amode = (amode | MPI_MODE_CREATE) & ~(MPI_MODE_EXCL | MPI_MODE_DELETE_ON_CLOSE);
+  int rc = (*scri_real_mpi_file_open)(MPI_COMM_SELF, name, seg_amode, info, fh);
+  if (rc != MPI_SUCCESS) {
+    fprintf(stderr,"SCRI: ERROR: Failed to open segment %s for rerouting %s (rc=%d) @ %s:%d\n",
+            name, filename, rc, __FILE__, __LINE__
+    );
+    return rc;
+  }
+  (*scri_real_mpi_file_set_size)(*fh, 0);
+
+  scri_add_checkpoint_mpifile(filename, name, *fh);
+
+  return rc;
+}
+
+/* write data to the end of the segment of checkpoint file i,
+ * and note where it belongs in the shared file */
+static int scri_segment_write_at(
+  int (*real)(MPI_File, MPI_Offset, const void *, int, MPI_Datatype, MPI_Status *),
+  int i, MPI_Offset offset, const void *buf, int count, MPI_Datatype datatype, MPI_Status *status)
+{
+  struct scri_checkpointfile* f = &scri_checkpoint_files[i];
+
+  /* the segment keeps the default view, so positions are in bytes */
+  int size;
+  MPI_Type_size(datatype, &size);
+  MPI_Offset length = (MPI_Offset) count * (MPI_Offset) size;
+  int rc = (*real)(f->mpifile, f->seg_pos, buf, count, datatype, status);
+  if (rc == MPI_SUCCESS) {
+    scri_add_extent(i, f->mpi_disp + offset * (MPI_Offset) f->mpi_etype, length);
+    f->seg_pos += length;
+  }
+  return rc;
+}
+
+#ifdef MPI_File_write_at
+#undef MPI_File_write_at
+#endif
+int MPI_File_write_at(MPI_File fh, MPI_Offset offset, const void *buf, int count, MPI_Datatype datatype, MPI_Status *status)
+{
+  if (!scri_initialized) { scr_interpose_init(); }
+
+  int i = scri_index_by_mpifile(fh);
+  if (i < MAX_CHECKPOINT_FILES) {
+    return scri_segment_write_at(scri_real_mpi_file_write_at, i, offset, buf, count, datatype, status);
+  }
+  return (*scri_real_mpi_file_write_at)(fh, offset, buf, count, datatype, status);
+}
+
+#ifdef MPI_File_write_at_all
+#undef MPI_File_write_at_all
+#endif
+int MPI_File_write_at_all(MPI_File fh, MPI_Offset offset, const void *buf, int count, MPI_Datatype datatype, MPI_Status *status)
+{
+  if (!scri_initialized) { scr_interpose_init(); }
+
+  /* the segment is opened on MPI_COMM_SELF, so its collective
+   * write completes without the other procs */
+  int i = scri_index_by_mpifile(fh);
+  if (i < MAX_CHECKPOINT_FILES) {
+    return scri_segment_write_at(scri_real_mpi_file_write_at_all, i, offset, buf, count, datatype, status);
+  }
+  return (*scri_real_mpi_file_write_at_all)(fh, offset, buf, count, datatype, status);
+}
+
+#ifdef MPI_File_set_view
+#undef MPI_File_set_view
+#endif
+int MPI_File_set_view(MPI_File fh, MPI_Offset disp, MPI_Datatype etype, MPI_Datatype filetype, const char *datarep, MPI_Info info)
+{
+  if (!scri_initialized) { scr_interpose_init(); }
+
+  int i = scri_index_by_mpifile(fh);
+  if (i >= MAX_CHECKPOINT_FILES) {
+    return (*scri_real_mpi_file_set_view)(fh, disp, etype, filetype, datarep, info);
+  }
+
+  /* we can only map offsets of a view without holes straight to bytes,
+   * the app holds the handle of our segment rather than of the shared
+   * file, so we can't pass other views on to MPI */
+  if (!scri_type_is_contiguous(etype) || !scri_type_is_contiguous(filetype) ||
+      strcmp(datarep, "native") != 0)
+  {
+    return scri_segment_unsupported(i, "MPI_File_set_view with a noncontiguous or nonnative view");
+  }
+
+  /* the segment keeps its byte view, we just remember how to map offsets,
+   * setting a view resets the individual file pointer */
+  int size;
+  MPI_Type_size(etype, &size);
+  scri_checkpoint_files[i].mpi_disp  = disp;
+  scri_checkpoint_files[i].mpi_etype = size;
+  scri_checkpoint_files[i].mpi_pos   = 0;
+  return MPI_SUCCESS;
+}
+
+/* write data at the individual file pointer of checkpoint file i
+ * and advance the pointer past it */
+static int scri_segment_write(
+  int (*real)(MPI_File, MPI_Offset, const void *, int, MPI_Datatype, MPI_Status *),
+  int i, const void *buf, int count, MPI_Datatype datatype, MPI_Status *status)
+{
+  struct scri_checkpointfile* f = &scri_checkpoint_files[i];
+  int rc = scri_segment_write_at(real, i, f->mpi_pos, buf, count, datatype, status);
+  if (rc == MPI_SUCCESS) {
+    int size;
+    MPI_Type_size(datatype, &size);
+    f->mpi_pos += (MPI_Offset) count * (MPI_Offset) size / (MPI_Offset) f->mpi_etype;
+  }
+  return rc;
+}
+
+#ifdef MPI_File_write
+#undef MPI_File_write
+#endif
+int MPI_File_write(MPI_File fh, const void *buf, int count, MPI_Datatype datatype, MPI_Status *status)
+{
+  if (!scri_initialized) { scr_interpose_init(); }
+
+  int i = scri_index_by_mpifile(fh);
+  if (i < MAX_CHECKPOINT_FILES) {
+    return scri_segment_write(scri_real_mpi_file_write_at, i, buf, count, datatype, status);
+  }
+  return (*scri_real_mpi_file_write)(fh, buf, count, datatype, status);
+}
+
+#ifdef MPI_File_write_all
+#undef MPI_File_write_all
+#endif
+int MPI_File_write_all(MPI_File fh, const void *buf, int count, MPI_Datatype datatype, MPI_Status *status)
+{
+  if (!scri_initialized) { scr_interpose_init(); }
+
+  int i = scri_index_by_mpifile(fh);
+  if (i < MAX_CHECKPOINT_FILES) {
+    return scri_segment_write(scri_real_mpi_file_write_at_all, i, buf, count, datatype, status);
+  }
+  return (*scri_real_mpi_file_write_all)(fh, buf, count, datatype, status);
+}
+
+#ifdef MPI_File_iwrite_at
+#undef MPI_File_iwrite_at
+#endif
+int MPI_File_iwrite_at(MPI_File fh, MPI_Offset offset, const void *buf, int count, MPI_Datatype datatype, MPI_Request *request)
+{
+  if (!scri_initialized) { scr_interpose_init(); }
+
+  int i = scri_index_by_mpifile(fh);
+  if (i < MAX_CHECKPOINT_FILES) {
+    return scri_segment_unsupported(i, "MPI_File_iwrite_at");
+  }
+  return (*scri_real_mpi_file_iwrite_at)(fh, offset, buf, count, datatype, request);
+}
+
+#ifdef MPI_File_iwrite
+#undef MPI_File_iwrite
+#endif
+int MPI_File_iwrite(MPI_File fh, const void *buf, int count, MPI_Datatype datatype, MPI_Request *request)
+{
+  if (!scri_initialized) { scr_interpose_init(); }
+
+  int i = scri_index_by_mpifile(fh);
+  if (i < MAX_CHECKPOINT_FILES) {
+    return scri_segment_unsupported(i, "MPI_File_iwrite");
+  }
+  return (*scri_real_mpi_file_iwrite)(fh, buf, count, datatype, request);
+}
+
+#if MPI_VERSION > 3 || (MPI_VERSION == 3 && MPI_SUBVERSION >= 1)
+#ifdef MPI_File_iwrite_at_all
+#undef MPI_File_iwrite_at_all
+#endif
+int MPI_File_iwrite_at_all(MPI_File fh, MPI_Offset offset, const void *buf, int count, MPI_Datatype datatype, MPI_Request *request)
+{
+  if (!scri_initialized) { scr_interpose_init(); }
+
+  int i = scri_index_by_mpifile(fh);
+  if (i < MAX_CHECKPOINT_FILES) {
+    return scri_segment_unsupported(i, "MPI_File_iwrite_at_all");
+  }
+  return (*scri_real_mpi_file_iwrite_at_all)(fh, offset, buf, count, datatype, request);
+}
+
+#ifdef MPI_File_iwrite_all
+#undef MPI_File_iwrite_all
+#endif
+int MPI_File_iwrite_all(MPI_File fh, const void *buf, int count, MPI_Datatype datatype, MPI_Request *request)
+{
+  if (!scri_initialized) { scr_interpose_init(); }
+
+  int i = scri_index_by_mpifile(fh);
+  if (i < MAX_CHECKPOINT_FILES) {
+    return scri_segment_unsupported(i, "MPI_File_iwrite_all");
+  }
+  return (*scri_real_mpi_file_iwrite_all)(fh, buf, count, datatype, request);
+}
+#endif
+
+#ifdef MPI_File_read_at
+#undef MPI_File_read_at
+#endif
+int MPI_File_read_at(MPI_File fh, MPI_Offset offset, void *buf, int count, MPI_Datatype datatype, MPI_Status *status)
+{
+  if (!scri_initialized) { scr_interpose_init(); }
+
+  /* the segment holds our extents back to back, not at their offsets */
+  int i = scri_index_by_mpifile(fh);
+  if (i < MAX_CHECKPOINT_FILES) {
+    return scri_segment_unsupported(i, "MPI_File_read_at");
+  }
+  return (*scri_real_mpi_file_read_at)(fh, offset, buf, count, datatype, status);
+}
+
+#ifdef MPI_File_read_at_all
+#undef MPI_File_read_at_all
+#endif
+int MPI_File_read_at_all(MPI_File fh, MPI_Offset offset, void *buf, int count, MPI_Datatype datatype, MPI_Status *status)
+{
+  if (!scri_initialized) { scr_interpose_init(); }
+
+  int i = scri_index_by_mpifile(fh);
+  if (i < MAX_CHECKPOINT_FILES) {
+    return scri_segment_unsupported(i, "MPI_File_read_at_all");
+  }
+  return (*scri_real_mpi_file_read_at_all)(fh, offset, buf, count, datatype, status);
+}
+
+#ifdef MPI_File_read
+#undef MPI_File_read
+#endif
+int MPI_File_read(MPI_File fh, void *buf, int count, MPI_Datatype datatype, MPI_Status *status)
+{
+  if (!scri_initialized) { scr_interpose_init(); }
+
+  int i = scri_index_by_mpifile(fh);
+  if (i < MAX_CHECKPOINT_FILES) {
+    return scri_segment_unsupported(i, "MPI_File_read");
+  }
+  return (*scri_real_mpi_file_read)(fh, buf, count, datatype, status);
+}
+
+#ifdef MPI_File_read_all
+#undef MPI_File_read_all
+#endif
+int MPI_File_read_all(MPI_File fh, void *buf, int count, MPI_Datatype datatype, MPI_Status *status)
+{
+  if (!scri_initialized) { scr_interpose_init(); }
+
+  int i = scri_index_by_mpifile(fh);
+  if (i < MAX_CHECKPOINT_FILES) {
+    return scri_segment_unsupported(i, "MPI_File_read_all");
+  }
+  return (*scri_real_mpi_file_read_all)(fh, buf, count, datatype, status);
+}
+
+#ifdef MPI_File_seek
+#undef MPI_File_seek
+#endif
+int MPI_File_seek(MPI_File fh, MPI_Offset offset, int whence)
+{
+  if (!scri_initialized) { scr_interpose_init(); }
+
+  int i = scri_index_by_mpifile(fh);
+  if (i >= MAX_CHECKPOINT_FILES) {
+    return (*scri_real_mpi_file_seek)(fh, offset, whence);
+  }
+
+  /* the end of the shared file depends on what the other procs write */
+  struct scri_checkpointfile* f = &scri_checkpoint_files[i];
+  MPI_Offset pos;
+  if (whence == MPI_SEEK_SET) {
+    pos = offset;
+  } else if (whence == MPI_SEEK_CUR) {
+    pos = f->mpi_pos + offset;
+  } else {
+    return scri_segment_unsupported(i, "MPI_File_seek with MPI_SEEK_END");
+  }
+  if (pos < 0) {
+    return MPI_ERR_ARG;
+  }
+  f->mpi_pos = pos;
+  return MPI_SUCCESS;
+}
+
+#ifdef MPI_File_get_position
+#undef MPI_File_get_position
+#endif
+int MPI_File_get_position(MPI_File fh, MPI_Offset *offset)
+{
+  if (!scri_initialized) { scr_interpose_init(); }
+
+  int i = scri_index_by_mpifile(fh);
+  if (i < MAX_CHECKPOINT_FILES) {
+    *offset = scri_checkpoint_files[i].mpi_pos;
+    return MPI_SUCCESS;
+  }
+  return (*scri_real_mpi_file_get_position)(fh, offset);
+}
+
+#ifdef MPI_File_get_size
+#undef MPI_File_get_size
+#endif
+int MPI_File_get_size(MPI_File fh, MPI_Offset *size)
+{
+  if (!scri_initialized) { scr_interpose_init(); }
+
+  /* the size of the segment says nothing about the shared file */
+  int i = scri_index_by_mpifile(fh);
+  if (i < MAX_CHECKPOINT_FILES) {
+    return scri_segment_unsupported(i, "MPI_File_get_size");
+  }
+  return (*scri_real_mpi_file_get_size)(fh, size);
+}
+
+#ifdef MPI_File_set_size
+#undef MPI_File_set_size
+#endif
+int MPI_File_set_size(MPI_File fh, MPI_Offset size)
+{
+  if (!scri_initialized) { scr_interpose_init(); }
+
+  int i = scri_index_by_mpifile(fh);
+  if (i >= MAX_CHECKPOINT_FILES) {
+    return (*scri_real_mpi_file_set_size)(fh, size);
+  }
+
+  /* the segment starts out empty, so truncating it before any write
+   * changes nothing, any other size would cut into our data or
+   * the extent table we append on close */
+  if (size == 0 && scri_checkpoint_files[i].ext_count == 0) {
+    return MPI_SUCCESS;
+  }
+  return scri_segment_unsupported(i, "MPI_File_set_size");
+}
+
+#ifdef MPI_File_close
+#undef MPI_File_close
+#endif
+int MPI_File_close(MPI_File *fh)
+{
+  if (!scri_initialized) { scr_interpose_init(); }
+
+  int i = scri_index_by_mpifile(*fh);
+  if (i >= MAX_CHECKPOINT_FILES) {
+    return (*scri_real_mpi_file_close)(fh);
+  }
+
+  /* append the extent table and the trailer to the data */
+  struct scri_checkpointfile* f = &scri_checkpoint_files[i];
+  int rc = MPI_SUCCESS;
+  if (f->ext_count > 0) {
+    rc = (*scri_real_mpi_file_write_at)(f->mpifile, f->seg_pos, f->extents,
+      2 * f->ext_count * (int) sizeof(uint64_t), MPI_BYTE, MPI_STATUS_IGNORE
+    );
+  }
+  char trailer[sizeof(uint64_t) + 8];
+  uint64_t count = (uint64_t) f->ext_count;
+  memcpy(trailer, &count, sizeof(count));
+  memcpy(trailer + sizeof(count), SCRI_SEGMENT_MAGIC, 8);
+  if (rc == MPI_SUCCESS) {
+    MPI_Offset table = (MPI_Offset) (2 * f->ext_count * sizeof(uint64_t));
+    rc = (*scri_real_mpi_file_write_at)(f->mpifile, f->seg_pos + table, trailer,
+      (int) sizeof(trailer), MPI_BYTE, MPI_STATUS_IGNORE
+    );
+  }
+  if (rc != MPI_SUCCESS) {
+    fprintf(stderr,"SCRI: ERROR: Failed to write extent table to segment %s (rc=%d) @ %s:%d\n",
+            f->tempname, rc, __FILE__, __LINE__
+    );
+  }
+
+  /* close the segment */
+  int close_rc = (*scri_real_mpi_file_close)(fh);
+  if (rc == MPI_SUCCESS) {
+    rc = close_rc;
+  }
+
+  /* complete the checkpoint, and drop the handle from our active set */
+  scri_complete_checkpoint(i);
+  scri_drop_checkpoint_mpifile(i);
+
+  return rc;
+}
+
 /*
 ==============================================================================
 Interpose open/close functions
@@ -868,8 +2069,16 @@ int close(int fd)
 
   /* TODO: need to fsync here as well? */
 
+  /* pass on any small writes we are holding for this file */
+  int flush_rc = scri_flush_fd(fd);
+  int flush_errno = errno;
+
   /* close the file */
   int rc = (*scri_real_close)(fd);
+  if (flush_rc != 0 && rc == 0) {
+    errno = flush_errno;
+    rc = -1;
+  }
 
   /* if fd matches a checkpoint file, call SCR_COMPLETE and then remove fd from list */
   if (scri_is_checkpoint_fd(fd)) {
@@ -956,6 +2165,266 @@ int fclose(FILE* fstream)
   return rc;
 } 
 
+/*
+==============================================================================
+Interpose read/write functions
+==============================================================================
+*/
+
+#ifdef write
+#undef write
+#endif
+ssize_t write(int fd, const void *buf, size_t count)
+{
+  /* no file is a checkpoint file before we initialize, so only look up
+   * the real call in these functions, they may run during our own init */
+  if (scri_real_write == NULL) {
+    scri_real_write = (ssize_t (*)(int, const void *, size_t)) mydlsym("write");
+  }
+
+  /* gather small writes to checkpoint files */
+  int i = scri_index_by_fd(fd);
+  if (i < MAX_CHECKPOINT_FILES && scri_buffer_size > 0) {
+    int rc = scri_buffer_write(i, buf, count, 0, 0);
+    if (rc == 1) {
+      return (ssize_t) count;
+    } else if (rc < 0) {
+      return -1;
+    }
+  }
+
+  return (*scri_real_write)(fd, buf, count);
+}
+
+#ifdef pwrite
+#undef pwrite
+#endif
+ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset)
+{
+  if (scri_real_pwrite == NULL) {
+    scri_real_pwrite = (ssize_t (*)(int, const void *, size_t, off_t)) mydlsym("pwrite");
+  }
+
+  /* gather small writes to checkpoint files that follow one another */
+  int i = scri_index_by_fd(fd);
+  if (i < MAX_CHECKPOINT_FILES && scri_buffer_size > 0) {
+    int rc = scri_buffer_write(i, buf, count, 1, offset);
+    if (rc == 1) {
+      return (ssize_t) count;
+    } else if (rc < 0) {
+      return -1;
+    }
+  }
+
+  return (*scri_real_pwrite)(fd, buf, count, offset);
+}
+
+#ifdef writev
+#undef writev
+#endif
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
+{
+  if (scri_real_writev == NULL) {
+    scri_real_writev = (ssize_t (*)(int, const struct iovec *, int)) mydlsym("writev");
+  }
+
+  int i = scri_index_by_fd(fd);
+  if (i < MAX_CHECKPOINT_FILES && scri_buffer_size > 0) {
+    size_t total = 0;
+    int j;
+    for (j = 0; j < iovcnt; j++) {
+      total += iov[j].iov_len;
+    }
+
+    /* gather the pieces of small writes once we know they all fit,
+     * pass on large ones after anything we are holding */
+    if (total < scri_buffer_size) {
+      int rc = scri_buffer_reserve(i, total, 0, 0);
+      if (rc < 0) {
+        return -1;
+      }
+      if (rc == 1) {
+        struct scri_checkpointfile* f = &scri_checkpoint_files[i];
+        for (j = 0; j < iovcnt; j++) {
+          memcpy(f->wbuf + f->wbuf_len, iov[j].iov_base, iov[j].iov_len);
+          f->wbuf_len += iov[j].iov_len;
+        }
+        return (ssize_t) total;
+      }
+    }
+    if (scri_flush_buffer(i) != 0) {
+      return -1;
+    }
+  }
+
+  return (*scri_real_writev)(fd, iov, iovcnt);
+}
+
+#ifdef read
+#undef read
+#endif
+ssize_t read(int fd, void *buf, size_t count)
+{
+  if (scri_real_read == NULL) {
+    scri_real_read = (ssize_t (*)(int, void *, size_t)) mydlsym("read");
+  }
+
+  /* let the read see data we are holding */
+  if (scri_flush_fd(fd) != 0) {
+    return -1;
+  }
+
+  return (*scri_real_read)(fd, buf, count);
+}
+
+#ifdef pread
+#undef pread
+#endif
+ssize_t pread(int fd, void *buf, size_t count, off_t offset)
+{
+  if (scri_real_pread == NULL) {
+    scri_real_pread = (ssize_t (*)(int, void *, size_t, off_t)) mydlsym("pread");
+  }
+
+  if (scri_flush_fd(fd) != 0) {
+    return -1;
+  }
+
+  return (*scri_real_pread)(fd, buf, count, offset);
+}
+
+#ifdef readv
+#undef readv
+#endif
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
+{
+  if (scri_real_readv == NULL) {
+    scri_real_readv = (ssize_t (*)(int, const struct iovec *, int)) mydlsym("readv");
+  }
+
+  if (scri_flush_fd(fd) != 0) {
+    return -1;
+  }
+
+  return (*scri_real_readv)(fd, iov, iovcnt);
+}
+
+#ifdef preadv
+#undef preadv
+#endif
+ssize_t preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+  if (scri_real_preadv == NULL) {
+    scri_real_preadv = (ssize_t (*)(int, const struct iovec *, int, off_t)) mydlsym("preadv");
+  }
+
+  if (scri_flush_fd(fd) != 0) {
+    return -1;
+  }
+
+  return (*scri_real_preadv)(fd, iov, iovcnt, offset);
+}
+
+#ifdef pwritev
+#undef pwritev
+#endif
+ssize_t pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+  if (scri_real_pwritev == NULL) {
+    scri_real_pwritev = (ssize_t (*)(int, const struct iovec *, int, off_t)) mydlsym("pwritev");
+  }
+
+  /* data we are holding must land before this write,
+   * which may overlap it */
+  if (scri_flush_fd(fd) != 0) {
+    return -1;
+  }
+
+  return (*scri_real_pwritev)(fd, iov, iovcnt, offset);
+}
+
+#ifdef fstat
+#undef fstat
+#endif
+int fstat(int fd, struct stat *buf)
+{
+  if (scri_real_fstat == NULL) {
+    scri_real_fstat = (int (*)(int, struct stat *)) mydlsym("fstat");
+  }
+
+  /* the file size must account for data we are holding */
+  if (scri_flush_fd(fd) != 0) {
+    return -1;
+  }
+
+  return (*scri_real_fstat)(fd, buf);
+}
+
+#ifdef lseek
+#undef lseek
+#endif
+off_t lseek(int fd, off_t offset, int whence)
+{
+  if (scri_real_lseek == NULL) {
+    scri_real_lseek = (off_t (*)(int, off_t, int)) mydlsym("lseek");
+  }
+
+  /* the file position must account for data we are holding */
+  if (scri_flush_fd(fd) != 0) {
+    return (off_t) -1;
+  }
+
+  return (*scri_real_lseek)(fd, offset, whence);
+}
+
+#ifdef fsync
+#undef fsync
+#endif
+int fsync(int fd)
+{
+  if (scri_real_fsync == NULL) {
+    scri_real_fsync = (int (*)(int)) mydlsym("fsync");
+  }
+
+  if (scri_flush_fd(fd) != 0) {
+    return -1;
+  }
+
+  return (*scri_real_fsync)(fd);
+}
+
+#ifdef fdatasync
+#undef fdatasync
+#endif
+int fdatasync(int fd)
+{
+  if (scri_real_fdatasync == NULL) {
+    scri_real_fdatasync = (int (*)(int)) mydlsym("fdatasync");
+  }
+
+  if (scri_flush_fd(fd) != 0) {
+    return -1;
+  }
+
+  return (*scri_real_fdatasync)(fd);
+}
+
+#ifdef ftruncate
+#undef ftruncate
+#endif
+int ftruncate(int fd, off_t length)
+{
+  if (scri_real_ftruncate == NULL) {
+    scri_real_ftruncate = (int (*)(int, off_t)) mydlsym("ftruncate");
+  }
+
+  if (scri_flush_fd(fd) != 0) {
+    return -1;
+  }
+
+  return (*scri_real_ftruncate)(fd, length);
+}
+
 /*
 ==============================================================================
 Interpose mkdir functions
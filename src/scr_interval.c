@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+/* Implements the models used by scripts/common/scr_ckpt_interval.py
+ * so SCR_Need_checkpoint can pick its interval as the job runs. */
+
+#include "scr.h"
+#include "scr_err.h"
+#include "scr_util.h"
+#include "scr_interval.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <time.h>
+
+/* convert model name to one of the values above,
+ * returns SCR_SUCCESS if name is recognized */
+int scr_interval_model_from_str(const char* name, int* model)
+{
+  if (strcasecmp(name, "NONE") == 0) {
+    *model = SCR_INTERVAL_NONE;
+  } else if (strcasecmp(name, "YOUNG") == 0) {
+    *model = SCR_INTERVAL_YOUNG;
+  } else if (strcasecmp(name, "DALY") == 0) {
+    *model = SCR_INTERVAL_DALY;
+  } else {
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
+
+/* given the cost of a checkpoint and the mean time between failures
+ * in seconds, return the optimal number of seconds between checkpoints,
+ * returns 0 if the interval can not be computed */
+double scr_interval_secs(int model, double cost, double mtbf)
+{
+  if (cost <= 0.0 || mtbf <= 0.0) {
+    return 0.0;
+  }
+
+  if (model == SCR_INTERVAL_YOUNG) {
+    /* "A First Order Approximation to the Optimum Checkpoint Interval",
+     * John Young, 1974 */
+    return sqrt(2.0 * cost * mtbf);
+  }
+
+  if (model == SCR_INTERVAL_DALY) {
+    /* "A Higher Order Estimate of the Optimum Checkpoint Interval for Restart Dumps",
+     * John Daly, 2006, equation 37 */
+    double m2 = 2.0 * mtbf;
+    if (cost >= m2) {
+      return mtbf;
+    }
+    double f = cost / m2;
+    return sqrt(cost * m2) * (1.0 + sqrt(f) / 3.0 + f / 9.0) - cost;
+  }
+
+  return 0.0;
+}
+
+/* parse timestamp at the start of a log line */
+static int scr_interval_parse_time(const char* line, time_t* t)
+{
+  struct tm tm;
+  memset(&tm, 0, sizeof(tm));
+  if (sscanf(line, "%d-%d-%dT%d:%d:%d",
+    &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+    &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6)
+  {
+    return SCR_FAILURE;
+  }
+  tm.tm_year -= 1900;
+  tm.tm_mon  -= 1;
+  tm.tm_isdst = -1;
+  *t = mktime(&tm);
+  return SCR_SUCCESS;
+}
+
+/* read SCR text log file and estimate the mean time between any failure
+ * and the mean time between failures that required a fetch from the
+ * prefix directory, an estimate is set to 0 if it can not be computed */
+int scr_interval_read_log(const char* file, double* mtbf, double* mtbf_pfs)
+{
+  *mtbf     = 0.0;
+  *mtbf_pfs = 0.0;
+
+  FILE* fp = fopen(file, "r");
+  if (fp == NULL) {
+    return SCR_FAILURE;
+  }
+
+  /* each START begins a new run, a run that follows a run which
+   * did not log a HALT was started because of a failure, and
+   * the failure needed the prefix directory if the run fetched */
+  int runs      = 0;
+  int halted    = 0;
+  int failed    = 0;
+  int fetched   = 0;
+  int fails     = 0;
+  int fails_pfs = 0;
+  time_t first = 0;
+  time_t last  = 0;
+
+  char line[1024];
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    time_t t;
+    if (scr_interval_parse_time(line, &t) != SCR_SUCCESS) {
+      continue;
+    }
+    if (runs == 0 && first == 0) {
+      first = t;
+    }
+    last = t;
+
+    if (strstr(line, "event=START") != NULL) {
+      /* tally up the run that just ended */
+      if (failed) {
+        fails++;
+        if (fetched) {
+          fails_pfs++;
+        }
+      }
+
+      /* the new run follows a failure if the last run did not halt */
+      failed  = (runs > 0 && ! halted);
+      halted  = 0;
+      fetched = 0;
+      runs++;
+    } else if (strstr(line, "event=HALT") != NULL) {
+      halted = 1;
+    } else if (strstr(line, "event=FETCH_SUCCESS") != NULL) {
+      fetched = 1;
+    }
+  }
+  fclose(fp);
+
+  /* tally up the last run */
+  if (failed) {
+    fails++;
+    if (fetched) {
+      fails_pfs++;
+    }
+  }
+
+  /* include the time up to now in the current run */
+  time_t now = time(NULL);
+  if (now > last) {
+    last = now;
+  }
+
+  /* we need some history to estimate failure rates, if we have not
+   * seen a failure yet, assume one is due at the end of the history */
+  double span = difftime(last, first);
+  if (runs == 0 || span <= 0.0) {
+    return SCR_FAILURE;
+  }
+  *mtbf     = span / (double) ((fails     > 0) ? fails     : 1);
+  *mtbf_pfs = span / (double) ((fails_pfs > 0) ? fails_pfs : 1);
+
+  return SCR_SUCCESS;
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_INTERVAL_H
+#define SCR_INTERVAL_H
+
+/*
+=========================================
+This file computes the optimal time between checkpoints given
+the cost of a checkpoint and the mean time between failures,
+and it estimates failure rates from the SCR text log.
+=========================================
+*/
+
+/* models to compute optimal checkpoint interval */
+#define SCR_INTERVAL_NONE  (0)
+#define SCR_INTERVAL_YOUNG (1) /* Young, 1974 */
+#define SCR_INTERVAL_DALY  (2) /* Daly, 2006 */
+
+/* convert model name to one of the values above,
+ * returns SCR_SUCCESS if name is recognized */
+int scr_interval_model_from_str(const char* name, int* model);
+
+/* given the cost of a checkpoint and the mean time between failures
+ * in seconds, return the optimal number of seconds between checkpoints,
+ * returns 0 if the interval can not be computed */
+double scr_interval_secs(int model, double cost, double mtbf);
+
+/* read SCR text log file and estimate the mean time between any failure
+ * and the mean time between failures that required a fetch from the
+ * prefix directory, an estimate is set to 0 if it can not be computed */
+int scr_interval_read_log(const char* file, double* mtbf, double* mtbf_pfs);
+
+#endif
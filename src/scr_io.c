@@ -36,11 +36,17 @@
 /* Please note todos in the cppr section; an optimization of using CPPR apis is
  * planned for upcoming work */
 
+/* O_DIRECT */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "scr_conf.h"
 #include "scr.h"
 #include "scr_err.h"
 #include "scr_io.h"
 #include "scr_util.h"
+#include "scr_numa.h"
 
 #include <stdlib.h>
 #include <stdarg.h>
@@ -69,6 +75,38 @@
 /* gettimeofday */
 #include <sys/time.h>
 
+/* pipelined file copy */
+#include <pthread.h>
+
+/* mmap source file to compute crc during kernel-side copies */
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+
+/* FICLONE */
+#ifdef HAVE_LINUX_FS_H
+#include <linux/fs.h>
+#endif
+
+/* sendfile */
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+
+/* asynchronous I/O with io_uring */
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#include <sys/uio.h>
+#endif
+
+/* number of reads and writes to keep in flight with io_uring,
+ * 0 uses the POSIX read/write path, defined here rather than in
+ * scr_globals.c since the command line tools link this file alone */
+int scr_io_uring_depth = SCR_IO_URING_DEPTH;
+
+/* if set, called with the bytes and seconds of each file copy,
+ * so the library can record copies made by any caller */
+void (*scr_io_copy_hook)(double bytes, double secs) = NULL;
+
 /*  use libcppr to copy files if available */
 #ifdef HAVE_LIBCPPR
 #include "cppr.h"
@@ -547,39 +585,149 @@ ssize_t scr_writef(const char* file, int fd, const char* format, ...)
   return rc;
 }
 
-/* logically concatenate n opened files and read count bytes from this logical file into buf starting
- * from offset, pad with zero on end if missing data */
-int scr_read_pad_n(int n, char** files, int* fds,
-                   char* buf, unsigned long count, unsigned long offset, unsigned long* filesizes)
+/* read up to size bytes at offset with pread, retrying on interrupts
+ * and short reads, returns number of bytes read or -1 on error */
+static ssize_t scr_pread_attempt(const char* file, int fd, void* buf, size_t size, off_t offset)
 {
-  int i = 0;
-  size_t pos = 0;
-  off_t nseek = 0;
-  off_t nread = 0;
-
-  /* pass through files until we find the one containing our offset */
-  while (i < n && (nseek + filesizes[i]) <= offset) {
-    nseek += filesizes[i];
-    i++;
+  ssize_t n = 0;
+  int retries = 10;
+  while (n < size) {
+    ssize_t rc = pread(fd, (char*) buf + n, size - n, offset + n);
+    if (rc > 0) {
+      n += rc;
+    } else if (rc == 0) {
+      /* EOF */
+      return n;
+    } else {
+      if (errno == EINTR || errno == EAGAIN) {
+        continue;
+      }
+      retries--;
+      if (retries) {
+        scr_dbg(1, "Error reading file %s pread(%d, %x, %ld, %ld) errno=%d %s @ %s:%d",
+          file, fd, (char*) buf + n, (long) (size - n), (long) (offset + n),
+          errno, strerror(errno), __FILE__, __LINE__
+        );
+      } else {
+        scr_err("Giving up read of file %s errno=%d %s @ %s:%d",
+          file, errno, strerror(errno), __FILE__, __LINE__
+        );
+        return -1;
+      }
+    }
   }
+  return n;
+}
 
-  /* seek to the proper position in the current file */
-  if (i < n) {
-      pos = offset - nseek;
-      nseek += pos;
-      if (lseek(fds[i], pos, SEEK_SET) == (off_t)-1) {
-        /* our seek failed, return an error */
-        scr_err("Failed to seek to byte %lu in %s @ %s:%d",
-          pos, files[i], __FILE__, __LINE__
+/* write size bytes at offset with pwrite, retrying on interrupts
+ * and short writes, returns number of bytes written or -1 on error */
+static ssize_t scr_pwrite_attempt(const char* file, int fd, const void* buf, size_t size, off_t offset)
+{
+  ssize_t n = 0;
+  int retries = 10;
+  while (n < size) {
+    ssize_t rc = pwrite(fd, (const char*) buf + n, size - n, offset + n);
+    if (rc > 0) {
+      n += rc;
+    } else if (rc == 0) {
+      /* something bad happened, print an error and abort */
+      scr_err("Error writing file %s pwrite returned 0 @ %s:%d",
+        file, __FILE__, __LINE__
+      );
+      return -1;
+    } else {
+      if (errno == EINTR || errno == EAGAIN) {
+        continue;
+      }
+      retries--;
+      if (retries) {
+        scr_dbg(1, "Error writing file %s pwrite(%d, %x, %ld, %ld) errno=%d %s @ %s:%d",
+          file, fd, (const char*) buf + n, (long) (size - n), (long) (offset + n),
+          errno, strerror(errno), __FILE__, __LINE__
         );
-        return SCR_FAILURE;
+      } else {
+        scr_err("Giving up write of file %s errno=%d %s @ %s:%d",
+          file, errno, strerror(errno), __FILE__, __LINE__
+        );
+        return -1;
       }
+    }
+  }
+  return n;
+}
+
+/* build a logical file from n opened files with known filesizes,
+ * precomputes the starting offset of each file in the logical file,
+ * the files, fds, and filesizes arrays must outlive the object */
+int scr_logical_file_init(
+  scr_logical_file* lf,
+  int n,
+  char** files,
+  int* fds,
+  unsigned long* filesizes)
+{
+  lf->n         = n;
+  lf->files     = files;
+  lf->fds       = fds;
+  lf->filesizes = filesizes;
+  lf->offsets   = (unsigned long*) SCR_MALLOC((n + 1) * sizeof(unsigned long));
+
+  /* compute prefix sum of file sizes */
+  int i;
+  lf->offsets[0] = 0;
+  for (i = 0; i < n; i++) {
+    lf->offsets[i + 1] = lf->offsets[i] + filesizes[i];
+  }
+
+  return SCR_SUCCESS;
+}
+
+/* free memory associated with logical file, does not close the files */
+int scr_logical_file_free(scr_logical_file* lf)
+{
+  scr_free(&lf->offsets);
+  lf->n = 0;
+  return SCR_SUCCESS;
+}
+
+/* return index of file containing byte at offset, or n if offset
+ * is beyond the end of the logical file */
+static int scr_logical_file_find(const scr_logical_file* lf, unsigned long offset)
+{
+  if (offset >= lf->offsets[lf->n]) {
+    return lf->n;
   }
 
-  /* read data from files */
-  while (nread < count && i < n) {
+  /* binary search for largest i with offsets[i] <= offset,
+   * skipping over any zero-length files */
+  int low  = 0;
+  int high = lf->n - 1;
+  while (low < high) {
+    int mid = low + (high - low + 1) / 2;
+    if (lf->offsets[mid] <= offset) {
+      low = mid;
+    } else {
+      high = mid - 1;
+    }
+  }
+  return low;
+}
+
+/* read count bytes starting from offset in the logical file into buf,
+ * pad with zero on end if missing data */
+int scr_logical_file_read(
+  const scr_logical_file* lf,
+  char* buf,
+  unsigned long count,
+  unsigned long offset)
+{
+  unsigned long nread = 0;
+
+  int i = scr_logical_file_find(lf, offset);
+  unsigned long pos = (i < lf->n) ? offset - lf->offsets[i] : 0;
+  while (nread < count && i < lf->n) {
     /* assume we'll read the remainder of the current file */
-    size_t num_to_read = filesizes[i] - pos;
+    unsigned long num_to_read = lf->filesizes[i] - pos;
 
     /* if we don't need to read the whole remainder of the file, adjust to the smaller amount */
     if (num_to_read > count - nread) {
@@ -587,24 +735,18 @@ int scr_read_pad_n(int n, char** files, int* fds,
     }
 
     /* read data from file and add to the total read count */
-    if (scr_read_attempt(files[i], fds[i], buf + nread, num_to_read) != num_to_read) {
-      /* our read failed, return an error */
-      return SCR_FAILURE;
-    }
-    nread += num_to_read;
-
-    /* advance to next file and seek to byte 0 */
-    i++;
-    if (i < n) {
-      pos = 0;
-      if (lseek(fds[i], pos, SEEK_SET) == (off_t)-1) {
-        /* our seek failed, return an error */
-        scr_err("Failed to seek to byte %lu in %s @ %s:%d",
-          pos, files[i], __FILE__, __LINE__
-        );
+    if (num_to_read > 0) {
+      ssize_t rc = scr_pread_attempt(lf->files[i], lf->fds[i], buf + nread, num_to_read, (off_t) pos);
+      if (rc != (ssize_t) num_to_read) {
+        /* our read failed, return an error */
         return SCR_FAILURE;
       }
+      nread += num_to_read;
     }
+
+    /* advance to start of next file */
+    i++;
+    pos = 0;
   }
 
   /* if count is bigger than all of our file data, pad with zeros on the end */
@@ -615,38 +757,21 @@ int scr_read_pad_n(int n, char** files, int* fds,
   return SCR_SUCCESS;
 }
 
-/* write to an array of open files with known filesizes treating them as one single large file */
-int scr_write_pad_n(int n, char** files, int* fds,
-                    char* buf, unsigned long count, unsigned long offset, unsigned long* filesizes)
+/* write count bytes from buf starting at offset in the logical file,
+ * data beyond the end of the logical file is discarded */
+int scr_logical_file_write(
+  const scr_logical_file* lf,
+  const char* buf,
+  unsigned long count,
+  unsigned long offset)
 {
-  int i = 0;
-  size_t pos = 0;
-  off_t nseek  = 0;
-  off_t nwrite = 0;
-
-  /* pass through files until we find the one containing our offset */
-  while (i < n && (nseek + filesizes[i]) <= offset) {
-    nseek += filesizes[i];
-    i++;
-  }
-
-  /* seek to the proper position in the current file */
-  if (i < n) {
-      pos = offset - nseek;
-      nseek += pos;
-      if (lseek(fds[i], pos, SEEK_SET) == (off_t)-1) {
-        /* our seek failed, return an error */
-        scr_err("Failed to seek to byte %lu in %s @ %s:%d",
-          pos, files[i], __FILE__, __LINE__
-        );
-        return SCR_FAILURE;
-      }
-  }
+  unsigned long nwrite = 0;
 
-  /* write data to files */
-  while (nwrite < count && i < n) {
+  int i = scr_logical_file_find(lf, offset);
+  unsigned long pos = (i < lf->n) ? offset - lf->offsets[i] : 0;
+  while (nwrite < count && i < lf->n) {
     /* assume we'll write the remainder of the current file */
-    size_t num_to_write = filesizes[i] - pos;
+    unsigned long num_to_write = lf->filesizes[i] - pos;
 
     /* if we don't need to write the whole remainder of the file, adjust to the smaller amount */
     if (num_to_write > count - nwrite) {
@@ -654,34 +779,49 @@ int scr_write_pad_n(int n, char** files, int* fds,
     }
 
     /* write data to file and add to the total write count */
-    if (scr_write_attempt(files[i], fds[i], buf + nwrite, num_to_write) != num_to_write) {
-      /* our write failed, return an error */
-      return SCR_FAILURE;
-    }
-    nwrite += num_to_write;
-
-    /* advance to next file and seek to byte 0 */
-    i++;
-    if (i < n) {
-      pos = 0;
-      if (lseek(fds[i], pos, SEEK_SET) == (off_t)-1) {
-        /* our seek failed, return an error */
-        scr_err("Failed to seek to byte %lu in %s @ %s:%d",
-          pos, files[i], __FILE__, __LINE__
-        );
+    if (num_to_write > 0) {
+      ssize_t rc = scr_pwrite_attempt(lf->files[i], lf->fds[i], buf + nwrite, num_to_write, (off_t) pos);
+      if (rc != (ssize_t) num_to_write) {
+        /* our write failed, return an error */
         return SCR_FAILURE;
       }
+      nwrite += num_to_write;
     }
+
+    /* advance to start of next file */
+    i++;
+    pos = 0;
   }
 
   /* if count is bigger than all of our file data, just throw the data away */
-  if (nwrite < count) {
-    /* NOTHING TO DO */
-  }
 
   return SCR_SUCCESS;
 }
 
+/* logically concatenate n opened files and read count bytes from this logical file into buf starting
+ * from offset, pad with zero on end if missing data, for one-off reads */
+int scr_read_pad_n(int n, char** files, int* fds,
+                   char* buf, unsigned long count, unsigned long offset, unsigned long* filesizes)
+{
+  scr_logical_file lf;
+  scr_logical_file_init(&lf, n, files, fds, filesizes);
+  int rc = scr_logical_file_read(&lf, buf, count, offset);
+  scr_logical_file_free(&lf);
+  return rc;
+}
+
+/* write to an array of open files with known filesizes treating them as one single large file,
+ * for one-off writes */
+int scr_write_pad_n(int n, char** files, int* fds,
+                    char* buf, unsigned long count, unsigned long offset, unsigned long* filesizes)
+{
+  scr_logical_file lf;
+  scr_logical_file_init(&lf, n, files, fds, filesizes);
+  int rc = scr_logical_file_write(&lf, buf, count, offset);
+  scr_logical_file_free(&lf);
+  return rc;
+}
+
 /* given a filename, return number of bytes in file */
 unsigned long scr_file_size(const char* file)
 {
@@ -762,6 +902,250 @@ int scr_file_unlink(const char* file)
   return SCR_SUCCESS;
 }
 
+/*
+=========================================
+io_uring backend
+=========================================
+*/
+
+/* set number of reads and writes to keep in flight with io_uring in
+ * scr_file_copy and scr_crc32, 0 disables io_uring */
+int scr_io_set_uring_depth(int depth)
+{
+#ifdef HAVE_LIBURING
+  scr_io_uring_depth = (depth > 0) ? depth : 0;
+  return SCR_SUCCESS;
+#else
+  if (depth > 0) {
+    scr_dbg(1, "SCR was built without io_uring support, using POSIX I/O @ %s:%d",
+      __FILE__, __LINE__
+    );
+  }
+  scr_io_uring_depth = 0;
+  return SCR_FAILURE;
+#endif
+}
+
+#ifdef HAVE_LIBURING
+#define SCR_URING_FREE    (0) /* buffer is available */
+#define SCR_URING_READING (1) /* read is in flight */
+#define SCR_URING_READ    (2) /* read completed, waiting for crc in file order */
+#define SCR_URING_WRITING (3) /* write is in flight */
+
+typedef struct {
+  char* buf;           /* registered buffer */
+  int index;           /* index of registered buffer */
+  int state;           /* one of SCR_URING_* values */
+  off_t offset;        /* offset of this block in the file */
+  size_t len;          /* number of bytes in this block */
+  size_t done;         /* number of bytes of current operation completed so far */
+  unsigned long seq;   /* block number, used to compute crc in order */
+} scr_uring_slot;
+
+/* queue read or write of remainder of slot */
+static void scr_uring_queue(struct io_uring* ring, scr_uring_slot* slot, int fd, int write, int fixed)
+{
+  struct io_uring_sqe* sqe = io_uring_get_sqe(ring);
+  char* buf = slot->buf + slot->done;
+  unsigned nbytes = (unsigned) (slot->len - slot->done);
+  off_t offset = slot->offset + (off_t) slot->done;
+  if (write) {
+    if (fixed) {
+      io_uring_prep_write_fixed(sqe, fd, buf, nbytes, offset, slot->index);
+    } else {
+      io_uring_prep_write(sqe, fd, buf, nbytes, offset);
+    }
+  } else {
+    if (fixed) {
+      io_uring_prep_read_fixed(sqe, fd, buf, nbytes, offset, slot->index);
+    } else {
+      io_uring_prep_read(sqe, fd, buf, nbytes, offset);
+    }
+  }
+  io_uring_sqe_set_data(sqe, slot);
+}
+
+/* read size bytes of src_fd with up to depth reads in flight,
+ * optionally compute the crc in file order and write the data to dst_fd
+ * (pass dst_fd < 0 to only read), sets fallback and returns SCR_FAILURE
+ * without touching the files if the kernel does not support io_uring */
+static int scr_uring_stream(
+  const char* src_file,
+  int src_fd,
+  const char* dst_file,
+  int dst_fd,
+  off_t size,
+  unsigned long buf_size,
+  int depth,
+  uLong* crc,
+  int* fallback)
+{
+  *fallback = 0;
+
+  struct io_uring ring;
+  int ret = io_uring_queue_init((unsigned) depth, &ring, 0);
+  if (ret < 0) {
+    scr_dbg(2, "io_uring_queue_init failed, using POSIX I/O: %s @ %s:%d",
+      strerror(-ret), __FILE__, __LINE__
+    );
+    *fallback = 1;
+    return SCR_FAILURE;
+  }
+
+  /* allocate and register buffers */
+  int rc = SCR_SUCCESS;
+  scr_uring_slot* slots = (scr_uring_slot*) SCR_MALLOC(depth * sizeof(scr_uring_slot));
+  struct iovec* iovs = (struct iovec*) SCR_MALLOC(depth * sizeof(struct iovec));
+  int i;
+  for (i = 0; i < depth; i++) {
+    slots[i].buf   = (char*) scr_align_malloc(buf_size, (size_t) getpagesize());
+    slots[i].index = i;
+    slots[i].state = SCR_URING_FREE;
+    iovs[i].iov_base = slots[i].buf;
+    iovs[i].iov_len  = buf_size;
+    if (slots[i].buf == NULL) {
+      scr_err("Allocating memory: scr_align_malloc(%lu) @ %s:%d",
+        buf_size, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+  }
+  int fixed = 0;
+  if (rc == SCR_SUCCESS) {
+    fixed = (io_uring_register_buffers(&ring, iovs, (unsigned) depth) == 0);
+  }
+
+  if (crc != NULL) {
+    *crc = crc32(0L, Z_NULL, 0);
+  }
+
+  off_t next_offset = 0;
+  unsigned long next_seq = 0;
+  unsigned long crc_seq  = 0;
+  int inflight = 0;
+  while (1) {
+    /* start reads into free buffers, unless we've hit an error */
+    if (rc == SCR_SUCCESS) {
+      for (i = 0; i < depth && next_offset < size; i++) {
+        scr_uring_slot* slot = &slots[i];
+        if (slot->state == SCR_URING_FREE) {
+          slot->offset = next_offset;
+          slot->len    = (size - next_offset < (off_t) buf_size) ? (size_t) (size - next_offset) : buf_size;
+          slot->done   = 0;
+          slot->seq    = next_seq++;
+          slot->state  = SCR_URING_READING;
+          scr_uring_queue(&ring, slot, src_fd, 0, fixed);
+          next_offset += slot->len;
+          inflight++;
+        }
+      }
+    }
+
+    /* nothing left in flight, so we're done (or we've drained after an error) */
+    if (inflight == 0) {
+      break;
+    }
+
+    /* submit and wait for the next completion */
+    io_uring_submit(&ring);
+    struct io_uring_cqe* cqe;
+    ret = io_uring_wait_cqe(&ring, &cqe);
+    if (ret < 0) {
+      if (ret == -EINTR) {
+        continue;
+      }
+      scr_err("io_uring_wait_cqe failed: %s @ %s:%d",
+        strerror(-ret), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+      break;
+    }
+    scr_uring_slot* slot = (scr_uring_slot*) io_uring_cqe_get_data(cqe);
+    int res = cqe->res;
+    io_uring_cqe_seen(&ring, cqe);
+    inflight--;
+
+    int writing = (slot->state == SCR_URING_WRITING);
+    const char* file = writing ? dst_file : src_file;
+    int fd = writing ? dst_fd : src_fd;
+
+    /* once we've failed, just drain outstanding operations */
+    if (rc != SCR_SUCCESS) {
+      slot->state = SCR_URING_FREE;
+      continue;
+    }
+
+    if (res == -EINTR || res == -EAGAIN) {
+      /* retry the same operation */
+      scr_uring_queue(&ring, slot, fd, writing, fixed);
+      inflight++;
+      continue;
+    }
+    if (res <= 0) {
+      scr_err("Error %s file %s at offset %lu with io_uring: %s @ %s:%d",
+        writing ? "writing" : "reading", file, (unsigned long) (slot->offset + slot->done),
+        (res < 0) ? strerror(-res) : "unexpected end of file", __FILE__, __LINE__
+      );
+      slot->state = SCR_URING_FREE;
+      rc = SCR_FAILURE;
+      continue;
+    }
+
+    /* short read or write, queue up the remainder */
+    slot->done += (size_t) res;
+    if (slot->done < slot->len) {
+      scr_uring_queue(&ring, slot, fd, writing, fixed);
+      inflight++;
+      continue;
+    }
+
+    if (writing) {
+      slot->state = SCR_URING_FREE;
+      continue;
+    }
+
+    /* read completed, compute crc and write blocks in file order */
+    slot->state = SCR_URING_READ;
+    int found = 1;
+    while (found) {
+      found = 0;
+      for (i = 0; i < depth; i++) {
+        scr_uring_slot* s = &slots[i];
+        if (s->state == SCR_URING_READ && s->seq == crc_seq) {
+          if (crc != NULL) {
+            *crc = crc32(*crc, (const Bytef*) s->buf, (uInt) s->len);
+          }
+          if (dst_fd >= 0) {
+            s->done  = 0;
+            s->state = SCR_URING_WRITING;
+            scr_uring_queue(&ring, s, dst_fd, 1, fixed);
+            inflight++;
+          } else {
+            s->state = SCR_URING_FREE;
+          }
+          crc_seq++;
+          found = 1;
+          break;
+        }
+      }
+    }
+  }
+
+  /* free buffers and tear down the ring */
+  if (fixed) {
+    io_uring_unregister_buffers(&ring);
+  }
+  io_uring_queue_exit(&ring);
+  for (i = 0; i < depth; i++) {
+    scr_align_free(&slots[i].buf);
+  }
+  scr_free(&iovs);
+  scr_free(&slots);
+
+  return rc;
+}
+#endif /* HAVE_LIBURING */
+
 /* opens, reads, and computes the crc32 value for the given filename */
 int scr_crc32(const char* filename, uLong* crc)
 {
@@ -782,6 +1166,23 @@ int scr_crc32(const char* filename, uLong* crc)
     return SCR_FAILURE;
   }
 
+#ifdef HAVE_LIBURING
+  /* read the file with many reads in flight if enabled */
+  if (scr_io_uring_depth > 0) {
+    struct stat stat_buf;
+    if (fstat(fd, &stat_buf) == 0) {
+      int fallback;
+      int uring_rc = scr_uring_stream(filename, fd, NULL, -1, stat_buf.st_size,
+        1024*1024, scr_io_uring_depth, crc, &fallback
+      );
+      if (! fallback) {
+        scr_close(filename, fd);
+        return uring_rc;
+      }
+    }
+  }
+#endif
+
   /* read the file data in and compute its crc32 */
   int nread = 0;
   unsigned long buffer_size = 1024*1024;
@@ -808,113 +1209,897 @@ int scr_crc32(const char* filename, uLong* crc)
   return SCR_SUCCESS;
 }
 
-/*
-=========================================
-Directory functions
-=========================================
-*/
-
-/* recursively create directory and subdirectories */
-int scr_mkdir(const char* dir, mode_t mode)
+/* range of a file to compute a partial crc over in a helper thread */
+typedef struct {
+  const char* file; /* name of file */
+  int fd;           /* open file descriptor shared by all threads */
+  off_t offset;     /* starting offset of range */
+  off_t length;     /* number of bytes in range */
+  uLong crc;        /* crc32 of the range */
+  int rc;           /* SCR_SUCCESS if range was read without error */
+  int node;         /* NUMA node to place buffer on, -1 for none */
+} scr_crc32_range;
+
+/* compute crc32 over one range of a file with pread */
+static void* scr_crc32_range_thread(void* arg)
 {
-  /* consider it a success if we either create the directory
-   * or we fail because it already exists */
-  int tmp_rc = mkdir(dir, mode);
-  if (tmp_rc == 0 || errno == EEXIST) {
-    return SCR_SUCCESS;
-  }
-
-  /* failed to create the directory,
-   * we'll check the parent dir and try again */
-  int rc = SCR_SUCCESS;
-
-  /* With dirname, either the original string may be modified or the function may return a
-   * pointer to static storage which will be overwritten by the next call to dirname,
-   * so we need to strdup both the argument and the return string. */
+  scr_crc32_range* r = (scr_crc32_range*) arg;
 
-  /* extract leading path from dir = full path - basename */
-  char* dircopy = strdup(dir);
-  char* path    = strdup(dirname(dircopy));
+  r->crc = crc32(0L, Z_NULL, 0);
+  r->rc  = SCR_SUCCESS;
 
-  /* if we can read path or path=="." or path=="/", then there's nothing to do,
-   * otherwise, try to create it */
-  if (access(path, R_OK) < 0 &&
-      strcmp(path,".") != 0  &&
-      strcmp(path,"/") != 0)
-  {
-    rc = scr_mkdir(path, mode);
+  size_t buffer_size = 1024*1024;
+  char* buf = (char*) scr_numa_alloc(buffer_size, r->node);
+  if (buf == NULL) {
+    r->rc = SCR_FAILURE;
+    return NULL;
   }
 
-  /* if we can write to path, try to create subdir within path */
-  if (access(path, W_OK) == 0 && rc == SCR_SUCCESS) {
-    tmp_rc = mkdir(dir, mode);
-    if (tmp_rc < 0) {
-      if (errno == EEXIST) {
-        /* don't complain about mkdir for a directory that already exists */
-        scr_free(&dircopy);
-        scr_free(&path);
-        return SCR_SUCCESS;
-      } else {
-        scr_err("Creating directory: mkdir(%s, %x) path=%s errno=%d %s @ %s:%d",
-          dir, mode, path, errno, strerror(errno), __FILE__, __LINE__
-        );
-        rc = SCR_FAILURE;
-      }
+  off_t offset = r->offset;
+  off_t remaining = r->length;
+  while (remaining > 0) {
+    size_t count = (remaining < (off_t) buffer_size) ? (size_t) remaining : buffer_size;
+    ssize_t nread = pread(r->fd, buf, count, offset);
+    if (nread < 0 && (errno == EINTR || errno == EAGAIN)) {
+      continue;
     }
-  } else {
-    scr_err("Cannot write to directory: %s @ %s:%d",
-      path, __FILE__, __LINE__
-    );
-    rc = SCR_FAILURE;
+    if (nread <= 0) {
+      /* hit an error or the file was truncated from under us */
+      scr_dbg(1, "Error reading file to compute crc: %s errno=%d %s @ %s:%d",
+        r->file, errno, strerror(errno), __FILE__, __LINE__
+      );
+      r->rc = SCR_FAILURE;
+      break;
+    }
+    r->crc = crc32(r->crc, (const Bytef*) buf, (uInt) nread);
+    offset    += nread;
+    remaining -= nread;
   }
 
-  /* free our dup'ed string and return error code */
-  scr_free(&dircopy);
+  scr_free(&buf);
+  return NULL;
+}
+
+/* entry point of a helper thread, which runs on the node of its buffer */
+static void* scr_crc32_range_start(void* arg)
+{
+  scr_crc32_range* r = (scr_crc32_range*) arg;
+  scr_numa_bind_thread(r->node);
+  return scr_crc32_range_thread(arg);
+}
+
+/* same as scr_crc32, but splits the file into ranges which are read
+ * with pread and checksummed by up to threads threads, the partial
+ * values are merged with crc32_combine64, so the result is identical to
+ * scr_crc32, files smaller than min_size are processed serially */
+int scr_crc32_parallel(const char* filename, int threads, unsigned long min_size, uLong* crc)
+{
+  /* check that we got a variable to write our answer to */
+  if (crc == NULL) {
+    return SCR_FAILURE;
+  }
+
+  /* fall back to the serial version for small files */
+  unsigned long size = scr_file_size(filename);
+  if (threads < 2 || size < min_size) {
+    return scr_crc32(filename, crc);
+  }
+
+  /* open the file for reading */
+  int fd = scr_open(filename, O_RDONLY);
+  if (fd < 0) {
+    scr_dbg(1, "Failed to open file to compute crc: %s errno=%d @ %s:%d",
+      filename, errno, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* divide file into ranges, keep range boundaries on 1MB multiples */
+  off_t chunk = (off_t) ((size / threads + (1024*1024 - 1)) / (1024*1024)) * (1024*1024);
+  scr_crc32_range* ranges = (scr_crc32_range*) SCR_MALLOC(threads * sizeof(scr_crc32_range));
+  pthread_t* tids = (pthread_t*) SCR_MALLOC(threads * sizeof(pthread_t));
+  int* started = (int*) SCR_MALLOC(threads * sizeof(int));
+
+  /* read into buffers on the node registered for the file's store */
+  int node = scr_numa_node_of_file(filename);
+
+  int i;
+  off_t offset = 0;
+  for (i = 0; i < threads; i++) {
+    /* last range picks up whatever is left */
+    off_t length = (i < threads - 1 && offset + chunk <= (off_t) size) ? chunk : ((off_t) size - offset);
+    if (length < 0) {
+      length = 0;
+    }
+    ranges[i].file   = filename;
+    ranges[i].fd     = fd;
+    ranges[i].offset = offset;
+    ranges[i].length = length;
+    ranges[i].crc    = crc32(0L, Z_NULL, 0);
+    ranges[i].rc     = SCR_SUCCESS;
+    ranges[i].node   = node;
+    offset += length;
+
+    /* compute range in this thread if we fail to start a new one */
+    started[i] = 0;
+    if (length > 0) {
+      if (pthread_create(&tids[i], NULL, scr_crc32_range_start, &ranges[i]) == 0) {
+        started[i] = 1;
+      } else {
+        scr_crc32_range_thread(&ranges[i]);
+      }
+    }
+  }
+
+  /* wait for threads and merge values in file order */
+  int rc = SCR_SUCCESS;
+  *crc = crc32(0L, Z_NULL, 0);
+  for (i = 0; i < threads; i++) {
+    if (started[i]) {
+      pthread_join(tids[i], NULL);
+    }
+    if (ranges[i].rc != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+    if (ranges[i].length > 0) {
+      *crc = crc32_combine64(*crc, ranges[i].crc, (z_off64_t) ranges[i].length);
+    }
+  }
+
+  scr_free(&started);
+  scr_free(&tids);
+  scr_free(&ranges);
+
+  /* close the file */
+  scr_close(filename, fd);
+
+  return rc;
+}
+
+/* open file with O_DIRECT, falls back to a normal open if O_DIRECT
+ * is not supported on this system or by the underlying file system */
+static int scr_open_direct(const char* file, int flags, mode_t mode)
+{
+#ifdef O_DIRECT
+  int fd = open(file, flags | O_DIRECT, mode);
+  if (fd >= 0) {
+    return fd;
+  }
+  scr_dbg(2, "Failed to open file with O_DIRECT, using buffered I/O: %s errno=%d %s @ %s:%d",
+    file, errno, strerror(errno), __FILE__, __LINE__
+  );
+#endif
+  return scr_open(file, flags, mode);
+}
+
+/* clear O_DIRECT on an open file descriptor,
+ * needed before writing a partial block at the end of a file */
+static void scr_clear_direct(const char* file, int fd)
+{
+#ifdef O_DIRECT
+  int flags = fcntl(fd, F_GETFL);
+  if (flags != -1 && (flags & O_DIRECT)) {
+    if (fcntl(fd, F_SETFL, flags & ~O_DIRECT) != 0) {
+      scr_dbg(1, "Failed to clear O_DIRECT on file: %s errno=%d %s @ %s:%d",
+        file, errno, strerror(errno), __FILE__, __LINE__
+      );
+    }
+  }
+#endif
+}
+
+/* round size up to the next multiple of align */
+static size_t scr_align_size(size_t size, size_t align)
+{
+  if (align == 0) {
+    return size;
+  }
+  return ((size + align - 1) / align) * align;
+}
+
+/* same as scr_crc32, but reads the file with O_DIRECT into a buffer
+ * aligned to align bytes to avoid polluting the page cache */
+int scr_crc32_direct(const char* filename, size_t align, uLong* crc)
+{
+  /* check that we got a variable to write our answer to */
+  if (crc == NULL) {
+    return SCR_FAILURE;
+  }
+
+  /* initialize our crc value */
+  *crc = crc32(0L, Z_NULL, 0);
+
+  /* open the file for reading */
+  int fd = scr_open_direct(filename, O_RDONLY, 0);
+  if (fd < 0) {
+    scr_dbg(1, "Failed to open file to compute crc: %s errno=%d @ %s:%d",
+      filename, errno, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* allocate an aligned buffer to read the file */
+  size_t buffer_size = scr_align_size(1024*1024, align);
+  char* buf = (char*) scr_align_malloc(buffer_size, align);
+  if (buf == NULL) {
+    scr_err("Allocating memory: scr_align_malloc(%lu, %lu) @ %s:%d",
+      (unsigned long) buffer_size, (unsigned long) align, __FILE__, __LINE__
+    );
+    close(fd);
+    return SCR_FAILURE;
+  }
+
+  /* read the file data in and compute its crc32 */
+  ssize_t nread = 0;
+  do {
+    nread = scr_read_attempt(filename, fd, buf, buffer_size);
+    if (nread > 0) {
+      *crc = crc32(*crc, (const Bytef*) buf, (uInt) nread);
+    }
+  } while (nread == buffer_size);
+
+  scr_align_free(&buf);
+
+  /* if we got an error, don't print anything and bailout */
+  if (nread < 0) {
+    scr_dbg(1, "Error while reading file to compute crc: %s @ %s:%d",
+      filename, __FILE__, __LINE__
+    );
+    close(fd);
+    return SCR_FAILURE;
+  }
+
+  /* close the file */
+  scr_close(filename, fd);
+
+  return SCR_SUCCESS;
+}
+
+/*
+=========================================
+Directory functions
+=========================================
+*/
+
+/* recursively create directory and subdirectories */
+int scr_mkdir(const char* dir, mode_t mode)
+{
+  /* consider it a success if we either create the directory
+   * or we fail because it already exists */
+  int tmp_rc = mkdir(dir, mode);
+  if (tmp_rc == 0 || errno == EEXIST) {
+    return SCR_SUCCESS;
+  }
+
+  /* failed to create the directory,
+   * we'll check the parent dir and try again */
+  int rc = SCR_SUCCESS;
+
+  /* With dirname, either the original string may be modified or the function may return a
+   * pointer to static storage which will be overwritten by the next call to dirname,
+   * so we need to strdup both the argument and the return string. */
+
+  /* extract leading path from dir = full path - basename */
+  char* dircopy = strdup(dir);
+  char* path    = strdup(dirname(dircopy));
+
+  /* if we can read path or path=="." or path=="/", then there's nothing to do,
+   * otherwise, try to create it */
+  if (access(path, R_OK) < 0 &&
+      strcmp(path,".") != 0  &&
+      strcmp(path,"/") != 0)
+  {
+    rc = scr_mkdir(path, mode);
+  }
+
+  /* if we can write to path, try to create subdir within path */
+  if (access(path, W_OK) == 0 && rc == SCR_SUCCESS) {
+    tmp_rc = mkdir(dir, mode);
+    if (tmp_rc < 0) {
+      if (errno == EEXIST) {
+        /* don't complain about mkdir for a directory that already exists */
+        scr_free(&dircopy);
+        scr_free(&path);
+        return SCR_SUCCESS;
+      } else {
+        scr_err("Creating directory: mkdir(%s, %x) path=%s errno=%d %s @ %s:%d",
+          dir, mode, path, errno, strerror(errno), __FILE__, __LINE__
+        );
+        rc = SCR_FAILURE;
+      }
+    }
+  } else {
+    scr_err("Cannot write to directory: %s @ %s:%d",
+      path, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  /* free our dup'ed string and return error code */
+  scr_free(&dircopy);
   scr_free(&path);
   return rc;
 }
 
-/* remove directory */
-int scr_rmdir(const char* dir)
+/* remove directory */
+int scr_rmdir(const char* dir)
+{
+  /* delete directory */
+  int rc = rmdir(dir);
+  if (rc < 0) {
+    /* whoops, something failed when we tried to delete our directory */
+    scr_err("Error deleting directory: %s (rmdir returned %d %s) @ %s:%d",
+      dir, rc, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
+
+/* write current working directory to buf */
+int scr_getcwd(char* buf, size_t size)
+{
+  int rc = SCR_SUCCESS;
+  if (getcwd(buf, size) == NULL) {
+    scr_abort(-1, "Problem reading current working directory (getcwd() errno=%d %s) @ %s:%d",
+              errno, strerror(errno), __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+  return rc;
+}
+
+/*
+=========================================
+File Copy Functions
+=========================================
+*/
+
+/* compute crc32 of the first size bytes of an open file by mapping it
+ * into memory, so the data is not copied through a user-space buffer */
+static int scr_crc32_mmap(const char* file, int fd, off_t size, uLong* crc)
+{
+  *crc = crc32(0L, Z_NULL, 0);
+  if (size == 0) {
+    return SCR_SUCCESS;
+  }
+
+  void* addr = mmap(NULL, (size_t) size, PROT_READ, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    scr_dbg(2, "Failed to mmap file to compute crc: %s errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+#if !defined(__APPLE__)
+  posix_madvise(addr, (size_t) size, POSIX_MADV_SEQUENTIAL);
+#endif
+
+  /* crc32 takes a uInt length, so process the map in chunks */
+  const Bytef* ptr = (const Bytef*) addr;
+  off_t remaining = size;
+  while (remaining > 0) {
+    uInt count = (remaining > (off_t) (1024*1024*1024)) ? (1024*1024*1024) : (uInt) remaining;
+    *crc = crc32(*crc, ptr, count);
+    ptr       += count;
+    remaining -= count;
+  }
+
+  munmap(addr, (size_t) size);
+
+  return SCR_SUCCESS;
+}
+
+/* compute crc of the source once the kernel has copied it, so a copy
+ * that falls back to reading the file does not read it twice, the
+ * copy is done at this point, so a failure here is not a fallback */
+static int scr_file_copy_kernel_crc(const char* src_file, int src_fd, off_t size, uLong* crc, int* fallback)
+{
+  if (crc == NULL) {
+    return SCR_SUCCESS;
+  }
+  if (scr_crc32_mmap(src_file, src_fd, size, crc) == SCR_SUCCESS ||
+      scr_crc32(src_file, crc) == SCR_SUCCESS)
+  {
+    return SCR_SUCCESS;
+  }
+  *fallback = 0;
+  return SCR_FAILURE;
+}
+
+/* attempt to have the kernel copy the contents of src_fd to dst_fd,
+ * tries a reflink clone, then copy_file_range, then sendfile,
+ * returns SCR_SUCCESS if one of them copied the whole file, otherwise
+ * both files are rewound and the destination truncated and fallback is
+ * set to 1 so the caller can use a read/write loop, fallback is 0 on
+ * a hard error where the files could not be reset */
+static int scr_file_copy_kernel(
+  const char* src_file,
+  int src_fd,
+  const char* dst_file,
+  int dst_fd,
+  uLong* crc,
+  int* fallback)
+{
+  *fallback = 1;
+
+  /* get size of source file */
+  struct stat stat_buf;
+  if (fstat(src_fd, &stat_buf) != 0 || !S_ISREG(stat_buf.st_mode)) {
+    return SCR_FAILURE;
+  }
+  off_t size = stat_buf.st_size;
+
+#if defined(HAVE_LINUX_FS_H) && defined(FICLONE)
+  /* share the source extents if the file system supports it */
+  if (ioctl(dst_fd, FICLONE, src_fd) == 0) {
+    scr_dbg(2, "Cloned file %s to %s", src_file, dst_file);
+    return scr_file_copy_kernel_crc(src_file, src_fd, size, crc, fallback);
+  }
+#endif
+
+  off_t copied = 0;
+
+#ifdef HAVE_COPY_FILE_RANGE
+  /* copy within the kernel, which may offload to the storage */
+  while (copied < size) {
+    ssize_t n = copy_file_range(src_fd, NULL, dst_fd, NULL, (size_t) (size - copied), 0);
+    if (n <= 0) {
+      break;
+    }
+    copied += n;
+  }
+  if (copied == size) {
+    scr_dbg(2, "Copied file %s to %s with copy_file_range", src_file, dst_file);
+    return scr_file_copy_kernel_crc(src_file, src_fd, size, crc, fallback);
+  }
+#endif
+
+#ifdef HAVE_SYS_SENDFILE_H
+  /* pick up where copy_file_range left off, if anywhere */
+  while (copied < size) {
+    ssize_t n = sendfile(dst_fd, src_fd, NULL, (size_t) (size - copied));
+    if (n <= 0) {
+      break;
+    }
+    copied += n;
+  }
+  if (copied == size) {
+    scr_dbg(2, "Copied file %s to %s with sendfile", src_file, dst_file);
+    return scr_file_copy_kernel_crc(src_file, src_fd, size, crc, fallback);
+  }
+#endif
+
+  /* failed to copy the whole file, undo any partial copy */
+  if (copied > 0) {
+    if (lseek(src_fd, 0, SEEK_SET) != 0 ||
+        lseek(dst_fd, 0, SEEK_SET) != 0 ||
+        ftruncate(dst_fd, 0) != 0)
+    {
+      scr_err("Failed to reset files after partial copy of %s to %s errno=%d %s @ %s:%d",
+        src_file, dst_file, errno, strerror(errno), __FILE__, __LINE__
+      );
+      *fallback = 0;
+    }
+  }
+  return SCR_FAILURE;
+}
+
+/* returns 1 if file has fewer blocks allocated than its size implies */
+int scr_file_is_sparse(const char* file)
+{
+  struct stat stat_buf;
+  if (stat(file, &stat_buf) != 0 || !S_ISREG(stat_buf.st_mode)) {
+    return 0;
+  }
+  return ((off_t) stat_buf.st_blocks * 512 < stat_buf.st_size);
+}
+
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+/* extend crc as if len zero bytes were appended to the data,
+ * builds up crc of runs of 2^k zero bytes rather than reading zeros */
+static uLong scr_crc32_zeros(uLong crc, off_t len)
+{
+  uLong zeros = crc32(0L, (const Bytef*) "", 1);
+  z_off64_t run = 1;
+  while (len > 0) {
+    if (len & 1) {
+      crc = crc32_combine64(crc, zeros, run);
+    }
+    len >>= 1;
+    if (len > 0) {
+      zeros = crc32_combine64(zeros, zeros, run);
+      run <<= 1;
+    }
+  }
+  return crc;
+}
+
+/* copy only the data regions of a sparse file, leaving holes in the
+ * destination where the source has them, crc covers the zeros in holes,
+ * sets fallback if the file system can't report holes and nothing was
+ * written, in which case the caller should copy the file normally */
+static int scr_file_copy_sparse(
+  const char* src_file,
+  int src_fd,
+  const char* dst_file,
+  int dst_fd,
+  unsigned long buf_size,
+  uLong* crc,
+  int* fallback)
+{
+  *fallback = 1;
+
+  /* only bother if fewer blocks are allocated than the size implies */
+  struct stat stat_buf;
+  if (fstat(src_fd, &stat_buf) != 0 || !S_ISREG(stat_buf.st_mode) ||
+      (off_t) stat_buf.st_blocks * 512 >= stat_buf.st_size)
+  {
+    return SCR_FAILURE;
+  }
+  off_t size = stat_buf.st_size;
+
+  /* check that we can find data in this file before we write anything,
+   * say once if we can't, since its holes will be written out as zeros */
+  off_t data = lseek(src_fd, 0, SEEK_DATA);
+  if (data < 0 && errno != ENXIO) {
+    static int warned = 0;
+    if (! warned) {
+      scr_warn("File system can't report holes in %s, copying sparse files in full: errno=%d %s @ %s:%d",
+        src_file, errno, strerror(errno), __FILE__, __LINE__
+      );
+      warned = 1;
+    }
+    return SCR_FAILURE;
+  }
+
+  char* buf = (char*) malloc(buf_size);
+  if (buf == NULL) {
+    return SCR_FAILURE;
+  }
+  *fallback = 0;
+
+  if (crc != NULL) {
+    *crc = crc32(0L, Z_NULL, 0);
+  }
+
+  int rc = SCR_SUCCESS;
+  off_t pos   = 0;
+  off_t moved = 0;
+  while (pos < size) {
+    /* a file that ends in a hole reports ENXIO */
+    if (data < 0) {
+      data = size;
+    }
+    if (data > size) {
+      data = size;
+    }
+
+    /* account for zeros in the hole we skip over */
+    if (crc != NULL) {
+      *crc = scr_crc32_zeros(*crc, data - pos);
+    }
+    pos = data;
+    if (pos >= size) {
+      break;
+    }
+
+    /* find end of this data region */
+    off_t hole = lseek(src_fd, pos, SEEK_HOLE);
+    if (hole < 0) {
+      rc = SCR_FAILURE;
+      break;
+    }
+    if (hole > size) {
+      hole = size;
+    }
+
+    /* copy the data region */
+    while (pos < hole) {
+      size_t count = (size_t) (hole - pos);
+      if (count > buf_size) {
+        count = buf_size;
+      }
+      ssize_t nread = scr_pread_attempt(src_file, src_fd, buf, count, pos);
+      if (nread <= 0) {
+        rc = SCR_FAILURE;
+        break;
+      }
+      if (crc != NULL) {
+        *crc = crc32(*crc, (const Bytef*) buf, (uInt) nread);
+      }
+      if (scr_pwrite_attempt(dst_file, dst_fd, buf, (size_t) nread, pos) != nread) {
+        rc = SCR_FAILURE;
+        break;
+      }
+      pos   += nread;
+      moved += nread;
+    }
+    if (rc != SCR_SUCCESS) {
+      break;
+    }
+
+    /* look for the next data region */
+    data = lseek(src_fd, pos, SEEK_DATA);
+    if (data < 0 && errno != ENXIO) {
+      rc = SCR_FAILURE;
+      break;
+    }
+  }
+
+  scr_free(&buf);
+
+  /* extend destination over any trailing hole */
+  if (rc == SCR_SUCCESS && ftruncate(dst_fd, size) != 0) {
+    scr_err("Failed to set size of %s to %lu errno=%d %s @ %s:%d",
+      dst_file, (unsigned long) size, errno, strerror(errno), __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  if (rc == SCR_SUCCESS) {
+    scr_dbg(2, "Sparse copy of %s to %s moved %lu of %lu bytes",
+      src_file, dst_file, (unsigned long) moved, (unsigned long) size
+    );
+  }
+
+  return rc;
+}
+#endif
+
+/* TODO: could apply compression/decompression here */
+/* copy src_file (full path) to dest_path and return new full path in dest_file */
+static int scr_file_copy_data(
+  const char* src_file,
+  const char* dst_file,
+  unsigned long buf_size,
+  uLong* crc)
+{
+  /* check that we got something for a source file */
+  if (src_file == NULL || strcmp(src_file, "") == 0) {
+    scr_err("Invalid source file @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* check that we got something for a destination file */
+  if (dst_file == NULL || strcmp(dst_file, "") == 0) {
+    scr_err("Invalid destination file @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  int rc = SCR_SUCCESS;
+
+#ifdef HAVE_LIBCPPR
+  cppr_return_t cppr_retval = _scr_cppr_file_copy(
+    src_file, dst_file, buf_size, crc
+  );
+
+  if (cppr_retval == CPPR_SUCCESS) {
+    scr_dbg(2,"#bold file %s copied successfully using CPPR @ %s:%d",
+      dst_file, __FILE__, __LINE__
+    );
+    return SCR_SUCCESS;
+  } else {
+    scr_dbg(2,"Couldn't move file with cppr, attempting move without \
+cppr cppr_err=%d @ %s:%d", cppr_retval, __FILE__, __LINE__
+    );
+  }
+#endif /* HAVE_LIBCPPR */
+
+  /* open src_file for reading */
+  int src_fd = scr_open(src_file, O_RDONLY);
+  if (src_fd < 0) {
+    scr_err("Opening file to copy: scr_open(%s) errno=%d %s @ %s:%d",
+      src_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* open dest_file for writing */
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int dst_fd = scr_open(dst_file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (dst_fd < 0) {
+    scr_err("Opening file for writing: scr_open(%s) errno=%d %s @ %s:%d",
+      dst_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_close(src_file, src_fd);
+    return SCR_FAILURE;
+  }
+
+#if !defined(__APPLE__)
+  /* TODO:
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED | POSIX_FADV_SEQUENTIAL)
+  that tells the kernel that you don't ever need the pages
+  from the file again, and it won't bother keeping them in the page cache.
+  */
+  posix_fadvise(src_fd, 0, 0, POSIX_FADV_DONTNEED | POSIX_FADV_SEQUENTIAL);
+  posix_fadvise(dst_fd, 0, 0, POSIX_FADV_DONTNEED | POSIX_FADV_SEQUENTIAL);
+#endif
+
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+  /* skip over holes rather than writing them out as zeros */
+  int sparse_fallback;
+  rc = scr_file_copy_sparse(src_file, src_fd, dst_file, dst_fd, buf_size, crc, &sparse_fallback);
+  if (! sparse_fallback) {
+    if (scr_close(dst_file, dst_fd) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+    if (scr_close(src_file, src_fd) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+    if (rc != SCR_SUCCESS) {
+      unlink(dst_file);
+    }
+    return rc;
+  }
+  rc = SCR_SUCCESS;
+#endif
+
+#ifdef HAVE_LIBURING
+  /* keep many reads and writes in flight if enabled, this is tried
+   * ahead of the kernel copy, since asking for a queue depth means the
+   * caller wants the copy to go through io_uring */
+  if (scr_io_uring_depth > 0) {
+    struct stat stat_buf;
+    if (fstat(src_fd, &stat_buf) == 0) {
+      int fallback;
+      rc = scr_uring_stream(src_file, src_fd, dst_file, dst_fd, stat_buf.st_size,
+        buf_size, scr_io_uring_depth, crc, &fallback
+      );
+      if (! fallback) {
+        if (scr_close(dst_file, dst_fd) != SCR_SUCCESS) {
+          rc = SCR_FAILURE;
+        }
+        if (scr_close(src_file, src_fd) != SCR_SUCCESS) {
+          rc = SCR_FAILURE;
+        }
+        if (rc != SCR_SUCCESS) {
+          unlink(dst_file);
+        }
+        return rc;
+      }
+      rc = SCR_SUCCESS;
+    }
+  }
+#endif
+
+  /* let the kernel copy the data if it can, a partial copy we could
+   * not undo leaves the destination in an unknown state, so give up */
+  int kernel_fallback;
+  rc = scr_file_copy_kernel(src_file, src_fd, dst_file, dst_fd, crc, &kernel_fallback);
+  if (rc == SCR_SUCCESS || ! kernel_fallback) {
+    if (scr_close(dst_file, dst_fd) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+    if (scr_close(src_file, src_fd) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+    if (rc != SCR_SUCCESS) {
+      unlink(dst_file);
+    }
+    return rc;
+  }
+  rc = SCR_SUCCESS;
+
+  /* allocate buffer to read in file chunks, on the node of the
+   * store we write to or else the one we read from */
+  int node = scr_numa_node_of_file(dst_file);
+  if (node < 0) {
+    node = scr_numa_node_of_file(src_file);
+  }
+  char* buf = (char*) scr_numa_alloc(buf_size, node);
+  if (buf == NULL) {
+    scr_err("Allocating memory: malloc(%llu) errno=%d %s @ %s:%d",
+      buf_size, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_close(dst_file, dst_fd);
+    scr_close(src_file, src_fd);
+    return SCR_FAILURE;
+  }
+
+  /* initialize crc values */
+  if (crc != NULL) {
+    *crc = crc32(0L, Z_NULL, 0);
+  }
+
+  /* write chunks */
+  int copying = 1;
+  while (copying) {
+    /* attempt to read buf_size bytes from file */
+    int nread = scr_read_attempt(src_file, src_fd, buf, buf_size);
+
+    /* if we read some bytes, write them out */
+    if (nread > 0) {
+      /* optionally compute crc value as we go */
+      if (crc != NULL) {
+        *crc = crc32(*crc, (const Bytef*) buf, (uInt) nread);
+      }
+
+      /* write our nread bytes out */
+      int nwrite = scr_write_attempt(dst_file, dst_fd, buf, nread);
+
+      /* check for a write error or a short write */
+      if (nwrite != nread) {
+        /* write had a problem, stop copying and return an error */
+        copying = 0;
+        rc = SCR_FAILURE;
+      }
+    }
+
+    /* assume a short read means we hit the end of the file */
+    if (nread < buf_size) {
+      copying = 0;
+    }
+
+    /* check for a read error, stop copying and return an error */
+    if (nread < 0) {
+      /* read had a problem, stop copying and return an error */
+      copying = 0;
+      rc = SCR_FAILURE;
+    }
+  }
+
+  /* free buffer */
+  scr_free(&buf);
+
+  /* close source and destination files */
+  if (scr_close(dst_file, dst_fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  if (scr_close(src_file, src_fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+
+  /* unlink the file if the copy failed */
+  if (rc != SCR_SUCCESS) {
+    unlink(dst_file);
+  }
+#ifdef HAVE_LIBCPPR
+  else {
+    scr_err("File moved successfully without CPPR, WHAT HAPPENED??\
+ @ %s:%d", __FILE__, __LINE__
+    );
+  }
+#endif
+
+  return rc;
+}
+
+/* report a successful copy to scr_io_copy_hook */
+static void scr_io_copy_record(const char* dst_file, double start)
 {
-  /* delete directory */
-  int rc = rmdir(dir);
-  if (rc < 0) {
-    /* whoops, something failed when we tried to delete our directory */
-    scr_err("Error deleting directory: %s (rmdir returned %d %s) @ %s:%d",
-      dir, rc, strerror(errno), __FILE__, __LINE__
-    );
-    return SCR_FAILURE;
+  if (scr_io_copy_hook != NULL) {
+    scr_io_copy_hook((double) scr_file_size(dst_file), scr_seconds() - start);
   }
-  return SCR_SUCCESS;
 }
 
-/* write current working directory to buf */
-int scr_getcwd(char* buf, size_t size)
+int scr_file_copy(
+  const char* src_file,
+  const char* dst_file,
+  unsigned long buf_size,
+  uLong* crc)
 {
-  int rc = SCR_SUCCESS;
-  if (getcwd(buf, size) == NULL) {
-    scr_abort(-1, "Problem reading current working directory (getcwd() errno=%d %s) @ %s:%d",
-              errno, strerror(errno), __FILE__, __LINE__
-    );
-    rc = SCR_FAILURE;
+  double start = scr_seconds();
+  int rc = scr_file_copy_data(src_file, dst_file, buf_size, crc);
+  if (rc == SCR_SUCCESS) {
+    scr_io_copy_record(dst_file, start);
   }
   return rc;
 }
 
-/*
-=========================================
-File Copy Functions
-=========================================
-*/
-
-/* TODO: could perhaps use O_DIRECT here as an optimization */
-/* TODO: could apply compression/decompression here */
-/* copy src_file (full path) to dest_path and return new full path in dest_file */
-int scr_file_copy(
+/* same as scr_file_copy, but reads and writes with O_DIRECT using a
+ * buffer aligned to align bytes, a partial block at the end of the
+ * file is written after dropping O_DIRECT on the destination */
+static int scr_file_copy_direct_data(
   const char* src_file,
   const char* dst_file,
   unsigned long buf_size,
+  size_t align,
   uLong* crc)
 {
   /* check that we got something for a source file */
@@ -935,25 +2120,8 @@ int scr_file_copy(
 
   int rc = SCR_SUCCESS;
 
-#ifdef HAVE_LIBCPPR
-  cppr_return_t cppr_retval = _scr_cppr_file_copy(
-    src_file, dst_file, buf_size, crc
-  );
-
-  if (cppr_retval == CPPR_SUCCESS) {
-    scr_dbg(2,"#bold file %s copied successfully using CPPR @ %s:%d",
-      dst_file, __FILE__, __LINE__
-    );
-    return SCR_SUCCESS;
-  } else {
-    scr_dbg(2,"Couldn't move file with cppr, attempting move without \
-cppr cppr_err=%d @ %s:%d", cppr_retval, __FILE__, __LINE__
-    );
-  }
-#endif /* HAVE_LIBCPPR */
-
   /* open src_file for reading */
-  int src_fd = scr_open(src_file, O_RDONLY);
+  int src_fd = scr_open_direct(src_file, O_RDONLY, 0);
   if (src_fd < 0) {
     scr_err("Opening file to copy: scr_open(%s) errno=%d %s @ %s:%d",
       src_file, errno, strerror(errno), __FILE__, __LINE__
@@ -963,7 +2131,7 @@ cppr cppr_err=%d @ %s:%d", cppr_retval, __FILE__, __LINE__
 
   /* open dest_file for writing */
   mode_t mode_file = scr_getmode(1, 1, 0);
-  int dst_fd = scr_open(dst_file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  int dst_fd = scr_open_direct(dst_file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
   if (dst_fd < 0) {
     scr_err("Opening file for writing: scr_open(%s) errno=%d %s @ %s:%d",
       dst_file, errno, strerror(errno), __FILE__, __LINE__
@@ -972,21 +2140,14 @@ cppr cppr_err=%d @ %s:%d", cppr_retval, __FILE__, __LINE__
     return SCR_FAILURE;
   }
 
-#if !defined(__APPLE__)
-  /* TODO:
-  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED | POSIX_FADV_SEQUENTIAL)
-  that tells the kernel that you don't ever need the pages
-  from the file again, and it won't bother keeping them in the page cache.
-  */
-  posix_fadvise(src_fd, 0, 0, POSIX_FADV_DONTNEED | POSIX_FADV_SEQUENTIAL);
-  posix_fadvise(dst_fd, 0, 0, POSIX_FADV_DONTNEED | POSIX_FADV_SEQUENTIAL);
-#endif
+  /* O_DIRECT requires transfer sizes to be a multiple of the alignment */
+  size_t bufsize = scr_align_size((size_t) buf_size, align);
 
-  /* allocate buffer to read in file chunks */
-  char* buf = (char*) malloc(buf_size);
+  /* allocate aligned buffer to read in file chunks */
+  char* buf = (char*) scr_align_malloc(bufsize, align);
   if (buf == NULL) {
-    scr_err("Allocating memory: malloc(%llu) errno=%d %s @ %s:%d",
-      buf_size, errno, strerror(errno), __FILE__, __LINE__
+    scr_err("Allocating memory: scr_align_malloc(%lu, %lu) @ %s:%d",
+      (unsigned long) bufsize, (unsigned long) align, __FILE__, __LINE__
     );
     scr_close(dst_file, dst_fd);
     scr_close(src_file, src_fd);
@@ -1001,8 +2162,8 @@ cppr cppr_err=%d @ %s:%d", cppr_retval, __FILE__, __LINE__
   /* write chunks */
   int copying = 1;
   while (copying) {
-    /* attempt to read buf_size bytes from file */
-    int nread = scr_read_attempt(src_file, src_fd, buf, buf_size);
+    /* attempt to read bufsize bytes from file */
+    ssize_t nread = scr_read_attempt(src_file, src_fd, buf, bufsize);
 
     /* if we read some bytes, write them out */
     if (nread > 0) {
@@ -1011,8 +2172,14 @@ cppr cppr_err=%d @ %s:%d", cppr_retval, __FILE__, __LINE__
         *crc = crc32(*crc, (const Bytef*) buf, (uInt) nread);
       }
 
+      /* the last block may be a partial block, which we can't
+       * write with O_DIRECT, so fall back to buffered I/O for it */
+      if (align > 0 && (nread % align) != 0) {
+        scr_clear_direct(dst_file, dst_fd);
+      }
+
       /* write our nread bytes out */
-      int nwrite = scr_write_attempt(dst_file, dst_fd, buf, nread);
+      ssize_t nwrite = scr_write_attempt(dst_file, dst_fd, buf, nread);
 
       /* check for a write error or a short write */
       if (nwrite != nread) {
@@ -1023,7 +2190,7 @@ cppr cppr_err=%d @ %s:%d", cppr_retval, __FILE__, __LINE__
     }
 
     /* assume a short read means we hit the end of the file */
-    if (nread < buf_size) {
+    if (nread < bufsize) {
       copying = 0;
     }
 
@@ -1036,7 +2203,7 @@ cppr cppr_err=%d @ %s:%d", cppr_retval, __FILE__, __LINE__
   }
 
   /* free buffer */
-  scr_free(&buf);
+  scr_align_free(&buf);
 
   /* close source and destination files */
   if (scr_close(dst_file, dst_fd) != SCR_SUCCESS) {
@@ -1050,14 +2217,362 @@ cppr cppr_err=%d @ %s:%d", cppr_retval, __FILE__, __LINE__
   if (rc != SCR_SUCCESS) {
     unlink(dst_file);
   }
-#ifdef HAVE_LIBCPPR
-  else {
-    scr_err("File moved successfully without CPPR, WHAT HAPPENED??\
- @ %s:%d", __FILE__, __LINE__
+
+  return rc;
+}
+
+int scr_file_copy_direct(
+  const char* src_file,
+  const char* dst_file,
+  unsigned long buf_size,
+  size_t align,
+  uLong* crc)
+{
+  double start = scr_seconds();
+  int rc = scr_file_copy_direct_data(src_file, dst_file, buf_size, align, crc);
+  if (rc == SCR_SUCCESS) {
+    scr_io_copy_record(dst_file, start);
+  }
+  return rc;
+}
+
+/* state of a buffer in the copy pipeline ring */
+#define SCR_COPY_SLOT_EMPTY   (0) /* ready to be filled by reader */
+#define SCR_COPY_SLOT_READ    (1) /* filled by reader, waiting on crc */
+#define SCR_COPY_SLOT_CHECKED (2) /* crc done, waiting on writer */
+
+typedef struct {
+  char* buf;    /* buffer of buf_size bytes */
+  ssize_t size; /* number of valid bytes in buffer */
+  int last;     /* set if this is the last buffer in the file */
+  int state;    /* one of SCR_COPY_SLOT_* values */
+} scr_copy_slot;
+
+typedef struct {
+  const char* src_file; /* name of source file */
+  const char* dst_file; /* name of destination file */
+  int src_fd;           /* open file descriptor of source file */
+  int dst_fd;           /* open file descriptor of destination file */
+  unsigned long buf_size;
+  int depth;            /* number of buffers in ring */
+  scr_copy_slot* slots; /* ring of buffers */
+  uLong* crc;           /* crc to update, NULL to skip crc */
+  int node;             /* NUMA node of buffers and helper threads, -1 for none */
+  int error;            /* set if any stage hits an error */
+  unsigned long bytes;  /* number of bytes written */
+  pthread_mutex_t lock; /* protects state fields of slots and error */
+  pthread_cond_t cond;  /* signaled whenever a slot changes state */
+} scr_copy_pipe;
+
+/* wait until slot is in given state or an error is flagged,
+ * returns 1 if slot is ready, 0 on error, caller must hold lock */
+static int scr_copy_pipe_wait(scr_copy_pipe* p, scr_copy_slot* slot, int state)
+{
+  while (slot->state != state && !p->error) {
+    pthread_cond_wait(&p->cond, &p->lock);
+  }
+  return (slot->state == state);
+}
+
+/* set slot to new state and wake up other stages */
+static void scr_copy_pipe_set(scr_copy_pipe* p, scr_copy_slot* slot, int state)
+{
+  pthread_mutex_lock(&p->lock);
+  slot->state = state;
+  pthread_cond_broadcast(&p->cond);
+  pthread_mutex_unlock(&p->lock);
+}
+
+/* flag an error so that all stages stop */
+static void scr_copy_pipe_fail(scr_copy_pipe* p)
+{
+  pthread_mutex_lock(&p->lock);
+  p->error = 1;
+  pthread_cond_broadcast(&p->cond);
+  pthread_mutex_unlock(&p->lock);
+}
+
+/* crc stage, runs in its own thread and computes crc over buffers
+ * in file order as the reader fills them */
+static void* scr_copy_pipe_crc(void* arg)
+{
+  scr_copy_pipe* p = (scr_copy_pipe*) arg;
+  scr_numa_bind_thread(p->node);
+
+  int i = 0;
+  int done = 0;
+  while (!done) {
+    scr_copy_slot* slot = &p->slots[i];
+
+    pthread_mutex_lock(&p->lock);
+    int ready = scr_copy_pipe_wait(p, slot, SCR_COPY_SLOT_READ);
+    pthread_mutex_unlock(&p->lock);
+    if (!ready) {
+      break;
+    }
+
+    if (slot->size > 0) {
+      *(p->crc) = crc32(*(p->crc), (const Bytef*) slot->buf, (uInt) slot->size);
+    }
+    done = slot->last;
+
+    scr_copy_pipe_set(p, slot, SCR_COPY_SLOT_CHECKED);
+    i = (i + 1) % p->depth;
+  }
+
+  return NULL;
+}
+
+/* writer stage, runs in its own thread and writes buffers in file order */
+static void* scr_copy_pipe_write(void* arg)
+{
+  scr_copy_pipe* p = (scr_copy_pipe*) arg;
+  scr_numa_bind_thread(p->node);
+
+  int i = 0;
+  int done = 0;
+  while (!done) {
+    scr_copy_slot* slot = &p->slots[i];
+
+    pthread_mutex_lock(&p->lock);
+    int ready = scr_copy_pipe_wait(p, slot, SCR_COPY_SLOT_CHECKED);
+    pthread_mutex_unlock(&p->lock);
+    if (!ready) {
+      break;
+    }
+
+    if (slot->size > 0) {
+      ssize_t nwrite = scr_write_attempt(p->dst_file, p->dst_fd, slot->buf, slot->size);
+      if (nwrite != slot->size) {
+        /* write had a problem, stop copying and return an error */
+        scr_copy_pipe_fail(p);
+        break;
+      }
+      p->bytes += (unsigned long) nwrite;
+    }
+    done = slot->last;
+
+    scr_copy_pipe_set(p, slot, SCR_COPY_SLOT_EMPTY);
+    i = (i + 1) % p->depth;
+  }
+
+  return NULL;
+}
+
+/* copy src_file to dst_file like scr_file_copy, but overlap reading,
+ * crc computation, and writing using a ring of depth buffers each of
+ * buf_size bytes, the calling thread reads while helper threads compute
+ * the crc and write, falls back to scr_file_copy if depth < 2 */
+int scr_file_copy_pipeline(
+  const char* src_file,
+  const char* dst_file,
+  unsigned long buf_size,
+  int depth,
+  uLong* crc)
+{
+  /* nothing to overlap with a single buffer, and sparse files
+   * are copied one data region at a time by scr_file_copy */
+  if (depth < 2 || scr_file_is_sparse(src_file)) {
+    return scr_file_copy(src_file, dst_file, buf_size, crc);
+  }
+
+  /* check that we got something for a source file */
+  if (src_file == NULL || strcmp(src_file, "") == 0) {
+    scr_err("Invalid source file @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* check that we got something for a destination file */
+  if (dst_file == NULL || strcmp(dst_file, "") == 0) {
+    scr_err("Invalid destination file @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  int rc = SCR_SUCCESS;
+
+  double time_start = scr_seconds();
+
+  /* open src_file for reading */
+  int src_fd = scr_open(src_file, O_RDONLY);
+  if (src_fd < 0) {
+    scr_err("Opening file to copy: scr_open(%s) errno=%d %s @ %s:%d",
+      src_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* open dest_file for writing */
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int dst_fd = scr_open(dst_file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (dst_fd < 0) {
+    scr_err("Opening file for writing: scr_open(%s) errno=%d %s @ %s:%d",
+      dst_file, errno, strerror(errno), __FILE__, __LINE__
     );
+    scr_close(src_file, src_fd);
+    return SCR_FAILURE;
   }
+
+#if !defined(__APPLE__)
+  posix_fadvise(src_fd, 0, 0, POSIX_FADV_DONTNEED | POSIX_FADV_SEQUENTIAL);
+  posix_fadvise(dst_fd, 0, 0, POSIX_FADV_DONTNEED | POSIX_FADV_SEQUENTIAL);
 #endif
 
+  /* initialize our pipeline */
+  scr_copy_pipe p;
+  p.src_file = src_file;
+  p.dst_file = dst_file;
+  p.src_fd   = src_fd;
+  p.dst_fd   = dst_fd;
+  p.buf_size = buf_size;
+  p.depth    = depth;
+  p.crc      = crc;
+  p.node     = scr_numa_node_of_file(dst_file);
+  p.error    = 0;
+  p.bytes    = 0;
+  p.slots    = (scr_copy_slot*) SCR_MALLOC(depth * sizeof(scr_copy_slot));
+  if (p.node < 0) {
+    p.node = scr_numa_node_of_file(src_file);
+  }
+  pthread_mutex_init(&p.lock, NULL);
+  pthread_cond_init(&p.cond, NULL);
+
+  /* allocate buffers to read in file chunks */
+  int i;
+  for (i = 0; i < depth; i++) {
+    p.slots[i].size  = 0;
+    p.slots[i].last  = 0;
+    p.slots[i].state = SCR_COPY_SLOT_EMPTY;
+    p.slots[i].buf   = (char*) scr_numa_alloc(buf_size, p.node);
+    if (p.slots[i].buf == NULL) {
+      scr_err("Allocating memory: malloc(%lu) errno=%d %s @ %s:%d",
+        buf_size, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+  }
+
+  /* initialize crc values */
+  if (crc != NULL) {
+    *crc = crc32(0L, Z_NULL, 0);
+  }
+
+  /* start the crc and writer stages */
+  int have_crc_thread = 0;
+  int have_write_thread = 0;
+  pthread_t crc_thread, write_thread;
+  if (rc == SCR_SUCCESS && crc != NULL) {
+    if (pthread_create(&crc_thread, NULL, scr_copy_pipe_crc, &p) == 0) {
+      have_crc_thread = 1;
+    } else {
+      scr_err("Failed to create crc thread for copy of %s @ %s:%d",
+        src_file, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+  }
+  if (rc == SCR_SUCCESS) {
+    if (pthread_create(&write_thread, NULL, scr_copy_pipe_write, &p) == 0) {
+      have_write_thread = 1;
+    } else {
+      scr_err("Failed to create writer thread for copy of %s @ %s:%d",
+        dst_file, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+  }
+
+  /* buffers skip the crc stage if we don't need a crc */
+  int filled = (crc != NULL) ? SCR_COPY_SLOT_READ : SCR_COPY_SLOT_CHECKED;
+
+  /* reader stage runs in this thread */
+  int copying = (rc == SCR_SUCCESS);
+  i = 0;
+  while (copying) {
+    scr_copy_slot* slot = &p.slots[i];
+
+    /* wait for the writer to release this buffer */
+    pthread_mutex_lock(&p.lock);
+    int ready = scr_copy_pipe_wait(&p, slot, SCR_COPY_SLOT_EMPTY);
+    pthread_mutex_unlock(&p.lock);
+    if (!ready) {
+      break;
+    }
+
+    /* attempt to read buf_size bytes from file */
+    ssize_t nread = scr_read_attempt(src_file, src_fd, slot->buf, buf_size);
+    if (nread < 0) {
+      /* read had a problem, stop copying and return an error */
+      scr_copy_pipe_fail(&p);
+      break;
+    }
+
+    /* assume a short read means we hit the end of the file */
+    slot->size = nread;
+    slot->last = (nread < buf_size);
+    if (slot->last) {
+      copying = 0;
+    }
+
+    /* hand buffer off to the next stage */
+    scr_copy_pipe_set(&p, slot, filled);
+    i = (i + 1) % depth;
+  }
+
+  /* if we failed to start a stage, let any other stage know */
+  if (rc != SCR_SUCCESS) {
+    scr_copy_pipe_fail(&p);
+  }
+
+  /* wait for other stages to finish */
+  if (have_crc_thread) {
+    pthread_join(crc_thread, NULL);
+  }
+  if (have_write_thread) {
+    pthread_join(write_thread, NULL);
+  }
+  if (p.error) {
+    rc = SCR_FAILURE;
+  }
+
+  /* free buffers */
+  for (i = 0; i < depth; i++) {
+    scr_free(&p.slots[i].buf);
+  }
+  scr_free(&p.slots);
+  pthread_cond_destroy(&p.cond);
+  pthread_mutex_destroy(&p.lock);
+
+  /* close source and destination files */
+  if (scr_close(dst_file, dst_fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  if (scr_close(src_file, src_fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+
+  /* unlink the file if the copy failed */
+  if (rc != SCR_SUCCESS) {
+    unlink(dst_file);
+  }
+
+  /* report bandwidth of the copy */
+  double time_diff = scr_seconds() - time_start;
+  double bw = 0.0;
+  if (time_diff > 0.0) {
+    bw = ((double) p.bytes) / (1024.0 * 1024.0 * time_diff);
+  }
+  scr_dbg(1, "scr_file_copy_pipeline: %s: %f secs, %e bytes, %f MB/s, depth %d",
+    dst_file, time_diff, (double) p.bytes, bw, depth
+  );
+
+  if (rc == SCR_SUCCESS) {
+    scr_io_copy_record(dst_file, time_start);
+  }
+
   return rc;
 }
 
@@ -70,8 +70,49 @@ ssize_t scr_read_line(const char* file, int fd, char* buf, size_t size);
 /* write a formatted string to specified file descriptor */
 ssize_t scr_writef(const char* file, int fd, const char* format, ...);
 
+/* a set of opened files with known sizes treated as one logical file */
+typedef struct {
+  int n;                    /* number of files */
+  char** files;             /* file names, for error messages */
+  int* fds;                 /* open file descriptors */
+  unsigned long* filesizes; /* size of each file */
+  unsigned long* offsets;   /* offset of each file in logical file, n+1 entries */
+} scr_logical_file;
+
+/* build a logical file from n opened files with known filesizes,
+ * the arrays are referenced, not copied, so they must outlive the object */
+int scr_logical_file_init(
+  scr_logical_file* lf,
+  int n,
+  char** files,
+  int* fds,
+  unsigned long* filesizes
+);
+
+/* free memory associated with logical file, does not close the files */
+int scr_logical_file_free(scr_logical_file* lf);
+
+/* read count bytes from logical file into buf starting from offset,
+ * pad with zero on end if missing data */
+int scr_logical_file_read(
+  const scr_logical_file* lf,
+  char* buf,
+  unsigned long count,
+  unsigned long offset
+);
+
+/* write count bytes from buf to logical file starting at offset,
+ * data beyond the end of the logical file is discarded */
+int scr_logical_file_write(
+  const scr_logical_file* lf,
+  const char* buf,
+  unsigned long count,
+  unsigned long offset
+);
+
 /* logically concatenate n opened files and read count bytes from this logical file into buf starting
- * from offset, pad with zero on end if missing data */
+ * from offset, pad with zero on end if missing data, builds a scr_logical_file on each call,
+ * so callers that read a file set in many chunks should keep one with scr_logical_file_init */
 int scr_read_pad_n(
   int n,
   char** files,
@@ -82,7 +123,8 @@ int scr_read_pad_n(
   unsigned long* filesizes
 );
 
-/* write to an array of open files with known filesizes and treat them as one single large file */
+/* write to an array of open files with known filesizes and treat them as one single large file,
+ * builds a scr_logical_file on each call, so use scr_logical_file_write for many chunks */
 int scr_write_pad_n(
   int n,
   char** files,
@@ -99,6 +141,9 @@ unsigned long scr_file_size(const char* file);
 /* tests whether the file or directory exists */
 int scr_file_exists(const char* file);
 
+/* returns 1 if file has fewer blocks allocated than its size implies */
+int scr_file_is_sparse(const char* file);
+
 /* tests whether the file or directory is readable */
 int scr_file_is_readable(const char* file);
 
@@ -111,6 +156,26 @@ int scr_file_unlink(const char* file);
 /* opens, reads, and computes the crc32 value for the given filename */
 int scr_crc32(const char* filename, uLong* crc);
 
+/* same as scr_crc32, but computes ranges of the file using up to threads threads
+ * and merges them with crc32_combine64, files smaller than min_size are read serially */
+int scr_crc32_parallel(const char* filename, int threads, unsigned long min_size, uLong* crc);
+
+/* same as scr_crc32, but reads file with O_DIRECT into a buffer aligned to align bytes */
+int scr_crc32_direct(const char* filename, size_t align, uLong* crc);
+
+/* number of reads and writes in flight with io_uring, 0 for POSIX I/O,
+ * set with scr_io_set_uring_depth */
+extern int scr_io_uring_depth;
+
+/* set number of reads and writes to keep in flight with io_uring when copying
+ * files and computing crc values, 0 uses POSIX I/O, returns SCR_FAILURE if
+ * SCR was built without io_uring support */
+int scr_io_set_uring_depth(int depth);
+
+/* if set, called with the bytes and seconds of each successful
+ * scr_file_copy, scr_file_copy_direct, and scr_file_copy_pipeline */
+extern void (*scr_io_copy_hook)(double bytes, double secs);
+
 /*
 =========================================
 Directory functions
@@ -139,4 +204,25 @@ int scr_file_copy(
   uLong* crc
 );
 
+/* same as scr_file_copy, but uses O_DIRECT with buffers aligned to align bytes
+ * to bypass the page cache, the tail of the file is written with buffered I/O */
+int scr_file_copy_direct(
+  const char* src_file,
+  const char* dst_file,
+  unsigned long buf_size,
+  size_t align,
+  uLong* crc
+);
+
+/* same as scr_file_copy, but overlaps reading, crc, and writing of the
+ * file using a ring of depth buffers, each of buf_size bytes,
+ * uses scr_file_copy when depth is less than 2 */
+int scr_file_copy_pipeline(
+  const char* src_file,
+  const char* dst_file,
+  unsigned long buf_size,
+  int depth,
+  uLong* crc
+);
+
 #endif
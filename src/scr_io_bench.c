@@ -0,0 +1,558 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+/* Serial microbenchmark of the file kernels in scr_io and scr_checksum.
+ * For each storage directory, file size, and buffer size, runs each
+ * kernel several times and prints one CSV line with the min, median,
+ * and max bandwidth in GB/s and the number of read and write system
+ * calls per GB, as counted by /proc/self/io.  This is meant to help pick
+ * SCR_FILE_BUF_SIZE for a system and to compare the copy engines. */
+
+#include "scr_conf.h"
+#include "scr.h"
+#include "scr_io.h"
+#include "scr_err.h"
+#include "scr_util.h"
+#include "scr_checksum.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+
+/* compute crc32 */
+#include <zlib.h>
+
+#ifdef SCR_GLOBALS_H
+#error "globals.h accessed from tools"
+#endif
+
+#define PROG ("scr_io_bench")
+
+/* maximum number of values in a comma-separated list option */
+#define MAX_LIST (32)
+
+/* number of files the pad kernels spread the logical file across */
+#define PAD_FILES (4)
+
+/* kernels we know how to run, in the order we run them */
+static const char* all_kernels[] = {
+  "copy", "copy_direct", "copy_pipeline",
+  "crc32", "crc32_parallel", "crc32_direct",
+  "crc32c", "xxh64",
+  "write_pad", "read_pad",
+  NULL
+};
+
+struct arglist {
+  int num_sizes;
+  unsigned long sizes[MAX_LIST]; /* file sizes to test */
+  int num_bufs;
+  unsigned long bufs[MAX_LIST];  /* buffer sizes to test */
+  char* kernels;                 /* comma-separated list of kernels to run */
+  int reps;                      /* number of times to run each kernel */
+  int depth;                     /* pipeline depth for copy_pipeline */
+  int threads;                   /* threads for crc32_parallel */
+  int uring_depth;               /* io_uring depth, 0 for POSIX I/O */
+  int crc_flag;                  /* whether copies also compute crc32 */
+  int drop_flag;                 /* whether to drop files from page cache before each run */
+  int num_dirs;
+  char** dirs;                   /* storage directories to test */
+};
+
+int print_usage()
+{
+  printf("\n");
+  printf("  Usage: %s [options] <dir> [<dir> ...]\n", PROG);
+  printf("\n");
+  printf("  Options:\n");
+  printf("    -s, --sizes=<LIST>    Comma-separated file sizes (default 64MB,1GB)\n");
+  printf("    -b, --bufs=<LIST>     Comma-separated buffer sizes (default 128KB,1MB,%lu)\n", (unsigned long) SCR_FILE_BUF_SIZE);
+  printf("    -k, --kernels=<LIST>  Comma-separated kernels to run (default all):\n");
+  printf("                          copy, copy_direct, copy_pipeline, crc32, crc32_parallel,\n");
+  printf("                          crc32_direct, crc32c, xxh64, write_pad, read_pad\n");
+  printf("    -r, --reps=<N>        Runs of each kernel (default 5)\n");
+  printf("    -l, --pipeline=<N>    Buffers for copy_pipeline (default %d)\n", SCR_COPY_PIPELINE_DEPTH < 2 ? 2 : SCR_COPY_PIPELINE_DEPTH);
+  printf("    -t, --threads=<N>     Threads for crc32_parallel (default 4)\n");
+  printf("    -u, --uring=<N>       Reads and writes in flight with io_uring (default %d)\n", SCR_IO_URING_DEPTH);
+  printf("    -c, --crc             Compute crc32 during copies\n");
+  printf("    -d, --drop            Drop files from the page cache before each run\n");
+  printf("    -h, --help            Print usage\n");
+  printf("\n");
+  exit(1);
+}
+
+/* parse a comma-separated list of byte counts into vals */
+static int parse_bytes_list(const char* str, unsigned long* vals, int* num)
+{
+  char* copy = strdup(str);
+  char* saveptr = NULL;
+  char* tok = strtok_r(copy, ",", &saveptr);
+  *num = 0;
+  while (tok != NULL) {
+    unsigned long long bytes;
+    if (*num >= MAX_LIST || scr_abtoull(tok, &bytes) != SCR_SUCCESS || bytes == 0) {
+      scr_free(&copy);
+      return 0;
+    }
+    vals[(*num)++] = (unsigned long) bytes;
+    tok = strtok_r(NULL, ",", &saveptr);
+  }
+  scr_free(&copy);
+  return (*num > 0);
+}
+
+int process_args(int argc, char **argv, struct arglist* args)
+{
+  /* define our options */
+  static struct option long_options[] = {
+    {"sizes",    required_argument, NULL, 's'},
+    {"bufs",     required_argument, NULL, 'b'},
+    {"kernels",  required_argument, NULL, 'k'},
+    {"reps",     required_argument, NULL, 'r'},
+    {"pipeline", required_argument, NULL, 'l'},
+    {"threads",  required_argument, NULL, 't'},
+    {"uring",    required_argument, NULL, 'u'},
+    {"crc",      no_argument,       NULL, 'c'},
+    {"drop",     no_argument,       NULL, 'd'},
+    {"help",     no_argument,       NULL, 'h'},
+    {0, 0, 0, 0}
+  };
+
+  /* set our options to default values */
+  parse_bytes_list("64MB,1GB", args->sizes, &args->num_sizes);
+  args->num_bufs    = 3;
+  args->bufs[0]     = 128 * 1024;
+  args->bufs[1]     = 1024 * 1024;
+  args->bufs[2]     = SCR_FILE_BUF_SIZE;
+  args->kernels     = NULL;
+  args->reps        = 5;
+  args->depth       = (SCR_COPY_PIPELINE_DEPTH < 2) ? 2 : SCR_COPY_PIPELINE_DEPTH;
+  args->threads     = 4;
+  args->uring_depth = SCR_IO_URING_DEPTH;
+  args->crc_flag    = 0;
+  args->drop_flag   = 0;
+
+  /* loop through and process all options */
+  int c;
+  do {
+    /* read in our next option */
+    int option_index = 0;
+    c = getopt_long(argc, argv, "s:b:k:r:l:t:u:cdh", long_options, &option_index);
+    switch (c) {
+      case 's':
+        if (! parse_bytes_list(optarg, args->sizes, &args->num_sizes)) {
+          scr_err("%s: Invalid file sizes '--sizes %s'", PROG, optarg);
+          return 0;
+        }
+        break;
+      case 'b':
+        if (! parse_bytes_list(optarg, args->bufs, &args->num_bufs)) {
+          scr_err("%s: Invalid buffer sizes '--bufs %s'", PROG, optarg);
+          return 0;
+        }
+        break;
+      case 'k':
+        args->kernels = optarg;
+        break;
+      case 'r':
+        args->reps = atoi(optarg);
+        if (args->reps <= 0) {
+          scr_err("%s: Number of runs must be positive '--reps %s'", PROG, optarg);
+          return 0;
+        }
+        break;
+      case 'l':
+        args->depth = atoi(optarg);
+        break;
+      case 't':
+        args->threads = atoi(optarg);
+        break;
+      case 'u':
+        args->uring_depth = atoi(optarg);
+        break;
+      case 'c':
+        args->crc_flag = 1;
+        break;
+      case 'd':
+        args->drop_flag = 1;
+        break;
+      case 'h':
+        print_usage();
+        break;
+      case '?':
+        /* getopt_long printed an error message */
+        return 0;
+      default:
+        break;
+    }
+  } while (c != -1);
+
+  /* remaining arguments are the directories to test */
+  args->num_dirs = argc - optind;
+  args->dirs     = &argv[optind];
+  if (args->num_dirs <= 0) {
+    print_usage();
+  }
+
+  return 1;
+}
+
+/* returns 1 if kernel is in the comma-separated list, or if list is NULL */
+static int kernel_selected(const char* list, const char* kernel)
+{
+  if (list == NULL) {
+    return 1;
+  }
+  size_t len = strlen(kernel);
+  const char* p = list;
+  while (*p != '\0') {
+    size_t n = strcspn(p, ",");
+    if (n == len && strncmp(p, kernel, len) == 0) {
+      return 1;
+    }
+    p += n;
+    if (*p == ',') {
+      p++;
+    }
+  }
+  return 0;
+}
+
+/* returns number of read plus write system calls issued by this process
+ * from /proc/self/io, or -1 if that is not available */
+static long long syscall_count(void)
+{
+  FILE* fp = fopen("/proc/self/io", "r");
+  if (fp == NULL) {
+    return -1;
+  }
+  long long count = 0;
+  int found = 0;
+  char line[128];
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    long long val;
+    if (sscanf(line, "syscr: %lld", &val) == 1 ||
+        sscanf(line, "syscw: %lld", &val) == 1)
+    {
+      count += val;
+      found++;
+    }
+  }
+  fclose(fp);
+  return (found == 2) ? count : -1;
+}
+
+/* evict file from the page cache so the next read comes from storage */
+static void drop_file(const char* file)
+{
+  int fd = open(file, O_RDONLY);
+  if (fd >= 0) {
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+}
+
+/* create file of given size filled with a pattern */
+static int create_file(const char* file, unsigned long size)
+{
+  int fd = scr_open(file, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  if (fd < 0) {
+    return SCR_FAILURE;
+  }
+
+  int rc = SCR_SUCCESS;
+  size_t bufsize = 1024 * 1024;
+  char* buf = (char*) SCR_MALLOC(bufsize);
+  size_t i;
+  for (i = 0; i < bufsize; i++) {
+    buf[i] = (char) (i * 31 + 7);
+  }
+  unsigned long written = 0;
+  while (written < size) {
+    size_t count = bufsize;
+    if (size - written < count) {
+      count = size - written;
+    }
+    if (scr_write(file, fd, buf, count) != (ssize_t) count) {
+      rc = SCR_FAILURE;
+      break;
+    }
+    written += count;
+  }
+  scr_free(&buf);
+
+  scr_close(file, fd);
+  return rc;
+}
+
+/* context for one run of a kernel */
+struct bench {
+  const struct arglist* args;
+  const char* src;                 /* source file of size bytes */
+  const char* dst;                 /* destination file for copies */
+  char* parts[PAD_FILES];          /* files for pad kernels */
+  unsigned long part_sizes[PAD_FILES];
+  unsigned long size;              /* bytes processed per run */
+  unsigned long buf_size;          /* buffer size for this run */
+};
+
+/* read or write the logical file spread over the pad files in chunks of buf_size */
+static int run_pad(struct bench* b, int write_flag)
+{
+  int fds[PAD_FILES];
+  int i;
+  int flags = write_flag ? (O_WRONLY | O_CREAT) : O_RDONLY;
+  for (i = 0; i < PAD_FILES; i++) {
+    fds[i] = scr_open(b->parts[i], flags, S_IRUSR | S_IWUSR);
+    if (fds[i] < 0) {
+      while (--i >= 0) {
+        scr_close(b->parts[i], fds[i]);
+      }
+      return SCR_FAILURE;
+    }
+  }
+
+  /* build the logical file once for all chunks */
+  scr_logical_file lf;
+  scr_logical_file_init(&lf, PAD_FILES, b->parts, fds, b->part_sizes);
+
+  int rc = SCR_SUCCESS;
+  char* buf = (char*) SCR_MALLOC(b->buf_size);
+  memset(buf, 1, b->buf_size);
+  unsigned long offset = 0;
+  while (offset < b->size) {
+    unsigned long count = b->buf_size;
+    if (b->size - offset < count) {
+      count = b->size - offset;
+    }
+    int pad_rc;
+    if (write_flag) {
+      pad_rc = scr_logical_file_write(&lf, buf, count, offset);
+    } else {
+      pad_rc = scr_logical_file_read(&lf, buf, count, offset);
+    }
+    if (pad_rc != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+      break;
+    }
+    offset += count;
+  }
+  scr_free(&buf);
+  scr_logical_file_free(&lf);
+
+  for (i = 0; i < PAD_FILES; i++) {
+    if (write_flag) {
+      fsync(fds[i]);
+    }
+    scr_close(b->parts[i], fds[i]);
+  }
+  return rc;
+}
+
+/* run one kernel once, returns SCR_SUCCESS if it succeeded */
+static int run_kernel(struct bench* b, const char* kernel)
+{
+  const struct arglist* args = b->args;
+  uLong crc = crc32(0L, Z_NULL, 0);
+  uLong* crc_p = args->crc_flag ? &crc : NULL;
+  uint64_t value;
+
+  if (strcmp(kernel, "copy") == 0) {
+    return scr_file_copy(b->src, b->dst, b->buf_size, crc_p);
+  } else if (strcmp(kernel, "copy_direct") == 0) {
+    return scr_file_copy_direct(b->src, b->dst, b->buf_size, (size_t) sysconf(_SC_PAGESIZE), crc_p);
+  } else if (strcmp(kernel, "copy_pipeline") == 0) {
+    return scr_file_copy_pipeline(b->src, b->dst, b->buf_size, args->depth, crc_p);
+  } else if (strcmp(kernel, "crc32") == 0) {
+    return scr_crc32(b->src, &crc);
+  } else if (strcmp(kernel, "crc32_parallel") == 0) {
+    return scr_crc32_parallel(b->src, args->threads, 0, &crc);
+  } else if (strcmp(kernel, "crc32_direct") == 0) {
+    return scr_crc32_direct(b->src, (size_t) sysconf(_SC_PAGESIZE), &crc);
+  } else if (strcmp(kernel, "crc32c") == 0) {
+    return scr_checksum_file(b->src, SCR_CHECKSUM_CRC32C, &value);
+  } else if (strcmp(kernel, "xxh64") == 0) {
+    return scr_checksum_file(b->src, SCR_CHECKSUM_XXH64, &value);
+  } else if (strcmp(kernel, "write_pad") == 0) {
+    return run_pad(b, 1);
+  } else if (strcmp(kernel, "read_pad") == 0) {
+    return run_pad(b, 0);
+  }
+  return SCR_FAILURE;
+}
+
+/* returns 1 if the kernel uses the buffer size option */
+static int kernel_uses_buf(const char* kernel)
+{
+  return (strncmp(kernel, "copy", 4) == 0 || strstr(kernel, "_pad") != NULL);
+}
+
+/* compare doubles for qsort */
+static int cmp_double(const void* a, const void* b)
+{
+  double x = *(const double*) a;
+  double y = *(const double*) b;
+  return (x > y) - (x < y);
+}
+
+/* run a kernel reps times and print a line of results */
+static void bench_kernel(struct bench* b, const char* dir, const char* kernel)
+{
+  const struct arglist* args = b->args;
+  double* rates = (double*) SCR_MALLOC(args->reps * sizeof(double));
+  double gb = (double) b->size / (1024.0 * 1024.0 * 1024.0);
+
+  long long calls = 0;
+  int r;
+  for (r = 0; r < args->reps; r++) {
+    if (args->drop_flag) {
+      int i;
+      drop_file(b->src);
+      for (i = 0; i < PAD_FILES; i++) {
+        drop_file(b->parts[i]);
+      }
+    }
+
+    long long calls_start = syscall_count();
+    double start = scr_seconds();
+    int rc = run_kernel(b, kernel);
+    double secs = scr_seconds() - start;
+    long long calls_end = syscall_count();
+
+    if (rc != SCR_SUCCESS) {
+      scr_err("%s: Kernel %s failed in %s", PROG, kernel, dir);
+      scr_free(&rates);
+      return;
+    }
+
+    rates[r] = (secs > 0.0) ? gb / secs : 0.0;
+    if (calls >= 0 && calls_start >= 0 && calls_end >= 0) {
+      calls += calls_end - calls_start;
+    } else {
+      calls = -1;
+    }
+  }
+
+  qsort(rates, args->reps, sizeof(double), cmp_double);
+  double med = rates[args->reps / 2];
+  if (args->reps % 2 == 0) {
+    med = (rates[args->reps / 2 - 1] + rates[args->reps / 2]) / 2.0;
+  }
+
+  double calls_per_gb = -1.0;
+  if (calls >= 0 && gb > 0.0) {
+    calls_per_gb = (double) calls / (gb * args->reps);
+  }
+
+  printf("%s,%s,%lu,%lu,%d,%.3f,%.3f,%.3f,%.0f\n",
+    dir, kernel, b->size, kernel_uses_buf(kernel) ? b->buf_size : 0UL,
+    args->reps, rates[0], med, rates[args->reps - 1], calls_per_gb
+  );
+  fflush(stdout);
+
+  scr_free(&rates);
+}
+
+int main(int argc, char* argv[])
+{
+  /* process command line arguments */
+  struct arglist args;
+  if (! process_args(argc, argv, &args)) {
+    return 1;
+  }
+
+  if (args.uring_depth > 0 && scr_io_set_uring_depth(args.uring_depth) != SCR_SUCCESS) {
+    scr_err("%s: SCR was built without io_uring support, using POSIX I/O", PROG);
+    scr_io_set_uring_depth(0);
+  }
+
+  printf("dir,kernel,size,buf,reps,min_GBps,median_GBps,max_GBps,syscalls_per_GB\n");
+
+  int rc = 0;
+  int d;
+  for (d = 0; d < args.num_dirs; d++) {
+    const char* dir = args.dirs[d];
+
+    char* src = scr_strdupf("%s/scr_io_bench.%d.src", dir, (int) getpid());
+    char* dst = scr_strdupf("%s/scr_io_bench.%d.dst", dir, (int) getpid());
+
+    struct bench b;
+    b.args = &args;
+    b.src  = src;
+    b.dst  = dst;
+    int i;
+    for (i = 0; i < PAD_FILES; i++) {
+      b.parts[i] = scr_strdupf("%s/scr_io_bench.%d.pad%d", dir, (int) getpid(), i);
+    }
+
+    int s;
+    for (s = 0; s < args.num_sizes; s++) {
+      b.size = args.sizes[s];
+
+      /* spread the logical file evenly over the pad files */
+      for (i = 0; i < PAD_FILES; i++) {
+        b.part_sizes[i] = b.size / PAD_FILES;
+      }
+      b.part_sizes[PAD_FILES - 1] += b.size % PAD_FILES;
+
+      if (create_file(src, b.size) != SCR_SUCCESS) {
+        scr_err("%s: Failed to create %s", PROG, src);
+        rc = 1;
+        break;
+      }
+
+      /* read_pad needs the pad files, which write_pad would otherwise create */
+      if (kernel_selected(args.kernels, "read_pad")) {
+        b.buf_size = 1024 * 1024;
+        run_pad(&b, 1);
+      }
+
+      /* run kernels that use a buffer once per buffer size,
+       * and the others once per file size */
+      int k;
+      for (k = 0; all_kernels[k] != NULL; k++) {
+        const char* kernel = all_kernels[k];
+        if (! kernel_selected(args.kernels, kernel)) {
+          continue;
+        }
+        if (kernel_uses_buf(kernel)) {
+          int bi;
+          for (bi = 0; bi < args.num_bufs; bi++) {
+            b.buf_size = args.bufs[bi];
+            bench_kernel(&b, dir, kernel);
+          }
+        } else {
+          b.buf_size = 0;
+          bench_kernel(&b, dir, kernel);
+        }
+      }
+    }
+
+    /* clean up our files */
+    scr_file_unlink(src);
+    scr_file_unlink(dst);
+    for (i = 0; i < PAD_FILES; i++) {
+      scr_file_unlink(b.parts[i]);
+      scr_free(&b.parts[i]);
+    }
+    scr_free(&dst);
+    scr_free(&src);
+  }
+
+  return rc;
+}
@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#include "scr_globals.h"
+
+#include <stdint.h>
+#include <pthread.h>
+
+/* tag used to send host names of slow ranks to rank 0 */
+#define SCR_IOHIST_TAG (7373)
+
+/* each power of two is split into this many linear buckets */
+#define SCR_IOHIST_SUB_BITS (4)
+#define SCR_IOHIST_SUB (1 << SCR_IOHIST_SUB_BITS)
+
+/* enough buckets to hold any 64-bit value */
+#define SCR_IOHIST_BINS ((64 - SCR_IOHIST_SUB_BITS + 1) * SCR_IOHIST_SUB)
+
+/* histograms we keep for each operation */
+#define SCR_IOHIST_LAT     (0) /* latency in microseconds */
+#define SCR_IOHIST_BW      (1) /* bandwidth in KiB/sec */
+#define SCR_IOHIST_METRICS (2)
+
+/* values we summarize for each operation on each rank */
+#define SCR_IOHIST_COUNT   (0) /* number of operations */
+#define SCR_IOHIST_LAT_P50 (1) /* median latency in secs */
+#define SCR_IOHIST_LAT_P99 (2) /* 99th percentile latency in secs */
+#define SCR_IOHIST_LAT_MAX (3) /* max latency in secs */
+#define SCR_IOHIST_BW_P50  (4) /* median bandwidth in bytes/sec */
+#define SCR_IOHIST_VALS    (5)
+
+static const char* scr_iohist_names[SCR_IOHIST_OPS] = {"WRITE", "COPY", "CRC"};
+
+static uint64_t scr_iohist_bins[SCR_IOHIST_OPS][SCR_IOHIST_METRICS][SCR_IOHIST_BINS];
+static pthread_mutex_t scr_iohist_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* return index of bucket holding given value */
+static int scr_iohist_bin(uint64_t value)
+{
+  if (value < SCR_IOHIST_SUB) {
+    return (int) value;
+  }
+
+  /* find the highest bit that is set */
+  int high = 0;
+  uint64_t v = value;
+  while (v >>= 1) {
+    high++;
+  }
+
+  /* keep the top SCR_IOHIST_SUB_BITS+1 bits to pick the linear bucket */
+  int shift = high - SCR_IOHIST_SUB_BITS;
+  int sub = (int) (value >> shift) - SCR_IOHIST_SUB;
+  return (shift + 1) * SCR_IOHIST_SUB + sub;
+}
+
+/* return value at the middle of the range of given bucket */
+static double scr_iohist_value(int bin)
+{
+  if (bin < SCR_IOHIST_SUB) {
+    return (double) bin;
+  }
+  int shift = bin / SCR_IOHIST_SUB - 1;
+  int sub   = bin % SCR_IOHIST_SUB;
+  double low  = (double) ((uint64_t) (SCR_IOHIST_SUB + sub) << shift);
+  double high = (double) ((uint64_t) (SCR_IOHIST_SUB + sub + 1) << shift);
+  return (low + high) / 2.0;
+}
+
+/* return number of values in histogram */
+static uint64_t scr_iohist_total(const uint64_t* bins)
+{
+  uint64_t total = 0;
+  int i;
+  for (i = 0; i < SCR_IOHIST_BINS; i++) {
+    total += bins[i];
+  }
+  return total;
+}
+
+/* return value below which fraction q of the values in histogram fall */
+static double scr_iohist_percentile(const uint64_t* bins, double q)
+{
+  uint64_t total = scr_iohist_total(bins);
+  if (total == 0) {
+    return 0.0;
+  }
+
+  uint64_t target = (uint64_t) (q * (double) total + 0.5);
+  if (target < 1) {
+    target = 1;
+  }
+
+  uint64_t seen = 0;
+  int i;
+  for (i = 0; i < SCR_IOHIST_BINS; i++) {
+    seen += bins[i];
+    if (seen >= target) {
+      return scr_iohist_value(i);
+    }
+  }
+  return scr_iohist_value(SCR_IOHIST_BINS - 1);
+}
+
+/* record that the calling rank moved bytes in secs for one operation,
+ * this is thread safe and does nothing unless SCR_IOHIST is set */
+void scr_iohist_record(int op, double bytes, double secs)
+{
+  if (! scr_iohist || op < 0 || op >= SCR_IOHIST_OPS) {
+    return;
+  }
+
+  /* guard against clock skew */
+  if (secs < 0.0) {
+    secs = 0.0;
+  }
+
+  int lat = scr_iohist_bin((uint64_t) (secs * 1000000.0));
+
+  /* operations too fast to time say nothing about bandwidth */
+  int bw = -1;
+  if (secs > 0.0 && bytes > 0.0) {
+    bw = scr_iohist_bin((uint64_t) (bytes / 1024.0 / secs));
+  }
+
+  pthread_mutex_lock(&scr_iohist_lock);
+  scr_iohist_bins[op][SCR_IOHIST_LAT][lat]++;
+  if (bw >= 0) {
+    scr_iohist_bins[op][SCR_IOHIST_BW][bw]++;
+  }
+  pthread_mutex_unlock(&scr_iohist_lock);
+}
+
+/* record a file copy, matches scr_io_copy_hook */
+void scr_iohist_record_copy(double bytes, double secs)
+{
+  scr_iohist_record(SCR_IOHIST_COPY, bytes, secs);
+}
+
+/* fill in summary values of one operation from its histograms */
+static void scr_iohist_summarize(const uint64_t* lat, const uint64_t* bw, double* vals)
+{
+  vals[SCR_IOHIST_COUNT]   = (double) scr_iohist_total(lat);
+  vals[SCR_IOHIST_LAT_P50] = scr_iohist_percentile(lat, 0.50) / 1000000.0;
+  vals[SCR_IOHIST_LAT_P99] = scr_iohist_percentile(lat, 0.99) / 1000000.0;
+  vals[SCR_IOHIST_LAT_MAX] = scr_iohist_percentile(lat, 1.00) / 1000000.0;
+  vals[SCR_IOHIST_BW_P50]  = scr_iohist_percentile(bw,  0.50) * 1024.0;
+}
+
+/* merge histograms across comm, print percentiles along with the
+ * slowest ranks on rank 0, and log each slow rank, this is collective */
+int scr_iohist_report(MPI_Comm comm)
+{
+  if (! scr_iohist) {
+    return SCR_SUCCESS;
+  }
+
+  int rank, ranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+
+  /* copy our histograms so other threads can keep recording */
+  int n = SCR_IOHIST_OPS * SCR_IOHIST_METRICS * SCR_IOHIST_BINS;
+  uint64_t* mine = (uint64_t*) SCR_MALLOC(n * sizeof(uint64_t));
+  pthread_mutex_lock(&scr_iohist_lock);
+  memcpy(mine, scr_iohist_bins, n * sizeof(uint64_t));
+  pthread_mutex_unlock(&scr_iohist_lock);
+
+  /* merge histograms of all ranks on rank 0 for system-wide percentiles */
+  uint64_t* all = NULL;
+  if (rank == 0) {
+    all = (uint64_t*) SCR_MALLOC(n * sizeof(uint64_t));
+  }
+  MPI_Reduce(mine, all, n, MPI_UINT64_T, MPI_SUM, 0, comm);
+
+  /* summarize our own operations and gather summaries on rank 0 */
+  int op;
+  double summary[SCR_IOHIST_OPS * SCR_IOHIST_VALS];
+  for (op = 0; op < SCR_IOHIST_OPS; op++) {
+    const uint64_t* lat = mine + (op * SCR_IOHIST_METRICS + SCR_IOHIST_LAT) * SCR_IOHIST_BINS;
+    const uint64_t* bw  = mine + (op * SCR_IOHIST_METRICS + SCR_IOHIST_BW)  * SCR_IOHIST_BINS;
+    scr_iohist_summarize(lat, bw, &summary[op * SCR_IOHIST_VALS]);
+  }
+
+  double* summaries = NULL;
+  if (rank == 0) {
+    summaries = (double*) SCR_MALLOC(ranks * SCR_IOHIST_OPS * SCR_IOHIST_VALS * sizeof(double));
+  }
+  MPI_Gather(summary, SCR_IOHIST_OPS * SCR_IOHIST_VALS, MPI_DOUBLE,
+    summaries, SCR_IOHIST_OPS * SCR_IOHIST_VALS, MPI_DOUBLE, 0, comm
+  );
+
+  /* rank 0 picks the ranks with the highest 99th percentile latency
+   * for each operation, slow lists each picked rank only once */
+  int top = (scr_iohist_top > 0) ? scr_iohist_top : 0;
+  if (top > ranks) {
+    top = ranks;
+  }
+  int* picks = NULL;
+  int* slow  = NULL;
+  int nslow  = 0;
+  if (top > 0) {
+    picks = (int*) SCR_MALLOC(SCR_IOHIST_OPS * top * sizeof(int));
+    slow  = (int*) SCR_MALLOC(SCR_IOHIST_OPS * top * sizeof(int));
+  }
+  if (rank == 0 && top > 0) {
+    for (op = 0; op < SCR_IOHIST_OPS; op++) {
+      int k;
+      for (k = 0; k < top; k++) {
+        /* find slowest rank that we have not already picked */
+        int best = -1;
+        double best_p99 = -1.0;
+        int r;
+        for (r = 0; r < ranks; r++) {
+          const double* vals = &summaries[(r * SCR_IOHIST_OPS + op) * SCR_IOHIST_VALS];
+          if (vals[SCR_IOHIST_COUNT] == 0.0 || vals[SCR_IOHIST_LAT_P99] <= best_p99) {
+            continue;
+          }
+          int j, picked = 0;
+          for (j = 0; j < k; j++) {
+            if (picks[op * top + j] == r) {
+              picked = 1;
+              break;
+            }
+          }
+          if (! picked) {
+            best = r;
+            best_p99 = vals[SCR_IOHIST_LAT_P99];
+          }
+        }
+        picks[op * top + k] = best;
+
+        /* add rank to the list of slow ranks if it's new */
+        if (best >= 0) {
+          int j, found = 0;
+          for (j = 0; j < nslow; j++) {
+            if (slow[j] == best) {
+              found = 1;
+              break;
+            }
+          }
+          if (! found) {
+            slow[nslow++] = best;
+          }
+        }
+      }
+    }
+  }
+
+  /* get host names of slow ranks so the report can name bad nodes */
+  MPI_Bcast(&nslow, 1, MPI_INT, 0, comm);
+  if (nslow > 0) {
+    MPI_Bcast(slow, nslow, MPI_INT, 0, comm);
+  }
+  char** hosts = NULL;
+  if (rank == 0 && nslow > 0) {
+    hosts = (char**) SCR_MALLOC(nslow * sizeof(char*));
+  }
+  int k;
+  for (k = 0; k < nslow; k++) {
+    if (rank == 0) {
+      if (slow[k] == 0) {
+        hosts[k] = strdup(scr_my_hostname);
+      } else {
+        MPI_Status status;
+        MPI_Probe(slow[k], SCR_IOHIST_TAG, comm, &status);
+        int count;
+        MPI_Get_count(&status, MPI_CHAR, &count);
+        hosts[k] = (char*) SCR_MALLOC(count);
+        MPI_Recv(hosts[k], count, MPI_CHAR, slow[k], SCR_IOHIST_TAG, comm, MPI_STATUS_IGNORE);
+      }
+    } else if (slow[k] == rank) {
+      MPI_Send(scr_my_hostname, strlen(scr_my_hostname) + 1, MPI_CHAR, 0, SCR_IOHIST_TAG, comm);
+    }
+  }
+
+  if (rank == 0) {
+    for (op = 0; op < SCR_IOHIST_OPS; op++) {
+      const char* name = scr_iohist_names[op];
+      const uint64_t* lat = all + (op * SCR_IOHIST_METRICS + SCR_IOHIST_LAT) * SCR_IOHIST_BINS;
+      const uint64_t* bw  = all + (op * SCR_IOHIST_METRICS + SCR_IOHIST_BW)  * SCR_IOHIST_BINS;
+      uint64_t count = scr_iohist_total(lat);
+      if (count == 0) {
+        continue;
+      }
+
+      double lat_p50 = scr_iohist_percentile(lat, 0.50) / 1000000.0;
+      scr_dbg(0, "I/O %s: %llu operations, latency p50 %f p90 %f p99 %f max %f secs, bandwidth p50 %f p1 %f MB/s",
+        name, (unsigned long long) count, lat_p50,
+        scr_iohist_percentile(lat, 0.90) / 1000000.0,
+        scr_iohist_percentile(lat, 0.99) / 1000000.0,
+        scr_iohist_percentile(lat, 1.00) / 1000000.0,
+        scr_iohist_percentile(bw,  0.50) / 1024.0,
+        scr_iohist_percentile(bw,  0.01) / 1024.0
+      );
+
+      /* list the slowest ranks against the system-wide median */
+      for (k = 0; k < top; k++) {
+        int r = picks[op * top + k];
+        if (r < 0) {
+          break;
+        }
+        int j;
+        const char* host = "";
+        for (j = 0; j < nslow; j++) {
+          if (slow[j] == r) {
+            host = hosts[j];
+            break;
+          }
+        }
+        const double* vals = &summaries[(r * SCR_IOHIST_OPS + op) * SCR_IOHIST_VALS];
+        double ratio = (lat_p50 > 0.0) ? vals[SCR_IOHIST_LAT_P99] / lat_p50 : 0.0;
+        scr_dbg(0, "Slow %s on rank %d on %s: %d operations, latency p50 %f p99 %f max %f secs (p99 %.1fx system p50), bandwidth p50 %f MB/s",
+          name, r, host, (int) vals[SCR_IOHIST_COUNT],
+          vals[SCR_IOHIST_LAT_P50], vals[SCR_IOHIST_LAT_P99], vals[SCR_IOHIST_LAT_MAX],
+          ratio, vals[SCR_IOHIST_BW_P50] / (1024.0 * 1024.0)
+        );
+
+        /* record slow hosts in the log so that bad devices can be found across jobs */
+        if (scr_log_enable) {
+          double p99 = vals[SCR_IOHIST_LAT_P99];
+          scr_log_event("IOHIST_SLOW", host, NULL, name, NULL, &p99);
+        }
+      }
+    }
+  }
+
+  for (k = 0; k < nslow && hosts != NULL; k++) {
+    scr_free(&hosts[k]);
+  }
+  scr_free(&hosts);
+  scr_free(&slow);
+  scr_free(&picks);
+  scr_free(&summaries);
+  scr_free(&all);
+  scr_free(&mine);
+
+  return SCR_SUCCESS;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+
+#ifndef SCR_IOHIST_H
+#define SCR_IOHIST_H
+
+#include "mpi.h"
+
+/*
+=========================================
+This file keeps histograms of the latency and bandwidth of each file
+operation on each rank, such as the write of a dataset into cache or
+the copy and checksum of a file.  As in HDR histograms, each power of
+two is split into a fixed number of linear buckets, so percentiles
+keep the same relative precision from microseconds to hours at a fixed
+cost in memory.  A report merges the histograms of all ranks for
+system-wide percentiles and lists the ranks with the slowest files,
+along with their hosts, so that bad cache devices can be drained
+before they stall every checkpoint.
+=========================================
+*/
+
+/* kinds of file operations we track */
+#define SCR_IOHIST_WRITE (0) /* application writing its files of a dataset to cache */
+#define SCR_IOHIST_COPY  (1) /* copying a file between cache and the prefix directory */
+#define SCR_IOHIST_CRC   (2) /* computing the checksum of a file */
+#define SCR_IOHIST_OPS   (3)
+
+/* record that the calling rank moved bytes in secs for one operation,
+ * this is thread safe and does nothing unless SCR_IOHIST is set */
+void scr_iohist_record(int op, double bytes, double secs);
+
+/* record a file copy, set as scr_io_copy_hook so every copy is counted */
+void scr_iohist_record_copy(double bytes, double secs);
+
+/* merge histograms across comm, print percentiles along with the
+ * slowest ranks on rank 0, and log each slow rank, this is collective */
+int scr_iohist_report(MPI_Comm comm);
+
+#endif
@@ -49,6 +49,8 @@ Define common hash key strings
 #define SCR_KEY_SIZE      ("SIZE")
 #define SCR_KEY_OFFSET    ("OFFSET")
 #define SCR_KEY_LENGTH    ("LENGTH")
+#define SCR_KEY_SHARED    ("SHARED")
+#define SCR_KEY_EXTENT    ("EXTENT")
 #define SCR_KEY_RANK      ("RANK")
 #define SCR_KEY_RANKS     ("RANKS")
 #define SCR_KEY_DIRECTORY ("DIR")
@@ -111,6 +113,7 @@ Define common hash key strings
 #define SCR_FLUSH_KEY_LOCATION ("LOCATION")
 #define SCR_FLUSH_KEY_LOCATION_CACHE    ("CACHE")
 #define SCR_FLUSH_KEY_LOCATION_PFS      ("PFS")
+#define SCR_FLUSH_KEY_LOCATION_DRAIN    ("DRAIN")
 #define SCR_FLUSH_KEY_LOCATION_FLUSHING ("FLUSHING")
 #define SCR_FLUSH_KEY_LOCATION_SYNC_FLUSHING ("SYNC_FLUSHING")
 #define SCR_FLUSH_KEY_DIRECTORY ("DIR")
@@ -149,6 +152,8 @@ Define common hash key strings
 #define SCR_CONFIG_KEY_STOREDESC  ("STORE")
 #define SCR_CONFIG_KEY_CACHEDESC  ("CACHE")
 #define SCR_CONFIG_KEY_COUNT      ("COUNT")
+#define SCR_CONFIG_KEY_BYTES      ("BYTES")
+#define SCR_CONFIG_KEY_ARENA      ("ARENA")
 #define SCR_CONFIG_KEY_NAME       ("NAME")
 #define SCR_CONFIG_KEY_BASE       ("BASE")
 #define SCR_CONFIG_KEY_STORE      ("STORE")
@@ -166,6 +171,8 @@ Define common hash key strings
 #define SCR_CONFIG_KEY_FAIL_GROUP ("FAIL_GROUP")
 #define SCR_CONFIG_KEY_SET_SIZE     ("SET_SIZE")
 #define SCR_CONFIG_KEY_SET_FAILURES ("SET_FAILURES")
+#define SCR_CONFIG_KEY_SET_GROUP    ("SET_GROUP")
+#define SCR_CONFIG_KEY_STRIPE       ("STRIPE")
 #define SCR_CONFIG_KEY_GROUPS     ("GROUPS")
 #define SCR_CONFIG_KEY_GROUP_ID   ("GROUP_ID")
 #define SCR_CONFIG_KEY_GROUP_SIZE ("GROUP_SIZE")
@@ -173,6 +180,17 @@ Define common hash key strings
 #define SCR_CONFIG_KEY_MKDIR      ("MKDIR")
 #define SCR_CONFIG_KEY_FLUSH      ("FLUSH")
 #define SCR_CONFIG_KEY_VIEW       ("VIEW")
+#define SCR_CONFIG_KEY_DIRECT     ("DIRECT")
+#define SCR_CONFIG_KEY_CRC_THREADS ("CRC_THREADS")
+#define SCR_CONFIG_KEY_COMPRESS   ("COMPRESS")
+#define SCR_CONFIG_KEY_MEMORY     ("MEMORY")
+#define SCR_CONFIG_KEY_NUMA       ("NUMA")
+#define SCR_CONFIG_KEY_DEDUP      ("DEDUP")
+#define SCR_CONFIG_KEY_CACHE_COMPRESS ("CACHE_COMPRESS")
+#define SCR_CONFIG_KEY_STRIPE_BYTES ("STRIPE_BYTES")
+#define SCR_CONFIG_KEY_STRIPE_MAX   ("STRIPE_MAX")
+#define SCR_CONFIG_KEY_STRIPE_SIZE  ("STRIPE_SIZE")
+#define SCR_CONFIG_KEY_MDT_COUNT    ("MDT_COUNT")
 
 #define SCR_META_KEY_CKPT     ("CKPT")
 #define SCR_META_KEY_RANKS    ("RANKS")
@@ -182,6 +200,16 @@ Define common hash key strings
 #define SCR_META_KEY_NAME     ("NAME")
 #define SCR_META_KEY_SIZE     ("SIZE")
 #define SCR_META_KEY_CRC      ("CRC")
+#define SCR_META_KEY_CHECKSUM      ("CHECKSUM")
+#define SCR_META_KEY_CHECKSUM_TYPE ("CHECKSUM_TYPE")
+#define SCR_META_KEY_COMPRESS ("COMPRESS")
+#define SCR_META_KEY_COMPSIZE ("COMPSIZE")
+#define SCR_META_KEY_CACHE_COMPRESS ("CACHE_COMPRESS")
+#define SCR_META_KEY_CACHE_COMPSIZE ("CACHE_COMPSIZE")
+#define SCR_META_KEY_DELTA    ("DELTA")
+#define SCR_META_KEY_FETCH    ("FETCH")
+#define SCR_META_KEY_DEDUP    ("DEDUP")
+#define SCR_META_KEY_THROUGH  ("THROUGH")
 #define SCR_META_KEY_COMPLETE ("COMPLETE")
 #define SCR_META_KEY_MODE     ("MODE")
 #define SCR_META_KEY_UID      ("UID")
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#include "scr_globals.h"
+
+#include "spath.h"
+
+#ifdef HAVE_LUSTREAPI
+#include <lustre/lustreapi.h>
+#endif
+
+/* return number of stripes to give a file of size bytes flushed
+ * from store s, returns 0 to keep the default layout */
+int scr_layout_stripe_count(const scr_storedesc* s, unsigned long size)
+{
+  if (s == NULL || s->stripe_bytes == 0) {
+    return 0;
+  }
+
+  /* one stripe for each stripe_bytes of the file, at least one */
+  unsigned long count = (size + s->stripe_bytes - 1) / s->stripe_bytes;
+  if (count < 1) {
+    count = 1;
+  }
+  if (s->stripe_max > 0 && count > (unsigned long) s->stripe_max) {
+    count = (unsigned long) s->stripe_max;
+  }
+  return (int) count;
+}
+
+/* create an empty file with a layout picked from its size in bytes,
+ * the transfer that follows writes into the file and keeps its layout */
+int scr_layout_file_create(const scr_storedesc* s, const char* file, unsigned long size)
+{
+  int count = scr_layout_stripe_count(s, size);
+  if (count == 0) {
+    return SCR_SUCCESS;
+  }
+
+#ifdef HAVE_LUSTREAPI
+  /* a layout can only be set on a new file, so drop any file
+   * left from an earlier flush that the transfer would overwrite */
+  unlink(file);
+
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int fd = llapi_file_open(file, O_WRONLY | O_CREAT, mode_file,
+    (unsigned long long) s->stripe_size, -1, count, LOV_PATTERN_RAID0
+  );
+  if (fd < 0) {
+    /* the transfer creates the file with the default layout */
+    scr_dbg(2, "Failed to set layout of %s with %d stripes: %s @ %s:%d",
+      file, count, strerror(-fd), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+  scr_close(file, fd);
+#endif
+
+  return SCR_SUCCESS;
+}
+
+/* create directory along with any missing parents, placing the
+ * directory itself on metadata target mdt, use mdt < 0 for default */
+int scr_layout_dir_create(const char* dir, mode_t mode, int mdt)
+{
+#ifdef HAVE_LUSTREAPI
+  if (mdt >= 0 && access(dir, F_OK) < 0) {
+    /* create parents as usual */
+    spath* parent_path = spath_from_str(dir);
+    spath_dirname(parent_path);
+    char* parent = spath_strdup(parent_path);
+    spath_delete(&parent_path);
+    int rc = scr_mkdir(parent, mode);
+    scr_free(&parent);
+
+    /* then create the directory itself on the given MDT */
+    if (rc == SCR_SUCCESS) {
+      int ret = llapi_dir_create_pool(dir, mode, mdt, 1, 0, NULL);
+      if (ret == 0 || ret == -EEXIST) {
+        return SCR_SUCCESS;
+      }
+      scr_dbg(2, "Failed to create %s on MDT %d: %s @ %s:%d",
+        dir, mdt, strerror(-ret), __FILE__, __LINE__
+      );
+    }
+  }
+#endif
+
+  return scr_mkdir(dir, mode);
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_LAYOUT_H
+#define SCR_LAYOUT_H
+
+#include <sys/types.h>
+#include "scr_storedesc.h"
+
+/*
+=========================================
+This file sets the layout of files and directories that are flushed to
+the parallel file system.  On Lustre, each file is created with a
+stripe count picked from its size under the rules of the store it is
+flushed from, so large files spread over many OSTs while small files
+stay on one.  Directories can be spread across metadata targets (DNE)
+so that datasets with many directories do not load a single MDT.
+Without liblustreapi, or on other file systems, these calls fall back
+to the default layout.
+=========================================
+*/
+
+/* return number of stripes to give a file of size bytes flushed
+ * from store s, returns 0 to keep the default layout */
+int scr_layout_stripe_count(const scr_storedesc* s, unsigned long size);
+
+/* create an empty file with a layout picked from its size in bytes,
+ * the transfer that follows writes into the file and keeps its layout */
+int scr_layout_file_create(const scr_storedesc* s, const char* file, unsigned long size);
+
+/* create directory along with any missing parents, placing the
+ * directory itself on metadata target mdt, use mdt < 0 for default */
+int scr_layout_dir_create(const char* dir, mode_t mode, int mdt);
+
+#endif
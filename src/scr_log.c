@@ -51,6 +51,7 @@
 #include <string.h>
 #include <strings.h>
 #include <errno.h>
+#include <stdarg.h>
 
 /* gettimeofday */
 #include <sys/time.h>
@@ -60,6 +61,8 @@
 
 #include <syslog.h>
 
+#include <pthread.h>
+
 #ifdef HAVE_LIBMYSQLCLIENT
 #include <mysql.h>
 #endif
@@ -74,6 +77,11 @@ static int   txt_initialized = 0;                  /* flag indicating whether we
 static char* txt_name        = NULL;               /* name of log file */
 static int   txt_fd          = -1;                 /* file descriptor of log file */
 
+static int   json_enable      = SCR_LOG_JSON_ENABLE; /* whether to log event as a JSON record */
+static int   json_initialized = 0;                   /* flag indicating whether we have opened the JSON log */
+static char* json_name        = NULL;                /* name of JSON log file */
+static int   json_fd          = -1;                  /* file descriptor of JSON log file */
+
 static int syslog_enable = SCR_LOG_SYSLOG_ENABLE; /* whether to write log messages to syslog */
 
 static int db_enable = 0;    /* whether to log event in SCR log database */
@@ -424,8 +432,41 @@ int scr_mysql_type_id(const char* type, int* id)
   return SCR_SUCCESS;
 }
 
-/* records an SCR event in the SCR log database */
-int scr_mysql_log_event(
+#ifdef HAVE_LIBMYSQLCLIENT
+/* leading part of statements that insert rows into the events and transfers tables */
+#define SCR_MYSQL_EVENTS_INSERT \
+  "INSERT" \
+  " INTO `events`" \
+  " (`id`,`job_id`,`type_id`,`dset_id`,`dset_name`,`start`,`secs`,`note`)" \
+  " VALUES"
+
+#define SCR_MYSQL_TRANSFERS_INSERT \
+  "INSERT" \
+  " INTO `transfers`" \
+  " (`id`,`job_id`,`type_id`,`dset_id`,`dset_name`,`start`,`end`,`secs`,`bytes`,`bw`,`files`,`from`,`to`)" \
+  " VALUES"
+
+/* execute the given query */
+static int scr_mysql_query(const char* query)
+{
+  if (db_debug >= 1) {
+    scr_dbg(0, "%s", query);
+  }
+  if (mysql_real_query(&scr_mysql, query, (unsigned int) strlen(query))) {
+    scr_err("Insert failed, query = (%s), error = (%s) @ %s:%d",
+            query, mysql_error(&scr_mysql), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
+#endif
+
+#ifdef HAVE_LIBMYSQLCLIENT
+/* fill in buf with the row of values for an event in the events table */
+static int scr_mysql_event_values(
+  char* buf,
+  size_t size,
   const char* type,
   const char* note,
   const int* dset,
@@ -433,7 +474,6 @@ int scr_mysql_log_event(
   const time_t* start,
   const double* secs)
 {
-#ifdef HAVE_LIBMYSQLCLIENT
   /* lookup the id for the type string */
   int type_id = -1;
   if (scr_mysql_type_id(type, &type_id) == SCR_FAILURE) {
@@ -462,50 +502,63 @@ int scr_mysql_log_event(
     return SCR_FAILURE;
   }
 
-  /* construct the query */
-  char query[4096];
-  int n = snprintf(query, sizeof(query),
-    "INSERT"
-    " INTO `events`"
-    " (`id`,`job_id`,`type_id`,`dset_id`,`dset_name`,`start`,`secs`,`note`)"
-    " VALUES"
-    " (NULL, %lu, %d, %s, %s, %s, %s, %s)"
-    " ;",
+  /* construct the row */
+  int n = snprintf(buf, size,
+    " (NULL, %lu, %d, %s, %s, %s, %s, %s)",
     scr_db_jobid, type_id, qdset, qname, qstart, qsecs, qnote
   );
 
-  /* free the strings as they are now encoded into the query */
+  /* free the strings as they are now encoded into the row */
   scr_free(&qnote);
   scr_free(&qdset);
   scr_free(&qname);
   scr_free(&qstart);
   scr_free(&qsecs);
 
-  /* check that we were able to construct the query ok */
-  if (n >= sizeof(query)) {
+  /* check that we were able to construct the row ok */
+  if (n >= size) {
     scr_err("Insufficient buffer space (%lu bytes) to build query (%lu bytes) @ %s:%d",
-            sizeof(query), n, __FILE__, __LINE__
+            size, n, __FILE__, __LINE__
     );
     return SCR_FAILURE;
   }
 
-  /* execute the query */
-  if (db_debug >= 1) {
-    scr_dbg(0, "%s", query);
-  }
-  if (mysql_real_query(&scr_mysql, query, (unsigned int) strlen(query))) {
-    scr_err("Insert failed, query = (%s), error = (%s) @ %s:%d",
-            query, mysql_error(&scr_mysql), __FILE__, __LINE__
-    );
+  return SCR_SUCCESS;
+}
+#endif
+
+/* records an SCR event in the SCR log database */
+int scr_mysql_log_event(
+  const char* type,
+  const char* note,
+  const int* dset,
+  const char* name,
+  const time_t* start,
+  const double* secs)
+{
+#ifdef HAVE_LIBMYSQLCLIENT
+  char values[4096];
+  if (scr_mysql_event_values(values, sizeof(values), type, note, dset, name, start, secs) != SCR_SUCCESS) {
     return SCR_FAILURE;
   }
 
+  /* construct the query */
+  char query[4096 + 256];
+  snprintf(query, sizeof(query), "%s%s ;", SCR_MYSQL_EVENTS_INSERT, values);
+
+  /* execute the query */
+  if (scr_mysql_query(query) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
 #endif
   return SCR_SUCCESS;
 }
 
-/* records an SCR file transfer (copy/fetch/flush/drain) in the SCR log database */
-int scr_mysql_log_transfer(
+#ifdef HAVE_LIBMYSQLCLIENT
+/* fill in buf with the row of values for a transfer in the transfers table */
+static int scr_mysql_transfer_values(
+  char* buf,
+  size_t size,
   const char* type,
   const char* from,
   const char* to,
@@ -516,7 +569,6 @@ int scr_mysql_log_transfer(
   const double* bytes,
   const int* files)
 {
-#ifdef HAVE_LIBMYSQLCLIENT
   /* lookup the id for the type string */
   int type_id = -1;
   if (scr_mysql_type_id(type, &type_id) == SCR_FAILURE) {
@@ -572,19 +624,13 @@ int scr_mysql_log_transfer(
     return SCR_FAILURE;
   }
 
-  /* construct the query */
-  char query[4096];
-  int n = snprintf(query, sizeof(query),
-    "INSERT"
-    " INTO `transfers`"
-    " (`id`,`job_id`,`type_id`,`dset_id`,`dset_name`,`start`,`end`,`secs`,`bytes`,`bw`,`files`,`from`,`to`)"
-    " VALUES"
-    " (NULL, %lu, %d, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s)"
-    " ;",
+  /* construct the row */
+  int n = snprintf(buf, size,
+    " (NULL, %lu, %d, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s)",
     scr_db_jobid, type_id, qdset, qname, qstart, qend, qsecs, qbytes, qbw, qfiles, qfrom, qto
   );
 
-  /* free the strings as they are now encoded into the query */
+  /* free the strings as they are now encoded into the row */
   scr_free(&qfrom);
   scr_free(&qto);
   scr_free(&qdset);
@@ -596,25 +642,46 @@ int scr_mysql_log_transfer(
   scr_free(&qbw);
   scr_free(&qfiles);
 
-  /* check that we were able to construct the query ok */
-  if (n >= sizeof(query)) {
+  /* check that we were able to construct the row ok */
+  if (n >= size) {
     scr_err("Insufficient buffer space (%lu bytes) to build query (%lu bytes) @ %s:%d",
-            sizeof(query), n, __FILE__, __LINE__
+            size, n, __FILE__, __LINE__
     );
     return SCR_FAILURE;
   }
 
-  /* execute the query */
-  if (db_debug >= 1) {
-    scr_dbg(0, "%s", query);
-  }
-  if (mysql_real_query(&scr_mysql, query, (unsigned int) strlen(query))) {
-    scr_err("Insert failed, query = (%s), error = (%s) @ %s:%d",
-            query, mysql_error(&scr_mysql), __FILE__, __LINE__
-    );
+  return SCR_SUCCESS;
+}
+#endif
+
+/* records an SCR file transfer (copy/fetch/flush/drain) in the SCR log database */
+int scr_mysql_log_transfer(
+  const char* type,
+  const char* from,
+  const char* to,
+  const int* dset,
+  const char* name,
+  const time_t* start,
+  const double* secs,
+  const double* bytes,
+  const int* files)
+{
+#ifdef HAVE_LIBMYSQLCLIENT
+  char values[4096];
+  if (scr_mysql_transfer_values(values, sizeof(values),
+        type, from, to, dset, name, start, secs, bytes, files) != SCR_SUCCESS)
+  {
     return SCR_FAILURE;
   }
 
+  /* construct the query */
+  char query[4096 + 256];
+  snprintf(query, sizeof(query), "%s%s ;", SCR_MYSQL_TRANSFERS_INSERT, values);
+
+  /* execute the query */
+  if (scr_mysql_query(query) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
 #endif
   return SCR_SUCCESS;
 }
@@ -774,6 +841,500 @@ int scr_mysql_register_job(
   return rc;
 }
 
+/*
+=========================================
+Log queue functions
+=========================================
+*/
+
+/* kinds of log records */
+#define SCR_LOG_REC_EVENT    (0)
+#define SCR_LOG_REC_TRANSFER (1)
+
+/* a log entry, along with the lines we write to the text log
+ * and syslog and the fields we insert into the database */
+typedef struct {
+  int    kind;         /* SCR_LOG_REC_EVENT or SCR_LOG_REC_TRANSFER */
+  char*  txt;          /* line for text log, NULL if none */
+  char*  json;         /* line for JSON log, NULL if none */
+  char*  syslog;       /* line for syslog, NULL if none */
+  int    syslog_level; /* level to file syslog line under */
+  int    db;           /* whether to insert a row in the database */
+  char*  type;         /* event or transfer type */
+  char*  note;         /* note of event, or source of transfer */
+  char*  to;           /* destination of transfer */
+  char*  name;         /* dataset name */
+  int    has_dset,  dset;
+  int    has_start; time_t start;
+  int    has_secs;  double secs;
+  int    has_bytes; double bytes;
+  int    has_files; int files;
+} scr_log_rec;
+
+static pthread_t       scr_log_thread;
+static pthread_mutex_t scr_log_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  scr_log_cond = PTHREAD_COND_INITIALIZER; /* signals new records or stop */
+static pthread_cond_t  scr_log_done = PTHREAD_COND_INITIALIZER; /* signals drained queue */
+static int             scr_log_started = 0; /* whether thread is running */
+static int             scr_log_stop    = 0; /* tells thread to exit */
+static int             scr_log_busy    = 0; /* set while thread writes a batch */
+static scr_log_rec**   scr_log_ring    = NULL; /* ring buffer of queued records */
+static int             scr_log_size    = 0; /* capacity of ring */
+static int             scr_log_head    = 0; /* index of oldest record */
+static int             scr_log_count   = 0; /* number of queued records */
+static unsigned long   scr_log_dropped = 0; /* records dropped because the queue was full */
+
+/* allocate a new log record of the given kind */
+static scr_log_rec* scr_log_rec_new(int kind)
+{
+  scr_log_rec* rec = (scr_log_rec*) calloc(1, sizeof(scr_log_rec));
+  if (rec == NULL) {
+    scr_err("Failed to allocate log record @ %s:%d",
+            __FILE__, __LINE__
+    );
+    return NULL;
+  }
+  rec->kind = kind;
+  rec->syslog_level = LOG_INFO;
+  return rec;
+}
+
+/* strdup a string that may be NULL */
+static char* scr_log_strdup(const char* str)
+{
+  return (str != NULL) ? strdup(str) : NULL;
+}
+
+/* record the fields of an event or transfer to insert in the database */
+static void scr_log_rec_set_db(
+  scr_log_rec* rec,
+  const char* type,
+  const char* note,
+  const char* to,
+  const int* dset,
+  const char* name,
+  const time_t* start,
+  const double* secs,
+  const double* bytes,
+  const int* files)
+{
+  rec->db   = 1;
+  rec->type = scr_log_strdup(type);
+  rec->note = scr_log_strdup(note);
+  rec->to   = scr_log_strdup(to);
+  rec->name = scr_log_strdup(name);
+  if (dset  != NULL) { rec->has_dset  = 1; rec->dset  = *dset;  }
+  if (start != NULL) { rec->has_start = 1; rec->start = *start; }
+  if (secs  != NULL) { rec->has_secs  = 1; rec->secs  = *secs;  }
+  if (bytes != NULL) { rec->has_bytes = 1; rec->bytes = *bytes; }
+  if (files != NULL) { rec->has_files = 1; rec->files = *files; }
+}
+
+/* free a log record */
+static void scr_log_rec_delete(scr_log_rec** ptr_rec)
+{
+  scr_log_rec* rec = *ptr_rec;
+  if (rec != NULL) {
+    scr_free(&rec->txt);
+    scr_free(&rec->json);
+    scr_free(&rec->syslog);
+    scr_free(&rec->type);
+    scr_free(&rec->note);
+    scr_free(&rec->to);
+    scr_free(&rec->name);
+    scr_free(ptr_rec);
+  }
+}
+
+#ifdef HAVE_LIBMYSQLCLIENT
+/* cap on the size of a multi-row insert statement */
+#define SCR_LOG_BATCH_BYTES (64 * 1024)
+
+/* a multi-row insert statement being built */
+typedef struct {
+  const char* insert; /* leading part of statement */
+  char*  query;       /* statement built so far */
+  size_t len;         /* length of statement */
+  int    rows;        /* number of rows in statement */
+} scr_log_batch;
+
+/* execute the rows we have added to batch, if any */
+static int scr_log_batch_flush(scr_log_batch* b)
+{
+  int rc = SCR_SUCCESS;
+  if (b->rows > 0) {
+    strcpy(b->query + b->len, " ;");
+    rc = scr_mysql_query(b->query);
+  }
+  b->len  = 0;
+  b->rows = 0;
+  return rc;
+}
+
+/* add a row to batch, executing the statement once it gets large */
+static int scr_log_batch_add(scr_log_batch* b, const char* values)
+{
+  int rc = SCR_SUCCESS;
+
+  size_t n = strlen(values);
+  if (b->rows > 0 && b->len + 1 + n + 3 > SCR_LOG_BATCH_BYTES) {
+    rc = scr_log_batch_flush(b);
+  }
+
+  if (b->rows == 0) {
+    strcpy(b->query, b->insert);
+    b->len = strlen(b->query);
+  } else {
+    b->query[b->len++] = ',';
+  }
+  strcpy(b->query + b->len, values);
+  b->len += n;
+  b->rows++;
+
+  return rc;
+}
+#endif
+
+/* append the text log lines, or JSON log lines if json is set,
+ * of a batch of records to a file with a single write */
+static void scr_log_write_lines(const char* name, int fd, scr_log_rec** recs, int count, int json)
+{
+  size_t total = 0;
+  int i;
+  for (i = 0; i < count; i++) {
+    const char* line = json ? recs[i]->json : recs[i]->txt;
+    if (line != NULL) {
+      total += strlen(line);
+    }
+  }
+  if (total == 0) {
+    return;
+  }
+
+  char* buf = (char*) malloc(total + 1);
+  if (buf == NULL) {
+    return;
+  }
+  size_t len = 0;
+  for (i = 0; i < count; i++) {
+    const char* line = json ? recs[i]->json : recs[i]->txt;
+    if (line != NULL) {
+      size_t n = strlen(line);
+      memcpy(buf + len, line, n);
+      len += n;
+    }
+  }
+  scr_write(name, fd, buf, len);
+  scr_free(&buf);
+}
+
+/* write a batch of records to each of our logs,
+ * with one write to each log file and one insert per table */
+static int scr_log_write_recs(scr_log_rec** recs, int count)
+{
+  int rc = SCR_SUCCESS;
+  int i;
+
+  if (txt_enable && txt_fd >= 0) {
+    scr_log_write_lines(txt_name, txt_fd, recs, count, 0);
+  }
+
+  if (json_enable && json_fd >= 0) {
+    scr_log_write_lines(json_name, json_fd, recs, count, 1);
+  }
+
+  if (syslog_enable) {
+    for (i = 0; i < count; i++) {
+      if (recs[i]->syslog != NULL) {
+        syslog(recs[i]->syslog_level, "%s", recs[i]->syslog);
+      }
+    }
+  }
+
+#ifdef HAVE_LIBMYSQLCLIENT
+  if (db_enable) {
+    char* events_query    = (char*) malloc(SCR_LOG_BATCH_BYTES + 4096);
+    char* transfers_query = (char*) malloc(SCR_LOG_BATCH_BYTES + 4096);
+    if (events_query == NULL || transfers_query == NULL) {
+      scr_err("Failed to allocate buffer for database insert @ %s:%d",
+              __FILE__, __LINE__
+      );
+      scr_free(&events_query);
+      scr_free(&transfers_query);
+      return SCR_FAILURE;
+    }
+    scr_log_batch events    = {SCR_MYSQL_EVENTS_INSERT,    events_query,    0, 0};
+    scr_log_batch transfers = {SCR_MYSQL_TRANSFERS_INSERT, transfers_query, 0, 0};
+
+    for (i = 0; i < count; i++) {
+      scr_log_rec* r = recs[i];
+      if (! r->db) {
+        continue;
+      }
+
+      const int*    dset  = r->has_dset  ? &r->dset  : NULL;
+      const time_t* start = r->has_start ? &r->start : NULL;
+      const double* secs  = r->has_secs  ? &r->secs  : NULL;
+      const double* bytes = r->has_bytes ? &r->bytes : NULL;
+      const int*    files = r->has_files ? &r->files : NULL;
+
+      char values[4096];
+      if (r->kind == SCR_LOG_REC_EVENT) {
+        if (scr_mysql_event_values(values, sizeof(values),
+              r->type, r->note, dset, r->name, start, secs) != SCR_SUCCESS ||
+            scr_log_batch_add(&events, values) != SCR_SUCCESS)
+        {
+          rc = SCR_FAILURE;
+        }
+      } else {
+        if (scr_mysql_transfer_values(values, sizeof(values),
+              r->type, r->note, r->to, dset, r->name, start, secs, bytes, files) != SCR_SUCCESS ||
+            scr_log_batch_add(&transfers, values) != SCR_SUCCESS)
+        {
+          rc = SCR_FAILURE;
+        }
+      }
+    }
+
+    if (scr_log_batch_flush(&events) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+    if (scr_log_batch_flush(&transfers) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+
+    scr_free(&events_query);
+    scr_free(&transfers_query);
+  }
+#endif
+
+  return rc;
+}
+
+/* write out all queued records in batches until told to stop */
+static void* scr_log_run_thread(void* arg)
+{
+  scr_log_rec** recs = (scr_log_rec**) malloc(scr_log_size * sizeof(scr_log_rec*));
+  if (recs == NULL) {
+    return NULL;
+  }
+
+  pthread_mutex_lock(&scr_log_lock);
+  while (1) {
+    while (scr_log_count == 0 && ! scr_log_stop) {
+      pthread_cond_wait(&scr_log_cond, &scr_log_lock);
+    }
+    if (scr_log_count == 0 && scr_log_stop) {
+      break;
+    }
+
+    /* take everything in the queue, so that callers can add
+     * more records while we write these */
+    int count = scr_log_count;
+    int i;
+    for (i = 0; i < count; i++) {
+      recs[i] = scr_log_ring[(scr_log_head + i) % scr_log_size];
+    }
+    scr_log_head  = (scr_log_head + count) % scr_log_size;
+    scr_log_count = 0;
+    scr_log_busy  = 1;
+    pthread_mutex_unlock(&scr_log_lock);
+
+    scr_log_write_recs(recs, count);
+    for (i = 0; i < count; i++) {
+      scr_log_rec_delete(&recs[i]);
+    }
+
+    pthread_mutex_lock(&scr_log_lock);
+    scr_log_busy = 0;
+    pthread_cond_broadcast(&scr_log_done);
+  }
+  pthread_mutex_unlock(&scr_log_lock);
+
+  scr_free(&recs);
+  return NULL;
+}
+
+/* write a record to the logs, or queue it for our thread if it is
+ * running, in which case the record is dropped if the queue is full,
+ * frees the record */
+static int scr_log_submit(scr_log_rec* rec)
+{
+  if (rec == NULL) {
+    return SCR_FAILURE;
+  }
+
+  if (! scr_log_started) {
+    int rc = scr_log_write_recs(&rec, 1);
+    scr_log_rec_delete(&rec);
+    return rc;
+  }
+
+  pthread_mutex_lock(&scr_log_lock);
+  if (scr_log_count < scr_log_size) {
+    scr_log_ring[(scr_log_head + scr_log_count) % scr_log_size] = rec;
+    scr_log_count++;
+    rec = NULL;
+    pthread_cond_signal(&scr_log_cond);
+  } else {
+    /* rather than wait on a slow log, drop the record */
+    scr_log_dropped++;
+  }
+  pthread_mutex_unlock(&scr_log_lock);
+
+  scr_log_rec_delete(&rec);
+  return SCR_SUCCESS;
+}
+
+/* wait for our thread to write all queued records */
+static void scr_log_wait(void)
+{
+  if (! scr_log_started) {
+    return;
+  }
+
+  pthread_mutex_lock(&scr_log_lock);
+  while (scr_log_count > 0 || scr_log_busy) {
+    pthread_cond_wait(&scr_log_done, &scr_log_lock);
+  }
+  pthread_mutex_unlock(&scr_log_lock);
+}
+
+/* start a thread to write log records in batches, queuing at most
+ * size records before dropping new ones */
+int scr_log_init_async(int size)
+{
+  if (scr_log_started || size <= 0) {
+    return SCR_SUCCESS;
+  }
+
+  scr_log_ring = (scr_log_rec**) calloc(size, sizeof(scr_log_rec*));
+  if (scr_log_ring == NULL) {
+    scr_err("Failed to allocate log queue of %d records @ %s:%d",
+            size, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+  scr_log_size    = size;
+  scr_log_head    = 0;
+  scr_log_count   = 0;
+  scr_log_stop    = 0;
+  scr_log_dropped = 0;
+
+  if (pthread_create(&scr_log_thread, NULL, scr_log_run_thread, NULL) != 0) {
+    scr_err("Failed to start log thread, logging synchronously @ %s:%d",
+            __FILE__, __LINE__
+    );
+    scr_free(&scr_log_ring);
+    scr_log_size = 0;
+    return SCR_FAILURE;
+  }
+  scr_log_started = 1;
+
+  return SCR_SUCCESS;
+}
+
+/* write out queued records and stop our thread */
+static void scr_log_finalize_async(void)
+{
+  if (! scr_log_started) {
+    return;
+  }
+
+  pthread_mutex_lock(&scr_log_lock);
+  scr_log_stop = 1;
+  pthread_cond_signal(&scr_log_cond);
+  pthread_mutex_unlock(&scr_log_lock);
+
+  pthread_join(scr_log_thread, NULL);
+  scr_log_started = 0;
+
+  if (scr_log_dropped > 0) {
+    scr_warn("Dropped %lu log records because the log queue of %d records was full @ %s:%d",
+             scr_log_dropped, scr_log_size, __FILE__, __LINE__
+    );
+  }
+
+  scr_free(&scr_log_ring);
+  scr_log_size = 0;
+}
+
+/*
+=========================================
+JSON record functions
+=========================================
+*/
+
+/* a JSON log record being built, we drop a record that does not fit
+ * rather than write a line that is not valid JSON */
+typedef struct {
+  char   buf[2048];
+  size_t len;
+  int    overflow;
+} scr_log_json;
+
+/* append formatted text to record */
+static void scr_log_json_raw(scr_log_json* j, const char* format, ...)
+{
+  if (j->overflow) {
+    return;
+  }
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(j->buf + j->len, sizeof(j->buf) - j->len, format, args);
+  va_end(args);
+  if (n < 0 || (size_t) n >= sizeof(j->buf) - j->len) {
+    j->overflow = 1;
+    return;
+  }
+  j->len += (size_t) n;
+}
+
+/* append "key":"value" to record, escaping value, skipped if value is NULL */
+static void scr_log_json_str(scr_log_json* j, const char* key, const char* value)
+{
+  if (value == NULL) {
+    return;
+  }
+  scr_log_json_raw(j, ",\"%s\":\"", key);
+  const unsigned char* c;
+  for (c = (const unsigned char*) value; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') {
+      scr_log_json_raw(j, "\\%c", *c);
+    } else if (*c < 0x20) {
+      scr_log_json_raw(j, "\\u%04x", (unsigned int) *c);
+    } else {
+      scr_log_json_raw(j, "%c", *c);
+    }
+  }
+  scr_log_json_raw(j, "\"");
+}
+
+/* start a record with the fields every record has */
+static void scr_log_json_begin(scr_log_json* j, time_t time, const char* kind, const char* label)
+{
+  j->len      = 0;
+  j->overflow = 0;
+  scr_log_json_raw(j, "{\"time\":%ld", (long) time);
+  scr_log_json_str(j, "host", id_hostname);
+  scr_log_json_str(j, "jobid", id_jobid);
+  scr_log_json_str(j, "type", kind);
+  scr_log_json_str(j, "label", label);
+}
+
+/* finish a record and return a copy of its line, NULL if it did not fit */
+static char* scr_log_json_end(scr_log_json* j)
+{
+  scr_log_json_raw(j, "}\n");
+  if (j->overflow) {
+    scr_err("Dropping JSON log record that exceeds %lu bytes @ %s:%d",
+            (unsigned long) sizeof(j->buf), __FILE__, __LINE__
+    );
+    return NULL;
+  }
+  return strdup(j->buf);
+}
+
 /*
 =========================================
 Log functions
@@ -819,6 +1380,34 @@ int scr_log_init_txt(const char* prefix)
   return rc; 
 }
 
+/* initialize JSON record logging in prefix directory */
+int scr_log_init_json(const char* prefix)
+{
+  json_enable = 1;
+
+  if (! json_initialized) {
+    /* build path to log file */
+    char logname[SCR_MAX_FILENAME];
+    snprintf(logname, sizeof(logname), "%s/.scr/log.json", prefix);
+    json_name = strdup(logname);
+
+    /* open log file */
+    json_fd = scr_open(json_name, O_WRONLY | O_CREAT | O_APPEND, S_IWUSR | S_IRUSR);
+    if (json_fd < 0) {
+      scr_err("Failed to open log file: `%s' errno=%d (%s) @ %s:%d",
+        json_name, errno, strerror(errno), __FILE__, __LINE__
+      );
+      json_enable = 0;
+      scr_free(&json_name);
+      return SCR_FAILURE;
+    }
+
+    json_initialized = 1;
+  }
+
+  return SCR_SUCCESS;
+}
+
 /* initialize syslog logging */
 int scr_log_init_syslog(void)
 {
@@ -882,6 +1471,11 @@ int scr_log_init(const char* prefix)
     syslog_enable = atoi(value);
   }
 
+  /* check whether to log events as JSON records */
+  if ((value = scr_param_get("SCR_LOG_JSON_ENABLE")) != NULL) {
+    json_enable = atoi(value);
+  }
+
   /* check whether SCR logging DB is enabled */
   if ((value = scr_param_get("SCR_LOG_DB_ENABLE")) != NULL) {
     db_enable = atoi(value);
@@ -916,6 +1510,14 @@ int scr_log_init(const char* prefix)
     }
   }
 
+  /* open JSON log file if enabled */
+  if (json_enable) {
+    tmp_rc = scr_log_init_json(prefix);
+    if (tmp_rc != SCR_SUCCESS) {
+      rc = tmp_rc;
+    }
+  }
+
   /* open connection to syslog if we're using it,
    * file messages under "SCR" */
   if (syslog_enable) {
@@ -939,6 +1541,9 @@ int scr_log_init(const char* prefix)
 /* shut down the logging */
 int scr_log_finalize()
 {
+  /* write anything still in the queue */
+  scr_log_finalize_async();
+
   /* close log file if we opened one */
   if (txt_enable) {
     if (txt_fd >= 0) {
@@ -948,6 +1553,15 @@ int scr_log_finalize()
     scr_free(&txt_name);
   }
 
+  /* close JSON log file if we opened one */
+  if (json_enable) {
+    if (json_fd >= 0) {
+      scr_close(json_name, json_fd);
+      json_fd = -1;
+    }
+    scr_free(&json_name);
+  }
+
   /* close syslog if we're using it */
   if (syslog_enable) {
     closelog();
@@ -1019,6 +1633,11 @@ int scr_log_run(time_t start, int procs, int nodes)
 {
   int rc = SCR_SUCCESS;
 
+  scr_log_rec* rec = scr_log_rec_new(SCR_LOG_REC_EVENT);
+  if (rec == NULL) {
+    return SCR_FAILURE;
+  }
+
   struct tm* timeinfo = localtime(&start);
   char timestr[100];
   strftime(timestr, sizeof(timestr), "%s", timeinfo);
@@ -1039,8 +1658,7 @@ int scr_log_run(time_t start, int procs, int nodes)
         buf[sizeof(buf)-2] = '\n';
         buf[sizeof(buf)-1] = '\0';
     }
-    scr_write(txt_name, txt_fd, buf, strlen(buf));
-    //fsync(txt_fd);
+    rec->txt = strdup(buf);
   }
 
   if (syslog_enable) {
@@ -1057,13 +1675,23 @@ int scr_log_run(time_t start, int procs, int nodes)
         buf[sizeof(buf)-2] = '\n';
         buf[sizeof(buf)-1] = '\0';
     }
-    syslog(SCR_LOG_SYSLOG_LEVEL, buf);
+    rec->syslog = strdup(buf);
+    rec->syslog_level = SCR_LOG_SYSLOG_LEVEL;
+  }
+
+  if (json_enable) {
+    scr_log_json j;
+    scr_log_json_begin(&j, start, "event", "START");
+    scr_log_json_raw(&j, ",\"procs\":%d,\"nodes\":%d", procs, nodes);
+    rec->json = scr_log_json_end(&j);
   }
 
   if (db_enable) {
-    rc = scr_mysql_log_event("START", NULL, NULL, NULL, &start, NULL);
+    scr_log_rec_set_db(rec, "START", NULL, NULL, NULL, NULL, &start, NULL, NULL, NULL);
   }
 
+  rc = scr_log_submit(rec);
+
   return rc;
 }
 
@@ -1072,6 +1700,11 @@ int scr_log_halt(const char* reason)
 {
   int rc = SCR_SUCCESS;
 
+  scr_log_rec* rec = scr_log_rec_new(SCR_LOG_REC_EVENT);
+  if (rec == NULL) {
+    return SCR_FAILURE;
+  }
+
   time_t now = scr_log_seconds();
   struct tm* timeinfo = localtime(&now);
   char timestr[100];
@@ -1097,8 +1730,7 @@ int scr_log_halt(const char* reason)
         buf[sizeof(buf)-2] = '\n';
         buf[sizeof(buf)-1] = '\0';
     }
-    scr_write(txt_name, txt_fd, buf, strlen(buf));
-    //fsync(txt_fd);
+    rec->txt = strdup(buf);
   }
 
   if (syslog_enable) {
@@ -1119,13 +1751,25 @@ int scr_log_halt(const char* reason)
         buf[sizeof(buf)-2] = '\n';
         buf[sizeof(buf)-1] = '\0';
     }
-    syslog(LOG_INFO, buf);
+    rec->syslog = strdup(buf);
+  }
+
+  if (json_enable) {
+    scr_log_json j;
+    scr_log_json_begin(&j, now, "event", "HALT");
+    scr_log_json_str(&j, "note", reason);
+    rec->json = scr_log_json_end(&j);
   }
 
   if (db_enable) {
-    rc = scr_mysql_log_event("HALT", reason, NULL, NULL, &now, NULL);
+    scr_log_rec_set_db(rec, "HALT", reason, NULL, NULL, NULL, &now, NULL, NULL, NULL);
   }
 
+  rc = scr_log_submit(rec);
+
+  /* the job may exit right after a halt, so write it out now */
+  scr_log_wait();
+
   return rc;
 }
 
@@ -1140,6 +1784,11 @@ int scr_log_event(
 {
   int rc = SCR_SUCCESS;
 
+  scr_log_rec* rec = scr_log_rec_new(SCR_LOG_REC_EVENT);
+  if (rec == NULL) {
+    return SCR_FAILURE;
+  }
+
   int    dset_val  = (dset  != NULL) ? *dset  : -1;
   double secs_val  = (secs  != NULL) ? *secs  : 0.0;
   time_t start_val = (start != NULL) ? *start : scr_log_seconds();
@@ -1180,8 +1829,7 @@ int scr_log_event(
         buf[sizeof(buf)-2] = '\n';
         buf[sizeof(buf)-1] = '\0';
     }
-    scr_write(txt_name, txt_fd, buf, strlen(buf));
-    //fsync(txt_fd);
+    rec->txt = strdup(buf);
   }
 
   if (syslog_enable) {
@@ -1214,13 +1862,29 @@ int scr_log_event(
         buf[sizeof(buf)-2] = '\n';
         buf[sizeof(buf)-1] = '\0';
     }
-    syslog(LOG_INFO, buf);
+    rec->syslog = strdup(buf);
+  }
+
+  if (json_enable) {
+    scr_log_json j;
+    scr_log_json_begin(&j, start_val, "event", type);
+    scr_log_json_str(&j, "note", note);
+    if (dset != NULL) {
+      scr_log_json_raw(&j, ",\"dset\":%d", dset_val);
+    }
+    scr_log_json_str(&j, "name", name);
+    if (secs != NULL) {
+      scr_log_json_raw(&j, ",\"secs\":%f", secs_val);
+    }
+    rec->json = scr_log_json_end(&j);
   }
 
   if (db_enable) {
-    rc = scr_mysql_log_event(type, note, dset, name, &start_val, secs);
+    scr_log_rec_set_db(rec, type, note, NULL, dset, name, &start_val, secs, NULL, NULL);
   }
 
+  rc = scr_log_submit(rec);
+
   return rc;
 }
 
@@ -1234,10 +1898,16 @@ int scr_log_transfer(
   const time_t* start,
   const double* secs,
   const double* bytes,
+  const double* moved,
   const int* files)
 {
   int rc = SCR_SUCCESS;
 
+  scr_log_rec* rec = scr_log_rec_new(SCR_LOG_REC_TRANSFER);
+  if (rec == NULL) {
+    return SCR_FAILURE;
+  }
+
   struct tm* timeinfo = localtime(start);
   char timestr[100];
   strftime(timestr, sizeof(timestr), "%s", timeinfo);
@@ -1247,6 +1917,7 @@ int scr_log_transfer(
   int    dset_val  = (dset != NULL)  ? *dset  : -1;
   double secs_val  = (secs != NULL)  ? *secs  : 0.0;
   double bytes_val = (bytes != NULL) ? *bytes : 0.0;
+  double moved_val = (moved != NULL) ? *moved : 0.0;
   int    files_val = (files != NULL) ? *files : 0;
 
   if (txt_enable) {
@@ -1281,6 +1952,10 @@ int scr_log_transfer(
       nwritten += snprintf(buf + nwritten, remaining, ", bytes=%f", bytes_val);
       remaining = (sizeof(buf) > nwritten) ? sizeof(buf) - nwritten : 0;
     }
+    if (moved != NULL) {
+      nwritten += snprintf(buf + nwritten, remaining, ", moved=%f", moved_val);
+      remaining = (sizeof(buf) > nwritten) ? sizeof(buf) - nwritten : 0;
+    }
     if (files != NULL) {
       nwritten += snprintf(buf + nwritten, remaining, ", files=%d", files_val);
       remaining = (sizeof(buf) > nwritten) ? sizeof(buf) - nwritten : 0;
@@ -1291,8 +1966,7 @@ int scr_log_transfer(
         buf[sizeof(buf)-2] = '\n';
         buf[sizeof(buf)-1] = '\0';
     }
-    scr_write(txt_name, txt_fd, buf, strlen(buf));
-    //fsync(txt_fd);
+    rec->txt = strdup(buf);
   }
 
   if (syslog_enable) {
@@ -1327,6 +2001,10 @@ int scr_log_transfer(
       nwritten += snprintf(buf + nwritten, remaining, ", bytes=%f", bytes_val);
       remaining = (sizeof(buf) > nwritten) ? sizeof(buf) - nwritten : 0;
     }
+    if (moved != NULL) {
+      nwritten += snprintf(buf + nwritten, remaining, ", moved=%f", moved_val);
+      remaining = (sizeof(buf) > nwritten) ? sizeof(buf) - nwritten : 0;
+    }
     if (files != NULL) {
       nwritten += snprintf(buf + nwritten, remaining, ", files=%d", files_val);
       remaining = (sizeof(buf) > nwritten) ? sizeof(buf) - nwritten : 0;
@@ -1337,12 +2015,38 @@ int scr_log_transfer(
         buf[sizeof(buf)-2] = '\n';
         buf[sizeof(buf)-1] = '\0';
     }
-    syslog(LOG_INFO, buf);
+    rec->syslog = strdup(buf);
+  }
+
+  if (json_enable) {
+    scr_log_json j;
+    scr_log_json_begin(&j, *start, "xfer", type);
+    scr_log_json_str(&j, "from", from);
+    scr_log_json_str(&j, "to", to);
+    if (dset != NULL) {
+      scr_log_json_raw(&j, ",\"dset\":%d", dset_val);
+    }
+    scr_log_json_str(&j, "name", name);
+    if (secs != NULL) {
+      scr_log_json_raw(&j, ",\"secs\":%f", secs_val);
+    }
+    if (bytes != NULL) {
+      scr_log_json_raw(&j, ",\"bytes\":%f", bytes_val);
+    }
+    if (moved != NULL) {
+      scr_log_json_raw(&j, ",\"moved\":%f", moved_val);
+    }
+    if (files != NULL) {
+      scr_log_json_raw(&j, ",\"files\":%d", files_val);
+    }
+    rec->json = scr_log_json_end(&j);
   }
 
   if (db_enable) {
-    rc = scr_mysql_log_transfer(type, from, to, dset, name, start, secs, bytes, files);
+    scr_log_rec_set_db(rec, type, from, to, dset, name, start, secs, bytes, files);
   }
 
+  rc = scr_log_submit(rec);
+
   return rc;
 }
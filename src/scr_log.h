@@ -50,6 +50,9 @@ time_t scr_log_seconds(void);
 /* initialize text file logging in prefix directory */
 int scr_log_init_txt(const char* prefix);
 
+/* initialize JSON record logging in prefix directory */
+int scr_log_init_json(const char* prefix);
+
 /* initialize syslog logging */
 int scr_log_init_syslog(void);
 
@@ -62,6 +65,10 @@ int scr_log_init_db(
   const char* name
 );
 
+/* start a thread to write log records in batches, queuing at most
+ * size records before dropping new ones */
+int scr_log_init_async(int size);
+
 /* initialize the logging */
 int scr_log_init(const char* prefix);
 
@@ -102,7 +109,10 @@ int scr_log_event(
   const double* secs
 );
 
-/* log a transfer: copy / checkpoint / fetch / flush */
+/* log a transfer: copy / checkpoint / fetch / flush,
+ * bytes is the logical size of the data and moved is the number of bytes
+ * actually written when that differs, e.g., due to compression or holes,
+ * set moved to NULL if it is the same as bytes */
 int scr_log_transfer(
   const char* type,
   const char* from,
@@ -112,6 +122,7 @@ int scr_log_transfer(
   const time_t* start,
   const double* secs,
   const double* bytes,
+  const double* moved,
   const int* files
 );
 
@@ -51,6 +51,7 @@ struct arglist {
   time_t* transfer_start;
   double* transfer_secs;
   double* transfer_bytes;
+  double* transfer_moved;
   int*    transfer_files;
 };
 
@@ -60,6 +61,7 @@ int global_dset;
 time_t global_start;
 double global_secs;
 double global_bytes;
+double global_moved;
 int    global_files;
 
 void print_usage()
@@ -82,6 +84,7 @@ void print_usage()
   printf("  -S <start>     Transfer start time as UNIX timestamp (integer)\n");
   printf("  -L <duration>  Duration in seconds (integer)\n");
   printf("  -B <bytes>     Number of bytes transfered (integer)\n");
+  printf("  -M <bytes>     Number of bytes actually written, if different from -B (integer)\n");
   printf("  -F <files>     Number of files transfered (integer)\n");
   printf("\n");
   return;
@@ -109,6 +112,7 @@ int processArgs(int argc, char **argv, struct arglist* args)
   args->transfer_start    = NULL;
   args->transfer_secs     = NULL;
   args->transfer_bytes    = NULL;
+  args->transfer_moved    = NULL;
   args->transfer_files    = NULL;
 
   for (i=1; i<argc; i++) {
@@ -128,7 +132,7 @@ int processArgs(int argc, char **argv, struct arglist* args)
       }
 
       /* single argument parameters */
-      if (strchr("pujisTXYDnSLBF", flag)) {
+      if (strchr("pujisTXYDnSLBMF", flag)) {
         switch(flag) {
         case 'p':
           args->prefix = strdup(argptr);
@@ -174,6 +178,10 @@ int processArgs(int argc, char **argv, struct arglist* args)
           global_bytes = (double) atoi(argptr);
           args->transfer_bytes = &global_bytes;
           break;
+        case 'M':
+          global_moved = (double) strtoull(argptr, NULL, 0);
+          args->transfer_moved = &global_moved;
+          break;
         case 'F':
           global_files = atoi(argptr);
           args->transfer_files = &global_files;
@@ -278,7 +286,7 @@ int main (int argc, char *argv[])
   if (scr_log_enable) {
     if (scr_log_transfer(args.transfer_type, args.transfer_from, args.transfer_to,
           args.transfer_dset, args.transfer_name, args.transfer_start, args.transfer_secs,
-          args.transfer_bytes, args.transfer_files) != SCR_SUCCESS)
+          args.transfer_bytes, args.transfer_moved, args.transfer_files) != SCR_SUCCESS)
     {
       rc = 1;
     }
@@ -16,6 +16,8 @@
 #include "scr_util.h"
 #include "scr_io.h"
 #include "scr_meta.h"
+#include "scr_checksum.h"
+#include "scr_compress.h"
 
 #include "spath.h"
 #include "kvtree.h"
@@ -157,6 +159,85 @@ int scr_meta_set_crc32(scr_meta* meta, uLong crc)
   return (rc == KVTREE_SUCCESS) ? SCR_SUCCESS : SCR_FAILURE;
 }
 
+/* sets checksum value and type in meta data, overwrites any existing values */
+int scr_meta_set_checksum(scr_meta* meta, int type, uint64_t value)
+{
+  /* record zlib crc32 under the CRC key so older versions can still read it */
+  if (type == SCR_CHECKSUM_CRC32) {
+    kvtree_unset(meta, SCR_META_KEY_CHECKSUM);
+    kvtree_unset(meta, SCR_META_KEY_CHECKSUM_TYPE);
+    return scr_meta_set_crc32(meta, (uLong) value);
+  }
+
+  const char* name = scr_checksum_type_to_str(type);
+  if (name == NULL) {
+    return SCR_FAILURE;
+  }
+
+  int rc = kvtree_util_set_str(meta, SCR_META_KEY_CHECKSUM_TYPE, name);
+  if (rc == KVTREE_SUCCESS) {
+    rc = kvtree_util_set_unsigned_long(meta, SCR_META_KEY_CHECKSUM, (unsigned long) value);
+  }
+  return (rc == KVTREE_SUCCESS) ? SCR_SUCCESS : SCR_FAILURE;
+}
+
+/* sets compression codec and compressed size of the file, overwrites any existing values */
+int scr_meta_set_compress(scr_meta* meta, int type, unsigned long compsize)
+{
+  /* nothing to record if file is not compressed */
+  if (type == SCR_COMPRESS_NONE) {
+    kvtree_unset(meta, SCR_META_KEY_COMPRESS);
+    kvtree_unset(meta, SCR_META_KEY_COMPSIZE);
+    return SCR_SUCCESS;
+  }
+
+  const char* name = scr_compress_type_to_str(type);
+  if (name == NULL) {
+    return SCR_FAILURE;
+  }
+
+  int rc = kvtree_util_set_str(meta, SCR_META_KEY_COMPRESS, name);
+  if (rc == KVTREE_SUCCESS) {
+    rc = kvtree_util_set_unsigned_long(meta, SCR_META_KEY_COMPSIZE, compsize);
+  }
+  return (rc == KVTREE_SUCCESS) ? SCR_SUCCESS : SCR_FAILURE;
+}
+
+/* sets the manifest of blocks holding a deduplicated file, a NULL
+ * manifest marks the file as holding its own data */
+int scr_meta_set_dedup(scr_meta* meta, const kvtree* manifest)
+{
+  kvtree_unset(meta, SCR_META_KEY_DEDUP);
+  if (manifest != NULL) {
+    kvtree* copy = kvtree_new();
+    kvtree_merge(copy, manifest);
+    kvtree_set(meta, SCR_META_KEY_DEDUP, copy);
+  }
+  return SCR_SUCCESS;
+}
+
+/* sets codec and compressed size of a file kept compressed in cache,
+ * SCR_COMPRESS_NONE marks the file as stored as is */
+int scr_meta_set_cache_compress(scr_meta* meta, int type, unsigned long compsize)
+{
+  if (type == SCR_COMPRESS_NONE) {
+    kvtree_unset(meta, SCR_META_KEY_CACHE_COMPRESS);
+    kvtree_unset(meta, SCR_META_KEY_CACHE_COMPSIZE);
+    return SCR_SUCCESS;
+  }
+
+  const char* name = scr_compress_type_to_str(type);
+  if (name == NULL) {
+    return SCR_FAILURE;
+  }
+
+  int rc = kvtree_util_set_str(meta, SCR_META_KEY_CACHE_COMPRESS, name);
+  if (rc == KVTREE_SUCCESS) {
+    rc = kvtree_util_set_unsigned_long(meta, SCR_META_KEY_CACHE_COMPSIZE, compsize);
+  }
+  return (rc == KVTREE_SUCCESS) ? SCR_SUCCESS : SCR_FAILURE;
+}
+
 static void scr_stat_get_atimes(const struct stat* sb, uint64_t* secs, uint64_t* nsecs)
 {
     *secs = (uint64_t) sb->st_atime;
@@ -306,6 +387,89 @@ int scr_meta_get_crc32(const scr_meta* meta, uLong* crc)
   return (rc == KVTREE_SUCCESS) ? SCR_SUCCESS : SCR_FAILURE;
 }
 
+/* get the checksum value and type in meta data, returns SCR_SUCCESS if a field is set */
+int scr_meta_get_checksum(const scr_meta* meta, int* type, uint64_t* value)
+{
+  char* name = NULL;
+  unsigned long val;
+  if (kvtree_util_get_str(meta, SCR_META_KEY_CHECKSUM_TYPE, &name) == KVTREE_SUCCESS &&
+      kvtree_util_get_unsigned_long(meta, SCR_META_KEY_CHECKSUM, &val) == KVTREE_SUCCESS)
+  {
+    int t = scr_checksum_type_from_str(name);
+    if (t < 0) {
+      return SCR_FAILURE;
+    }
+    *type  = t;
+    *value = (uint64_t) val;
+    return SCR_SUCCESS;
+  }
+
+  /* fall back to a plain crc32 value */
+  uLong crc;
+  if (scr_meta_get_crc32(meta, &crc) == SCR_SUCCESS) {
+    *type  = SCR_CHECKSUM_CRC32;
+    *value = (uint64_t) crc;
+    return SCR_SUCCESS;
+  }
+
+  return SCR_FAILURE;
+}
+
+/* get the compression codec and compressed size of the file, sets type to
+ * SCR_COMPRESS_NONE if file is not compressed, returns SCR_FAILURE if the
+ * recorded codec is not recognized */
+int scr_meta_get_compress(const scr_meta* meta, int* type, unsigned long* compsize)
+{
+  char* name = NULL;
+  if (kvtree_util_get_str(meta, SCR_META_KEY_COMPRESS, &name) != KVTREE_SUCCESS) {
+    *type = SCR_COMPRESS_NONE;
+    return SCR_SUCCESS;
+  }
+
+  int t = scr_compress_type_from_str(name);
+  if (t < 0) {
+    return SCR_FAILURE;
+  }
+  *type = t;
+
+  if (compsize != NULL) {
+    *compsize = 0;
+    kvtree_util_get_unsigned_long(meta, SCR_META_KEY_COMPSIZE, compsize);
+  }
+  return SCR_SUCCESS;
+}
+
+/* get the codec and compressed size of a file kept compressed in cache,
+ * sets type to SCR_COMPRESS_NONE if the file is stored as is, returns
+ * SCR_FAILURE if the recorded codec is not recognized */
+int scr_meta_get_cache_compress(const scr_meta* meta, int* type, unsigned long* compsize)
+{
+  char* name = NULL;
+  if (kvtree_util_get_str(meta, SCR_META_KEY_CACHE_COMPRESS, &name) != KVTREE_SUCCESS) {
+    *type = SCR_COMPRESS_NONE;
+    return SCR_SUCCESS;
+  }
+
+  int t = scr_compress_type_from_str(name);
+  if (t < 0) {
+    return SCR_FAILURE;
+  }
+  *type = t;
+
+  if (compsize != NULL) {
+    *compsize = 0;
+    kvtree_util_get_unsigned_long(meta, SCR_META_KEY_CACHE_COMPSIZE, compsize);
+  }
+  return SCR_SUCCESS;
+}
+
+/* get the manifest of blocks holding a deduplicated file,
+ * returns NULL if the file holds its own data */
+const kvtree* scr_meta_get_dedup(const scr_meta* meta)
+{
+  return kvtree_get(meta, SCR_META_KEY_DEDUP);
+}
+
 /*
 =========================================
 Check field values
@@ -44,6 +44,8 @@
 /* compute crc32, needed for uLong */
 #include <zlib.h>
 
+#include <stdint.h>
+
 typedef kvtree scr_meta;
 
 /*
@@ -97,6 +99,19 @@ int scr_meta_set_stat(scr_meta* meta, struct stat* statbuf);
 /* set the crc32 field on meta */
 int scr_meta_set_crc32(scr_meta* meta, uLong crc);
 
+/* set the checksum value on meta along with the SCR_CHECKSUM_* type used to compute it */
+int scr_meta_set_checksum(scr_meta* meta, int type, uint64_t value);
+
+/* set the SCR_COMPRESS_* codec and compressed size of a flushed file */
+int scr_meta_set_compress(scr_meta* meta, int type, unsigned long compsize);
+
+/* set the manifest of blocks holding a deduplicated file in cache,
+ * a NULL manifest marks the file as holding its own data */
+int scr_meta_set_dedup(scr_meta* meta, const kvtree* manifest);
+
+/* set the SCR_COMPRESS_* codec and compressed size of a file kept compressed in cache */
+int scr_meta_set_cache_compress(scr_meta* meta, int type, unsigned long compsize);
+
 /*
 =========================================
 Get field values
@@ -130,6 +145,23 @@ int scr_meta_get_complete(const scr_meta* meta, int* complete);
 /* get the crc32 field in meta data, returns SCR_SUCCESS if a field is set */
 int scr_meta_get_crc32(const scr_meta* meta, uLong* crc);
 
+/* get the checksum value and its SCR_CHECKSUM_* type from meta data,
+ * returns SCR_SUCCESS if a checksum is set, falls back to the crc32 field
+ * for meta data recorded before checksum types were added */
+int scr_meta_get_checksum(const scr_meta* meta, int* type, uint64_t* value);
+
+/* get the SCR_COMPRESS_* codec and compressed size of a flushed file,
+ * type is set to SCR_COMPRESS_NONE if the file is not compressed */
+int scr_meta_get_compress(const scr_meta* meta, int* type, unsigned long* compsize);
+
+/* get the manifest of blocks holding a deduplicated file in cache,
+ * returns NULL if the file holds its own data */
+const kvtree* scr_meta_get_dedup(const scr_meta* meta);
+
+/* get the SCR_COMPRESS_* codec and compressed size of a file kept compressed in cache,
+ * type is set to SCR_COMPRESS_NONE if the file is stored as is */
+int scr_meta_get_cache_compress(const scr_meta* meta, int* type, unsigned long* compsize);
+
 /*
 =========================================
 Check field values
@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+/* pthread_setaffinity_np, CPU_SET */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "scr_conf.h"
+#include "scr.h"
+#include "scr_err.h"
+#include "scr_util.h"
+#include "scr_numa.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#endif
+
+/* mbind policy from linux/mempolicy.h */
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED (1)
+#endif
+
+/* directory prefixes and the node their buffers belong on */
+static int scr_numa_count = 0;
+static char** scr_numa_prefixes = NULL;
+static int* scr_numa_nodes = NULL;
+static pthread_mutex_t scr_numa_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int scr_numa_from_str(const char* name)
+{
+  if (name == NULL || strcmp(name, "") == 0 || strcasecmp(name, "NONE") == 0) {
+    return SCR_NUMA_NONE;
+  } else if (strcasecmp(name, "AUTO") == 0) {
+    return SCR_NUMA_AUTO;
+  } else if (strcasecmp(name, "LOCAL") == 0) {
+    return SCR_NUMA_LOCAL;
+  }
+
+  /* otherwise expect a node number */
+  const char* p;
+  for (p = name; *p != '\0'; p++) {
+    if (! isdigit((unsigned char) *p)) {
+      return -4;
+    }
+  }
+  return atoi(name);
+}
+
+/* read a single integer from a sysfs file, returns -1 if not found */
+static int scr_numa_read_int(const char* file)
+{
+  int value = -1;
+  FILE* fp = fopen(file, "r");
+  if (fp != NULL) {
+    if (fscanf(fp, "%d", &value) != 1) {
+      value = -1;
+    }
+    fclose(fp);
+  }
+  return value;
+}
+
+int scr_numa_node_of_path(const char* path)
+{
+#ifdef __linux__
+  if (path == NULL) {
+    return -1;
+  }
+
+  /* the store directory may not exist yet, so walk up to the
+   * closest parent that does */
+  char* dir = strdup(path);
+  struct stat st;
+  while (stat(dir, &st) != 0) {
+    char* slash = strrchr(dir, '/');
+    if (slash == NULL || slash == dir) {
+      scr_free(&dir);
+      return -1;
+    }
+    *slash = '\0';
+  }
+  scr_free(&dir);
+
+  /* file systems without a backing device, e.g., tmpfs, have no node */
+  unsigned int maj = major(st.st_dev);
+  unsigned int min = minor(st.st_dev);
+  if (maj == 0) {
+    return -1;
+  }
+
+  /* a partition inherits the node of its disk, and depending on the
+   * driver the node is recorded on the device or on its controller */
+  const char* candidates[] = {
+    "device/numa_node",
+    "device/device/numa_node",
+    "../device/numa_node",
+    "../device/device/numa_node",
+  };
+  int i;
+  for (i = 0; i < (int) (sizeof(candidates) / sizeof(candidates[0])); i++) {
+    char file[256];
+    snprintf(file, sizeof(file), "/sys/dev/block/%u:%u/%s", maj, min, candidates[i]);
+    int node = scr_numa_read_int(file);
+    if (node >= 0) {
+      return node;
+    }
+  }
+#endif
+
+  return -1;
+}
+
+int scr_numa_node_current(void)
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+  unsigned int cpu, node;
+  if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0) {
+    return (int) node;
+  }
+#endif
+  return -1;
+}
+
+int scr_numa_resolve(int setting, const char* path)
+{
+  if (setting == SCR_NUMA_AUTO) {
+    return scr_numa_node_of_path(path);
+  } else if (setting == SCR_NUMA_LOCAL) {
+    return scr_numa_node_current();
+  } else if (setting >= 0) {
+    return setting;
+  }
+  return -1;
+}
+
+int scr_numa_register(const char* prefix, int node)
+{
+  if (prefix == NULL) {
+    return SCR_FAILURE;
+  }
+
+  pthread_mutex_lock(&scr_numa_lock);
+
+  /* drop any existing entry for this prefix */
+  int i;
+  for (i = 0; i < scr_numa_count; i++) {
+    if (strcmp(scr_numa_prefixes[i], prefix) == 0) {
+      scr_free(&scr_numa_prefixes[i]);
+      scr_numa_count--;
+      scr_numa_prefixes[i] = scr_numa_prefixes[scr_numa_count];
+      scr_numa_nodes[i]    = scr_numa_nodes[scr_numa_count];
+      break;
+    }
+  }
+
+  /* add the new entry */
+  if (node >= 0) {
+    scr_numa_prefixes = (char**) realloc(scr_numa_prefixes, (scr_numa_count + 1) * sizeof(char*));
+    scr_numa_nodes    = (int*)   realloc(scr_numa_nodes,    (scr_numa_count + 1) * sizeof(int));
+    scr_numa_prefixes[scr_numa_count] = strdup(prefix);
+    scr_numa_nodes[scr_numa_count]    = node;
+    scr_numa_count++;
+  }
+
+  pthread_mutex_unlock(&scr_numa_lock);
+
+  return SCR_SUCCESS;
+}
+
+int scr_numa_node_of_file(const char* file)
+{
+  if (file == NULL || scr_numa_count == 0) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&scr_numa_lock);
+
+  int node = -1;
+  size_t longest = 0;
+  int i;
+  for (i = 0; i < scr_numa_count; i++) {
+    /* match whole path components only */
+    const char* prefix = scr_numa_prefixes[i];
+    size_t len = strlen(prefix);
+    if (len > longest && strncmp(file, prefix, len) == 0 &&
+        (file[len] == '/' || file[len] == '\0'))
+    {
+      node    = scr_numa_nodes[i];
+      longest = len;
+    }
+  }
+
+  pthread_mutex_unlock(&scr_numa_lock);
+
+  return node;
+}
+
+void scr_numa_clear(void)
+{
+  pthread_mutex_lock(&scr_numa_lock);
+  int i;
+  for (i = 0; i < scr_numa_count; i++) {
+    scr_free(&scr_numa_prefixes[i]);
+  }
+  scr_free(&scr_numa_prefixes);
+  scr_free(&scr_numa_nodes);
+  scr_numa_count = 0;
+  pthread_mutex_unlock(&scr_numa_lock);
+}
+
+void* scr_numa_alloc(size_t size, int node)
+{
+  if (node < 0) {
+    return malloc(size);
+  }
+
+  /* round up to whole pages so the policy does not spill over
+   * onto pages shared with other allocations */
+  size_t page = (size_t) sysconf(_SC_PAGESIZE);
+  size_t bytes = (size + page - 1) / page * page;
+  if (bytes == 0) {
+    bytes = page;
+  }
+
+  void* buf = scr_align_malloc(bytes, page);
+  if (buf == NULL) {
+    return NULL;
+  }
+
+#if defined(__linux__) && defined(SYS_mbind)
+  /* prefer rather than require the node, so we still get memory
+   * from elsewhere if the node runs low */
+  unsigned long bits = 8 * sizeof(unsigned long);
+  unsigned long words = (unsigned long) node / bits + 1;
+  unsigned long* mask = (unsigned long*) calloc(words, sizeof(unsigned long));
+  if (mask != NULL) {
+    mask[node / bits] = 1UL << (node % bits);
+    if (syscall(SYS_mbind, buf, bytes, MPOL_PREFERRED, mask, words * bits + 1, 0) != 0) {
+      scr_dbg(2, "Failed to place %lu bytes on NUMA node %d @ %s:%d",
+        (unsigned long) bytes, node, __FILE__, __LINE__
+      );
+    }
+    free(mask);
+  }
+#endif
+
+  /* touch each page now so it is allocated under the policy */
+  memset(buf, 0, bytes);
+
+  return buf;
+}
+
+int scr_numa_bind_thread(int node)
+{
+  if (node < 0) {
+    return SCR_SUCCESS;
+  }
+
+#ifdef __linux__
+  char file[256];
+  snprintf(file, sizeof(file), "/sys/devices/system/node/node%d/cpulist", node);
+  FILE* fp = fopen(file, "r");
+  if (fp == NULL) {
+    return SCR_FAILURE;
+  }
+  char list[4096];
+  char* line = fgets(list, sizeof(list), fp);
+  fclose(fp);
+  if (line == NULL) {
+    return SCR_FAILURE;
+  }
+
+  /* parse a list like 0-7,16-23 */
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  int cpus = 0;
+  char* saveptr = NULL;
+  char* tok = strtok_r(list, ",\n", &saveptr);
+  while (tok != NULL) {
+    int first, last;
+    int n = sscanf(tok, "%d-%d", &first, &last);
+    if (n == 1) {
+      last = first;
+    }
+    if (n >= 1) {
+      int cpu;
+      for (cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+        CPU_SET(cpu, &set);
+        cpus++;
+      }
+    }
+    tok = strtok_r(NULL, ",\n", &saveptr);
+  }
+  if (cpus == 0) {
+    return SCR_FAILURE;
+  }
+
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+#else
+  return SCR_FAILURE;
+#endif
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_NUMA_H
+#define SCR_NUMA_H
+
+#include <stddef.h>
+
+/*
+=========================================
+This file places the buffers SCR copies and checksums files through on
+a chosen NUMA node, and pins the helper threads that use them to the
+CPUs of that node.  Each store descriptor registers the node for its
+directory, and I/O routines look up the node for the files they touch.
+It talks to the kernel directly through sysfs and mbind, so it does not
+need libnuma, and everything falls back to plain malloc where NUMA
+information is not available.
+=========================================
+*/
+
+/* special values of a NUMA setting, other values name a node */
+#define SCR_NUMA_NONE  (-1) /* leave placement to the operating system */
+#define SCR_NUMA_AUTO  (-2) /* node of the device holding the store */
+#define SCR_NUMA_LOCAL (-3) /* node of the CPU the process runs on */
+
+/* convert NONE, AUTO, LOCAL, or a node number to a NUMA setting,
+ * returns -4 if the name is not valid */
+int scr_numa_from_str(const char* name);
+
+/* returns the NUMA node of the block device holding path, -1 if unknown */
+int scr_numa_node_of_path(const char* path);
+
+/* returns the NUMA node of the CPU the calling thread runs on, -1 if unknown */
+int scr_numa_node_current(void);
+
+/* resolve a NUMA setting for files under path to a node number,
+ * returns -1 if no placement should be done */
+int scr_numa_resolve(int setting, const char* path);
+
+/* record that buffers for files under prefix belong on node,
+ * a negative node removes any entry for prefix */
+int scr_numa_register(const char* prefix, int node);
+
+/* returns the node registered for the longest prefix of file, -1 if none */
+int scr_numa_node_of_file(const char* file);
+
+/* forget all registered prefixes */
+void scr_numa_clear(void);
+
+/* allocate size bytes preferring memory on node, the buffer is page
+ * aligned when node is valid and is released with free (scr_free),
+ * behaves like malloc if node < 0 */
+void* scr_numa_alloc(size_t size, int node);
+
+/* pin the calling thread to the CPUs of node, does nothing if node < 0,
+ * only call this from threads SCR creates itself */
+int scr_numa_bind_thread(int node);
+
+#endif
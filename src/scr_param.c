@@ -59,10 +59,22 @@ static kvtree* scr_user_hash = NULL;
 /* this data structure will hold values read from the system config file */
 static kvtree* scr_system_hash = NULL;
 
-/* caches lookups via getenv, need to do this on some systems because returning
- * pointers to getenv values back too many functions was segfaulting on some
- * systems */
-static kvtree* scr_env_hash = NULL;
+/* one parameter with precedence and environment expansion applied */
+typedef struct {
+  char* name;  /* parameter name, NULL if slot is empty */
+  char* value; /* value of parameter */
+} scr_param_entry;
+
+/* open-addressed table of every parameter that is set anywhere,
+ * built on the first lookup after init and dropped by SCR_Config,
+ * we copy values from getenv into the table, since returning
+ * pointers to getenv values back too many functions was segfaulting
+ * on some systems */
+static scr_param_entry* scr_param_table = NULL;
+static size_t scr_param_table_slots = 0; /* number of slots, a power of two */
+
+/* environment of the process */
+extern char** environ;
 
 /* holds param values set through SCR_Config */
 kvtree* scr_app_hash = NULL;
@@ -163,75 +175,130 @@ static char* expand_env(const char* value)
   return retval;
 }
 
-/* searches for name and returns a character pointer to its value if set,
- * returns NULL if not found */
-const char* scr_param_get(const char* name)
+/* FNV-1a hash of parameter name */
+static size_t scr_param_hash(const char* name)
 {
-  char* value = NULL;
-
-  /* see if this parameter is one which is restricted from user */
-  kvtree* no_user = kvtree_get(scr_no_user_hash, name);
+  size_t h = 2166136261u;
+  const unsigned char* p;
+  for (p = (const unsigned char*) name; *p != '\0'; p++) {
+    h ^= (size_t) *p;
+    h *= 16777619u;
+  }
+  return h;
+}
 
-  /* if parameter is set in environment, return that value */
-  if (no_user == NULL && getenv(name) != NULL) {
-    /* we don't just return the getenv value directly because that causes
-     * segfaults on some systems, so instead we add it to a hash and return
-     * the pointer into the hash */
-
-    /* try to lookup the value for this name in case we've already cached it */
-    if (kvtree_util_get_str(scr_env_hash, name, &value) != KVTREE_SUCCESS) {
-      /* it's not in the hash yet, so add it */
-      char* tmp_value = expand_env(getenv(name));
-      kvtree_util_set_str(scr_env_hash, name, tmp_value);
-      scr_free(&tmp_value);
-
-      /* now issue our lookup again */
-      if (kvtree_util_get_str(scr_env_hash, name, &value) != KVTREE_SUCCESS) {
-        /* it's an error if we don't find it this time */
-        scr_abort(-1, "Failed to find value for %s in env hash @ %s:%d",
-          name, __FILE__, __LINE__
-        );
-      }
+/* returns slot holding name, or the empty slot where it belongs */
+static scr_param_entry* scr_param_slot(const char* name, size_t len)
+{
+  size_t mask = scr_param_table_slots - 1;
+  size_t i = scr_param_hash(name) & mask;
+  while (scr_param_table[i].name != NULL) {
+    if (strncmp(scr_param_table[i].name, name, len) == 0 &&
+        scr_param_table[i].name[len] == '\0')
+    {
+      break;
     }
+    i = (i + 1) & mask;
+  }
+  return &scr_param_table[i];
+}
 
-    return value;
+/* add first len chars of name with value unless name is already set,
+ * so sources must be added from highest precedence to lowest */
+static void scr_param_table_add(const char* name, size_t len, const char* value, int expand)
+{
+  scr_param_entry* e = scr_param_slot(name, len);
+  if (e->name != NULL) {
+    return;
+  }
+  e->name = strndup(name, len);
+  if (expand || strchr(value, '$')) {
+    e->value = expand_env(value);
+  } else {
+    e->value = strdup(value);
   }
+}
 
-  /* otherwise, if parameter is set in user configuration file,
-   * return that value */
-  value = kvtree_elem_get_first_val(scr_user_hash, name);
-  if (no_user == NULL && value != NULL) {
-    /* evaluate environment variables */
-    if (strchr(value, '$')) {
-      value = expand_env(value);
+/* add each top level parameter set in hash that the user may set */
+static void scr_param_table_add_hash(const kvtree* hash, int is_user)
+{
+  kvtree_elem* elem;
+  for (elem = kvtree_elem_first(hash);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    char* name = kvtree_elem_key(elem);
+    if (is_user && kvtree_get(scr_no_user_hash, name) != NULL) {
+      continue;
+    }
+    char* value = kvtree_elem_get_first_val(hash, name);
+    if (value != NULL) {
+      scr_param_table_add(name, strlen(name), value, 0);
     }
-    return value;
   }
+}
 
-  /* otherwise, if this parameter is one which has been set by the application
-   * return that value */
-  value = kvtree_elem_get_first_val(scr_app_hash, name);
-  if (value != NULL) {
-    /* evaluate environment variables */
-    if (strchr(value, '$')) {
-      value = expand_env(value);
-    }
-    return value;
+/* free the table of parameters, it is built again on the next lookup */
+static void scr_param_table_free(void)
+{
+  size_t i;
+  for (i = 0; i < scr_param_table_slots; i++) {
+    scr_free(&scr_param_table[i].name);
+    scr_free(&scr_param_table[i].value);
   }
+  scr_free(&scr_param_table);
+  scr_param_table_slots = 0;
+}
 
-  /* otherwise, if parameter is set in system configuration file,
-   * return that value */
-  value = kvtree_elem_get_first_val(scr_system_hash, name);
-  if (value != NULL) {
-    /* evaluate environment variables */
-    if (strchr(value, '$')) {
-      value = expand_env(value);
+/* resolve every parameter once in order of precedence:
+ * environment, user config file, SCR_Config, system config file */
+static void scr_param_table_build(void)
+{
+  /* leave room for twice as many entries as there are settings */
+  size_t count = (size_t) kvtree_size(scr_user_hash) +
+                 (size_t) kvtree_size(scr_app_hash) +
+                 (size_t) kvtree_size(scr_system_hash);
+  char** env;
+  for (env = environ; env != NULL && *env != NULL; env++) {
+    count++;
+  }
+  size_t slots = 64;
+  while (slots < 2 * count) {
+    slots *= 2;
+  }
+  scr_param_table = (scr_param_entry*) calloc(slots, sizeof(scr_param_entry));
+  assert(scr_param_table);
+  scr_param_table_slots = slots;
+
+  for (env = environ; env != NULL && *env != NULL; env++) {
+    const char* eq = strchr(*env, '=');
+    if (eq == NULL || eq == *env) {
+      continue;
+    }
+    size_t len = (size_t) (eq - *env);
+    char* name = strndup(*env, len);
+    int allowed = (kvtree_get(scr_no_user_hash, name) == NULL);
+    scr_free(&name);
+    if (allowed) {
+      scr_param_table_add(*env, len, eq + 1, 1);
     }
-    return value;
   }
+  scr_param_table_add_hash(scr_user_hash, 1);
+  scr_param_table_add_hash(scr_app_hash, 0);
+  scr_param_table_add_hash(scr_system_hash, 0);
+}
 
-  /* parameter not found, return NULL */
-  return NULL;
+/* searches for name and returns a character pointer to its value if set,
+ * returns NULL if not found, the pointer is good until the next call
+ * to SCR_Config or scr_param_finalize */
+const char* scr_param_get(const char* name)
+{
+  if (scr_param_table == NULL) {
+    scr_param_table_build();
+  }
+
+  scr_param_entry* e = scr_param_slot(name, strlen(name));
+  return e->value;
 }
 
 /* searchs for name and returns a newly allocated hash of its value if set,
@@ -445,8 +512,8 @@ int scr_param_init()
     scr_system_hash = kvtree_new();
     scr_config_read(scr_config_file, scr_system_hash);
 
-    /* initialize our hash to cache lookups to getenv */
-    scr_env_hash = kvtree_new();
+    /* we resolve parameters again with the files we just read */
+    scr_param_table_free();
 
     /* warn user if they set any parameters in their environment or user
      * config file which aren't permitted */
@@ -506,8 +573,8 @@ int scr_param_finalize()
     /* free our parameter hash */
     kvtree_delete(&scr_system_hash);
 
-    /* free our env hash */
-    kvtree_delete(&scr_env_hash);
+    /* free our table of resolved parameters */
+    scr_param_table_free();
 
     /* free the hash listing parameters user cannot set */
     kvtree_delete(&scr_no_user_hash);
@@ -530,6 +597,9 @@ kvtree* scr_param_set(char* name, const char* value)
   kvtree* v = kvtree_set(k, value, kvtree_new());
   assert(k && v);
   kvtree_set(scr_app_hash, name, k);
+
+  /* resolve parameters again on the next lookup */
+  scr_param_table_free();
   return v;
 }
 
@@ -545,5 +615,9 @@ kvtree* scr_param_set_hash(char* name, kvtree* hash_value)
     );
   }
 
-  return kvtree_set(scr_app_hash, name, hash_value);
+  kvtree* hash = kvtree_set(scr_app_hash, name, hash_value);
+
+  /* resolve parameters again on the next lookup */
+  scr_param_table_free();
+  return hash;
 }
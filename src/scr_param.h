@@ -51,7 +51,8 @@ int scr_param_init(void);
 int scr_param_finalize(void);
 
 /* searchs for name and returns a character pointer to its value if set,
- * returns NULL if not found */
+ * returns NULL if not found, the pointer is good until the next call
+ * to SCR_Config or scr_param_finalize */
 const char* scr_param_get(const char* name);
 
 /* searchs for name and returns a newly allocated hash of its value if set,
@@ -0,0 +1,395 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#include "scr_globals.h"
+#include "scr_pmix_event.h"
+
+#ifdef HAVE_PMIX_EVENTS
+
+#include "pmix.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+/* shell that runs the emergency flush on each node, it copies the
+ * files of the dataset in this node's cache with scr_copy, and then
+ * adds the dataset to the index file and marks it as current the same
+ * way the scavenge script does after the job, nodes take turns under
+ * a lock and rebuild the summary each time so that the last one to
+ * finish sees the files of all nodes, an incomplete dataset only means
+ * other nodes are still copying, takes the prefix directory, dataset
+ * id, and dataset name followed by the arguments to scr_copy */
+#define SCR_PMIX_EVENT_SHELL ("/bin/sh")
+#define SCR_PMIX_EVENT_SCRIPT \
+  "prefix=$1; id=$2; name=$3; shift 3; " \
+  "\"" X_BINDIR "/scr_copy\" \"$@\" || exit 1; " \
+  "dir=\"$prefix/.scr/scr.dataset.$id\"; " \
+  "exec 9>\"$dir/emergency.lock\" && flock 9 || exit 1; " \
+  "rm -f \"$dir/summary.scr\"; " \
+  "\"" X_BINDIR "/scr_index\" --prefix \"$prefix\" --build \"$id\" || exit 0; " \
+  "exec \"" X_BINDIR "/scr_index\" --prefix \"$prefix\" --current \"$name\""
+
+/* most down nodes we name to scr_copy to recover partner files */
+#define SCR_PMIX_EVENT_MAX_HOSTS (64)
+
+/* reference of our registered handler, valid if registered is set */
+static size_t scr_pmix_event_ref = 0;
+static int scr_pmix_event_registered = 0;
+
+/* whether this process starts the emergency flush for its node */
+static int scr_pmix_event_is_leader = 0;
+
+/* set in the progress thread, read in the application thread */
+static volatile int scr_pmix_event_count = 0;   /* failures reported so far */
+static int scr_pmix_event_handled = 0;          /* failures acted on so far */
+static pthread_mutex_t scr_pmix_event_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* names of nodes reported down, protected by lock */
+static char* scr_pmix_event_hosts[SCR_PMIX_EVENT_MAX_HOSTS];
+static int scr_pmix_event_nhosts = 0;
+
+/* process copying the newest checkpoint out of cache, protected by lock */
+static pid_t scr_pmix_event_pid = -1;
+
+/* newest checkpoint in cache and how to flush it, copied from the
+ * application thread so the handler never reads globals the application
+ * may be changing, protected by lock */
+static int scr_pmix_event_id = 0;
+static char* scr_pmix_event_name   = NULL;
+static char* scr_pmix_event_prefix = NULL;
+static char* scr_pmix_event_cntl   = NULL;
+static int scr_pmix_event_do_flush = 0;
+static int scr_pmix_event_crc      = 0;
+static unsigned long scr_pmix_event_buf = 0;
+
+/* remember host as down unless we already know it */
+static void scr_pmix_event_add_host(const char* host)
+{
+  int i;
+  for (i = 0; i < scr_pmix_event_nhosts; i++) {
+    if (strcmp(scr_pmix_event_hosts[i], host) == 0) {
+      return;
+    }
+  }
+  if (scr_pmix_event_nhosts < SCR_PMIX_EVENT_MAX_HOSTS) {
+    scr_pmix_event_hosts[scr_pmix_event_nhosts++] = strdup(host);
+  }
+}
+
+/* start the emergency flush on this node to copy the newest checkpoint
+ * in cache to the prefix directory, caller must hold lock */
+static void scr_pmix_event_flush(void)
+{
+  /* one process per node copies, and only once */
+  if (scr_pmix_event_pid >= 0 || ! scr_pmix_event_is_leader) {
+    return;
+  }
+
+  /* only if flushing is enabled and there is a checkpoint to copy */
+  int id = scr_pmix_event_id;
+  if (! scr_pmix_event_do_flush || id <= 0 || scr_pmix_event_name == NULL ||
+      scr_pmix_event_cntl == NULL || scr_pmix_event_prefix == NULL)
+  {
+    return;
+  }
+
+  char id_str[32], buf_str[32];
+  snprintf(id_str,  sizeof(id_str),  "%d",  id);
+  snprintf(buf_str, sizeof(buf_str), "%lu", scr_pmix_event_buf);
+
+  /* build the same command the scavenge script runs after the job,
+   * naming down nodes lets scr_copy recover their files from partners */
+  char* argv[20 + SCR_PMIX_EVENT_MAX_HOSTS];
+  int argc = 0;
+  argv[argc++] = SCR_PMIX_EVENT_SHELL;
+  argv[argc++] = "-c";
+  argv[argc++] = SCR_PMIX_EVENT_SCRIPT;
+  argv[argc++] = "scr_pmix_event";
+  argv[argc++] = scr_pmix_event_prefix;
+  argv[argc++] = id_str;
+  argv[argc++] = scr_pmix_event_name;
+  argv[argc++] = "--cntldir";
+  argv[argc++] = scr_pmix_event_cntl;
+  argv[argc++] = "--id";
+  argv[argc++] = id_str;
+  argv[argc++] = "--prefix";
+  argv[argc++] = scr_pmix_event_prefix;
+  argv[argc++] = "--buf";
+  argv[argc++] = buf_str;
+  if (scr_pmix_event_crc) {
+    argv[argc++] = "--crc";
+  }
+  if (scr_pmix_event_nhosts > 0) {
+    argv[argc++] = "--partner";
+    int i;
+    for (i = 0; i < scr_pmix_event_nhosts; i++) {
+      argv[argc++] = scr_pmix_event_hosts[i];
+    }
+  }
+  argv[argc] = NULL;
+
+  /* the launcher signals the processes of the job step when it tears
+   * the step down after a failure, so put the copy in its own session
+   * and block the signals it sends first, this cannot help if the
+   * resource manager kills every process of the step outright */
+  posix_spawnattr_t attr;
+  posix_spawnattr_init(&attr);
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGHUP);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  posix_spawnattr_setsigmask(&attr, &mask);
+  short flags = POSIX_SPAWN_SETSIGMASK;
+#ifdef POSIX_SPAWN_SETSID
+  flags |= POSIX_SPAWN_SETSID;
+#endif
+  posix_spawnattr_setflags(&attr, flags);
+
+  /* posix_spawn avoids duplicating the address space of the application */
+  pid_t pid;
+  int rc = posix_spawn(&pid, SCR_PMIX_EVENT_SHELL, NULL, &attr, argv, environ);
+  posix_spawnattr_destroy(&attr);
+  if (rc == 0) {
+    scr_pmix_event_pid = pid;
+    scr_dbg(0, "Started emergency flush of dataset %d from %s", id, scr_my_hostname);
+  } else {
+    scr_err("Failed to start %s for emergency flush: %s @ %s:%d",
+      SCR_PMIX_EVENT_SHELL, strerror(rc), __FILE__, __LINE__
+    );
+  }
+}
+
+/* called by PMIx in its progress thread when a failure is reported,
+ * this must not block or call into MPI */
+static void scr_pmix_event_handler(
+  size_t evhdlr_registration_id,
+  pmix_status_t status,
+  const pmix_proc_t* source,
+  pmix_info_t info[], size_t ninfo,
+  pmix_info_t* results, size_t nresults,
+  pmix_event_notification_cbfunc_fn_t cbfunc,
+  void* cbdata)
+{
+  pthread_mutex_lock(&scr_pmix_event_lock);
+
+  /* note any hosts named in the event */
+  size_t i;
+  for (i = 0; i < ninfo; i++) {
+    if (strcmp(info[i].key, PMIX_HOSTNAME) == 0 &&
+        info[i].value.type == PMIX_STRING &&
+        info[i].value.data.string != NULL)
+    {
+      scr_pmix_event_add_host(info[i].value.data.string);
+    }
+  }
+
+  scr_pmix_event_count++;
+
+  /* get the newest checkpoint off the surviving nodes right away,
+   * the application may never return to SCR if it is stuck in MPI */
+  scr_pmix_event_flush();
+
+  pthread_mutex_unlock(&scr_pmix_event_lock);
+
+  /* let other handlers see the event too */
+  if (cbfunc != NULL) {
+    cbfunc(PMIX_EVENT_ACTION_COMPLETE, NULL, 0, NULL, NULL, cbdata);
+  }
+}
+
+int scr_pmix_event_init(void)
+{
+  if (! scr_pmix_events || scr_pmix_event_registered) {
+    return SCR_SUCCESS;
+  }
+
+  /* failures of processes and of nodes */
+  pmix_status_t codes[] = {
+    PMIX_ERR_PROC_ABORTED,
+    PMIX_ERR_NODE_DOWN,
+#ifdef PMIX_ERR_PROC_ABORTING
+    PMIX_ERR_PROC_ABORTING,
+#endif
+#ifdef PMIX_ERR_NODE_OFFLINE
+    PMIX_ERR_NODE_OFFLINE,
+#endif
+#ifdef PMIX_ERR_PROC_TERM_WO_SYNC
+    PMIX_ERR_PROC_TERM_WO_SYNC,
+#endif
+  };
+  size_t ncodes = sizeof(codes) / sizeof(codes[0]);
+
+  /* without a callback, the call blocks and returns the handler reference */
+  pmix_status_t rc = PMIx_Register_event_handler(
+    codes, ncodes, NULL, 0, scr_pmix_event_handler, NULL, NULL
+  );
+  if (rc < 0) {
+    scr_dbg(1, "Failed to register PMIx failure event handler: rc=%d @ %s:%d",
+      (int) rc, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  scr_pmix_event_ref = (size_t) rc;
+  scr_pmix_event_registered = 1;
+
+  /* settings that do not change while we run */
+  pthread_mutex_lock(&scr_pmix_event_lock);
+  scr_pmix_event_is_leader = (scr_storedesc_cntl != NULL && scr_storedesc_cntl->rank == 0);
+  scr_pmix_event_prefix    = (scr_prefix != NULL) ? strdup(scr_prefix) : NULL;
+  scr_pmix_event_cntl      = (scr_cntl_prefix != NULL) ? strdup(scr_cntl_prefix) : NULL;
+  scr_pmix_event_do_flush  = (scr_flush > 0);
+  scr_pmix_event_crc       = scr_crc_on_flush;
+  scr_pmix_event_buf       = (unsigned long) scr_file_buf_size;
+  pthread_mutex_unlock(&scr_pmix_event_lock);
+  scr_dbg(2, "Registered PMIx failure event handler @ %s:%d", __FILE__, __LINE__);
+
+  return SCR_SUCCESS;
+}
+
+int scr_pmix_event_checkpoint(const scr_cache_index* cindex)
+{
+  if (! scr_pmix_event_registered) {
+    return SCR_SUCCESS;
+  }
+
+  /* look up the name now, the scripts name the dataset to mark it current */
+  int id = scr_ckpt_dset_id;
+  char* name = NULL;
+  if (id > 0 && cindex != NULL) {
+    scr_dataset* dataset = scr_dataset_new();
+    scr_cache_index_get_dataset(cindex, id, dataset);
+    char* dataset_name;
+    if (scr_dataset_get_name(dataset, &dataset_name) == SCR_SUCCESS) {
+      name = strdup(dataset_name);
+    }
+    scr_dataset_delete(&dataset);
+  }
+
+  pthread_mutex_lock(&scr_pmix_event_lock);
+  scr_free(&scr_pmix_event_name);
+  scr_pmix_event_id   = (name != NULL) ? id : 0;
+  scr_pmix_event_name = name;
+  pthread_mutex_unlock(&scr_pmix_event_lock);
+
+  return SCR_SUCCESS;
+}
+
+int scr_pmix_event_failed(void)
+{
+  return (scr_pmix_event_count > 0);
+}
+
+int scr_pmix_event_respond(scr_cache_index* cindex)
+{
+  /* nothing to do if no failure or if we already acted on all of them */
+  int count = scr_pmix_event_count;
+  if (count == 0 || count == scr_pmix_event_handled) {
+    return SCR_SUCCESS;
+  }
+  scr_pmix_event_handled = count;
+
+  scr_dbg(0, "Process or node failure reported, marking cached datasets for rebuild");
+  if (scr_log_enable) {
+    scr_log_event("PMIX_FAILURE", NULL, NULL, NULL, NULL, NULL);
+  }
+
+  /* the redundancy data of every dataset in cache was spread over the
+   * failed processes, so each needs to be rebuilt on restart */
+  if (cindex != NULL) {
+    int ndsets;
+    int* dsets;
+    scr_cache_index_list_datasets(cindex, &ndsets, &dsets);
+    int i;
+    for (i = 0; i < ndsets; i++) {
+      scr_cache_index_set_rebuild(cindex, dsets[i], 1);
+    }
+    scr_free(&dsets);
+    scr_cache_index_write(scr_cindex_file, cindex);
+  }
+
+  /* don't trust what we recorded about files before the failure */
+  scr_cache_known_free();
+
+  return SCR_SUCCESS;
+}
+
+int scr_pmix_event_finalize(void)
+{
+  if (scr_pmix_event_registered) {
+    PMIx_Deregister_event_handler(scr_pmix_event_ref, NULL, NULL);
+    scr_pmix_event_registered = 0;
+  }
+
+  /* let the emergency flush finish before we go away */
+  pthread_mutex_lock(&scr_pmix_event_lock);
+  if (scr_pmix_event_pid >= 0) {
+    int status;
+    if (waitpid(scr_pmix_event_pid, &status, 0) == scr_pmix_event_pid &&
+        WIFEXITED(status) && WEXITSTATUS(status) == 0)
+    {
+      scr_dbg(1, "Emergency flush from %s completed", scr_my_hostname);
+    } else {
+      scr_err("Emergency flush from %s failed @ %s:%d",
+        scr_my_hostname, __FILE__, __LINE__
+      );
+    }
+    scr_pmix_event_pid = -1;
+  }
+
+  int i;
+  for (i = 0; i < scr_pmix_event_nhosts; i++) {
+    scr_free(&scr_pmix_event_hosts[i]);
+  }
+  scr_pmix_event_nhosts = 0;
+
+  scr_pmix_event_id = 0;
+  scr_free(&scr_pmix_event_name);
+  scr_free(&scr_pmix_event_prefix);
+  scr_free(&scr_pmix_event_cntl);
+  pthread_mutex_unlock(&scr_pmix_event_lock);
+
+  return SCR_SUCCESS;
+}
+
+#else /* HAVE_PMIX_EVENTS */
+
+int scr_pmix_event_init(void)
+{
+  return SCR_SUCCESS;
+}
+
+int scr_pmix_event_checkpoint(const scr_cache_index* cindex)
+{
+  return SCR_SUCCESS;
+}
+
+int scr_pmix_event_failed(void)
+{
+  return 0;
+}
+
+int scr_pmix_event_respond(scr_cache_index* cindex)
+{
+  return SCR_SUCCESS;
+}
+
+int scr_pmix_event_finalize(void)
+{
+  return SCR_SUCCESS;
+}
+
+#endif /* HAVE_PMIX_EVENTS */
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_PMIX_EVENT_H
+#define SCR_PMIX_EVENT_H
+
+#include "scr_cache_index.h"
+
+/*
+=========================================
+This file subscribes to PMIx process and node failure events, so the
+library learns about a failure as soon as the resource manager does
+rather than from the launcher scripts after the job step ends.  The
+event handler runs in the PMIx progress thread, where it records the
+failure and has one process per surviving node start copying the
+newest checkpoint in cache to the prefix directory with scr_copy,
+after which scr_index adds it to the index file as the checkpoint to
+restart from.  The handler only uses values the application thread
+recorded under a lock.  The application thread then marks cached datasets as needing a
+rebuild and tells the application to exit on its next call to
+SCR_Should_exit.  Without PMIx support, these do nothing.
+=========================================
+*/
+
+/* register for failure events, call after PMIx has been initialized */
+int scr_pmix_event_init(void);
+
+/* record the newest checkpoint in cindex as the one to flush if a
+ * failure is reported, call after each checkpoint completes */
+int scr_pmix_event_checkpoint(const scr_cache_index* cindex);
+
+/* returns 1 if a process or node failure has been reported */
+int scr_pmix_event_failed(void);
+
+/* act on any reported failure from the application thread,
+ * marks datasets in cindex as needing a rebuild */
+int scr_pmix_event_respond(scr_cache_index* cindex);
+
+/* wait for any emergency flush to finish and deregister the handler,
+ * call before PMIx is finalized */
+int scr_pmix_event_finalize(void);
+
+#endif
@@ -15,35 +15,39 @@
 
 #include "spath.h"
 #include "kvtree.h"
-#include "dtcmp.h"
+#include "kvtree_util.h"
 
 #include <sys/types.h>
 #include <dirent.h>
-
-/* delete named dataset from index file in prefix directory */
-static int scr_prefix_remove_index(const char* name)
-{
-  /* delete from index file */
-  if (scr_my_rank_world == 0) {
-      /* read the index file */
-      kvtree* index_hash = kvtree_new();
-      if (scr_index_read(scr_prefix_path, index_hash) == SCR_SUCCESS) {
-        /* if there is an entry for this dataset, remove it */
-        int id;
-        if (scr_index_get_id_by_name(index_hash, name, &id) == SCR_SUCCESS) {
-          /* found an entry, remove it and update the index file */
-          scr_index_remove(index_hash, name);
-          scr_index_write(scr_prefix_path, index_hash);
-        }
-      }
-      kvtree_delete(&index_hash);
-  }
-
-  /* hold everyone until delete is complete */
-  MPI_Barrier(scr_comm_world);
-
-  return SCR_SUCCESS;
-}
+#include <pthread.h>
+
+/* files and directories of datasets to be deleted from the prefix directory */
+typedef struct scr_prefix_job_struct {
+  int    num_files; /* number of files to unlink */
+  char** files;     /* files to unlink */
+  int    num_dirs;  /* number of directories to remove */
+  char** dirs;      /* directories to remove once files are gone, deepest first */
+  int    num_scans; /* number of dataset metadata directories */
+  char** scans;     /* scr.dataset.<id> directories to empty and remove */
+  int    threads;   /* number of threads to unlink files with */
+  struct scr_prefix_job_struct* next; /* next job in queue */
+} scr_prefix_job;
+
+/* files of a job that unlink threads pull from in order */
+typedef struct {
+  char** files;         /* files to unlink */
+  int count;            /* number of files */
+  int next;             /* index of next file to unlink */
+  pthread_mutex_t lock; /* protects next */
+} scr_prefix_unlink_batch;
+
+static pthread_t       scr_prefix_thread;
+static pthread_mutex_t scr_prefix_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  scr_prefix_cond = PTHREAD_COND_INITIALIZER;
+static int             scr_prefix_started = 0;       /* whether thread is running */
+static int             scr_prefix_stop    = 0;       /* tells thread to exit */
+static scr_prefix_job* scr_prefix_head    = NULL;    /* queued jobs, oldest first */
+static scr_prefix_job* scr_prefix_tail    = NULL;    /* newest queued job */
 
 /* open dirname, scan entries, and delete them */
 static int scr_prefix_rmscan(const char* dirname)
@@ -88,11 +92,207 @@ static int scr_prefix_rmscan(const char* dirname)
   return rc;
 }
 
-/* deletes user data files from prefix directory for named dataset */
-static int scr_prefix_delete_data(int id)
+/* unlink files of batch until none are left */
+static void* scr_prefix_unlink_run(void* arg)
 {
-  int rc = SCR_SUCCESS;
+  scr_prefix_unlink_batch* b = (scr_prefix_unlink_batch*) arg;
+  while (1) {
+    pthread_mutex_lock(&b->lock);
+    int i = b->next++;
+    pthread_mutex_unlock(&b->lock);
+    if (i >= b->count) {
+      break;
+    }
+    if (unlink(b->files[i]) != 0 && errno != ENOENT) {
+      scr_dbg(2, "Failed to delete file %s: %s @ %s:%d",
+        b->files[i], strerror(errno), __FILE__, __LINE__
+      );
+    }
+  }
+  return NULL;
+}
+
+/* delete files and directories of a job, runs without the lock held */
+static void scr_prefix_job_run(scr_prefix_job* job)
+{
+  /* spread the unlinks over a few threads, the calling thread is one of them */
+  scr_prefix_unlink_batch b;
+  b.files = job->files;
+  b.count = job->num_files;
+  b.next  = 0;
+  pthread_mutex_init(&b.lock, NULL);
+
+  int threads = job->threads;
+  if (threads > b.count) {
+    threads = b.count;
+  }
+  if (threads < 1) {
+    threads = 1;
+  }
+  pthread_t* tids = (pthread_t*) SCR_MALLOC(threads * sizeof(pthread_t));
+  int started = 0;
+  int i;
+  for (i = 1; i < threads; i++) {
+    if (pthread_create(&tids[started], NULL, scr_prefix_unlink_run, &b) == 0) {
+      started++;
+    }
+  }
+  scr_prefix_unlink_run(&b);
+  for (i = 0; i < started; i++) {
+    pthread_join(tids[i], NULL);
+  }
+  scr_free(&tids);
+  pthread_mutex_destroy(&b.lock);
+
+  /* every process tries each directory above its own files, deepest first,
+   * a directory is left alone while other processes still have files in it,
+   * and the last process to empty it removes it along with its parents */
+  for (i = 0; i < job->num_dirs; i++) {
+    if (rmdir(job->dirs[i]) != 0 &&
+        errno != ENOENT && errno != ENOTEMPTY && errno != EEXIST)
+    {
+      scr_dbg(2, "Failed to delete directory %s: %s @ %s:%d",
+        job->dirs[i], strerror(errno), __FILE__, __LINE__
+      );
+    }
+  }
+
+  /* delete files within scr.dataset.id directory,
+   * this is most likely just the summary and rank2file files,
+   * but we do this by scanning and deleting items
+   * in case we happened to execute a scavenge in which case
+   * we'll also have lots of redundancy and filemap files */
+  for (i = 0; i < job->num_scans; i++) {
+    scr_prefix_rmscan(job->scans[i]);
+  }
+}
+
+/* free a job and the names it references */
+static void scr_prefix_job_free(scr_prefix_job** ptr_job)
+{
+  scr_prefix_job* job = *ptr_job;
+  int i;
+  for (i = 0; i < job->num_files; i++) {
+    scr_free(&job->files[i]);
+  }
+  for (i = 0; i < job->num_dirs; i++) {
+    scr_free(&job->dirs[i]);
+  }
+  for (i = 0; i < job->num_scans; i++) {
+    scr_free(&job->scans[i]);
+  }
+  scr_free(&job->files);
+  scr_free(&job->dirs);
+  scr_free(&job->scans);
+  scr_free(ptr_job);
+}
+
+/* delete files of queued jobs until told to stop */
+static void* scr_prefix_run(void* arg)
+{
+  pthread_mutex_lock(&scr_prefix_lock);
+  while (1) {
+    scr_prefix_job* job = scr_prefix_head;
+    if (job == NULL) {
+      if (scr_prefix_stop) {
+        break;
+      }
+      pthread_cond_wait(&scr_prefix_cond, &scr_prefix_lock);
+      continue;
+    }
 
+    /* only this thread removes jobs, so the head stays put while we work on it */
+    pthread_mutex_unlock(&scr_prefix_lock);
+    scr_prefix_job_run(job);
+    pthread_mutex_lock(&scr_prefix_lock);
+
+    scr_prefix_head = job->next;
+    if (scr_prefix_head == NULL) {
+      scr_prefix_tail = NULL;
+    }
+    scr_prefix_job_free(&job);
+    pthread_cond_broadcast(&scr_prefix_cond);
+  }
+  pthread_mutex_unlock(&scr_prefix_lock);
+  return NULL;
+}
+
+/* run job in the background, or now if not deleting in the background,
+ * takes ownership of job */
+static void scr_prefix_job_add(scr_prefix_job* job)
+{
+  if (! scr_prefix_delete_async) {
+    scr_prefix_job_run(job);
+    scr_prefix_job_free(&job);
+    return;
+  }
+
+  pthread_mutex_lock(&scr_prefix_lock);
+
+  /* start the thread with the first job */
+  if (! scr_prefix_started) {
+    scr_prefix_stop = 0;
+    if (pthread_create(&scr_prefix_thread, NULL, scr_prefix_run, NULL) != 0) {
+      pthread_mutex_unlock(&scr_prefix_lock);
+      scr_warn("Failed to start thread to delete files from prefix, deleting inline @ %s:%d",
+        __FILE__, __LINE__
+      );
+      scr_prefix_job_run(job);
+      scr_prefix_job_free(&job);
+      return;
+    }
+    scr_prefix_started = 1;
+  }
+
+  if (scr_prefix_tail != NULL) {
+    scr_prefix_tail->next = job;
+  } else {
+    scr_prefix_head = job;
+  }
+  scr_prefix_tail = job;
+  pthread_cond_broadcast(&scr_prefix_cond);
+
+  pthread_mutex_unlock(&scr_prefix_lock);
+}
+
+/* append name to list of count names with room for cap, growing it as needed */
+static void scr_prefix_list_add(char*** list, int* count, int* cap, char* name)
+{
+  if (*count == *cap) {
+    int newcap = (*cap > 0) ? *cap * 2 : 64;
+    char** bigger = (char**) SCR_MALLOC(newcap * sizeof(char*));
+    if (*count > 0) {
+      memcpy(bigger, *list, *count * sizeof(char*));
+    }
+    scr_free(list);
+    *list = bigger;
+    *cap  = newcap;
+  }
+  (*list)[*count] = name;
+  (*count)++;
+}
+
+/* directory name paired with its depth, used to order removal */
+typedef struct {
+  char* dir;
+  int depth;
+} scr_prefix_dir;
+
+/* sort directories deepest first */
+static int scr_prefix_dir_cmp(const void* a, const void* b)
+{
+  const scr_prefix_dir* da = (const scr_prefix_dir*) a;
+  const scr_prefix_dir* db = (const scr_prefix_dir*) b;
+  if (da->depth != db->depth) {
+    return (da->depth > db->depth) ? -1 : 1;
+  }
+  return strcmp(da->dir, db->dir);
+}
+
+/* add user data files this process wrote for dataset id and the
+ * directories above them to the lists of job, collective over all procs */
+static int scr_prefix_add_data(int id, scr_prefix_job* job, int* file_cap, kvtree* dirs)
+{
   /* build path to dataset directory under prefix */
   spath* dataset_path = spath_from_str(scr_prefix_scr);
   spath_append_strf(dataset_path, "scr.dataset.%d", id);
@@ -107,24 +307,35 @@ static int scr_prefix_delete_data(int id)
 
   /* get the list of files to read */
   kvtree* filelist = kvtree_new();
-  if (kvtree_read_scatter(rank2file, filelist, scr_comm_world) != KVTREE_SUCCESS) {
+  if (scr_rank2file_read(rank2file, filelist, scr_comm_world) != SCR_SUCCESS) {
     /* failed to read list of files in this dataset */
-    scr_free(&rank2file);  
+    scr_free(&rank2file);
     kvtree_delete(&filelist);
     return SCR_FAILURE;
   }
 
   /* done with rank2file */
-  scr_free(&rank2file);  
+  scr_free(&rank2file);
 
-  /* allocate list of file names */
-  kvtree* files = kvtree_get(filelist, "FILE");
-
-  /* delete files and count up number of directories */
-  int num_dirs = 0;
-  int min_depth = -1;
-  int max_depth = -1;
+  /* delete any container files this process created, the
+   * files packed inside have no files or directories of their own */
   kvtree_elem* elem;
+  kvtree* containers = kvtree_get(filelist, SCR_KEY_CONTAINER);
+  for (elem = kvtree_elem_first(containers);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    spath* container_path = spath_dup(scr_prefix_path);
+    spath_append_str(container_path, kvtree_elem_key(elem));
+    spath_reduce(container_path);
+    char* container = spath_strdup(container_path);
+    scr_prefix_list_add(&job->files, &job->num_files, file_cap, container);
+    spath_delete(&container_path);
+  }
+
+  /* record files and each directory between them and the prefix directory */
+  int parent_components = spath_components(scr_prefix_path);
+  kvtree* files = kvtree_get(filelist, "FILE");
   for (elem = kvtree_elem_first(files);
        elem != NULL;
        elem = kvtree_elem_next(elem))
@@ -132,195 +343,192 @@ static int scr_prefix_delete_data(int id)
     /* get the file name */
     char* file = kvtree_elem_key(elem);
 
+    /* skip files that were packed into a container */
+    if (kvtree_get(kvtree_elem_hash(elem), SCR_KEY_CONTAINER) != NULL) {
+      continue;
+    }
+
+    /* a segment of a shared file has no file of its own, every rank
+     * wrote into the shared file, so rank 0 deletes it for all */
+    char* shared = NULL;
+    kvtree_util_get_str(kvtree_elem_hash(elem), SCR_KEY_SHARED, &shared);
+
     /* build full path to the file under the prefix directory */
     spath* file_path = spath_dup(scr_prefix_path);
-    spath_append_str(file_path, file);
+    spath_append_str(file_path, (shared != NULL) ? shared : file);
     spath_reduce(file_path);
-    char* src_file = spath_strdup(file_path);
-
-    /* delete the file */
-    scr_file_unlink(src_file);
-
-    /* free file path string */
-    scr_free(&src_file);
+    if (shared == NULL || scr_my_rank_world == 0) {
+      char* src_file = spath_strdup(file_path);
+      scr_prefix_list_add(&job->files, &job->num_files, file_cap, src_file);
+    }
 
-    /* now get the directory portion */
+    /* work back for each directory component from the file
+     * to the prefix directory, files of a dataset share just a few */
     spath_dirname(file_path);
     if (spath_is_child(scr_prefix_path, file_path)) {
-      int parent_components = spath_components(scr_prefix_path);
       int target_components = spath_components(file_path);
-      num_dirs += target_components - parent_components;
+      while (target_components > parent_components) {
+        char* dir = spath_strdup(file_path);
+        kvtree_util_set_int(dirs, dir, target_components);
+        scr_free(&dir);
 
-      if (min_depth == -1 || parent_components < min_depth) {
-        min_depth = parent_components;
-      }
-      if (max_depth == -1 || target_components > max_depth) {
-        max_depth = target_components;
+        spath_dirname(file_path);
+        target_components--;
       }
     }
     spath_delete(&file_path);
   }
 
-  /* identify minimum rank with a valid value */
-  int source;
-  int source_rank = scr_ranks_world;
-  if (min_depth != -1) {
-    source_rank = scr_my_rank_world;
-  }
-  MPI_Allreduce(&source_rank, &source, 1, MPI_INT, MPI_MIN, scr_comm_world);
-
-  /* delete directories for user dataset files if any rank found them */
-  if (source < scr_ranks_world) {
-    /* some rank has defined min/max values,
-     * get min_depth from that rank */
-    int min_source = min_depth;
-    MPI_Bcast(&min_source, 1, MPI_INT, source, scr_comm_world);
+  /* done with the list of files */
+  kvtree_delete(&filelist);
 
-    /* initialize our own min/max if needed */
-    if (min_depth == -1) {
-      min_depth = min_source;
-    }
-    if (max_depth == -1) {
-      max_depth = min_source;
-    }
+  return SCR_SUCCESS;
+}
 
-    /* get global min and max values across all procs */
-    int min_global, max_global;
-    MPI_Allreduce(&min_depth, &min_global, 1, MPI_INT, MPI_MIN, scr_comm_world);
-    MPI_Allreduce(&max_depth, &max_global, 1, MPI_INT, MPI_MAX, scr_comm_world);
+/* delete count datasets given by ids from the prefix directory,
+ * names of the datasets are only needed on rank 0,
+ * the datasets leave the index file before this returns,
+ * while their files may be deleted in the background,
+ * must be called by all procs */
+static int scr_prefix_delete_list(int count, const int* ids, char** names)
+{
+  int rc = SCR_SUCCESS;
+  if (count == 0) {
+    return rc;
+  }
 
-    /* allocate memory to hold list of each of our directories */
-    char** dirs = (char**) SCR_MALLOC(num_dirs * sizeof(char*));
-    int* depths = (int*)   SCR_MALLOC(num_dirs * sizeof(int));
+  scr_trace_mark_begin("prefix_delete");
 
-    /* get list of directories */
-    int i = 0;
-    for (elem = kvtree_elem_first(files);
-         elem != NULL;
-         elem = kvtree_elem_next(elem))
-    {
-      /* get the file name */
-      char* file = kvtree_elem_key(elem);
-
-      /* build full path to the file under the prefix directory */
-      spath* file_path = spath_dup(scr_prefix_path);
-      spath_append_str(file_path, file);
-      spath_reduce(file_path);
-
-      /* now get the directory portion */
-      spath_dirname(file_path);
-      if (spath_is_child(scr_prefix_path, file_path)) {
-        /* work back for each directory component from the file
-         * to the prefix directory */
-        int parent_components = spath_components(scr_prefix_path);
-        int target_components = spath_components(file_path);
-        while (target_components > parent_components) {
-          /* get a copy of this directory string and its depth */
-          char* dir = spath_strdup(file_path);
-          dirs[i]   = dir;
-          depths[i] = target_components;
-          i++;
-
-          /* chop off another component and try again */
-          spath_dirname(file_path);
-          target_components--;
+  /* drop all entries from the index file with one update,
+   * so no restart picks a dataset whose files are going away */
+  if (scr_my_rank_world == 0) {
+    kvtree* index_hash = kvtree_new();
+    if (scr_index_read(scr_prefix_path, index_hash) == SCR_SUCCESS) {
+      int changed = 0;
+      int i;
+      for (i = 0; i < count; i++) {
+        /* if there is an entry for this dataset, remove it */
+        int id;
+        if (scr_index_get_id_by_name(index_hash, names[i], &id) == SCR_SUCCESS) {
+          scr_index_remove(index_hash, names[i]);
+          changed = 1;
         }
       }
-
-      /* release the path object for this file */
-      spath_delete(&file_path);
+      if (changed) {
+        scr_index_write(scr_prefix_path, index_hash);
+      }
     }
+    kvtree_delete(&index_hash);
+  }
 
-    /* compute union of directories to identify leaders */
-    uint64_t groups;
-    uint64_t* group_id    = (uint64_t*) SCR_MALLOC(sizeof(uint64_t) * num_dirs);
-    uint64_t* group_ranks = (uint64_t*) SCR_MALLOC(sizeof(uint64_t) * num_dirs);
-    uint64_t* group_rank  = (uint64_t*) SCR_MALLOC(sizeof(uint64_t) * num_dirs);
-    int dtcmp_rc = DTCMP_Rankv_strings(
-      num_dirs, (const char**) dirs, &groups, group_id, group_ranks, group_rank,
-      DTCMP_FLAG_NONE, scr_comm_world
-    );
-    if (dtcmp_rc != DTCMP_SUCCESS) {
-      rc = SCR_FAILURE;
+  /* gather files and directories of every dataset into a single job */
+  scr_prefix_job* job = (scr_prefix_job*) SCR_MALLOC(sizeof(scr_prefix_job));
+  job->num_files = 0;
+  job->files     = NULL;
+  job->num_dirs  = 0;
+  job->dirs      = NULL;
+  job->num_scans = 0;
+  job->scans     = NULL;
+  job->next      = NULL;
+
+  /* divide threads on the node among its processes */
+  int ranks_node;
+  MPI_Comm_size(scr_comm_node, &ranks_node);
+  job->threads = scr_prefix_delete_threads / ranks_node;
+  if (job->threads < 1) {
+    job->threads = 1;
+  }
+
+  int file_cap = 0;
+  int scan_cap = 0;
+  kvtree* dirs = kvtree_new();
+  int i;
+  for (i = 0; i < count; i++) {
+    /* print a debug messages */
+    if (scr_my_rank_world == 0) {
+      scr_dbg(1, "Deleting dataset %d `%s' from `%s'", ids[i], names[i], scr_prefix);
     }
 
-    /* delete directories from bottom level to top */
-    int depth;
-    for (depth = max_global; depth >= min_global; depth--) {
-      /* iterate over each directory we have,
-       * delete it if it's at the right level and
-       * if we are the designated leader */
-      for (i = 0; i < num_dirs; i++) {
-        if (depths[i] == depth &&
-            group_rank[i] == 0)
-        {
-          /* will naturally fail to delete non-empty directories */
-          scr_rmdir(dirs[i]);
-        }
-      }
+    /* a dataset without a rank2file map still has its metadata deleted */
+    scr_prefix_add_data(ids[i], job, &file_cap, dirs);
 
-      /* execute barrier to ensure everyone is done with this level
-       * before we move a level up */
-      MPI_Barrier(scr_comm_world);
+    /* rank 0 empties the scr.dataset.id directory */
+    if (scr_my_rank_world == 0) {
+      spath* dataset_path = spath_from_str(scr_prefix_scr);
+      spath_append_strf(dataset_path, "scr.dataset.%d", ids[i]);
+      char* dataset_dir = spath_strdup(dataset_path);
+      spath_delete(&dataset_path);
+      scr_prefix_list_add(&job->scans, &job->num_scans, &scan_cap, dataset_dir);
     }
+  }
 
-    /* free dtcmp buffers */
-    scr_free(&group_id);
-    scr_free(&group_ranks);
-    scr_free(&group_rank);
+  /* order directories deepest first */
+  int num_dirs = kvtree_size(dirs);
+  if (num_dirs > 0) {
+    scr_prefix_dir* list = (scr_prefix_dir*) SCR_MALLOC(num_dirs * sizeof(scr_prefix_dir));
+    kvtree_elem* elem;
+    int n = 0;
+    for (elem = kvtree_elem_first(dirs);
+         elem != NULL;
+         elem = kvtree_elem_next(elem))
+    {
+      list[n].dir = kvtree_elem_key(elem);
+      kvtree_util_get_int(dirs, list[n].dir, &list[n].depth);
+      n++;
+    }
+    qsort(list, n, sizeof(scr_prefix_dir), scr_prefix_dir_cmp);
 
-    /* free memory allocated for directory list */
-    for (i = 0; i < num_dirs; i++) {
-      /* free directory name strings */
-      scr_free(&dirs[i]);
+    job->dirs = (char**) SCR_MALLOC(n * sizeof(char*));
+    for (i = 0; i < n; i++) {
+      job->dirs[i] = strdup(list[i].dir);
     }
-    scr_free(&dirs);
-    scr_free(&depths);
+    job->num_dirs = n;
+    scr_free(&list);
   }
+  kvtree_delete(&dirs);
 
-  /* done with the list of files */
-  kvtree_delete(&filelist);
+  /* hand the job to the background thread */
+  scr_prefix_job_add(job);
+
+  /* hold everyone until delete is complete or queued */
+  MPI_Barrier(scr_comm_world);
 
+  scr_trace_mark_end("prefix_delete");
   return rc;
 }
 
 /* delete named dataset from the prefix directory */
 int scr_prefix_delete(int id, const char* name)
 {
-  int rc = SCR_SUCCESS;
+  char* names[1];
+  names[0] = (char*) name;
+  return scr_prefix_delete_list(1, &id, names);
+}
 
-  /* print a debug messages */
-  if (scr_my_rank_world == 0) {
-    scr_dbg(1, "Deleting dataset %d `%s' from `%s'", id, name, scr_prefix);
+/* rank 0 broadcasts the list of count datasets it picked and all procs
+ * delete them together, frees the list on rank 0 */
+static int scr_prefix_delete_picked(int count, int* ids, char** names)
+{
+  /* broadcast ids of datasets from rank 0, names stay there */
+  MPI_Bcast(&count, 1, MPI_INT, 0, scr_comm_world);
+  if (scr_my_rank_world != 0) {
+    ids = (int*) SCR_MALLOC((count + 1) * sizeof(int));
   }
-  
-  /* first, delete user data files from prefix directory */
-  scr_prefix_delete_data(id);
-
-  /* delete files within scr.dataset.id directory,
-   * this is most likely just the summary and rank2file files,
-   * but we do this by scanning and deleting items
-   * in case we happened to execute a scavenge in which case
-   * we'll also have lots of redundancy and filemap files */
-  if (scr_my_rank_world == 0) {
-    /* build path to dataset directory under prefix */
-    spath* dataset_path = spath_from_str(scr_prefix_scr);
-    spath_append_strf(dataset_path, "scr.dataset.%d", id);
-    char* dataset_dir = spath_strdup(dataset_path);
-    spath_delete(&dataset_path);
-
-    /* scan over all items in the directory and delete them */
-    scr_prefix_rmscan(dataset_dir);
-
-    /* free dataset directory name */
-    scr_free(&dataset_dir);
+  if (count > 0) {
+    MPI_Bcast(ids, count, MPI_INT, 0, scr_comm_world);
   }
 
-  /* drop the entry from the index file */
-  scr_prefix_remove_index(name);
+  int rc = scr_prefix_delete_list(count, ids, names);
 
-  /* hold everyone until delete is complete */
-  MPI_Barrier(scr_comm_world);
+  /* free the list */
+  int i;
+  if (scr_my_rank_world == 0) {
+    for (i = 0; i < count; i++) {
+      scr_free(&names[i]);
+    }
+  }
+  scr_free(&names);
+  scr_free(&ids);
 
   return rc;
 }
@@ -328,49 +536,43 @@ int scr_prefix_delete(int id, const char* name)
 /* keep a sliding window of checkpoints in the prefix directory,
  * delete any pure checkpoints that fall outside of the window
  * defined by the given dataset id and the window width,
- * excludes checkpoints that are marked as output */
+ * excludes checkpoints that are marked as output and checkpoints
+ * that a delta flush was written against */
 int scr_prefix_delete_sliding(int id, int window)
 {
-  /* rank 0 reads the index file */
-  kvtree* index_hash = NULL;
-  int read_index_file = 0;
+  /* rank 0 picks every checkpoint outside of the window in one pass */
+  int count = 0;
+  int* ids = NULL;
+  char** names = NULL;
   if (scr_my_rank_world == 0) {
-    /* create an empty hash to store our index */
-    index_hash = kvtree_new();
-
-    /* read the index file */
-    if (scr_index_read(scr_prefix_path, index_hash) == SCR_SUCCESS) {
-      read_index_file = 1;
-    }
-  }
-
-  /* don't enter while loop below if rank 0 failed to read index file */
-  int continue_deleting = 1;
-  MPI_Bcast(&read_index_file, 1, MPI_INT, 0, scr_comm_world);
-  if (! read_index_file) {
-    continue_deleting = 0;
-  }
-
-  /* we count the current checkpoint as a member of the window */
-  window--;
-
-  /* iterate over all checkpoints in the prefix directory,
-   * deleting any pure checkpoints that fall outside of the window */
-  int target_id = id;
-  while (continue_deleting) {
-    /* rank 0 determines the directory to fetch from */
-    char target[SCR_MAX_FILENAME];
-    if (scr_my_rank_world == 0) {
-      /* TODO: delete checkpoint if not valid, even if in window? */
-
-      /* get the most recent complete checkpoint older than the target id */
-      int next_id = -1;
-      scr_index_get_most_recent_complete(index_hash, target_id, &next_id, target);
-      target_id = next_id;
+    /* create an empty summary to store our index */
+    scr_index_summary* summary = scr_index_summary_new();
+
+    /* read the summary, which is sorted by id */
+    if (scr_index_summary_read(scr_prefix_path, summary) == SCR_SUCCESS) {
+      ids   = (int*)   SCR_MALLOC((summary->count + 1) * sizeof(int));
+      names = (char**) SCR_MALLOC((summary->count + 1) * sizeof(char*));
+
+      /* we count the current checkpoint as a member of the window */
+      window--;
+
+      /* iterate over all checkpoints in the prefix directory,
+       * picking any pure checkpoints that fall outside of the window */
+      int target_id = id;
+      while (1) {
+        /* TODO: delete checkpoint if not valid, even if in window? */
+
+        /* get the most recent complete checkpoint older than the target id */
+        char target[SCR_MAX_FILENAME];
+        int next_id = -1;
+        scr_index_summary_most_recent_complete(summary, target_id, &next_id, target);
+        target_id = next_id;
+
+        /* ran out of checkpoints to consider */
+        if (target_id < 0) {
+          break;
+        }
 
-      /* found the next most recent checkpoint,
-       * consider whether we should keep it */
-      if (target_id >= 0) {
         /* keep this checkpoint if we're still in the window */
         if (window > 0) {
           /* saved by the window, look for something older */
@@ -380,48 +582,32 @@ int scr_prefix_delete_sliding(int id, int window)
 
         /* not in window, but we also keep any checkpoints
          * that are marked as output */
-        scr_dataset* dataset = scr_dataset_new();
-        if (scr_index_get_dataset(index_hash, target_id, target, dataset) == SCR_SUCCESS) {
-          /* get output flag for this dataset */
-          int is_output = scr_dataset_is_output(dataset);
-          if (is_output) {
-            /* this checkpoint is also marked as output, so don't delete it */
-            scr_dataset_delete(&dataset);
-            continue;
-          }
+        const scr_index_entry* entry = scr_index_summary_get(summary, target_id);
+        if (entry != NULL && (entry->flags & SCR_INDEX_FLAG_OUTPUT)) {
+          /* this checkpoint is also marked as output, so don't delete it */
+          continue;
         }
-        scr_dataset_delete(&dataset);
-      }
-    }
-
-    /* broadcast target id from rank 0 */
-    MPI_Bcast(&target_id, 1, MPI_INT, 0, scr_comm_world);
 
-    /* if we got an id, delete it, otherwise we're done */
-    if (target_id >= 0) {
-      /* get name from rank 0 */
-      scr_strn_bcast(target, sizeof(target), 0, scr_comm_world);
-
-      /* delete this dataset from the prefix directory */
-      scr_prefix_delete(target_id, target);
+        /* keep any checkpoint that a more recent delta flush depends on */
+        if (scr_index_summary_is_base(summary, target_id)) {
+          continue;
+        }
 
-      /* remove dataset from index hash */
-      if (scr_my_rank_world == 0) {
-        scr_index_remove(index_hash, target);
+        /* pick it, and drop it from the summary so older checkpoints
+         * it was the only dependent of can go too */
+        ids[count]   = target_id;
+        names[count] = strdup(target);
+        count++;
+        scr_index_summary_remove(summary, target_id);
       }
-    } else {
-      /* ran out of checkpoints to consider */
-      continue_deleting = 0;
     }
-  }
 
-  /* delete the index hash */
-  if (scr_my_rank_world == 0) {
-    kvtree_delete(&index_hash);
+    /* delete the index summary */
+    scr_index_summary_delete(&summary);
   }
 
-  /* hold everyone until delete is complete */
-  MPI_Barrier(scr_comm_world);
+  /* delete everything we picked at once */
+  scr_prefix_delete_picked(count, ids, names);
 
   return SCR_SUCCESS;
 }
@@ -430,64 +616,79 @@ int scr_prefix_delete_sliding(int id, int window)
  * both checkpoint and output */
 int scr_prefix_delete_all(void)
 {
-  /* rank 0 reads the index file */
-  kvtree* index_hash = NULL;
-  int read_index_file = 0;
+  /* rank 0 lists every dataset, oldest first */
+  int count = 0;
+  int* ids = NULL;
+  char** names = NULL;
   if (scr_my_rank_world == 0) {
-    /* create an empty hash to store our index */
-    index_hash = kvtree_new();
+    /* create an empty summary to store our index */
+    scr_index_summary* summary = scr_index_summary_new();
+
+    /* read the summary, which is sorted by id */
+    if (scr_index_summary_read(scr_prefix_path, summary) == SCR_SUCCESS) {
+      ids   = (int*)   SCR_MALLOC((summary->count + 1) * sizeof(int));
+      names = (char**) SCR_MALLOC((summary->count + 1) * sizeof(char*));
+      while (1) {
+        /* get the oldest dataset id */
+        int target_id;
+        char target[SCR_MAX_FILENAME];
+        scr_index_summary_oldest(summary, &target_id, target);
+        if (target_id < 0) {
+          break;
+        }
 
-    /* read the index file */
-    if (scr_index_read(scr_prefix_path, index_hash) == SCR_SUCCESS) {
-      read_index_file = 1;
+        ids[count]   = target_id;
+        names[count] = strdup(target);
+        count++;
+        scr_index_summary_remove(summary, target_id);
+      }
     }
-  }
 
-  /* don't enter while loop below if rank 0 failed to read index file */
-  int continue_deleting = 1;
-  MPI_Bcast(&read_index_file, 1, MPI_INT, 0, scr_comm_world);
-  if (! read_index_file) {
-    continue_deleting = 0;
+    /* delete the index summary */
+    scr_index_summary_delete(&summary);
   }
 
-  /* iterate and delete each dataset in the prefix directory */
-  while (continue_deleting) {
-    /* rank 0 determines the directory to fetch from */
-    int target_id;
-    char target[SCR_MAX_FILENAME];
-    if (scr_my_rank_world == 0) {
-      /* get the oldest dataset id */
-      scr_index_get_oldest(index_hash, &target_id, target);
-    }
-
-    /* broadcast target id from rank 0 */
-    MPI_Bcast(&target_id, 1, MPI_INT, 0, scr_comm_world);
+  /* delete everything at once */
+  scr_prefix_delete_picked(count, ids, names);
 
-    /* if we got an id, delete it, otherwise we're done */
-    if (target_id >= 0) {
-      /* get name from rank 0 */
-      scr_strn_bcast(target, sizeof(target), 0, scr_comm_world);
-
-      /* delete this dataset from the prefix directory */
-      scr_prefix_delete(target_id, target);
+  return SCR_SUCCESS;
+}
 
-      /* remove dataset from index hash */
-      if (scr_my_rank_world == 0) {
-        scr_index_remove(index_hash, target);
-      }
-    } else {
-      /* ran out of checkpoints to consider */
-      continue_deleting = 0;
-    }
+/* wait until every proc has deleted the files of datasets it queued,
+ * must be called by all procs */
+int scr_prefix_wait(void)
+{
+  if (! scr_prefix_delete_async) {
+    return SCR_SUCCESS;
   }
 
-  /* delete the index hash */
-  if (scr_my_rank_world == 0) {
-    kvtree_delete(&index_hash);
+  pthread_mutex_lock(&scr_prefix_lock);
+  while (scr_prefix_head != NULL) {
+    pthread_cond_wait(&scr_prefix_cond, &scr_prefix_lock);
   }
+  pthread_mutex_unlock(&scr_prefix_lock);
 
-  /* hold everyone until delete is complete */
+  /* directories are removed by whichever proc empties them last,
+   * so wait for all procs before anyone creates them again */
   MPI_Barrier(scr_comm_world);
 
   return SCR_SUCCESS;
 }
+
+/* finish deleting everything still queued and stop the background thread,
+ * must be called by all procs */
+void scr_prefix_finalize(void)
+{
+  scr_prefix_wait();
+
+  pthread_mutex_lock(&scr_prefix_lock);
+  int started = scr_prefix_started;
+  scr_prefix_stop = 1;
+  pthread_cond_broadcast(&scr_prefix_cond);
+  pthread_mutex_unlock(&scr_prefix_lock);
+
+  if (started) {
+    pthread_join(scr_prefix_thread, NULL);
+    scr_prefix_started = 0;
+  }
+}
@@ -12,6 +12,17 @@
 #ifndef SCR_PREFIX_H
 #define SCR_PREFIX_H
 
+/*
+=========================================
+This file deletes datasets from the prefix directory.  Datasets leave
+the index file right away, and each process queues the files it wrote
+for a background thread, which unlinks them with a few threads and then
+removes the directories that held them.  A directory goes away when the
+last process with files in it is done, so no collectives are needed
+after the files are queued.  The next flush waits for queued deletes.
+=========================================
+*/
+
 /* delete named dataset from the prefix directory */
 int scr_prefix_delete(int id, const char* name);
 
@@ -25,4 +36,12 @@ int scr_prefix_delete_sliding(int id, int window);
  * both checkpoint and output */
 int scr_prefix_delete_all(void);
 
+/* wait until every proc has deleted the files of datasets it queued,
+ * must be called by all procs */
+int scr_prefix_wait(void);
+
+/* finish deleting everything still queued and stop the background thread,
+ * must be called by all procs */
+void scr_prefix_finalize(void);
+
 #endif /* SCR_PREFIX_H */
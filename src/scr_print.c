@@ -1,4 +1,7 @@
 #include "kvtree.h"
+#include "spath.h"
+#include "scr.h"
+#include "scr_filemap.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -87,15 +90,18 @@ int main(int argc, char* argv[])
   /* get the file name */
   char* filename = argv[optind];
 
-  /* read in the file */
+  /* read in the file, filemaps are stored in a binary format,
+   * and the filemap reader falls back to kvtree for other files */
   kvtree* hash = kvtree_new();
-  if (kvtree_read_file(filename, hash) == KVTREE_SUCCESS) {
+  spath* path_file = spath_from_str(filename);
+  if (scr_filemap_read(path_file, hash) == SCR_SUCCESS) {
     /* we read the file, now print it out */
     kvtree_print_mode(hash, 0, print_mode);
   } else {
     printf("ERROR: Failed to read file: `%s'\n", filename);
     rc = 1;
   }
+  spath_delete(&path_file);
   kvtree_delete(&hash);
 
   return rc;
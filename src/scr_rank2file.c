@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+/* Implements the binary rank2file map, these functions do not depend
+ * on MPI so they can be used by the command line tools */
+
+#include "scr_conf.h"
+#include "scr.h"
+#include "scr_err.h"
+#include "scr_io.h"
+#include "scr_util.h"
+#include "scr_rank2file.h"
+
+#include "spath.h"
+#include "kvtree.h"
+#include "kvtree_util.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+
+/* magic string at the start of each shard */
+#define SCR_RANK2FILE_MAGIC   ("SCRM")
+#define SCR_RANK2FILE_VERSION (1)
+
+/* encode value as 8 bytes in big-endian order */
+void scr_rank2file_pack64(unsigned char* buf, uint64_t value)
+{
+  int i;
+  for (i = 7; i >= 0; i--) {
+    buf[i] = (unsigned char) (value & 0xff);
+    value >>= 8;
+  }
+}
+
+/* decode 8 bytes in big-endian order */
+uint64_t scr_rank2file_unpack64(const unsigned char* buf)
+{
+  uint64_t value = 0;
+  int i;
+  for (i = 0; i < 8; i++) {
+    value = (value << 8) | (uint64_t) buf[i];
+  }
+  return value;
+}
+
+/* fill in header for given shard of a map of ranks entries */
+void scr_rank2file_header(unsigned char* buf, int ranks, int shard_ranks, int shard)
+{
+  memset(buf, 0, SCR_RANK2FILE_HEADER_SIZE);
+  memcpy(buf, SCR_RANK2FILE_MAGIC, 4);
+  buf[7] = (unsigned char) SCR_RANK2FILE_VERSION;
+  scr_rank2file_pack64(&buf[8],  (uint64_t) ranks);
+  scr_rank2file_pack64(&buf[16], (uint64_t) shard_ranks);
+  scr_rank2file_pack64(&buf[24], (uint64_t) shard);
+}
+
+/* return newly allocated name of given shard of rank2file map in file */
+char* scr_rank2file_shard_name(const char* file, int shard)
+{
+  return scr_strdupf("%s.bin.%d", file, shard);
+}
+
+/* read header from open shard and check that it is the expected shard */
+static int scr_rank2file_check_header(
+  const char* name, int fd, int shard,
+  int* ranks, int* shard_ranks)
+{
+  unsigned char header[SCR_RANK2FILE_HEADER_SIZE];
+  if (pread(fd, header, sizeof(header), 0) != sizeof(header)) {
+    scr_err("Reading rank2file header: pread(%s) errno=%d %s @ %s:%d",
+      name, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  if (memcmp(header, SCR_RANK2FILE_MAGIC, 4) != 0 ||
+      header[7] != (unsigned char) SCR_RANK2FILE_VERSION)
+  {
+    scr_err("Unknown rank2file format in %s @ %s:%d",
+      name, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  *ranks       = (int) scr_rank2file_unpack64(&header[8]);
+  *shard_ranks = (int) scr_rank2file_unpack64(&header[16]);
+  int found    = (int) scr_rank2file_unpack64(&header[24]);
+  if (found != shard || *shard_ranks <= 0) {
+    scr_err("Invalid rank2file header in %s @ %s:%d",
+      name, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  return SCR_SUCCESS;
+}
+
+/* read header of first shard of binary map in file, returns SCR_FAILURE
+ * if there is no binary map */
+int scr_rank2file_read_header(const char* file, int* ranks, int* shard_ranks)
+{
+  char* name = scr_rank2file_shard_name(file, 0);
+  if (scr_file_exists(name) != SCR_SUCCESS) {
+    scr_free(&name);
+    return SCR_FAILURE;
+  }
+
+  int fd = scr_open(name, O_RDONLY);
+  if (fd < 0) {
+    scr_err("Opening rank2file: scr_open(%s) errno=%d %s @ %s:%d",
+      name, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_free(&name);
+    return SCR_FAILURE;
+  }
+
+  int rc = scr_rank2file_check_header(name, fd, 0, ranks, shard_ranks);
+
+  scr_close(name, fd);
+  scr_free(&name);
+
+  return rc;
+}
+
+/* read entry for rank from binary map in file into hash */
+int scr_rank2file_read_rank(const char* file, int rank, int shard_ranks, kvtree* hash)
+{
+  int rc = SCR_SUCCESS;
+
+  /* the shard holding our rank follows from the shard size */
+  int shard = rank / shard_ranks;
+  int index = rank - shard * shard_ranks;
+
+  char* name = scr_rank2file_shard_name(file, shard);
+  int fd = scr_open(name, O_RDONLY);
+  if (fd < 0) {
+    scr_err("Opening rank2file: scr_open(%s) errno=%d %s @ %s:%d",
+      name, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_free(&name);
+    return SCR_FAILURE;
+  }
+
+  int ranks, size;
+  if (scr_rank2file_check_header(name, fd, shard, &ranks, &size) != SCR_SUCCESS ||
+      size != shard_ranks || rank >= ranks)
+  {
+    scr_err("Rank %d not found in rank2file %s @ %s:%d",
+      rank, name, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  /* our entry lies between our offset and the next */
+  unsigned char table[16];
+  off_t pos = (off_t) SCR_RANK2FILE_HEADER_SIZE + (off_t) index * 8;
+  if (rc == SCR_SUCCESS && pread(fd, table, sizeof(table), pos) != sizeof(table)) {
+    scr_err("Reading rank2file offsets: pread(%s) errno=%d %s @ %s:%d",
+      name, errno, strerror(errno), __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  if (rc == SCR_SUCCESS) {
+    uint64_t start = scr_rank2file_unpack64(&table[0]);
+    uint64_t end   = scr_rank2file_unpack64(&table[8]);
+    size_t len = (size_t) (end - start);
+    char* buf = (char*) SCR_MALLOC(len);
+    if (pread(fd, buf, len, (off_t) start) != (ssize_t) len) {
+      scr_err("Reading rank2file entry: pread(%s) errno=%d %s @ %s:%d",
+        name, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    } else {
+      kvtree_unpack(buf, hash);
+    }
+    scr_free(&buf);
+  }
+
+  scr_close(name, fd);
+  scr_free(&name);
+
+  return rc;
+}
+
+/* write binary map in file given entries for each rank under RANK/<rank>
+ * in rank2file, ranks missing from the hash are given empty entries */
+int scr_rank2file_write_ranks(const char* file, const kvtree* rank2file, int ranks, int shard_ranks)
+{
+  int rc = SCR_SUCCESS;
+
+  kvtree* empty = kvtree_new();
+
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int shards = (ranks + shard_ranks - 1) / shard_ranks;
+  int shard;
+  for (shard = 0; shard < shards && rc == SCR_SUCCESS; shard++) {
+    int first = shard * shard_ranks;
+    int count = ranks - first;
+    if (count > shard_ranks) {
+      count = shard_ranks;
+    }
+
+    char* name = scr_rank2file_shard_name(file, shard);
+    int fd = scr_open(name, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+    if (fd < 0) {
+      scr_err("Opening rank2file for write: scr_open(%s) errno=%d %s @ %s:%d",
+        name, errno, strerror(errno), __FILE__, __LINE__
+      );
+      scr_free(&name);
+      rc = SCR_FAILURE;
+      break;
+    }
+
+    /* write header and offset table, then entries in rank order */
+    unsigned char header[SCR_RANK2FILE_HEADER_SIZE];
+    scr_rank2file_header(header, ranks, shard_ranks, shard);
+    size_t table_size = (size_t) (count + 1) * 8;
+    unsigned char* table = (unsigned char*) SCR_MALLOC(table_size);
+
+    uint64_t offset = (uint64_t) (sizeof(header) + table_size);
+    off_t pos = (off_t) offset;
+    int i;
+    for (i = 0; i < count; i++) {
+      const kvtree* entry = kvtree_get_kv_int(rank2file, "RANK", first + i);
+      if (entry == NULL) {
+        entry = empty;
+      }
+
+      size_t len = kvtree_pack_size(entry);
+      char* buf = (char*) SCR_MALLOC(len);
+      kvtree_pack(buf, entry);
+      if (pwrite(fd, buf, len, pos) != (ssize_t) len) {
+        scr_err("Writing rank2file entry: pwrite(%s) errno=%d %s @ %s:%d",
+          name, errno, strerror(errno), __FILE__, __LINE__
+        );
+        rc = SCR_FAILURE;
+      }
+      scr_free(&buf);
+
+      scr_rank2file_pack64(&table[i * 8], offset);
+      offset += (uint64_t) len;
+      pos    += (off_t) len;
+    }
+    scr_rank2file_pack64(&table[count * 8], offset);
+
+    if (pwrite(fd, header, sizeof(header), 0) != sizeof(header) ||
+        pwrite(fd, table, table_size, sizeof(header)) != (ssize_t) table_size)
+    {
+      scr_err("Writing rank2file header: pwrite(%s) errno=%d %s @ %s:%d",
+        name, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+    scr_free(&table);
+
+    if (scr_close(name, fd) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+    scr_free(&name);
+  }
+
+  kvtree_delete(&empty);
+
+  return rc;
+}
+
+/* read one part of a map written by kvtree_write_gather and merge
+ * the entries of its ranks into rank2file */
+static int scr_rank2file_read_part(const char* file, const char* part, unsigned long offset, kvtree* rank2file)
+{
+  int fd = scr_open(part, O_RDONLY);
+  if (fd < 0) {
+    scr_err("Opening rank2file: scr_open(%s) errno=%d %s @ %s:%d",
+      part, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  kvtree* hash = kvtree_new();
+  int rc = scr_lseek(part, fd, (off_t) offset, SEEK_SET);
+  if (rc == SCR_SUCCESS && kvtree_read_fd(part, fd, hash) != KVTREE_SUCCESS) {
+    scr_err("Reading rank2file %s @ %s:%d",
+      part, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+  scr_close(part, fd);
+
+  int level;
+  if (rc == SCR_SUCCESS && kvtree_util_get_int(hash, "LEVEL", &level) != KVTREE_SUCCESS) {
+    scr_err("Missing level in rank2file %s @ %s:%d",
+      part, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  if (rc == SCR_SUCCESS) {
+    kvtree* ranks_hash = kvtree_get(hash, "RANK");
+    kvtree_elem* elem;
+    for (elem = kvtree_elem_first(ranks_hash);
+         elem != NULL && rc == SCR_SUCCESS;
+         elem = kvtree_elem_next(elem))
+    {
+      int rank = kvtree_elem_key_int(elem);
+      kvtree* elem_hash = kvtree_elem_hash(elem);
+      if (level == 0) {
+        /* leaf level holds the entry of each rank */
+        kvtree* rank_hash = kvtree_set_kv_int(rank2file, "RANK", rank);
+        kvtree_merge(rank_hash, elem_hash);
+      } else {
+        /* upper levels point to parts of the next level down */
+        char* suffix;
+        unsigned long part_offset = 0;
+        if (kvtree_util_get_str(elem_hash, "FILE", &suffix) != KVTREE_SUCCESS) {
+          rc = SCR_FAILURE;
+          break;
+        }
+        kvtree_util_get_bytecount(elem_hash, "OFFSET", &part_offset);
+
+        /* part names are usually a suffix to the top-level file name,
+         * otherwise take them as relative to its directory */
+        char* name = scr_strdupf("%s%s", file, suffix);
+        if (scr_file_exists(name) != SCR_SUCCESS) {
+          scr_free(&name);
+          spath* path = spath_from_str(file);
+          spath_dirname(path);
+          spath_append_str(path, suffix);
+          name = spath_strdup(path);
+          spath_delete(&path);
+        }
+        rc = scr_rank2file_read_part(file, name, part_offset, rank2file);
+        scr_free(&name);
+      }
+    }
+  }
+
+  kvtree_delete(&hash);
+
+  return rc;
+}
+
+/* read rank2file map written by kvtree_write_gather in file and record
+ * entry for each rank under RANK/<rank> in rank2file */
+int scr_rank2file_read_levels(const char* file, kvtree* rank2file)
+{
+  return scr_rank2file_read_part(file, file, 0, rank2file);
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_RANK2FILE_H
+#define SCR_RANK2FILE_H
+
+#include <stdint.h>
+#include "kvtree.h"
+
+/*
+=========================================
+This file defines a binary format for the rank2file map.  The map is
+split into shards of a fixed number of ranks, and each shard is
+written to its own file named <rank2file>.bin.<shard>.  A shard is a
+header, a table of count+1 offsets, and the packed kvtree of each rank
+in the shard.  The entry for a rank lies between its offset and the
+next, so a process reads its entry with three preads and never parses
+the entries of other ranks.  All integers are stored in big-endian
+order.
+=========================================
+*/
+
+/* header is magic, version, total number of ranks, ranks per shard,
+ * and the index of this shard */
+#define SCR_RANK2FILE_HEADER_SIZE (32)
+
+/* encode value as 8 bytes in big-endian order */
+void scr_rank2file_pack64(unsigned char* buf, uint64_t value);
+
+/* decode 8 bytes in big-endian order */
+uint64_t scr_rank2file_unpack64(const unsigned char* buf);
+
+/* fill in header for given shard of a map of ranks entries */
+void scr_rank2file_header(unsigned char* buf, int ranks, int shard_ranks, int shard);
+
+/* return newly allocated name of given shard of rank2file map in file */
+char* scr_rank2file_shard_name(const char* file, int shard);
+
+/* read header of first shard of binary map in file, returns SCR_FAILURE
+ * if there is no binary map */
+int scr_rank2file_read_header(const char* file, int* ranks, int* shard_ranks);
+
+/* read entry for rank from binary map in file into hash */
+int scr_rank2file_read_rank(const char* file, int rank, int shard_ranks, kvtree* hash);
+
+/* write binary map in file given entries for each rank under RANK/<rank>
+ * in rank2file, ranks missing from the hash are given empty entries */
+int scr_rank2file_write_ranks(const char* file, const kvtree* rank2file, int ranks, int shard_ranks);
+
+/* read rank2file map written by kvtree_write_gather in file and record
+ * entry for each rank under RANK/<rank> in rank2file */
+int scr_rank2file_read_levels(const char* file, kvtree* rank2file);
+
+#endif
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#include "scr_globals.h"
+
+#include "kvtree.h"
+#include "kvtree_mpi.h"
+
+/* write entry in hash of each process in comm to rank2file map in file,
+ * writes the binary format unless SCR_RANK2FILE_SHARD is 0,
+ * must be called by all procs in comm */
+int scr_rank2file_write(const char* file, const kvtree* hash, MPI_Comm comm)
+{
+  int rc = SCR_SUCCESS;
+
+  /* fall back to the kvtree format if asked */
+  int shard_ranks = scr_rank2file_shard_ranks;
+  if (shard_ranks <= 0) {
+    if (kvtree_write_gather(file, (kvtree*) hash, comm) != KVTREE_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+    return rc;
+  }
+
+  int rank, ranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+
+  /* each shard holds a contiguous range of ranks */
+  int shard = rank / shard_ranks;
+  int first = shard * shard_ranks;
+  int index = rank - first;
+  int count = ranks - first;
+  if (count > shard_ranks) {
+    count = shard_ranks;
+  }
+  MPI_Comm shard_comm;
+  MPI_Comm_split(comm, shard, rank, &shard_comm);
+
+  /* pack our entry, entries are stored in rank order after the table */
+  size_t len = kvtree_pack_size(hash);
+  char* buf = (char*) SCR_MALLOC(len);
+  kvtree_pack(buf, hash);
+
+  unsigned long size = (unsigned long) len;
+  unsigned long offset = 0;
+  MPI_Exscan(&size, &offset, 1, MPI_UNSIGNED_LONG, MPI_SUM, shard_comm);
+  if (index == 0) {
+    offset = 0;
+  }
+  uint64_t start = (uint64_t) SCR_RANK2FILE_HEADER_SIZE + (uint64_t) (count + 1) * 8;
+  uint64_t pos   = start + (uint64_t) offset;
+
+  /* first rank of the shard creates the file and writes the header,
+   * along with the offset of the first entry */
+  char* name = scr_rank2file_shard_name(file, shard);
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int created = 1;
+  if (index == 0) {
+    unsigned char header[SCR_RANK2FILE_HEADER_SIZE + 8];
+    scr_rank2file_header(header, ranks, shard_ranks, shard);
+    scr_rank2file_pack64(&header[SCR_RANK2FILE_HEADER_SIZE], start);
+
+    int fd = scr_open(name, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+    if (fd < 0) {
+      scr_err("Opening rank2file for write: scr_open(%s) errno=%d %s @ %s:%d",
+        name, errno, strerror(errno), __FILE__, __LINE__
+      );
+      created = 0;
+    } else {
+      if (pwrite(fd, header, sizeof(header), 0) != sizeof(header)) {
+        scr_err("Writing rank2file header: pwrite(%s) errno=%d %s @ %s:%d",
+          name, errno, strerror(errno), __FILE__, __LINE__
+        );
+        created = 0;
+      }
+      scr_close(name, fd);
+    }
+  }
+  MPI_Bcast(&created, 1, MPI_INT, 0, shard_comm);
+
+  /* write our entry and the offset where it ends */
+  if (created) {
+    int fd = scr_open(name, O_WRONLY);
+    if (fd < 0) {
+      scr_err("Opening rank2file for write: scr_open(%s) errno=%d %s @ %s:%d",
+        name, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    } else {
+      unsigned char end[8];
+      scr_rank2file_pack64(end, pos + (uint64_t) len);
+      off_t end_pos = (off_t) SCR_RANK2FILE_HEADER_SIZE + (off_t) (index + 1) * 8;
+      if (pwrite(fd, buf, len, (off_t) pos) != (ssize_t) len ||
+          pwrite(fd, end, sizeof(end), end_pos) != sizeof(end))
+      {
+        scr_err("Writing rank2file entry: pwrite(%s) errno=%d %s @ %s:%d",
+          name, errno, strerror(errno), __FILE__, __LINE__
+        );
+        rc = SCR_FAILURE;
+      }
+      if (scr_close(name, fd) != SCR_SUCCESS) {
+        rc = SCR_FAILURE;
+      }
+    }
+  } else {
+    rc = SCR_FAILURE;
+  }
+
+  scr_free(&name);
+  scr_free(&buf);
+  MPI_Comm_free(&shard_comm);
+
+  if (! scr_alltrue(rc == SCR_SUCCESS, comm)) {
+    rc = SCR_FAILURE;
+  }
+  return rc;
+}
+
+/* read entry of each process in comm from rank2file map in file into hash,
+ * falls back to the kvtree format if there is no binary map,
+ * must be called by all procs in comm */
+int scr_rank2file_read(const char* file, kvtree* hash, MPI_Comm comm)
+{
+  int rc = SCR_SUCCESS;
+
+  int rank, ranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+
+  /* rank 0 reads the header of the first shard to learn the shard size
+   * and how many ranks wrote the map, everything else each process
+   * needs is in its own shard */
+  int info[3] = {0, 0, 0};
+  if (rank == 0) {
+    int map_ranks, shard_ranks;
+    if (scr_rank2file_read_header(file, &map_ranks, &shard_ranks) == SCR_SUCCESS) {
+      info[0] = 1;
+      info[1] = shard_ranks;
+      info[2] = map_ranks;
+      if (map_ranks != ranks) {
+        scr_dbg(1, "Rank2file %s has %d ranks but job has %d @ %s:%d",
+          file, map_ranks, ranks, __FILE__, __LINE__
+        );
+      }
+    }
+  }
+  MPI_Bcast(info, 3, MPI_INT, 0, comm);
+
+  if (info[0] == 0) {
+    /* no binary map, this dataset was written in the kvtree format */
+    if (kvtree_read_scatter(file, hash, comm) != KVTREE_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+    return rc;
+  }
+
+  /* as with the kvtree format, ranks beyond those that wrote the map
+   * get an empty entry, and entries of ranks beyond the job are not read */
+  if (rank < info[2]) {
+    rc = scr_rank2file_read_rank(file, rank, info[1], hash);
+  }
+
+  if (! scr_alltrue(rc == SCR_SUCCESS, comm)) {
+    rc = SCR_FAILURE;
+  }
+  return rc;
+}
@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_RANK2FILE_MPI_H
+#define SCR_RANK2FILE_MPI_H
+
+#include "mpi.h"
+#include "kvtree.h"
+
+/* write entry in hash of each process in comm to rank2file map in file,
+ * writes the binary format unless SCR_RANK2FILE_SHARD is 0,
+ * must be called by all procs in comm */
+int scr_rank2file_write(const char* file, const kvtree* hash, MPI_Comm comm);
+
+/* read entry of each process in comm from rank2file map in file into hash,
+ * falls back to the kvtree format if there is no binary map,
+ * must be called by all procs in comm */
+int scr_rank2file_read(const char* file, kvtree* hash, MPI_Comm comm);
+
+#endif
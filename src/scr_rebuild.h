@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_REBUILD_H
+#define SCR_REBUILD_H
+
+#include "spath.h"
+
+/*
+=========================================
+These functions rebuild the missing files of one redundancy set of a
+scavenged dataset from the redundancy files that survive.  Each is the
+body of the matching scr_rebuild_<type> command, so scr_index can also
+call it directly.  Files are named relative to the dataset directory
+path_prefix, which must be the current working directory.  Set
+build_data to rebuild data files or to 0 to rebuild filemaps.  Each
+returns 0 on success and 1 on failure, like the commands do.
+=========================================
+*/
+
+int scr_rebuild_xor(const spath* path_prefix, int build_data, int numfiles, const char** files);
+
+int scr_rebuild_partner(const spath* path_prefix, int build_data, int numfiles, const char** files);
+
+int scr_rebuild_rs(const spath* path_prefix, int build_data, int numfiles, const char** files);
+
+#endif
@@ -17,6 +17,7 @@
 #include "scr_err.h"
 #include "scr_util.h"
 #include "scr_filemap.h"
+#include "scr_rebuild.h"
 
 #include "spath.h"
 #include "kvtree.h"
@@ -76,7 +77,7 @@ static char* lookup_path(const scr_filemap* map, const char* file)
  * as it was stored in cache to the map now stored in the prefix directory
  * after a scavenge, this map will be needed to tell redset where those
  * files are now located */
-int build_map_filemap(
+static int build_map_filemap(
   const spath* path_prefix,
   int set_size,
   int* ranks,
@@ -120,7 +121,7 @@ int build_map_filemap(
  * as it was stored in cache to the location where it is now stored within
  * the prefix directory after a scavenge, this map is needed to tell redset
  * where those files are now located */
-int build_map_data(
+static int build_map_data(
   const spath* path_prefix, /* path to the filemap (could probably drop this) */
   int set_size, /* size of redundancy set */
   int* ranks,   /* global mpi rank of each member in the redundancy set */
@@ -129,6 +130,10 @@ int build_map_data(
 {
   int rc = 0;
 
+  /* user files of all members tend to share a few directories,
+   * so remember the ones we have created to only create each once */
+  kvtree* dirs = kvtree_new();
+
   /* get file name, file size, and open each of the user files that we have */
   int i;
   for (i = 0; i < set_size; i++) {
@@ -172,12 +177,16 @@ int build_map_data(
       /* create directory */
       if (! spath_is_null(user_dir_path)) {
         char* user_dir = spath_strdup(user_dir_path);
-        mode_t mode_dir = scr_getmode(1, 1, 1);
-        if (scr_mkdir(user_dir, mode_dir) != SCR_SUCCESS) {
-          scr_err("Failed to create directory for user file %s @ %s:%d",
-            user_dir, __FILE__, __LINE__
-          );
-          rc = 1;
+        if (kvtree_get(dirs, user_dir) == NULL) {
+          mode_t mode_dir = scr_getmode(1, 1, 1);
+          if (scr_mkdir(user_dir, mode_dir) != SCR_SUCCESS) {
+            scr_err("Failed to create directory for user file %s @ %s:%d",
+              user_dir, __FILE__, __LINE__
+            );
+            rc = 1;
+          } else {
+            kvtree_set(dirs, user_dir, kvtree_new());
+          }
         }
         scr_free(&user_dir);
       }
@@ -192,17 +201,21 @@ int build_map_data(
     scr_filemap_delete(&filemap);
   }
 
+  kvtree_delete(&dirs);
+
   return rc;
 }
 
-int rebuild(const spath* path_prefix, int build_data, int numfiles, char** files)
+/* rebuild missing files of one redundancy set in the dataset directory
+ * path_prefix, which must be the current working directory */
+int scr_rebuild_partner(const spath* path_prefix, int build_data, int numfiles, const char** files)
 {
   int rc = 0;
 
   /* get list of global rank ids in set */
   int set_size = 0;
   int* global_ranks = NULL;
-  redset_filelist list = redset_filelist_get_data_partner(numfiles, (const char**) files, &set_size, &global_ranks);
+  redset_filelist list = redset_filelist_get_data_partner(numfiles, files, &set_size, &global_ranks);
   if (list == NULL) {
     /* failed to get the file list for some reason */
     return 1;
@@ -220,7 +233,7 @@ int rebuild(const spath* path_prefix, int build_data, int numfiles, char** files
   }
   char* prefix = spath_strdup(file_prefix);
 
-  if (redset_rebuild_partner(numfiles, (const char**) files, prefix, map) != REDSET_SUCCESS) {
+  if (redset_rebuild_partner(numfiles, files, prefix, map) != REDSET_SUCCESS) {
     /* rebuild failed */
     rc = 1;
   }
@@ -236,6 +249,7 @@ int rebuild(const spath* path_prefix, int build_data, int numfiles, char** files
   return rc;
 }
 
+#ifndef SCR_REBUILD_NO_MAIN
 int main(int argc, char* argv[])
 {
   /* print usage if not enough arguments were given */
@@ -259,12 +273,13 @@ int main(int argc, char* argv[])
    * otherwise rebuild data files */
   int rc = 1;
   if (strcmp(argv[index++], "map") == 0) {
-    rc = rebuild(path_prefix, 0, argc - index, &argv[index]);
+    rc = scr_rebuild_partner(path_prefix, 0, argc - index, (const char **) &argv[index]);
   } else {
-    rc = rebuild(path_prefix, 1, argc - index, &argv[index]);
+    rc = scr_rebuild_partner(path_prefix, 1, argc - index, (const char **) &argv[index]);
   }
 
   spath_delete(&path_prefix);
 
   return rc;
 }
+#endif
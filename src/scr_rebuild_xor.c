@@ -17,6 +17,7 @@
 #include "scr_err.h"
 #include "scr_util.h"
 #include "scr_filemap.h"
+#include "scr_rebuild.h"
 
 #include "spath.h"
 #include "kvtree.h"
@@ -76,7 +77,7 @@ static char* lookup_path(const scr_filemap* map, const char* file)
  * as it was stored in cache to the map now stored in the prefix directory
  * after a scavenge, this map will be needed to tell redset where those
  * files are now located */
-int build_map_filemap(
+static int build_map_filemap(
   const spath* path_prefix,
   int set_size,
   int* ranks,
@@ -120,7 +121,7 @@ int build_map_filemap(
  * as it was stored in cache to the location where it is now stored within
  * the prefix directory after a scavenge, this map is needed to tell redset
  * where those files are now located */
-int build_map_data(
+static int build_map_data(
   const spath* path_prefix, /* path to the filemap (could probably drop this) */
   int set_size, /* size of redundancy set */
   int* ranks,   /* global mpi rank of each member in the redundancy set */
@@ -129,6 +130,10 @@ int build_map_data(
 {
   int rc = 0;
 
+  /* user files of all members tend to share a few directories,
+   * so remember the ones we have created to only create each once */
+  kvtree* dirs = kvtree_new();
+
   /* get file name, file size, and open each of the user files that we have */
   int i;
   for (i = 0; i < set_size; i++) {
@@ -172,12 +177,16 @@ int build_map_data(
       /* create directory */
       if (! spath_is_null(user_dir_path)) {
         char* user_dir = spath_strdup(user_dir_path);
-        mode_t mode_dir = scr_getmode(1, 1, 1);
-        if (scr_mkdir(user_dir, mode_dir) != SCR_SUCCESS) {
-          scr_err("Failed to create directory for user file %s @ %s:%d",
-            user_dir, __FILE__, __LINE__
-          );
-          rc = 1;
+        if (kvtree_get(dirs, user_dir) == NULL) {
+          mode_t mode_dir = scr_getmode(1, 1, 1);
+          if (scr_mkdir(user_dir, mode_dir) != SCR_SUCCESS) {
+            scr_err("Failed to create directory for user file %s @ %s:%d",
+              user_dir, __FILE__, __LINE__
+            );
+            rc = 1;
+          } else {
+            kvtree_set(dirs, user_dir, kvtree_new());
+          }
         }
         scr_free(&user_dir);
       }
@@ -192,10 +201,14 @@ int build_map_data(
     scr_filemap_delete(&filemap);
   }
 
+  kvtree_delete(&dirs);
+
   return rc;
 }
 
-int rebuild(const spath* path_prefix, int build_data, int numfiles, const char** files)
+/* rebuild missing files of one redundancy set in the dataset directory
+ * path_prefix, which must be the current working directory */
+int scr_rebuild_xor(const spath* path_prefix, int build_data, int numfiles, const char** files)
 {
   int rc = 0;
 
@@ -235,6 +248,7 @@ int rebuild(const spath* path_prefix, int build_data, int numfiles, const char**
   return rc;
 }
 
+#ifndef SCR_REBUILD_NO_MAIN
 int main(int argc, char* argv[])
 {
   /* print usage if not enough arguments were given */
@@ -257,12 +271,13 @@ int main(int argc, char* argv[])
   /* rebuild filemaps if given map command */
   int rc = 1;
   if (strcmp(argv[index++], "map") == 0) {
-    rc = rebuild(path_prefix, 0, argc - index, (const char **) &argv[index]);
+    rc = scr_rebuild_xor(path_prefix, 0, argc - index, (const char **) &argv[index]);
   } else {
-    rc = rebuild(path_prefix, 1, argc - index, (const char **) &argv[index]);
+    rc = scr_rebuild_xor(path_prefix, 1, argc - index, (const char **) &argv[index]);
   }
 
   spath_delete(&path_prefix);
 
   return rc;
 }
+#endif
@@ -0,0 +1,459 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#include "scr_globals.h"
+
+#include <pthread.h>
+#include <dirent.h>
+
+/* files of a deleted dataset */
+typedef struct scr_reclaim_job_struct {
+  char* dir;         /* cache directory of dataset */
+  scr_filemap* map;  /* files to be deleted */
+  int   bypass;      /* whether files are on the file system rather than cache */
+  struct scr_reclaim_job_struct* next; /* next job in queue */
+} scr_reclaim_job;
+
+/* directories of a deleted dataset */
+typedef struct scr_reclaim_dir_struct {
+  int   store_index; /* index of store holding directories */
+  char* dir_scr;     /* hidden .scr subdirectory */
+  char* dir;         /* dataset directory */
+  int   sweep;       /* remove files the filemaps may not list */
+  int   reused;      /* set if directory was created again */
+  struct scr_reclaim_dir_struct* next; /* next directory in list */
+} scr_reclaim_dir;
+
+static pthread_t       scr_reclaim_thread;
+static pthread_mutex_t scr_reclaim_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  scr_reclaim_cond = PTHREAD_COND_INITIALIZER;
+static int             scr_reclaim_started = 0; /* whether thread is running */
+static int             scr_reclaim_stop    = 0; /* tells thread to exit */
+static scr_reclaim_job* scr_reclaim_head = NULL; /* queued jobs, oldest first */
+static scr_reclaim_job* scr_reclaim_tail = NULL; /* newest queued job */
+static scr_reclaim_dir* scr_reclaim_dirs_head = NULL; /* directories to remove */
+static scr_reclaim_dir* scr_reclaim_dirs_tail = NULL; /* last directory in list */
+
+/* check and delete files of a single job, runs without the lock held */
+static void scr_reclaim_files(scr_reclaim_job* job)
+{
+  scr_trace_mark_begin("reclaim");
+
+  scr_filemap* map = job->map;
+
+  kvtree_elem* file_elem;
+  for (file_elem = scr_filemap_first_file(map);
+       file_elem != NULL;
+       file_elem = kvtree_elem_next(file_elem))
+  {
+    /* get the filename */
+    char* file = kvtree_elem_key(file_elem);
+
+    scr_meta* meta = scr_meta_new();
+    scr_filemap_get_meta(map, file, meta);
+
+    /* the blocks of a deduplicated file were released when it was queued */
+    if (scr_meta_get_dedup(meta) != NULL) {
+      scr_meta_delete(&meta);
+      continue;
+    }
+
+    /* a file kept compressed in cache was rewritten after it was
+     * completed and no longer holds the data its checksum covers */
+    int comp_type = SCR_COMPRESS_NONE;
+    scr_meta_get_cache_compress(meta, &comp_type, NULL);
+    int compressed = (comp_type != SCR_COMPRESS_NONE);
+
+    /* verify that file mtime and ctime have not changed since scr_complete_output,
+     * which could idenitfy a bug in the user's code */
+    struct stat statbuf;
+    int stat_rc = compressed ? -1 : stat(file, &statbuf);
+    if (stat_rc == 0) {
+      int file_changed = 0;
+
+      /* check that file contents have not been modified */
+      if (scr_meta_check_mtime(meta, &statbuf) != SCR_SUCCESS) {
+        file_changed = 1;
+        scr_warn("Detected mtime change in file `%s' since it was completed @ %s:%d",
+          file, __FILE__, __LINE__
+        );
+      }
+
+      /* check that permission bits, uid, and gid have not changed */
+      if (scr_meta_check_metadata(meta, &statbuf) != SCR_SUCCESS) {
+        file_changed = 1;
+        scr_warn("Detected change in mode bits, uid, or gid on file `%s' since it was completed @ %s:%d",
+          file, __FILE__, __LINE__
+        );
+      }
+
+      if (file_changed) {
+        scr_warn("Detected change in file `%s' since it was completed @ %s:%d",
+          file, __FILE__, __LINE__
+        );
+      }
+    }
+    scr_meta_delete(&meta);
+
+    /* check file's crc value (monitor that cache hardware isn't corrupting
+     * files on us) */
+    if (scr_crc_on_delete && ! compressed) {
+      /* TODO: if corruption, need to log */
+      if (scr_compute_crc(map, file) != SCR_SUCCESS) {
+        scr_err("Failed to verify CRC32 before deleting file %s, bad drive? @ %s:%d",
+          file, __FILE__, __LINE__
+        );
+      }
+    }
+
+    /* if we're not using bypass, delete data files from cache */
+    if (! job->bypass) {
+      /* delete the file */
+      scr_file_unlink(file);
+    }
+  }
+
+  scr_trace_mark_end("reclaim");
+}
+
+/* free a job and the files it references */
+static void scr_reclaim_job_free(scr_reclaim_job** ptr_job)
+{
+  scr_reclaim_job* job = *ptr_job;
+  scr_filemap_delete(&job->map);
+  scr_free(&job->dir);
+  scr_free(ptr_job);
+}
+
+/* delete files of queued jobs until told to stop */
+static void* scr_reclaim_run(void* arg)
+{
+  pthread_mutex_lock(&scr_reclaim_lock);
+  while (1) {
+    scr_reclaim_job* job = scr_reclaim_head;
+    if (job == NULL) {
+      if (scr_reclaim_stop) {
+        break;
+      }
+      pthread_cond_wait(&scr_reclaim_cond, &scr_reclaim_lock);
+      continue;
+    }
+
+    /* only this thread removes jobs, so the head stays put while we work on it */
+    pthread_mutex_unlock(&scr_reclaim_lock);
+    scr_reclaim_files(job);
+    pthread_mutex_lock(&scr_reclaim_lock);
+
+    scr_reclaim_head = job->next;
+    if (scr_reclaim_head == NULL) {
+      scr_reclaim_tail = NULL;
+    }
+    scr_reclaim_job_free(&job);
+    pthread_cond_broadcast(&scr_reclaim_cond);
+  }
+  pthread_mutex_unlock(&scr_reclaim_lock);
+  return NULL;
+}
+
+/* queue files in map of dataset in cache directory dir to be deleted,
+ * takes ownership of map, checks but keeps files if bypass is set */
+int scr_reclaim_add(const char* dir, scr_filemap* map, int bypass)
+{
+  if (map == NULL) {
+    return SCR_FAILURE;
+  }
+
+  scr_reclaim_job* job = (scr_reclaim_job*) SCR_MALLOC(sizeof(scr_reclaim_job));
+  job->dir    = (dir != NULL) ? strdup(dir) : NULL;
+  job->map    = map;
+  job->bypass = bypass;
+  job->next   = NULL;
+
+  /* when not deleting in the background, do the work now */
+  if (! scr_cache_delete_async) {
+    scr_reclaim_files(job);
+    scr_reclaim_job_free(&job);
+    return SCR_SUCCESS;
+  }
+
+  pthread_mutex_lock(&scr_reclaim_lock);
+
+  /* start the thread with the first job */
+  if (! scr_reclaim_started) {
+    scr_reclaim_stop = 0;
+    if (pthread_create(&scr_reclaim_thread, NULL, scr_reclaim_run, NULL) != 0) {
+      pthread_mutex_unlock(&scr_reclaim_lock);
+      scr_warn("Failed to start thread to delete cached files, deleting inline @ %s:%d",
+        __FILE__, __LINE__
+      );
+      scr_reclaim_files(job);
+      scr_reclaim_job_free(&job);
+      return SCR_SUCCESS;
+    }
+    scr_reclaim_started = 1;
+  }
+
+  if (scr_reclaim_tail != NULL) {
+    scr_reclaim_tail->next = job;
+  } else {
+    scr_reclaim_head = job;
+  }
+  scr_reclaim_tail = job;
+  pthread_cond_broadcast(&scr_reclaim_cond);
+
+  pthread_mutex_unlock(&scr_reclaim_lock);
+  return SCR_SUCCESS;
+}
+
+/* remove everything below dir, but not dir itself */
+static void scr_reclaim_sweep(const char* dir)
+{
+  DIR* dirp = opendir(dir);
+  if (dirp == NULL) {
+    return;
+  }
+
+  struct dirent* de;
+  while ((de = readdir(dirp)) != NULL) {
+    if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+      continue;
+    }
+
+    char* path = scr_strdupf("%s/%s", dir, de->d_name);
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+      scr_reclaim_sweep(path);
+      scr_rmdir(path);
+    } else {
+      scr_dbg(2, "Removing file not listed in filemap: %s", path);
+      scr_file_unlink(path);
+    }
+    scr_free(&path);
+  }
+  closedir(dirp);
+}
+
+/* remove hidden and dataset directories from cache, collective over store */
+static int scr_reclaim_dir_delete(int store_index, const char* dir_scr, const char* dir, int sweep)
+{
+  int rc = SCR_SUCCESS;
+
+  /* get store descriptor */
+  scr_storedesc* store = &scr_storedescs[store_index];
+
+  /* remove hidden .scr subdirectory from cache, stripe directories have none */
+  if (dir_scr != NULL && scr_storedesc_dir_delete(store, dir_scr) != SCR_SUCCESS) {
+    scr_err("Failed to remove dataset directory: %s @ %s:%d",
+      dir_scr, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  /* the filemaps of a dataset whose output never completed may not
+   * list every file written to it, so once all procs on the store
+   * have deleted theirs, one of them removes whatever is left */
+  if (sweep && store->enabled) {
+    MPI_Barrier(store->comm);
+    if (store->rank == 0 && store->can_mkdir) {
+      scr_reclaim_sweep(dir);
+    }
+  }
+
+  /* remove the dataset directory from cache */
+  if (scr_storedesc_dir_delete(store, dir) != SCR_SUCCESS) {
+    scr_err("Failed to remove dataset directory: %s @ %s:%d",
+      dir, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  return rc;
+}
+
+/* remove dir_scr and dir from store after files queued for them are deleted,
+ * dir_scr may be NULL, must be called by all procs in the same order */
+int scr_reclaim_dir_add(int store_index, const char* dir_scr, const char* dir, int sweep)
+{
+  /* when not deleting in the background, the files are already gone */
+  if (! scr_cache_delete_async) {
+    return scr_reclaim_dir_delete(store_index, dir_scr, dir, sweep);
+  }
+
+  scr_reclaim_dir* d = (scr_reclaim_dir*) SCR_MALLOC(sizeof(scr_reclaim_dir));
+  d->store_index = store_index;
+  d->dir_scr     = (dir_scr != NULL) ? strdup(dir_scr) : NULL;
+  d->dir         = strdup(dir);
+  d->sweep       = sweep;
+  d->reused      = 0;
+  d->next        = NULL;
+
+  /* the dataset is about to leave the cache index, so note there that
+   * its directory is still to be removed, if we fail before we get to
+   * it, scr_reclaim_recover removes it in the next run */
+  scr_cache_index_set_reclaim(scr_cindex, dir);
+
+  /* only the main thread touches the list of directories */
+  if (scr_reclaim_dirs_tail != NULL) {
+    scr_reclaim_dirs_tail->next = d;
+  } else {
+    scr_reclaim_dirs_head = d;
+  }
+  scr_reclaim_dirs_tail = d;
+
+  return SCR_SUCCESS;
+}
+
+/* called before dir is created again, waits for files queued
+ * for dir and keeps it from being removed */
+void scr_reclaim_reuse(const char* dir)
+{
+  if (dir == NULL) {
+    return;
+  }
+
+  /* we must not delete files written to the new directory */
+  pthread_mutex_lock(&scr_reclaim_lock);
+  while (1) {
+    scr_reclaim_job* job;
+    for (job = scr_reclaim_head; job != NULL; job = job->next) {
+      if (job->dir != NULL && strcmp(job->dir, dir) == 0) {
+        break;
+      }
+    }
+    if (job == NULL) {
+      break;
+    }
+    pthread_cond_wait(&scr_reclaim_cond, &scr_reclaim_lock);
+  }
+  pthread_mutex_unlock(&scr_reclaim_lock);
+
+  /* and must not remove the new directory */
+  scr_reclaim_dir* d;
+  for (d = scr_reclaim_dirs_head; d != NULL; d = d->next) {
+    if (strcmp(d->dir, dir) == 0) {
+      d->reused = 1;
+      scr_cache_index_unset_reclaim(scr_cindex, dir);
+    }
+  }
+}
+
+/* wait until the background thread has deleted every queued file */
+int scr_reclaim_wait(void)
+{
+  pthread_mutex_lock(&scr_reclaim_lock);
+  while (scr_reclaim_head != NULL) {
+    pthread_cond_wait(&scr_reclaim_cond, &scr_reclaim_lock);
+  }
+  pthread_mutex_unlock(&scr_reclaim_lock);
+  return SCR_SUCCESS;
+}
+
+/* wait for queued files and remove directories of deleted datasets,
+ * must be called by all procs */
+int scr_reclaim_dirs(void)
+{
+  int rc = SCR_SUCCESS;
+
+  /* every proc adds the same directories, so all agree on whether there are any */
+  if (scr_reclaim_dirs_head == NULL) {
+    return rc;
+  }
+
+  scr_reclaim_wait();
+
+  scr_reclaim_dir* d = scr_reclaim_dirs_head;
+  while (d != NULL) {
+    /* leave the directory in place if any proc created it again */
+    if (scr_alltrue(! d->reused, scr_comm_world)) {
+      if (scr_reclaim_dir_delete(d->store_index, d->dir_scr, d->dir, d->sweep) != SCR_SUCCESS) {
+        rc = SCR_FAILURE;
+      }
+    }
+
+    scr_cache_index_unset_reclaim(scr_cindex, d->dir);
+
+    scr_reclaim_dir* next = d->next;
+    scr_free(&d->dir_scr);
+    scr_free(&d->dir);
+    scr_free(&d);
+    d = next;
+  }
+  scr_reclaim_dirs_head = NULL;
+  scr_reclaim_dirs_tail = NULL;
+
+  /* the directories no longer need to be recorded in the index */
+  scr_cache_index_write(scr_cindex_file, scr_cindex);
+
+  return rc;
+}
+
+/* remove directories of datasets that were deleted in an earlier run
+ * but whose files were still being deleted when that run ended,
+ * called once the cache index has been read */
+int scr_reclaim_recover(scr_cache_index* cindex)
+{
+  kvtree_elem* elem = scr_cache_index_first_reclaim(cindex);
+  if (elem == NULL) {
+    return SCR_SUCCESS;
+  }
+
+  /* one process on the node removes what is left, skipping any
+   * directory a dataset in the index has taken over since */
+  while (elem != NULL) {
+    char* dir = kvtree_elem_key(elem);
+    elem = kvtree_elem_next(elem);
+
+    int in_use = 0;
+    kvtree_elem* dset_elem;
+    for (dset_elem = scr_cache_index_first_dataset(cindex);
+         dset_elem != NULL;
+         dset_elem = kvtree_elem_next(dset_elem))
+    {
+      char* path = NULL;
+      int dset = kvtree_elem_key_int(dset_elem);
+      if (scr_cache_index_get_dir(cindex, dset, &path) == SCR_SUCCESS &&
+          strcmp(path, dir) == 0)
+      {
+        in_use = 1;
+      }
+    }
+
+    if (! in_use && scr_storedesc_cntl->rank == 0 && access(dir, F_OK) == 0) {
+      scr_dbg(1, "Removing directory of dataset deleted in an earlier run: %s", dir);
+      scr_reclaim_sweep(dir);
+      scr_rmdir(dir);
+    }
+
+    scr_cache_index_unset_reclaim(cindex, dir);
+  }
+
+  scr_cache_index_write(scr_cindex_file, cindex);
+
+  return SCR_SUCCESS;
+}
+
+/* remove everything still queued and stop the background thread,
+ * must be called by all procs */
+void scr_reclaim_finalize(void)
+{
+  scr_reclaim_dirs();
+
+  pthread_mutex_lock(&scr_reclaim_lock);
+  int started = scr_reclaim_started;
+  scr_reclaim_stop = 1;
+  pthread_cond_broadcast(&scr_reclaim_cond);
+  pthread_mutex_unlock(&scr_reclaim_lock);
+
+  if (started) {
+    pthread_join(scr_reclaim_thread, NULL);
+    scr_reclaim_started = 0;
+  }
+}
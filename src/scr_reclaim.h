@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_RECLAIM_H
+#define SCR_RECLAIM_H
+
+#include "scr_filemap.h"
+#include "scr_cache_index.h"
+
+/*
+=========================================
+This file reclaims the cache space of deleted datasets.  Once a dataset
+has been dropped from the cache index, its files are handed to a
+background thread that checks and unlinks them while the application
+goes on, for example to write its next checkpoint.  The dataset
+directories can only be removed after every process has deleted its
+files, which takes a collective, so they are kept on a list and
+removed together the next time all procs call scr_reclaim_dirs.
+Until then, the cache index records the directories, so that a run
+that ends early does not leave them behind.  Background deletes are
+enabled with SCR_CACHE_DELETE_ASYNC=1, otherwise all of this work is
+done inline.
+=========================================
+*/
+
+/* queue files in map of dataset in cache directory dir to be deleted,
+ * takes ownership of map, checks but keeps files if bypass is set */
+int scr_reclaim_add(const char* dir, scr_filemap* map, int bypass);
+
+/* remove dir_scr and dir from store after files queued for them are deleted,
+ * dir_scr may be NULL, with sweep set any other files left in dir are
+ * removed as well, must be called by all procs in the same order */
+int scr_reclaim_dir_add(int store_index, const char* dir_scr, const char* dir, int sweep);
+
+/* called before dir is created again, waits for files queued
+ * for dir and keeps it from being removed */
+void scr_reclaim_reuse(const char* dir);
+
+/* wait until the background thread has deleted every queued file */
+int scr_reclaim_wait(void);
+
+/* wait for queued files and remove directories of deleted datasets,
+ * must be called by all procs */
+int scr_reclaim_dirs(void);
+
+/* remove directories of datasets that were deleted in an earlier run
+ * but whose files were still being deleted when that run ended,
+ * called once the cache index has been read */
+int scr_reclaim_recover(scr_cache_index* cindex);
+
+/* remove everything still queued and stop the background thread,
+ * must be called by all procs */
+void scr_reclaim_finalize(void);
+
+#endif
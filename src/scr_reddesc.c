@@ -12,6 +12,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "mpi.h"
 
@@ -19,6 +20,7 @@
 #include "kvtree_util.h"
 #include "spath.h"
 #include "er.h"
+#include "rankstr_mpi.h"
 
 #include "scr_globals.h"
 
@@ -47,10 +49,17 @@ int scr_reddesc_init(scr_reddesc* d)
   d->bypass      = -1;
   d->store_index = -1;
   d->group_index = -1;
+  d->set_group_index = -1;
   d->base        = NULL;
   d->directory   = NULL;
+  d->stripe_count = 0;
+  d->stripe_index = NULL;
+  d->stripe_dirs  = NULL;
   d->copy_type   = SCR_COPY_NULL;
   d->er_scheme   = -1;
+  d->encode_count = 0;
+  d->encode_secs  = 0.0;
+  d->encode_bytes = 0.0;
 
   return SCR_SUCCESS;
 }
@@ -63,6 +72,15 @@ int scr_reddesc_free(scr_reddesc* d)
   scr_free(&d->base);
   scr_free(&d->directory);
 
+  /* free the stripe stores */
+  int i;
+  for (i = 0; i < d->stripe_count; i++) {
+    scr_free(&d->stripe_dirs[i]);
+  }
+  scr_free(&d->stripe_dirs);
+  scr_free(&d->stripe_index);
+  d->stripe_count = 0;
+
   /* free off ER scheme resources */
   if (d->er_scheme != -1) {
     ER_Free_Scheme(d->er_scheme);
@@ -71,6 +89,92 @@ int scr_reddesc_free(scr_reddesc* d)
   return SCR_SUCCESS;
 }
 
+/* bytes in the most recent measured encode, taken as the size of the next */
+static double scr_reddesc_model_bytes = 0.0;
+
+/* returns 1 if we have measured the cost of encoding with descriptor d */
+static int scr_reddesc_measured(const scr_reddesc* d)
+{
+  return (d->encode_count > 0 && d->encode_bytes > 0.0);
+}
+
+/* among the enabled descriptors, select and return a pointer to the one
+ * that minimizes the expected time lost to the next checkpoint */
+scr_reddesc* scr_reddesc_for_model(
+  int ndescs,
+  scr_reddesc* descs,
+  scr_reddesc* configured,
+  double interval,
+  double lost)
+{
+  if (scr_checkpoint_mtbf <= 0.0 || scr_reddesc_model_bytes <= 0.0) {
+    return configured;
+  }
+
+  /* explore each descriptor on the regular schedule before we model it */
+  if (configured != NULL && ! scr_reddesc_measured(configured)) {
+    return configured;
+  }
+
+  scr_reddesc* d = NULL;
+  double best = 0.0;
+  int i;
+  for (i = 0; i < ndescs; i++) {
+    if (! descs[i].enabled) {
+      continue;
+    }
+
+    /* only compare descriptors we have measured */
+    if (! scr_reddesc_measured(&descs[i])) {
+      continue;
+    }
+
+    /* time to encode a dataset of the expected size */
+    double cost = descs[i].encode_secs / descs[i].encode_bytes * scr_reddesc_model_bytes;
+
+    /* a SINGLE copy is lost with any failure of its node, while the other
+     * schemes only lose out to failures that need the prefix directory */
+    double mtbf = scr_checkpoint_mtbf;
+    if (descs[i].copy_type != SCR_COPY_SINGLE && scr_checkpoint_mtbf_pfs > 0.0) {
+      mtbf = scr_checkpoint_mtbf_pfs;
+    }
+
+    /* add the work we expect to lose to failures it can not survive */
+    double expected = cost + interval / mtbf * lost;
+    if (d == NULL || expected < best) {
+      d = &descs[i];
+      best = expected;
+    }
+  }
+
+  if (d == NULL) {
+    d = configured;
+  }
+  return d;
+}
+
+/* return 1 if every proc in the group defined by setdesc can find at
+ * least min_domains failure domains within its own group, so that
+ * redundancy sets formed within each group still span failure domains */
+static int scr_reddesc_set_group_valid(
+  const scr_groupdesc* setdesc,
+  const char* failure_domain,
+  int min_domains)
+{
+  /* count failure domains in our group by counting their leaders */
+  MPI_Comm domain_comm;
+  rankstr_mpi_comm_split(setdesc->comm, failure_domain, 0, 0, 1, &domain_comm);
+  int domain_rank;
+  MPI_Comm_rank(domain_comm, &domain_rank);
+  MPI_Comm_free(&domain_comm);
+
+  int leader = (domain_rank == 0);
+  int domains;
+  MPI_Allreduce(&leader, &domains, 1, MPI_INT, MPI_SUM, setdesc->comm);
+
+  return scr_alltrue(domains >= min_domains, scr_comm_world);
+}
+
 /* given a checkpoint id and a list of redundancy descriptors,
  * select and return a pointer to a descriptor for the specified id */
 scr_reddesc* scr_reddesc_for_checkpoint(
@@ -132,6 +236,11 @@ int scr_reddesc_store_to_hash(const scr_reddesc* d, kvtree* hash)
   /* we don't set GROUP_INDEX because this is dependent on runtime
    * environment */
 
+  /* set the SET_GROUP key */
+  if (d->set_group_index >= 0) {
+    kvtree_set_kv(hash, SCR_CONFIG_KEY_SET_GROUP, scr_groupdescs[d->set_group_index].name);
+  }
+
   /* set the STORE key */
   if (d->base != NULL) {
     kvtree_set_kv(hash, SCR_CONFIG_KEY_STORE, d->base);
@@ -142,6 +251,25 @@ int scr_reddesc_store_to_hash(const scr_reddesc* d, kvtree* hash)
     kvtree_set_kv(hash, SCR_CONFIG_KEY_DIRECTORY, d->directory);
   }
 
+  /* set the STRIPE key as a comma-separated list of store names */
+  if (d->stripe_count > 0) {
+    size_t len = 0;
+    int i;
+    for (i = 0; i < d->stripe_count; i++) {
+      len += strlen(scr_storedescs[d->stripe_index[i]].name) + 1;
+    }
+    char* names = (char*) SCR_MALLOC(len);
+    names[0] = '\0';
+    for (i = 0; i < d->stripe_count; i++) {
+      if (i > 0) {
+        strcat(names, ",");
+      }
+      strcat(names, scr_storedescs[d->stripe_index[i]].name);
+    }
+    kvtree_set_kv(hash, SCR_CONFIG_KEY_STRIPE, names);
+    scr_free(&names);
+  }
+
   /* set the TYPE key */
   switch (d->copy_type) {
   case SCR_COPY_SINGLE:
@@ -188,6 +316,55 @@ static int scr_reddesc_type_int_from_str(const char* value, int* type)
   return rc;
 }
 
+/* fill in the stripe stores of d from a comma-separated list of store
+ * names, skipping the primary store, duplicates, and unusable stores */
+static void scr_reddesc_stripe_from_str(scr_reddesc* d, const char* value)
+{
+  /* allocate room for as many stores as are defined */
+  d->stripe_index = (int*)   SCR_MALLOC(scr_nstoredescs * sizeof(int));
+  d->stripe_dirs  = (char**) SCR_MALLOC(scr_nstoredescs * sizeof(char*));
+
+  char* names = strdup(value);
+  char* saveptr = NULL;
+  char* name = strtok_r(names, ", ", &saveptr);
+  while (name != NULL) {
+    /* reduce the name the same way we do for the primary store */
+    char* reduced = spath_strdup_reduce_str(name);
+    int index = scr_storedescs_index_from_name(reduced);
+
+    /* skip stores we already have */
+    int dup = (index == d->store_index);
+    int i;
+    for (i = 0; i < d->stripe_count; i++) {
+      if (d->stripe_index[i] == index) {
+        dup = 1;
+      }
+    }
+
+    if (index < 0 || ! scr_storedescs[index].enabled) {
+      if (scr_my_rank_world == 0) {
+        scr_warn("Not striping across unknown or disabled store %s in redundancy descriptor %d @ %s:%d",
+          reduced, d->index, __FILE__, __LINE__
+        );
+      }
+    } else if (! dup && d->stripe_count < scr_nstoredescs) {
+      /* files go in a job directory on the stripe store named like ours */
+      spath* dir = spath_from_str(reduced);
+      spath_append_str(dir, scr_username);
+      spath_append_strf(dir, "scr.%s", scr_jobid);
+      spath_reduce(dir);
+      d->stripe_index[d->stripe_count] = index;
+      d->stripe_dirs[d->stripe_count]  = spath_strdup(dir);
+      d->stripe_count++;
+      spath_delete(&dir);
+    }
+
+    scr_free(&reduced);
+    name = strtok_r(NULL, ", ", &saveptr);
+  }
+  scr_free(&names);
+}
+
 /* build a redundancy descriptor corresponding to the specified hash,
  * this function is collective */
 int scr_reddesc_create_from_hash(
@@ -279,6 +456,14 @@ int scr_reddesc_create_from_hash(
   spath_reduce(dir);
   d->directory = spath_strdup(dir);
   spath_delete(&dir);
+
+  /* get the list of other stores to stripe files across */
+  char* stripe = NULL;
+  if (d->store_index >= 0 &&
+      kvtree_util_get_str(hash, SCR_CONFIG_KEY_STRIPE, &stripe) == KVTREE_SUCCESS)
+  {
+    scr_reddesc_stripe_from_str(d, stripe);
+  }
     
   /* set the redundancy set size */
   int set_size = scr_set_size;
@@ -357,21 +542,52 @@ int scr_reddesc_create_from_hash(
   }
   scr_str_bcast(&failure_domain, 0, groupdesc->comm);
 
+  /* number of failure domains a set needs to protect anything */
+  int min_domains = 2;
+  if (d->copy_type == SCR_COPY_SINGLE) {
+    min_domains = 1;
+  } else if (d->copy_type == SCR_COPY_RS) {
+    min_domains = set_failures + 1;
+  }
+
+  /* form redundancy sets within the group named by SET_GROUP, e.g., all
+   * procs on the same network switch, so encoding traffic stays on
+   * nearby links, sets still span failure domains within that group,
+   * and we fall back to all procs if some group has too few domains */
+  MPI_Comm set_comm = scr_comm_world;
+  int set_ranks = scr_ranks_world;
+  char* set_groupname = scr_set_group;
+  kvtree_util_get_str(hash, SCR_CONFIG_KEY_SET_GROUP, &set_groupname);
+  if (set_groupname != NULL) {
+    const scr_groupdesc* setdesc = scr_groupdescs_from_name(set_groupname);
+    if (setdesc != NULL &&
+        scr_reddesc_set_group_valid(setdesc, failure_domain, min_domains))
+    {
+      d->set_group_index = setdesc->index;
+      set_comm  = setdesc->comm;
+      set_ranks = setdesc->ranks;
+    } else if (scr_my_rank_world == 0) {
+      scr_warn("Forming redundancy sets across all procs since group %s does not hold %d failure domains everywhere in redundancy descriptor %d @ %s:%d",
+        set_groupname, min_domains, d->index, __FILE__, __LINE__
+      );
+    }
+  }
+
   /* build the communicator based on the copy type
    * and other parameters */
   d->er_scheme = -1;
   switch (d->copy_type) {
   case SCR_COPY_SINGLE:
-    d->er_scheme = ER_Create_Scheme(scr_comm_world, failure_domain, scr_ranks_world, 0);
+    d->er_scheme = ER_Create_Scheme(set_comm, failure_domain, set_ranks, 0);
     break;
   case SCR_COPY_PARTNER:
-    d->er_scheme = ER_Create_Scheme(scr_comm_world, failure_domain, scr_ranks_world, scr_ranks_world);
+    d->er_scheme = ER_Create_Scheme(set_comm, failure_domain, set_ranks, set_ranks);
     break;
   case SCR_COPY_XOR:
-    d->er_scheme = ER_Create_Scheme(scr_comm_world, failure_domain, scr_ranks_world, 1);
+    d->er_scheme = ER_Create_Scheme(set_comm, failure_domain, set_ranks, 1);
     break;
   case SCR_COPY_RS:
-    d->er_scheme = ER_Create_Scheme(scr_comm_world, failure_domain, scr_ranks_world, set_failures);
+    d->er_scheme = ER_Create_Scheme(set_comm, failure_domain, set_ranks, set_failures);
     break;
   }
 
@@ -391,6 +607,16 @@ int scr_reddesc_create_from_hash(
   return SCR_SUCCESS;
 }
 
+/* return pointer to the store descriptor of the given stripe of a
+ * redundancy descriptor, returns NULL if out of range */
+scr_storedesc* scr_reddesc_get_stripe_store(const scr_reddesc* desc, int stripe)
+{
+  if (desc == NULL || stripe < 0 || stripe >= desc->stripe_count) {
+    return NULL;
+  }
+  return &scr_storedescs[desc->stripe_index[stripe]];
+}
+
 /* return pointer to store descriptor associated with redundancy
  * descriptor, returns NULL if reddesc or storedesc is not enabled */
 scr_storedesc* scr_reddesc_get_store(const scr_reddesc* desc)
@@ -441,6 +667,8 @@ static char* scr_reddesc_prefix_filemap(const char* dir)
   return prefix;
 }
 
+/* encode the filemap of dataset id, returns whether the calling
+ * process succeeded, the caller must agree on the result */
 static int scr_reddesc_apply_to_filemap(const scr_reddesc* desc, int id, const scr_storedesc* store)
 {
   /* define path for hidden directory */
@@ -498,37 +726,99 @@ static int scr_reddesc_apply_to_filemap(const scr_reddesc* desc, int id, const s
     rc = SCR_FAILURE;
   }
 
-  /* determine whether everyone succeeded in their copy */
-  int valid_copy = (rc == SCR_SUCCESS);
-  if (! valid_copy) {
+  if (rc != SCR_SUCCESS) {
     scr_err("scr_copy_files failed with return code %d @ %s:%d",
             rc, __FILE__, __LINE__
     );
   }
-  int all_valid_copy = scr_alltrue(valid_copy, scr_comm_world);
-  rc = all_valid_copy ? SCR_SUCCESS : SCR_FAILURE;
 
   return rc;
 }
 
-/* apply redundancy scheme to files */
-int scr_reddesc_apply(
+/* state of the encode we have dispatched but not yet waited on */
+static int scr_reddesc_apply_set_id = -1;
+static int scr_reddesc_apply_rc;
+static const scr_reddesc* scr_reddesc_apply_desc;
+static int scr_reddesc_apply_files;
+static double scr_reddesc_apply_bytes;
+static double scr_reddesc_apply_my_bytes;
+static double scr_reddesc_apply_time_start;
+static time_t scr_reddesc_apply_timestamp_start;
+
+/* tracks helper thread that runs ER_Dispatch and ER_Wait for an
+ * asynchronous encode, ER works on duplicates of the world and store
+ * communicators so that its collectives do not mix with our own */
+typedef struct {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  int      active;     /* whether the thread was started */
+  int      done;       /* set by the thread once the encode has finished */
+  int      rc;         /* return code from the encode */
+  int      set_id;     /* ER set being encoded */
+  MPI_Comm comm_world; /* duplicate of scr_comm_world given to ER */
+  MPI_Comm comm_store; /* duplicate of store communicator given to ER */
+} scr_reddesc_encode_t;
+
+static scr_reddesc_encode_t scr_reddesc_encode = {
+  .lock       = PTHREAD_MUTEX_INITIALIZER,
+  .active     = 0,
+  .comm_world = MPI_COMM_NULL,
+  .comm_store = MPI_COMM_NULL,
+};
+
+/* dispatch the encode and wait for it to complete */
+static void* scr_reddesc_encode_thread(void* arg)
+{
+  scr_reddesc_encode_t* e = (scr_reddesc_encode_t*) arg;
+
+  int rc = SCR_SUCCESS;
+  if (ER_Dispatch(e->set_id) != ER_SUCCESS) {
+    scr_err("ER_Dispatch failed @ %s:%d", __FILE__, __LINE__);
+    rc = SCR_FAILURE;
+  }
+  if (ER_Wait(e->set_id) != ER_SUCCESS) {
+    scr_err("ER_Wait failed @ %s:%d", __FILE__, __LINE__);
+    rc = SCR_FAILURE;
+  }
+
+  pthread_mutex_lock(&e->lock);
+  e->rc   = rc;
+  e->done = 1;
+  pthread_mutex_unlock(&e->lock);
+
+  return NULL;
+}
+
+/* free the communicators we duplicated for the encode */
+static void scr_reddesc_encode_free_comms(scr_reddesc_encode_t* e)
+{
+  if (e->comm_world != MPI_COMM_NULL) {
+    MPI_Comm_free(&e->comm_world);
+  }
+  if (e->comm_store != MPI_COMM_NULL) {
+    MPI_Comm_free(&e->comm_store);
+  }
+}
+
+/* start applying redundancy scheme to files, sets scr_encode_async_in_progress
+ * if the encode has been dispatched and must be finished with apply_wait */
+int scr_reddesc_apply_start(
   scr_filemap* map,
   const scr_reddesc* desc,
   int id)
 {
   /* start timer */
   time_t timestamp_start;
-  double time_start;
+  double time_start = MPI_Wtime();
   if (scr_my_rank_world == 0) {
     timestamp_start = scr_log_seconds();
-    time_start = MPI_Wtime();
   }
 
   /* step through each of my files for the specified dataset
    * to scan for any incomplete files */
   int valid = 1;
   unsigned long my_counts[3] = {0};
+  scr_cache_stat_files(map);
   kvtree_elem* file_elem;
   for (file_elem = scr_filemap_first_file(map);
        file_elem != NULL;
@@ -543,22 +833,39 @@ int scr_reddesc_apply(
       valid = 0;
     }
 
-    /* add up the number of files and bytes on our way through */
+    /* add up the number of files and bytes on our way through,
+     * using the size recorded when the file was completed */
+    unsigned long filesize;
+    scr_meta* meta = scr_meta_new();
+    if (scr_filemap_get_meta(map, file, meta) != SCR_SUCCESS ||
+        scr_meta_get_filesize(meta, &filesize) != SCR_SUCCESS)
+    {
+      filesize = scr_file_size(file);
+    }
+    scr_meta_delete(&meta);
     my_counts[0] += 1;
-    my_counts[1] += scr_file_size(file);
+    my_counts[1] += filesize;
 
-    /* if crc_on_copy is set, compute crc and update meta file */
+    /* if crc_on_copy is set, compute crc and update meta file,
+     * unless that was done when the application closed the file */
     if (scr_crc_on_copy) {
-      scr_compute_crc(map, file);
+      struct stat stat_buf;
+      int type;
+      uint64_t value;
+      if (scr_stream_get(file, &stat_buf, &type, &value) != SCR_SUCCESS || type < 0) {
+        scr_compute_crc(map, file);
+      }
     }
   }
 
+  scr_statx_clear();
+
   /* record valid flag, we'll sum these up to determine if all ranks are valid */
   my_counts[2] = valid;
 
   /* add up total number of files, bytes, and valid flags */
   unsigned long total_counts[3];
-  MPI_Allreduce(&my_counts, &total_counts, 3, MPI_UNSIGNED_LONG, MPI_SUM, scr_comm_world);
+  scr_allreduce(&my_counts, &total_counts, 3, MPI_UNSIGNED_LONG, MPI_SUM, scr_comm_world);
   int files       = (int)    total_counts[0];
   double bytes    = (double) total_counts[1];
   int total_valid = (int)    total_counts[2];
@@ -575,20 +882,21 @@ int scr_reddesc_apply(
   scr_storedesc* store = scr_reddesc_get_store(desc);
 
   /* first encode filemap files, need to capture multi-level storage
-   * info (path in cache and path in prefix) in case of a rebuild on scavenge */
-  int filemap_rc = scr_reddesc_apply_to_filemap(desc, id, store);
-  if (filemap_rc != SCR_SUCCESS) {
-    if (scr_my_rank_world == 0) {
-      scr_err("Failed to encode filemaps @ %s:%d",
-              __FILE__, __LINE__
-      );
-    }
-    return SCR_FAILURE;
-  }
+   * info (path in cache and path in prefix) in case of a rebuild on scavenge,
+   * we agree on the result along with the check of the data files below */
+  int filemap_valid = (scr_reddesc_apply_to_filemap(desc, id, store) == SCR_SUCCESS);
 
   /* we only need to protect the filemap for bypass datasets */
   if (desc->bypass) {
     /* TODO: want to print and log timing in this case? */
+    if (! scr_alltrue(filemap_valid, scr_comm_world)) {
+      if (scr_my_rank_world == 0) {
+        scr_err("Failed to encode filemaps @ %s:%d",
+                __FILE__, __LINE__
+        );
+      }
+      return SCR_FAILURE;
+    }
     return SCR_SUCCESS;
   }
 
@@ -598,8 +906,20 @@ int scr_reddesc_apply(
   /* define path to er files */
   char* reddesc_dir = scr_reddesc_prefix(dir_hidden);
 
+  /* an asynchronous encode hands ER its own communicators,
+   * since it runs on a helper thread */
+  scr_reddesc_encode_t* e = &scr_reddesc_encode;
+  MPI_Comm comm_world = scr_comm_world;
+  MPI_Comm comm_store = store->comm;
+  if (scr_encode_async) {
+    MPI_Comm_dup(scr_comm_world, &e->comm_world);
+    MPI_Comm_dup(store->comm,    &e->comm_store);
+    comm_world = e->comm_world;
+    comm_store = e->comm_store;
+  }
+
   /* create ER set */
-  int set_id = ER_Create(scr_comm_world, store->comm, reddesc_dir, ER_DIRECTION_ENCODE, desc->er_scheme);
+  int set_id = ER_Create(comm_world, comm_store, reddesc_dir, ER_DIRECTION_ENCODE, desc->er_scheme);
   if (set_id < 0) {
     scr_err("Failed to create ER set @ %s:%d",
             __FILE__, __LINE__
@@ -636,23 +956,119 @@ int scr_reddesc_apply(
   scr_free(&mapfile_str);
 #endif
 
-  /* determine whether everyone's files are good */
-  int all_valid = scr_alltrue(valid, scr_comm_world);
-  if (! all_valid) {
+  /* determine whether everyone encoded their filemap and added their
+   * files, with the flags fused so this takes a single reduction */
+  int flags[2] = {filemap_valid, valid};
+  int all_flags[2];
+  scr_allreduce(flags, all_flags, 2, MPI_INT, MPI_LAND, scr_comm_world);
+  if (! all_flags[0] || ! all_flags[1]) {
     if (scr_my_rank_world == 0) {
-      scr_dbg(1, "Exiting copy since one or more checkpoint files is invalid");
+      if (! all_flags[0]) {
+        scr_err("Failed to encode filemaps @ %s:%d",
+                __FILE__, __LINE__
+        );
+      } else {
+        scr_dbg(1, "Exiting copy since one or more checkpoint files is invalid");
+      }
     }
     ER_Free(set_id);
+    scr_reddesc_encode_free_comms(e);
     return SCR_FAILURE;
   }
 
-  /* apply the redundancy scheme */
+  /* start applying the redundancy scheme, ER_Dispatch does not return
+   * until the encode is done, so run it on a helper thread to overlap
+   * the encode with the application */
   int rc = SCR_SUCCESS;
-  if (ER_Dispatch(set_id) != ER_SUCCESS) {
+  if (scr_encode_async) {
+    e->done   = 0;
+    e->rc     = SCR_SUCCESS;
+    e->set_id = set_id;
+    if (pthread_create(&e->thread, NULL, scr_reddesc_encode_thread, e) == 0) {
+      e->active = 1;
+    } else {
+      scr_err("Failed to create thread to encode dataset %d @ %s:%d",
+        id, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+  } else if (ER_Dispatch(set_id) != ER_SUCCESS) {
     scr_err("ER_Dispatch failed @ %s:%d", __FILE__, __LINE__);
     rc = SCR_FAILURE;
   }
-  if (ER_Wait(set_id) != ER_SUCCESS) {
+
+  /* remember what we need to finish the encode in apply_wait */
+  scr_reddesc_apply_set_id          = set_id;
+  scr_reddesc_apply_rc              = rc;
+  scr_reddesc_apply_desc            = desc;
+  scr_reddesc_apply_files           = files;
+  scr_reddesc_apply_bytes           = bytes;
+  scr_reddesc_apply_my_bytes        = (double) my_counts[1];
+  scr_reddesc_apply_time_start      = time_start;
+  scr_reddesc_apply_timestamp_start = timestamp_start;
+
+  /* mark that we've started an encode */
+  scr_encode_async_in_progress = 1;
+  scr_encode_async_dataset_id  = id;
+
+  return SCR_SUCCESS;
+}
+
+/* returns SCR_SUCCESS if the dispatched encode has finished on all procs */
+int scr_reddesc_apply_test(void)
+{
+  /* if nothing is outstanding, there is nothing to wait on */
+  if (! scr_encode_async_in_progress) {
+    return SCR_SUCCESS;
+  }
+
+  /* a failed dispatch has nothing left to do */
+  int done = 1;
+  scr_reddesc_encode_t* e = &scr_reddesc_encode;
+  if (e->active) {
+    pthread_mutex_lock(&e->lock);
+    done = e->done;
+    pthread_mutex_unlock(&e->lock);
+  } else if (scr_reddesc_apply_rc == SCR_SUCCESS && ER_Test(scr_reddesc_apply_set_id) != ER_SUCCESS) {
+    done = 0;
+  }
+
+  /* we're only done if everyone is done */
+  if (! scr_alltrue(done, scr_comm_world)) {
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
+
+/* wait for the dispatched encode to finish, returns SCR_SUCCESS
+ * if all procs succeeded */
+int scr_reddesc_apply_wait(void)
+{
+  /* if nothing is outstanding, there is nothing to wait on */
+  if (! scr_encode_async_in_progress) {
+    return SCR_SUCCESS;
+  }
+
+  scr_trace_mark_begin("encode_wait");
+
+  int set_id              = scr_reddesc_apply_set_id;
+  int rc                  = scr_reddesc_apply_rc;
+  const scr_reddesc* desc = scr_reddesc_apply_desc;
+  int id                  = scr_encode_async_dataset_id;
+  int files               = scr_reddesc_apply_files;
+  double bytes            = scr_reddesc_apply_bytes;
+  double time_start       = scr_reddesc_apply_time_start;
+  time_t timestamp_start  = scr_reddesc_apply_timestamp_start;
+
+  /* wait for the redundancy scheme to be applied */
+  scr_reddesc_encode_t* e = &scr_reddesc_encode;
+  if (e->active) {
+    pthread_join(e->thread, NULL);
+    e->active = 0;
+    if (e->rc != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+  } else if (rc == SCR_SUCCESS && ER_Wait(set_id) != ER_SUCCESS) {
     scr_err("ER_Wait failed @ %s:%d", __FILE__, __LINE__);
     rc = SCR_FAILURE;
   }
@@ -660,6 +1076,12 @@ int scr_reddesc_apply(
     scr_err("ER_Free failed @ %s:%d", __FILE__, __LINE__);
     rc = SCR_FAILURE;
   }
+  scr_reddesc_encode_free_comms(e);
+
+  /* mark that we've stopped the encode */
+  scr_reddesc_apply_set_id     = -1;
+  scr_encode_async_in_progress = 0;
+  scr_encode_async_dataset_id  = -1;
 
   /* determine whether everyone succeeded in their copy */
   int valid_copy = (rc == SCR_SUCCESS);
@@ -672,8 +1094,22 @@ int scr_reddesc_apply(
   rc = all_valid_copy ? SCR_SUCCESS : SCR_FAILURE;
 
   /* stop timer and report performance info */
+  double time_end = MPI_Wtime();
+  scr_stats_record(SCR_STATS_ENCODE, scr_reddesc_apply_my_bytes, time_end - time_start);
+
+  /* record cost of encoding with this descriptor for the cost model,
+   * copies of descriptors made during restart do not count */
+  if (rc == SCR_SUCCESS && desc->index >= 0 && desc->index < scr_nreddescs &&
+      desc == &scr_reddescs[desc->index])
+  {
+    scr_reddesc* measured = &scr_reddescs[desc->index];
+    measured->encode_count++;
+    measured->encode_secs  += time_end - time_start;
+    measured->encode_bytes += bytes;
+    scr_reddesc_model_bytes = bytes;
+  }
+
   if (scr_my_rank_world == 0) {
-    double time_end = MPI_Wtime();
     double time_diff = time_end - time_start;
     double bw = 0.0;
     if (time_diff > 0.0) {
@@ -686,11 +1122,37 @@ int scr_reddesc_apply(
     /* log data on the copy in the database */
     if (scr_log_enable) {
       char* dir = scr_cache_dir_get(desc, id);
-      scr_log_transfer("ENCODE", desc->base, dir, &id, NULL, &timestamp_start, &time_diff, &bytes, &files);
+      scr_log_transfer("ENCODE", desc->base, dir, &id, NULL, &timestamp_start, &time_diff, &bytes, NULL, &files);
       scr_free(&dir);
     }
   }
 
+  scr_trace_mark_end("encode_wait");
+  return rc;
+}
+
+/* apply redundancy scheme to files */
+int scr_reddesc_apply(
+  scr_filemap* map,
+  const scr_reddesc* desc,
+  int id)
+{
+  scr_trace_mark_begin("encode");
+
+  /* finish any encode still running from an earlier dataset */
+  if (scr_reddesc_apply_wait() != SCR_SUCCESS) {
+    scr_err("Failed to encode earlier dataset @ %s:%d",
+      __FILE__, __LINE__
+    );
+  }
+
+  /* dispatch the encode and wait for it to finish */
+  int rc = scr_reddesc_apply_start(map, desc, id);
+  if (scr_encode_async_in_progress) {
+    rc = scr_reddesc_apply_wait();
+  }
+
+  scr_trace_mark_end("encode");
   return rc;
 }
 
@@ -751,6 +1213,7 @@ int scr_reddesc_recover(scr_cache_index* cindex, int id, const char* dir)
 
       /* step through each of my files for the specified dataset
        * to scan for any incomplete files */
+      scr_cache_stat_files(map);
       kvtree_elem* file_elem;
       for (file_elem = scr_filemap_first_file(map);
            file_elem != NULL;
@@ -765,6 +1228,7 @@ int scr_reddesc_recover(scr_cache_index* cindex, int id, const char* dir)
           rc = SCR_FAILURE;
         }
       }
+      scr_statx_clear();
 
       /* free the map */
       scr_filemap_delete(&map);
@@ -52,10 +52,17 @@ typedef struct {
   int      bypass;         /* flag indicating whether data should bypass cache */
   int      store_index;    /* index into scr_storedesc for storage descriptor */
   int      group_index;    /* index into scr_groupdesc for failure group */
+  int      set_group_index; /* index into scr_groupdesc for group each set stays within, -1 for all procs */
   char*    base;           /* base cache directory to use */
   char*    directory;      /* full directory base/dataset.id */
+  int      stripe_count;   /* number of stores besides store_index files are striped across */
+  int*     stripe_index;   /* index into scr_storedesc for each store files are striped across */
+  char**   stripe_dirs;    /* job directory on each store files are striped across */
   int      copy_type;      /* redundancy scheme to apply */
   int      er_scheme;      /* encoding scheme id */
+  int      encode_count;   /* number of encodes measured with this descriptor */
+  double   encode_secs;    /* total seconds spent in measured encodes */
+  double   encode_bytes;   /* total bytes encoded in measured encodes */
 } scr_reddesc;
 
 /*
@@ -84,6 +91,23 @@ scr_reddesc* scr_reddesc_for_checkpoint(
   scr_reddesc* descs
 );
 
+/* among the enabled descriptors, select and return a pointer to the one
+ * that minimizes the expected time lost to the next checkpoint, from the
+ * measured cost of encoding with each one and the rate of failures each
+ * cannot survive, where interval is the expected seconds until the
+ * checkpoint after the next one and lost is the seconds of work a failure
+ * the descriptor cannot survive would cost, descriptors not measured yet
+ * are left out, and returns configured, the descriptor picked by the
+ * regular schedule, if it has not been measured yet, if none has, or
+ * if no failure rate is known */
+scr_reddesc* scr_reddesc_for_model(
+  int ndescs,
+  scr_reddesc* descs,
+  scr_reddesc* configured,
+  double interval,
+  double lost
+);
+
 /* convert the specified redundancy descritpor into a corresponding
  * hash */
 int scr_reddesc_store_to_hash(
@@ -105,6 +129,13 @@ scr_storedesc* scr_reddesc_get_store(
   const scr_reddesc* desc
 );
 
+/* return pointer to the store descriptor of the given stripe of a
+ * redundancy descriptor, returns NULL if out of range */
+scr_storedesc* scr_reddesc_get_stripe_store(
+  const scr_reddesc* desc,
+  int stripe
+);
+
 /* apply redundancy scheme to files */
 int scr_reddesc_apply(
   scr_filemap* map,
@@ -112,6 +143,21 @@ int scr_reddesc_apply(
   int id
 );
 
+/* start applying redundancy scheme to files, sets scr_encode_async_in_progress
+ * if the encode has been dispatched and must be finished with apply_wait */
+int scr_reddesc_apply_start(
+  scr_filemap* map,
+  const scr_reddesc* c,
+  int id
+);
+
+/* returns SCR_SUCCESS if the dispatched encode has finished on all procs */
+int scr_reddesc_apply_test(void);
+
+/* wait for the dispatched encode to finish, returns SCR_SUCCESS
+ * if all procs succeeded */
+int scr_reddesc_apply_wait(void);
+
 /* rebuilds files for specified dataset id using specified redundancy descriptor,
  * adds them to filemap, and returns SCR_SUCCESS if all processes succeeded */
 int scr_reddesc_recover(
@@ -0,0 +1,387 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#include "scr_globals.h"
+
+#include "spath.h"
+#include "kvtree_util.h"
+
+/* the trailer holds the number of extents followed by the magic */
+#define SCR_SEGMENT_TRAILER (sizeof(uint64_t) + 8)
+
+/* each extent is recorded as an offset and a length */
+#define SCR_SEGMENT_EXTENT (2 * sizeof(uint64_t))
+
+/* returns 1 if file is a segment of a shared file, 0 otherwise */
+int scr_segment_is(const char* file)
+{
+  const char* suffix = strstr(file, SCR_SEGMENT_SUFFIX);
+  if (suffix == NULL) {
+    return 0;
+  }
+
+  /* the suffix must be followed by a rank and nothing else */
+  const char* c = suffix + strlen(SCR_SEGMENT_SUFFIX);
+  if (*c == '\0') {
+    return 0;
+  }
+  for (; *c != '\0'; c++) {
+    if (! isdigit((unsigned char) *c)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* return newly allocated name of the shared file that file is a segment of */
+static char* scr_segment_shared_name(const char* file)
+{
+  char* shared = strdup(file);
+  char* suffix = strstr(shared, SCR_SEGMENT_SUFFIX);
+  if (suffix != NULL) {
+    *suffix = '\0';
+  }
+  return shared;
+}
+
+/* read the extent table from the end of seg_file, returns the number
+ * of extents in count, and a newly allocated list of offset and length
+ * pairs in extents */
+static int scr_segment_extents(const char* seg_file, uint64_t* count, uint64_t** extents)
+{
+  *count = 0;
+  *extents = NULL;
+
+  int fd = scr_open(seg_file, O_RDONLY);
+  if (fd < 0) {
+    scr_err("Failed to open segment: scr_open(%s) errno=%d %s @ %s:%d",
+      seg_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  int rc = SCR_SUCCESS;
+  struct stat stat_buf;
+  char trailer[SCR_SEGMENT_TRAILER];
+  if (fstat(fd, &stat_buf) != 0 || stat_buf.st_size < (off_t) SCR_SEGMENT_TRAILER ||
+      pread(fd, trailer, sizeof(trailer), stat_buf.st_size - sizeof(trailer)) != (ssize_t) sizeof(trailer) ||
+      memcmp(trailer + sizeof(uint64_t), SCR_SEGMENT_MAGIC, 8) != 0)
+  {
+    scr_err("Missing segment trailer in %s @ %s:%d",
+      seg_file, __FILE__, __LINE__
+    );
+    scr_close(seg_file, fd);
+    return SCR_FAILURE;
+  }
+
+  /* the table sits just before the trailer */
+  uint64_t n;
+  memcpy(&n, trailer, sizeof(n));
+  off_t data_bytes = stat_buf.st_size - (off_t) SCR_SEGMENT_TRAILER - (off_t) (n * SCR_SEGMENT_EXTENT);
+  if (data_bytes < 0) {
+    scr_err("Segment %s lists %lu extents but holds %lu bytes @ %s:%d",
+      seg_file, (unsigned long) n, (unsigned long) stat_buf.st_size, __FILE__, __LINE__
+    );
+    scr_close(seg_file, fd);
+    return SCR_FAILURE;
+  }
+
+  uint64_t* list = NULL;
+  if (n > 0) {
+    size_t table_bytes = (size_t) (n * SCR_SEGMENT_EXTENT);
+    list = (uint64_t*) SCR_MALLOC(table_bytes);
+    if (pread(fd, list, table_bytes, data_bytes) != (ssize_t) table_bytes) {
+      scr_err("Failed to read extent table of segment %s errno=%d %s @ %s:%d",
+        seg_file, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+  }
+
+  /* the extents must account for every data byte */
+  uint64_t i;
+  uint64_t total = 0;
+  for (i = 0; i < n && rc == SCR_SUCCESS; i++) {
+    total += list[2 * i + 1];
+  }
+  if (rc == SCR_SUCCESS && total != (uint64_t) data_bytes) {
+    scr_err("Extents of segment %s cover %lu bytes, but it holds %lu @ %s:%d",
+      seg_file, (unsigned long) total, (unsigned long) data_bytes, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  scr_close(seg_file, fd);
+
+  if (rc != SCR_SUCCESS) {
+    scr_free(&list);
+    return rc;
+  }
+
+  *count = n;
+  *extents = list;
+  return SCR_SUCCESS;
+}
+
+/* copy length bytes at src_off in src_fd to dst_off in dst_fd */
+static int scr_segment_copy(
+  const char* src_file, int src_fd, off_t src_off,
+  const char* dst_file, int dst_fd, off_t dst_off,
+  uint64_t length, char* buf, size_t buf_size)
+{
+  uint64_t remaining = length;
+  while (remaining > 0) {
+    size_t chunk = buf_size;
+    if ((uint64_t) chunk > remaining) {
+      chunk = (size_t) remaining;
+    }
+
+    ssize_t nread = pread(src_fd, buf, chunk, src_off);
+    if (nread != (ssize_t) chunk) {
+      scr_err("Failed to read %lu bytes at %lu from %s errno=%d %s @ %s:%d",
+        (unsigned long) chunk, (unsigned long) src_off, src_file,
+        errno, strerror(errno), __FILE__, __LINE__
+      );
+      return SCR_FAILURE;
+    }
+
+    ssize_t nwrite = pwrite(dst_fd, buf, chunk, dst_off);
+    if (nwrite != (ssize_t) chunk) {
+      scr_err("Failed to write %lu bytes at %lu to %s errno=%d %s @ %s:%d",
+        (unsigned long) chunk, (unsigned long) dst_off, dst_file,
+        errno, strerror(errno), __FILE__, __LINE__
+      );
+      return SCR_FAILURE;
+    }
+
+    src_off   += (off_t) chunk;
+    dst_off   += (off_t) chunk;
+    remaining -= (uint64_t) chunk;
+  }
+  return SCR_SUCCESS;
+}
+
+/* read the extent table of segment seg_file and record the shared file
+ * that dst_file is a segment of along with its extents in file_hash */
+int scr_segment_record(const char* seg_file, const char* dst_file, kvtree* file_hash)
+{
+  uint64_t count;
+  uint64_t* extents;
+  if (scr_segment_extents(seg_file, &count, &extents) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+
+  /* rank2file entries are relative to the prefix directory */
+  char* shared = scr_segment_shared_name(dst_file);
+  spath* base = spath_from_str(scr_prefix);
+  spath* dest = spath_from_str(shared);
+  spath* rel  = spath_relative(base, dest);
+  char* relname = spath_strdup(rel);
+  kvtree_util_set_str(file_hash, SCR_KEY_SHARED, relname);
+  scr_free(&relname);
+  spath_delete(&rel);
+  spath_delete(&dest);
+  spath_delete(&base);
+  scr_free(&shared);
+
+  uint64_t i;
+  for (i = 0; i < count; i++) {
+    kvtree* extent_hash = kvtree_set_kv_int(file_hash, SCR_KEY_EXTENT, (int) i);
+    kvtree_util_set_unsigned_long(extent_hash, SCR_KEY_OFFSET, (unsigned long) extents[2 * i]);
+    kvtree_util_set_unsigned_long(extent_hash, SCR_KEY_LENGTH, (unsigned long) extents[2 * i + 1]);
+  }
+
+  scr_free(&extents);
+  return SCR_SUCCESS;
+}
+
+/* write the extents of segment seg_file to their place in the
+ * shared file that dst_file is a segment of */
+int scr_segment_write(const char* seg_file, const char* dst_file, double* moved)
+{
+  *moved = 0.0;
+
+  uint64_t count;
+  uint64_t* extents;
+  if (scr_segment_extents(seg_file, &count, &extents) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+
+  int src_fd = scr_open(seg_file, O_RDONLY);
+  if (src_fd < 0) {
+    scr_err("Failed to open segment: scr_open(%s) errno=%d %s @ %s:%d",
+      seg_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_free(&extents);
+    return SCR_FAILURE;
+  }
+
+  /* every rank writes into the same file, so none of us truncate it,
+   * bytes outside the extents of all segments are undefined */
+  char* shared = scr_segment_shared_name(dst_file);
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int dst_fd = scr_open(shared, O_WRONLY | O_CREAT, mode_file);
+  if (dst_fd < 0) {
+    scr_err("Failed to open shared file: scr_open(%s) errno=%d %s @ %s:%d",
+      shared, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_close(seg_file, src_fd);
+    scr_free(&shared);
+    scr_free(&extents);
+    return SCR_FAILURE;
+  }
+
+  /* data of each extent follows that of the one before it */
+  int rc = SCR_SUCCESS;
+  char* buf = (char*) SCR_MALLOC(scr_file_buf_size);
+  off_t pos = 0;
+  uint64_t i;
+  for (i = 0; i < count && rc == SCR_SUCCESS; i++) {
+    uint64_t length = extents[2 * i + 1];
+    rc = scr_segment_copy(seg_file, src_fd, pos, shared, dst_fd,
+      (off_t) extents[2 * i], length, buf, scr_file_buf_size
+    );
+    pos    += (off_t) length;
+    *moved += (double) length;
+  }
+  scr_free(&buf);
+
+  if (fsync(dst_fd) < 0) {
+    scr_err("Failed to fsync shared file %s errno=%d %s @ %s:%d",
+      shared, errno, strerror(errno), __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+  if (scr_close(shared, dst_fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  scr_close(seg_file, src_fd);
+
+  scr_free(&shared);
+  scr_free(&extents);
+  return rc;
+}
+
+/* given rank2file entry of a file, return newly allocated path to the
+ * shared file it is a segment of along with a new hash holding a copy
+ * of its extents, returns SCR_FAILURE if the file is not a segment */
+int scr_segment_get(const kvtree* file_hash, char** shared, kvtree** extents)
+{
+  char* relname = NULL;
+  if (kvtree_util_get_str(file_hash, SCR_KEY_SHARED, &relname) != KVTREE_SUCCESS) {
+    return SCR_FAILURE;
+  }
+
+  spath* path = spath_from_str(scr_prefix);
+  spath_append_str(path, relname);
+  spath_reduce(path);
+  *shared = spath_strdup(path);
+  spath_delete(&path);
+
+  *extents = kvtree_new();
+  kvtree* list = kvtree_get(file_hash, SCR_KEY_EXTENT);
+  if (list != NULL) {
+    kvtree* copy = kvtree_new();
+    kvtree_merge(copy, list);
+    kvtree_set(*extents, SCR_KEY_EXTENT, copy);
+  }
+
+  return SCR_SUCCESS;
+}
+
+/* rebuild segment file from the extents in shared file held in
+ * extents, as returned by scr_segment_get */
+int scr_segment_read(const char* shared, const kvtree* extents, const char* file)
+{
+  /* gather the extent table, which we write after the data */
+  uint64_t count = (uint64_t) kvtree_size(kvtree_get(extents, SCR_KEY_EXTENT));
+  uint64_t* list = NULL;
+  if (count > 0) {
+    list = (uint64_t*) SCR_MALLOC((size_t) (count * SCR_SEGMENT_EXTENT));
+  }
+  uint64_t i;
+  for (i = 0; i < count; i++) {
+    kvtree* extent_hash = kvtree_get_kv_int(extents, SCR_KEY_EXTENT, (int) i);
+    unsigned long offset, length;
+    if (extent_hash == NULL ||
+        kvtree_util_get_unsigned_long(extent_hash, SCR_KEY_OFFSET, &offset) != KVTREE_SUCCESS ||
+        kvtree_util_get_unsigned_long(extent_hash, SCR_KEY_LENGTH, &length) != KVTREE_SUCCESS)
+    {
+      scr_err("Missing extent %lu of segment %s of %s @ %s:%d",
+        (unsigned long) i, file, shared, __FILE__, __LINE__
+      );
+      scr_free(&list);
+      return SCR_FAILURE;
+    }
+    list[2 * i]     = (uint64_t) offset;
+    list[2 * i + 1] = (uint64_t) length;
+  }
+
+  int src_fd = scr_open(shared, O_RDONLY);
+  if (src_fd < 0) {
+    scr_err("Failed to open shared file: scr_open(%s) errno=%d %s @ %s:%d",
+      shared, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_free(&list);
+    return SCR_FAILURE;
+  }
+
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int dst_fd = scr_open(file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (dst_fd < 0) {
+    scr_err("Failed to open file for writing: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_close(shared, src_fd);
+    scr_free(&list);
+    return SCR_FAILURE;
+  }
+
+  /* read each extent back to back, then append the table and trailer,
+   * which gives back the same bytes the interposer wrote */
+  int rc = SCR_SUCCESS;
+  char* buf = (char*) SCR_MALLOC(scr_file_buf_size);
+  off_t pos = 0;
+  for (i = 0; i < count && rc == SCR_SUCCESS; i++) {
+    uint64_t length = list[2 * i + 1];
+    rc = scr_segment_copy(shared, src_fd, (off_t) list[2 * i], file, dst_fd,
+      pos, length, buf, scr_file_buf_size
+    );
+    pos += (off_t) length;
+  }
+  scr_free(&buf);
+
+  if (rc == SCR_SUCCESS) {
+    char trailer[SCR_SEGMENT_TRAILER];
+    memcpy(trailer, &count, sizeof(count));
+    memcpy(trailer + sizeof(count), SCR_SEGMENT_MAGIC, 8);
+    size_t table_bytes = (size_t) (count * SCR_SEGMENT_EXTENT);
+    if ((table_bytes > 0 && pwrite(dst_fd, list, table_bytes, pos) != (ssize_t) table_bytes) ||
+        pwrite(dst_fd, trailer, sizeof(trailer), pos + (off_t) table_bytes) != (ssize_t) sizeof(trailer))
+    {
+      scr_err("Failed to write extent table to %s errno=%d %s @ %s:%d",
+        file, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+  }
+
+  if (scr_close(file, dst_fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  scr_close(shared, src_fd);
+  scr_free(&list);
+
+  if (rc != SCR_SUCCESS) {
+    unlink(file);
+  }
+  return rc;
+}
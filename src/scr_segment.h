@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_SEGMENT_H
+#define SCR_SEGMENT_H
+
+#include "kvtree.h"
+
+/*
+=========================================
+This file handles segments of shared files.  When all procs write one
+file through MPI-IO, the interposer routes the part each rank writes
+into its own segment file in cache, named after the shared file with
+SCR_SEGMENT_SUFFIX and the rank appended.  A segment holds the bytes
+the rank wrote back to back, followed by a table of the offset and
+length of each extent in the shared file, followed by a trailer with
+the number of extents and SCR_SEGMENT_MAGIC.  Encoding protects each
+segment like any other file.  A flush writes each extent to its place
+in the shared file and records the extents in the rank2file entry of
+the segment, and a fetch reads them back to rebuild the segment.
+=========================================
+*/
+
+/* suffix given to the name of the shared file to name a segment,
+ * the interposer uses the same format */
+#define SCR_SEGMENT_SUFFIX (".scrseg.")
+#define SCR_SEGMENT_MAGIC  ("SCRSEG01")
+
+/* returns 1 if file is a segment of a shared file, 0 otherwise */
+int scr_segment_is(const char* file);
+
+/* read the extent table of segment seg_file and record the shared file
+ * that dst_file is a segment of along with its extents in file_hash */
+int scr_segment_record(const char* seg_file, const char* dst_file, kvtree* file_hash);
+
+/* write the extents of segment seg_file to their place in the
+ * shared file that dst_file is a segment of */
+int scr_segment_write(const char* seg_file, const char* dst_file, double* moved);
+
+/* given rank2file entry of a file, return newly allocated path to the
+ * shared file it is a segment of along with a new hash holding a copy
+ * of its extents, returns SCR_FAILURE if the file is not a segment */
+int scr_segment_get(const kvtree* file_hash, char** shared, kvtree** extents);
+
+/* rebuild segment file from the extents in shared file held in
+ * extents, as returned by scr_segment_get */
+int scr_segment_read(const char* shared, const kvtree* extents, const char* file);
+
+#endif
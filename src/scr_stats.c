@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#include "scr_globals.h"
+
+/* number of values we track for each phase */
+#define SCR_STATS_COUNT (0)
+#define SCR_STATS_BYTES (1)
+#define SCR_STATS_SECS  (2)
+#define SCR_STATS_VALS  (3)
+
+/* local values for most recent and cumulative runs of each phase */
+static double scr_stats_last[SCR_STATS_PHASES][SCR_STATS_VALS];
+static double scr_stats_total[SCR_STATS_PHASES][SCR_STATS_VALS];
+
+/* local rate limit and backlog of an ongoing async flush */
+static double scr_stats_flush[2];
+
+/* local counters for the report at finalize */
+static double scr_stats_events[SCR_STATS_EVENTS];
+
+/* add value to the counter of event */
+void scr_stats_add(int event, double value)
+{
+  if (event < 0 || event >= SCR_STATS_EVENTS) {
+    return;
+  }
+  scr_stats_events[event] += value;
+}
+
+/* record that the calling rank moved bytes in secs for one run of phase */
+void scr_stats_record(int phase, double bytes, double secs)
+{
+  if (phase < 0 || phase >= SCR_STATS_PHASES) {
+    return;
+  }
+
+  /* guard against clock skew */
+  if (secs < 0.0) {
+    secs = 0.0;
+  }
+
+  scr_stats_last[phase][SCR_STATS_COUNT] = 1.0;
+  scr_stats_last[phase][SCR_STATS_BYTES] = bytes;
+  scr_stats_last[phase][SCR_STATS_SECS]  = secs;
+
+  scr_stats_total[phase][SCR_STATS_COUNT] += 1.0;
+  scr_stats_total[phase][SCR_STATS_BYTES] += bytes;
+  scr_stats_total[phase][SCR_STATS_SECS]  += secs;
+}
+
+/* record the current async flush rate limit and the bytes left to flush */
+void scr_stats_set_flush(double rate, double backlog)
+{
+  scr_stats_flush[0] = rate;
+  scr_stats_flush[1] = backlog;
+}
+
+/* get the number of runs and seconds the calling rank has spent in phase */
+void scr_stats_local_total(int phase, int* count, double* secs)
+{
+  *count = 0;
+  *secs  = 0.0;
+  if (phase < 0 || phase >= SCR_STATS_PHASES) {
+    return;
+  }
+  *count = (int) scr_stats_total[phase][SCR_STATS_COUNT];
+  *secs  = scr_stats_total[phase][SCR_STATS_SECS];
+}
+
+/* fill in stats for one phase from reduced values */
+static void scr_stats_fill(
+  SCR_Stats_phase* p,
+  const double* min,
+  const double* max,
+  const double* sum)
+{
+  p->count = (int) max[SCR_STATS_COUNT];
+
+  p->rank_bytes_min = min[SCR_STATS_BYTES];
+  p->rank_bytes_max = max[SCR_STATS_BYTES];
+  p->rank_bytes_avg = sum[SCR_STATS_BYTES] / (double) scr_ranks_world;
+
+  p->rank_secs_min = min[SCR_STATS_SECS];
+  p->rank_secs_max = max[SCR_STATS_SECS];
+  p->rank_secs_avg = sum[SCR_STATS_SECS] / (double) scr_ranks_world;
+
+  /* the phase lasts as long as its slowest rank */
+  p->bytes = sum[SCR_STATS_BYTES];
+  p->secs  = max[SCR_STATS_SECS];
+  p->bw    = 0.0;
+  if (p->secs > 0.0) {
+    p->bw = p->bytes / (1024.0 * 1024.0 * p->secs);
+  }
+}
+
+/* reduce statistics across ranks and fill in stats,
+ * must be called by all ranks, stats may be NULL */
+int scr_stats_get(SCR_Stats* stats)
+{
+  /* pack last and total values into one array so we need
+   * a single allreduce for each of min, max, and sum */
+  int n = SCR_STATS_PHASES * SCR_STATS_VALS;
+  double vals[2 * SCR_STATS_PHASES * SCR_STATS_VALS];
+  memcpy(&vals[0], scr_stats_last,  sizeof(scr_stats_last));
+  memcpy(&vals[n], scr_stats_total, sizeof(scr_stats_total));
+
+  double min[2 * SCR_STATS_PHASES * SCR_STATS_VALS];
+  double max[2 * SCR_STATS_PHASES * SCR_STATS_VALS];
+  double sum[2 * SCR_STATS_PHASES * SCR_STATS_VALS];
+  MPI_Allreduce(vals, min, 2 * n, MPI_DOUBLE, MPI_MIN, scr_comm_world);
+  MPI_Allreduce(vals, max, 2 * n, MPI_DOUBLE, MPI_MAX, scr_comm_world);
+  MPI_Allreduce(vals, sum, 2 * n, MPI_DOUBLE, MPI_SUM, scr_comm_world);
+
+  double flush[2];
+  MPI_Allreduce(scr_stats_flush, flush, 2, MPI_DOUBLE, MPI_SUM, scr_comm_world);
+
+  double percent, bw, eta;
+  scr_flush_async_status(&percent, &bw, &eta);
+
+  if (stats == NULL) {
+    return SCR_FAILURE;
+  }
+
+  int i;
+  for (i = 0; i < SCR_STATS_PHASES; i++) {
+    int last  = i * SCR_STATS_VALS;
+    int total = n + i * SCR_STATS_VALS;
+    scr_stats_fill(&stats->last[i],  &min[last],  &max[last],  &sum[last]);
+    scr_stats_fill(&stats->total[i], &min[total], &max[total], &sum[total]);
+  }
+  stats->flush_async_rate    = flush[0];
+  stats->flush_async_backlog = flush[1];
+  stats->flush_async_percent = percent;
+  stats->flush_async_bw      = bw;
+  stats->flush_async_eta     = eta;
+
+  return SCR_SUCCESS;
+}
+
+/* returns secs as a percentage of wall */
+static double scr_stats_percent(double secs, double wall)
+{
+  return (wall > 0.0) ? 100.0 * secs / wall : 0.0;
+}
+
+/* if SCR_REPORT is set, print a summary of the time and bytes SCR used
+ * over wall seconds since SCR_Init from rank 0, must be called by all ranks */
+int scr_stats_report(double wall)
+{
+  if (! scr_report) {
+    return SCR_SUCCESS;
+  }
+
+  SCR_Stats stats;
+  scr_stats_get(&stats);
+
+  /* times are those of the slowest rank, bytes are summed */
+  double max[SCR_STATS_EVENTS];
+  double sum[SCR_STATS_EVENTS];
+  MPI_Allreduce(scr_stats_events, max, SCR_STATS_EVENTS, MPI_DOUBLE, MPI_MAX, scr_comm_world);
+  MPI_Allreduce(scr_stats_events, sum, SCR_STATS_EVENTS, MPI_DOUBLE, MPI_SUM, scr_comm_world);
+
+  if (scr_my_rank_world != 0) {
+    return SCR_SUCCESS;
+  }
+
+  double mb = 1024.0 * 1024.0;
+  scr_dbg(0, "Report: wall time %.3f secs", wall);
+  scr_dbg(0, "Report: init %.3f secs (%.2f%%)",
+    max[SCR_STATS_EV_INIT], scr_stats_percent(max[SCR_STATS_EV_INIT], wall)
+  );
+  scr_dbg(0, "Report: output %d times, %.3f secs (%.2f%%)",
+    stats.total[SCR_STATS_WRITE].count,
+    max[SCR_STATS_EV_OUTPUT], scr_stats_percent(max[SCR_STATS_EV_OUTPUT], wall)
+  );
+
+  const char* names[SCR_STATS_PHASES] = {"write", "encode", "flush", "fetch"};
+  int i;
+  for (i = 0; i < SCR_STATS_PHASES; i++) {
+    const SCR_Stats_phase* p = &stats.total[i];
+    scr_dbg(0, "Report: %s %d times, %.3f secs (%.2f%%), %.3f MB, %.3f MB/s",
+      names[i], p->count, p->secs, scr_stats_percent(p->secs, wall), p->bytes / mb, p->bw
+    );
+  }
+
+  scr_dbg(0, "Report: blocked on async flush %.3f secs (%.2f%%)",
+    max[SCR_STATS_EV_FLUSH_WAIT], scr_stats_percent(max[SCR_STATS_EV_FLUSH_WAIT], wall)
+  );
+
+  /* files written in bypass mode go to the prefix directory, not cache */
+  double bypass = sum[SCR_STATS_EV_BYPASS];
+  double cache  = stats.total[SCR_STATS_WRITE].bytes - bypass;
+  double prefix = stats.total[SCR_STATS_FLUSH].bytes + bypass;
+  scr_dbg(0, "Report: written to cache %.3f MB, to prefix %.3f MB, read from prefix %.3f MB",
+    cache / mb, prefix / mb, stats.total[SCR_STATS_FETCH].bytes / mb
+  );
+
+  scr_dbg(0, "Report: datasets deleted from cache %d, evicted for room %d",
+    (int) max[SCR_STATS_EV_DELETE], (int) max[SCR_STATS_EV_EVICT]
+  );
+
+  return SCR_SUCCESS;
+}
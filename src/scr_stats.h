@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_STATS_H
+#define SCR_STATS_H
+
+#include "scr.h"
+
+/*
+=========================================
+This file tracks the bytes and seconds each rank spends in each
+phase for SCR_Get_stats.  Recording only updates local counters,
+values are reduced across ranks when statistics are requested.
+A few more counters feed the report SCR_REPORT prints at finalize.
+=========================================
+*/
+
+/* counters kept only for the report at finalize */
+#define SCR_STATS_EV_INIT       (0) /* seconds in SCR_Init */
+#define SCR_STATS_EV_OUTPUT     (1) /* seconds from start to complete of each output */
+#define SCR_STATS_EV_FLUSH_WAIT (2) /* seconds blocked waiting for async flushes */
+#define SCR_STATS_EV_BYPASS     (3) /* bytes written straight to the prefix directory */
+#define SCR_STATS_EV_DELETE     (4) /* datasets deleted from cache */
+#define SCR_STATS_EV_EVICT      (5) /* datasets deleted to make room for a new one */
+#define SCR_STATS_EVENTS        (6)
+
+/* record that the calling rank moved bytes in secs for one run of phase */
+void scr_stats_record(int phase, double bytes, double secs);
+
+/* get the number of runs and seconds the calling rank has spent in phase */
+void scr_stats_local_total(int phase, int* count, double* secs);
+
+/* record the current async flush rate limit and the bytes left to flush */
+void scr_stats_set_flush(double rate, double backlog);
+
+/* reduce statistics across ranks and fill in stats,
+ * must be called by all ranks, stats may be NULL */
+int scr_stats_get(SCR_Stats* stats);
+
+/* add value to the counter of event */
+void scr_stats_add(int event, double value);
+
+/* if SCR_REPORT is set, print a summary of the time and bytes SCR used
+ * over wall seconds since SCR_Init from rank 0, must be called by all ranks */
+int scr_stats_report(double wall);
+
+#endif
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+/* statx */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "scr_globals.h"
+
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "spath.h"
+
+/* a file to be checked */
+typedef struct {
+  char* file;         /* full name of file */
+  char* name;         /* name of file relative to its directory */
+  int   dirfd;        /* open descriptor of directory holding file */
+  int   readable;     /* whether file exists and can be read, -1 if not checked */
+  unsigned long size; /* size of file in bytes */
+  int   have_stat;    /* whether st holds the full stat data of the file */
+  struct stat st;     /* stat data of file if have_stat is set */
+} scr_statx_entry;
+
+/* work shared by the threads of a batch */
+typedef struct {
+  scr_statx_entry* entries; /* files to check */
+  int count;                /* number of files */
+  int full;                 /* whether to get the full stat data of each file */
+  int next;                 /* index of next file to check */
+  pthread_mutex_t lock;     /* protects next */
+} scr_statx_batch;
+
+/* file name mapped to index of its result in scr_statx_results */
+static kvtree* scr_statx_table = NULL;
+
+/* results of all batches since the last scr_statx_clear */
+static scr_statx_entry* scr_statx_results = NULL;
+static int scr_statx_nresults = 0;
+
+/* decide from the mode bits whether we may read a file we own, which
+ * saves asking the file system again, returns -1 if we can't tell */
+static int scr_statx_owner_readable(const struct stat* st)
+{
+  uid_t uid = geteuid();
+  if (uid == 0 || st->st_uid != uid) {
+    return -1;
+  }
+  return (st->st_mode & S_IRUSR) ? 1 : 0;
+}
+
+/* check a single file */
+static void scr_statx_check(scr_statx_entry* e, int full)
+{
+  e->readable = 0;
+  e->size     = 0;
+  if (e->dirfd < 0) {
+    /* leave the file to be checked by name */
+    e->readable = -1;
+    return;
+  }
+
+  /* one lookup that gets everything we record about the file,
+   * files we own are judged readable from their mode bits */
+  if (full) {
+    if (fstatat(e->dirfd, e->name, &e->st, 0) != 0) {
+      return;
+    }
+    e->size      = (unsigned long) e->st.st_size;
+    e->have_stat = 1;
+
+    int readable = scr_statx_owner_readable(&e->st);
+    if (readable < 0) {
+      readable = (faccessat(e->dirfd, e->name, R_OK, 0) == 0);
+    }
+    e->readable = readable;
+    return;
+  }
+
+#ifdef HAVE_STATX
+  struct statx stx;
+  if (statx(e->dirfd, e->name, AT_STATX_DONT_SYNC, STATX_SIZE | STATX_MODE, &stx) != 0) {
+    return;
+  }
+  e->size = (unsigned long) stx.stx_size;
+#else
+  struct stat stat_buf;
+  if (fstatat(e->dirfd, e->name, &stat_buf, 0) != 0) {
+    return;
+  }
+  e->size = (unsigned long) stat_buf.st_size;
+#endif
+
+  /* same test as scr_file_is_readable */
+  if (faccessat(e->dirfd, e->name, R_OK, 0) == 0) {
+    e->readable = 1;
+  }
+}
+
+/* check files of batch until none are left */
+static void* scr_statx_run(void* arg)
+{
+  scr_statx_batch* b = (scr_statx_batch*) arg;
+  while (1) {
+    pthread_mutex_lock(&b->lock);
+    int i = b->next++;
+    pthread_mutex_unlock(&b->lock);
+    if (i >= b->count) {
+      break;
+    }
+    scr_statx_check(&b->entries[i], b->full);
+  }
+  return NULL;
+}
+
+/* check list of files, with full set, get the full stat data of each */
+static int scr_statx_batch_files(int count, const char** files, int full)
+{
+  if (count == 0) {
+    return SCR_SUCCESS;
+  }
+
+  scr_statx_batch b;
+  b.entries = (scr_statx_entry*) SCR_MALLOC(count * sizeof(scr_statx_entry));
+  b.count   = 0;
+  b.full    = full;
+  b.next    = 0;
+  pthread_mutex_init(&b.lock, NULL);
+
+  /* open each directory once, files of a dataset share just a few */
+  kvtree* dirs = kvtree_new();
+  int i;
+  for (i = 0; i < count; i++) {
+    const char* file = files[i];
+
+    spath* path = spath_from_str(file);
+    spath* path_name = spath_cut(path, spath_components(path) - 1);
+    char* dir  = spath_strdup(path);
+    char* name = spath_strdup(path_name);
+    spath_delete(&path_name);
+    spath_delete(&path);
+
+    int dirfd;
+    if (kvtree_util_get_int(dirs, dir, &dirfd) != KVTREE_SUCCESS) {
+      dirfd = open(dir, O_RDONLY | O_DIRECTORY);
+      kvtree_util_set_int(dirs, dir, dirfd);
+    }
+    scr_free(&dir);
+
+    scr_statx_entry* e = &b.entries[b.count++];
+    e->file     = strdup(file);
+    e->name     = name;
+    e->dirfd    = dirfd;
+    e->readable = 0;
+    e->size     = 0;
+    e->have_stat = 0;
+  }
+
+  /* spread the files over a few threads, the calling thread is one of them */
+  int threads = scr_stat_threads;
+  if (threads > b.count) {
+    threads = b.count;
+  }
+  if (threads < 1) {
+    threads = 1;
+  }
+  pthread_t* tids = (pthread_t*) SCR_MALLOC(threads * sizeof(pthread_t));
+  int started = 0;
+  for (i = 1; i < threads; i++) {
+    if (pthread_create(&tids[started], NULL, scr_statx_run, &b) == 0) {
+      started++;
+    }
+  }
+  scr_statx_run(&b);
+  for (i = 0; i < started; i++) {
+    pthread_join(tids[i], NULL);
+  }
+  scr_free(&tids);
+  pthread_mutex_destroy(&b.lock);
+
+  /* record results, a file checked again points to its newest one */
+  if (scr_statx_table == NULL) {
+    scr_statx_table = kvtree_new();
+  }
+  scr_statx_results = (scr_statx_entry*) realloc(scr_statx_results,
+    (scr_statx_nresults + b.count) * sizeof(scr_statx_entry)
+  );
+  if (scr_statx_results == NULL) {
+    scr_abort(-1, "Failed to allocate results of %d file checks @ %s:%d",
+      scr_statx_nresults + b.count, __FILE__, __LINE__
+    );
+  }
+  for (i = 0; i < b.count; i++) {
+    scr_statx_entry* e = &b.entries[i];
+    scr_free(&e->name);
+    if (e->readable >= 0) {
+      int index = scr_statx_nresults++;
+      scr_statx_results[index] = *e;
+      kvtree_util_set_int(scr_statx_table, e->file, index);
+    } else {
+      scr_free(&e->file);
+    }
+  }
+  scr_free(&b.entries);
+
+  /* close the directories */
+  kvtree_elem* elem;
+  for (elem = kvtree_elem_first(dirs);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    int dirfd;
+    if (kvtree_util_get_int(dirs, kvtree_elem_key(elem), &dirfd) == KVTREE_SUCCESS && dirfd >= 0) {
+      close(dirfd);
+    }
+  }
+  kvtree_delete(&dirs);
+
+  return SCR_SUCCESS;
+}
+
+/* check list of files and remember the results until scr_statx_clear */
+int scr_statx_files(int count, const char** files)
+{
+  return scr_statx_batch_files(count, files, 0);
+}
+
+/* like scr_statx_files, but get the full stat data of each file,
+ * asking the file system for current rather than cached values */
+int scr_statx_stat_files(int count, const char** files)
+{
+  return scr_statx_batch_files(count, files, 1);
+}
+
+/* return the result recorded for file, NULL if it was not checked */
+static const scr_statx_entry* scr_statx_lookup(const char* file)
+{
+  int index;
+  if (scr_statx_table == NULL ||
+      kvtree_util_get_int(scr_statx_table, file, &index) != KVTREE_SUCCESS)
+  {
+    return NULL;
+  }
+  return &scr_statx_results[index];
+}
+
+/* look up result for file, returns 1 and sets size if the file was
+ * checked and is readable, 0 if it was checked and is missing or
+ * unreadable, and -1 if it was not checked */
+int scr_statx_get(const char* file, unsigned long* size)
+{
+  const scr_statx_entry* e = scr_statx_lookup(file);
+  if (e == NULL) {
+    return -1;
+  }
+  if (! e->readable) {
+    return 0;
+  }
+  *size = e->size;
+  return 1;
+}
+
+/* look up result of scr_statx_stat_files for file, returns 1 if the
+ * file is readable, 0 if it is not, and -1 if it was not checked,
+ * sets have_stat and fills in stat_buf if the file was found */
+int scr_statx_get_stat(const char* file, struct stat* stat_buf, int* have_stat)
+{
+  *have_stat = 0;
+  const scr_statx_entry* e = scr_statx_lookup(file);
+  if (e == NULL) {
+    return -1;
+  }
+  if (e->have_stat) {
+    *stat_buf  = e->st;
+    *have_stat = 1;
+  }
+  return e->readable;
+}
+
+/* forget all results */
+void scr_statx_clear(void)
+{
+  int i;
+  for (i = 0; i < scr_statx_nresults; i++) {
+    scr_free(&scr_statx_results[i].file);
+  }
+  scr_free(&scr_statx_results);
+  scr_statx_nresults = 0;
+  kvtree_delete(&scr_statx_table);
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_STATX_H
+#define SCR_STATX_H
+
+/*
+=========================================
+This file checks a list of files in one batch before they are tested
+one at a time.  Files are looked up relative to an open file
+descriptor of their directory, with statx asking only for the fields
+we compare where it is available, and the lookups are spread over
+SCR_STAT_THREADS threads.  Checks of a file that was in the batch then
+use the stored result instead of asking the file system again.
+Completing an output needs the full stat data of each file, which
+scr_statx_stat_files gets with a single lookup per file.
+=========================================
+*/
+
+#include <sys/stat.h>
+
+/* check list of files and remember the results until scr_statx_clear */
+int scr_statx_files(int count, const char** files);
+
+/* like scr_statx_files, but get the full stat data of each file,
+ * asking the file system for current rather than cached values */
+int scr_statx_stat_files(int count, const char** files);
+
+/* look up result for file, returns 1 and sets size if the file was
+ * checked and is readable, 0 if it was checked and is missing or
+ * unreadable, and -1 if it was not checked */
+int scr_statx_get(const char* file, unsigned long* size);
+
+/* look up result of scr_statx_stat_files for file, returns 1 if the
+ * file is readable, 0 if it is not, and -1 if it was not checked,
+ * sets have_stat and fills in stat_buf if the file was found */
+int scr_statx_get_stat(const char* file, struct stat* stat_buf, int* have_stat);
+
+/* forget all results */
+void scr_statx_clear(void);
+
+#endif
@@ -12,6 +12,12 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/statvfs.h>
+
+#ifdef __linux__
+#include <sys/vfs.h>
+#include <linux/magic.h>
+#endif
 
 #include "mpi.h"
 
@@ -43,16 +49,47 @@ static int scr_storedesc_init(scr_storedesc* s)
   s->index     = -1;
   s->name      = NULL;
   s->max_count = 0;
+  s->max_bytes = 0;
+  s->arena_bytes = 0;
   s->can_mkdir = 0;
   s->xfer      = NULL;
   s->view      = NULL;
+  s->direct    = 0;
+  s->crc_threads = 1;
+  s->compress  = SCR_COMPRESS_NONE;
+  s->memory    = 0;
+  s->numa      = SCR_NUMA_NONE;
+  s->dedup     = 0;
+  s->cache_compress = SCR_COMPRESS_NONE;
+  s->stripe_bytes = 0;
+  s->stripe_max  = 0;
+  s->stripe_size = 0;
+  s->mdt_count   = 0;
+  s->buf_size    = 0;
+  s->mpi_buf_size = 0;
+  s->write_bw    = 0.0;
   s->comm      = MPI_COMM_NULL;
   s->rank      = MPI_PROC_NULL;
   s->ranks     = 0;
+  s->leaders   = MPI_COMM_NULL;
 
   return SCR_SUCCESS;
 }
 
+/* returns 1 if path is on a file system that keeps its data in memory */
+static int scr_storedesc_is_memory(const char* path)
+{
+#ifdef __linux__
+  struct statfs buf;
+  if (statfs(path, &buf) == 0) {
+    if (buf.f_type == TMPFS_MAGIC || buf.f_type == RAMFS_MAGIC) {
+      return 1;
+    }
+  }
+#endif
+  return 0;
+}
+
 /* free any memory associated with the specified store descriptor */
 static int scr_storedesc_free(scr_storedesc* s)
 {
@@ -66,6 +103,9 @@ static int scr_storedesc_free(scr_storedesc* s)
     if (s->comm != MPI_COMM_NULL) {
       MPI_Comm_free(&s->comm);
     }
+    if (s->leaders != MPI_COMM_NULL) {
+      MPI_Comm_free(&s->leaders);
+    }
 
     /* reinitialize fields */
     scr_storedesc_init(s);
@@ -90,33 +130,55 @@ static int scr_storedesc_copy(scr_storedesc* out, const scr_storedesc* in)
   out->index     = in->index;
   out->name      = strdup(in->name);
   out->max_count = in->max_count;
+  out->max_bytes = in->max_bytes;
+  out->arena_bytes = in->arena_bytes;
   out->can_mkdir = in->can_mkdir;
   out->xfer      = strdup(in->xfer);
   out->view      = strdup(in->view);
+  out->direct    = in->direct;
+  out->crc_threads = in->crc_threads;
+  out->compress  = in->compress;
+  out->memory    = in->memory;
+  out->numa      = in->numa;
+  out->dedup     = in->dedup;
+  out->cache_compress = in->cache_compress;
+  out->stripe_bytes = in->stripe_bytes;
+  out->stripe_max  = in->stripe_max;
+  out->stripe_size = in->stripe_size;
+  out->mdt_count   = in->mdt_count;
+  out->buf_size    = in->buf_size;
+  out->mpi_buf_size = in->mpi_buf_size;
+  out->write_bw    = in->write_bw;
   MPI_Comm_dup(in->comm, &out->comm);
   out->rank      = in->rank;
   out->ranks     = in->ranks;
+  if (in->leaders != MPI_COMM_NULL) {
+    MPI_Comm_dup(in->leaders, &out->leaders);
+  }
 
   return SCR_SUCCESS;
 }
 
 /* build a store descriptor corresponding to the specified hash,
- * this function is collective, because it issues MPI calls */
+ * this function is local, scr_storedescs_create agrees on the
+ * enabled flag and builds the leaders communicator for all stores
+ * at once, sets group_index to the index of the group descriptor
+ * of the store or -1 if there is none */
 static int scr_storedesc_create_from_hash(
   scr_storedesc* s,
   const char* name,
   int index,
   const kvtree* hash,
-  MPI_Comm comm)
+  int* group_index)
 {
-  int rc = SCR_SUCCESS;
+  *group_index = -1;
 
   /* check that we got a valid descriptor */
   if (s == NULL) {
     scr_err("No store descriptor to fill from hash @ %s:%d",
       __FILE__, __LINE__
     );
-    rc = SCR_FAILURE;
+    return SCR_FAILURE;
   }
 
   /* check that we got a valid pointer to a hash */
@@ -124,14 +186,7 @@ static int scr_storedesc_create_from_hash(
     scr_err("No hash specified to build store descriptor from @ %s:%d",
       __FILE__, __LINE__
     );
-    rc = SCR_FAILURE;
-  }
-
-  /* check that everyone made it this far */
-  if (! scr_alltrue(rc == SCR_SUCCESS, comm)) {
-    if (s != NULL) {
-      s->enabled = 0;
-    }
+    scr_storedesc_init(s);
     return SCR_FAILURE;
   }
 
@@ -153,6 +208,14 @@ static int scr_storedesc_create_from_hash(
   s->max_count = scr_cache_size;
   kvtree_util_get_int(hash, SCR_CONFIG_KEY_COUNT, &(s->max_count));
 
+  /* set the max bytes, default to scr_cache_bytes unless specified otherwise */
+  s->max_bytes = scr_cache_bytes;
+  kvtree_util_get_bytecount(hash, SCR_CONFIG_KEY_BYTES, &(s->max_bytes));
+
+  /* set bytes to reserve up front, default to scr_cache_arena unless specified otherwise */
+  s->arena_bytes = scr_cache_arena;
+  kvtree_util_get_bytecount(hash, SCR_CONFIG_KEY_ARENA, &(s->arena_bytes));
+
   /* assume we can call mkdir/rmdir on this store unless told otherwise */
   s->can_mkdir = 1;
   kvtree_util_get_int(hash, SCR_CONFIG_KEY_MKDIR, &(s->can_mkdir));
@@ -172,6 +235,77 @@ static int scr_storedesc_create_from_hash(
     s->view = strdup("PRIVATE");
   }
 
+  /* use buffered I/O on this store unless told otherwise */
+  s->direct = SCR_STORE_DIRECT;
+  kvtree_util_get_int(hash, SCR_CONFIG_KEY_DIRECT, &(s->direct));
+
+  /* number of threads to compute crc32 of large files on this store */
+  s->crc_threads = scr_crc_threads;
+  kvtree_util_get_int(hash, SCR_CONFIG_KEY_CRC_THREADS, &(s->crc_threads));
+
+  /* detect whether the store keeps files in memory unless told otherwise,
+   * checksums of files on such stores are computed from a mapping */
+  s->memory = scr_storedesc_is_memory(s->name);
+  kvtree_util_get_int(hash, SCR_CONFIG_KEY_MEMORY, &(s->memory));
+
+  /* pick the NUMA node to place copy and checksum buffers for files
+   * on this store, and record it so I/O routines can look it up */
+  char* numa = scr_numa;
+  kvtree_util_get_str(hash, SCR_CONFIG_KEY_NUMA, &numa);
+  int numa_setting = scr_numa_from_str(numa);
+  if (numa_setting < SCR_NUMA_LOCAL) {
+    if (scr_my_rank_world == 0) {
+      scr_err("Invalid NUMA setting `%s' for %s, leaving placement to the system @ %s:%d",
+        numa, s->name, __FILE__, __LINE__
+      );
+    }
+    numa_setting = SCR_NUMA_NONE;
+  }
+  s->numa = scr_numa_resolve(numa_setting, s->name);
+  if (s->numa >= 0) {
+    scr_numa_register(s->name, s->numa);
+  }
+
+  /* keep each unique block of files on this store once if asked */
+  s->dedup = scr_cache_dedup;
+  kvtree_util_get_int(hash, SCR_CONFIG_KEY_DEDUP, &(s->dedup));
+
+  /* keep files compressed on this store if asked */
+  char* cache_compress = scr_cache_compress;
+  kvtree_util_get_str(hash, SCR_CONFIG_KEY_CACHE_COMPRESS, &cache_compress);
+  s->cache_compress = scr_compress_type_from_str(cache_compress);
+  if (s->cache_compress < 0 || ! scr_compress_available(s->cache_compress)) {
+    if (scr_my_rank_world == 0) {
+      scr_err("Compression `%s' is not supported, keeping files in %s uncompressed @ %s:%d",
+        cache_compress, s->name, __FILE__, __LINE__
+      );
+    }
+    s->cache_compress = SCR_COMPRESS_NONE;
+  }
+
+  /* rules to pick the layout of files and directories flushed from this store */
+  s->stripe_bytes = scr_flush_stripe_bytes;
+  kvtree_util_get_bytecount(hash, SCR_CONFIG_KEY_STRIPE_BYTES, &(s->stripe_bytes));
+  s->stripe_max = scr_flush_stripe_max;
+  kvtree_util_get_int(hash, SCR_CONFIG_KEY_STRIPE_MAX, &(s->stripe_max));
+  s->stripe_size = scr_flush_stripe_size;
+  kvtree_util_get_bytecount(hash, SCR_CONFIG_KEY_STRIPE_SIZE, &(s->stripe_size));
+  s->mdt_count = scr_flush_mdt_count;
+  kvtree_util_get_int(hash, SCR_CONFIG_KEY_MDT_COUNT, &(s->mdt_count));
+
+  /* set the codec used to compress files flushed from this store */
+  char* compress = scr_flush_compress;
+  kvtree_util_get_str(hash, SCR_CONFIG_KEY_COMPRESS, &compress);
+  s->compress = scr_compress_type_from_str(compress);
+  if (s->compress < 0 || ! scr_compress_available(s->compress)) {
+    if (scr_my_rank_world == 0) {
+      scr_err("Compression `%s' is not supported, flushing %s uncompressed @ %s:%d",
+        compress, s->name, __FILE__, __LINE__
+      );
+    }
+    s->compress = SCR_COMPRESS_NONE;
+  }
+
   /* get communicator of ranks that can access this storage device,
    * assume node-local storage unless told otherwise  */
   char* group = SCR_GROUP_NODE;
@@ -185,18 +319,28 @@ static int scr_storedesc_create_from_hash(
     /* get our rank and the number of ranks in this communicator */
     MPI_Comm_rank(s->comm, &s->rank);
     MPI_Comm_size(s->comm, &s->ranks);
-  } else {
-    s->enabled = 0;
-  }
 
-  /* if anyone has disabled this descriptor, everyone needs to */
-  if (! scr_alltrue(s->enabled, comm)) {
+    /* remember which group we used */
+    *group_index = groupdesc->index;
+  } else {
     s->enabled = 0;
   }
 
   return SCR_SUCCESS;
 }
 
+/* returns 1 if the calling process creates directories on store */
+int scr_storedesc_dir_owner(const scr_storedesc* store)
+{
+  if (! store->can_mkdir) {
+    return 0;
+  }
+  if (!strcmp(store->view, "GLOBAL") && scr_my_rank_host == 0) {
+    return 1;
+  }
+  return (store->rank == 0);
+}
+
 /* create specified directory on store */
 int scr_storedesc_dir_create(const scr_storedesc* store, const char* dir)
 {
@@ -212,10 +356,7 @@ int scr_storedesc_dir_create(const scr_storedesc* store, const char* dir)
 
   /* rank 0 creates the directory */
   int rc = SCR_SUCCESS;
-  if (!strcmp(store->view, "GLOBAL") && store->can_mkdir && scr_my_rank_host == 0) {
-    scr_dbg(2, "Creating directory: %s", dir);
-    rc = scr_mkdir(dir, S_IRWXU | S_IRWXG);
-  } else if (store->rank == 0 && store->can_mkdir) {
+  if (scr_storedesc_dir_owner(store)) {
     scr_dbg(2, "Creating directory: %s", dir);
     rc = scr_mkdir(dir, S_IRWXU | S_IRWXG);
   }
@@ -263,6 +404,20 @@ int scr_storedesc_dir_delete(const scr_storedesc* store, const char* dir)
   return rc;
 }
 
+/* get number of bytes available to unprivileged users on the device of store */
+int scr_storedesc_free_bytes(const scr_storedesc* s, double* bytes)
+{
+  *bytes = 0.0;
+
+  struct statvfs buf;
+  if (s == NULL || s->name == NULL || statvfs(s->name, &buf) != 0) {
+    return SCR_FAILURE;
+  }
+
+  *bytes = (double) buf.f_bavail * (double) buf.f_frsize;
+  return SCR_SUCCESS;
+}
+
 /*
 =========================================
 Routines that operate on scr_storedescs array
@@ -328,6 +483,17 @@ int scr_storedescs_index_from_child_path(const char* path)
   return index;
 }
 
+/* return the number of bytes per buffer to copy a file under path with,
+ * which is the tuned size of its store if it has one */
+size_t scr_storedescs_buf_size(const char* path)
+{
+  int index = scr_storedescs_index_from_child_path(path);
+  if (index >= 0 && scr_storedescs[index].buf_size > 0) {
+    return (size_t) scr_storedescs[index].buf_size;
+  }
+  return scr_file_buf_size;
+}
+
 /* fill in scr_storedescs array from scr_storedescs_hash */
 int scr_storedescs_create(MPI_Comm comm)
 {
@@ -349,6 +515,12 @@ int scr_storedescs_create(MPI_Comm comm)
    * order on all procs */
   kvtree_sort(tmp, KVTREE_SORT_ASCENDING);
 
+  /* four flags per descriptor that we reduce across procs */
+  int* flags = NULL;
+  if (scr_nstoredescs > 0) {
+    flags = (int*) SCR_MALLOC(scr_nstoredescs * 4 * sizeof(int));
+  }
+
   /* iterate over each of our hash entries filling in each
    * corresponding descriptor */
   int index = 0;
@@ -363,14 +535,75 @@ int scr_storedescs_create(MPI_Comm comm)
     /* get the hash for descriptor of specified name */
     kvtree* hash = kvtree_get(tmp, name);
 
-    if (scr_storedesc_create_from_hash(&scr_storedescs[index], name, index, hash, comm) != SCR_SUCCESS) {
-      all_valid = 0;
-    }
+    int group_index;
+    int rc = scr_storedesc_create_from_hash(&scr_storedescs[index], name, index, hash, &group_index);
+
+    /* record whether we built the descriptor, whether it is enabled,
+     * and its group so that we can compare them across procs */
+    flags[index * 4 + 0] = (rc == SCR_SUCCESS);
+    flags[index * 4 + 1] = scr_storedescs[index].enabled;
+    flags[index * 4 + 2] =  group_index;
+    flags[index * 4 + 3] = -group_index;
 
     /* increment our index for the next descriptor */
     index++;
   }
 
+  /* agree on the state of all descriptors in a single reduction */
+  if (scr_nstoredescs > 0) {
+    MPI_Allreduce(MPI_IN_PLACE, flags, scr_nstoredescs * 4, MPI_INT, MPI_MIN, comm);
+  }
+
+  /* index of the first store built from each group, since stores
+   * on the same group have the same leaders, we split once per group
+   * and dup the communicator from that store for the others */
+  int* group_leaders = NULL;
+  if (scr_ngroupdescs > 0) {
+    group_leaders = (int*) SCR_MALLOC(scr_ngroupdescs * sizeof(int));
+  }
+  int i;
+  for (i = 0; i < scr_ngroupdescs; i++) {
+    group_leaders[i] = -1;
+  }
+
+  for (i = 0; i < scr_nstoredescs; i++) {
+    scr_storedesc* s = &scr_storedescs[i];
+
+    /* if anyone failed to build this descriptor, everyone fails */
+    int valid = flags[i * 4 + 0];
+    if (! valid) {
+      all_valid = 0;
+    }
+
+    /* if anyone has disabled this descriptor, everyone needs to */
+    if (! valid || ! flags[i * 4 + 1]) {
+      s->enabled = 0;
+      continue;
+    }
+
+    /* the group is the same on all procs if the min and max agree */
+    int group_min =  flags[i * 4 + 2];
+    int group_max = -flags[i * 4 + 3];
+    int same_group = (group_min == group_max && group_min >= 0);
+    if (same_group && group_leaders[group_min] >= 0) {
+      const scr_storedesc* first = &scr_storedescs[group_leaders[group_min]];
+      if (first->leaders != MPI_COMM_NULL) {
+        MPI_Comm_dup(first->leaders, &s->leaders);
+      }
+      continue;
+    }
+
+    /* build communicator of leaders, one per group of ranks sharing the storage */
+    int color = (s->rank == 0) ? 0 : MPI_UNDEFINED;
+    MPI_Comm_split(comm, color, scr_my_rank_world, &s->leaders);
+    if (same_group) {
+      group_leaders[group_min] = i;
+    }
+  }
+
+  scr_free(&group_leaders);
+  scr_free(&flags);
+
   /* create store descriptor for control directory */
   scr_storedesc_cntl = (scr_storedesc*) SCR_MALLOC(sizeof(scr_storedesc));
   index = scr_storedescs_index_from_name(scr_cntl_base);
@@ -47,12 +47,29 @@ typedef struct {
   int      index;     /* each descriptor is indexed starting from 0 */
   char*    name;      /* name of store */
   int      max_count; /* maximum number of datasets to be stored in device */
+  unsigned long max_bytes; /* maximum bytes of datasets to be stored in device, 0 for no limit */
+  unsigned long arena_bytes; /* bytes to reserve on device for datasets during SCR_Init, 0 for none */
   int      can_mkdir; /* flag indicating whether mkdir/rmdir work */
   char*    xfer;      /* AXL xfer type string (bbapi, sync, pthread, etc..) */
   char*    view;      /* indicates whether store is node-local or global */
+  int      direct;    /* flag indicating whether to use O_DIRECT for file I/O */
+  int      crc_threads; /* number of threads to compute crc32 of large files */
+  int      compress;  /* SCR_COMPRESS_* codec to apply to files flushed from this store */
+  int      memory;    /* flag indicating whether store is backed by memory, e.g., tmpfs */
+  int      numa;      /* NUMA node for copy and checksum buffers of files on store, -1 for none */
+  int      dedup;     /* flag indicating whether to keep identical blocks of cached files once */
+  int      cache_compress; /* SCR_COMPRESS_* codec to keep files compressed with in this store */
+  unsigned long stripe_bytes; /* bytes per stripe of flushed files, 0 for default layout */
+  int      stripe_max;  /* max number of stripes of a flushed file, 0 for no limit */
+  unsigned long stripe_size; /* stripe size of flushed files, 0 for file system default */
+  int      mdt_count;   /* number of metadata targets to spread flushed directories over */
+  unsigned long buf_size; /* bytes per buffer to copy files on store with, 0 until tuned */
+  int      mpi_buf_size;  /* bytes per buffer to send file data on store over MPI, 0 until tuned */
+  double   write_bw;      /* bytes per second measured writing to store, 0 until tuned */
   MPI_Comm comm;      /* communicator of processes that can access storage */
   int      rank;      /* local rank of process in communicator */
   int      ranks;     /* number of ranks in communicator */
+  MPI_Comm leaders;   /* communicator of rank 0 of each comm, MPI_COMM_NULL on other ranks */
 } scr_storedesc;
 
 /*
@@ -61,12 +78,18 @@ Store descriptor functions
 =========================================
 */
 
+/* returns 1 if the calling process creates directories on store */
+int scr_storedesc_dir_owner(const scr_storedesc* s);
+
 /* create specified directory on store */
 int scr_storedesc_dir_create(const scr_storedesc* s, const char* dir);
 
 /* delete specified directory on store */
 int scr_storedesc_dir_delete(const scr_storedesc* s, const char* dir);
 
+/* get number of bytes available to unprivileged users on the device of store */
+int scr_storedesc_free_bytes(const scr_storedesc* s, double* bytes);
+
 /*
 =========================================
 Routines that operate on scr_storedescs array
@@ -82,6 +105,10 @@ int scr_storedescs_index_from_name(const char* name);
  * returns -1 if not found */
 int scr_storedescs_index_from_child_path(const char* path);
 
+/* return the number of bytes per buffer to copy a file under path with,
+ * which is the tuned size of its store if it has one */
+size_t scr_storedescs_buf_size(const char* path);
+
 /* fill in scr_storedescs array from scr_storedescs_hash */
 int scr_storedescs_create(MPI_Comm comm);
 
@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+
+#include "scr_globals.h"
+
+#include <pthread.h>
+
+/* a file the application has closed */
+typedef struct scr_stream_file_struct {
+  char* file;        /* name of file */
+  int   done;        /* whether the thread has checked the file */
+  int   valid;       /* whether file could be read and stat'd */
+  struct stat stat_buf; /* stat data of file */
+  int   type;        /* checksum type, -1 if none was computed */
+  uint64_t value;    /* checksum value */
+  char* dest;        /* where to copy file to, NULL if not written through */
+  int   through;     /* whether file was copied to dest */
+  struct scr_stream_file_struct* next; /* next file in list */
+} scr_stream_file;
+
+static pthread_t       scr_stream_thread;
+static pthread_mutex_t scr_stream_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  scr_stream_cond = PTHREAD_COND_INITIALIZER;
+static int             scr_stream_started = 0; /* whether thread is running */
+static int             scr_stream_stop    = 0; /* tells thread to exit */
+static int             scr_stream_pending = 0; /* number of files not yet checked */
+static scr_stream_file* scr_stream_head = NULL; /* list of files, newest first */
+
+/* check a single file, runs without the lock held */
+static void scr_stream_check(scr_stream_file* f)
+{
+  f->valid = 0;
+  f->type  = -1;
+  if (scr_file_is_readable(f->file) != SCR_SUCCESS ||
+      stat(f->file, &f->stat_buf) != 0)
+  {
+    return;
+  }
+  f->valid = 1;
+
+  /* while the data is likely still in the page cache */
+  if (scr_crc_on_copy && S_ISREG(f->stat_buf.st_mode)) {
+    if (scr_cache_checksum_file(f->file, scr_checksum_type, &f->value) == SCR_SUCCESS) {
+      f->type = scr_checksum_type;
+    }
+  }
+
+  /* write the file through to the prefix directory, the destination
+   * may be a hard link into an earlier flush, so never write into it */
+  f->through = 0;
+  if (f->dest != NULL && S_ISREG(f->stat_buf.st_mode)) {
+    spath* path = spath_from_str(f->dest);
+    spath_dirname(path);
+    char* dir = spath_strdup(path);
+    spath_delete(&path);
+
+    mode_t mode_dir = scr_getmode(1, 1, 1);
+    if (scr_mkdir(dir, mode_dir) == SCR_SUCCESS) {
+      unlink(f->dest);
+      if (scr_file_copy(f->file, f->dest, scr_storedescs_buf_size(f->file), NULL) == SCR_SUCCESS) {
+        f->through = 1;
+      } else {
+        scr_dbg(1, "Failed to write %s through to %s, it will be copied on flush @ %s:%d",
+          f->file, f->dest, __FILE__, __LINE__
+        );
+      }
+    }
+    scr_free(&dir);
+  }
+}
+
+/* check files as they are queued until told to stop */
+static void* scr_stream_run(void* arg)
+{
+  pthread_mutex_lock(&scr_stream_lock);
+  while (1) {
+    /* find the oldest file we have not checked */
+    scr_stream_file* f = NULL;
+    scr_stream_file* cur;
+    for (cur = scr_stream_head; cur != NULL; cur = cur->next) {
+      if (! cur->done) {
+        f = cur;
+      }
+    }
+
+    if (f == NULL) {
+      if (scr_stream_stop) {
+        break;
+      }
+      pthread_cond_wait(&scr_stream_cond, &scr_stream_lock);
+      continue;
+    }
+
+    /* entries are not freed while any are pending, so we can drop the lock */
+    pthread_mutex_unlock(&scr_stream_lock);
+    scr_stream_check(f);
+    pthread_mutex_lock(&scr_stream_lock);
+
+    f->done = 1;
+    scr_stream_pending--;
+    pthread_cond_broadcast(&scr_stream_cond);
+  }
+  pthread_mutex_unlock(&scr_stream_lock);
+  return NULL;
+}
+
+/* queue file to be checked by the background thread, and if dest is
+ * not NULL, to be copied to dest after it is checked */
+int scr_stream_add(const char* file, const char* dest)
+{
+  if (file == NULL) {
+    return SCR_FAILURE;
+  }
+
+  scr_stream_file* f = (scr_stream_file*) SCR_MALLOC(sizeof(scr_stream_file));
+  f->file  = strdup(file);
+  f->done  = 0;
+  f->valid = 0;
+  f->type  = -1;
+  f->value = 0;
+  f->dest  = (dest != NULL) ? strdup(dest) : NULL;
+  f->through = 0;
+
+  pthread_mutex_lock(&scr_stream_lock);
+
+  /* start the thread with the first file */
+  if (! scr_stream_started) {
+    scr_stream_stop = 0;
+    if (pthread_create(&scr_stream_thread, NULL, scr_stream_run, NULL) != 0) {
+      pthread_mutex_unlock(&scr_stream_lock);
+      scr_err("Failed to start thread to check closed files @ %s:%d",
+        __FILE__, __LINE__
+      );
+      scr_free(&f->file);
+      scr_free(&f->dest);
+      scr_free(&f);
+      return SCR_FAILURE;
+    }
+    scr_stream_started = 1;
+  }
+
+  f->next = scr_stream_head;
+  scr_stream_head = f;
+  scr_stream_pending++;
+  pthread_cond_broadcast(&scr_stream_cond);
+
+  pthread_mutex_unlock(&scr_stream_lock);
+  return SCR_SUCCESS;
+}
+
+/* wait until the background thread has checked every queued file */
+int scr_stream_wait(void)
+{
+  pthread_mutex_lock(&scr_stream_lock);
+  while (scr_stream_pending > 0) {
+    pthread_cond_wait(&scr_stream_cond, &scr_stream_lock);
+  }
+  pthread_mutex_unlock(&scr_stream_lock);
+  return SCR_SUCCESS;
+}
+
+/* after scr_stream_wait, get stat data of file and its checksum if one
+ * was computed, sets type to -1 if not, returns SCR_FAILURE if file was
+ * not queued or could not be read */
+int scr_stream_get(const char* file, struct stat* stat_buf, int* type, uint64_t* value)
+{
+  int rc = SCR_FAILURE;
+  pthread_mutex_lock(&scr_stream_lock);
+  scr_stream_file* f;
+  for (f = scr_stream_head; f != NULL; f = f->next) {
+    /* the newest entry wins if a file was closed more than once */
+    if (f->done && strcmp(f->file, file) == 0) {
+      if (f->valid) {
+        *stat_buf = f->stat_buf;
+        *type     = f->type;
+        *value    = f->value;
+        rc = SCR_SUCCESS;
+      }
+      break;
+    }
+  }
+  pthread_mutex_unlock(&scr_stream_lock);
+  return rc;
+}
+
+/* after scr_stream_wait, returns 1 if the background thread copied
+ * file to dest after the last time file was queued, 0 otherwise */
+int scr_stream_through(const char* file, const char* dest)
+{
+  int through = 0;
+  pthread_mutex_lock(&scr_stream_lock);
+  scr_stream_file* f;
+  for (f = scr_stream_head; f != NULL; f = f->next) {
+    if (f->done && strcmp(f->file, file) == 0) {
+      through = (f->through && strcmp(f->dest, dest) == 0);
+      break;
+    }
+  }
+  pthread_mutex_unlock(&scr_stream_lock);
+  return through;
+}
+
+/* forget all checked files */
+void scr_stream_clear(void)
+{
+  scr_stream_wait();
+
+  pthread_mutex_lock(&scr_stream_lock);
+  scr_stream_file* f = scr_stream_head;
+  while (f != NULL) {
+    scr_stream_file* next = f->next;
+    scr_free(&f->file);
+    scr_free(&f->dest);
+    scr_free(&f);
+    f = next;
+  }
+  scr_stream_head = NULL;
+  pthread_mutex_unlock(&scr_stream_lock);
+}
+
+/* stop the background thread and forget all checked files */
+void scr_stream_finalize(void)
+{
+  scr_stream_clear();
+
+  pthread_mutex_lock(&scr_stream_lock);
+  int started = scr_stream_started;
+  scr_stream_stop = 1;
+  pthread_cond_broadcast(&scr_stream_cond);
+  pthread_mutex_unlock(&scr_stream_lock);
+
+  if (started) {
+    pthread_join(scr_stream_thread, NULL);
+    scr_stream_started = 0;
+  }
+}
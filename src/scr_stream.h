@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+
+#ifndef SCR_STREAM_H
+#define SCR_STREAM_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/*
+=========================================
+This file does the per-file work that precedes redundancy encoding as
+soon as the application reports that it has closed a file with
+SCR_Complete_file, rather than in one pass over all files once the
+output is complete.  A background thread checks that each file can be
+read, stats it, and computes its checksum when SCR_CRC_ON_COPY is set,
+while the application goes on to write its remaining files.  With
+SCR_FLUSH_THROUGH, the thread also copies files of output datasets to
+their place in the prefix directory, so the flush that follows only
+has to copy what was not written through.  The results are picked up
+when the output is completed.
+=========================================
+*/
+
+/* queue file to be checked by the background thread, and if dest is
+ * not NULL, to be copied to dest after it is checked */
+int scr_stream_add(const char* file, const char* dest);
+
+/* wait until the background thread has checked every queued file */
+int scr_stream_wait(void);
+
+/* after scr_stream_wait, get stat data of file and its checksum if one
+ * was computed, sets type to -1 if not, returns SCR_FAILURE if file was
+ * not queued or could not be read */
+int scr_stream_get(const char* file, struct stat* stat_buf, int* type, uint64_t* value);
+
+/* after scr_stream_wait, returns 1 if the background thread copied
+ * file to dest after the last time file was queued, 0 otherwise */
+int scr_stream_through(const char* file, const char* dest);
+
+/* forget all checked files */
+void scr_stream_clear(void);
+
+/* stop the background thread and forget all checked files */
+void scr_stream_finalize(void);
+
+#endif
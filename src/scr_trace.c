@@ -0,0 +1,538 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+
+#include "scr_globals.h"
+
+/* deepest nesting of phases we track */
+#define SCR_TRACE_DEPTH (8)
+
+/* most timeline events we keep for each thread, later events are dropped */
+#define SCR_TRACE_EVENTS (8192)
+
+/* tag used to send timeline events to rank 0 */
+#define SCR_TRACE_TAG (7272)
+
+/* total time spent in each phase, named by its path, e.g., "init/fetch" */
+typedef struct {
+  char*  path;  /* strdup'd path of phase */
+  double secs;  /* total seconds spent in phase */
+  int    count; /* number of times phase was entered */
+} scr_trace_phase;
+
+/* phase we are in, along with the time we entered it */
+typedef struct {
+  char*       path;
+  const char* name;   /* name of phase, used for its timeline event */
+  double      start;
+  int         marked; /* whether we added a begin event to the timeline */
+} scr_trace_frame;
+
+/* begin or end of a span on the timeline */
+typedef struct {
+  const char* name; /* name of span, must outlive the timeline */
+  double time;      /* MPI_Wtime of event */
+  char   phase;     /* 'B' for begin, 'E' for end */
+} scr_trace_event;
+
+/* timeline events of a single thread, only the owning thread appends
+ * events, so recording an event takes no lock */
+typedef struct scr_trace_buf {
+  int tid;     /* id of thread within this process */
+  int count;   /* number of events recorded */
+  int dropped; /* number of events dropped because buffer was full */
+  scr_trace_event events[SCR_TRACE_EVENTS];
+  struct scr_trace_buf* next; /* next buffer in list of all threads */
+} scr_trace_buf;
+
+static scr_trace_phase* scr_trace_phases = NULL;
+static int scr_trace_nphases = 0;
+static int scr_trace_maxphases = 0;
+
+static scr_trace_frame scr_trace_stack[SCR_TRACE_DEPTH];
+static int scr_trace_depth = 0;
+
+/* phases nested deeper than we track are counted so that
+ * begin and end calls still pair up */
+static int scr_trace_overflow = 0;
+
+/* buffer of the calling thread, and list of buffers of all threads,
+ * buffers are added to the list with compare-and-swap */
+static __thread scr_trace_buf* scr_trace_mybuf = NULL;
+static scr_trace_buf* volatile scr_trace_bufs = NULL;
+static int scr_trace_ntids = 0;
+
+/* set once the timeline has a base time that is aligned across ranks */
+static volatile int scr_trace_timeline_started = 0;
+static double scr_trace_timeline_base = 0.0;
+
+/* return index of phase with given path, adding it if needed */
+static int scr_trace_phase_index(const char* path)
+{
+  int i;
+  for (i = 0; i < scr_trace_nphases; i++) {
+    if (strcmp(scr_trace_phases[i].path, path) == 0) {
+      return i;
+    }
+  }
+
+  /* grow our list of phases if needed */
+  if (scr_trace_nphases == scr_trace_maxphases) {
+    int count = (scr_trace_maxphases > 0) ? scr_trace_maxphases * 2 : 16;
+    scr_trace_phase* phases = (scr_trace_phase*) SCR_MALLOC(count * sizeof(scr_trace_phase));
+    if (scr_trace_nphases > 0) {
+      memcpy(phases, scr_trace_phases, scr_trace_nphases * sizeof(scr_trace_phase));
+    }
+    scr_free(&scr_trace_phases);
+    scr_trace_phases = phases;
+    scr_trace_maxphases = count;
+  }
+
+  scr_trace_phase* p = &scr_trace_phases[scr_trace_nphases];
+  p->path  = strdup(path);
+  p->secs  = 0.0;
+  p->count = 0;
+  return scr_trace_nphases++;
+}
+
+/* forget all recorded phases */
+static void scr_trace_clear(void)
+{
+  int i;
+  for (i = 0; i < scr_trace_nphases; i++) {
+    scr_free(&scr_trace_phases[i].path);
+  }
+  scr_free(&scr_trace_phases);
+  scr_trace_nphases = 0;
+  scr_trace_maxphases = 0;
+}
+
+/* add an event to the timeline buffer of the calling thread */
+static void scr_trace_mark(const char* name, char phase)
+{
+  scr_trace_buf* b = scr_trace_mybuf;
+  if (b == NULL) {
+    /* first event from this thread, allocate a buffer and add it
+     * to the list without blocking other threads */
+    b = (scr_trace_buf*) SCR_MALLOC(sizeof(scr_trace_buf));
+    b->tid     = __sync_fetch_and_add(&scr_trace_ntids, 1);
+    b->count   = 0;
+    b->dropped = 0;
+    do {
+      b->next = scr_trace_bufs;
+    } while (! __sync_bool_compare_and_swap(&scr_trace_bufs, b->next, b));
+    scr_trace_mybuf = b;
+  }
+
+  if (b->count == SCR_TRACE_EVENTS) {
+    b->dropped++;
+    return;
+  }
+
+  scr_trace_event* e = &b->events[b->count];
+  e->name  = name;
+  e->time  = MPI_Wtime();
+  e->phase = phase;
+  b->count++;
+}
+
+/* start a span of given name on the timeline of the calling thread,
+ * name must be a string literal */
+void scr_trace_mark_begin(const char* name)
+{
+  if (scr_trace_timeline_started) {
+    scr_trace_mark(name, 'B');
+  }
+}
+
+/* end the span of given name on the timeline of the calling thread */
+void scr_trace_mark_end(const char* name)
+{
+  if (scr_trace_timeline_started) {
+    scr_trace_mark(name, 'E');
+  }
+}
+
+/* enter phase of given name, nested within the current phase */
+void scr_trace_begin(const char* name)
+{
+  if (scr_trace_depth >= SCR_TRACE_DEPTH) {
+    scr_trace_overflow++;
+    return;
+  }
+
+  /* build the path of this phase from the path of its parent */
+  char* path;
+  if (scr_trace_depth > 0) {
+    const char* parent = scr_trace_stack[scr_trace_depth - 1].path;
+    path = (char*) SCR_MALLOC(strlen(parent) + 1 + strlen(name) + 1);
+    sprintf(path, "%s/%s", parent, name);
+  } else {
+    path = strdup(name);
+  }
+
+  scr_trace_frame* f = &scr_trace_stack[scr_trace_depth];
+  f->path   = path;
+  f->name   = name;
+  f->start  = MPI_Wtime();
+  f->marked = scr_trace_timeline_started;
+  scr_trace_depth++;
+
+  if (f->marked) {
+    scr_trace_mark(name, 'B');
+  }
+}
+
+/* leave the current phase, adding its time to the total of its path */
+void scr_trace_end(void)
+{
+  if (scr_trace_overflow > 0) {
+    scr_trace_overflow--;
+    return;
+  }
+  if (scr_trace_depth == 0) {
+    scr_dbg(1, "Ended a phase that was never started @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return;
+  }
+
+  scr_trace_depth--;
+  scr_trace_frame* f = &scr_trace_stack[scr_trace_depth];
+  double secs = MPI_Wtime() - f->start;
+
+  /* a phase started before the timeline only ends on the timeline
+   * if it began there too */
+  if (f->marked && scr_trace_timeline_started) {
+    scr_trace_mark(f->name, 'E');
+  }
+
+  int index = scr_trace_phase_index(f->path);
+  scr_trace_phases[index].secs += secs;
+  scr_trace_phases[index].count++;
+
+  scr_free(&f->path);
+}
+
+/* write times of each phase to a JSON file */
+static int scr_trace_write(
+  const char* file,
+  const char* label,
+  int ranks,
+  kvtree* names,
+  int count,
+  const double* mins,
+  const double* maxs,
+  const double* sums)
+{
+  FILE* fp = fopen(file, "w");
+  if (fp == NULL) {
+    scr_err("Failed to open trace file %s: %s @ %s:%d",
+      file, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  fprintf(fp, "{\n");
+  fprintf(fp, "  \"version\": \"%s\",\n", SCR_VERSION);
+  fprintf(fp, "  \"jobid\": \"%s\",\n", (scr_jobid != NULL) ? scr_jobid : "");
+  fprintf(fp, "  \"label\": \"%s\",\n", label);
+  fprintf(fp, "  \"ranks\": %d,\n", ranks);
+  fprintf(fp, "  \"phases\": [");
+  int i;
+  for (i = 0; i < count; i++) {
+    char* path;
+    kvtree_util_get_str(kvtree_get_kv_int(names, "PHASE", i), "PATH", &path);
+    fprintf(fp, "%s\n    {\"path\": \"%s\", \"min\": %f, \"max\": %f, \"avg\": %f}",
+      (i > 0) ? "," : "", path, mins[i], maxs[i], sums[i] / (double) ranks
+    );
+  }
+  fprintf(fp, "\n  ]\n");
+  fprintf(fp, "}\n");
+
+  if (fclose(fp) != 0) {
+    scr_err("Failed to close trace file %s: %s @ %s:%d",
+      file, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  return SCR_SUCCESS;
+}
+
+/* reduce the time of each recorded phase across comm and report the
+ * min, max, and average on rank 0 under the given label, then forget
+ * the recorded phases, this is collective */
+int scr_trace_report(const char* label, MPI_Comm comm)
+{
+  int rc = SCR_SUCCESS;
+
+  /* nothing to do unless someone will see the report */
+  if (! scr_trace && scr_debug < 1) {
+    scr_trace_clear();
+    return rc;
+  }
+
+  int rank, ranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+
+  /* rank 0 decides which phases to report and in which order */
+  kvtree* names = kvtree_new();
+  if (rank == 0) {
+    int i;
+    for (i = 0; i < scr_trace_nphases; i++) {
+      kvtree* phase = kvtree_set_kv_int(names, "PHASE", i);
+      kvtree_util_set_str(phase, "PATH", scr_trace_phases[i].path);
+    }
+    kvtree_util_set_int(names, "COUNT", scr_trace_nphases);
+  }
+  kvtree_bcast(names, 0, comm);
+
+  int count = 0;
+  kvtree_util_get_int(names, "COUNT", &count);
+
+  /* look up our time in each phase, zero if we never entered it */
+  double* secs = NULL;
+  double* mins = NULL;
+  double* maxs = NULL;
+  double* sums = NULL;
+  if (count > 0) {
+    secs = (double*) SCR_MALLOC(count * sizeof(double));
+    mins = (double*) SCR_MALLOC(count * sizeof(double));
+    maxs = (double*) SCR_MALLOC(count * sizeof(double));
+    sums = (double*) SCR_MALLOC(count * sizeof(double));
+  }
+  int i;
+  for (i = 0; i < count; i++) {
+    char* path;
+    kvtree_util_get_str(kvtree_get_kv_int(names, "PHASE", i), "PATH", &path);
+    secs[i] = 0.0;
+    int j;
+    for (j = 0; j < scr_trace_nphases; j++) {
+      if (strcmp(scr_trace_phases[j].path, path) == 0) {
+        secs[i] = scr_trace_phases[j].secs;
+        break;
+      }
+    }
+  }
+
+  if (count > 0) {
+    MPI_Reduce(secs, mins, count, MPI_DOUBLE, MPI_MIN, 0, comm);
+    MPI_Reduce(secs, maxs, count, MPI_DOUBLE, MPI_MAX, 0, comm);
+    MPI_Reduce(secs, sums, count, MPI_DOUBLE, MPI_SUM, 0, comm);
+  }
+
+  if (rank == 0 && count > 0) {
+    for (i = 0; i < count; i++) {
+      char* path;
+      kvtree_util_get_str(kvtree_get_kv_int(names, "PHASE", i), "PATH", &path);
+      double avg = sums[i] / (double) ranks;
+      scr_dbg(1, "Phase %s: min %f secs, max %f secs, avg %f secs",
+        path, mins[i], maxs[i], avg
+      );
+
+      /* record the slowest rank in the log to track overhead over time */
+      if (scr_trace && scr_log_enable) {
+        scr_log_event("TRACE", path, NULL, label, NULL, &maxs[i]);
+      }
+    }
+
+    /* write everything to a file for this job in the prefix directory */
+    if (scr_trace && scr_prefix_scr != NULL) {
+      char file[SCR_MAX_FILENAME];
+      snprintf(file, sizeof(file), "%s/trace.%s.%s.json",
+        scr_prefix_scr, (scr_jobid != NULL) ? scr_jobid : "0", label
+      );
+      rc = scr_trace_write(file, label, ranks, names, count, mins, maxs, sums);
+    }
+  }
+
+  scr_free(&sums);
+  scr_free(&maxs);
+  scr_free(&mins);
+  scr_free(&secs);
+  kvtree_delete(&names);
+
+  scr_trace_clear();
+
+  return rc;
+}
+
+/* start recording timeline events if SCR_TRACE_TIMELINE is set,
+ * the barrier gives all ranks a common base time, this is collective */
+void scr_trace_timeline_init(MPI_Comm comm)
+{
+  if (! scr_trace_timeline) {
+    return;
+  }
+
+  MPI_Barrier(comm);
+  scr_trace_timeline_base = MPI_Wtime();
+  scr_trace_timeline_started = 1;
+}
+
+/* serialize events of all threads of this process as Chrome trace
+ * records, times are shifted to the base time and scaled by scale so
+ * that clocks of all ranks line up, caller frees returned string */
+static char* scr_trace_timeline_pack(int rank, double scale, int* len)
+{
+  /* compute an upper bound on the length of our records */
+  size_t size = 256 + strlen(scr_my_hostname);
+  scr_trace_buf* b;
+  for (b = scr_trace_bufs; b != NULL; b = b->next) {
+    size += 128;
+    int i;
+    for (i = 0; i < b->count; i++) {
+      size += 128 + strlen(b->events[i].name);
+    }
+  }
+
+  char* str = (char*) SCR_MALLOC(size);
+  size_t off = 0;
+
+  /* name the process after its rank and host, rank 0 writes the first
+   * record of the file, so it has no leading comma */
+  off += snprintf(str + off, size - off,
+    "%s\n{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": 0, "
+    "\"args\": {\"name\": \"rank %d (%s)\"}}",
+    (rank > 0) ? "," : "", rank, rank, scr_my_hostname
+  );
+
+  int dropped = 0;
+  for (b = scr_trace_bufs; b != NULL; b = b->next) {
+    off += snprintf(str + off, size - off,
+      ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, "
+      "\"args\": {\"name\": \"%s\"}}",
+      rank, b->tid, (b->tid == 0) ? "main" : "helper"
+    );
+
+    int i;
+    for (i = 0; i < b->count; i++) {
+      scr_trace_event* e = &b->events[i];
+      double usecs = (e->time - scr_trace_timeline_base) * scale * 1000000.0;
+      off += snprintf(str + off, size - off,
+        ",\n{\"name\": \"%s\", \"ph\": \"%c\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f}",
+        e->name, e->phase, rank, b->tid, usecs
+      );
+    }
+    dropped += b->dropped;
+  }
+
+  if (dropped > 0) {
+    scr_dbg(1, "Dropped %d timeline events from full buffers @ %s:%d",
+      dropped, __FILE__, __LINE__
+    );
+  }
+
+  *len = (int) off;
+  return str;
+}
+
+/* free the timeline buffers of all threads, other threads must have
+ * exited before this is called */
+static void scr_trace_timeline_clear(void)
+{
+  scr_trace_buf* b = scr_trace_bufs;
+  while (b != NULL) {
+    scr_trace_buf* next = b->next;
+    scr_free(&b);
+    b = next;
+  }
+  scr_trace_bufs  = NULL;
+  scr_trace_mybuf = NULL;
+  scr_trace_ntids = 0;
+}
+
+/* stop recording timeline events and write the events of all ranks
+ * to a Chrome trace file for the job in the .scr directory of the
+ * prefix, helper threads must have exited, this is collective */
+int scr_trace_timeline_write(MPI_Comm comm)
+{
+  int rc = SCR_SUCCESS;
+
+  if (! scr_trace_timeline_started) {
+    return rc;
+  }
+  scr_trace_timeline_started = 0;
+
+  int rank, ranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+
+  /* leave the timeline together, and stretch our span between the two
+   * barriers to match that of rank 0 to correct for clock drift */
+  MPI_Barrier(comm);
+  double span = MPI_Wtime() - scr_trace_timeline_base;
+  double span0 = span;
+  MPI_Bcast(&span0, 1, MPI_DOUBLE, 0, comm);
+  double scale = (span > 0.0) ? span0 / span : 1.0;
+
+  int len;
+  char* str = scr_trace_timeline_pack(rank, scale, &len);
+
+  if (rank == 0) {
+    FILE* fp = NULL;
+    char file[SCR_MAX_FILENAME];
+    if (scr_prefix_scr != NULL) {
+      snprintf(file, sizeof(file), "%s/timeline.%s.json",
+        scr_prefix_scr, (scr_jobid != NULL) ? scr_jobid : "0"
+      );
+      fp = fopen(file, "w");
+      if (fp == NULL) {
+        scr_err("Failed to open timeline file %s: %s @ %s:%d",
+          file, strerror(errno), __FILE__, __LINE__
+        );
+        rc = SCR_FAILURE;
+      }
+    }
+
+    if (fp != NULL) {
+      fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+      fwrite(str, 1, (size_t) len, fp);
+    }
+
+    /* receive records of each other rank, one at a time, so we only
+     * hold those of a single rank in memory */
+    int i;
+    for (i = 1; i < ranks; i++) {
+      MPI_Status status;
+      MPI_Probe(MPI_ANY_SOURCE, SCR_TRACE_TAG, comm, &status);
+
+      int count;
+      MPI_Get_count(&status, MPI_CHAR, &count);
+      char* buf = (char*) SCR_MALLOC(count > 0 ? count : 1);
+      MPI_Recv(buf, count, MPI_CHAR, status.MPI_SOURCE, SCR_TRACE_TAG, comm, MPI_STATUS_IGNORE);
+      if (fp != NULL) {
+        fwrite(buf, 1, (size_t) count, fp);
+      }
+      scr_free(&buf);
+    }
+
+    if (fp != NULL) {
+      fprintf(fp, "\n]}\n");
+      if (fclose(fp) != 0) {
+        scr_err("Failed to close timeline file %s: %s @ %s:%d",
+          file, strerror(errno), __FILE__, __LINE__
+        );
+        rc = SCR_FAILURE;
+      }
+    }
+  } else {
+    MPI_Send(str, len, MPI_CHAR, 0, SCR_TRACE_TAG, comm);
+  }
+
+  scr_free(&str);
+  scr_trace_timeline_clear();
+
+  MPI_Bcast(&rc, 1, MPI_INT, 0, comm);
+  return rc;
+}
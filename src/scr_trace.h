@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+
+#ifndef SCR_TRACE_H
+#define SCR_TRACE_H
+
+#include "mpi.h"
+
+/*
+=========================================
+This file times named phases of the library, such as the steps of
+SCR_Init and SCR_Finalize.  Phases nest, and each is recorded under
+its path, e.g., "init/fetch", with the total time spent in it on each
+process.  A report reduces the time of each phase across processes,
+prints the min, max, and average at debug level 1, and with SCR_TRACE
+set, logs each phase and writes a JSON file for the job to the .scr
+directory in the prefix so that overhead can be compared across runs.
+
+With SCR_TRACE_TIMELINE set, each thread also records the begin and
+end of phases and of other marked spans, such as flushes and deletes,
+into a buffer of its own without taking a lock.  At finalize, the
+events of all ranks are written to a single file in the Chrome trace
+event format, which can be opened in chrome://tracing or Perfetto.
+Times are taken relative to a barrier in SCR_Init and stretched to line
+up with rank 0 at a barrier in SCR_Finalize to correct for clock drift.
+=========================================
+*/
+
+/* enter phase of given name, nested within the current phase */
+void scr_trace_begin(const char* name);
+
+/* leave the current phase, adding its time to the total of its path */
+void scr_trace_end(void);
+
+/* reduce the time of each recorded phase across comm and report the
+ * min, max, and average on rank 0 under the given label, then forget
+ * the recorded phases, this is collective */
+int scr_trace_report(const char* label, MPI_Comm comm);
+
+/* start a span of given name on the timeline of the calling thread,
+ * name must be a string literal */
+void scr_trace_mark_begin(const char* name);
+
+/* end the span of given name on the timeline of the calling thread */
+void scr_trace_mark_end(const char* name);
+
+/* start recording timeline events if SCR_TRACE_TIMELINE is set,
+ * the barrier gives all ranks a common base time, this is collective */
+void scr_trace_timeline_init(MPI_Comm comm);
+
+/* stop recording timeline events and write the events of all ranks
+ * to a Chrome trace file for the job in the .scr directory of the
+ * prefix, helper threads must have exited, this is collective */
+int scr_trace_timeline_write(MPI_Comm comm);
+
+#endif
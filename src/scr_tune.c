@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#include "scr_globals.h"
+#include "scr_tune.h"
+
+#include <sys/vfs.h>
+#include <sys/sysmacros.h>
+
+/* keys of the file that records the sizes picked for a signature */
+#define SCR_TUNE_KEY_BUF     ("BUF")
+#define SCR_TUNE_KEY_MPI_BUF ("MPIBUF")
+#define SCR_TUNE_KEY_WRITE_BW ("WRITEBW")
+
+/* buffer sizes we try, the MPI buffer is limited to the smaller ones
+ * since larger messages only cost memory on each side */
+static const unsigned long scr_tune_sizes[] = {
+  64*1024, 256*1024, 1024*1024, 4*1024*1024, 16*1024*1024
+};
+#define SCR_TUNE_NSIZES (sizeof(scr_tune_sizes) / sizeof(scr_tune_sizes[0]))
+#define SCR_TUNE_MPI_MAX (4*1024*1024)
+
+/* a size counts as good as the best one if its rate is within this fraction */
+#define SCR_TUNE_SLACK (0.05)
+
+/* build a name that identifies the file system and device behind dir,
+ * returns a newly allocated string or NULL if dir cannot be checked */
+static char* scr_tune_signature(const char* dir)
+{
+  struct stat st;
+  struct statfs fs;
+  if (stat(dir, &st) != 0 || statfs(dir, &fs) != 0) {
+    return NULL;
+  }
+  return scr_strdupf("tune_%lx_%u_%u_%lu.scrinfo",
+    (unsigned long) fs.f_type, major(st.st_dev), minor(st.st_dev), (unsigned long) fs.f_bsize
+  );
+}
+
+/* write bytes to file in chunks of size, read them back the same way,
+ * and return the write and read rates in bytes per second */
+static int scr_tune_probe(
+  const char* file,
+  char* buf,
+  unsigned long size,
+  unsigned long bytes,
+  double* write_rate,
+  double* read_rate)
+{
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int fd = scr_open(file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (fd < 0) {
+    return SCR_FAILURE;
+  }
+
+  int rc = SCR_SUCCESS;
+  double start = MPI_Wtime();
+  unsigned long done = 0;
+  while (done < bytes && rc == SCR_SUCCESS) {
+    if (scr_write(file, fd, buf, (size_t) size) != (ssize_t) size) {
+      rc = SCR_FAILURE;
+    }
+    done += size;
+  }
+  if (rc == SCR_SUCCESS && fsync(fd) != 0) {
+    rc = SCR_FAILURE;
+  }
+  double mid = MPI_Wtime();
+
+  /* drop the pages so the read measures the device, not memory */
+#ifdef POSIX_FADV_DONTNEED
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+  scr_close(file, fd);
+
+  if (rc == SCR_SUCCESS) {
+    fd = scr_open(file, O_RDONLY);
+    if (fd >= 0) {
+      mid = MPI_Wtime();
+      done = 0;
+      while (done < bytes && rc == SCR_SUCCESS) {
+        if (scr_read(file, fd, buf, (size_t) size) != (ssize_t) size) {
+          rc = SCR_FAILURE;
+        }
+        done += size;
+      }
+      scr_close(file, fd);
+    } else {
+      rc = SCR_FAILURE;
+    }
+  }
+  double end = MPI_Wtime();
+
+  scr_file_unlink(file);
+
+  if (rc == SCR_SUCCESS) {
+    *write_rate = (double) bytes / (mid - start + 1.0e-9);
+    *read_rate  = (double) bytes / (end - mid   + 1.0e-9);
+  }
+  return rc;
+}
+
+/* return index of the smallest size whose rate is close to the best */
+static int scr_tune_pick(const double* rates, int count)
+{
+  double best = 0.0;
+  int i;
+  for (i = 0; i < count; i++) {
+    if (rates[i] > best) {
+      best = rates[i];
+    }
+  }
+  for (i = 0; i < count; i++) {
+    if (rates[i] >= best * (1.0 - SCR_TUNE_SLACK)) {
+      return i;
+    }
+  }
+  return count - 1;
+}
+
+/* run the probe in dir, sets buf_size and mpi_buf_size to 0 on failure,
+ * and write_bw to the write rate in bytes per second at buf_size */
+static void scr_tune_measure(const char* dir, unsigned long* buf_size, int* mpi_buf_size, unsigned long* write_bw)
+{
+  *buf_size     = 0;
+  *mpi_buf_size = 0;
+  *write_bw     = 0;
+
+  char* buf = (char*) scr_align_malloc(scr_tune_sizes[SCR_TUNE_NSIZES - 1], scr_page_size);
+  if (buf == NULL) {
+    return;
+  }
+  memset(buf, 0, scr_tune_sizes[SCR_TUNE_NSIZES - 1]);
+
+  char* file = scr_strdupf("%s/.scr_tune.%d", dir, scr_my_rank_world);
+
+  /* copies read from one store and write to another, so they go
+   * at the slower of the two rates, MPI buffers are only read */
+  double copy_rates[SCR_TUNE_NSIZES];
+  double read_rates[SCR_TUNE_NSIZES];
+  double write_rates[SCR_TUNE_NSIZES];
+  int nmpi = 0;
+  int i;
+  for (i = 0; i < (int) SCR_TUNE_NSIZES; i++) {
+    /* use at least a few buffers worth of data for the largest sizes */
+    unsigned long size  = scr_tune_sizes[i];
+    unsigned long bytes = (scr_buf_tune_bytes > 4 * size) ? scr_buf_tune_bytes / size * size : 4 * size;
+    double write_rate, read_rate;
+    if (scr_tune_probe(file, buf, size, bytes, &write_rate, &read_rate) != SCR_SUCCESS) {
+      scr_dbg(1, "Failed to probe buffer sizes in %s @ %s:%d", dir, __FILE__, __LINE__);
+      scr_free(&file);
+      scr_align_free(&buf);
+      return;
+    }
+    copy_rates[i] = (write_rate < read_rate) ? write_rate : read_rate;
+    read_rates[i] = read_rate;
+    write_rates[i] = write_rate;
+    if (size <= SCR_TUNE_MPI_MAX) {
+      nmpi = i + 1;
+    }
+    scr_dbg(2, "Buffer size %lu in %s: write %f MB/s, read %f MB/s",
+      size, dir, write_rate / (1024.0 * 1024.0), read_rate / (1024.0 * 1024.0)
+    );
+  }
+
+  int pick = scr_tune_pick(copy_rates, SCR_TUNE_NSIZES);
+  *buf_size     = scr_tune_sizes[pick];
+  *mpi_buf_size = (int) scr_tune_sizes[scr_tune_pick(read_rates, nmpi)];
+  *write_bw     = (unsigned long) write_rates[pick];
+
+  scr_free(&file);
+  scr_align_free(&buf);
+}
+
+int scr_tune_store(scr_storedesc* store, const char* dir)
+{
+  /* nothing to do if not asked or if we already tuned this store */
+  if (! scr_buf_tune || store == NULL || store->buf_size > 0) {
+    return SCR_SUCCESS;
+  }
+
+  /* rank 0 of the store looks for earlier results on the same kind of
+   * device in the control directory before it runs the probe */
+  unsigned long sizes[3] = {0, 0, 0};
+  if (store->rank == 0) {
+    char* sig = scr_tune_signature(dir);
+    char* sig_file = NULL;
+    if (sig != NULL) {
+      sig_file = scr_strdupf("%s/%s", scr_cntl_prefix, sig);
+    }
+
+    int found = 0;
+    kvtree* hash = kvtree_new();
+    if (sig_file != NULL && access(sig_file, R_OK) == 0 &&
+        kvtree_read_file(sig_file, hash) == KVTREE_SUCCESS &&
+        kvtree_util_get_unsigned_long(hash, SCR_TUNE_KEY_BUF,     &sizes[0]) == KVTREE_SUCCESS &&
+        kvtree_util_get_unsigned_long(hash, SCR_TUNE_KEY_MPI_BUF, &sizes[1]) == KVTREE_SUCCESS)
+    {
+      /* files from before we recorded bandwidth just lack it */
+      kvtree_util_get_unsigned_long(hash, SCR_TUNE_KEY_WRITE_BW, &sizes[2]);
+      found = 1;
+    }
+
+    if (! found) {
+      int mpi_size;
+      scr_tune_measure(dir, &sizes[0], &mpi_size, &sizes[2]);
+      sizes[1] = (unsigned long) mpi_size;
+
+      /* save what we found for later runs */
+      if (sig_file != NULL && sizes[0] > 0) {
+        kvtree_util_set_unsigned_long(hash, SCR_TUNE_KEY_BUF,      sizes[0]);
+        kvtree_util_set_unsigned_long(hash, SCR_TUNE_KEY_MPI_BUF,  sizes[1]);
+        kvtree_util_set_unsigned_long(hash, SCR_TUNE_KEY_WRITE_BW, sizes[2]);
+        kvtree_write_file(sig_file, hash);
+      }
+    }
+
+    kvtree_delete(&hash);
+    scr_free(&sig_file);
+    scr_free(&sig);
+  }
+  MPI_Bcast(sizes, 3, MPI_UNSIGNED_LONG, 0, store->comm);
+
+  /* the bandwidth of the device on our node weights how many files
+   * we stripe onto it, so it is kept per node */
+  store->write_bw = (double) sizes[2];
+
+  /* every process must agree on the MPI buffer size, and devices of the
+   * same store should behave alike, so use the smallest on any node */
+  unsigned long max = (unsigned long) -1;
+  unsigned long local[2];
+  local[0] = (sizes[0] > 0) ? sizes[0] : max;
+  local[1] = (sizes[1] > 0) ? sizes[1] : max;
+  MPI_Allreduce(local, sizes, 2, MPI_UNSIGNED_LONG, MPI_MIN, scr_comm_world);
+
+  /* fall back to the defaults if no process could measure the store */
+  store->buf_size     = (sizes[0] != max) ? sizes[0] : (unsigned long) scr_file_buf_size;
+  store->mpi_buf_size = (sizes[1] != max) ? (int) sizes[1] : scr_mpi_buf_size;
+
+  if (scr_my_rank_world == 0) {
+    scr_dbg(1, "Tuned buffers of store %s: file %lu bytes, MPI %d bytes",
+      store->name, store->buf_size, store->mpi_buf_size
+    );
+    if (scr_log_enable) {
+      char note[256];
+      snprintf(note, sizeof(note), "store=%s buf=%lu mpibuf=%d",
+        store->name, store->buf_size, store->mpi_buf_size
+      );
+      scr_log_event("BUF_TUNE", note, NULL, NULL, NULL, NULL);
+    }
+  }
+
+  return SCR_SUCCESS;
+}
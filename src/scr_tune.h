@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_TUNE_H
+#define SCR_TUNE_H
+
+#include "scr_storedesc.h"
+
+/*
+=========================================
+This file picks the buffer sizes SCR copies files and sends file data
+over MPI with for each store.  With SCR_BUF_TUNE set, rank 0 of each
+store writes and reads back a short probe file with a few buffer sizes
+the first time the store is used, and keeps the smallest size that
+comes close to the best rate.  Results are saved in the control
+directory under a signature of the file system and device, so later
+runs in the same allocation skip the probe.
+=========================================
+*/
+
+/* measure and set buf_size and mpi_buf_size of store using the
+ * directory dir on it, does nothing if the store was already tuned,
+ * must be called by all procs in the same order for each store */
+int scr_tune_store(scr_storedesc* store, const char* dir);
+
+#endif
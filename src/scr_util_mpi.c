@@ -201,10 +201,43 @@ MPI utility functions
 int scr_alltrue(int flag, MPI_Comm comm)
 {
   int all_true = 0;
-  MPI_Allreduce(&flag, &all_true, 1, MPI_INT, MPI_LAND, comm);
+  scr_allreduce(&flag, &all_true, 1, MPI_INT, MPI_LAND, comm);
   return all_true;
 }
 
+/* same as MPI_Allreduce, but with SCR_COLL_HIER set, reductions over
+ * scr_comm_world first reduce within each node, then across rank 0 of
+ * each node, and then broadcast the result within each node, so only
+ * one message per node crosses the network, op must be commutative */
+int scr_allreduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm)
+{
+  /* every proc has the same settings and communicators, so all agree
+   * on which path to take */
+  if (! scr_coll_hier || comm != scr_comm_world || scr_comm_node == MPI_COMM_NULL) {
+    return MPI_Allreduce(sendbuf, recvbuf, count, type, op, comm);
+  }
+
+  /* combine values from procs on our node in the node leader */
+  int rc;
+  if (scr_my_rank_host == 0) {
+    rc = MPI_Reduce(sendbuf, recvbuf, count, type, op, 0, scr_comm_node);
+  } else {
+    const void* buf = (sendbuf == MPI_IN_PLACE) ? recvbuf : sendbuf;
+    rc = MPI_Reduce(buf, NULL, count, type, op, 0, scr_comm_node);
+  }
+
+  /* combine node values across leaders */
+  if (rc == MPI_SUCCESS && scr_comm_node_leaders != MPI_COMM_NULL) {
+    rc = MPI_Allreduce(MPI_IN_PLACE, recvbuf, count, type, op, scr_comm_node_leaders);
+  }
+
+  /* hand the result to everyone on the node */
+  if (rc == MPI_SUCCESS) {
+    rc = MPI_Bcast(recvbuf, count, type, 0, scr_comm_node);
+  }
+  return rc;
+}
+
 void scr_allabort(const char* file, int line, int code, const char* format, ...)
 {
   /* have rank 0 print the message and call abort */
@@ -332,20 +365,20 @@ int scr_axl(
 {
   int rc = SCR_SUCCESS;
 
-  /* define a transfer handle */
-  int id = AXL_Create_comm(type, name, NULL, comm);
+  /* the _comm versions of the AXL calls only agree on the result of
+   * each step, so we define the handle and add files on our own and
+   * check that everyone succeeded once before we transfer anything */
+  int id = AXL_Create(type, name, NULL);
   if (id < 0) {
     scr_err("Failed to create AXL transfer handle @ %s:%d",
       __FILE__, __LINE__
     );
-
-    /* if we fail to create, bail out now */
-    return SCR_FAILURE;
+    rc = SCR_FAILURE;
   }
 
   /* add files to transfer list */
   int i;
-  for (i = 0; i < num_files; i++) {
+  for (i = 0; i < num_files && id >= 0; i++) {
     const char* src_file  = src_filelist[i];
     const char* dest_file = dest_filelist[i];
     if (AXL_Add(id, src_file, dest_file) != AXL_SUCCESS) {
@@ -356,17 +389,21 @@ int scr_axl(
     }
   }
 
-  /* kick off the transfer */
-  if (AXL_Dispatch_comm(id, comm) != AXL_SUCCESS) {
+  /* bail out if anyone failed to set up its transfer */
+  if (! scr_alltrue(rc == SCR_SUCCESS, comm)) {
+    if (id >= 0) {
+      AXL_Free(id);
+    }
+    return SCR_FAILURE;
+  }
+
+  /* kick off the transfer and wait for it to complete */
+  if (AXL_Dispatch(id) != AXL_SUCCESS) {
     scr_err("Failed to dispatch AXL transfer handle %d @ %s:%d",
       id, __FILE__, __LINE__
     );
     rc = SCR_FAILURE;
-  }
-
-  /* wait for transfer to complete */
-  int rc_axl = AXL_Wait_comm(id, comm);
-  if (rc_axl != AXL_SUCCESS) {
+  } else if (AXL_Wait(id) != AXL_SUCCESS) {
     /* transfer failed */
     scr_err("Failed to wait on AXL transfer handle %d @ %s:%d",
       id, __FILE__, __LINE__
@@ -375,12 +412,123 @@ int scr_axl(
   }
 
   /* release the handle */
-  if (AXL_Free_comm(id, comm) != AXL_SUCCESS) {
+  if (AXL_Free(id) != AXL_SUCCESS) {
     scr_err("Failed to free AXL transfer handle %d @ %s:%d",
       id, __FILE__, __LINE__
     );
     rc = SCR_FAILURE;
   }
 
+  /* the transfer succeeded only if it did on every proc */
+  if (! scr_alltrue(rc == SCR_SUCCESS, comm)) {
+    rc = SCR_FAILURE;
+  }
+
   return rc;
 }
+
+/* same as scr_axl, but gathers the file lists of each group to rank 0 of
+ * group_comm, which transfers the files of its group using one AXL handle
+ * over leaders_comm, returns the same value on all procs in comm */
+int scr_axl_leaders(
+  const char* name,
+  int num_files,
+  const char** src_filelist,
+  const char** dest_filelist,
+  axl_xfer_t type,
+  MPI_Comm group_comm,
+  MPI_Comm leaders_comm,
+  MPI_Comm comm)
+{
+  int rc = SCR_SUCCESS;
+
+  int rank, ranks;
+  MPI_Comm_rank(group_comm, &rank);
+  MPI_Comm_size(group_comm, &ranks);
+
+  /* pack our source and destination names into a single buffer */
+  int i;
+  int bytes = 0;
+  for (i = 0; i < num_files; i++) {
+    bytes += (int) (strlen(src_filelist[i]) + 1 + strlen(dest_filelist[i]) + 1);
+  }
+  char* sendbuf = (char*) SCR_MALLOC(bytes > 0 ? bytes : 1);
+  char* ptr = sendbuf;
+  for (i = 0; i < num_files; i++) {
+    strcpy(ptr, src_filelist[i]);
+    ptr += strlen(src_filelist[i]) + 1;
+    strcpy(ptr, dest_filelist[i]);
+    ptr += strlen(dest_filelist[i]) + 1;
+  }
+
+  /* gather the number of files and bytes from each rank */
+  int counts[2] = {num_files, bytes};
+  int* all_counts = NULL;
+  int* recvcounts = NULL;
+  int* displs     = NULL;
+  if (rank == 0) {
+    all_counts = (int*) SCR_MALLOC(2 * ranks * sizeof(int));
+    recvcounts = (int*) SCR_MALLOC(ranks * sizeof(int));
+    displs     = (int*) SCR_MALLOC(ranks * sizeof(int));
+  }
+  MPI_Gather(counts, 2, MPI_INT, all_counts, 2, MPI_INT, 0, group_comm);
+
+  /* gather the file names */
+  int total_files = 0;
+  int total_bytes = 0;
+  if (rank == 0) {
+    for (i = 0; i < ranks; i++) {
+      recvcounts[i] = all_counts[2 * i + 1];
+      displs[i]     = total_bytes;
+      total_files  += all_counts[2 * i];
+      total_bytes  += all_counts[2 * i + 1];
+    }
+  }
+  char* recvbuf = NULL;
+  if (rank == 0) {
+    recvbuf = (char*) SCR_MALLOC(total_bytes > 0 ? total_bytes : 1);
+  }
+  MPI_Gatherv(sendbuf, bytes, MPI_CHAR, recvbuf, recvcounts, displs, MPI_CHAR, 0, group_comm);
+  scr_free(&sendbuf);
+
+  /* the leader transfers the files for its group */
+  if (rank == 0) {
+    const char** src_list = NULL;
+    const char** dst_list = NULL;
+    if (total_files > 0) {
+      src_list = (const char**) SCR_MALLOC(total_files * sizeof(char*));
+      dst_list = (const char**) SCR_MALLOC(total_files * sizeof(char*));
+    }
+    ptr = recvbuf;
+    for (i = 0; i < total_files; i++) {
+      src_list[i] = ptr;
+      ptr += strlen(ptr) + 1;
+      dst_list[i] = ptr;
+      ptr += strlen(ptr) + 1;
+    }
+
+    if (leaders_comm != MPI_COMM_NULL) {
+      rc = scr_axl(name, total_files, src_list, dst_list, type, leaders_comm);
+    } else {
+      scr_err("Missing communicator of leaders for AXL transfer @ %s:%d",
+        __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+
+    scr_free(&src_list);
+    scr_free(&dst_list);
+  }
+  scr_free(&recvbuf);
+  scr_free(&displs);
+  scr_free(&recvcounts);
+  scr_free(&all_counts);
+
+  /* let the group know how the transfer went */
+  MPI_Bcast(&rc, 1, MPI_INT, 0, group_comm);
+
+  if (! scr_alltrue(rc == SCR_SUCCESS, comm)) {
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
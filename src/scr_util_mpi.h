@@ -47,6 +47,10 @@ MPI utility functions
 /* returns true (non-zero) if flag on each process in comm is true */
 int scr_alltrue(int flag, MPI_Comm comm);
 
+/* same as MPI_Allreduce, but with SCR_COLL_HIER set, reductions over
+ * scr_comm_world go through node leaders, op must be commutative */
+int scr_allreduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm);
+
 /* rank 0 prints a message and calls MPI_Abort, while others wait in a barrier */
 #define SCR_ALLABORT(X, ...)  \
     do { scr_allabort(__FILE__, __LINE__, X, __VA_ARGS__); } while (0)
@@ -71,4 +75,18 @@ int scr_axl(
   MPI_Comm comm
 );
 
+/* same as scr_axl, but gathers the file lists of each group to rank 0 of
+ * group_comm, which transfers the files of its group using one AXL handle
+ * over leaders_comm, returns the same value on all procs in comm */
+int scr_axl_leaders(
+  const char* name,
+  int num_files,
+  const char** src_filelist,
+  const char** dest_filelist,
+  axl_xfer_t type,
+  MPI_Comm group_comm,
+  MPI_Comm leaders_comm,
+  MPI_Comm comm
+);
+
 #endif
@@ -279,6 +279,31 @@ FORTRAN_API void FORT_CALL scr_complete_output_(int* valid, int* ierror)
   return;
 }
 
+FORTRAN_API void FORT_CALL scr_icomplete_output_(int* valid, int* req, int* ierror)
+{
+  int valid_tmp = *valid;
+  SCR_Request req_tmp;
+  *ierror = SCR_Icomplete_output(valid_tmp, &req_tmp);
+  *req = (int) req_tmp;
+  return;
+}
+
+FORTRAN_API void FORT_CALL scr_test_output_(int* req, int* flag, int* ierror)
+{
+  SCR_Request req_tmp = (SCR_Request) *req;
+  int flag_tmp;
+  *ierror = SCR_Test_output(req_tmp, &flag_tmp);
+  *flag = flag_tmp;
+  return;
+}
+
+FORTRAN_API void FORT_CALL scr_wait_output_(int* req, int* ierror)
+{
+  SCR_Request req_tmp = (SCR_Request) *req;
+  *ierror = SCR_Wait_output(req_tmp);
+  return;
+}
+
 /*================================================
  * Route file
  *================================================*/
@@ -228,3 +228,14 @@ rm -f ${prefix_files}
 ${scrbin}/scr_srun -n4 -N4 ./test_api
 ${scrbin}/scr_index --list
 
+
+
+# flush each checkpoint asynchronously, check that SCR_Finalize reports
+# "letting it finish" for the flush of the last checkpoint
+srun -n4 -N4 /bin/rm -rf /dev/shm/${USER}/scr.$jobid
+rm -f ${prefix_files}
+export SCR_FLUSH=1
+export SCR_FLUSH_ASYNC=1
+srun -n4 -N4 ./test_api
+unset SCR_FLUSH_ASYNC
+${scrbin}/scr_index --list